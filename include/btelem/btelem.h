@@ -20,18 +20,74 @@ struct btelem_ring {
     struct btelem_entry entries[];  /* flexible array */
 };
 
+/*
+ * Ring layouts.  BTELEM_RING_FIXED stores one struct btelem_entry per slot.
+ * BTELEM_RING_VAR treats the slot storage as BTELEM_VAR_UNIT-byte units and
+ * sizes each record to its payload; head, capacity and client cursors then
+ * count units rather than entries.  BTELEM_RING_SHARDED gives every producer
+ * thread its own fixed-layout ring (see btelem_init_sharded).
+ */
+#define BTELEM_RING_FIXED   0
+#define BTELEM_RING_VAR     1
+#define BTELEM_RING_SHARDED 2   /* one fixed-layout SPSC ring per producer */
+
+/*
+ * Timestamp calibration.  tick_hz == 0 means entry timestamps are already
+ * nanoseconds (the default BTELEM_TIMESTAMP()) and nothing is carried on the
+ * wire.  Otherwise (ref_ticks, ref_ns) is a simultaneous reading of the tick
+ * counter and CLOCK_MONOTONIC.
+ */
+struct btelem_clock {
+    uint64_t tick_hz;
+    uint64_t ref_ticks;
+    uint64_t ref_ns;
+};
+
 /* --------------------------------------------------------------------------
  * Context: owns the ring buffer, schema registry, and clients
  * ----------------------------------------------------------------------- */
 
 struct btelem_ctx {
     struct btelem_ring  *ring;
-    struct btelem_client clients[BTELEM_MAX_CLIENTS];
+    struct btelem_client *clients;     /* client_slots, or a shared table */
+    struct btelem_client client_slots[BTELEM_MAX_CLIENTS];
+
+    /* Shared-memory contexts only (btelem_shm.h): bit i set = slot i taken,
+     * claimed atomically since other processes open clients too */
+    btelem_atomic_u64   *client_claim;
+    uint32_t             client_owner;  /* stored in clients we open (pid) */
+    void                *shm;           /* mapped segment */
 
     /* Schema registry */
     const struct btelem_schema_entry *schema[BTELEM_MAX_SCHEMA_ENTRIES];
     uint16_t schema_count;
     uint8_t  endianness;    /* 0 = little, 1 = big */
+    uint8_t  ring_mode;     /* BTELEM_RING_FIXED, _VAR or _SHARDED */
+
+    /* BTELEM_RING_SHARDED only (ring == shards[0]) */
+    struct btelem_ring *shards[BTELEM_MAX_SHARDS];
+    uint16_t            shard_count;
+    uint64_t            shard_epoch;    /* distinguishes re-inits of the same ctx */
+    uint32_t            shard_live;     /* slot in the live sharded-context table */
+    btelem_atomic_u64   shards_busy;    /* bit per shard bound to a thread (or stats) */
+    btelem_atomic_u64   shard_releases; /* btelem_shard_detach() count: unbound threads retry */
+    btelem_atomic_u64   shard_unbound;  /* entries discarded: no shard for thread */
+    struct btelem_ring *stats_shard;    /* reserved by btelem_stats_register() */
+
+    struct btelem_clock clock;          /* set by init under BTELEM_TIMESTAMP_TSC */
+
+    /* Consumer wake-up (see btelem_wake_arm); UINT64_MAX = disarmed */
+    btelem_atomic_u64   wake_at;
+    btelem_atomic_u64   wake_gate;      /* callbacks in flight; see btelem_wake_set */
+    void              (*wake_fn)(void *user);
+    void               *wake_user;
+
+    /* Latest btelem_trigger() window, in entry timestamp units.  Seqlock:
+     * trigger_seq is odd while a trigger is being written, 2 * triggers
+     * otherwise */
+    btelem_atomic_u64   trigger_seq;
+    uint64_t            trigger_from;
+    uint64_t            trigger_to;
 };
 
 /* --------------------------------------------------------------------------
@@ -54,6 +110,103 @@ size_t btelem_ring_size(uint32_t entry_count);
  */
 int btelem_init(struct btelem_ctx *ctx, void *ring_buf, uint32_t entry_count);
 
+/**
+ * Retire a context before its memory is freed or reused for something
+ * else.  Threads still bound to a sharded ctx drop that binding later
+ * without touching ctx.  No thread may log to or drain ctx during or after
+ * the call.  Re-initialising a ctx retires its previous use implicitly.
+ *
+ * Required for sharded contexts: one freed without it keeps its slot of
+ * the BTELEM_MAX_SHARDED_CTXS live-context table for good.
+ */
+void btelem_deinit(struct btelem_ctx *ctx);
+
+/**
+ * Compute the required buffer size for a variable-length ring with
+ * `unit_count` units of BTELEM_VAR_UNIT bytes.  `unit_count` must be a
+ * power of 2.
+ */
+size_t btelem_ring_size_var(uint32_t unit_count);
+
+/**
+ * Initialise a btelem context with a variable-length ring (BTELEM_RING_VAR).
+ *
+ * Each record takes ceil((24 + payload) / BTELEM_VAR_UNIT) units instead of
+ * a full 256-byte slot, so small payloads give a much deeper ring for the
+ * same memory.  BTELEM_LOG, the drain functions and btelem_client_available
+ * work unchanged; the only visible difference is that drop counts are in
+ * ring units (an upper bound on lost entries) rather than entries.
+ *
+ * @param ctx         Context to initialise (caller-owned, e.g. static).
+ * @param ring_buf    Memory for the ring (must be btelem_ring_size_var() bytes).
+ * @param unit_count  Number of units (power of 2, >= BTELEM_VAR_MAX_UNITS).
+ * @return 0 on success, -1 on invalid arguments.
+ */
+int btelem_init_var(struct btelem_ctx *ctx, void *ring_buf, uint32_t unit_count);
+
+/**
+ * Compute the required buffer size for a sharded context with `shard_count`
+ * rings of `entries_per_shard` slots each.
+ */
+size_t btelem_ring_size_sharded(uint32_t shard_count, uint32_t entries_per_shard);
+
+/**
+ * Initialise a btelem context with per-producer shards (BTELEM_RING_SHARDED).
+ *
+ * Each producer thread writes to its own single-producer ring, so the log
+ * path has no shared atomic read-modify-write.  Drain functions k-way merge
+ * the shards by timestamp into the usual packet format; each client keeps a
+ * cursor and drop count per shard.
+ *
+ * A thread is bound to a shard on its first BTELEM_LOG (or explicitly with
+ * btelem_shard_attach) and keeps it until btelem_shard_detach().  At most
+ * `shard_count` threads can be bound at once: while every shard is taken,
+ * further threads discard what they log (counted in ctx->shard_unbound)
+ * and only retry the claim after some thread detaches.  Size `shard_count`
+ * for the number of concurrent producers, and have short-lived threads
+ * detach before they exit.
+ *
+ * A thread keeps one binding per sharded context for up to
+ * BTELEM_SHARD_BINDINGS contexts; logging to one more evicts the least
+ * recently used binding and releases that shard, unless its ctx has been
+ * retired with btelem_deinit() meanwhile.  btelem_deinit() is required
+ * before freeing a sharded ctx: besides stale bindings, each live sharded
+ * ctx holds one of BTELEM_MAX_SHARDED_CTXS process-wide slots until it is
+ * retired (or the same ctx is re-initialised).
+ *
+ * @param ctx                Context to initialise.
+ * @param ring_buf           Memory (must be btelem_ring_size_sharded() bytes).
+ * @param shard_count        Number of shards (1..BTELEM_MAX_SHARDS).
+ * @param entries_per_shard  Slots per shard (power of 2).
+ * @return 0 on success, -1 on invalid arguments or if
+ *         BTELEM_MAX_SHARDED_CTXS sharded contexts are already live.
+ */
+int btelem_init_sharded(struct btelem_ctx *ctx, void *ring_buf,
+                        uint32_t shard_count, uint32_t entries_per_shard);
+
+/**
+ * Bind the calling thread to a shard of a sharded context.
+ *
+ * @param shard  Shard index to bind to, or -1 to claim the next unused one.
+ *               Binding by index is for callers that already partition
+ *               producers (e.g. one pinned thread per CPU).  Either way the
+ *               shard is claimed, so no two threads ever write one shard.
+ * A thread already bound to another shard of ctx moves, releasing it.
+ * @return Shard index, or -1 if the context isn't sharded or the shard (or
+ *         every shard, for -1) is held by another thread.  On failure the
+ *         thread keeps its current binding.
+ */
+int btelem_shard_attach(struct btelem_ctx *ctx, int shard);
+
+/**
+ * Release the calling thread's shard so a later btelem_shard_attach(-1)
+ * (or first BTELEM_LOG) on another thread can claim it.  Call after the
+ * thread's last log, e.g. just before it exits; entries already in the
+ * shard stay readable and the next owner continues after them.
+ * @return 0 on success, -1 if the thread isn't bound to a shard of ctx.
+ */
+int btelem_shard_detach(struct btelem_ctx *ctx);
+
 /* --------------------------------------------------------------------------
  * Schema registration
  * ----------------------------------------------------------------------- */
@@ -64,6 +217,51 @@ int btelem_init(struct btelem_ctx *ctx, void *ring_buf, uint32_t entry_count);
  */
 int btelem_register(struct btelem_ctx *ctx, const struct btelem_schema_entry *entry);
 
+/* --------------------------------------------------------------------------
+ * Consumer wake-up
+ *
+ * Lets one consumer per context sleep instead of polling the ring.  The
+ * consumer installs a callback once, then arms before each sleep; the
+ * first log that brings the ring head to the armed position disarms and
+ * invokes the callback on the producer's thread.  While disarmed the hot
+ * path pays one relaxed load and compare.
+ *
+ * Producers do not fence between committing an entry and checking the
+ * arm, so a wake-up can be missed in a narrow window: consumers must still
+ * sleep with a timeout, which also bounds latency below the threshold.
+ * ----------------------------------------------------------------------- */
+
+/**
+ * Install the wake callback (e.g. an eventfd write).  Must be
+ * async-safe with respect to the producers that may call it.
+ * Pass NULL to remove it; this also disarms.  Returns only once no
+ * producer is still inside the previous callback, so its resources (e.g.
+ * the eventfd) may be released right after.  Must not be called from the
+ * callback itself.
+ */
+void btelem_wake_set(struct btelem_ctx *ctx, void (*fn)(void *user), void *user);
+
+/**
+ * Arm the wake-up for `threshold` ring positions past the client's cursor
+ * (entries, or units on a BTELEM_RING_VAR ring; any new entry on a sharded
+ * context).  Arming is one-shot.
+ *
+ * @return 1 if `threshold` positions were already pending after arming
+ *         (drain instead of sleeping), 0 if the caller may sleep,
+ *         -1 on invalid arguments.
+ */
+int btelem_wake_arm(struct btelem_ctx *ctx, int client_id, uint32_t threshold);
+
+/** Slow path of btelem_wake_check: disarm and call the wake callback. */
+void btelem_wake_fire(struct btelem_ctx *ctx);
+
+/** Called by the logging paths with the ring position after the write. */
+static inline void btelem_wake_check(struct btelem_ctx *ctx, uint64_t end)
+{
+    if (end >= btelem_atomic_load_relaxed(&ctx->wake_at))
+        btelem_wake_fire(ctx);
+}
+
 /* --------------------------------------------------------------------------
  * Logging (hot path)
  * ----------------------------------------------------------------------- */
@@ -88,15 +286,281 @@ int btelem_register(struct btelem_ctx *ctx, const struct btelem_schema_entry *en
     do { \
         _Static_assert(sizeof(data) <= BTELEM_MAX_PAYLOAD, \
                        "btelem: payload exceeds BTELEM_MAX_PAYLOAD"); \
-        struct btelem_ring *_btlm_r = (ctx)->ring; \
-        uint64_t _btlm_slot = btelem_atomic_fetch_add_relaxed(&_btlm_r->head, 1); \
-        struct btelem_entry *_btlm_e = &_btlm_r->entries[_btlm_slot & _btlm_r->mask]; \
-        btelem_atomic_store_rel((btelem_atomic_u64 *)&_btlm_e->seq, 0); \
-        _btlm_e->timestamp = BTELEM_TIMESTAMP(); \
-        _btlm_e->id = (uint16_t)(id_expr); \
-        _btlm_e->payload_size = (uint16_t)sizeof(data); \
-        memcpy(_btlm_e->payload, &(data), sizeof(data)); \
-        btelem_atomic_store_rel((btelem_atomic_u64 *)&_btlm_e->seq, _btlm_slot + 1); \
+        struct btelem_ctx *_btlm_c = (ctx); \
+        struct btelem_ring *_btlm_r = _btlm_c->ring; \
+        uint64_t _btlm_end; \
+        if (_btlm_c->ring_mode == BTELEM_RING_VAR) { \
+            _btlm_end = btelem_log_var(_btlm_r, (uint16_t)(id_expr), &(data), \
+                                       (uint16_t)sizeof(data)); \
+        } else if (_btlm_c->ring_mode == BTELEM_RING_SHARDED) { \
+            _btlm_end = btelem_log_shard(_btlm_c, (uint16_t)(id_expr), &(data), \
+                                         (uint16_t)sizeof(data)); \
+        } else { \
+            uint64_t _btlm_slot = btelem_atomic_fetch_add_relaxed(&_btlm_r->head, 1); \
+            struct btelem_entry *_btlm_e = &_btlm_r->entries[_btlm_slot & _btlm_r->mask]; \
+            btelem_atomic_store_rel((btelem_atomic_u64 *)&_btlm_e->seq, 0); \
+            _btlm_e->timestamp = BTELEM_TIMESTAMP(); \
+            _btlm_e->id = (uint16_t)(id_expr); \
+            _btlm_e->payload_size = (uint16_t)sizeof(data); \
+            memcpy(_btlm_e->payload, &(data), sizeof(data)); \
+            btelem_atomic_store_rel((btelem_atomic_u64 *)&_btlm_e->seq, _btlm_slot + 1); \
+            _btlm_end = _btlm_slot + 1; \
+        } \
+        btelem_wake_check(_btlm_c, _btlm_end); \
+    } while (0)
+
+/*
+ * Write an uncommitted variable-length record at unit `pos` (reserved by the
+ * caller).  The caller publishes it by storing seq = pos + 1.
+ */
+static inline struct btelem_var_header *
+btelem_var_write(struct btelem_ring *r, uint64_t pos, uint32_t units,
+                 uint16_t id, uint64_t timestamp, const void *data, uint16_t size)
+{
+    uint8_t *base = (uint8_t *)r->entries;
+    size_t ring_bytes = (size_t)r->capacity * BTELEM_VAR_UNIT;
+    size_t off = (size_t)(pos & r->mask) * BTELEM_VAR_UNIT;
+
+    struct btelem_var_header *h = (struct btelem_var_header *)(base + off);
+    btelem_atomic_store_rel((btelem_atomic_u64 *)&h->seq, 0);
+    /* Order the reservation and seq=0 before the payload stores: readers
+     * detect overwrite by re-checking head after their copy. */
+    btelem_atomic_fence_rel();
+    h->timestamp = timestamp;
+    h->id = id;
+    h->payload_size = size;
+    h->units = (uint16_t)units;
+
+    off += sizeof(*h);
+    size_t first = ring_bytes - off;
+    if (first > size)
+        first = size;
+    memcpy(base + off, data, first);
+    if (first < size)
+        memcpy(base, (const uint8_t *)data + first, size - first);
+
+    return h;
+}
+
+/**
+ * Variable-length ring write (used by BTELEM_LOG_ID in BTELEM_RING_VAR mode).
+ *
+ * Reserves BTELEM_VAR_UNITS(size) units with a single fetch_add on head,
+ * then follows the same seq=0 / write / seq=slot+1 commit protocol as the
+ * fixed layout.  The payload may wrap from the last unit to unit 0.
+ * Returns the unit position after the record.
+ */
+static inline uint64_t btelem_log_var(struct btelem_ring *r, uint16_t id,
+                                      const void *data, uint16_t size)
+{
+    uint32_t units = BTELEM_VAR_UNITS(size);
+    uint64_t pos = btelem_atomic_fetch_add_relaxed(&r->head, units);
+    struct btelem_var_header *h =
+        btelem_var_write(r, pos, units, id, BTELEM_TIMESTAMP(), data, size);
+    btelem_atomic_store_rel((btelem_atomic_u64 *)&h->seq, pos + 1);
+    return pos + units;
+}
+
+/* The calling thread's shard in the sharded context it logged to last (the
+ * front of a per-thread table, see BTELEM_SHARD_BINDINGS).  ring == NULL
+ * with ctx set means no shard was free when `releases` was
+ * ctx->shard_releases; the claim is not retried until that changes. */
+struct btelem_shard_binding {
+    const struct btelem_ctx *ctx;
+    uint64_t                 epoch;
+    uint32_t                 live;      /* ctx->shard_live */
+    struct btelem_ring      *ring;
+    uint64_t                 releases;
+};
+
+extern BTELEM_THREAD_LOCAL struct btelem_shard_binding btelem_tls_shard;
+
+/** Slow path of btelem_log_shard: bind the thread, or NULL if no shard is free. */
+struct btelem_ring *btelem_shard_bind(struct btelem_ctx *ctx);
+
+/**
+ * Append one entry to shard r, which the caller is the only writer of.
+ *
+ * Head is advanced with a plain release store after the entry is
+ * committed — no atomic read-modify-write.  The seq protocol is kept so
+ * readers still detect being lapped mid-copy.
+ * Returns the shard position after the entry.
+ */
+static inline uint64_t btelem_shard_write(struct btelem_ring *r, uint16_t id,
+                                          const void *data, uint16_t size)
+{
+    uint64_t slot = btelem_atomic_load_acq(&r->head);
+    struct btelem_entry *e = &r->entries[slot & r->mask];
+    btelem_atomic_store_rel((btelem_atomic_u64 *)&e->seq, 0);
+    e->timestamp = BTELEM_TIMESTAMP();
+    e->id = id;
+    e->payload_size = size;
+    memcpy(e->payload, data, size);
+    btelem_atomic_store_rel((btelem_atomic_u64 *)&e->seq, slot + 1);
+    btelem_atomic_store_rel(&r->head, slot + 1);
+    return slot + 1;
+}
+
+/**
+ * Sharded ring write (used by BTELEM_LOG_ID in BTELEM_RING_SHARDED mode):
+ * btelem_shard_write() to the calling thread's shard.
+ * Returns the shard position after the entry, or 0 if the entry was
+ * discarded because no shard is free (counted in ctx->shard_unbound and
+ * btelem_stats().unbound; the wake check never fires on 0).
+ */
+static inline uint64_t btelem_log_shard(struct btelem_ctx *ctx, uint16_t id,
+                                        const void *data, uint16_t size)
+{
+    struct btelem_ring *r = btelem_tls_shard.ring;
+    if (btelem_tls_shard.ctx != ctx || btelem_tls_shard.epoch != ctx->shard_epoch || !r) {
+        r = btelem_shard_bind(ctx);
+        if (!r)
+            return 0;
+    }
+    return btelem_shard_write(r, id, data, size);
+}
+
+/* --------------------------------------------------------------------------
+ * Batched logging (hot path)
+ *
+ * For bursts (e.g. an ISR draining a sensor FIFO), reserve n consecutive
+ * slots with one atomic and one timestamp read, fill them, then commit:
+ *
+ *   struct btelem_batch b;
+ *   if (btelem_reserve(ctx, &b, n, sizeof(struct sample)) == 0) {
+ *       for (uint32_t i = 0; i < n; i++)
+ *           btelem_batch_put(&b, i, BTELEM_ID_SAMPLE, &s[i], sizeof(s[i]), i * dt);
+ *       btelem_commit(&b);
+ *   }
+ *
+ * Each entry is still a normal ring entry, so drains see no difference.
+ * ----------------------------------------------------------------------- */
+
+struct btelem_batch {
+    struct btelem_ctx  *ctx;
+    struct btelem_ring *ring;
+    uint64_t            first;      /* first reserved slot (or unit) */
+    uint64_t            timestamp;  /* shared base; entries add a delta */
+    uint32_t            count;
+    uint32_t            units;      /* units per record (BTELEM_RING_VAR), else 0 */
+    uint8_t             sharded;    /* publish head on commit */
+};
+
+/**
+ * Reserve `n` consecutive entries of up to `max_size` payload bytes each.
+ * Reads BTELEM_TIMESTAMP() once as the batch's timestamp base.
+ *
+ * @return 0 on success, -1 if n is 0, exceeds the ring, or max_size is too
+ *         large (or, for sharded contexts, no shard is free for this thread).
+ */
+static inline int btelem_reserve(struct btelem_ctx *ctx, struct btelem_batch *b,
+                                 uint32_t n, uint16_t max_size)
+{
+    struct btelem_ring *r = ctx->ring;
+    if (n == 0 || max_size > BTELEM_MAX_PAYLOAD)
+        return -1;
+
+    b->count = n;
+    b->units = 0;
+    b->sharded = 0;
+
+    if (ctx->ring_mode == BTELEM_RING_VAR) {
+        b->units = BTELEM_VAR_UNITS(max_size);
+        if ((uint64_t)n * b->units > r->capacity)
+            return -1;
+        b->first = btelem_atomic_fetch_add_relaxed(&r->head, (uint64_t)n * b->units);
+    } else if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        r = btelem_tls_shard.ring;
+        if (btelem_tls_shard.ctx != ctx || btelem_tls_shard.epoch != ctx->shard_epoch || !r) {
+            r = btelem_shard_bind(ctx);
+            if (!r)
+                return -1;
+        }
+        if (n > r->capacity)
+            return -1;
+        b->first = btelem_atomic_load_acq(&r->head);
+        b->sharded = 1;
+    } else {
+        if (n > r->capacity)
+            return -1;
+        b->first = btelem_atomic_fetch_add_relaxed(&r->head, n);
+    }
+
+    b->ctx = ctx;
+    b->ring = r;
+    b->timestamp = BTELEM_TIMESTAMP();
+    return 0;
+}
+
+/**
+ * Fill reserved entry `i` (0 <= i < n) with timestamp base + ts_delta.
+ * `size` must not exceed the reservation's max_size.
+ */
+static inline void btelem_batch_put(struct btelem_batch *b, uint32_t i, uint16_t id,
+                                    const void *data, uint16_t size, uint64_t ts_delta)
+{
+    struct btelem_ring *r = b->ring;
+    if (b->units) {
+        btelem_var_write(r, b->first + (uint64_t)i * b->units, b->units, id,
+                         b->timestamp + ts_delta, data, size);
+        return;
+    }
+
+    struct btelem_entry *e = &r->entries[(b->first + i) & r->mask];
+    btelem_atomic_store_rel((btelem_atomic_u64 *)&e->seq, 0);
+    e->timestamp = b->timestamp + ts_delta;
+    e->id = id;
+    e->payload_size = size;
+    memcpy(e->payload, data, size);
+}
+
+/** Publish every entry of a reserved batch. */
+static inline void btelem_commit(struct btelem_batch *b)
+{
+    struct btelem_ring *r = b->ring;
+    if (b->units) {
+        for (uint32_t i = 0; i < b->count; i++) {
+            uint64_t pos = b->first + (uint64_t)i * b->units;
+            struct btelem_var_header *h = (struct btelem_var_header *)
+                ((uint8_t *)r->entries + (size_t)(pos & r->mask) * BTELEM_VAR_UNIT);
+            btelem_atomic_store_rel((btelem_atomic_u64 *)&h->seq, pos + 1);
+        }
+        btelem_wake_check(b->ctx, b->first + (uint64_t)b->count * b->units);
+        return;
+    }
+
+    for (uint32_t i = 0; i < b->count; i++) {
+        uint64_t slot = b->first + i;
+        struct btelem_entry *e = &r->entries[slot & r->mask];
+        btelem_atomic_store_rel((btelem_atomic_u64 *)&e->seq, slot + 1);
+    }
+    if (b->sharded)
+        btelem_atomic_store_rel(&r->head, b->first + b->count);
+    btelem_wake_check(b->ctx, b->first + b->count);
+}
+
+/**
+ * Log `n` elements of `array` (all the same schema) as one batch.  Entry i
+ * is timestamped base + i * dt_ns, where base is read once per batch.
+ *
+ * Usage:
+ *   struct sample s[16];
+ *   BTELEM_LOG_BATCH(ctx, SAMPLE, s, 16, 1000);   // 1 kHz sensor burst
+ */
+#define BTELEM_LOG_BATCH(ctx, tag, array, n, dt_ns) \
+    do { \
+        _Static_assert(sizeof((array)[0]) <= BTELEM_MAX_PAYLOAD, \
+                       "btelem: payload exceeds BTELEM_MAX_PAYLOAD"); \
+        struct btelem_batch _btlm_b; \
+        uint32_t _btlm_n = (uint32_t)(n); \
+        if (btelem_reserve((ctx), &_btlm_b, _btlm_n, \
+                           (uint16_t)sizeof((array)[0])) == 0) { \
+            for (uint32_t _btlm_i = 0; _btlm_i < _btlm_n; _btlm_i++) \
+                btelem_batch_put(&_btlm_b, _btlm_i, BTELEM_ID_##tag, \
+                                 &(array)[_btlm_i], (uint16_t)sizeof((array)[0]), \
+                                 (uint64_t)(dt_ns) * _btlm_i); \
+            btelem_commit(&_btlm_b); \
+        } \
     } while (0)
 
 /* --------------------------------------------------------------------------
@@ -112,6 +576,19 @@ int btelem_register(struct btelem_ctx *ctx, const struct btelem_schema_entry *en
 int btelem_client_open(struct btelem_ctx *ctx,
                        const uint16_t *filter_ids, int filter_count);
 
+/* Where btelem_client_open_at() starts a client */
+#define BTELEM_FROM_HEAD    0   /* new entries only, as btelem_client_open() */
+#define BTELEM_FROM_OLDEST  1   /* everything still in the ring */
+
+/**
+ * Register a new client starting at `from` (BTELEM_FROM_HEAD or
+ * BTELEM_FROM_OLDEST).  BTELEM_FROM_OLDEST lets a client opened after the
+ * fact (e.g. on btelem_trigger()) drain the ring's history.
+ * @return Client ID, or -1 if full or `from` is unknown.
+ */
+int btelem_client_open_at(struct btelem_ctx *ctx, int from,
+                          const uint16_t *filter_ids, int filter_count);
+
 /**
  * Close a client, freeing the slot.
  */
@@ -125,12 +602,54 @@ void btelem_client_close(struct btelem_ctx *ctx, int client_id);
 void btelem_client_set_filter(struct btelem_ctx *ctx, int client_id,
                               const uint16_t *filter_ids, int filter_count);
 
+/**
+ * Move a client's cursor back to the oldest entry still in the ring, e.g.
+ * to extract what a crashed producer left in a shared-memory ring.
+ * @return 0 on success, -1 on error.
+ */
+int btelem_client_rewind(struct btelem_ctx *ctx, int client_id);
+
 /**
  * Get the number of entries available to read for a client, and how many
  * were dropped since last drain.
+ *
+ * In BTELEM_RING_VAR mode this walks the committed records after the
+ * client's cursor, and `dropped` is the number of overwritten ring units.
  */
 uint64_t btelem_client_available(struct btelem_ctx *ctx, int client_id, uint64_t *dropped);
 
+/**
+ * Ring positions between the client's cursor and the head: entries, or
+ * units on a BTELEM_RING_VAR ring, summed over shards.  O(1) per ring (no
+ * record walk), so cheap enough to poll; counts records still being
+ * written and ones already overwritten, so treat it as an estimate.
+ */
+uint64_t btelem_client_pending(struct btelem_ctx *ctx, int client_id);
+
+/* --------------------------------------------------------------------------
+ * Snapshot triggers (flight recorder)
+ *
+ * Instead of streaming everything in case something goes wrong, a
+ * consumer can stay idle until btelem_trigger() marks an interesting
+ * moment, then open a client with BTELEM_FROM_OLDEST and keep the entries
+ * timestamped inside the window: history up to pre_ns before the trigger
+ * (as far as the ring reaches) and post_ns after it.  btelem_record does
+ * this with the `trigger` option, writing one .btlm file per window.
+ * ----------------------------------------------------------------------- */
+
+/**
+ * Mark now as interesting: the window is [now - pre_ns, now + post_ns].
+ * Safe from any thread; consumers see the latest trigger.
+ */
+void btelem_trigger(struct btelem_ctx *ctx, uint64_t pre_ns, uint64_t post_ns);
+
+/**
+ * Read the latest trigger.  from/to (either may be NULL) receive its
+ * window in entry timestamp units (ticks under BTELEM_TIMESTAMP_TSC).
+ * @return Number of triggers so far (0 = none; from/to untouched).
+ */
+uint64_t btelem_trigger_get(const struct btelem_ctx *ctx, uint64_t *from, uint64_t *to);
+
 /* --------------------------------------------------------------------------
  * Draining
  * ----------------------------------------------------------------------- */
@@ -179,7 +698,8 @@ typedef int (*btelem_schema_emit_fn)(const void *chunk, size_t len, void *user);
  *
  * Emits the schema one piece at a time using only stack space (~1.3 KB).
  * Chunk order: header, schema entries (one per call), enum count + enum
- * entries (one per call).  The total byte count across all chunks equals
+ * entries (one per call), bitfield count + bitfield entries, then the clock
+ * record if ctx->clock is set.  The total byte count across all chunks equals
  * what btelem_schema_serialize(ctx, NULL, 0) would return.
  *
  * @param ctx   Context with registered schemas.
@@ -190,6 +710,63 @@ typedef int (*btelem_schema_emit_fn)(const void *chunk, size_t len, void *user);
 int btelem_schema_stream(const struct btelem_ctx *ctx,
                          btelem_schema_emit_fn emit, void *user);
 
+/**
+ * Serialise the schema in the compact format (btelem_schema_compact_header
+ * + length-prefixed records, see btelem_types.h).  Typically a few percent
+ * of the fixed-size form.
+ * @param buf       Output buffer, or NULL to query the required size.
+ * @param buf_size  Size of buf in bytes (ignored when buf is NULL).
+ * @return Number of bytes written (or required when buf is NULL), or -1 on error.
+ */
+int btelem_schema_serialize_compact(const struct btelem_ctx *ctx,
+                                    void *buf, size_t buf_size);
+
+/**
+ * Hash of the compact schema (the header's `hash`), without serialising it.
+ * Stable across runs of the same build; the clock calibration is excluded.
+ */
+uint64_t btelem_schema_hash(const struct btelem_ctx *ctx);
+
+/* --------------------------------------------------------------------------
+ * Tick clock calibration
+ *
+ * When built with BTELEM_TIMESTAMP_TSC, every btelem_init*() calls
+ * btelem_clock_calibrate() and the serialised schema gains a trailing
+ * btelem_clock_wire record.  Long-running producers should refresh the
+ * calibration for decoders now and then (btelem_serve does this every few
+ * seconds) since a short init-time measurement drifts.
+ * ----------------------------------------------------------------------- */
+
+/**
+ * Measure BTELEM_TIMESTAMP() against CLOCK_MONOTONIC (busy-waits ~2 ms)
+ * and store the result in ctx->clock.  Only meaningful when
+ * BTELEM_TIMESTAMP() returns ticks.
+ * @return 0 on success, -1 if no monotonic clock is available.
+ */
+int btelem_clock_calibrate(struct btelem_ctx *ctx);
+
+/**
+ * Take a fresh (ticks, ns) reference pair and re-estimate tick_hz over the
+ * whole interval since ctx->clock was measured.  Does not modify ctx, so it
+ * is safe to call from any drain thread.
+ * @return 0 on success, -1 if ctx has no tick clock.
+ */
+int btelem_clock_sample(const struct btelem_ctx *ctx, struct btelem_clock *out);
+
+/**
+ * Convert an entry timestamp to CLOCK_MONOTONIC nanoseconds using clk
+ * (ctx->clock or a btelem_clock_sample() result).  Returns ts unchanged
+ * when clk->tick_hz == 0, i.e. timestamps are already nanoseconds.
+ */
+uint64_t btelem_clock_ns(const struct btelem_clock *clk, uint64_t ts);
+
+/**
+ * Build a clock-update packet (BTELEM_PACKET_FLAG_CLOCK, no entries) for
+ * sending alongside btelem_drain_packed() output.
+ * @return Packet size in bytes, or -1 if buf is too small.
+ */
+int btelem_clock_packet(const struct btelem_clock *clk, void *buf, size_t buf_size);
+
 /* --------------------------------------------------------------------------
  * Packed batch drain (for transport)
  *
@@ -217,6 +794,277 @@ int btelem_schema_stream(const struct btelem_ctx *ctx,
 int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
                         void *buf, size_t buf_size);
 
+/* --------------------------------------------------------------------------
+ * Packet compression
+ *
+ * Delta-codes a packed batch (BTELEM_PACKET_FLAG_COMPRESSED): timestamps
+ * against the previous entry, payloads XORed against the previous payload
+ * with the same ID, zero runs skipped.  Slowly changing telemetry shrinks
+ * severalfold; nothing carries over between packets.
+ * ----------------------------------------------------------------------- */
+
+/**
+ * Compress a packet from btelem_drain_packed() into out (must not overlap).
+ * @return Compressed size, 0 if the packet would not get smaller (or fit
+ *         out_size), is not an entry batch, or has no entries; -1 if it is
+ *         malformed.
+ */
+int btelem_packet_compress(const void *pkt, size_t len,
+                           void *out, size_t out_size);
+
+/**
+ * Expand a BTELEM_PACKET_FLAG_COMPRESSED packet back into the plain layout.
+ * @return Plain packet size, or -1 if it is malformed or out_size is too
+ *         small.
+ */
+int btelem_packet_decompress(const void *pkt, size_t len,
+                             void *out, size_t out_size);
+
+/* --------------------------------------------------------------------------
+ * Zero-copy drain (scatter/gather transport)
+ *
+ * Same packet as btelem_drain_packed(), described as a list of spans so
+ * the transport can hand it to writev()/sendmsg() without assembling it:
+ *
+ *   iov[0]    packet header + entry table      (built in caller's buf)
+ *   iov[1..]  payloads, pointing into ring slots
+ *
+ * Payloads are not copied, so a producer could overwrite a referenced slot
+ * while the transport is still reading it.  Three defences:
+ *   - slots within capacity/4 of being overwritten when the packet is built
+ *     are copied into buf (after the table) instead of referenced, and
+ *     btelem_drain_iov_validate() re-checks that margin just before the
+ *     send; a packet that fails is copied out with btelem_drain_iov_settle()
+ *     and sent from the copy;
+ *   - a transport that has to wait (a short or would-block write) first
+ *     calls btelem_drain_iov_settle() to copy the unsent rest out of the
+ *     ring, so no slot is read after it may have been reused;
+ *   - btelem_drain_iov_release() re-checks head once the transport is done.
+ *     A referenced slot can only be lapped by capacity/4 entries logged
+ *     during one non-blocking send; if that happens the payload may have
+ *     gone out with newer bytes, so the transport must end the stream.
+ *
+ * BTELEM_RING_VAR and BTELEM_RING_SHARDED contexts fall back to copying the
+ * whole packet into buf (a single span).
+ * ----------------------------------------------------------------------- */
+
+/* Layout-compatible with POSIX struct iovec on common ABIs, but copy the
+ * fields rather than casting. */
+struct btelem_iov {
+    const void *base;
+    size_t      len;
+};
+
+struct btelem_drain_iov {
+    struct btelem_iov iov[BTELEM_DRAIN_IOV_MAX];
+    int               iov_count;
+    size_t            total;        /* packet bytes across all spans */
+
+    /* Referenced ring positions, checked by btelem_drain_iov_release() */
+    int               client_id;
+    uint32_t          ref_count;
+    uint64_t          ref_pos[BTELEM_DRAIN_IOV_MAX];
+};
+
+/**
+ * Drain available entries for a client as a scatter/gather packet.
+ *
+ * Applies the client's filter and advances its cursor, like
+ * btelem_drain_packed().  At most BTELEM_DRAIN_IOV_MAX - 1 entries are
+ * referenced per packet.
+ *
+ * @param d          Span list to fill (caller-owned; ~6 KB).
+ * @param buf        Scratch for the header, entry table and any copied
+ *                   payloads.  Must outlive the transport's use of d.
+ * @param buf_size   Size of buf in bytes.
+ * @return Total packet size in bytes, 0 if no entries available, or -1 on error.
+ */
+int btelem_drain_iov(struct btelem_ctx *ctx, int client_id,
+                     struct btelem_drain_iov *d, void *buf, size_t buf_size);
+
+/**
+ * Check, just before sending a btelem_drain_iov() packet in place, that no
+ * referenced slot has since come within capacity/4 of being overwritten.
+ * If any has, copy the packet out with btelem_drain_iov_settle(d, 0, ...)
+ * and send the copy instead.
+ *
+ * @return 0 if the packet can be sent from the ring, otherwise the number
+ *         of referenced entries too close to being overwritten.  -1 on error.
+ */
+int btelem_drain_iov_validate(struct btelem_ctx *ctx,
+                              const struct btelem_drain_iov *d);
+
+/**
+ * Finish with a packet from btelem_drain_iov() once the transport has
+ * consumed every span.
+ *
+ * @return Number of referenced entries that may have been overwritten while
+ *         in flight (also added to the client's drop count), or -1 on error.
+ *         If non-zero, the bytes already sent for them are not trustworthy
+ *         and the transport should drop the connection.
+ */
+int btelem_drain_iov_release(struct btelem_ctx *ctx,
+                             const struct btelem_drain_iov *d);
+
+/**
+ * Copy the part of a btelem_drain_iov() packet the transport has not
+ * consumed yet (from byte `sent` on) into buf, and rewrite d as that one
+ * span with no ring references.  Call before the transport waits for
+ * room, so ring slots are only read while they are known to be current.
+ *
+ * @param buf  Scratch of at least d->total - sent bytes, not overlapping
+ *             any span (the btelem_drain_iov() buf holds some of them).
+ * @return 0 if the copy is faithful; otherwise the number of unsent
+ *         referenced entries that were overwritten before the copy, whose
+ *         bytes must not be sent (also added to the client's drop count).
+ *         -1 on error or if buf is too small.
+ */
+int btelem_drain_iov_settle(struct btelem_ctx *ctx, struct btelem_drain_iov *d,
+                            size_t sent, void *buf, size_t buf_size);
+
+/* --------------------------------------------------------------------------
+ * Lossless clients (spill)
+ *
+ * A client with a spill buffer attached does not lose entries when it falls
+ * behind.  A spill thread calls btelem_spill_pump() regularly; it copies the
+ * client's unread slots that are within half a ring of being overwritten
+ * into the spill (a large secondary buffer, e.g. an mmap()ed file), and the
+ * client's drains read from the spill first, then the ring.  Producers are
+ * untouched.  Entries are still dropped if the spill fills up or the pump
+ * falls half a ring behind.
+ *
+ * BTELEM_RING_FIXED contexts only.  btelem_drain_iov() on a lossless client
+ * copies like btelem_drain_packed().
+ * ----------------------------------------------------------------------- */
+
+struct btelem_spill {
+    struct btelem_entry *entries;   /* entry_count slots (power of 2) */
+    uint64_t            mask;       /* entry_count - 1 */
+    btelem_atomic_u64   hi;         /* ring positions below hi are copied (pump) */
+    btelem_atomic_u64   lo;         /* ring positions below lo are consumed (drain) */
+    btelem_atomic_u64   spilled;    /* entries copied so far (pump) */
+    btelem_atomic_u64   peak;       /* most entries held at once (pump) */
+};
+
+/**
+ * Bytes of spill storage for `entry_count` entries.
+ */
+static inline size_t btelem_spill_size(uint64_t entry_count)
+{
+    return (size_t)entry_count * sizeof(struct btelem_entry);
+}
+
+/**
+ * Initialise a spill over `buf` (btelem_spill_size(entry_count) bytes).
+ * @return 0 on success, -1 if entry_count is not a power of 2.
+ */
+int btelem_spill_init(struct btelem_spill *sp, void *buf, uint64_t entry_count);
+
+/**
+ * Make a client lossless by attaching `sp`, or detach with NULL.  Call
+ * while the client is not being drained or pumped.  `sp` must stay valid
+ * until it is detached or the client is closed.
+ * @return 0 on success, -1 on error (including non-fixed rings).
+ */
+int btelem_client_set_spill(struct btelem_ctx *ctx, int client_id,
+                            struct btelem_spill *sp);
+
+/**
+ * Copy a lossless client's at-risk ring slots into its spill.  Call from
+ * one thread (the spill thread) at least every half ring's worth of
+ * logging; it may run concurrently with drains of the same client.
+ * @return Entries copied, or -1 if the client has no spill.
+ */
+int btelem_spill_pump(struct btelem_ctx *ctx, int client_id);
+
+/* --------------------------------------------------------------------------
+ * Health metrics
+ *
+ * Counters are kept per client and updated only on the drain side (the
+ * producer path is untouched).  Lag is in ring positions: entries for
+ * fixed and sharded rings, BTELEM_VAR_UNIT units for BTELEM_RING_VAR.
+ * ----------------------------------------------------------------------- */
+
+struct btelem_client_stats {
+    int      active;
+    uint64_t lag;               /* head - cursor now (summed over shards) */
+    uint64_t lag_max;           /* high-water lag seen at drain start */
+    uint64_t dropped;           /* cumulative entries lost to overwrite */
+    uint64_t torn;              /* of which skipped after a torn read */
+    uint64_t emitted;           /* entries handed out */
+    uint64_t packets;           /* packets built */
+    uint64_t drain_ns;          /* time spent building them (0 without a
+                                 * monotonic clock) */
+};
+
+struct btelem_stats {
+    uint64_t t_ns;              /* monotonic time of this snapshot */
+    uint64_t head;              /* ring head (summed over shards) */
+    uint64_t head_rate;         /* positions/s since the previous snapshot */
+    uint64_t capacity;          /* ring capacity (summed over shards) */
+    uint64_t unbound;           /* sharded: entries discarded, no shard free */
+    struct btelem_client_stats clients[BTELEM_MAX_CLIENTS];
+};
+
+/**
+ * Take a snapshot of ring and client health.
+ *
+ * `st` is read before it is overwritten: pass the previous snapshot (or a
+ * zeroed struct the first time) and head_rate is computed against it.
+ * Safe to call from any thread; counters of a client being drained
+ * concurrently may be a drain behind.
+ * @return 0 on success, -1 on error.
+ */
+int btelem_stats(struct btelem_ctx *ctx, struct btelem_stats *st);
+
+/**
+ * Copy a client's per-schema-ID entry counts (index = schema ID) into
+ * counts[0..max).  Counts wrap at 2^32.
+ * Only counted when built with BTELEM_STATS_IDS=1 (off by default: it
+ * adds 4 bytes per schema ID to every client).
+ * @return Number of IDs copied, or -1 on error or when built without
+ *         BTELEM_STATS_IDS.
+ */
+int btelem_stats_id_counts(struct btelem_ctx *ctx, int client_id,
+                           uint32_t *counts, int max);
+
+/*
+ * Built-in "btelem_stats" schema entry, so the pipeline's own health can be
+ * plotted next to the telemetry it carries.  Reserves the last schema ID.
+ * Per-client arrays cover the first BTELEM_STATS_CLIENTS clients.
+ */
+#define BTELEM_STATS_ID      (BTELEM_MAX_SCHEMA_ENTRIES - 1)
+#define BTELEM_STATS_CLIENTS (BTELEM_MAX_CLIENTS < 8 ? BTELEM_MAX_CLIENTS : 8)
+
+struct btelem_stats_entry {
+    uint64_t head;
+    uint64_t head_rate;
+    uint64_t dropped[BTELEM_STATS_CLIENTS];
+    uint32_t lag[BTELEM_STATS_CLIENTS];
+    uint32_t lag_max[BTELEM_STATS_CLIENTS];
+    uint32_t torn[BTELEM_STATS_CLIENTS];
+    uint32_t drain_ns[BTELEM_STATS_CLIENTS]; /* mean per packet since the
+                                              * previous entry */
+    uint32_t active;                         /* bit i: client i open */
+};
+
+/**
+ * Register the built-in stats schema at BTELEM_STATS_ID.  On a sharded
+ * context this also reserves a shard for btelem_stats_publish(), so the
+ * publishing thread never takes a producer's shard; size shard_count for
+ * one more than the producers.
+ * @return 0 on success, -1 if that ID already holds another schema or no
+ *         shard is free.
+ */
+int btelem_stats_register(struct btelem_ctx *ctx);
+
+/**
+ * Snapshot like btelem_stats(ctx, prev) and log the result as one
+ * btelem_stats entry.  Keep `prev` between calls; call from one thread.
+ * @return 0 on success, -1 if the stats schema is not registered.
+ */
+int btelem_stats_publish(struct btelem_ctx *ctx, struct btelem_stats *prev);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,37 +14,103 @@
 
 #define btelem_atomic_u64           _Atomic uint64_t
 #define btelem_atomic_load_acq(p)   atomic_load_explicit((p), memory_order_acquire)
+#define btelem_atomic_load_relaxed(p) atomic_load_explicit((p), memory_order_relaxed)
 #define btelem_atomic_store_rel(p, v) atomic_store_explicit((p), (v), memory_order_release)
 #define btelem_atomic_fetch_add_relaxed(p, v) atomic_fetch_add_explicit((p), (v), memory_order_relaxed)
+#define btelem_atomic_exchange(p, v) atomic_exchange_explicit((p), (v), memory_order_acq_rel)
+#define btelem_atomic_cas(p, expp, v) \
+    atomic_compare_exchange_weak_explicit((p), (expp), (v), memory_order_acq_rel, memory_order_acquire)
+#define btelem_atomic_fence_acq()   atomic_thread_fence(memory_order_acquire)
+#define btelem_atomic_fence_rel()   atomic_thread_fence(memory_order_release)
+#define btelem_atomic_fence_seq_cst() atomic_thread_fence(memory_order_seq_cst)
 
 #elif defined(__GNUC__) || defined(__clang__)
 
 typedef volatile uint64_t btelem_atomic_u64;
 #define btelem_atomic_load_acq(p)   __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define btelem_atomic_load_relaxed(p) __atomic_load_n((p), __ATOMIC_RELAXED)
 #define btelem_atomic_store_rel(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
 #define btelem_atomic_fetch_add_relaxed(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define btelem_atomic_exchange(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define btelem_atomic_cas(p, expp, v) \
+    __atomic_compare_exchange_n((p), (expp), (v), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define btelem_atomic_fence_acq()   __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define btelem_atomic_fence_rel()   __atomic_thread_fence(__ATOMIC_RELEASE)
+#define btelem_atomic_fence_seq_cst() __atomic_thread_fence(__ATOMIC_SEQ_CST)
 
 #else
 #error "btelem requires C11 atomics or GCC/Clang __atomic builtins"
 #endif
 
+/* --------------------------------------------------------------------------
+ * Thread-local storage (per-thread shard binding)
+ * ----------------------------------------------------------------------- */
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define BTELEM_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__) || defined(__clang__)
+#define BTELEM_THREAD_LOCAL __thread
+#else
+#error "btelem requires C11 _Thread_local or GCC/Clang __thread"
+#endif
+
 /* --------------------------------------------------------------------------
  * Timestamp
  *
  * Override BTELEM_TIMESTAMP() to provide your own.  Must return uint64_t.
  * Default: clock_gettime(CLOCK_MONOTONIC) on Linux/POSIX, 0 otherwise.
+ *
+ * Define BTELEM_TIMESTAMP_TSC to log raw cycle-counter ticks instead (rdtsc
+ * on x86-64, cntvct_el0 on AArch64).  btelem_init() then calibrates the
+ * counter against CLOCK_MONOTONIC and the schema carries the calibration so
+ * decoders can convert back to nanoseconds.  A custom BTELEM_TIMESTAMP() that
+ * returns ticks should also define BTELEM_TIMESTAMP_TICKS and fill
+ * ctx->clock itself (or call btelem_clock_calibrate()).
  * ----------------------------------------------------------------------- */
 
-#ifndef BTELEM_TIMESTAMP
-
 #if defined(__linux__) || defined(__unix__) || defined(__APPLE__)
 #include <time.h>
-static inline uint64_t btelem_timestamp(void)
+#define BTELEM_HAVE_MONOTONIC 1
+static inline uint64_t btelem_monotonic_ns(void)
 {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
+#endif
+
+#if defined(BTELEM_TIMESTAMP_TSC) && !defined(BTELEM_TIMESTAMP)
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t btelem_timestamp(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t btelem_timestamp(void)
+{
+    uint64_t t;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+}
+#else
+#error "BTELEM_TIMESTAMP_TSC: no cycle counter known for this architecture"
+#endif
+
+#define BTELEM_TIMESTAMP() btelem_timestamp()
+#define BTELEM_TIMESTAMP_TICKS 1
+
+#endif /* BTELEM_TIMESTAMP_TSC */
+
+#ifndef BTELEM_TIMESTAMP
+
+#if defined(BTELEM_HAVE_MONOTONIC)
+static inline uint64_t btelem_timestamp(void)
+{
+    return btelem_monotonic_ns();
+}
 #define BTELEM_TIMESTAMP() btelem_timestamp()
 #else
 /* Bare-metal: user must define BTELEM_TIMESTAMP() */
@@ -0,0 +1,160 @@
+#ifndef BTELEM_RECORD_H
+#define BTELEM_RECORD_H
+
+#include "btelem.h"
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * On-target recorder: writes .btlm files straight from the ring.
+ *
+ * A drain thread fills one of two page-aligned buffers with
+ * btelem_drain_packed() packets while a writer thread write()s the other,
+ * so the drain never waits on the disk unless the disk falls a whole
+ * buffer behind (counted in `stalls`; the ring absorbs the wait and any
+ * overrun shows up as `dropped`).
+ *
+ * Files match python/btelem/storage.py: header, compact schema, packets,
+ * then the per-packet ID summary and btelem_index_entry table with their
+ * footers (see "File index" in btelem_types.h).  When
+ * timestamps are ticks the schema's clock record is refreshed on close,
+ * as LogWriter does.  A file cut short by a crash has no footer; readers
+ * fall back to scanning it.
+ *
+ * With rotation enabled, files are named by inserting the file number
+ * before the extension: "run.btlm" becomes "run.0.btlm", "run.1.btlm", ...
+ *
+ * Lossless recording (spill_entries != 0, BTELEM_RING_FIXED contexts): a
+ * third thread pumps the recorder client's at-risk slots into a spill of
+ * spill_entries entries (btelem_spill_pump), so a disk stall longer than
+ * the ring covers costs spill space instead of entries.  The spill is an
+ * mmap() of a file created (and immediately unlinked) at spill_path, or
+ * anonymous memory without one; the file only chooses what backs it.
+ *
+ * Flight recording (trigger != 0): nothing is drained or written until
+ * btelem_trigger().  Each trigger then opens a client at the ring's oldest
+ * entry and writes the packets overlapping its window to a file of its
+ * own, numbered as with rotation ("run.0.btlm", "run.1.btlm", ...).  The
+ * window's edges are rounded out to whole packets.  A trigger that fires
+ * while a window is open extends it.  The recorder holds no client slot
+ * between windows, so a slot must be free when a trigger fires.
+ */
+
+/* Default size of each of the two write buffers */
+#ifndef BTELEM_RECORD_BUF
+#define BTELEM_RECORD_BUF (4u << 20)
+#endif
+/* Largest packet drained at once (one index entry each) */
+#ifndef BTELEM_RECORD_PKT
+#define BTELEM_RECORD_PKT 65536
+#endif
+/* Default longest wait before a partly filled buffer is written */
+#ifndef BTELEM_RECORD_FLUSH_MS
+#define BTELEM_RECORD_FLUSH_MS 250
+#endif
+/* Spill thread poll interval; the ring must hold twice this much logging */
+#ifndef BTELEM_RECORD_SPILL_US
+#define BTELEM_RECORD_SPILL_US 1000
+#endif
+
+/**
+ * Recorder options; all-zero gives one unrotated file and the defaults.
+ */
+struct btelem_record_opts {
+    uint64_t max_file_bytes;    /* start a new file before exceeding this (0 = never) */
+    uint32_t max_file_secs;     /* start a new file after this long (0 = never) */
+    uint32_t buf_bytes;         /* each write buffer (0 = BTELEM_RECORD_BUF);
+                                   raised to 2 * BTELEM_RECORD_PKT at least */
+    uint32_t flush_ms;          /* longest a partly filled buffer waits
+                                   (0 = BTELEM_RECORD_FLUSH_MS) */
+    int      compress;          /* store packets compressed when smaller */
+    uint32_t spill_entries;     /* lossless: spill size in entries, a power
+                                   of 2 (0 = off, overruns drop) */
+    const char *spill_path;     /* file backing the spill (NULL = memory);
+                                   only used by btelem_record_start */
+    int      trigger;           /* flight recorder: write only btelem_trigger()
+                                   windows, a file each; no spill */
+};
+
+struct btelem_record_stats {
+    uint64_t packets;           /* packets written */
+    uint64_t entries;           /* entries in them */
+    uint64_t bytes;             /* file bytes written, headers and indexes included */
+    uint64_t dropped;           /* entries lost to ring overwrite */
+    uint64_t files;             /* files completed or open */
+    uint64_t stalls;            /* buffer hand-offs that waited for the writer */
+    uint64_t write_errors;      /* failed opens/writes; the data is lost */
+    uint64_t spilled;           /* entries that went through the spill */
+    uint64_t spill_peak;        /* most entries held in the spill at once */
+    uint64_t snapshots;         /* trigger windows completed */
+};
+
+struct btelem_record_buf;       /* write buffer, private to btelem_record.c */
+struct btelem_record_file;      /* open output file, private */
+
+struct btelem_recorder {
+    struct btelem_ctx         *ctx;
+    int                        btelem_client_id;    /* -1 between trigger windows */
+    volatile int               running;
+    pthread_t                  drain_thread;
+    pthread_t                  writer_thread;
+    pthread_t                  spill_thread;
+
+    char                       path[256];
+    struct btelem_record_opts  opts;
+    uint8_t                   *schema;          /* compact schema blob */
+    uint32_t                   schema_len;
+
+    /* Hand-off: `full` is the buffer being written (NULL when the writer
+     * is idle); `done` is set once the drain thread has handed its last. */
+    pthread_mutex_t            lock;
+    pthread_cond_t             cond;
+    struct btelem_record_buf  *bufs[2];
+    struct btelem_record_buf  *full;
+    int                        done;
+
+    struct btelem_spill        spill;           /* lossless recording only */
+    void                      *spill_mem;
+    size_t                     spill_len;
+
+    uint64_t                   trigger_seen;    /* trigger thread only */
+
+    struct btelem_record_file *file;            /* writer thread only */
+    struct btelem_record_stats stats;           /* under lock */
+};
+
+/**
+ * Start recording ctx (schema registered) to `path`.
+ *
+ * @param rec   Caller-owned recorder (need not be zeroed).
+ * @param ctx   Initialised btelem context.
+ * @param path  Output file (see rotation naming above); the first file is
+ *              created before this returns, except when triggered.
+ * @param opts  Options, or NULL for the defaults.
+ * @return 0 on success, -1 on failure (no client slot, bad path, no memory,
+ *         spill setup failed, spill with trigger).
+ */
+int btelem_record_start(struct btelem_recorder *rec, struct btelem_ctx *ctx,
+                        const char *path, const struct btelem_record_opts *opts);
+
+/**
+ * Stop recording: drain what is left in the ring, write it, and close the
+ * file with its index.
+ */
+void btelem_record_stop(struct btelem_recorder *rec);
+
+/**
+ * Snapshot the counters; safe while recording.
+ */
+void btelem_record_get_stats(struct btelem_recorder *rec,
+                             struct btelem_record_stats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTELEM_RECORD_H */
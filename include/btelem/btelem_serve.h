@@ -9,14 +9,84 @@
 extern "C" {
 #endif
 
+#ifndef BTELEM_SERVE_MAX_CLIENTS
 #define BTELEM_SERVE_MAX_CLIENTS 16
+#endif
+
+/* Default (and initial) packet buffer per connection */
+#ifndef BTELEM_SERVE_PKT_BUF
+#define BTELEM_SERVE_PKT_BUF 65536
+#endif
+#define BTELEM_SERVE_MIN_PKT_BUF 1024
+
+/* Fan-out mode: shared packets in flight, and per-connection backlog */
+#ifndef BTELEM_SERVE_POOL_PKTS
+#define BTELEM_SERVE_POOL_PKTS 32
+#endif
+#ifndef BTELEM_SERVE_QUEUE_DEPTH
+#define BTELEM_SERVE_QUEUE_DEPTH 16
+#endif
+
+struct btelem_serve_pkt; /* pool packet, private to btelem_serve.c */
+
+/**
+ * Batching policy for btelem_serve() connections.  Set srv->batch before
+ * btelem_serve(); all-zero keeps the default of sending whatever is
+ * pending as soon as it is seen.
+ *
+ * A connection holds off while fewer than about `min_bytes` are pending
+ * (estimated from the mean entry size so far), until the oldest pending
+ * entry has waited `max_latency_us` or the ring is half full.  Packets
+ * start at BTELEM_SERVE_PKT_BUF bytes (or `max_pkt_bytes` if smaller);
+ * a connection that keeps filling them doubles its buffer up to
+ * `max_pkt_bytes`.
+ */
+struct btelem_serve_batch_opts {
+    uint32_t max_latency_us;    /* longest wait below the watermark */
+    uint32_t min_bytes;         /* send once this many bytes are pending */
+    uint32_t max_pkt_bytes;     /* packet size ceiling (default BTELEM_SERVE_PKT_BUF);
+                                   PacketDecoder rejects > 1 MiB by default */
+};
+
+/* Why a connection sent a packet */
+enum btelem_serve_flush {
+    BTELEM_SERVE_FLUSH_SIZE = 0,    /* min_bytes reached (or no watermark) */
+    BTELEM_SERVE_FLUSH_DEADLINE,    /* max_latency_us expired */
+    BTELEM_SERVE_FLUSH_PRESSURE,    /* ring half full */
+    BTELEM_SERVE_FLUSH_FULL,        /* previous packet was full, more pending */
+    BTELEM_SERVE_FLUSH_COUNT
+};
+
+struct btelem_serve_client_stats {
+    uint64_t packets;
+    uint64_t entries;
+    uint64_t bytes;                 /* including length prefixes */
+    uint64_t dropped;               /* sum of sent packets' dropped fields */
+    uint64_t flush[BTELEM_SERVE_FLUSH_COUNT];
+    uint32_t pkt_buf_size;          /* current packet buffer */
+    double   packets_per_sec;       /* over the last 2 s status interval */
+    double   mean_entries_per_packet;
+};
 
 struct btelem_client_conn {
     int                  fd;
-    int                  btelem_client_id;
+    int                  btelem_client_id;  /* -1 in fan-out mode */
     struct btelem_server *server;
     pthread_t            thread;
     int                  active;
+
+    /* Fan-out mode only; guarded by server->clients_mu.  Per-client
+     * connections filter through their btelem client instead. */
+    int                  subscribed;        /* schema sent, packets queued */
+    uint16_t             queue[BTELEM_SERVE_QUEUE_DEPTH]; /* pool indices */
+    uint32_t             q_head;
+    uint32_t             q_count;
+    uint64_t             dropped_pending;   /* lost to queue overflow, reported next */
+    pthread_cond_t       cond;
+    int                  filter_active;
+    uint8_t              filter[BTELEM_MAX_SCHEMA_ENTRIES];
+
+    struct btelem_serve_client_stats stats;  /* guarded by server->clients_mu */
 };
 
 struct btelem_server {
@@ -27,6 +97,15 @@ struct btelem_server {
 
     pthread_mutex_t           clients_mu;
     struct btelem_client_conn clients[BTELEM_SERVE_MAX_CLIENTS];
+    struct btelem_stats       health;  /* last btelem_stats_publish() snapshot */
+
+    struct btelem_serve_batch_opts batch;   /* set by the caller before btelem_serve() */
+
+    /* Fan-out mode */
+    int                       fanout;
+    int                       drain_client_id;
+    pthread_t                 drain_thread;
+    struct btelem_serve_pkt   *pool;
 };
 
 /**
@@ -36,8 +115,16 @@ struct btelem_server {
  * until btelem_server_stop() returns.
  *
  * Spawns an accept thread; each connection gets its own thread that
- * streams the schema (using btelem_schema_stream, no large buffer
- * required) then runs a drain-and-send loop.
+ * sends the schema then runs a drain-and-send loop.  A viewer that opens
+ * with BTELEM_CTRL_HELLO gets the compact schema, or only its hash if the
+ * viewer already has it, provided the HELLO is queued when the connection
+ * thread starts (send it right after connecting).  Others get the
+ * fixed-size schema (streamed with btelem_schema_stream) straight away.
+ *
+ * Viewers may send BTELEM_CTRL_* messages (see btelem_types.h) to
+ * subscribe to a subset of IDs, each optionally capped to one entry per
+ * min_interval_us.  The ID set becomes the connection's btelem client
+ * filter; decimated packets are compacted before they are sent.
  *
  * @param srv   Caller-owned server struct (zeroed before first use).
  * @param ctx   Initialised btelem context (with schema registered).
@@ -48,6 +135,53 @@ struct btelem_server {
 int btelem_serve(struct btelem_server *srv, struct btelem_ctx *ctx,
                  const char *ip, uint16_t port);
 
+/**
+ * Start a TCP trace server that drains the ring once for all viewers.
+ *
+ * A single drain thread owns one btelem client and builds each packet
+ * once into a pool of BTELEM_SERVE_POOL_PKTS refcounted buffers; each
+ * connection thread sends referenced packets from its own queue.  Viewers
+ * therefore no longer consume BTELEM_MAX_CLIENTS slots, only
+ * BTELEM_SERVE_MAX_CLIENTS connection slots.
+ *
+ * A viewer whose queue is full (or holds the oldest packet when the pool
+ * runs dry) loses that packet; the lost entries are added to the
+ * `dropped` field of the next packet it is sent.  Subscribed IDs count
+ * towards that even when decimation would have skipped them.
+ *
+ * BTELEM_CTRL_* subscriptions work as in btelem_serve(), applied per
+ * viewer as it sends.
+ *
+ * Same parameters and return value as btelem_serve().
+ */
+int btelem_serve_fanout(struct btelem_server *srv, struct btelem_ctx *ctx,
+                        const char *ip, uint16_t port);
+
+/**
+ * Restrict which schema IDs a fan-out connection receives, as a
+ * BTELEM_CTRL_SUBSCRIBE from the viewer would (and replaced by the next
+ * one it sends).
+ *
+ * Applied per packet: the viewer is sent a copy holding only the accepted
+ * entries, with payloads repacked.
+ *
+ * @param slot   Index into srv->clients.
+ * @param ids    Accepted schema IDs, or NULL to accept all.
+ * @param count  Number of IDs (0 = accept all).
+ * @return 0 on success, -1 if not in fan-out mode or slot is not connected.
+ */
+int btelem_server_set_filter(struct btelem_server *srv, int slot,
+                             const uint16_t *ids, int count);
+
+/**
+ * Snapshot the counters of connection `slot` (index into srv->clients).
+ * Fan-out connections fill packets, entries, bytes and dropped only.
+ *
+ * @return 0 on success, -1 if the slot is not connected.
+ */
+int btelem_server_client_stats(struct btelem_server *srv, int slot,
+                               struct btelem_serve_client_stats *out);
+
 /**
  * Stop the server: close all sockets, join all threads.
  * The caller still owns the struct after this call.
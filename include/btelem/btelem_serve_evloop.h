@@ -0,0 +1,94 @@
+#ifndef BTELEM_SERVE_EVLOOP_H
+#define BTELEM_SERVE_EVLOOP_H
+
+#include "btelem.h"
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Event-driven TCP trace server (Linux, epoll).
+ *
+ * Speaks the btelem_serve() protocol: the schema as soon as a viewer
+ * connects (the compact HELLO reply if its HELLO is already queued, else
+ * the fixed-size schema), then length-prefixed packed batches.  One
+ * thread owns one btelem client, the listening socket and every viewer
+ * socket:
+ *
+ *   - the ring is drained once per packet; viewers queue references to
+ *     shared refcounted packets (as in btelem_serve_fanout())
+ *   - sockets are non-blocking and flushed when epoll reports them
+ *     writable, so a stalled viewer never blocks the others
+ *   - when the ring runs dry the thread arms btelem_wake_arm() and sleeps
+ *     on an eventfd that the producer signals once `wake_threshold`
+ *     entries are pending; a timerfd bounds latency to `max_latency_us`
+ *     below the threshold.
+ *
+ * A viewer whose queue is full loses its oldest queued packet; the lost
+ * entries are added to the `dropped` field of the next packet it is sent.
+ *
+ * Viewer control messages (SUBSCRIBE/UNSUBSCRIBE/RESET, COMPRESS) are
+ * applied per viewer: a viewer with a filter, a rate limit or compression
+ * gets its own compacted (and compressed) copy of each packet, the rest
+ * share them.
+ */
+
+#ifndef BTELEM_EVLOOP_MAX_CONNS
+#define BTELEM_EVLOOP_MAX_CONNS 1024
+#endif
+
+struct btelem_evloop_opts {
+    uint32_t wake_threshold;    /* pending entries that wake the loop (default 1) */
+    uint32_t max_latency_us;    /* flush bound below the threshold (default 1000) */
+    uint32_t max_conns;         /* viewer limit (default BTELEM_EVLOOP_MAX_CONNS) */
+};
+
+struct btelem_evloop_conn;  /* private to btelem_serve_evloop.c */
+struct btelem_evloop_pkt;
+
+struct btelem_evloop_server {
+    struct btelem_ctx          *ctx;
+    struct btelem_evloop_opts   opts;
+    int                         listen_fd;
+    int                         epoll_fd;
+    int                         event_fd;
+    int                         timer_fd;
+    int                         btelem_client_id;
+    volatile int                running;
+    pthread_t                   thread;
+
+    /* Owned by the loop thread */
+    struct btelem_evloop_conn **conns;
+    uint32_t                    conn_count;
+    struct btelem_evloop_pkt   *free_pkts;
+    uint32_t                    live_pkts;
+};
+
+/**
+ * Start the event-loop server.  The caller owns `srv` (zeroed before
+ * first use) until btelem_evloop_server_stop() returns.
+ *
+ * The server installs the context's wake callback (btelem_wake_set), so
+ * only one evloop server may serve a context at a time.
+ *
+ * @param opts  NULL for defaults; zero fields also take their default.
+ * @return 0 on success, -1 on failure.
+ */
+int btelem_serve_evloop(struct btelem_evloop_server *srv, struct btelem_ctx *ctx,
+                        const char *ip, uint16_t port,
+                        const struct btelem_evloop_opts *opts);
+
+/**
+ * Stop the server: wake and join the loop thread, close all sockets,
+ * release the packet pool.
+ */
+void btelem_evloop_server_stop(struct btelem_evloop_server *srv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTELEM_SERVE_EVLOOP_H */
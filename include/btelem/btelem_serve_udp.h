@@ -17,12 +17,38 @@ extern "C" {
  *
  * Field naming uses dot-separated paths for PlotJuggler's tree view:
  *   "entry_name.field_name"            — scalar fields
- *   "entry_name.field_name_N"          — array elements (0-indexed)
+ *   "entry_name.field_name.N"          — array elements (0-indexed)
  *   "entry_name.field_name.bit_name"   — bitfield sub-fields
  *
- * Timestamp is emitted as "timestamp" in seconds (float64).
+ * Timestamp is emitted as "timestamp" in seconds, with all nine
+ * fractional digits.  Floats carry 8 significant digits; NaN and
+ * infinities are sent as null.  Keys are rendered once per schema ID at
+ * start-up, so the per-entry cost is copying keys and formatting numbers.
+ *
+ * btelem_serve_udp_binary() instead sends btelem_drain_packed() batches
+ * split into datagrams of at most `max_datagram` bytes, several per
+ * sendmmsg() call.  Every datagram is a self-contained packet:
+ *
+ *   - `_reserved` in the packet header carries a per-server sequence
+ *     number, incremented by one per datagram, so receivers can count loss
+ *   - the header's `dropped` is ring overwrites, as over TCP
+ *   - the compact schema is resent every BTELEM_UDP_SCHEMA_INTERVAL_MS as
+ *     BTELEM_PACKET_FLAG_SCHEMA fragments for receivers that join late,
+ *     followed by a clock packet when timestamps are ticks.
  */
 
+/* Default binary datagram size: Ethernet MTU less IPv4 and UDP headers */
+#ifndef BTELEM_UDP_DEFAULT_DATAGRAM
+#define BTELEM_UDP_DEFAULT_DATAGRAM 1472
+#endif
+/* Smallest datagram that still fits one worst-case entry */
+#define BTELEM_UDP_MIN_DATAGRAM \
+    (sizeof(struct btelem_packet_header) + sizeof(struct btelem_entry_header) \
+   + BTELEM_MAX_PAYLOAD)
+#ifndef BTELEM_UDP_SCHEMA_INTERVAL_MS
+#define BTELEM_UDP_SCHEMA_INTERVAL_MS 1000
+#endif
+
 struct btelem_udp_server {
     struct btelem_ctx  *ctx;
     int                 sock_fd;
@@ -33,6 +59,10 @@ struct btelem_udp_server {
     /* Destination address */
     char                dest_ip[64];
     uint16_t            dest_port;
+
+    int                 binary;
+    uint32_t            max_datagram;   /* 0 (JSON): one object per datagram */
+    uint32_t            seq;            /* next datagram sequence number */
 };
 
 /**
@@ -50,6 +80,32 @@ struct btelem_udp_server {
 int btelem_serve_udp(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
                      const char *dest_ip, uint16_t dest_port);
 
+/**
+ * As btelem_serve_udp(), but with several newline-separated JSON objects
+ * per datagram, up to `max_datagram` bytes.  An object larger than the
+ * limit is sent on its own.
+ *
+ * @param max_datagram  Coalescing limit in bytes (at most 65507); 0 sends
+ *                      one object per datagram, as btelem_serve_udp().
+ * @return 0 on success, -1 on failure.
+ */
+int btelem_serve_udp_json(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                          const char *dest_ip, uint16_t dest_port,
+                          uint32_t max_datagram);
+
+/**
+ * Start a binary UDP server: packed batches instead of JSON (see above).
+ * Decode with btelem.transport.UDPPacketReceiver or the viewer's UdpSource.
+ *
+ * @param max_datagram  Datagram size limit in bytes; 0 for
+ *                      BTELEM_UDP_DEFAULT_DATAGRAM.  Values below
+ *                      BTELEM_UDP_MIN_DATAGRAM are raised to it.
+ * @return 0 on success, -1 on failure.
+ */
+int btelem_serve_udp_binary(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                            const char *dest_ip, uint16_t dest_port,
+                            uint32_t max_datagram);
+
 /**
  * Stop the UDP server: close socket, join drain thread.
  */
@@ -0,0 +1,119 @@
+#ifndef BTELEM_SHM_H
+#define BTELEM_SHM_H
+
+#include "btelem.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared-memory ring (POSIX shm_open): zero-copy out-of-process consumers.
+ *
+ * btelem_init_shm() places the ring and the client table in a named
+ * segment; another process btelem_attach_shm()es to it, opens a client and
+ * calls btelem_drain_packed() (or btelem_drain) on the shared ring as if it
+ * were its own.  Producers log exactly as with btelem_init().  Client slots
+ * are claimed atomically across processes; a slot whose owner died is
+ * reclaimed by the next btelem_attach_shm().
+ *
+ * The segment outlives the producer, so a crashed process's last
+ * capacity entries can still be attached to and drained.  It is removed by
+ * btelem_shm_unlink(); btelem_init_shm() refuses to reuse the name until
+ * then.
+ *
+ * Layout (offsets in the header; ring page-aligned):
+ *
+ *   btelem_shm_header | clients[BTELEM_MAX_CLIENTS] | schema | btelem_ring
+ *
+ * Producer and consumers must be built with the same btelem configuration;
+ * attach checks the magic, version and the struct sizes it depends on.
+ * Fixed-layout rings only.  btelem_wake_* and spills are per-process and
+ * not available to attached consumers; the `spill` field of every client
+ * in the shared table stays NULL.
+ */
+
+#define BTELEM_SHM_MAGIC   0x4D535442  /* "BTSM" little-endian */
+#define BTELEM_SHM_VERSION 1
+
+/* Bytes reserved for the compact schema (btelem_shm_publish_schema) */
+#ifndef BTELEM_SHM_SCHEMA_MAX
+#define BTELEM_SHM_SCHEMA_MAX (64u << 10)
+#endif
+
+_Static_assert(BTELEM_MAX_CLIENTS <= 64,
+               "btelem_shm claims client slots in a 64-bit mask");
+
+struct btelem_shm_header {
+    uint32_t          magic;            /* BTELEM_SHM_MAGIC, written last */
+    uint32_t          version;          /* BTELEM_SHM_VERSION */
+    uint32_t          header_size;      /* sizeof(struct btelem_shm_header) */
+    uint32_t          entry_size;       /* sizeof(struct btelem_entry) */
+    uint32_t          client_size;      /* sizeof(struct btelem_client) */
+    uint32_t          max_clients;      /* BTELEM_MAX_CLIENTS */
+    uint32_t          capacity;         /* ring slots */
+    uint32_t          producer_pid;     /* process that created the segment */
+    uint64_t          size;             /* whole segment, bytes */
+    uint64_t          clients_offset;
+    uint64_t          schema_offset;
+    uint64_t          ring_offset;
+    uint32_t          schema_max;       /* BTELEM_SHM_SCHEMA_MAX */
+    uint32_t          schema_len;       /* published compact schema bytes */
+    btelem_atomic_u64 schema_seq;       /* 0 = none, odd = being rewritten */
+    btelem_atomic_u64 client_claim;     /* bit i: client slot i taken */
+};
+
+/**
+ * Create the segment `name` ("/btelem-app") with an entry_count-slot ring
+ * (power of 2) and initialise ctx on it, like btelem_init().  An existing
+ * segment of that name is left alone: extract from it if wanted, then
+ * btelem_shm_unlink() it and retry.
+ * @return 0 on success, -1 on failure (errno EEXIST if the name is taken).
+ */
+int btelem_init_shm(struct btelem_ctx *ctx, const char *name, uint32_t entry_count);
+
+/**
+ * Copy the compact schema of the registered entries into the segment for
+ * consumers (btelem_shm_schema).  Call after btelem_register(); again after
+ * registering more.
+ * @return 0 on success, -1 on error or if it exceeds BTELEM_SHM_SCHEMA_MAX.
+ */
+int btelem_shm_publish_schema(struct btelem_ctx *ctx);
+
+/**
+ * Map an existing segment into a consumer ctx.  The ctx has no schema
+ * registry of its own: open a client and drain as usual, and decode with
+ * the schema from btelem_shm_schema().  Clients left open by dead
+ * processes are closed.
+ * @return 0 on success, -1 if the segment is missing or was created with a
+ *         different version or configuration.
+ */
+int btelem_attach_shm(struct btelem_ctx *ctx, const char *name);
+
+/**
+ * Copy the compact schema published by the producer into buf (as
+ * btelem_schema_serialize_compact() would have produced it).  Pass
+ * buf = NULL to get the size.
+ * @return Schema size, 0 if none is published yet, -1 on error or if
+ *         buf_size is too small.
+ */
+int btelem_shm_schema(const struct btelem_ctx *ctx, void *buf, size_t buf_size);
+
+/**
+ * Unmap a segment set up by btelem_init_shm() or btelem_attach_shm().
+ * Close this process's clients first; the segment itself stays.
+ */
+void btelem_shm_detach(struct btelem_ctx *ctx);
+
+/**
+ * Remove the segment name; mappings stay valid until detached.
+ * @return 0 on success, -1 on failure.
+ */
+int btelem_shm_unlink(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTELEM_SHM_H */
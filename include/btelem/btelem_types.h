@@ -32,6 +32,26 @@
 #define BTELEM_MAX_FIELDS 16
 #endif
 
+#ifndef BTELEM_MAX_SHARDS
+#define BTELEM_MAX_SHARDS 16    /* producer shards in BTELEM_RING_SHARDED mode (<= 64) */
+#endif
+
+#ifndef BTELEM_SHARD_BINDINGS
+#define BTELEM_SHARD_BINDINGS 4 /* sharded contexts one thread stays bound to at once (>= 2) */
+#endif
+
+#ifndef BTELEM_MAX_SHARDED_CTXS
+#define BTELEM_MAX_SHARDED_CTXS 64 /* sharded contexts initialised at once, process-wide */
+#endif
+
+#ifndef BTELEM_DRAIN_IOV_MAX
+#define BTELEM_DRAIN_IOV_MAX 256 /* spans per btelem_drain_iov() packet (<= IOV_MAX) */
+#endif
+
+#ifndef BTELEM_STATS_IDS
+#define BTELEM_STATS_IDS 0      /* 1 = per-client entry counts by schema ID (4 B per ID per client) */
+#endif
+
 /* --------------------------------------------------------------------------
  * Field type enum
  * ----------------------------------------------------------------------- */
@@ -72,6 +92,41 @@ struct btelem_entry {
 
 #define BTELEM_ENTRY_SIZE (sizeof(struct btelem_entry))
 
+/* --------------------------------------------------------------------------
+ * Variable-length ring records (BTELEM_RING_VAR, see btelem_init_var)
+ *
+ * The ring is an array of BTELEM_VAR_UNIT-byte units.  A record occupies
+ * ceil((24 + payload_size) / BTELEM_VAR_UNIT) consecutive units (modulo the
+ * ring size): the header sits at the start of the first unit and the payload
+ * follows it contiguously, wrapping to unit 0 at the end of the ring.
+ *
+ * seq holds (absolute unit index + 1) once committed, as in fixed mode.
+ * ----------------------------------------------------------------------- */
+
+#ifndef BTELEM_VAR_UNIT
+#define BTELEM_VAR_UNIT 64      /* power of 2, >= 32; 64 = one cache line */
+#endif
+
+struct btelem_var_header {
+    uint64_t seq;               /* first unit index + 1 when committed */
+    uint64_t timestamp;
+    uint16_t id;
+    uint16_t payload_size;
+    uint16_t units;             /* units occupied (a batch may reserve extra) */
+    uint16_t _pad;
+};
+
+_Static_assert(sizeof(struct btelem_var_header) == 24, "btelem_var_header layout");
+_Static_assert(BTELEM_VAR_UNIT >= 32 && (BTELEM_VAR_UNIT & (BTELEM_VAR_UNIT - 1)) == 0,
+               "BTELEM_VAR_UNIT must be a power of 2 and at least 32");
+
+/* Units needed for a record carrying `payload_size` bytes */
+#define BTELEM_VAR_UNITS(payload_size) \
+    ((uint32_t)((sizeof(struct btelem_var_header) + (payload_size) \
+                 + BTELEM_VAR_UNIT - 1) / BTELEM_VAR_UNIT))
+
+#define BTELEM_VAR_MAX_UNITS BTELEM_VAR_UNITS(BTELEM_MAX_PAYLOAD)
+
 /* --------------------------------------------------------------------------
  * Enum definitions (for BTELEM_ENUM fields)
  * ----------------------------------------------------------------------- */
@@ -295,6 +350,28 @@ struct __attribute__((packed)) btelem_bitfield_wire {
 
 _Static_assert(sizeof(struct btelem_bitfield_wire) == 1093, "btelem_bitfield_wire packing");
 
+/* --------------------------------------------------------------------------
+ * Clock calibration wire format (optional, appended after bitfield section)
+ *
+ * Present only when entry timestamps are raw counter ticks rather than
+ * nanoseconds.  Decoders convert with
+ *   ns = ref_ns + (ticks - ref_ticks) * 1e9 / tick_hz
+ * The same record is the payload of a BTELEM_PACKET_FLAG_CLOCK packet,
+ * which refreshes the calibration mid-stream.
+ * ----------------------------------------------------------------------- */
+
+#define BTELEM_CLOCK_MAGIC 0x4B435442  /* "BTCK" little-endian */
+
+struct __attribute__((packed)) btelem_clock_wire {
+    uint32_t magic;                     /*  4  BTELEM_CLOCK_MAGIC */
+    uint32_t _reserved;                 /*  4 */
+    uint64_t tick_hz;                   /*  8  counter frequency */
+    uint64_t ref_ticks;                 /*  8  counter value at ref_ns */
+    uint64_t ref_ns;                    /*  8  CLOCK_MONOTONIC at ref_ticks */
+};
+
+_Static_assert(sizeof(struct btelem_clock_wire) == 32, "btelem_clock_wire packing");
+
 /** Worst-case serialized schema size (suitable for static allocation). */
 #define BTELEM_SCHEMA_BUF_SIZE \
     (sizeof(struct btelem_schema_header) \
@@ -302,7 +379,49 @@ _Static_assert(sizeof(struct btelem_bitfield_wire) == 1093, "btelem_bitfield_wir
    + sizeof(uint16_t) \
    + BTELEM_MAX_SCHEMA_ENTRIES * BTELEM_MAX_FIELDS * sizeof(struct btelem_enum_wire) \
    + sizeof(uint16_t) \
-   + BTELEM_MAX_SCHEMA_ENTRIES * BTELEM_MAX_FIELDS * sizeof(struct btelem_bitfield_wire))
+   + BTELEM_MAX_SCHEMA_ENTRIES * BTELEM_MAX_FIELDS * sizeof(struct btelem_bitfield_wire) \
+   + sizeof(struct btelem_clock_wire))
+
+/* --------------------------------------------------------------------------
+ * Compact schema format (version 1)
+ *
+ * Same content as the fixed-size format above, but strings are
+ * length-prefixed and only real fields, labels and bits are written:
+ *
+ *   btelem_schema_compact_header
+ *   entry × entry_count:
+ *     u16 id, u16 payload_size, u16 field_count, str name, str description,
+ *     field × min(field_count, BTELEM_MAX_FIELDS):
+ *       str name, u16 offset, u16 size, u8 type, u8 count
+ *   u16 enum_count, enum × enum_count:
+ *     u16 schema_id, u16 field_index, u8 label_count, str label × label_count
+ *   u16 bitfield_count, bitfield × bitfield_count:
+ *     u16 schema_id, u16 field_index, u8 bit_count,
+ *     (str name, u8 start, u8 width) × bit_count
+ *   [btelem_clock_wire]                      tick timestamps only
+ *
+ * str is a u8 byte count followed by that many bytes (no terminator),
+ * truncated to the fixed-format limits (BTELEM_NAME_MAX - 1, ...).
+ *
+ * `hash` is 64-bit FNV-1a over everything between the header and the
+ * clock record, so it identifies the schema but not the calibration.  The
+ * first byte distinguishes the formats: the fixed-size header starts with
+ * the endianness (0 or 1), this one with the magic.
+ * ----------------------------------------------------------------------- */
+
+#define BTELEM_SCHEMA_COMPACT_MAGIC   0x53435442  /* "BTCS" little-endian */
+#define BTELEM_SCHEMA_COMPACT_VERSION 1
+
+struct __attribute__((packed)) btelem_schema_compact_header {
+    uint32_t magic;                     /*  4  BTELEM_SCHEMA_COMPACT_MAGIC */
+    uint8_t  version;                   /*  1  BTELEM_SCHEMA_COMPACT_VERSION */
+    uint8_t  endianness;                /*  1 */
+    uint16_t entry_count;               /*  2 */
+    uint64_t hash;                      /*  8 */
+};
+
+_Static_assert(sizeof(struct btelem_schema_compact_header) == 16,
+               "btelem_schema_compact_header packing");
 
 /* --------------------------------------------------------------------------
  * Entry wire format (packed, for batch transport)
@@ -319,10 +438,10 @@ _Static_assert(sizeof(struct btelem_bitfield_wire) == 1093, "btelem_bitfield_wir
 
 struct __attribute__((packed)) btelem_packet_header {
     uint16_t entry_count;               /*  2  entries in this packet */
-    uint16_t flags;                     /*  2  (reserved) */
+    uint16_t flags;                     /*  2  BTELEM_PACKET_FLAG_* */
     uint32_t payload_size;              /*  4  total payload buffer bytes */
     uint32_t dropped;                   /*  4  entries dropped since last packet */
-    uint32_t _reserved;                 /*  4  (reserved) */
+    uint32_t _reserved;                 /*  4  datagram seq (UDP binary), else 0 */
 };
 
 struct __attribute__((packed)) btelem_entry_header {
@@ -332,9 +451,115 @@ struct __attribute__((packed)) btelem_entry_header {
     uint64_t timestamp;                 /*  8 */
 };
 
+/* Packet carries no entries; payload is one btelem_clock_wire */
+#define BTELEM_PACKET_FLAG_CLOCK 0x0001
+
+/* Packet carries no entries; payload is one btelem_schema_frag_wire
+ * followed by that fragment of the serialised schema (datagram transports,
+ * where the schema does not fit in one packet) */
+#define BTELEM_PACKET_FLAG_SCHEMA 0x0002
+
+/* Entry table and payload buffer are delta-coded (see below);
+ * payload_size counts the bytes after the packet header */
+#define BTELEM_PACKET_FLAG_COMPRESSED 0x0004
+
+struct __attribute__((packed)) btelem_schema_frag_wire {
+    uint32_t total_size;                /*  4  whole schema blob bytes */
+    uint32_t offset;                    /*  4  this fragment's offset in it */
+};
+
+_Static_assert(sizeof(struct btelem_schema_frag_wire) == 8, "btelem_schema_frag_wire packing");
+
 _Static_assert(sizeof(struct btelem_packet_header) == 16, "btelem_packet_header packing");
 _Static_assert(sizeof(struct btelem_entry_header)  == 16, "btelem_entry_header packing");
 
+/* --------------------------------------------------------------------------
+ * Compressed packets (BTELEM_PACKET_FLAG_COMPRESSED)
+ *
+ * The packet header is kept (entry_count unchanged); the entry table and
+ * payload buffer are replaced by one record per entry:
+ *
+ *   varint id
+ *   varint payload_size
+ *   varint zigzag(timestamp - previous entry's timestamp)   (first: - 0)
+ *   payload, XORed with the previous payload of the same id and size in
+ *   this packet (none, or id >= BTELEM_PACKET_DELTA_IDS: unchanged), as
+ *   runs covering payload_size bytes:
+ *     varint (zero_count << 4 | literal_count), literal bytes
+ *   with literal_count 0..15 (longer literals continue in further runs).
+ *
+ * Varints are LEB128 (7 bits per byte, least significant first).  Nothing
+ * carries over between packets, so each one decodes on its own.
+ * ----------------------------------------------------------------------- */
+
+/* Part of the format, independent of BTELEM_MAX_SCHEMA_ENTRIES */
+#define BTELEM_PACKET_DELTA_IDS 512
+
+/* --------------------------------------------------------------------------
+ * Viewer control messages (TCP, viewer → server)
+ *
+ * A viewer may write control messages on its connection at any time, each
+ * length-prefixed like the packets it receives:
+ *
+ *   [uint32 length][btelem_ctrl_header][btelem_ctrl_sub × count]
+ *
+ * A connection starts with every ID at full rate.  SUBSCRIBE adds IDs (or
+ * updates their interval) and, the first time, drops every ID not listed;
+ * UNSUBSCRIBE removes IDs; RESET returns to every ID at full rate.
+ *
+ * An ID with a non-zero min_interval_us is decimated by entry timestamp:
+ * an entry is sent only once that long has passed since the last one sent.
+ * Filtered and decimated entries are not counted in `dropped`.
+ *
+ * HELLO, sent before reading anything, opts in to the compact schema.  It
+ * carries the hash of the compact schema the viewer has cached (0 = none).
+ * The server then answers with a btelem_schema_hello in place of the
+ * fixed-size schema, and omits the schema itself if the hash is current.
+ * Viewers that stay silent get the fixed-size schema after a short wait.
+ *
+ * COMPRESS asks for BTELEM_PACKET_FLAG_COMPRESSED packets from then on
+ * (each packet only if it comes out smaller).  Servers that predate it
+ * ignore it, like any unknown type.
+ * ----------------------------------------------------------------------- */
+
+#define BTELEM_CTRL_SUBSCRIBE   1
+#define BTELEM_CTRL_UNSUBSCRIBE 2   /* min_interval_us ignored */
+#define BTELEM_CTRL_RESET       3   /* count = 0 */
+#define BTELEM_CTRL_HELLO       4   /* count = 0, then uint64 schema hash */
+#define BTELEM_CTRL_COMPRESS    5   /* count = 0 */
+
+struct __attribute__((packed)) btelem_ctrl_header {
+    uint16_t type;                      /*  2  BTELEM_CTRL_* */
+    uint16_t count;                     /*  2  btelem_ctrl_sub records */
+};
+
+struct __attribute__((packed)) btelem_ctrl_sub {
+    uint16_t id;                        /*  2 */
+    uint16_t _reserved;                 /*  2 */
+    uint32_t min_interval_us;           /*  4  0 = every entry */
+};
+
+_Static_assert(sizeof(struct btelem_ctrl_header) == 4, "btelem_ctrl_header packing");
+_Static_assert(sizeof(struct btelem_ctrl_sub)    == 8, "btelem_ctrl_sub packing");
+
+/* Server reply to HELLO: [uint32 length][btelem_schema_hello][compact
+ * schema, schema_size bytes].  schema_size = 0 means the viewer's cached
+ * copy matches `hash`; a clock packet follows when timestamps are ticks. */
+#define BTELEM_SCHEMA_HELLO_MAGIC 0x48535442  /* "BTSH" little-endian */
+
+struct __attribute__((packed)) btelem_schema_hello {
+    uint32_t magic;                     /*  4  BTELEM_SCHEMA_HELLO_MAGIC */
+    uint32_t schema_size;               /*  4  compact schema bytes that follow */
+    uint64_t hash;                      /*  8  compact schema hash */
+};
+
+_Static_assert(sizeof(struct btelem_schema_hello) == 16, "btelem_schema_hello packing");
+
+/* Largest valid control message (after the length prefix) */
+#define BTELEM_CTRL_MAX_SIZE \
+    (sizeof(struct btelem_ctrl_header) \
+   + BTELEM_MAX_SCHEMA_ENTRIES * sizeof(struct btelem_ctrl_sub))
+
 /* --------------------------------------------------------------------------
  * File index (footer, for fast seeking in .btlm files)
  *
@@ -342,8 +567,18 @@ _Static_assert(sizeof(struct btelem_entry_header)  == 16, "btelem_entry_header p
  * Reader seeks to EOF-16 to find the footer, then loads the index.
  *
  *   [packets...]
+ *   [uint32_t first_id × (N+1)]   optional ID summary (index v2): packet i's
+ *   [btelem_index_id × M]         records are first_id[i]..first_id[i+1]-1
+ *   [btelem_index_ids_footer]     16 bytes, ends right at the index
  *   [btelem_index_entry × N]      28 bytes each, fixed stride
  *   [btelem_index_footer]         16 bytes at EOF
+ *
+ * The ID summary lists, per packet, each schema ID present (ascending) with
+ * its entry count, so readers extracting one ID skip packets without it and
+ * size their output without touching the packets.  Its footer sits just
+ * before index_offset and is recognised by magic and by its sizes adding up
+ * to index_offset exactly; files without it are still valid.  When present,
+ * packets end at ids_offset rather than index_offset.
  * ----------------------------------------------------------------------- */
 
 #define BTELEM_INDEX_MAGIC 0x494C5442  /* "BTLI" */
@@ -361,8 +596,23 @@ struct __attribute__((packed)) btelem_index_footer {
     uint32_t magic;                     /*  4  BTELEM_INDEX_MAGIC */
 };
 
+#define BTELEM_INDEX_IDS_MAGIC 0x53444942  /* "BIDS" */
+
+struct __attribute__((packed)) btelem_index_id {
+    uint16_t id;                        /*  2  schema ID */
+    uint16_t count;                     /*  2  entries with this ID in the packet */
+};
+
+struct __attribute__((packed)) btelem_index_ids_footer {
+    uint64_t ids_offset;                /*  8  file offset of first_id[0] */
+    uint32_t id_count;                  /*  4  number of btelem_index_id records */
+    uint32_t magic;                     /*  4  BTELEM_INDEX_IDS_MAGIC */
+};
+
 _Static_assert(sizeof(struct btelem_index_entry)  == 28, "btelem_index_entry packing");
 _Static_assert(sizeof(struct btelem_index_footer) == 16, "btelem_index_footer packing");
+_Static_assert(sizeof(struct btelem_index_id)     == 4,  "btelem_index_id packing");
+_Static_assert(sizeof(struct btelem_index_ids_footer) == 16, "btelem_index_ids_footer packing");
 
 /* --------------------------------------------------------------------------
  * Client state
@@ -375,6 +625,33 @@ struct btelem_client {
     uint64_t dropped;           /* cumulative entries lost to overwrite */
     uint64_t dropped_reported;  /* dropped count already sent in packets */
     int      active;
+    uint32_t owner;             /* shared-memory rings: pid of the opener */
+
+    /* BTELEM_RING_SHARDED only: one cursor and drop count per shard
+     * (cursor above is unused; dropped is the sum of shard_dropped) */
+    uint64_t shard_cursor[BTELEM_MAX_SHARDS];
+    uint64_t shard_dropped[BTELEM_MAX_SHARDS];
+
+    /* Lossless clients only (btelem_client_set_spill): overflow copies of
+     * ring slots this client had not read before they were overwritten.
+     * A process-local pointer, so always NULL in a shared-memory client
+     * table (btelem_client_set_spill refuses there). */
+    struct btelem_spill *spill;
+
+    /* Health counters for btelem_stats().  Written only by the thread
+     * draining this client, so producers pay nothing for them. */
+    uint64_t torn;              /* entries skipped after a torn read */
+    uint64_t lag_max;           /* high-water head - cursor seen by a drain */
+    uint64_t emitted;           /* entries handed out */
+    uint64_t packets;           /* packets built by drain_packed / drain_iov */
+    uint64_t drain_ns;          /* time spent building them */
+#if BTELEM_STATS_IDS
+    uint32_t id_count[BTELEM_MAX_SCHEMA_ENTRIES]; /* emitted per schema ID (wraps) */
+#endif
 };
 
+_Static_assert(BTELEM_MAX_SHARDS >= 1 && BTELEM_MAX_SHARDS <= 64,
+               "BTELEM_MAX_SHARDS must be 1..64");
+_Static_assert(BTELEM_SHARD_BINDINGS >= 2, "BTELEM_SHARD_BINDINGS must be >= 2");
+
 #endif /* BTELEM_TYPES_H */
@@ -20,6 +20,10 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
 
 /* Viewer needs room for any schema the server sends; override the
    conservative embedded default (64) before btelem_types.h sees it. */
@@ -44,10 +48,19 @@ typedef struct {
     struct btelem_field_wire fields[BTELEM_MAX_FIELDS];
 } bt_entry_info;
 
+/* Tick-clock calibration from the optional schema clock record.
+ * tick_hz == 0: timestamps are already nanoseconds. */
+typedef struct {
+    uint64_t tick_hz;
+    uint64_t ref_ticks;
+    uint64_t ref_ns;
+} bt_clock;
+
 typedef struct {
     uint16_t      entry_count;
     bt_entry_info entries[BTELEM_MAX_SCHEMA_ENTRIES];
     bt_entry_info *by_id[BTELEM_MAX_SCHEMA_ENTRIES]; /* O(1) id lookup */
+    bt_clock      clock;
 } bt_schema;
 
 /* =========================================================================
@@ -93,11 +106,145 @@ type_element_size(uint8_t btype)
  * Schema parsing (from wire format using btelem_types.h structs)
  * ========================================================================= */
 
+/* Optional btelem_clock_wire at data[pos]; leaves *out zeroed if absent */
+static void
+parse_clock(const uint8_t *data, size_t len, size_t pos, bt_clock *out)
+{
+    struct btelem_clock_wire cw;
+    memset(out, 0, sizeof(*out));
+    if (pos + sizeof(cw) > len)
+        return;
+    memcpy(&cw, data + pos, sizeof(cw));
+    if (cw.magic != BTELEM_CLOCK_MAGIC || cw.tick_hz == 0)
+        return;
+    out->tick_hz   = cw.tick_hz;
+    out->ref_ticks = cw.ref_ticks;
+    out->ref_ns    = cw.ref_ns;
+}
+
+/* Bounds-checked cursor over a compact schema blob; sets err on overrun */
+typedef struct {
+    const uint8_t *data;
+    size_t         len;
+    size_t         pos;
+    int            err;
+} compact_reader;
+
+static uint8_t
+rd_u8(compact_reader *r)
+{
+    if (r->pos + 1 > r->len) {
+        r->err = 1;
+        return 0;
+    }
+    return r->data[r->pos++];
+}
+
+static uint16_t
+rd_u16(compact_reader *r)
+{
+    uint16_t v = 0;
+    if (r->pos + 2 > r->len) {
+        r->err = 1;
+        return 0;
+    }
+    memcpy(&v, r->data + r->pos, 2);
+    r->pos += 2;
+    return v;
+}
+
+/* Length-prefixed string into dst[cap] (NUL-terminated), or skip if NULL */
+static void
+rd_str(compact_reader *r, char *dst, size_t cap)
+{
+    size_t n = rd_u8(r);
+    if (r->pos + n > r->len) {
+        r->err = 1;
+        n = 0;
+    }
+    if (dst) {
+        size_t c = n < cap - 1 ? n : cap - 1;
+        memcpy(dst, r->data + r->pos, c);
+        dst[c] = '\0';
+    }
+    r->pos += n;
+}
+
+static int
+parse_schema_compact(const uint8_t *data, size_t len, bt_schema *out)
+{
+    struct btelem_schema_compact_header hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    if (hdr.version != BTELEM_SCHEMA_COMPACT_VERSION
+        || hdr.entry_count > BTELEM_MAX_SCHEMA_ENTRIES)
+        return -1;
+
+    out->entry_count = hdr.entry_count;
+    compact_reader r = { data, len, sizeof(hdr), 0 };
+
+    for (uint16_t i = 0; i < hdr.entry_count; i++) {
+        bt_entry_info *e = &out->entries[i];
+        e->id = rd_u16(&r);
+        e->payload_size = rd_u16(&r);
+        e->field_count = rd_u16(&r);
+        if (e->field_count > BTELEM_MAX_FIELDS)
+            e->field_count = BTELEM_MAX_FIELDS;
+        rd_str(&r, e->name, BTELEM_NAME_MAX);
+        rd_str(&r, NULL, 0);    /* description */
+
+        for (uint16_t fi = 0; fi < e->field_count; fi++) {
+            struct btelem_field_wire *fw = &e->fields[fi];
+            rd_str(&r, fw->name, BTELEM_NAME_MAX);
+            fw->offset = rd_u16(&r);
+            fw->size   = rd_u16(&r);
+            fw->type   = rd_u8(&r);
+            fw->count  = rd_u8(&r);
+        }
+        if (r.err)
+            return -1;
+        if (e->id < BTELEM_MAX_SCHEMA_ENTRIES)
+            out->by_id[e->id] = e;
+    }
+
+    /* Walk the enum and bitfield sections to reach the optional clock record */
+    uint16_t n = rd_u16(&r);
+    for (uint16_t i = 0; i < n && !r.err; i++) {
+        rd_u16(&r);
+        rd_u16(&r);
+        uint8_t lc = rd_u8(&r);
+        for (uint8_t li = 0; li < lc; li++)
+            rd_str(&r, NULL, 0);
+    }
+    n = rd_u16(&r);
+    for (uint16_t i = 0; i < n && !r.err; i++) {
+        rd_u16(&r);
+        rd_u16(&r);
+        uint8_t bc = rd_u8(&r);
+        for (uint8_t bi = 0; bi < bc; bi++) {
+            rd_str(&r, NULL, 0);
+            rd_u8(&r);
+            rd_u8(&r);
+        }
+    }
+    if (r.err)
+        return -1;
+    parse_clock(data, len, r.pos, &out->clock);
+
+    return 0;
+}
+
+/* Fixed-size or compact schema blob (told apart by the first word) */
 static int
 parse_schema(const uint8_t *data, size_t len, bt_schema *out)
 {
     memset(out, 0, sizeof(*out));
 
+    uint32_t magic = 0;
+    if (len >= sizeof(struct btelem_schema_compact_header))
+        memcpy(&magic, data, sizeof(magic));
+    if (magic == BTELEM_SCHEMA_COMPACT_MAGIC)
+        return parse_schema_compact(data, len, out);
+
     if (len < sizeof(struct btelem_schema_header))
         return -1;
 
@@ -138,9 +285,225 @@ parse_schema(const uint8_t *data, size_t len, bt_schema *out)
         pos += sizeof(struct btelem_schema_wire);
     }
 
+    /* Skip the enum and bitfield sections to reach the optional clock record */
+    uint16_t n;
+    if (pos + 2 <= len) {
+        memcpy(&n, data + pos, 2);
+        pos += 2 + (size_t)n * sizeof(struct btelem_enum_wire);
+    }
+    if (pos + 2 <= len) {
+        memcpy(&n, data + pos, 2);
+        pos += 2 + (size_t)n * sizeof(struct btelem_bitfield_wire);
+    }
+    parse_clock(data, len, pos, &out->clock);
+
+    return 0;
+}
+
+/* =========================================================================
+ * Tick timestamp conversion
+ *
+ *   ns = ref_ns + floor((ticks - ref_ticks) * 1e9 / tick_hz)
+ *
+ * Entry headers and the packet index stay in raw ticks; t0/t1 arguments are
+ * mapped into ticks on the way in and output timestamps back to ns.
+ * ========================================================================= */
+
+static __int128
+floor_div(__int128 a, __int128 b)
+{
+    __int128 q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static uint64_t
+clamp_u64(__int128 v)
+{
+    if (v < 0) return 0;
+    if (v > (__int128)UINT64_MAX) return UINT64_MAX;
+    return (uint64_t)v;
+}
+
+static uint64_t
+clock_to_ns(const bt_clock *c, uint64_t ticks)
+{
+    if (!c->tick_hz)
+        return ticks;
+    __int128 d = (__int128)ticks - (__int128)c->ref_ticks;
+    return clamp_u64((__int128)c->ref_ns + floor_div(d * 1000000000, c->tick_hz));
+}
+
+/* Smallest tick value whose ns time is >= ns (ceil) */
+static uint64_t
+clock_from_ns_lo(const bt_clock *c, uint64_t ns)
+{
+    if (!c->tick_hz)
+        return ns;
+    __int128 d = (__int128)ns - (__int128)c->ref_ns;
+    return clamp_u64((__int128)c->ref_ticks
+                     - floor_div(-d * c->tick_hz, 1000000000));
+}
+
+/* Largest tick value whose ns time is <= ns */
+static uint64_t
+clock_from_ns_hi(const bt_clock *c, uint64_t ns)
+{
+    if (!c->tick_hz || ns == UINT64_MAX)
+        return ns;
+    uint64_t lo = clock_from_ns_lo(c, ns + 1);
+    return lo ? lo - 1 : 0;
+}
+
+/* =========================================================================
+ * Compressed packets (BTELEM_PACKET_FLAG_COMPRESSED)
+ *
+ * Same decoder as btelem_packet_decompress(), kept here because this module
+ * does not link libbtelem.  Everything else in this file sees plain packets.
+ * ========================================================================= */
+
+typedef struct {
+    const uint8_t *buf;
+    size_t         len;
+    size_t         pos;
+    int            bad;
+} bt_zsrc;
+
+static uint64_t
+zsrc_varint(bt_zsrc *s)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64 && s->pos < s->len; shift += 7) {
+        uint8_t b = s->buf[s->pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    s->bad = 1;
     return 0;
 }
 
+/*
+ * Expand a compressed packet into out.  With out == NULL only validates and
+ * returns the plain size.  Returns the plain size, or -1 if malformed or
+ * larger than out_size.
+ */
+static Py_ssize_t
+inflate_packet(const uint8_t *pkt, size_t len, uint8_t *out, size_t out_size)
+{
+    struct btelem_packet_header h;
+    if (len < sizeof(h))
+        return -1;
+    memcpy(&h, pkt, sizeof(h));
+    if (!(h.flags & BTELEM_PACKET_FLAG_COMPRESSED) || sizeof(h) + h.payload_size > len)
+        return -1;
+
+    size_t table_end = sizeof(h) + (size_t)h.entry_count * sizeof(struct btelem_entry_header);
+    if (out && table_end > out_size)
+        return -1;
+    struct btelem_entry_header *table =
+        out ? (struct btelem_entry_header *)(out + sizeof(h)) : NULL;
+    uint8_t *payload = out ? out + table_end : NULL;
+    size_t capacity = out ? out_size - table_end : SIZE_MAX;
+
+    bt_zsrc s = { pkt + sizeof(h), h.payload_size, 0, 0 };
+    uint16_t prev[BTELEM_PACKET_DELTA_IDS];
+    memset(prev, 0, sizeof(prev));
+    uint64_t ts = 0;
+    size_t off = 0;
+
+    for (uint16_t i = 0; i < h.entry_count; i++) {
+        uint64_t id = zsrc_varint(&s);
+        uint64_t size = zsrc_varint(&s);
+        uint64_t zz = zsrc_varint(&s);
+        ts += (zz >> 1) ^ (uint64_t)-(int64_t)(zz & 1);
+        if (s.bad || id > UINT16_MAX || size > UINT16_MAX || off + size > capacity)
+            return -1;
+
+        uint8_t *cur = payload ? payload + off : NULL;
+        const uint8_t *ref = NULL;
+        if (out && id < BTELEM_PACKET_DELTA_IDS) {
+            const struct btelem_entry_header *r =
+                prev[id] ? &table[prev[id] - 1] : NULL;
+            if (r && r->payload_size == size)
+                ref = payload + r->payload_offset;
+            prev[id] = (uint16_t)(i + 1);
+        }
+
+        size_t k = 0;
+        while (k < size) {
+            uint64_t run = zsrc_varint(&s);
+            uint64_t zeros = run >> 4, lits = run & 15;
+            if (s.bad || zeros + lits == 0 || zeros > size - k
+                || lits > size - k - zeros || lits > s.len - s.pos)
+                return -1;
+            if (!cur) {
+                k += zeros + lits;
+                s.pos += lits;
+                continue;
+            }
+            for (uint64_t j = 0; j < zeros; j++, k++)
+                cur[k] = ref ? ref[k] : 0;
+            for (uint64_t j = 0; j < lits; j++, k++)
+                cur[k] = (uint8_t)(s.buf[s.pos++] ^ (ref ? ref[k] : 0));
+        }
+
+        if (table) {
+            table[i].id = (uint16_t)id;
+            table[i].payload_size = (uint16_t)size;
+            table[i].payload_offset = (uint32_t)off;
+            table[i].timestamp = ts;
+        }
+        off += size;
+    }
+    if (s.pos != s.len || off > UINT32_MAX)
+        return -1;
+
+    if (out) {
+        h.flags &= (uint16_t)~BTELEM_PACKET_FLAG_COMPRESSED;
+        h.payload_size = (uint32_t)off;
+        memcpy(out, &h, sizeof(h));
+    }
+    return (Py_ssize_t)(table_end + off);
+}
+
+/* ts_min/ts_max over a plain packet's entry headers (0, 0 if empty) */
+static void
+packet_ts_range(const uint8_t *pkt, uint64_t *ts_min, uint64_t *ts_max)
+{
+    const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(pkt + sizeof(*ph));
+    *ts_min = UINT64_MAX;
+    *ts_max = 0;
+    for (uint16_t i = 0; i < ph->entry_count; i++) {
+        if (table[i].timestamp < *ts_min) *ts_min = table[i].timestamp;
+        if (table[i].timestamp > *ts_max) *ts_max = table[i].timestamp;
+    }
+    if (ph->entry_count == 0) { *ts_min = 0; *ts_max = 0; }
+}
+
+/* Does a plain packet of len bytes hold its entry table, and does every
+ * payload lie inside the payload area after it? */
+static int
+packet_layout_ok(const uint8_t *pkt, size_t len)
+{
+    struct btelem_packet_header h;
+    if (len < sizeof(h))
+        return 0;
+    memcpy(&h, pkt, sizeof(h));
+    size_t table_end = sizeof(h) + (size_t)h.entry_count * sizeof(struct btelem_entry_header);
+    if (table_end > len)
+        return 0;
+    uint64_t area = len - table_end;
+    for (uint16_t i = 0; i < h.entry_count; i++) {
+        struct btelem_entry_header e;
+        memcpy(&e, pkt + sizeof(h) + (size_t)i * sizeof(e), sizeof(e));
+        if ((uint64_t)e.payload_offset + e.payload_size > area)
+            return 0;
+    }
+    return 1;
+}
+
 /* =========================================================================
  * File format constants (not in btelem_types.h — defined by Python storage)
  * ========================================================================= */
@@ -195,60 +558,64 @@ index_lower_bound(const struct btelem_index_entry *index, uint32_t idx_count,
 }
 
 /*
- * Exact entry count: scans entry headers matching target_id and t0/t1.
- * Only reads the 16-byte entry header table per packet (no payload access).
+ * Per-packet ID summary from a v2 index (see btelem_types.h): packet pi's
+ * records are recs[first[pi]] .. recs[first[pi + 1] - 1], ascending by ID.
+ * first is unaligned in the mmap, hence the memcpy loads.
  */
-static npy_intp
-count_entries_exact(const uint8_t *data,
-                    const struct btelem_index_entry *index, uint32_t idx_count,
-                    uint16_t target_id,
-                    uint64_t t0, int use_t0, uint64_t t1, int use_t1)
-{
-    uint32_t start = use_t0 ? index_lower_bound(index, idx_count, t0) : 0;
-    npy_intp count = 0;
-    for (uint32_t pi = start; pi < idx_count; pi++) {
-        const struct btelem_index_entry *ie = &index[pi];
-        if (use_t1 && ie->ts_min > t1) break;
-
-        const struct btelem_packet_header *ph =
-            (const struct btelem_packet_header *)(data + ie->offset);
-        const struct btelem_entry_header *table =
-            (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
+typedef struct {
+    const uint8_t                 *first;    /* uint32_t x (packets + 1), NULL = none */
+    const struct btelem_index_id  *recs;
+} bt_id_index;
 
-        for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
-            if (table[ei].id != target_id) continue;
-            if (use_t0 && table[ei].timestamp < t0) continue;
-            if (use_t1 && table[ei].timestamp > t1) continue;
-            count++;
-        }
-    }
-    return count;
+/* Packet pi's records are recs[*lo] .. recs[*hi - 1] */
+static void
+packet_id_range(const bt_id_index *ids, uint32_t pi, uint32_t *lo, uint32_t *hi)
+{
+    memcpy(lo, ids->first + (size_t)pi * 4, 4);
+    memcpy(hi, ids->first + (size_t)(pi + 1) * 4, 4);
 }
 
+/* Packets whose index offsets point into data */
+typedef struct {
+    const uint8_t                   *data;
+    const struct btelem_index_entry *index;
+    uint32_t                         count;
+} bt_part;
+
 /*
- * Count entries per schema ID in a single pass over the index.
- * Returns a Python dict {entry_name: count}.
+ * Count entries per schema ID in a single pass over the index.  ids is
+ * only given for a single part.  Returns a Python dict {entry_name: count}.
  */
 static PyObject *
-entry_counts_from_index(const uint8_t *data,
-                        const struct btelem_index_entry *index,
-                        uint32_t idx_count,
-                        const bt_schema *schema)
+entry_counts_from_index(const bt_part *parts, uint32_t nparts,
+                        const bt_id_index *ids, const bt_schema *schema)
 {
-    /* Use a flat array indexed by entry ID (max 64 entries). */
+    /* Use a flat array indexed by entry ID. */
     uint64_t counts[BTELEM_MAX_SCHEMA_ENTRIES] = {0};
 
-    for (uint32_t pi = 0; pi < idx_count; pi++) {
-        const struct btelem_index_entry *ie = &index[pi];
-        const struct btelem_packet_header *ph =
-            (const struct btelem_packet_header *)(data + ie->offset);
-        const struct btelem_entry_header *table =
-            (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
+    if (ids && ids->first && nparts == 1) {
+        /* The summary has it all; no packet is touched */
+        uint32_t n;
+        memcpy(&n, ids->first + (size_t)parts[0].count * 4, 4);
+        for (uint32_t i = 0; i < n; i++)
+            if (ids->recs[i].id < BTELEM_MAX_SCHEMA_ENTRIES)
+                counts[ids->recs[i].id] += ids->recs[i].count;
+        nparts = 0;
+    }
 
-        for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
-            uint16_t id = table[ei].id;
-            if (id < BTELEM_MAX_SCHEMA_ENTRIES)
-                counts[id]++;
+    for (uint32_t p = 0; p < nparts; p++) {
+        for (uint32_t pi = 0; pi < parts[p].count; pi++) {
+            const struct btelem_index_entry *ie = &parts[p].index[pi];
+            const struct btelem_packet_header *ph =
+                (const struct btelem_packet_header *)(parts[p].data + ie->offset);
+            const struct btelem_entry_header *table =
+                (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
+
+            for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
+                uint16_t id = table[ei].id;
+                if (id < BTELEM_MAX_SCHEMA_ENTRIES)
+                    counts[id]++;
+            }
         }
     }
 
@@ -265,191 +632,832 @@ entry_counts_from_index(const uint8_t *data,
     return dict;
 }
 
+/* =========================================================================
+ * Extraction engine
+ *
+ * One pass over the index fills any number of targets (an entry ID and the
+ * fields wanted from it).  The packets, in one or more parts (a Capture's
+ * mmap, a LiveCapture's segments), are cut into chunks: a count pass sizes
+ * every target per chunk, a prefix sum turns those counts into output
+ * offsets, and a fill pass copies each chunk into its own slice of the
+ * arrays.  Chunks share nothing, so both passes run on threads pulling
+ * chunk numbers from a counter; no Python API is used inside a pass, so
+ * callers may drop the GIL around them.
+ * ========================================================================= */
+
+#define BT_EXTRACT_MAX_THREADS  64
+#define BT_EXTRACT_MIN_CHUNK    256     /* packets; less is not worth a thread */
+
+typedef struct {
+    const struct btelem_field_wire *field;
+    int       npy_type;
+    int       size;                 /* bytes per row */
+    npy_intp  width;                /* elements per row, 0 = 1-D array */
+    PyObject *arr;
+    uint8_t  *out;
+} bt_column;
+
+typedef struct {
+    uint16_t   id;
+    bt_column *cols;
+    uint16_t   ncols;
+    npy_intp   count;
+    PyObject  *ts_arr;
+    uint8_t   *ts;
+} bt_target;
+
+typedef struct {
+    const uint8_t                   *data;
+    const struct btelem_index_entry *index;
+    uint32_t                         first, last;   /* packets [first, last) */
+} bt_chunk;
+
+typedef struct {
+    const bt_id_index               *ids;       /* NULL or no summary: scan headers;
+                                                   single-part sources only */
+    const bt_clock                  *clock;
+    uint64_t    t0, t1;                         /* ticks */
+    int         use_t0, use_t1;
+    bt_target  *targets;
+    uint16_t    ntargets;
+    uint16_t   *slot;                           /* by entry ID: target + 1, 0 = none */
+    bt_chunk   *chunks;
+    uint32_t    nchunks;
+    npy_intp   *off;                            /* [nchunks + 1][ntargets] counts, then offsets */
+    npy_intp   *cur;                            /* [nchunks][ntargets] fill cursors */
+    int         fill;                           /* pass being run */
+    uint32_t    next;                           /* next chunk to claim */
+} bt_extract;
+
+static int
+packet_inside(const bt_extract *x, const struct btelem_index_entry *ie)
+{
+    return (!x->use_t0 || ie->ts_min >= x->t0) && (!x->use_t1 || ie->ts_max <= x->t1);
+}
+
+static int
+entry_inside(const bt_extract *x, uint64_t ts)
+{
+    return (!x->use_t0 || ts >= x->t0) && (!x->use_t1 || ts <= x->t1);
+}
+
+/* With an ID summary: does packet pi hold any target at all? */
+static int
+packet_has_target(const bt_extract *x, uint32_t pi)
+{
+    uint32_t lo, hi;
+    packet_id_range(x->ids, pi, &lo, &hi);
+    for (uint32_t r = lo; r < hi; r++)
+        if (x->slot[x->ids->recs[r].id])
+            return 1;
+    return 0;
+}
+
 /*
- * Extract series: fill timestamp and value arrays.
+ * Count pass for one chunk.  Reads only entry headers, and with an ID
+ * summary only for packets straddling t0/t1.
  */
-static npy_intp
-fill_series(const uint8_t *data,
-            const struct btelem_index_entry *index, uint32_t idx_count,
-            uint16_t target_id, const struct btelem_field_wire *field,
-            uint64_t t0, int use_t0, uint64_t t1, int use_t1,
-            uint8_t *ts_out, uint8_t *val_out, npy_intp max_count,
-            int field_bytes)
+static void
+extract_count_chunk(bt_extract *x, uint32_t c)
 {
-    uint32_t start = use_t0 ? index_lower_bound(index, idx_count, t0) : 0;
-
-    npy_intp pos = 0;
-    for (uint32_t pi = start; pi < idx_count && pos < max_count; pi++) {
-        const struct btelem_index_entry *ie = &index[pi];
-        if (use_t1 && ie->ts_min > t1) break;
+    const bt_chunk *ch = &x->chunks[c];
+    npy_intp *cnt = x->off + (size_t)c * x->ntargets;
+    int summary = x->ids && x->ids->first;
+
+    for (uint32_t pi = ch->first; pi < ch->last; pi++) {
+        const struct btelem_index_entry *ie = &ch->index[pi];
+        if (summary && packet_inside(x, ie)) {
+            uint32_t lo, hi;
+            packet_id_range(x->ids, pi, &lo, &hi);
+            for (uint32_t r = lo; r < hi; r++) {
+                uint16_t s = x->slot[x->ids->recs[r].id];
+                if (s)
+                    cnt[s - 1] += x->ids->recs[r].count;
+            }
+            continue;
+        }
 
         const struct btelem_packet_header *ph =
-            (const struct btelem_packet_header *)(data + ie->offset);
+            (const struct btelem_packet_header *)(ch->data + ie->offset);
         const struct btelem_entry_header *table =
             (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
-        const uint8_t *payload_base =
-            (const uint8_t *)&table[ph->entry_count];
-
-        for (uint16_t ei = 0; ei < ph->entry_count && pos < max_count; ei++) {
-            const struct btelem_entry_header *eh = &table[ei];
-            if (eh->id != target_id) continue;
-            if (use_t0 && eh->timestamp < t0) continue;
-            if (use_t1 && eh->timestamp > t1) continue;
-
-            memcpy(ts_out + pos * 8, &eh->timestamp, 8);
 
-            const uint8_t *payload = payload_base + eh->payload_offset;
-            if (field->offset + field_bytes <= eh->payload_size)
-                memcpy(val_out + pos * field_bytes,
-                       payload + field->offset, field_bytes);
-            else
-                memset(val_out + pos * field_bytes, 0, field_bytes);
-            pos++;
+        for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
+            uint16_t s = x->slot[table[ei].id];
+            if (s && entry_inside(x, table[ei].timestamp))
+                cnt[s - 1]++;
         }
     }
-    return pos;
 }
 
 /*
- * Extract table: fill timestamp array + one array per field in a single scan.
+ * Fill pass for one chunk, into rows off[c] .. off[c + 1] of each target.
+ * Timestamps are written as ns.  A summary that disagrees with the packets
+ * cannot overrun the slice; rows it promised but did not deliver are zeroed.
  */
-static npy_intp
-fill_table(const uint8_t *data,
-           const struct btelem_index_entry *index, uint32_t idx_count,
-           uint16_t target_id, const bt_entry_info *entry,
-           uint64_t t0, int use_t0, uint64_t t1, int use_t1,
-           uint8_t *ts_out, uint8_t **field_arrays, int *field_sizes,
-           npy_intp max_count)
+static void
+extract_fill_chunk(bt_extract *x, uint32_t c)
 {
-    uint32_t start = use_t0 ? index_lower_bound(index, idx_count, t0) : 0;
+    const npy_intp *lim = x->off + (size_t)(c + 1) * x->ntargets;
+    npy_intp *pos = x->cur + (size_t)c * x->ntargets;
+    memcpy(pos, x->off + (size_t)c * x->ntargets, x->ntargets * sizeof(*pos));
+    const bt_chunk *ch = &x->chunks[c];
+    int summary = x->ids && x->ids->first;
 
-    npy_intp pos = 0;
-    for (uint32_t pi = start; pi < idx_count && pos < max_count; pi++) {
-        const struct btelem_index_entry *ie = &index[pi];
-        if (use_t1 && ie->ts_min > t1) break;
+    for (uint32_t pi = ch->first; pi < ch->last; pi++) {
+        if (summary && !packet_has_target(x, pi))
+            continue;
 
         const struct btelem_packet_header *ph =
-            (const struct btelem_packet_header *)(data + ie->offset);
+            (const struct btelem_packet_header *)(ch->data + ch->index[pi].offset);
         const struct btelem_entry_header *table =
             (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
         const uint8_t *payload_base =
             (const uint8_t *)&table[ph->entry_count];
 
-        for (uint16_t ei = 0; ei < ph->entry_count && pos < max_count; ei++) {
+        for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
             const struct btelem_entry_header *eh = &table[ei];
-            if (eh->id != target_id) continue;
-            if (use_t0 && eh->timestamp < t0) continue;
-            if (use_t1 && eh->timestamp > t1) continue;
+            uint16_t s = x->slot[eh->id];
+            if (!s || !entry_inside(x, eh->timestamp) || pos[s - 1] >= lim[s - 1])
+                continue;
 
-            memcpy(ts_out + pos * 8, &eh->timestamp, 8);
+            bt_target *t = &x->targets[s - 1];
+            npy_intp row = pos[s - 1]++;
+            uint64_t ns = clock_to_ns(x->clock, eh->timestamp);
+            memcpy(t->ts + row * 8, &ns, 8);
 
             const uint8_t *payload = payload_base + eh->payload_offset;
-            for (uint16_t fi = 0; fi < entry->field_count; fi++) {
-                const struct btelem_field_wire *f = &entry->fields[fi];
-                int fsz = field_sizes[fi];
-                if (f->offset + fsz <= eh->payload_size)
-                    memcpy(field_arrays[fi] + pos * fsz,
-                           payload + f->offset, fsz);
+            for (uint16_t k = 0; k < t->ncols; k++) {
+                const bt_column *col = &t->cols[k];
+                if (col->field->offset + col->size <= eh->payload_size)
+                    memcpy(col->out + row * col->size,
+                           payload + col->field->offset, col->size);
                 else
-                    memset(field_arrays[fi] + pos * fsz, 0, fsz);
+                    memset(col->out + row * col->size, 0, col->size);
             }
-            pos++;
         }
     }
-    return pos;
-}
 
-/* =========================================================================
- * CaptureObject (file-backed, mmap)
- * ========================================================================= */
+    for (uint16_t ti = 0; ti < x->ntargets; ti++) {
+        bt_target *t = &x->targets[ti];
+        npy_intp n = lim[ti] - pos[ti];
+        if (n <= 0)
+            continue;
+        memset(t->ts + pos[ti] * 8, 0, (size_t)n * 8);
+        for (uint16_t k = 0; k < t->ncols; k++)
+            memset(t->cols[k].out + pos[ti] * t->cols[k].size, 0,
+                   (size_t)n * t->cols[k].size);
+    }
+}
 
-typedef struct {
-    PyObject_HEAD
-    int         fd;
-    uint8_t    *map;
-    size_t      map_len;
-    bt_schema   schema;
-    size_t      data_start;
-    size_t      data_end;
-    struct btelem_index_entry *index;  /* pointer into mmap or malloc'd */
-    uint32_t    index_count;
-    int         index_owned;           /* 1 if we malloc'd index (no footer) */
-} CaptureObject;
+static void *
+extract_worker(void *arg)
+{
+    bt_extract *x = arg;
+    for (;;) {
+        uint32_t c = __atomic_fetch_add(&x->next, 1, __ATOMIC_RELAXED);
+        if (c >= x->nchunks)
+            return NULL;
+        if (x->fill)
+            extract_fill_chunk(x, c);
+        else
+            extract_count_chunk(x, c);
+    }
+}
 
+/* Run one pass on `threads` threads, the caller's included.  Threads that
+ * fail to start just leave more chunks for the others. */
 static void
-Capture_dealloc(CaptureObject *self)
+extract_pass(bt_extract *x, int fill, int threads)
 {
-    if (self->index_owned && self->index)
-        free(self->index);
-    if (self->map && self->map != MAP_FAILED)
-        munmap(self->map, self->map_len);
-    if (self->fd >= 0)
-        close(self->fd);
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    pthread_t tid[BT_EXTRACT_MAX_THREADS];
+    int started = 0;
+
+    x->fill = fill;
+    x->next = 0;
+    while (started + 1 < threads
+           && pthread_create(&tid[started], NULL, extract_worker, x) == 0)
+        started++;
+    extract_worker(x);
+    for (int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
 }
 
-/* Build index by scanning packets sequentially (fallback when no footer) */
+/*
+ * Choose the packets and chunks for x (t0/t1 set); threads <= 0 means one
+ * per CPU.  Parts are in time order, and the scan stops at the first packet
+ * starting after t1.  Returns the number of threads worth running, or -1
+ * with an exception set.
+ */
 static int
-Capture_build_index(CaptureObject *self)
+extract_plan(bt_extract *x, const bt_part *parts, uint32_t nparts, int threads)
 {
-    uint32_t cap = 64;
-    uint32_t count = 0;
-    struct btelem_index_entry *idx = malloc(cap * sizeof(*idx));
-    if (!idx) { PyErr_NoMemory(); return -1; }
-
-    size_t pos = self->data_start;
-    while (pos + sizeof(struct btelem_packet_header) <= self->map_len) {
-        const struct btelem_packet_header *ph =
-            (const struct btelem_packet_header *)(self->map + pos);
-
-        size_t pkt_size = sizeof(*ph)
-            + (size_t)ph->entry_count * sizeof(struct btelem_entry_header)
-            + ph->payload_size;
-        if (pos + pkt_size > self->map_len) break;
-
-        /* Scan entry headers for ts_min/ts_max */
-        uint64_t ts_min = UINT64_MAX, ts_max = 0;
-        const struct btelem_entry_header *table =
-            (const struct btelem_entry_header *)(self->map + pos + sizeof(*ph));
-        for (uint16_t i = 0; i < ph->entry_count; i++) {
-            if (table[i].timestamp < ts_min) ts_min = table[i].timestamp;
-            if (table[i].timestamp > ts_max) ts_max = table[i].timestamp;
+    bt_chunk *span = calloc(nparts ? nparts : 1, sizeof(*span));
+    if (!span) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    uint32_t packets = 0, nspans = 0;
+    for (uint32_t i = 0; i < nparts; i++) {
+        const bt_part *pt = &parts[i];
+        bt_chunk *sp = &span[nspans];
+        sp->data = pt->data;
+        sp->index = pt->index;
+        sp->first = x->use_t0 ? index_lower_bound(pt->index, pt->count, x->t0) : 0;
+        sp->last = x->use_t1 ? sp->first : pt->count;
+        if (x->use_t1)
+            while (sp->last < pt->count && pt->index[sp->last].ts_min <= x->t1)
+                sp->last++;
+        if (sp->last > sp->first) {
+            packets += sp->last - sp->first;
+            nspans++;
         }
-        if (ph->entry_count == 0) { ts_min = 0; ts_max = 0; }
+        if (sp->last < pt->count)
+            break;
+    }
 
-        if (count >= cap) {
-            cap *= 2;
-            struct btelem_index_entry *tmp = realloc(idx, cap * sizeof(*idx));
-            if (!tmp) { free(idx); PyErr_NoMemory(); return -1; }
-            idx = tmp;
+    if (threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    if (threads > BT_EXTRACT_MAX_THREADS)
+        threads = BT_EXTRACT_MAX_THREADS;
+
+    /* A few chunks per thread evens out packets of uneven weight; chunks
+     * never straddle parts, so a part may add one short chunk. */
+    uint32_t want = (uint32_t)threads * 4;
+    uint32_t chunk = (packets + want - 1) / want;
+    if (chunk < BT_EXTRACT_MIN_CHUNK)
+        chunk = BT_EXTRACT_MIN_CHUNK;
+    x->chunks = calloc(packets / chunk + nspans + 1, sizeof(*x->chunks));
+    if (!x->chunks) {
+        free(span);
+        PyErr_NoMemory();
+        return -1;
+    }
+    x->nchunks = 0;
+    for (uint32_t i = 0; i < nspans; i++)
+        for (uint32_t pi = span[i].first; pi < span[i].last; pi += chunk) {
+            bt_chunk *ch = &x->chunks[x->nchunks++];
+            *ch = span[i];
+            ch->first = pi;
+            ch->last = span[i].last - pi > chunk ? pi + chunk : span[i].last;
         }
-        idx[count].offset      = pos;
-        idx[count].ts_min      = ts_min;
-        idx[count].ts_max      = ts_max;
-        idx[count].entry_count = ph->entry_count;
-        count++;
+    free(span);
+    return (uint32_t)threads < x->nchunks ? threads : (int)x->nchunks;
+}
 
-        pos += pkt_size;
+/*
+ * Shared by Capture and LiveCapture.  busy != NULL drops the GIL around
+ * each pass and counts the call in *busy: Capture's mmap cannot move and
+ * close() refuses to unmap under it; LiveCapture holds its lock throughout.
+ */
+typedef struct {
+    const bt_part        *parts;
+    uint32_t              nparts;
+    const bt_id_index    *ids;
+    const bt_schema      *schema;
+    int                  *busy;
+    bt_part               one;          /* parts storage for single-part sources */
+} bt_source;
+
+/* numpy dtype and row layout for a field; bitfields use their storage size */
+static int
+column_init(bt_column *col, const struct btelem_field_wire *f)
+{
+    int npy_type = type_to_npy(f->type);
+    int elem_sz = type_element_size(f->type);
+
+    col->field = f;
+    col->arr = NULL;
+    col->out = NULL;
+    if (f->type == BTELEM_BITFIELD) {
+        switch (f->size) {
+        case 1: npy_type = NPY_UINT8; elem_sz = 1; break;
+        case 2: npy_type = NPY_UINT16; elem_sz = 2; break;
+        case 4: npy_type = NPY_UINT32; elem_sz = 4; break;
+        default:
+            PyErr_Format(PyExc_ValueError, "Unsupported bitfield size: %d", f->size);
+            return -1;
+        }
     }
-
-    self->index = idx;
-    self->index_count = count;
-    self->index_owned = 1;
-    self->data_end = pos;
+    if (npy_type < 0) {
+        PyErr_Format(PyExc_ValueError, "Unsupported field type: %d", f->type);
+        return -1;
+    }
+    col->npy_type = npy_type;
+    col->size = elem_sz * f->count;
+    col->width = f->count > 1 ? f->count : 0;
     return 0;
 }
 
-static int
-Capture_init(CaptureObject *self, PyObject *args, PyObject *kwds)
+static void
+targets_release(bt_target *targets, uint16_t n)
 {
-    const char *path;
+    for (uint16_t ti = 0; ti < n; ti++) {
+        Py_CLEAR(targets[ti].ts_arr);
+        for (uint16_t k = 0; k < targets[ti].ncols; k++)
+            Py_CLEAR(targets[ti].cols[k].arr);
+    }
+}
+
+static void
+source_pass(const bt_source *src, bt_extract *x, int fill, int threads)
+{
+    if (!src->busy) {
+        extract_pass(x, fill, threads);
+        return;
+    }
+    (*src->busy)++;
+    Py_BEGIN_ALLOW_THREADS
+    extract_pass(x, fill, threads);
+    Py_END_ALLOW_THREADS
+    (*src->busy)--;
+}
+
+/*
+ * Count, allocate every target's arrays, fill.  x has t0/t1 set.  Returns 0,
+ * or -1 with an exception set; arrays already made stay in the targets for
+ * targets_release().
+ */
+static int
+extract_run(const bt_source *src, bt_extract *x, bt_target *targets,
+            uint16_t ntargets, int threads)
+{
+    x->ids = src->ids;
+    x->clock = &src->schema->clock;
+    x->targets = targets;
+    x->ntargets = ntargets;
+    threads = extract_plan(x, src->parts, src->nparts, threads);
+    if (threads < 0)
+        return -1;
+
+    x->slot = calloc(65536, sizeof(*x->slot));
+    x->off = calloc(((size_t)x->nchunks * 2 + 1) * (ntargets ? ntargets : 1), sizeof(*x->off));
+    if (!x->slot || !x->off) {
+        free(x->chunks);
+        free(x->slot);
+        free(x->off);
+        PyErr_NoMemory();
+        return -1;
+    }
+    x->cur = x->off + ((size_t)x->nchunks + 1) * ntargets;
+    for (uint16_t ti = 0; ti < ntargets; ti++)
+        x->slot[targets[ti].id] = ti + 1;
+
+    if (x->nchunks)
+        source_pass(src, x, 0, threads);
+
+    /* Chunk counts -> starting rows; row nchunks ends up the totals */
+    for (uint16_t ti = 0; ti < ntargets; ti++) {
+        npy_intp total = 0;
+        for (uint32_t c = 0; c <= x->nchunks; c++) {
+            npy_intp *p = &x->off[(size_t)c * ntargets + ti];
+            npy_intp n = *p;
+            *p = total;
+            total += n;
+        }
+        targets[ti].count = total;
+    }
+
+    int rc = 0;
+    for (uint16_t ti = 0; ti < ntargets && rc == 0; ti++) {
+        bt_target *t = &targets[ti];
+        npy_intp ts_dims[1] = {t->count};
+        t->ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
+        if (!t->ts_arr) { rc = -1; break; }
+        t->ts = PyArray_DATA((PyArrayObject *)t->ts_arr);
+        for (uint16_t k = 0; k < t->ncols; k++) {
+            bt_column *col = &t->cols[k];
+            npy_intp dims[2] = {t->count, col->width};
+            col->arr = PyArray_SimpleNew(col->width ? 2 : 1, dims, col->npy_type);
+            if (!col->arr) { rc = -1; break; }
+            col->out = PyArray_DATA((PyArrayObject *)col->arr);
+        }
+    }
+
+    if (rc == 0 && x->nchunks)
+        source_pass(src, x, 1, threads);
+    free(x->chunks);
+    free(x->slot);
+    free(x->off);
+    return rc;
+}
+
+/* t0/t1 arguments (ns or None) into x, as ticks */
+static int
+parse_time_range(const bt_schema *schema, PyObject *t0_obj, PyObject *t1_obj,
+                 bt_extract *x)
+{
+    memset(x, 0, sizeof(*x));
+    x->use_t0 = (t0_obj != Py_None);
+    x->use_t1 = (t1_obj != Py_None);
+    if (x->use_t0) { x->t0 = PyLong_AsUnsignedLongLong(t0_obj); if (PyErr_Occurred()) return -1; }
+    if (x->use_t1) { x->t1 = PyLong_AsUnsignedLongLong(t1_obj); if (PyErr_Occurred()) return -1; }
+    x->t0 = clock_from_ns_lo(&schema->clock, x->t0);
+    x->t1 = clock_from_ns_hi(&schema->clock, x->t1);
+    return 0;
+}
+
+/* series() of one field; x has t0/t1 set */
+static PyObject *
+series_extract(const bt_source *src, bt_extract *x, const bt_entry_info *entry,
+               const struct btelem_field_wire *field, int threads)
+{
+    bt_column col;
+    if (column_init(&col, field) < 0)
+        return NULL;
+    bt_target target = { .id = entry->id, .cols = &col, .ncols = 1 };
+
+    PyObject *result = NULL;
+    if (extract_run(src, x, &target, 1, threads) == 0)
+        result = PyTuple_Pack(2, target.ts_arr, col.arr);
+    targets_release(&target, 1);
+    return result;
+}
+
+static PyObject *
+query_series(const bt_source *src, PyObject *args, PyObject *kwds)
+{
+    const char *entry_name, *field_name;
+    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
+    int threads = 0;
+    static char *kwlist[] = {"entry_name", "field_name", "t0", "t1", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOi", kwlist, &entry_name,
+                                     &field_name, &t0_obj, &t1_obj, &threads))
+        return NULL;
+
+    bt_extract x;
+    if (parse_time_range(src->schema, t0_obj, t1_obj, &x) < 0)
+        return NULL;
+
+    const bt_entry_info *entry = find_entry_by_name(src->schema, entry_name);
+    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+    const struct btelem_field_wire *field = find_field_by_name(entry, field_name);
+    if (!field) { PyErr_Format(PyExc_KeyError, "Unknown field: '%s'", field_name); return NULL; }
+
+    return series_extract(src, &x, entry, field, threads);
+}
+
+static PyObject *
+query_table(const bt_source *src, PyObject *args, PyObject *kwds)
+{
+    const char *entry_name;
+    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
+    int threads = 0;
+    static char *kwlist[] = {"entry_name", "t0", "t1", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOi", kwlist, &entry_name,
+                                     &t0_obj, &t1_obj, &threads))
+        return NULL;
+
+    bt_extract x;
+    if (parse_time_range(src->schema, t0_obj, t1_obj, &x) < 0)
+        return NULL;
+
+    const bt_entry_info *entry = find_entry_by_name(src->schema, entry_name);
+    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+
+    bt_column cols[BTELEM_MAX_FIELDS];
+    bt_target target = { .id = entry->id, .cols = cols };
+    for (uint16_t fi = 0; fi < entry->field_count; fi++) {
+        if (column_init(&cols[fi], &entry->fields[fi]) < 0)
+            return NULL;
+        target.ncols++;
+    }
+
+    PyObject *dict = NULL;
+    if (extract_run(src, &x, &target, 1, threads) == 0 && (dict = PyDict_New())) {
+        int rc = PyDict_SetItemString(dict, "_timestamp", target.ts_arr);
+        for (uint16_t fi = 0; fi < entry->field_count && rc == 0; fi++)
+            rc = PyDict_SetItemString(dict, entry->fields[fi].name, cols[fi].arr);
+        if (rc < 0)
+            Py_CLEAR(dict);
+    }
+    targets_release(&target, 1);
+    return dict;
+}
+
+/*
+ * series() for many fields in one pass over the data.  Fields of the same
+ * entry become one target and share a timestamp array.
+ */
+static PyObject *
+query_series_many(const bt_source *src, PyObject *args, PyObject *kwds)
+{
+    PyObject *fields_obj, *t0_obj = Py_None, *t1_obj = Py_None;
+    int threads = 0;
+    static char *kwlist[] = {"fields", "t0", "t1", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOi", kwlist, &fields_obj,
+                                     &t0_obj, &t1_obj, &threads))
+        return NULL;
+
+    bt_extract x;
+    if (parse_time_range(src->schema, t0_obj, t1_obj, &x) < 0)
+        return NULL;
+
+    PyObject *seq = PySequence_Fast(fields_obj,
+        "series_many() expects a sequence of (entry_name, field_name) pairs");
+    if (!seq)
+        return NULL;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+
+    bt_target *targets = calloc(n ? n : 1, sizeof(*targets));
+    bt_column *cols = calloc(n ? n : 1, sizeof(*cols));
+    const struct btelem_field_wire **req_field = calloc(n ? n : 1, sizeof(*req_field));
+    uint16_t *req_target = calloc(n ? n : 1, sizeof(*req_target));
+    uint16_t *req_col = calloc(n ? n : 1, sizeof(*req_col));
+    uint16_t ntargets = 0;
+    PyObject *result = NULL;
+    if (!targets || !cols || !req_field || !req_target || !req_col) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    /* Resolve names, grouping by entry */
+    for (Py_ssize_t i = 0; i < n; i++) {
+        const char *entry_name, *field_name;
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyTuple_Check(item) || !PyArg_ParseTuple(item, "ss", &entry_name, &field_name)) {
+            if (!PyErr_Occurred() || PyErr_ExceptionMatches(PyExc_TypeError)) {
+                PyErr_Clear();
+                PyErr_SetString(PyExc_TypeError,
+                                "series_many() expects (entry_name, field_name) pairs");
+            }
+            goto out;
+        }
+        const bt_entry_info *entry = find_entry_by_name(src->schema, entry_name);
+        if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); goto out; }
+        req_field[i] = find_field_by_name(entry, field_name);
+        if (!req_field[i]) { PyErr_Format(PyExc_KeyError, "Unknown field: '%s'", field_name); goto out; }
+
+        uint16_t ti = 0;
+        while (ti < ntargets && targets[ti].id != entry->id)
+            ti++;
+        if (ti == ntargets)
+            targets[ntargets++].id = entry->id;
+        req_target[i] = ti;
+        targets[ti].count++;        /* columns, until laid out below */
+    }
+
+    /* Give each target a contiguous run of columns */
+    Py_ssize_t next = 0;
+    for (uint16_t ti = 0; ti < ntargets; ti++) {
+        targets[ti].cols = cols + next;
+        next += targets[ti].count;
+        targets[ti].count = 0;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        bt_target *t = &targets[req_target[i]];
+        req_col[i] = t->ncols;
+        if (column_init(&t->cols[t->ncols], req_field[i]) < 0)
+            goto out;
+        t->ncols++;
+    }
+
+    if (extract_run(src, &x, targets, ntargets, threads) < 0)
+        goto out;
+
+    result = PyList_New(n);
+    for (Py_ssize_t i = 0; result && i < n; i++) {
+        const bt_target *t = &targets[req_target[i]];
+        PyObject *pair = PyTuple_Pack(2, t->ts_arr, t->cols[req_col[i]].arr);
+        if (!pair)
+            Py_CLEAR(result);
+        else
+            PyList_SET_ITEM(result, i, pair);
+    }
+
+out:
+    if (targets)
+        targets_release(targets, ntargets);
+    free(targets);
+    free(cols);
+    free(req_field);
+    free(req_target);
+    free(req_col);
+    Py_DECREF(seq);
+    return result;
+}
+
+/* =========================================================================
+ * CaptureObject (file-backed, mmap)
+ * ========================================================================= */
+
+typedef struct {
+    PyObject_HEAD
+    int         fd;
+    uint8_t    *map;
+    size_t      map_len;
+    uint8_t    *inflated;              /* expanded packets, if any were compressed */
+    const uint8_t *data;               /* map, or inflated; index offsets point here */
+    bt_schema   schema;
+    size_t      data_start;
+    size_t      data_end;
+    struct btelem_index_entry *index;  /* pointer into mmap or malloc'd */
+    uint32_t    index_count;
+    int         index_owned;           /* 1 if we malloc'd index (no footer) */
+    bt_id_index ids;                   /* into mmap; first == NULL without one */
+    int         busy;                  /* queries running without the GIL */
+} CaptureObject;
+
+static void
+Capture_dealloc(CaptureObject *self)
+{
+    if (self->index_owned && self->index)
+        free(self->index);
+    free(self->inflated);
+    if (self->map && self->map != MAP_FAILED)
+        munmap(self->map, self->map_len);
+    if (self->fd >= 0)
+        close(self->fd);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/* Build index by scanning packets sequentially (fallback when no footer) */
+static int
+Capture_build_index(CaptureObject *self)
+{
+    uint32_t cap = 64;
+    uint32_t count = 0;
+    struct btelem_index_entry *idx = malloc(cap * sizeof(*idx));
+    if (!idx) { PyErr_NoMemory(); return -1; }
+
+    size_t pos = self->data_start;
+    while (pos + sizeof(struct btelem_packet_header) <= self->map_len) {
+        const struct btelem_packet_header *ph =
+            (const struct btelem_packet_header *)(self->map + pos);
+
+        int compressed = (ph->flags & BTELEM_PACKET_FLAG_COMPRESSED) != 0;
+        size_t pkt_size = sizeof(*ph) + ph->payload_size;
+        if (!compressed)
+            pkt_size += (size_t)ph->entry_count * sizeof(struct btelem_entry_header);
+        if (pos + pkt_size > self->map_len) break;
+
+        /* Compressed packets get their range in Capture_inflate() */
+        uint64_t ts_min = 0, ts_max = 0;
+        if (!compressed)
+            packet_ts_range(self->map + pos, &ts_min, &ts_max);
+
+        if (count >= cap) {
+            cap *= 2;
+            struct btelem_index_entry *tmp = realloc(idx, cap * sizeof(*idx));
+            if (!tmp) { free(idx); PyErr_NoMemory(); return -1; }
+            idx = tmp;
+        }
+        idx[count].offset      = pos;
+        idx[count].ts_min      = ts_min;
+        idx[count].ts_max      = ts_max;
+        idx[count].entry_count = ph->entry_count;
+        count++;
+
+        pos += pkt_size;
+    }
+
+    self->index = idx;
+    self->index_count = count;
+    self->index_owned = 1;
+    self->data_end = pos;
+    return 0;
+}
+
+/* Expand compressed packets into an owned copy of the data section, with
+ * the index rebuilt to point into it.  No-op if nothing is compressed. */
+static int
+Capture_inflate(CaptureObject *self)
+{
+    size_t total = 0;
+    int any = 0;
+    for (uint32_t i = 0; i < self->index_count; i++) {
+        const struct btelem_index_entry *ie = &self->index[i];
+        if (ie->offset + sizeof(struct btelem_packet_header) > self->data_end)
+            goto bad;
+        const uint8_t *pkt = self->map + ie->offset;
+        const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+        size_t avail = self->data_end - ie->offset;
+        if (ph->flags & BTELEM_PACKET_FLAG_COMPRESSED) {
+            Py_ssize_t n = inflate_packet(pkt, avail, NULL, 0);
+            if (n < 0)
+                goto bad;
+            total += (size_t)n;
+            any = 1;
+        } else {
+            size_t n = sizeof(*ph)
+                + (size_t)ph->entry_count * sizeof(struct btelem_entry_header)
+                + ph->payload_size;
+            if (n > avail)
+                goto bad;
+            total += n;
+        }
+    }
+    if (!any) {
+        self->data = self->map;
+        return 0;
+    }
+
+    uint8_t *buf = malloc(total ? total : 1);
+    struct btelem_index_entry *idx = self->index;
+    if (!self->index_owned) {
+        idx = malloc((self->index_count ? self->index_count : 1) * sizeof(*idx));
+        if (idx)
+            memcpy(idx, self->index, self->index_count * sizeof(*idx));
+    }
+    if (!buf || !idx) {
+        free(buf);
+        if (idx != self->index)
+            free(idx);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    size_t pos = 0;
+    for (uint32_t i = 0; i < self->index_count; i++) {
+        const uint8_t *pkt = self->map + idx[i].offset;
+        const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+        size_t n;
+        if (ph->flags & BTELEM_PACKET_FLAG_COMPRESSED) {
+            n = (size_t)inflate_packet(pkt, self->data_end - idx[i].offset,
+                                       buf + pos, total - pos);
+        } else {
+            n = sizeof(*ph)
+                + (size_t)ph->entry_count * sizeof(struct btelem_entry_header)
+                + ph->payload_size;
+            memcpy(buf + pos, pkt, n);
+        }
+        uint64_t ts_min, ts_max;
+        packet_ts_range(buf + pos, &ts_min, &ts_max);
+        idx[i].offset = pos;
+        idx[i].ts_min = ts_min;
+        idx[i].ts_max = ts_max;
+        idx[i].entry_count = ph->entry_count;
+        pos += n;
+    }
+
+    self->index = idx;
+    self->index_owned = 1;
+    self->inflated = buf;
+    self->data = buf;
+    return 0;
+
+bad:
+    PyErr_SetString(PyExc_ValueError, "Corrupt packet in capture");
+    return -1;
+}
+
+/* Pick up the ID summary in front of the footer index, if there is one */
+static void
+Capture_load_ids(CaptureObject *self)
+{
+    size_t index_offset = self->data_end;
+    if (index_offset < self->data_start + sizeof(struct btelem_index_ids_footer))
+        return;
+    const struct btelem_index_ids_footer *ift = (const struct btelem_index_ids_footer *)
+        (self->map + index_offset - sizeof(*ift));
+    if (ift->magic != BTELEM_INDEX_IDS_MAGIC || ift->ids_offset < self->data_start)
+        return;
+    size_t size = ((size_t)self->index_count + 1) * 4
+                + (size_t)ift->id_count * sizeof(struct btelem_index_id)
+                + sizeof(*ift);
+    if (ift->ids_offset + size != index_offset)
+        return;
+
+    /* Ranges must be in order and inside the records */
+    const uint8_t *first = self->map + ift->ids_offset;
+    uint32_t prev = 0;
+    for (uint32_t i = 0; i <= self->index_count; i++) {
+        uint32_t v;
+        memcpy(&v, first + (size_t)i * 4, 4);
+        if (v < prev || v > ift->id_count)
+            return;
+        prev = v;
+    }
+    if (prev != ift->id_count)
+        return;
+
+    self->ids.first = first;
+    self->ids.recs = (const struct btelem_index_id *)
+        (first + ((size_t)self->index_count + 1) * 4);
+    self->data_end = ift->ids_offset;
+}
+
+static int
+Capture_init(CaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    const char *path;
     if (!PyArg_ParseTuple(args, "s", &path))
         return -1;
 
     self->fd = -1;
     self->map = MAP_FAILED;
+    self->inflated = NULL;
+    self->data = NULL;
     self->index = NULL;
     self->index_owned = 0;
+    self->ids.first = NULL;
+    self->ids.recs = NULL;
+    self->busy = 0;
 
     self->fd = open(path, O_RDONLY);
     if (self->fd < 0) {
@@ -515,6 +1523,7 @@ Capture_init(CaptureObject *self, PyObject *args, PyObject *kwds)
                 self->index_count = ft->index_count;
                 self->index_owned = 0;
                 self->data_end = ft->index_offset;
+                Capture_load_ids(self);
             }
         }
     }
@@ -526,283 +1535,581 @@ Capture_init(CaptureObject *self, PyObject *args, PyObject *kwds)
             return -1;
     }
 
-    return 0;
+    return Capture_inflate(self);
 }
 
 /* -------------------------------------------------------------------------
  * Capture methods
  * ------------------------------------------------------------------------- */
 
+static void
+capture_source(CaptureObject *self, bt_source *src)
+{
+    src->one.data = self->data;
+    src->one.index = self->index;
+    src->one.count = self->index_count;
+    src->parts = &src->one;
+    src->nparts = 1;
+    src->ids = &self->ids;
+    src->schema = &self->schema;
+    src->busy = &self->busy;
+}
+
 static PyObject *
 Capture_series(CaptureObject *self, PyObject *args, PyObject *kwds)
 {
-    const char *entry_name, *field_name = NULL;
-    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
-    static char *kwlist[] = {"entry_name", "field_name", "t0", "t1", NULL};
+    bt_source src;
+    capture_source(self, &src);
+    return query_series(&src, args, kwds);
+}
+
+static PyObject *
+Capture_series_many(CaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    bt_source src;
+    capture_source(self, &src);
+    return query_series_many(&src, args, kwds);
+}
+
+static PyObject *
+Capture_table(CaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    bt_source src;
+    capture_source(self, &src);
+    return query_table(&src, args, kwds);
+}
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|sOO", kwlist,
-                                     &entry_name, &field_name, &t0_obj, &t1_obj))
+static PyObject *
+Capture_close(CaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Capture is in use by another thread");
         return NULL;
+    }
+    if (self->index_owned && self->index) {
+        free(self->index);
+        self->index = NULL;
+    }
+    free(self->inflated);
+    self->inflated = NULL;
+    self->data = NULL;
+    self->index_count = 0;
+    self->ids.first = NULL;
+    self->ids.recs = NULL;
+    if (self->map && self->map != MAP_FAILED) {
+        munmap(self->map, self->map_len);
+        self->map = NULL;
+    }
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    Py_RETURN_NONE;
+}
 
-    uint64_t t0 = 0, t1 = 0;
-    int use_t0 = (t0_obj != Py_None);
-    int use_t1 = (t1_obj != Py_None);
-    if (use_t0) { t0 = PyLong_AsUnsignedLongLong(t0_obj); if (PyErr_Occurred()) return NULL; }
-    if (use_t1) { t1 = PyLong_AsUnsignedLongLong(t1_obj); if (PyErr_Occurred()) return NULL; }
+static PyObject *
+Capture_enter(CaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
 
-    const bt_entry_info *entry = find_entry_by_name(&self->schema, entry_name);
-    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+static PyObject *
+Capture_exit(CaptureObject *self, PyObject *args)
+{
+    return Capture_close(self, NULL);
+}
 
-    if (!field_name) { PyErr_SetString(PyExc_TypeError, "series() requires field_name"); return NULL; }
-    const struct btelem_field_wire *field = find_field_by_name(entry, field_name);
-    if (!field) { PyErr_Format(PyExc_KeyError, "Unknown field: '%s'", field_name); return NULL; }
+static PyObject *
+Capture_entry_counts(CaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    bt_source src;
+    capture_source(self, &src);
+    return entry_counts_from_index(src.parts, src.nparts, src.ids, &self->schema);
+}
 
-    int npy_type = type_to_npy(field->type);
-    if (npy_type < 0) {
-        /* BITFIELD: select NPY dtype from storage size */
-        if (field->type == BTELEM_BITFIELD) {
-            switch (field->size) {
-            case 1: npy_type = NPY_UINT8; break;
-            case 2: npy_type = NPY_UINT16; break;
-            case 4: npy_type = NPY_UINT32; break;
-            default: PyErr_Format(PyExc_ValueError, "Unsupported bitfield size: %d", field->size); return NULL;
-            }
-        } else {
-            PyErr_Format(PyExc_ValueError, "Unsupported field type: %d", field->type); return NULL;
-        }
-    }
+static PyObject *
+Capture_get_time_range(CaptureObject *self, void *Py_UNUSED(closure))
+{
+    if (self->index_count == 0)
+        Py_RETURN_NONE;
+    uint64_t ts_min = clock_to_ns(&self->schema.clock, self->index[0].ts_min);
+    uint64_t ts_max = clock_to_ns(&self->schema.clock,
+                                  self->index[self->index_count - 1].ts_max);
+    return Py_BuildValue("(KK)", ts_min, ts_max);
+}
 
-    int elem_sz = type_element_size(field->type);
-    int field_bytes = (elem_sz > 0) ? elem_sz * field->count : field->size;
+static PyGetSetDef Capture_getset[] = {
+    {"time_range", (getter)Capture_get_time_range, NULL,
+     "Global (ts_min, ts_max) in nanoseconds, or None if empty.", NULL},
+    {NULL}
+};
 
-    /* Exact count pass (reads entry headers only), then allocate + fill. */
-    npy_intp count = count_entries_exact(self->map, self->index, self->index_count,
-                                         entry->id, t0, use_t0, t1, use_t1);
+static PyMethodDef Capture_methods[] = {
+    {"series", (PyCFunction)Capture_series, METH_VARARGS | METH_KEYWORDS,
+     "series(entry_name, field_name, t0=None, t1=None, threads=0) -> (timestamps, values)"},
+    {"series_many", (PyCFunction)Capture_series_many, METH_VARARGS | METH_KEYWORDS,
+     "series_many(fields, t0=None, t1=None, threads=0) -> [(timestamps, values), ...]\n"
+     "Extract each (entry_name, field_name) pair of *fields* in one pass;\n"
+     "fields of the same entry share one timestamps array."},
+    {"table", (PyCFunction)Capture_table, METH_VARARGS | METH_KEYWORDS,
+     "table(entry_name, t0=None, t1=None, threads=0) -> dict of numpy arrays"},
+    {"entry_counts", (PyCFunction)Capture_entry_counts, METH_NOARGS,
+     "entry_counts() -> {entry_name: count} from index (no data extraction)."},
+    {"close", (PyCFunction)Capture_close, METH_NOARGS, "Close the file."},
+    {"__enter__", (PyCFunction)Capture_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)Capture_exit, METH_VARARGS, NULL},
+    {NULL}
+};
 
-    npy_intp ts_dims[1] = {count};
-    PyObject *ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
-    if (!ts_arr) return NULL;
+static PyTypeObject CaptureType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "btelem._native.Capture",
+    .tp_basicsize = sizeof(CaptureObject),
+    .tp_dealloc = (destructor)Capture_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "File-backed telemetry capture with mmap and numpy extraction.\n\n"
+              "Queries split the index across `threads` threads (0 = one per\n"
+              "CPU) and release the GIL while they run.",
+    .tp_methods = Capture_methods,
+    .tp_getset = Capture_getset,
+    .tp_init = (initproc)Capture_init,
+    .tp_new = PyType_GenericNew,
+};
 
-    PyObject *val_arr;
-    if (field->count > 1) {
-        npy_intp dims[2] = {count, field->count};
-        val_arr = PyArray_SimpleNew(2, dims, npy_type);
-    } else {
-        npy_intp dims[1] = {count};
-        val_arr = PyArray_SimpleNew(1, dims, npy_type);
-    }
-    if (!val_arr) { Py_DECREF(ts_arr); return NULL; }
+/* =========================================================================
+ * LiveCaptureObject (accumulator, transport-agnostic)
+ *
+ * Packets are appended to fixed-size segments, each with its own index.
+ * The rolling window (max_packets, max_bytes) drops whole segments from the
+ * front, so eviction never moves packet data; a segment holds at most a
+ * quarter of either limit, so at least three quarters of the window stays.
+ * The last dropped segment is kept as a spare for the next one.  Queries
+ * see the segments as parts, except series(), which reads the column cache.
+ * ========================================================================= */
 
-    if (count > 0)
-        fill_series(self->map, self->index, self->index_count,
-                    entry->id, field, t0, use_t0, t1, use_t1,
-                    PyArray_DATA((PyArrayObject *)ts_arr),
-                    PyArray_DATA((PyArrayObject *)val_arr),
-                    count, field_bytes);
+#ifndef BTELEM_LIVE_SEGMENT_BYTES
+#define BTELEM_LIVE_SEGMENT_BYTES (4u << 20)
+#endif
 
-    PyObject *result = PyTuple_Pack(2, ts_arr, val_arr);
-    Py_DECREF(ts_arr);
-    Py_DECREF(val_arr);
-    return result;
-}
+typedef struct {
+    uint8_t                   *buf;
+    size_t                     len;
+    size_t                     cap;
+    struct btelem_index_entry *index;       /* offsets into buf */
+    uint32_t                   count;
+    uint32_t                   index_cap;
+    uint64_t                   entries;
+} bt_segment;
 
-static PyObject *
-Capture_table(CaptureObject *self, PyObject *args, PyObject *kwds)
-{
-    const char *entry_name;
-    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
-    static char *kwlist[] = {"entry_name", "t0", "t1", NULL};
+/*
+ * Column cache: series() keeps each (entry, field) it is asked for as a
+ * column of raw-tick timestamps and values, appended to as packets arrive
+ * and trimmed as segments are dropped, so later calls copy rows out rather
+ * than rescanning every packet.  seg_rows counts the rows each segment
+ * added, parallel to segs.
+ */
+typedef struct {
+    bt_column  col;                 /* field and dtype; arr/out unused */
+    uint16_t   id;
+    uint16_t   next;                /* next column with this ID, + 1 (0 = end) */
+    uint64_t  *ts;                  /* ticks */
+    uint8_t   *vals;
+    size_t     head;                /* first live row */
+    size_t     count;
+    size_t     cap;
+    uint32_t  *seg_rows;            /* seg_cap long */
+    int        sorted;              /* timestamps never went backwards */
+} bt_live_column;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OO", kwlist,
-                                     &entry_name, &t0_obj, &t1_obj))
-        return NULL;
+typedef struct {
+    PyObject_HEAD
+    bt_schema                  schema;
+    bt_segment                *segs;              /* oldest first */
+    uint32_t                   seg_count;
+    uint32_t                   seg_cap;
+    bt_part                   *parts;             /* query view of segs, seg_cap long */
+    bt_segment                 spare;             /* buf == NULL: none */
+    uint64_t                   packets;           /* held, all segments */
+    uint64_t                   bytes;             /* packet bytes held */
+    uint32_t                   max_packets;       /* 0 = unlimited */
+    uint64_t                   max_bytes;         /* 0 = unlimited */
+    uint64_t                   truncated_packets;
+    uint64_t                   truncated_entries;
+    bt_live_column            *cols;
+    uint16_t                   col_count;
+    uint16_t                   col_cap;
+    uint16_t                  *col_by_id;         /* entry ID -> first column + 1 */
+    pthread_mutex_t            lock;              /* all of the above, vs. rx */
+    int                        busy;              /* queries running without the GIL */
+    struct bt_receiver        *rx;                /* attach_socket() thread, or NULL */
+    int                        ready;             /* __init__ done; never re-run */
+} LiveCaptureObject;
 
-    uint64_t t0 = 0, t1 = 0;
-    int use_t0 = (t0_obj != Py_None);
-    int use_t1 = (t1_obj != Py_None);
-    if (use_t0) { t0 = PyLong_AsUnsignedLongLong(t0_obj); if (PyErr_Occurred()) return NULL; }
-    if (use_t1) { t1 = PyLong_AsUnsignedLongLong(t1_obj); if (PyErr_Occurred()) return NULL; }
+/* Take self->lock from a Python thread.  The GIL is let go while waiting,
+ * so a holder that runs Python code (and so may switch threads) can finish. */
+static void
+live_lock(LiveCaptureObject *self)
+{
+    if (pthread_mutex_trylock(&self->lock) != 0) {
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->lock);
+        Py_END_ALLOW_THREADS
+    }
+}
 
-    const bt_entry_info *entry = find_entry_by_name(&self->schema, entry_name);
-    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+static void
+live_unlock(LiveCaptureObject *self)
+{
+    pthread_mutex_unlock(&self->lock);
+}
 
-    npy_intp count = count_entries_exact(self->map, self->index, self->index_count,
-                                         entry->id, t0, use_t0, t1, use_t1);
+static void
+segment_free(bt_segment *seg)
+{
+    free(seg->buf);
+    free(seg->index);
+    memset(seg, 0, sizeof(*seg));
+}
 
-    npy_intp ts_dims[1] = {count};
-    PyObject *ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
-    if (!ts_arr) return NULL;
+static void
+live_columns_free(LiveCaptureObject *self)
+{
+    for (uint16_t i = 0; i < self->col_count; i++) {
+        free(self->cols[i].ts);
+        free(self->cols[i].vals);
+        free(self->cols[i].seg_rows);
+    }
+    free(self->cols);
+    free(self->col_by_id);
+    self->cols = NULL;
+    self->col_by_id = NULL;
+    self->col_count = 0;
+    self->col_cap = 0;
+}
 
-    PyObject **field_pyarrs = calloc(entry->field_count, sizeof(PyObject *));
-    uint8_t **field_ptrs = calloc(entry->field_count, sizeof(uint8_t *));
-    int *field_sizes = calloc(entry->field_count, sizeof(int));
-    if (!field_pyarrs || !field_ptrs || !field_sizes) {
-        Py_DECREF(ts_arr);
-        free(field_pyarrs); free(field_ptrs); free(field_sizes);
-        return PyErr_NoMemory();
+/* Room for one more row: reclaim evicted rows once they are half, else grow */
+static int
+live_column_reserve(bt_live_column *c)
+{
+    size_t sz = (size_t)c->col.size;
+    if (c->head + c->count < c->cap)
+        return 0;
+    if (c->head && c->head >= c->cap / 2) {
+        memmove(c->ts, c->ts + c->head, c->count * sizeof(*c->ts));
+        memmove(c->vals, c->vals + c->head * sz, c->count * sz);
+        c->head = 0;
+        return 0;
     }
+    size_t cap = c->cap ? c->cap * 2 : 256;
+    uint64_t *ts = realloc(c->ts, cap * sizeof(*ts));
+    if (!ts)
+        return -1;
+    c->ts = ts;
+    size_t vbytes = cap * sz;
+    uint8_t *vals = realloc(c->vals, vbytes ? vbytes : 1);
+    if (!vals)
+        return -1;
+    c->vals = vals;
+    c->cap = cap;
+    return 0;
+}
 
-    for (uint16_t fi = 0; fi < entry->field_count; fi++) {
-        const struct btelem_field_wire *f = &entry->fields[fi];
-        int npy_type = type_to_npy(f->type);
-        int elem_sz = type_element_size(f->type);
-        if (npy_type < 0 && f->type == BTELEM_BITFIELD) {
-            switch (f->size) {
-            case 1: npy_type = NPY_UINT8; break;
-            case 2: npy_type = NPY_UINT16; break;
-            case 4: npy_type = NPY_UINT32; break;
-            default: npy_type = NPY_UINT8; break;
-            }
-        }
-        field_sizes[fi] = (elem_sz > 0) ? elem_sz * f->count : f->size;
+static int
+live_column_push(bt_live_column *c, const struct btelem_entry_header *eh,
+                 const uint8_t *payload_base)
+{
+    if (live_column_reserve(c) < 0)
+        return -1;
+    size_t row = c->head + c->count;
+    size_t sz = (size_t)c->col.size;
+    if (c->count && eh->timestamp < c->ts[row - 1])
+        c->sorted = 0;
+    c->ts[row] = eh->timestamp;
+    if (c->col.field->offset + sz <= eh->payload_size)
+        memcpy(c->vals + row * sz, payload_base + eh->payload_offset + c->col.field->offset, sz);
+    else
+        memset(c->vals + row * sz, 0, sz);
+    c->count++;
+    return 0;
+}
 
-        if (f->count > 1) {
-            npy_intp dims[2] = {count, f->count};
-            field_pyarrs[fi] = PyArray_SimpleNew(2, dims, npy_type);
-        } else {
-            npy_intp dims[1] = {count};
-            field_pyarrs[fi] = PyArray_SimpleNew(1, dims, npy_type);
-        }
-        if (!field_pyarrs[fi]) {
-            for (uint16_t j = 0; j < fi; j++) Py_XDECREF(field_pyarrs[j]);
-            Py_DECREF(ts_arr);
-            free(field_pyarrs); free(field_ptrs); free(field_sizes);
-            return NULL;
+/* Append the entries of a packet stored in segment seg to the columns.  On
+ * failure the cache is dropped (it would miss rows) and -1 returned; no
+ * Python exception is set, as the receive thread comes through here.
+ * Stored packets passed packet_layout_ok() (or were inflated) on ingest,
+ * so every payload lies inside the packet; live_column_push() zero-fills
+ * fields past a payload shorter than the schema says. */
+static int
+live_columns_add(LiveCaptureObject *self, const uint8_t *pkt, uint32_t seg)
+{
+    const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(pkt + sizeof(*ph));
+    const uint8_t *payload_base = (const uint8_t *)&table[ph->entry_count];
+
+    for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
+        for (uint16_t ci = self->col_by_id[table[ei].id]; ci; ci = self->cols[ci - 1].next) {
+            bt_live_column *c = &self->cols[ci - 1];
+            if (live_column_push(c, &table[ei], payload_base) < 0) {
+                live_columns_free(self);
+                return -1;
+            }
+            c->seg_rows[seg]++;
         }
-        field_ptrs[fi] = PyArray_DATA((PyArrayObject *)field_pyarrs[fi]);
     }
+    return 0;
+}
 
-    if (count > 0)
-        fill_table(self->map, self->index, self->index_count,
-                   entry->id, entry, t0, use_t0, t1, use_t1,
-                   PyArray_DATA((PyArrayObject *)ts_arr),
-                   field_ptrs, field_sizes, count);
+/* The cached column for (id, field), built from the packets held if new */
+static bt_live_column *
+live_column_get(LiveCaptureObject *self, uint16_t id, const struct btelem_field_wire *field)
+{
+    for (uint16_t i = 0; i < self->col_count; i++)
+        if (self->cols[i].id == id && self->cols[i].col.field == field)
+            return &self->cols[i];
 
-    PyObject *dict = PyDict_New();
-    if (!dict) {
-        Py_DECREF(ts_arr);
-        for (uint16_t fi = 0; fi < entry->field_count; fi++)
-            Py_XDECREF(field_pyarrs[fi]);
-        free(field_pyarrs); free(field_ptrs); free(field_sizes);
+    if (self->col_count == UINT16_MAX) {
+        PyErr_SetString(PyExc_RuntimeError, "Too many cached columns");
         return NULL;
     }
+    if (!self->col_by_id) {
+        self->col_by_id = calloc(65536, sizeof(*self->col_by_id));
+        if (!self->col_by_id)
+            return (bt_live_column *)PyErr_NoMemory();
+    }
+    if (self->col_count == self->col_cap) {
+        uint32_t cap = self->col_cap ? self->col_cap * 2u : 8u;
+        if (cap > UINT16_MAX)
+            cap = UINT16_MAX;
+        bt_live_column *cols = realloc(self->cols, cap * sizeof(*cols));
+        if (!cols)
+            return (bt_live_column *)PyErr_NoMemory();
+        self->cols = cols;
+        self->col_cap = (uint16_t)cap;
+    }
 
-    PyDict_SetItemString(dict, "_timestamp", ts_arr);
-    Py_DECREF(ts_arr);
-    for (uint16_t fi = 0; fi < entry->field_count; fi++) {
-        PyDict_SetItemString(dict, entry->fields[fi].name, field_pyarrs[fi]);
-        Py_DECREF(field_pyarrs[fi]);
+    /* Not counted in col_count until complete: failures free it here */
+    bt_live_column *c = &self->cols[self->col_count];
+    memset(c, 0, sizeof(*c));
+    if (column_init(&c->col, field) < 0)
+        goto fail;
+    c->id = id;
+    c->sorted = 1;
+    c->seg_rows = calloc(self->seg_cap ? self->seg_cap : 1, sizeof(*c->seg_rows));
+    if (!c->seg_rows) {
+        PyErr_NoMemory();
+        goto fail;
     }
 
-    free(field_pyarrs);
-    free(field_ptrs);
-    free(field_sizes);
-    return dict;
+    for (uint32_t si = 0; si < self->seg_count; si++) {
+        const bt_segment *seg = &self->segs[si];
+        for (uint32_t pi = 0; pi < seg->count; pi++) {
+            const uint8_t *pkt = seg->buf + seg->index[pi].offset;
+            const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+            const struct btelem_entry_header *table =
+                (const struct btelem_entry_header *)(pkt + sizeof(*ph));
+            const uint8_t *payload_base = (const uint8_t *)&table[ph->entry_count];
+            for (uint16_t ei = 0; ei < ph->entry_count; ei++) {
+                if (table[ei].id != id)
+                    continue;
+                if (live_column_push(c, &table[ei], payload_base) < 0) {
+                    PyErr_NoMemory();
+                    goto fail;
+                }
+                c->seg_rows[si]++;
+            }
+        }
+    }
+
+    c->next = self->col_by_id[id];
+    self->col_by_id[id] = ++self->col_count;
+    return c;
+
+fail:
+    free(c->ts);
+    free(c->vals);
+    free(c->seg_rows);
+    memset(c, 0, sizeof(*c));
+    return NULL;
 }
 
+/* (timestamps, values) from a cached column, rows within x's t0/t1 */
 static PyObject *
-Capture_close(CaptureObject *self, PyObject *Py_UNUSED(ignored))
+live_column_series(LiveCaptureObject *self, const bt_live_column *c, const bt_extract *x)
 {
-    if (self->index_owned && self->index) {
-        free(self->index);
-        self->index = NULL;
+    const uint64_t *ts = c->ts + c->head;
+    size_t sz = (size_t)c->col.size;
+    const uint8_t *vals = c->vals + c->head * sz;
+    size_t lo = 0, hi = c->count;
+    npy_intp n = 0;
+
+    if (c->sorted) {
+        size_t a = 0, b = c->count;
+        if (x->use_t0) {
+            while (a < b) {
+                size_t mid = a + (b - a) / 2;
+                if (ts[mid] < x->t0) a = mid + 1; else b = mid;
+            }
+            lo = a;
+        }
+        if (x->use_t1) {
+            a = lo; b = c->count;
+            while (a < b) {
+                size_t mid = a + (b - a) / 2;
+                if (ts[mid] <= x->t1) a = mid + 1; else b = mid;
+            }
+            hi = a;
+        }
+        n = (npy_intp)(hi - lo);
+    } else {
+        for (size_t i = 0; i < c->count; i++)
+            n += entry_inside(x, ts[i]);
     }
-    if (self->map && self->map != MAP_FAILED) {
-        munmap(self->map, self->map_len);
-        self->map = NULL;
+
+    npy_intp ts_dims[1] = {n};
+    PyObject *ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
+    if (!ts_arr)
+        return NULL;
+    npy_intp dims[2] = {n, c->col.width};
+    PyObject *val_arr = PyArray_SimpleNew(c->col.width ? 2 : 1, dims, c->col.npy_type);
+    if (!val_arr) {
+        Py_DECREF(ts_arr);
+        return NULL;
     }
-    if (self->fd >= 0) {
-        close(self->fd);
-        self->fd = -1;
+    uint64_t *ts_out = PyArray_DATA((PyArrayObject *)ts_arr);
+    uint8_t *val_out = PyArray_DATA((PyArrayObject *)val_arr);
+    const bt_clock *clock = &self->schema.clock;
+
+    if (c->sorted) {
+        if (clock->tick_hz)
+            for (npy_intp i = 0; i < n; i++)
+                ts_out[i] = clock_to_ns(clock, ts[lo + i]);
+        else
+            memcpy(ts_out, ts + lo, (size_t)n * sizeof(*ts));
+        memcpy(val_out, vals + lo * sz, (size_t)n * sz);
+    } else {
+        npy_intp j = 0;
+        for (size_t i = 0; i < c->count; i++) {
+            if (!entry_inside(x, ts[i]))
+                continue;
+            ts_out[j] = clock_to_ns(clock, ts[i]);
+            memcpy(val_out + j * sz, vals + i * sz, sz);
+            j++;
+        }
     }
-    Py_RETURN_NONE;
-}
 
-static PyObject *
-Capture_enter(CaptureObject *self, PyObject *Py_UNUSED(ignored))
-{
-    Py_INCREF(self);
-    return (PyObject *)self;
+    PyObject *result = PyTuple_Pack(2, ts_arr, val_arr);
+    Py_DECREF(ts_arr);
+    Py_DECREF(val_arr);
+    return result;
 }
 
-static PyObject *
-Capture_exit(CaptureObject *self, PyObject *args)
+/* Drop the oldest segment, keeping its memory as the spare */
+static void
+LiveCapture_drop_oldest(LiveCaptureObject *self)
 {
-    return Capture_close(self, NULL);
-}
+    for (uint16_t i = 0; i < self->col_count; i++) {
+        bt_live_column *c = &self->cols[i];
+        c->head += c->seg_rows[0];
+        c->count -= c->seg_rows[0];
+        if (!c->count) {
+            c->head = 0;
+            c->sorted = 1;
+        }
+        memmove(&c->seg_rows[0], &c->seg_rows[1], (self->seg_count - 1) * sizeof(*c->seg_rows));
+    }
 
-static PyObject *
-Capture_entry_counts(CaptureObject *self, PyObject *Py_UNUSED(ignored))
-{
-    return entry_counts_from_index(self->map, self->index, self->index_count,
-                                   &self->schema);
+    bt_segment *seg = &self->segs[0];
+    self->packets -= seg->count;
+    self->bytes -= seg->len;
+    segment_free(&self->spare);
+    self->spare = *seg;
+    self->spare.len = 0;
+    self->spare.count = 0;
+    self->spare.entries = 0;
+    memmove(&self->segs[0], &self->segs[1], (self->seg_count - 1) * sizeof(*seg));
+    self->seg_count--;
 }
 
-static PyObject *
-Capture_get_time_range(CaptureObject *self, void *Py_UNUSED(closure))
+/* Segment with room for a pkt_len-byte packet, starting one if needed;
+ * NULL when out of memory (no exception set) */
+static bt_segment *
+LiveCapture_tail(LiveCaptureObject *self, size_t pkt_len)
 {
-    if (self->index_count == 0)
-        Py_RETURN_NONE;
-    uint64_t ts_min = self->index[0].ts_min;
-    uint64_t ts_max = self->index[self->index_count - 1].ts_max;
-    return Py_BuildValue("(KK)", ts_min, ts_max);
-}
-
-static PyGetSetDef Capture_getset[] = {
-    {"time_range", (getter)Capture_get_time_range, NULL,
-     "Global (ts_min, ts_max) in nanoseconds, or None if empty.", NULL},
-    {NULL}
-};
+    size_t seg_bytes = BTELEM_LIVE_SEGMENT_BYTES;
+    if (self->max_bytes && self->max_bytes / 4 < seg_bytes)
+        seg_bytes = self->max_bytes / 4;
+    uint32_t seg_packets = self->max_packets ? self->max_packets / 4 : UINT32_MAX;
+    if (seg_packets == 0)
+        seg_packets = 1;
+
+    if (self->seg_count) {
+        bt_segment *tail = &self->segs[self->seg_count - 1];
+        if (tail->len + pkt_len <= tail->cap && tail->count < seg_packets)
+            return tail;
+    }
 
-static PyMethodDef Capture_methods[] = {
-    {"series", (PyCFunction)Capture_series, METH_VARARGS | METH_KEYWORDS,
-     "series(entry_name, field_name, t0=None, t1=None) -> (timestamps, values)"},
-    {"table", (PyCFunction)Capture_table, METH_VARARGS | METH_KEYWORDS,
-     "table(entry_name, t0=None, t1=None) -> dict of numpy arrays"},
-    {"entry_counts", (PyCFunction)Capture_entry_counts, METH_NOARGS,
-     "entry_counts() -> {entry_name: count} from index (no data extraction)."},
-    {"close", (PyCFunction)Capture_close, METH_NOARGS, "Close the file."},
-    {"__enter__", (PyCFunction)Capture_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)Capture_exit, METH_VARARGS, NULL},
-    {NULL}
-};
+    if (self->seg_count == self->seg_cap) {
+        uint32_t cap = self->seg_cap ? self->seg_cap * 2 : 8;
+        bt_segment *segs = realloc(self->segs, cap * sizeof(*segs));
+        if (!segs) return NULL;
+        self->segs = segs;
+        bt_part *parts = realloc(self->parts, cap * sizeof(*parts));
+        if (!parts) return NULL;
+        self->parts = parts;
+        for (uint16_t i = 0; i < self->col_count; i++) {
+            uint32_t *rows = realloc(self->cols[i].seg_rows, cap * sizeof(*rows));
+            if (!rows) return NULL;
+            self->cols[i].seg_rows = rows;
+        }
+        self->seg_cap = cap;
+    }
 
-static PyTypeObject CaptureType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "btelem._native.Capture",
-    .tp_basicsize = sizeof(CaptureObject),
-    .tp_dealloc = (destructor)Capture_dealloc,
-    .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_doc = "File-backed telemetry capture with mmap and numpy extraction.",
-    .tp_methods = Capture_methods,
-    .tp_getset = Capture_getset,
-    .tp_init = (initproc)Capture_init,
-    .tp_new = PyType_GenericNew,
-};
+    size_t cap = pkt_len > seg_bytes ? pkt_len : seg_bytes;
+    bt_segment seg = self->spare;
+    memset(&self->spare, 0, sizeof(self->spare));
+    if (seg.cap < cap) {
+        free(seg.buf);
+        seg.buf = malloc(cap);
+        seg.cap = cap;
+    }
+    if (!seg.index) {
+        seg.index_cap = 64;
+        seg.index = malloc(seg.index_cap * sizeof(*seg.index));
+    }
+    if (!seg.buf || !seg.index) {
+        segment_free(&seg);
+        return NULL;
+    }
+    for (uint16_t i = 0; i < self->col_count; i++)
+        self->cols[i].seg_rows[self->seg_count] = 0;
+    self->segs[self->seg_count] = seg;
+    return &self->segs[self->seg_count++];
+}
 
-/* =========================================================================
- * LiveCaptureObject (accumulator, transport-agnostic)
- * ========================================================================= */
+static int receiver_stop(LiveCaptureObject *self);
 
-typedef struct {
-    PyObject_HEAD
-    bt_schema                  schema;
-    uint8_t                   *buf;
-    size_t                     buf_len;
-    size_t                     buf_cap;
-    struct btelem_index_entry *index;
-    uint32_t                   index_count;
-    uint32_t                   index_cap;
-    uint32_t                   max_packets;       /* 0 = unlimited */
-    uint64_t                   truncated_packets;
-    uint64_t                   truncated_entries;
-} LiveCaptureObject;
+static PyObject *
+LiveCapture_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    LiveCaptureObject *self = (LiveCaptureObject *)PyType_GenericNew(type, args, kwds);
+    if (self)
+        pthread_mutex_init(&self->lock, NULL);
+    return (PyObject *)self;
+}
 
 static void
 LiveCapture_dealloc(LiveCaptureObject *self)
 {
-    free(self->buf);
-    free(self->index);
+    receiver_stop(self);
+    pthread_mutex_destroy(&self->lock);
+    for (uint32_t i = 0; i < self->seg_count; i++)
+        segment_free(&self->segs[i]);
+    segment_free(&self->spare);
+    free(self->segs);
+    free(self->parts);
+    live_columns_free(self);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -811,11 +2118,20 @@ LiveCapture_init(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
 {
     Py_buffer schema_buf;
     unsigned int max_packets = 0;
-    static char *kwlist[] = {"schema_bytes", "max_packets", NULL};
+    unsigned long long max_bytes = 0;
+    static char *kwlist[] = {"schema_bytes", "max_packets", "max_bytes", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*|I", kwlist,
-                                     &schema_buf, &max_packets))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*|IK", kwlist,
+                                     &schema_buf, &max_packets, &max_bytes))
+        return -1;
+    /* Queries without the GIL and the receive thread hold pointers into
+     * the schema, and the held packets and columns were decoded with it:
+     * a new schema needs a new LiveCapture */
+    if (self->ready) {
+        PyBuffer_Release(&schema_buf);
+        PyErr_SetString(PyExc_RuntimeError, "LiveCapture is already initialised");
         return -1;
+    }
 
     if (parse_schema(schema_buf.buf, schema_buf.len, &self->schema) < 0) {
         PyBuffer_Release(&schema_buf);
@@ -824,105 +2140,124 @@ LiveCapture_init(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
     }
     PyBuffer_Release(&schema_buf);
 
-    self->buf_cap = 4096;
-    self->buf = malloc(self->buf_cap);
-    self->buf_len = 0;
-
-    self->index_cap = 64;
-    self->index = malloc(self->index_cap * sizeof(*self->index));
-    self->index_count = 0;
-
     self->max_packets = max_packets;
-    self->truncated_packets = 0;
-    self->truncated_entries = 0;
+    self->max_bytes = max_bytes;
+    self->ready = 1;
+    return 0;
+}
 
-    if (!self->buf || !self->index) {
-        free(self->buf); self->buf = NULL;
-        free(self->index); self->index = NULL;
-        PyErr_NoMemory();
-        return -1;
+/* LiveCapture_ingest_one() results; live_ingest_raise() turns them into
+ * exceptions */
+enum {
+    BT_INGEST_OK = 0,
+    BT_INGEST_SHORT = -1,
+    BT_INGEST_MALFORMED = -2,
+    BT_INGEST_NOMEM = -3,
+    BT_INGEST_OVERSIZE = -4,        /* stream framing only */
+};
+
+static const char *
+live_ingest_message(int rc)
+{
+    switch (rc) {
+    case BT_INGEST_SHORT:     return "Packet too small";
+    case BT_INGEST_MALFORMED: return "Malformed packet";
+    case BT_INGEST_OVERSIZE:  return "Packet length exceeds limit (stream out of sync?)";
+    default:                  return "Out of memory";
     }
+}
 
-    return 0;
+static void
+live_ingest_raise(int rc)
+{
+    if (rc == BT_INGEST_NOMEM)
+        PyErr_NoMemory();
+    else
+        PyErr_SetString(PyExc_ValueError, live_ingest_message(rc));
 }
 
 /*
- * Internal: ingest a single raw packet (no Python objects).
- * Returns 0 on success, -1 on error (sets Python exception).
+ * Internal: ingest a single raw packet.  Touches no Python objects and
+ * sets no exception, so the receive thread can call it without the GIL
+ * (holding self->lock).  Returns BT_INGEST_OK or an error code.
  */
 static int
 LiveCapture_ingest_one(LiveCaptureObject *self, const uint8_t *data, size_t pkt_len)
 {
-    if (pkt_len < sizeof(struct btelem_packet_header)) {
-        PyErr_SetString(PyExc_ValueError, "Packet too small");
-        return -1;
+    if (pkt_len < sizeof(struct btelem_packet_header))
+        return BT_INGEST_SHORT;
+
+    /* Clock update: refresh the calibration, nothing to store */
+    uint16_t flags;
+    memcpy(&flags, data + 2, 2);
+    if (flags & BTELEM_PACKET_FLAG_CLOCK) {
+        bt_clock clk;
+        parse_clock(data, pkt_len, sizeof(struct btelem_packet_header), &clk);
+        if (clk.tick_hz)
+            self->schema.clock = clk;
+        return BT_INGEST_OK;
     }
 
-    /* Ensure buffer capacity */
-    while (self->buf_len + pkt_len > self->buf_cap) {
-        size_t new_cap = self->buf_cap * 2;
-        uint8_t *tmp = realloc(self->buf, new_cap);
-        if (!tmp) { PyErr_NoMemory(); return -1; }
-        self->buf = tmp;
-        self->buf_cap = new_cap;
+    /* Compressed packets are stored expanded (inflate_packet() builds a
+     * well-formed table); plain ones, possibly straight off the network,
+     * must not point the readers outside the packet */
+    size_t in_len = pkt_len;
+    if (flags & BTELEM_PACKET_FLAG_COMPRESSED) {
+        Py_ssize_t n = inflate_packet(data, in_len, NULL, 0);
+        if (n < 0)
+            return BT_INGEST_MALFORMED;
+        pkt_len = (size_t)n;
+    } else if (!packet_layout_ok(data, pkt_len)) {
+        return BT_INGEST_MALFORMED;
     }
 
-    size_t offset = self->buf_len;
-    memcpy(self->buf + offset, data, pkt_len);
-    self->buf_len += pkt_len;
-
-    /* Scan entry headers for ts_min/ts_max */
-    const struct btelem_packet_header *ph =
-        (const struct btelem_packet_header *)(self->buf + offset);
-    const struct btelem_entry_header *table =
-        (const struct btelem_entry_header *)((const uint8_t *)ph + sizeof(*ph));
-
-    uint64_t ts_min = UINT64_MAX, ts_max = 0;
-    for (uint16_t i = 0; i < ph->entry_count; i++) {
-        if (table[i].timestamp < ts_min) ts_min = table[i].timestamp;
-        if (table[i].timestamp > ts_max) ts_max = table[i].timestamp;
-    }
-    if (ph->entry_count == 0) { ts_min = 0; ts_max = 0; }
+    bt_segment *seg = LiveCapture_tail(self, pkt_len);
+    if (!seg)
+        return BT_INGEST_NOMEM;
 
     /* Ensure index capacity */
-    if (self->index_count >= self->index_cap) {
-        uint32_t new_cap = self->index_cap * 2;
-        struct btelem_index_entry *tmp = realloc(self->index, new_cap * sizeof(*tmp));
-        if (!tmp) { PyErr_NoMemory(); return -1; }
-        self->index = tmp;
-        self->index_cap = new_cap;
+    if (seg->count >= seg->index_cap) {
+        uint32_t new_cap = seg->index_cap * 2;
+        struct btelem_index_entry *tmp = realloc(seg->index, new_cap * sizeof(*tmp));
+        if (!tmp)
+            return BT_INGEST_NOMEM;
+        seg->index = tmp;
+        seg->index_cap = new_cap;
     }
 
-    struct btelem_index_entry *ie = &self->index[self->index_count++];
+    size_t offset = seg->len;
+    if (flags & BTELEM_PACKET_FLAG_COMPRESSED)
+        inflate_packet(data, in_len, seg->buf + offset, pkt_len);
+    else
+        memcpy(seg->buf + offset, data, pkt_len);
+    seg->len += pkt_len;
+
+    const struct btelem_packet_header *ph =
+        (const struct btelem_packet_header *)(seg->buf + offset);
+    uint64_t ts_min, ts_max;
+    packet_ts_range(seg->buf + offset, &ts_min, &ts_max);
+
+    struct btelem_index_entry *ie = &seg->index[seg->count++];
     ie->offset      = offset;
     ie->ts_min      = ts_min;
     ie->ts_max      = ts_max;
     ie->entry_count = ph->entry_count;
-
-    /* Rolling window: compact when we exceed max_packets.
-     * Drop the oldest half to amortise the memmove cost. */
-    if (self->max_packets > 0 && self->index_count > self->max_packets) {
-        uint32_t drop = self->index_count / 2;
-        uint64_t dropped_entries = 0;
-        for (uint32_t i = 0; i < drop; i++)
-            dropped_entries += self->index[i].entry_count;
-        self->truncated_packets += drop;
-        self->truncated_entries += dropped_entries;
-
-        size_t drop_bytes = self->index[drop].offset;
-        memmove(self->buf, self->buf + drop_bytes,
-                self->buf_len - drop_bytes);
-        self->buf_len -= drop_bytes;
-
-        uint32_t kept = self->index_count - drop;
-        for (uint32_t i = 0; i < kept; i++) {
-            self->index[i] = self->index[i + drop];
-            self->index[i].offset -= drop_bytes;
-        }
-        self->index_count = kept;
+    seg->entries += ph->entry_count;
+    self->packets++;
+    self->bytes += pkt_len;
+    if (self->col_count && live_columns_add(self, seg->buf + offset, self->seg_count - 1) < 0)
+        return BT_INGEST_NOMEM;
+
+    /* Rolling window: drop whole segments, never the one being filled */
+    while (self->seg_count > 1
+           && ((self->max_packets && self->packets > self->max_packets)
+               || (self->max_bytes && self->bytes > self->max_bytes))) {
+        self->truncated_packets += self->segs[0].count;
+        self->truncated_entries += self->segs[0].entries;
+        LiveCapture_drop_oldest(self);
     }
 
-    return 0;
+    return BT_INGEST_OK;
 }
 
 static PyObject *
@@ -932,10 +2267,14 @@ LiveCapture_add_packet(LiveCaptureObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "y*", &pkt_buf))
         return NULL;
 
+    live_lock(self);
     int rc = LiveCapture_ingest_one(self, pkt_buf.buf, pkt_buf.len);
+    live_unlock(self);
     PyBuffer_Release(&pkt_buf);
-    if (rc < 0)
+    if (rc < 0) {
+        live_ingest_raise(rc);
         return NULL;
+    }
     Py_RETURN_NONE;
 }
 
@@ -981,213 +2320,447 @@ LiveCapture_add_stream(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
     /* Pass 2: walk again, skip oldest, ingest the rest. */
     pos = 0;
     uint32_t idx = 0;
+    int rc = BT_INGEST_OK;
+    live_lock(self);
     while (pos + 4 <= consumed) {
         uint32_t pkt_len;
         memcpy(&pkt_len, p + pos, 4);
 
         if (idx >= skip) {
-            if (LiveCapture_ingest_one(self, p + pos + 4, pkt_len) < 0) {
-                PyBuffer_Release(&stream);
-                return NULL;
-            }
+            rc = LiveCapture_ingest_one(self, p + pos + 4, pkt_len);
+            if (rc < 0)
+                break;
         }
         pos += 4 + pkt_len;
         idx++;
     }
+    live_unlock(self);
 
     PyBuffer_Release(&stream);
+    if (rc < 0) {
+        live_ingest_raise(rc);
+        return NULL;
+    }
     return PyLong_FromSize_t(consumed);
 }
 
 static PyObject *
 LiveCapture_clear(LiveCaptureObject *self, PyObject *Py_UNUSED(ignored))
 {
-    self->buf_len = 0;
-    self->index_count = 0;
+    live_lock(self);
+    while (self->seg_count)
+        LiveCapture_drop_oldest(self);
+    live_unlock(self);
     Py_RETURN_NONE;
 }
 
-static PyObject *
-LiveCapture_series(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
-{
-    const char *entry_name, *field_name = NULL;
-    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
-    static char *kwlist[] = {"entry_name", "field_name", "t0", "t1", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OO", kwlist,
-                                     &entry_name, &field_name, &t0_obj, &t1_obj))
-        return NULL;
-
-    uint64_t t0 = 0, t1 = 0;
-    int use_t0 = (t0_obj != Py_None);
-    int use_t1 = (t1_obj != Py_None);
-    if (use_t0) { t0 = PyLong_AsUnsignedLongLong(t0_obj); if (PyErr_Occurred()) return NULL; }
-    if (use_t1) { t1 = PyLong_AsUnsignedLongLong(t1_obj); if (PyErr_Occurred()) return NULL; }
+/* =========================================================================
+ * Socket receiver (attach_socket)
+ *
+ * A pthread recv()s a length-prefixed packet stream into a staging buffer
+ * and ingests the whole packets in it under self->lock, never taking the
+ * GIL.  While a query holds the lock it keeps receiving and publishes
+ * later; it waits on the lock only once the staging buffer is full, which
+ * counts as a stall.
+ * ========================================================================= */
 
-    const bt_entry_info *entry = find_entry_by_name(&self->schema, entry_name);
-    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
-    const struct btelem_field_wire *field = find_field_by_name(entry, field_name);
-    if (!field) { PyErr_Format(PyExc_KeyError, "Unknown field: '%s'", field_name); return NULL; }
+#ifndef BTELEM_LIVE_RECV_BYTES
+#define BTELEM_LIVE_RECV_BYTES (1u << 20)
+#endif
+/* Longest packet accepted; a longer length prefix means a broken stream */
+#ifndef BTELEM_LIVE_RECV_MAX_PACKET
+#define BTELEM_LIVE_RECV_MAX_PACKET (64u << 20)
+#endif
+/* Retry interval for packets held back while a query has the lock */
+#define BT_RECV_RETRY_MS 1
 
-    int npy_type = type_to_npy(field->type);
-    if (npy_type < 0 && field->type == BTELEM_BITFIELD) {
-        switch (field->size) {
-        case 1: npy_type = NPY_UINT8; break;
-        case 2: npy_type = NPY_UINT16; break;
-        case 4: npy_type = NPY_UINT32; break;
-        default: npy_type = NPY_UINT8; break;
+typedef struct bt_receiver {
+    LiveCaptureObject *owner;
+    pthread_t   thread;
+    int         fd;
+    int         wake[2];        /* pipe: detach_socket() wakes poll() */
+    uint8_t    *buf;            /* staging, starts at a packet boundary */
+    size_t      len;
+    size_t      cap;
+    size_t      ready;          /* bytes of whole packets held back */
+    /* Atomics: written by the thread, read by receive_stats() */
+    uint64_t    bytes;
+    uint64_t    packets;
+    uint64_t    stalls;
+    int         running;
+    int         eof;
+    int         err;            /* errno, or a BT_INGEST_* code */
+} bt_receiver;
+
+/* Ingest the whole packets buffered.  Unless force, give up and hold them
+ * back if a query has the lock and there is still room to receive into.
+ * Returns BT_INGEST_OK or an error code. */
+static int
+receiver_publish(bt_receiver *rx, int force)
+{
+    size_t end = 0;
+    int framing = BT_INGEST_OK;
+    while (end + 4 <= rx->len) {
+        uint32_t pkt_len;
+        memcpy(&pkt_len, rx->buf + end, 4);
+        if (pkt_len > BTELEM_LIVE_RECV_MAX_PACKET) {
+            framing = BT_INGEST_OVERSIZE;
+            force = 1;
+            break;
         }
+        if (end + 4 + pkt_len > rx->len)
+            break;
+        end += 4 + pkt_len;
+    }
+    rx->ready = 0;
+    if (end == 0)
+        return framing;
+
+    LiveCaptureObject *self = rx->owner;
+    if (pthread_mutex_trylock(&self->lock) != 0) {
+        if (!force && rx->len < rx->cap) {
+            rx->ready = end;
+            return BT_INGEST_OK;
+        }
+        __atomic_fetch_add(&rx->stalls, 1, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&self->lock);
+    }
+    int rc = BT_INGEST_OK;
+    uint64_t n = 0;
+    for (size_t pos = 0; pos < end; n++) {
+        uint32_t pkt_len;
+        memcpy(&pkt_len, rx->buf + pos, 4);
+        rc = LiveCapture_ingest_one(self, rx->buf + pos + 4, pkt_len);
+        if (rc < 0)
+            break;
+        pos += 4 + pkt_len;
     }
-    int elem_sz = type_element_size(field->type);
-    int field_bytes = (elem_sz > 0) ? elem_sz * field->count : field->size;
+    pthread_mutex_unlock(&self->lock);
+    __atomic_fetch_add(&rx->packets, n, __ATOMIC_RELAXED);
 
-    /* Exact count pass (reads entry headers only), then allocate + fill. */
-    npy_intp count = count_entries_exact(self->buf, self->index, self->index_count,
-                                         entry->id, t0, use_t0, t1, use_t1);
+    memmove(rx->buf, rx->buf + end, rx->len - end);
+    rx->len -= end;
+    return rc < 0 ? rc : framing;
+}
 
-    npy_intp ts_dims[1] = {count};
-    PyObject *ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
-    if (!ts_arr) return NULL;
+/* Make room for the partial packet at the front of the buffer */
+static int
+receiver_reserve(bt_receiver *rx)
+{
+    if (rx->len < rx->cap)
+        return BT_INGEST_OK;
+    uint32_t pkt_len;
+    memcpy(&pkt_len, rx->buf, 4);           /* len == cap >= 4 */
+    size_t cap = rx->cap * 2;
+    if (cap < 4 + (size_t)pkt_len)
+        cap = 4 + (size_t)pkt_len;
+    uint8_t *buf = realloc(rx->buf, cap);
+    if (!buf)
+        return BT_INGEST_NOMEM;
+    rx->buf = buf;
+    rx->cap = cap;
+    return BT_INGEST_OK;
+}
 
-    PyObject *val_arr;
-    if (field->count > 1) {
-        npy_intp dims[2] = {count, field->count};
-        val_arr = PyArray_SimpleNew(2, dims, npy_type);
-    } else {
-        npy_intp dims[1] = {count};
-        val_arr = PyArray_SimpleNew(1, dims, npy_type);
+static void *
+receiver_main(void *arg)
+{
+    bt_receiver *rx = arg;
+    int err = 0;
+
+    for (;;) {
+        struct pollfd pfd[2] = {
+            {.fd = rx->fd, .events = POLLIN},
+            {.fd = rx->wake[0], .events = POLLIN},
+        };
+        int n = poll(pfd, 2, rx->ready ? BT_RECV_RETRY_MS : -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            err = errno;
+            break;
+        }
+        if (pfd[1].revents)
+            break;
+        if (pfd[0].revents) {
+            ssize_t got = recv(rx->fd, rx->buf + rx->len, rx->cap - rx->len, 0);
+            if (got == 0) {
+                __atomic_store_n(&rx->eof, 1, __ATOMIC_RELAXED);
+                break;
+            }
+            if (got < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+                    continue;
+                err = errno;
+                break;
+            }
+            rx->len += (size_t)got;
+            __atomic_fetch_add(&rx->bytes, (uint64_t)got, __ATOMIC_RELAXED);
+        }
+        if ((err = receiver_publish(rx, 0)) != 0 || (err = receiver_reserve(rx)) != 0)
+            break;
     }
-    if (!val_arr) { Py_DECREF(ts_arr); return NULL; }
 
-    if (count > 0)
-        fill_series(self->buf, self->index, self->index_count,
-                    entry->id, field, t0, use_t0, t1, use_t1,
-                    PyArray_DATA((PyArrayObject *)ts_arr),
-                    PyArray_DATA((PyArrayObject *)val_arr),
-                    count, field_bytes);
+    /* Whatever arrived in full before stopping is kept */
+    if (err == 0)
+        err = receiver_publish(rx, 1);
+    __atomic_store_n(&rx->err, err, __ATOMIC_RELAXED);
+    __atomic_store_n(&rx->running, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
 
-    PyObject *result = PyTuple_Pack(2, ts_arr, val_arr);
-    Py_DECREF(ts_arr);
-    Py_DECREF(val_arr);
-    return result;
+/* Stop and free the receiver.  Returns its error (0: none).  Call without
+ * self->lock; the GIL is let go while joining. */
+static int
+receiver_stop(LiveCaptureObject *self)
+{
+    bt_receiver *rx = self->rx;
+    if (!rx)
+        return 0;
+    self->rx = NULL;
+
+    char c = 0;
+    ssize_t w = write(rx->wake[1], &c, 1);
+    (void)w;
+    Py_BEGIN_ALLOW_THREADS
+    pthread_join(rx->thread, NULL);
+    Py_END_ALLOW_THREADS
+
+    int err = rx->err;
+    close(rx->wake[0]);
+    close(rx->wake[1]);
+    free(rx->buf);
+    free(rx);
+    return err;
 }
 
 static PyObject *
-LiveCapture_table(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
+receiver_raise(int err)
 {
-    const char *entry_name;
-    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
-    static char *kwlist[] = {"entry_name", "t0", "t1", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OO", kwlist,
-                                     &entry_name, &t0_obj, &t1_obj))
-        return NULL;
-
-    uint64_t t0 = 0, t1 = 0;
-    int use_t0 = (t0_obj != Py_None);
-    int use_t1 = (t1_obj != Py_None);
-    if (use_t0) { t0 = PyLong_AsUnsignedLongLong(t0_obj); if (PyErr_Occurred()) return NULL; }
-    if (use_t1) { t1 = PyLong_AsUnsignedLongLong(t1_obj); if (PyErr_Occurred()) return NULL; }
-
-    const bt_entry_info *entry = find_entry_by_name(&self->schema, entry_name);
-    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+    if (err > 0) {
+        errno = err;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    live_ingest_raise(err);
+    return NULL;
+}
 
-    npy_intp count = count_entries_exact(self->buf, self->index, self->index_count,
-                                         entry->id, t0, use_t0, t1, use_t1);
+/*
+ * attach_socket(sock, buffer_bytes=0)
+ *
+ * Start the receive thread on sock (a socket or file descriptor positioned
+ * after the schema).  The caller keeps ownership of sock and must keep it
+ * open until detach_socket().
+ */
+static PyObject *
+LiveCapture_attach_socket(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *sock;
+    unsigned int buffer_bytes = 0;
+    static char *kwlist[] = {"sock", "buffer_bytes", NULL};
 
-    npy_intp ts_dims[1] = {count};
-    PyObject *ts_arr = PyArray_SimpleNew(1, ts_dims, NPY_UINT64);
-    if (!ts_arr) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|I", kwlist, &sock, &buffer_bytes))
+        return NULL;
+    int fd = PyObject_AsFileDescriptor(sock);
+    if (fd < 0)
+        return NULL;
+    if (self->rx) {
+        PyErr_SetString(PyExc_RuntimeError, "A socket is already attached");
+        return NULL;
+    }
 
-    PyObject **field_pyarrs = calloc(entry->field_count, sizeof(PyObject *));
-    uint8_t **field_ptrs = calloc(entry->field_count, sizeof(uint8_t *));
-    int *field_sizes = calloc(entry->field_count, sizeof(int));
-    if (!field_pyarrs || !field_ptrs || !field_sizes) {
-        Py_DECREF(ts_arr);
-        free(field_pyarrs); free(field_ptrs); free(field_sizes);
+    bt_receiver *rx = calloc(1, sizeof(*rx));
+    if (!rx)
         return PyErr_NoMemory();
+    rx->owner = self;
+    rx->fd = fd;
+    rx->cap = buffer_bytes >= 4 ? buffer_bytes : BTELEM_LIVE_RECV_BYTES;
+    rx->buf = malloc(rx->cap);
+    rx->running = 1;
+    if (!rx->buf) {
+        free(rx);
+        return PyErr_NoMemory();
+    }
+    if (pipe(rx->wake) < 0) {
+        free(rx->buf);
+        free(rx);
+        return PyErr_SetFromErrno(PyExc_OSError);
     }
+    int rc = pthread_create(&rx->thread, NULL, receiver_main, rx);
+    if (rc != 0) {
+        close(rx->wake[0]);
+        close(rx->wake[1]);
+        free(rx->buf);
+        free(rx);
+        errno = rc;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    self->rx = rx;
+    Py_RETURN_NONE;
+}
 
-    for (uint16_t fi = 0; fi < entry->field_count; fi++) {
-        const struct btelem_field_wire *f = &entry->fields[fi];
-        int npy_type = type_to_npy(f->type);
-        int elem_sz = type_element_size(f->type);
-        if (npy_type < 0 && f->type == BTELEM_BITFIELD) {
-            switch (f->size) {
-            case 1: npy_type = NPY_UINT8; break;
-            case 2: npy_type = NPY_UINT16; break;
-            case 4: npy_type = NPY_UINT32; break;
-            default: npy_type = NPY_UINT8; break;
-            }
-        }
-        field_sizes[fi] = (elem_sz > 0) ? elem_sz * f->count : f->size;
+static PyObject *
+LiveCapture_detach_socket(LiveCaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    int err = receiver_stop(self);
+    if (err)
+        return receiver_raise(err);
+    Py_RETURN_NONE;
+}
 
-        if (f->count > 1) {
-            npy_intp dims[2] = {count, f->count};
-            field_pyarrs[fi] = PyArray_SimpleNew(2, dims, npy_type);
-        } else {
-            npy_intp dims[1] = {count};
-            field_pyarrs[fi] = PyArray_SimpleNew(1, dims, npy_type);
-        }
-        if (!field_pyarrs[fi]) {
-            for (uint16_t j = 0; j < fi; j++) Py_XDECREF(field_pyarrs[j]);
-            Py_DECREF(ts_arr);
-            free(field_pyarrs); free(field_ptrs); free(field_sizes);
-            return NULL;
-        }
-        field_ptrs[fi] = PyArray_DATA((PyArrayObject *)field_pyarrs[fi]);
+static PyObject *
+LiveCapture_receive_stats(LiveCaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    bt_receiver *rx = self->rx;
+    if (!rx)
+        Py_RETURN_NONE;
+    int running = __atomic_load_n(&rx->running, __ATOMIC_ACQUIRE);
+    int err = running ? 0 : rx->err;
+    return Py_BuildValue(
+        "{s:K,s:K,s:K,s:O,s:O,s:z}",
+        "bytes", (unsigned long long)__atomic_load_n(&rx->bytes, __ATOMIC_RELAXED),
+        "packets", (unsigned long long)__atomic_load_n(&rx->packets, __ATOMIC_RELAXED),
+        "stalls", (unsigned long long)__atomic_load_n(&rx->stalls, __ATOMIC_RELAXED),
+        "running", running ? Py_True : Py_False,
+        "eof", __atomic_load_n(&rx->eof, __ATOMIC_RELAXED) ? Py_True : Py_False,
+        "error", err > 0 ? strerror(err) : err < 0 ? live_ingest_message(err) : NULL);
+}
+
+/* Call with self->lock held for the whole query, which keeps add_packet()
+ * and the receive thread from starting or dropping segments under it. */
+static void
+live_source(LiveCaptureObject *self, bt_source *src)
+{
+    for (uint32_t i = 0; i < self->seg_count; i++) {
+        self->parts[i].data = self->segs[i].buf;
+        self->parts[i].index = self->segs[i].index;
+        self->parts[i].count = self->segs[i].count;
     }
+    src->parts = self->parts;
+    src->nparts = self->seg_count;
+    src->ids = NULL;
+    src->schema = &self->schema;
+    src->busy = &self->busy;
+}
 
-    if (count > 0)
-        fill_table(self->buf, self->index, self->index_count,
-                   entry->id, entry, t0, use_t0, t1, use_t1,
-                   PyArray_DATA((PyArrayObject *)ts_arr),
-                   field_ptrs, field_sizes, count);
+static PyObject *
+LiveCapture_series(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    const char *entry_name, *field_name;
+    PyObject *t0_obj = Py_None, *t1_obj = Py_None;
+    int threads = 0, cache = 1;
+    static char *kwlist[] = {"entry_name", "field_name", "t0", "t1", "threads", "cache", NULL};
 
-    PyObject *dict = PyDict_New();
-    if (!dict) {
-        Py_DECREF(ts_arr);
-        for (uint16_t fi = 0; fi < entry->field_count; fi++)
-            Py_XDECREF(field_pyarrs[fi]);
-        free(field_pyarrs); free(field_ptrs); free(field_sizes);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOip", kwlist, &entry_name,
+                                     &field_name, &t0_obj, &t1_obj, &threads, &cache))
         return NULL;
-    }
 
-    PyDict_SetItemString(dict, "_timestamp", ts_arr);
-    Py_DECREF(ts_arr);
-    for (uint16_t fi = 0; fi < entry->field_count; fi++) {
-        PyDict_SetItemString(dict, entry->fields[fi].name, field_pyarrs[fi]);
-        Py_DECREF(field_pyarrs[fi]);
+    const bt_entry_info *entry = find_entry_by_name(&self->schema, entry_name);
+    if (!entry) { PyErr_Format(PyExc_KeyError, "Unknown entry: '%s'", entry_name); return NULL; }
+    const struct btelem_field_wire *field = find_field_by_name(entry, field_name);
+    if (!field) { PyErr_Format(PyExc_KeyError, "Unknown field: '%s'", field_name); return NULL; }
+
+    PyObject *result = NULL;
+    bt_extract x;
+    live_lock(self);
+    if (parse_time_range(&self->schema, t0_obj, t1_obj, &x) < 0) {
+        /* exception set */
+    } else if (cache) {
+        const bt_live_column *c = live_column_get(self, entry->id, field);
+        if (c)
+            result = live_column_series(self, c, &x);
+    } else {
+        bt_source src;
+        live_source(self, &src);
+        result = series_extract(&src, &x, entry, field, threads);
     }
+    live_unlock(self);
+    return result;
+}
 
-    free(field_pyarrs);
-    free(field_ptrs);
-    free(field_sizes);
-    return dict;
+static PyObject *
+LiveCapture_clear_cache(LiveCaptureObject *self, PyObject *Py_UNUSED(ignored))
+{
+    live_lock(self);
+    live_columns_free(self);
+    live_unlock(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+LiveCapture_series_many(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    bt_source src;
+    live_lock(self);
+    live_source(self, &src);
+    PyObject *result = query_series_many(&src, args, kwds);
+    live_unlock(self);
+    return result;
+}
+
+static PyObject *
+LiveCapture_table(LiveCaptureObject *self, PyObject *args, PyObject *kwds)
+{
+    bt_source src;
+    live_lock(self);
+    live_source(self, &src);
+    PyObject *result = query_table(&src, args, kwds);
+    live_unlock(self);
+    return result;
 }
 
 static PyObject *
 LiveCapture_get_truncated_packets(LiveCaptureObject *self, void *Py_UNUSED(closure))
 {
-    return PyLong_FromUnsignedLongLong(self->truncated_packets);
+    live_lock(self);
+    uint64_t v = self->truncated_packets;
+    live_unlock(self);
+    return PyLong_FromUnsignedLongLong(v);
 }
 
 static PyObject *
 LiveCapture_get_truncated_entries(LiveCaptureObject *self, void *Py_UNUSED(closure))
 {
-    return PyLong_FromUnsignedLongLong(self->truncated_entries);
+    live_lock(self);
+    uint64_t v = self->truncated_entries;
+    live_unlock(self);
+    return PyLong_FromUnsignedLongLong(v);
 }
 
 static PyObject *
 LiveCapture_get_time_range(LiveCaptureObject *self, void *Py_UNUSED(closure))
 {
-    if (self->index_count == 0)
+    live_lock(self);
+    if (self->seg_count == 0) {
+        live_unlock(self);
         Py_RETURN_NONE;
-    uint64_t ts_min = self->index[0].ts_min;
-    uint64_t ts_max = self->index[self->index_count - 1].ts_max;
+    }
+    const bt_segment *last = &self->segs[self->seg_count - 1];
+    uint64_t ts_min = clock_to_ns(&self->schema.clock, self->segs[0].index[0].ts_min);
+    uint64_t ts_max = clock_to_ns(&self->schema.clock,
+                                  last->index[last->count - 1].ts_max);
+    live_unlock(self);
     return Py_BuildValue("(KK)", ts_min, ts_max);
 }
 
+static PyObject *
+LiveCapture_get_packets(LiveCaptureObject *self, void *Py_UNUSED(closure))
+{
+    live_lock(self);
+    uint64_t v = self->packets;
+    live_unlock(self);
+    return PyLong_FromUnsignedLongLong(v);
+}
+
+static PyObject *
+LiveCapture_get_bytes(LiveCaptureObject *self, void *Py_UNUSED(closure))
+{
+    live_lock(self);
+    uint64_t v = self->bytes;
+    live_unlock(self);
+    return PyLong_FromUnsignedLongLong(v);
+}
+
 static PyGetSetDef LiveCapture_getset[] = {
     {"truncated_packets", (getter)LiveCapture_get_truncated_packets, NULL,
      "Total packets dropped due to rolling window.", NULL},
@@ -1195,14 +2768,22 @@ static PyGetSetDef LiveCapture_getset[] = {
      "Total entries dropped due to rolling window.", NULL},
     {"time_range", (getter)LiveCapture_get_time_range, NULL,
      "Global (ts_min, ts_max) in nanoseconds, or None if empty.", NULL},
+    {"packets", (getter)LiveCapture_get_packets, NULL,
+     "Packets currently held.", NULL},
+    {"bytes", (getter)LiveCapture_get_bytes, NULL,
+     "Packet bytes currently held (what max_bytes limits).", NULL},
     {NULL}
 };
 
 static PyObject *
 LiveCapture_entry_counts(LiveCaptureObject *self, PyObject *Py_UNUSED(ignored))
 {
-    return entry_counts_from_index(self->buf, self->index, self->index_count,
-                                   &self->schema);
+    bt_source src;
+    live_lock(self);
+    live_source(self, &src);
+    PyObject *result = entry_counts_from_index(src.parts, src.nparts, NULL, &self->schema);
+    live_unlock(self);
+    return result;
 }
 
 static PyMethodDef LiveCapture_methods[] = {
@@ -1213,13 +2794,31 @@ static PyMethodDef LiveCapture_methods[] = {
      "raw byte stream, optionally skipping oldest if backlogged.\n"
      "Returns number of bytes consumed."},
     {"series", (PyCFunction)LiveCapture_series, METH_VARARGS | METH_KEYWORDS,
-     "series(entry_name, field_name, t0=None, t1=None) -> (timestamps, values)"},
+     "series(entry_name, field_name, t0=None, t1=None, threads=0, cache=True)\n"
+     "-> (timestamps, values).  With cache, the column is kept and extended as\n"
+     "packets arrive, so repeat calls only copy it out."},
+    {"series_many", (PyCFunction)LiveCapture_series_many, METH_VARARGS | METH_KEYWORDS,
+     "series_many(fields, t0=None, t1=None, threads=0) -> [(timestamps, values), ...]\n"
+     "Extract each (entry_name, field_name) pair of *fields* in one pass;\n"
+     "fields of the same entry share one timestamps array."},
     {"table", (PyCFunction)LiveCapture_table, METH_VARARGS | METH_KEYWORDS,
-     "table(entry_name, t0=None, t1=None) -> dict of numpy arrays"},
+     "table(entry_name, t0=None, t1=None, threads=0) -> dict of numpy arrays"},
     {"entry_counts", (PyCFunction)LiveCapture_entry_counts, METH_NOARGS,
      "entry_counts() -> {entry_name: count} from index (no data extraction)."},
     {"clear", (PyCFunction)LiveCapture_clear, METH_NOARGS,
      "Reset the internal buffer."},
+    {"clear_cache", (PyCFunction)LiveCapture_clear_cache, METH_NOARGS,
+     "Forget the columns cached by series()."},
+    {"attach_socket", (PyCFunction)LiveCapture_attach_socket, METH_VARARGS | METH_KEYWORDS,
+     "attach_socket(sock, buffer_bytes=0) — receive the length-prefixed packets\n"
+     "that follow the schema on sock in a native thread, without the GIL.\n"
+     "sock (a socket or fd) stays the caller's; keep it open until detach."},
+    {"detach_socket", (PyCFunction)LiveCapture_detach_socket, METH_NOARGS,
+     "Stop the receive thread, keeping the whole packets it got.  Raises\n"
+     "OSError/ValueError if it had stopped on an error."},
+    {"receive_stats", (PyCFunction)LiveCapture_receive_stats, METH_NOARGS,
+     "receive_stats() -> {bytes, packets, stalls, running, eof, error} for the\n"
+     "attached socket, or None."},
     {NULL}
 };
 
@@ -1229,11 +2828,15 @@ static PyTypeObject LiveCaptureType = {
     .tp_basicsize = sizeof(LiveCaptureObject),
     .tp_dealloc = (destructor)LiveCapture_dealloc,
     .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_doc = "Transport-agnostic live telemetry accumulator with numpy extraction.",
+    .tp_doc = "Transport-agnostic live telemetry accumulator with numpy extraction.\n\n"
+              "LiveCapture(schema_bytes, max_packets=0, max_bytes=0): either limit\n"
+              "(0 = none) keeps a rolling window by dropping the oldest segments.\n"
+              "attach_socket() feeds it from a native receive thread; queries\n"
+              "lock out that thread and run without the GIL.",
     .tp_methods = LiveCapture_methods,
     .tp_getset = LiveCapture_getset,
     .tp_init = (initproc)LiveCapture_init,
-    .tp_new = PyType_GenericNew,
+    .tp_new = LiveCapture_new,
 };
 
 /* =========================================================================
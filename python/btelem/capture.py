@@ -1,7 +1,8 @@
 """High-level wrappers around the C extension for numpy telemetry extraction.
 
 Capture — file-backed (mmap), uses footer index for fast time-range queries.
-LiveCapture — transport-agnostic accumulator, caller feeds raw packets.
+LiveCapture — transport-agnostic accumulator, caller feeds raw packets
+              (or attach_socket() receives them on a native thread).
 """
 
 from __future__ import annotations
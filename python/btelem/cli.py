@@ -7,7 +7,9 @@ import sys
 import time
 
 from .schema import Schema
-from .decoder import PacketDecoder, DecodedEntry, decode_packet, read_stream_schema
+from .decoder import (
+    PacketDecoder, DecodedEntry, EntryArrays, decode_packet, read_stream_schema,
+)
 from .storage import LogReader
 
 
@@ -18,9 +20,38 @@ def _format_entry(entry: DecodedEntry) -> str:
     return f"[{ts_s:12.6f}] {name}: {fields_str}"
 
 
+def _print_arrays(arrays: dict[int, EntryArrays]) -> None:
+    """Print decoded arrays as entry lines in timestamp order.
+
+    Fast-mode output: values are shown raw, without enum labels or
+    bitfield bits.
+    """
+    import numpy as np
+
+    groups = [ea for ea in arrays.values() if len(ea.timestamps)]
+    if not groups:
+        return
+    ts = np.concatenate([ea.timestamps for ea in groups])
+    which = np.concatenate([np.full(len(ea.timestamps), i) for i, ea in enumerate(groups)])
+    row = np.concatenate([np.arange(len(ea.timestamps)) for ea in groups])
+    order = np.argsort(ts, kind="stable")
+
+    names = [ea.values.dtype.names or () for ea in groups]
+    rows = [ea.values.tolist() for ea in groups]
+    lines = []
+    for t, i, r in zip(ts[order].tolist(), which[order].tolist(), row[order].tolist()):
+        fields_str = ", ".join(f"{k}={v}" for k, v in zip(names[i], rows[i][r]))
+        lines.append(f"[{t / 1_000_000_000:12.6f}] {groups[i].name}: {fields_str}")
+    print("\n".join(lines))
+
+
 def cmd_dump(args: argparse.Namespace) -> None:
     """Dump a log file to stdout."""
     with LogReader(args.file) as reader:
+        if args.fast:
+            for arrays in reader.packet_arrays():
+                _print_arrays(arrays)
+            return
         for entry in reader.entries():
             print(_format_entry(entry))
 
@@ -142,7 +173,9 @@ def cmd_live(args: argparse.Namespace) -> None:
     try:
         while True:
             data = transport.read(4096)
-            if data:
+            if data and args.fast:
+                _print_arrays(decoder.feed_arrays(data))
+            elif data:
                 for entry in decoder.feed(data):
                     print(_format_entry(entry))
             else:
@@ -160,6 +193,8 @@ def main() -> None:
     # dump
     p_dump = sub.add_parser("dump", help="Dump a log file")
     p_dump.add_argument("file", help="Path to .btlm log file")
+    p_dump.add_argument("--fast", action="store_true",
+                        help="Decode with NumPy arrays; raw enum/bitfield values")
 
     # schema
     p_schema = sub.add_parser("schema", help="Show schema from a log file")
@@ -176,6 +211,8 @@ def main() -> None:
     p_live.add_argument("--udp", help="UDP host:port to listen on")
     p_live.add_argument("--tcp", help="TCP host:port to connect to")
     p_live.add_argument("--schema-file", help="Log file to read schema from")
+    p_live.add_argument("--fast", action="store_true",
+                        help="Decode with NumPy arrays; raw enum/bitfield values")
 
     args = parser.parse_args()
     if args.command == "dump":
@@ -5,9 +5,9 @@ from __future__ import annotations
 import logging
 import struct
 from dataclasses import dataclass
-from typing import Any
+from typing import Any, Iterator
 
-from .schema import Schema
+from .schema import ClockCalibration, Schema
 from .transport import TCPTransport
 
 logger = logging.getLogger(__name__)
@@ -17,7 +17,7 @@ def read_stream_schema(transport: TCPTransport) -> Schema:
     """Read length-prefixed schema from a btelem TCP stream."""
     raw_len = transport.recv_exact(4)
     schema_len = struct.unpack("<I", raw_len)[0]
-    schema_bytes = transport.recv_exact(schema_len)
+    schema_bytes = transport.schema_blob(transport.recv_exact(schema_len))
     return Schema.from_bytes(schema_bytes)
 
 # Wire format constants (must match btelem_types.h)
@@ -27,6 +27,146 @@ PACKET_HEADER_SIZE = struct.calcsize(PACKET_HEADER_FMT)  # 16
 ENTRY_HEADER_FMT = "<HHIQ"
 ENTRY_HEADER_SIZE = struct.calcsize(ENTRY_HEADER_FMT)  # 16
 
+# Packet carries a clock calibration update instead of entries
+PACKET_FLAG_CLOCK = 0x0001
+# Packet carries a schema fragment (datagram transports, see UDPPacketReceiver)
+PACKET_FLAG_SCHEMA = 0x0002
+# Entry table and payloads are delta-coded (see compress_packet)
+PACKET_FLAG_COMPRESSED = 0x0004
+# IDs below this are XORed against their previous payload in the packet
+PACKET_DELTA_IDS = 512
+
+_U64 = (1 << 64) - 1
+
+
+def _put_varint(out: bytearray, v: int) -> None:
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+
+
+def _get_varint(data: bytes, pos: int, end: int) -> tuple[int, int]:
+    v = shift = 0
+    while pos < end and shift < 64:
+        b = data[pos]
+        pos += 1
+        v |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return v, pos
+        shift += 7
+    raise ValueError("truncated varint in compressed packet")
+
+
+def compress_packet(data: bytes) -> bytes | None:
+    """Delta-code a plain entry packet, like btelem_packet_compress().
+
+    Timestamps become deltas from the previous entry, and each payload is
+    XORed with the previous payload of the same ID and size in the packet,
+    with zero runs skipped (format in btelem_types.h).  Returns None if
+    the packet is not an entry batch or would not get smaller.
+    """
+    entry_count, flags, _, dropped, reserved = struct.unpack_from(
+        PACKET_HEADER_FMT, data, 0)
+    if flags or not entry_count:
+        return None
+    payload_base = PACKET_HEADER_SIZE + entry_count * ENTRY_HEADER_SIZE
+
+    out = bytearray()
+    prev: dict[int, bytes] = {}
+    prev_ts = 0
+    for i in range(entry_count):
+        entry_id, psz, poff, ts = struct.unpack_from(
+            ENTRY_HEADER_FMT, data, PACKET_HEADER_SIZE + i * ENTRY_HEADER_SIZE)
+        cur = bytes(data[payload_base + poff:payload_base + poff + psz])
+        _put_varint(out, entry_id)
+        _put_varint(out, psz)
+        delta = (ts - prev_ts) & _U64
+        _put_varint(out, ((delta << 1) & _U64) ^ (_U64 if delta >> 63 else 0))
+        prev_ts = ts
+
+        ref = prev.get(entry_id)
+        if entry_id < PACKET_DELTA_IDS:
+            prev[entry_id] = cur
+        x = bytes(a ^ b for a, b in zip(cur, ref)) if ref is not None and len(ref) == psz else cur
+
+        k = 0
+        while k < psz:
+            start = k
+            while k < psz and x[k] == 0:
+                k += 1
+            lit = k
+            while k < psz and (x[k] or (k + 1 < psz and x[k + 1])):
+                k += 1
+            zeros = lit - start
+            while True:
+                n = min(k - lit, 15)
+                _put_varint(out, zeros << 4 | n)
+                out += x[lit:lit + n]
+                lit += n
+                zeros = 0
+                if lit >= k:
+                    break
+
+    if PACKET_HEADER_SIZE + len(out) >= len(data):
+        return None
+    return struct.pack(PACKET_HEADER_FMT, entry_count, PACKET_FLAG_COMPRESSED,
+                       len(out), dropped, reserved) + bytes(out)
+
+
+def decompress_packet(data: bytes) -> bytes:
+    """Expand a PACKET_FLAG_COMPRESSED packet back into the plain layout.
+
+    Raises ValueError if it is malformed.
+    """
+    entry_count, flags, body_size, dropped, reserved = struct.unpack_from(
+        PACKET_HEADER_FMT, data, 0)
+    end = PACKET_HEADER_SIZE + body_size
+    if not flags & PACKET_FLAG_COMPRESSED or end > len(data):
+        raise ValueError("not a complete compressed packet")
+
+    table = bytearray()
+    payload = bytearray()
+    prev: dict[int, bytes] = {}
+    ts = 0
+    pos = PACKET_HEADER_SIZE
+    for _ in range(entry_count):
+        entry_id, pos = _get_varint(data, pos, end)
+        psz, pos = _get_varint(data, pos, end)
+        zz, pos = _get_varint(data, pos, end)
+        if entry_id > 0xFFFF or psz > 0xFFFF:
+            raise ValueError("bad entry in compressed packet")
+        ts = (ts + ((zz >> 1) ^ (_U64 if zz & 1 else 0))) & _U64
+
+        ref = prev.get(entry_id)
+        if ref is None or len(ref) != psz:
+            ref = bytes(psz)
+        cur = bytearray(ref)
+        k = 0
+        while k < psz:
+            run, pos = _get_varint(data, pos, end)
+            zeros, n = run >> 4, run & 15
+            if zeros + n == 0 or k + zeros + n > psz or pos + n > end:
+                raise ValueError("bad run in compressed packet")
+            k += zeros
+            for j in range(n):
+                cur[k + j] ^= data[pos + j]
+            pos += n
+            k += n
+        cur = bytes(cur)
+        if entry_id < PACKET_DELTA_IDS:
+            prev[entry_id] = cur
+
+        table += struct.pack(ENTRY_HEADER_FMT, entry_id, psz, len(payload), ts)
+        payload += cur
+    if pos != end:
+        raise ValueError("trailing bytes in compressed packet")
+
+    header = struct.pack(PACKET_HEADER_FMT, entry_count,
+                         flags & ~PACKET_FLAG_COMPRESSED, len(payload),
+                         dropped, reserved)
+    return header + bytes(table) + bytes(payload)
+
 
 @dataclass
 class DecodedEntry:
@@ -42,6 +182,46 @@ class DecodedEntry:
 class PacketResult:
     entries: list[DecodedEntry]
     dropped: int
+    clock: ClockCalibration | None = None
+
+
+@dataclass
+class EntryArrays:
+    """Every entry of one schema ID, as columns (see decode_packet_arrays)."""
+    id: int
+    name: str
+    timestamps: Any     # uint64 nanoseconds
+    values: Any         # structured array, dtype schema.dtype(id)
+
+
+@dataclass
+class PacketArrays:
+    arrays: dict[int, EntryArrays]
+    dropped: int
+    clock: ClockCalibration | None = None
+
+
+def _open_packet(data: bytes) -> tuple[bytes, int, int, ClockCalibration | None]:
+    """Expand a packet and classify it.
+
+    Returns (plain packet, entry_count, dropped, clock); entry_count is 0
+    for clock and schema packets.
+    """
+    if len(data) < PACKET_HEADER_SIZE:
+        return data, 0, 0, None
+
+    entry_count, flags, payload_size, dropped, _reserved = struct.unpack_from(
+        PACKET_HEADER_FMT, data, 0
+    )
+    if flags & PACKET_FLAG_COMPRESSED:
+        data = decompress_packet(data)
+        flags &= ~PACKET_FLAG_COMPRESSED
+
+    if flags & PACKET_FLAG_CLOCK:
+        return data, 0, dropped, ClockCalibration.from_bytes(data, PACKET_HEADER_SIZE)
+    if flags & PACKET_FLAG_SCHEMA:
+        return data, 0, dropped, None
+    return data, entry_count, dropped, None
 
 
 def decode_packet(schema: Schema, data: bytes,
@@ -53,13 +233,15 @@ def decode_packet(schema: Schema, data: bytes,
 
     If filter_ids is given, only decode entries whose id is in the set.
     Other entries are skipped without touching their payload data.
-    """
-    if len(data) < PACKET_HEADER_SIZE:
-        return PacketResult(entries=[], dropped=0)
 
-    entry_count, flags, payload_size, dropped, _reserved = struct.unpack_from(
-        PACKET_HEADER_FMT, data, 0
-    )
+    Tick timestamps are converted to nanoseconds with schema.clock.  A clock
+    update packet (PACKET_FLAG_CLOCK) is returned with no entries and its
+    calibration in ``clock``; callers apply it to schema.clock.  Compressed
+    packets (PACKET_FLAG_COMPRESSED) are expanded first.
+    """
+    data, entry_count, dropped, clock = _open_packet(data)
+    if clock is not None:
+        return PacketResult(entries=[], dropped=dropped, clock=clock)
 
     table_offset = PACKET_HEADER_SIZE
     payload_base = table_offset + entry_count * ENTRY_HEADER_SIZE
@@ -83,7 +265,7 @@ def decode_packet(schema: Schema, data: bytes,
 
         results.append(DecodedEntry(
             id=entry_id,
-            timestamp=timestamp,
+            timestamp=schema.timestamp_ns(timestamp),
             payload_size=psz,
             raw_payload=payload,
             fields=fields,
@@ -93,6 +275,103 @@ def decode_packet(schema: Schema, data: bytes,
     return PacketResult(entries=results, dropped=dropped)
 
 
+def decode_packet_arrays(schema: Schema, data: bytes,
+                         filter_ids: set[int] | None = None) -> PacketArrays:
+    """Decode a packet into one structured array per schema ID.
+
+    The vectorised counterpart of decode_packet(): the entry table is read
+    with np.frombuffer() and grouped by ID, and each group's payloads are
+    viewed in place when they are packed back to back, or gathered
+    otherwise.  No per-entry Python objects are made.  Entries with IDs
+    missing from the schema, or payloads shorter than it declares, are
+    left out.  Clock, schema and compressed packets are handled as in
+    decode_packet().
+    """
+    import numpy as np
+
+    data, entry_count, dropped, clock = _open_packet(data)
+    arrays: dict[int, EntryArrays] = {}
+    if not entry_count:
+        return PacketArrays(arrays=arrays, dropped=dropped, clock=clock)
+
+    payload_base = PACKET_HEADER_SIZE + entry_count * ENTRY_HEADER_SIZE
+    table = np.frombuffer(data, dtype=_entry_header_dtype(np),
+                          count=entry_count, offset=PACKET_HEADER_SIZE)
+    ids = table["id"]
+    raw = None
+
+    for entry_id in np.unique(ids).tolist():
+        if filter_ids is not None and entry_id not in filter_ids:
+            continue
+        schema_entry = schema.entries.get(entry_id)
+        if schema_entry is None:
+            continue
+        dt = schema.dtype(entry_id)
+        size = dt.itemsize
+
+        rows = table[ids == entry_id]
+        starts = rows["payload_offset"].astype(np.int64) + payload_base
+        ok = (rows["payload_size"] >= size) & (starts + size <= len(data))
+        if not ok.all():
+            rows, starts = rows[ok], starts[ok]
+        n = len(rows)
+
+        if n and size and (n == 1 or (np.diff(starts) == size).all()):
+            values = np.frombuffer(data, dtype=dt, count=n, offset=int(starts[0]))
+        elif size:
+            if raw is None:
+                raw = np.frombuffer(data, dtype=np.uint8)
+            values = raw[starts[:, None] + np.arange(size)].view(dt)[:, 0]
+        else:
+            values = np.zeros(n, dtype=dt)
+
+        arrays[entry_id] = EntryArrays(
+            id=entry_id,
+            name=schema_entry.name,
+            timestamps=schema.timestamps_ns(rows["timestamp"]),
+            values=values,
+        )
+
+    return PacketArrays(arrays=arrays, dropped=dropped)
+
+
+def concat_arrays(parts: list[dict[int, EntryArrays]]) -> dict[int, EntryArrays]:
+    """Join per-packet decode_packet_arrays() results, ID by ID."""
+    import numpy as np
+
+    grouped: dict[int, list[EntryArrays]] = {}
+    for part in parts:
+        for entry_id, ea in part.items():
+            grouped.setdefault(entry_id, []).append(ea)
+
+    out: dict[int, EntryArrays] = {}
+    for entry_id, group in grouped.items():
+        if len(group) == 1:
+            out[entry_id] = group[0]
+            continue
+        out[entry_id] = EntryArrays(
+            id=entry_id,
+            name=group[0].name,
+            timestamps=np.concatenate([ea.timestamps for ea in group]),
+            values=np.concatenate([ea.values for ea in group]),
+        )
+    return out
+
+
+_ENTRY_HEADER_DTYPE = None
+
+
+def _entry_header_dtype(np: Any) -> Any:
+    """btelem_entry_header as a NumPy dtype (matches ENTRY_HEADER_FMT)."""
+    global _ENTRY_HEADER_DTYPE
+    if _ENTRY_HEADER_DTYPE is None:
+        _ENTRY_HEADER_DTYPE = np.dtype([
+            ("id", "<u2"), ("payload_size", "<u2"),
+            ("payload_offset", "<u4"), ("timestamp", "<u8"),
+        ])
+    return _ENTRY_HEADER_DTYPE
+
+
 class PacketDecoder:
     """Stateful stream decoder that reassembles packets from a byte stream.
 
@@ -112,8 +391,34 @@ class PacketDecoder:
 
     def feed(self, data: bytes) -> list[DecodedEntry]:
         """Feed raw bytes, return any complete decoded entries."""
-        self._buf.extend(data)
         results: list[DecodedEntry] = []
+        for pkt_data in self._packets(data):
+            result = decode_packet(self.schema, pkt_data, self.filter_ids)
+            if result.clock is not None:
+                self.schema.clock = result.clock
+            self.dropped += result.dropped
+            results.extend(result.entries)
+        return results
+
+    def feed_arrays(self, data: bytes) -> dict[int, EntryArrays]:
+        """Like feed(), but decode with decode_packet_arrays().
+
+        Returns one EntryArrays per schema ID seen in the packets completed
+        by this call, in arrival order.
+        """
+        parts: list[dict[int, EntryArrays]] = []
+        for pkt_data in self._packets(data):
+            result = decode_packet_arrays(self.schema, pkt_data, self.filter_ids)
+            if result.clock is not None:
+                self.schema.clock = result.clock
+            self.dropped += result.dropped
+            if result.arrays:
+                parts.append(result.arrays)
+        return concat_arrays(parts)
+
+    def _packets(self, data: bytes) -> Iterator[bytes]:
+        """Buffer data and yield each complete packet it finishes."""
+        self._buf.extend(data)
 
         while len(self._buf) >= 4:
             pkt_len = struct.unpack_from("<I", self._buf, 0)[0]
@@ -129,12 +434,7 @@ class PacketDecoder:
 
             pkt_data = bytes(self._buf[4:total])
             del self._buf[:total]
-
-            result = decode_packet(self.schema, pkt_data, self.filter_ids)
-            self.dropped += result.dropped
-            results.extend(result.entries)
-
-        return results
+            yield pkt_data
 
     def reset(self):
         """Clear internal buffer."""
@@ -46,7 +46,7 @@ class BtelemData:
     """Raw captured telemetry suitable for serialisation (e.g. HDF5).
 
     Attributes:
-        schema_bytes: Serialised schema blob (``Schema.to_bytes()``).
+        schema_bytes: Serialised schema blob, either format.
         packets:      Concatenated length-prefixed packets — each packet
                       is ``[u32 len][packet_bytes]``.
         packet_count: Number of packets stored.
@@ -277,6 +277,9 @@ class Recorder:
         raw_len = self._recv_exact(4)
         (schema_len,) = struct.unpack("<I", raw_len)
         schema_bytes = self._recv_exact(schema_len)
+        resolve = getattr(self._transport, "schema_blob", None)
+        if resolve is not None:
+            schema_bytes = resolve(schema_bytes)
         return schema_bytes, Schema.from_bytes(schema_bytes)
 
     def _recv_exact(self, n: int) -> bytes:
@@ -26,6 +26,22 @@ class BtelemType(IntEnum):
     STRING = 14
 
 
+# NumPy dtype codes by BtelemType, without byte order; see Schema.dtype()
+_TYPE_NP = {
+    BtelemType.U8: "u1",
+    BtelemType.U16: "u2",
+    BtelemType.U32: "u4",
+    BtelemType.U64: "u8",
+    BtelemType.I8: "i1",
+    BtelemType.I16: "i2",
+    BtelemType.I32: "i4",
+    BtelemType.I64: "i8",
+    BtelemType.F32: "f4",
+    BtelemType.F64: "f8",
+    BtelemType.BOOL: "?",
+    BtelemType.ENUM: "u1",
+}
+
 # struct format chars indexed by BtelemType (little-endian base)
 _TYPE_FMT = {
     BtelemType.U8: "B",
@@ -72,6 +88,16 @@ _BITFIELD_MAX_BITS = 32
 _BITFIELD_WIRE_FMT = f"<HHB{_BITFIELD_MAX_BITS * _BIT_NAME_MAX}s{_BITFIELD_MAX_BITS}s{_BITFIELD_MAX_BITS}s"
 _BITFIELD_WIRE_SIZE = struct.calcsize(_BITFIELD_WIRE_FMT)  # 1093
 
+# Compact schema format (btelem_schema_compact_header + length-prefixed records)
+SCHEMA_COMPACT_MAGIC = 0x53435442  # "BTCS"
+SCHEMA_COMPACT_VERSION = 1
+_COMPACT_HEADER_FMT = "<IBBHQ"
+_COMPACT_HEADER_SIZE = struct.calcsize(_COMPACT_HEADER_FMT)  # 16
+
+CLOCK_MAGIC = 0x4B435442  # "BTCK"
+CLOCK_WIRE_FMT = "<IIQQQ"
+CLOCK_WIRE_SIZE = struct.calcsize(CLOCK_WIRE_FMT)  # 32
+
 
 @dataclass
 class BitDef:
@@ -90,6 +116,11 @@ class FieldDef:
     enum_labels: list[str] | None = None
     bitfield_bits: list[BitDef] | None = None
 
+    def split_bits(self, raw: Any) -> dict[str, Any]:
+        """Split a raw bitfield value (int or integer array) into its bits."""
+        return {bd.name: (raw >> bd.start) & ((1 << bd.width) - 1)
+                for bd in self.bitfield_bits or ()}
+
 
 @dataclass
 class SchemaEntry:
@@ -105,6 +136,42 @@ class SchemaEntry:
     declared_field_count: int = 0
 
 
+@dataclass
+class ClockCalibration:
+    """Tick-counter calibration for schemas whose timestamps are raw ticks."""
+    tick_hz: int
+    ref_ticks: int
+    ref_ns: int
+
+    def to_ns(self, ticks: int) -> int:
+        """Convert a tick timestamp to CLOCK_MONOTONIC nanoseconds."""
+        return self.ref_ns + (ticks - self.ref_ticks) * 1_000_000_000 // self.tick_hz
+
+    def to_ns_array(self, ticks: Any) -> Any:
+        """to_ns() over a uint64 NumPy array, giving uint64 nanoseconds."""
+        import numpy as np
+        # Split the tick delta so the scaling cannot overflow 64 bits
+        d = (ticks - np.uint64(self.ref_ticks & 0xFFFFFFFFFFFFFFFF)).view(np.int64)
+        q, r = np.divmod(d, self.tick_hz)
+        ns = q * 1_000_000_000 + r * 1_000_000_000 // self.tick_hz + self.ref_ns
+        return ns.astype(np.uint64)
+
+    @classmethod
+    def from_bytes(cls, data: bytes, offset: int = 0) -> ClockCalibration | None:
+        """Parse a btelem_clock_wire record, or None if absent/invalid."""
+        if offset + CLOCK_WIRE_SIZE > len(data):
+            return None
+        magic, _, tick_hz, ref_ticks, ref_ns = struct.unpack_from(
+            CLOCK_WIRE_FMT, data, offset)
+        if magic != CLOCK_MAGIC or tick_hz == 0:
+            return None
+        return cls(tick_hz, ref_ticks, ref_ns)
+
+    def to_bytes(self) -> bytes:
+        return struct.pack(CLOCK_WIRE_FMT, CLOCK_MAGIC, 0,
+                           self.tick_hz, self.ref_ticks, self.ref_ns)
+
+
 def _unpack_str(raw: bytes) -> str:
     """Decode a null-terminated fixed-size string field."""
     return raw.split(b"\x00", 1)[0].decode("utf-8")
@@ -116,14 +183,70 @@ def _pack_str(s: str, size: int) -> bytes:
     return encoded.ljust(size, b"\x00")
 
 
+def _pack_lstr(s: str, size: int) -> bytes:
+    """Encode a string as u8 length + bytes, truncated like _pack_str."""
+    encoded = s.encode("utf-8")[:size - 1]
+    return bytes([len(encoded)]) + encoded
+
+
+def fnv1a64(data: bytes) -> int:
+    """64-bit FNV-1a, the compact schema hash."""
+    h = 0xcbf29ce484222325
+    for b in data:
+        h = ((h ^ b) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def compact_schema_hash(data: bytes) -> int | None:
+    """Hash from a compact schema blob's header, or None for other blobs."""
+    if len(data) < _COMPACT_HEADER_SIZE:
+        return None
+    magic, _, _, _, h = struct.unpack_from(_COMPACT_HEADER_FMT, data, 0)
+    return h if magic == SCHEMA_COMPACT_MAGIC else None
+
+
+class _CompactReader:
+    """Cursor over the records of a compact schema blob."""
+
+    def __init__(self, data: bytes, pos: int):
+        self.data = data
+        self.pos = pos
+
+    def u8(self) -> int:
+        if self.pos >= len(self.data):
+            raise ValueError("truncated compact schema")
+        v = self.data[self.pos]
+        self.pos += 1
+        return v
+
+    def u16(self) -> int:
+        if self.pos + 2 > len(self.data):
+            raise ValueError("truncated compact schema")
+        (v,) = struct.unpack_from("<H", self.data, self.pos)
+        self.pos += 2
+        return v
+
+    def str(self) -> str:
+        n = self.u8()
+        if self.pos + n > len(self.data):
+            raise ValueError("truncated compact schema")
+        raw = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return raw.decode("utf-8")
+
+
 class Schema:
     """Telemetry schema: knows how to decode raw payloads into dicts."""
 
     def __init__(self, entries: list[SchemaEntry] | None = None,
-                 endianness: str = "little"):
+                 endianness: str = "little",
+                 clock: ClockCalibration | None = None):
         self.entries: dict[int, SchemaEntry] = {}
         self.endianness = endianness
+        # None: timestamps are already nanoseconds
+        self.clock = clock
         self._prefix = "<" if endianness == "little" else ">"
+        self._dtypes: dict[int, Any] = {}
         if entries:
             for e in entries:
                 self.entries[e.id] = e
@@ -148,11 +271,7 @@ class Schema:
                     continue
                 raw = struct.unpack_from(f"{self._prefix}{size_fmt}", payload, f.offset)[0]
                 if f.bitfield_bits:
-                    bits: dict[str, int] = {}
-                    for bd in f.bitfield_bits:
-                        mask = (1 << bd.width) - 1
-                        bits[bd.name] = (raw >> bd.start) & mask
-                    result[f.name] = bits
+                    result[f.name] = f.split_bits(raw)
                 else:
                     result[f.name] = raw
                 continue
@@ -180,13 +299,56 @@ class Schema:
 
         return result
 
+    def dtype(self, entry_id: int) -> Any:
+        """NumPy structured dtype laying out one payload of entry_id.
+
+        Fields sit at their schema offsets and the itemsize is the payload
+        size, so np.frombuffer() over packed payloads gives one record per
+        entry.  Arrays become subarray fields, BYTES void and STRING bytes
+        (read up to the first NUL).  Enums and bitfields keep their raw
+        integers; FieldDef.split_bits() separates the bits.  Raises KeyError
+        for IDs not in the schema.
+        """
+        dt = self._dtypes.get(entry_id)
+        if dt is not None:
+            return dt
+
+        import numpy as np
+        schema = self.entries[entry_id]
+        names, formats, offsets = [], [], []
+        end = schema.payload_size
+        for f in schema.fields:
+            if f.type == BtelemType.STRING:
+                fmt: Any = f"S{f.size}"
+            elif f.type == BtelemType.BITFIELD:
+                fmt = {1: "u1", 2: "u2", 4: "u4"}.get(f.size, f"V{f.size}")
+            elif f.type in _TYPE_NP:
+                fmt = _TYPE_NP[f.type]
+            else:
+                fmt = f"V{f.size}"
+            if fmt[0] in "uif":
+                fmt = self._prefix + fmt
+            if f.count > 1 and f.type not in (BtelemType.BYTES, BtelemType.STRING):
+                fmt = (fmt, (f.count,))
+            names.append(f.name)
+            formats.append(fmt)
+            offsets.append(f.offset)
+            end = max(end, f.offset + np.dtype(fmt).itemsize)
+        dt = np.dtype({"names": names, "formats": formats,
+                       "offsets": offsets, "itemsize": end})
+        self._dtypes[entry_id] = dt
+        return dt
+
     # ------------------------------------------------------------------
     # Binary schema parsing (packed struct wire format)
     # ------------------------------------------------------------------
 
     @classmethod
     def from_bytes(cls, data: bytes) -> Schema:
-        """Parse a serialised schema blob (packed struct format)."""
+        """Parse a serialised schema blob (fixed-size or compact format)."""
+        if compact_schema_hash(data) is not None:
+            return cls._from_compact(data)
+
         endian_byte, entry_count = struct.unpack_from(_HEADER_FMT, data, 0)
         endianness = "little" if endian_byte == 0 else "big"
 
@@ -254,8 +416,67 @@ class Schema:
                 if entry and fidx < len(entry.fields):
                     entry.fields[fidx].bitfield_bits = bits
 
+        # Optional clock calibration record (tick timestamps)
+        schema.clock = ClockCalibration.from_bytes(data, pos)
+
         return schema
 
+    @classmethod
+    def _from_compact(cls, data: bytes) -> Schema:
+        _, version, endian_byte, entry_count, _ = struct.unpack_from(
+            _COMPACT_HEADER_FMT, data, 0)
+        if version != SCHEMA_COMPACT_VERSION:
+            raise ValueError(f"unsupported compact schema version {version}")
+        r = _CompactReader(data, _COMPACT_HEADER_SIZE)
+
+        entries: list[SchemaEntry] = []
+        for _ in range(entry_count):
+            eid, payload_size, field_count = r.u16(), r.u16(), r.u16()
+            name, desc = r.str(), r.str()
+            fields: list[FieldDef] = []
+            for _ in range(min(field_count, MAX_FIELDS)):
+                fname = r.str()
+                foffset, fsize = r.u16(), r.u16()
+                ftype, fcount = r.u8(), r.u8()
+                fields.append(FieldDef(fname, foffset, fsize,
+                                       BtelemType(ftype), fcount))
+            entries.append(SchemaEntry(eid, name, desc, payload_size, fields,
+                                       declared_field_count=field_count))
+
+        schema = cls(entries, "little" if endian_byte == 0 else "big")
+
+        for _ in range(r.u16()):
+            sid, fidx, lcount = r.u16(), r.u16(), r.u8()
+            labels = [r.str() for _ in range(lcount)]
+            entry = schema.entries.get(sid)
+            if entry and fidx < len(entry.fields):
+                entry.fields[fidx].enum_labels = labels
+
+        for _ in range(r.u16()):
+            sid, fidx, bcount = r.u16(), r.u16(), r.u8()
+            bits: list[BitDef] = []
+            for _ in range(bcount):
+                bname = r.str()
+                bits.append(BitDef(bname, r.u8(), r.u8()))
+            entry = schema.entries.get(sid)
+            if entry and fidx < len(entry.fields):
+                entry.fields[fidx].bitfield_bits = bits
+
+        schema.clock = ClockCalibration.from_bytes(data, r.pos)
+        return schema
+
+    def timestamp_ns(self, timestamp: int) -> int:
+        """Convert an entry timestamp to nanoseconds using the calibration."""
+        if self.clock is None:
+            return timestamp
+        return self.clock.to_ns(timestamp)
+
+    def timestamps_ns(self, ticks: Any) -> Any:
+        """timestamp_ns() over a uint64 NumPy array."""
+        if self.clock is None:
+            return ticks
+        return self.clock.to_ns_array(ticks)
+
     def to_bytes(self) -> bytes:
         """Serialise schema to packed struct wire format."""
         buf = bytearray(struct.pack(_HEADER_FMT,
@@ -320,4 +541,47 @@ class Schema:
                                    bytes(starts_raw),
                                    bytes(widths_raw)))
 
+        if self.clock is not None:
+            buf.extend(self.clock.to_bytes())
+
+        return bytes(buf)
+
+    def to_compact_bytes(self) -> bytes:
+        """Serialise schema to the compact format (header hash included)."""
+        body = bytearray()
+        enum_fields: list[tuple[int, int, list[str]]] = []
+        bf_fields: list[tuple[int, int, list[BitDef]]] = []
+        for e in self.entries.values():
+            body += struct.pack("<HHH", e.id, e.payload_size, len(e.fields))
+            body += _pack_lstr(e.name, NAME_MAX) + _pack_lstr(e.description, DESC_MAX)
+            for fi, f in enumerate(e.fields[:MAX_FIELDS]):
+                body += _pack_lstr(f.name, NAME_MAX)
+                body += struct.pack("<HHBB", f.offset, f.size, f.type, f.count)
+                if f.enum_labels:
+                    enum_fields.append((e.id, fi, f.enum_labels))
+                if f.bitfield_bits:
+                    bf_fields.append((e.id, fi, f.bitfield_bits))
+
+        body += struct.pack("<H", len(enum_fields))
+        for sid, fidx, labels in enum_fields:
+            labels = labels[:_ENUM_MAX_VALUES]
+            body += struct.pack("<HHB", sid, fidx, len(labels))
+            for label in labels:
+                body += _pack_lstr(label, _ENUM_LABEL_MAX)
+
+        body += struct.pack("<H", len(bf_fields))
+        for sid, fidx, bits in bf_fields:
+            bits = bits[:_BITFIELD_MAX_BITS]
+            body += struct.pack("<HHB", sid, fidx, len(bits))
+            for b in bits:
+                body += _pack_lstr(b.name, _BIT_NAME_MAX)
+                body += struct.pack("<BB", b.start, b.width)
+
+        buf = bytearray(struct.pack(_COMPACT_HEADER_FMT, SCHEMA_COMPACT_MAGIC,
+                                    SCHEMA_COMPACT_VERSION,
+                                    0 if self.endianness == "little" else 1,
+                                    len(self.entries), fnv1a64(body)))
+        buf += body
+        if self.clock is not None:
+            buf += self.clock.to_bytes()
         return bytes(buf)
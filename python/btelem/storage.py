@@ -4,20 +4,28 @@ File format:
   [magic: "BTLM" 4 bytes]
   [version: uint16 LE]
   [schema_len: uint32 LE]
-  [schema blob]
+  [schema blob]                 compact (Schema.to_compact_bytes) or fixed-size
   [packet 0]
   [packet 1]
   ...
   [packet N]
+  [first_id: uint32 × (N+2)]    ID summary: packet i's records are
+  [index_id × M]                  first_id[i]..first_id[i+1]-1, 4 bytes each
+  [ids_footer]                  16 bytes, ends where the index starts
   [index_entry × (N+1)]        28 bytes each, fixed stride
   [index_footer]                16 bytes at EOF
 
 Each packet is a btelem packed batch:
   [btelem_packet_header(8)][btelem_entry_header(16) × N][payload_buffer]
+or, with PACKET_FLAG_COMPRESSED set, the header followed by payload_size
+bytes of delta-coded entries (see decoder.compress_packet).  The index
+always describes the plain packet.
 
 The footer index enables binary search by timestamp without scanning
 the entire file.  If the footer is missing (crash before close), the
-reader falls back to sequential scanning.
+reader falls back to sequential scanning.  The ID summary (index v2) gives
+each packet's schema IDs with entry counts, so ID-filtered reads skip
+packets without them; files written without it remain valid.
 """
 
 from __future__ import annotations
@@ -28,11 +36,13 @@ from dataclasses import dataclass
 from pathlib import Path
 from typing import BinaryIO, Iterator
 
-from .schema import Schema
+from .schema import CLOCK_WIRE_SIZE, ClockCalibration, Schema
 from .decoder import (
-    DecodedEntry, decode_packet,
+    DecodedEntry, EntryArrays, decode_packet, decode_packet_arrays,
+    concat_arrays, compress_packet, decompress_packet,
     PACKET_HEADER_FMT, PACKET_HEADER_SIZE,
     ENTRY_HEADER_FMT, ENTRY_HEADER_SIZE,
+    PACKET_FLAG_CLOCK, PACKET_FLAG_COMPRESSED,
 )
 
 MAGIC = b"BTLM"
@@ -46,6 +56,12 @@ INDEX_ENTRY_SIZE = struct.calcsize(INDEX_ENTRY_FMT)  # 28
 INDEX_FOOTER_FMT = "<QII"
 INDEX_FOOTER_SIZE = struct.calcsize(INDEX_FOOTER_FMT)  # 16
 
+INDEX_IDS_MAGIC = 0x53444942  # "BIDS"
+INDEX_ID_FMT = "<HH"
+INDEX_ID_SIZE = struct.calcsize(INDEX_ID_FMT)  # 4
+INDEX_IDS_FOOTER_FMT = "<QII"
+INDEX_IDS_FOOTER_SIZE = struct.calcsize(INDEX_IDS_FOOTER_FMT)  # 16
+
 
 @dataclass
 class IndexEntry:
@@ -53,33 +69,60 @@ class IndexEntry:
     ts_min: int
     ts_max: int
     entry_count: int
+    id_counts: dict[int, int] | None = None  # {schema ID: entries}, from the ID summary
 
 
 # ---------------------------------------------------------------------------
 # Helpers
 # ---------------------------------------------------------------------------
 
-def _packet_ts_range(data: bytes) -> tuple[int, int]:
-    """Extract (ts_min, ts_max) from a packet by scanning entry headers."""
-    entry_count = struct.unpack_from("<H", data, 0)[0]
+def _packet_meta(data: bytes) -> tuple[int, int, dict[int, int]]:
+    """Extract (ts_min, ts_max, id_counts) from a packet by scanning entry
+    headers; id_counts is ordered by ID."""
+    entry_count, flags = struct.unpack_from("<HH", data, 0)
+    if flags & PACKET_FLAG_COMPRESSED:
+        data = decompress_packet(data)
     if entry_count == 0:
-        return 0, 0
+        return 0, 0, {}
     ts_min = (1 << 64) - 1
     ts_max = 0
+    counts: dict[int, int] = {}
     for i in range(entry_count):
         off = PACKET_HEADER_SIZE + i * ENTRY_HEADER_SIZE
+        entry_id = struct.unpack_from("<H", data, off)[0]
         timestamp = struct.unpack_from("<Q", data, off + 8)[0]
+        counts[entry_id] = counts.get(entry_id, 0) + 1
         if timestamp < ts_min:
             ts_min = timestamp
         if timestamp > ts_max:
             ts_max = timestamp
-    return ts_min, ts_max
+    return ts_min, ts_max, dict(sorted(counts.items()))
 
 
 def _packet_size(data: bytes) -> int:
     """Compute total packet size from its header."""
-    entry_count, _, payload_size, _, _ = struct.unpack_from(PACKET_HEADER_FMT, data, 0)
-    return PACKET_HEADER_SIZE + entry_count * ENTRY_HEADER_SIZE + payload_size
+    entry_count, flags, payload_size, _, _ = struct.unpack_from(PACKET_HEADER_FMT, data, 0)
+    return PACKET_HEADER_SIZE + _packet_body_size(entry_count, flags, payload_size)
+
+
+def _packet_body_size(entry_count: int, flags: int, payload_size: int) -> int:
+    """Bytes following the packet header."""
+    if flags & PACKET_FLAG_COMPRESSED:
+        return payload_size
+    return entry_count * ENTRY_HEADER_SIZE + payload_size
+
+
+def _time_mask(timestamps, ts_min: int | None, ts_max: int | None):
+    """Boolean mask of timestamps inside [ts_min, ts_max], or None for all."""
+    keep = None
+    if ts_min is not None:
+        keep = timestamps >= ts_min
+    if ts_max is not None:
+        below = timestamps <= ts_max
+        keep = below if keep is None else keep & below
+    if keep is not None and keep.all():
+        return None
+    return keep
 
 
 def build_packet(entries: list[tuple[int, int, bytes]]) -> bytes:
@@ -105,24 +148,40 @@ def build_packet(entries: list[tuple[int, int, bytes]]) -> bytes:
 # ---------------------------------------------------------------------------
 
 class LogWriter:
-    """Writes packets to a btelem log file.  Appends footer index on close."""
+    """Writes packets to a btelem log file.  Appends footer index on close.
+
+    Clock update packets are not stored; the newest calibration (the one fit
+    over the longest interval) replaces the schema's clock record on close.
+    With ``compress=True`` plain packets are stored compressed whenever that
+    makes them smaller.
+    """
 
-    def __init__(self, path: str | Path, schema: Schema):
+    def __init__(self, path: str | Path, schema: Schema, compress: bool = False):
         self._f: BinaryIO = open(path, "wb")
         self._schema = schema
+        self._compress = compress
         self._index: list[IndexEntry] = []
+        self._clock: ClockCalibration | None = None
 
-        schema_blob = schema.to_bytes()
+        schema_blob = schema.to_compact_bytes()
         self._f.write(struct.pack(FILE_HEADER_FMT, MAGIC, VERSION, len(schema_blob)))
         self._f.write(schema_blob)
+        self._clock_offset = (FILE_HEADER_SIZE + len(schema_blob) - CLOCK_WIRE_SIZE
+                              if schema.clock is not None else None)
 
     def write_packet(self, packet_data: bytes) -> None:
         """Write a pre-built packet (from btelem_drain_packed or build_packet)."""
+        flags = struct.unpack_from("<H", packet_data, 2)[0]
+        if flags & PACKET_FLAG_CLOCK:
+            self._clock = ClockCalibration.from_bytes(packet_data, PACKET_HEADER_SIZE)
+            return
         offset = self._f.tell()
         entry_count = struct.unpack_from("<H", packet_data, 0)[0]
-        ts_min, ts_max = _packet_ts_range(packet_data)
+        ts_min, ts_max, id_counts = _packet_meta(packet_data)
+        if self._compress and not flags:
+            packet_data = compress_packet(packet_data) or packet_data
         self._f.write(packet_data)
-        self._index.append(IndexEntry(offset, ts_min, ts_max, entry_count))
+        self._index.append(IndexEntry(offset, ts_min, ts_max, entry_count, id_counts))
 
     def write_entries(self, entries: list[tuple[int, int, bytes]]) -> None:
         """Write a list of (id, timestamp, payload) tuples as a single packet."""
@@ -133,9 +192,23 @@ class LogWriter:
 
     def close(self) -> None:
         self._write_index()
+        if self._clock is not None and self._clock_offset is not None:
+            self._f.seek(self._clock_offset)
+            self._f.write(self._clock.to_bytes())
         self._f.close()
 
     def _write_index(self) -> None:
+        ids_offset = self._f.tell()
+        first = 0
+        for ie in self._index:
+            self._f.write(struct.pack("<I", first))
+            first += len(ie.id_counts or {})
+        self._f.write(struct.pack("<I", first))
+        for ie in self._index:
+            for entry_id, count in (ie.id_counts or {}).items():
+                self._f.write(struct.pack(INDEX_ID_FMT, entry_id, count))
+        self._f.write(struct.pack(INDEX_IDS_FOOTER_FMT, ids_offset, first, INDEX_IDS_MAGIC))
+
         index_offset = self._f.tell()
         for ie in self._index:
             self._f.write(struct.pack(
@@ -168,6 +241,7 @@ class LogReader:
         self._index: list[IndexEntry] | None = None
         self._data_start: int = 0
         self._data_end: int | None = None  # file offset where packets end (index starts)
+        self._has_id_counts = False
 
     def open(self) -> Schema:
         """Open the file, parse schema and index."""
@@ -211,24 +285,61 @@ class LogReader:
         """Iterate over entries, optionally filtering by time range and/or IDs.
 
         With an index present, time-range queries seek directly to relevant
-        packets.  Without an index, falls back to sequential scan.
+        packets, and ID-filtered ones skip packets without those IDs when the
+        file has an ID summary.  Without an index, falls back to sequential
+        scan.
         """
+        for packet in self._packets(ts_min, ts_max, filter_ids):
+            for entry in decode_packet(self._schema, packet, filter_ids).entries:
+                # Per-entry time filter (packet may partially overlap range)
+                if ts_min is not None and entry.timestamp < ts_min:
+                    continue
+                if ts_max is not None and entry.timestamp > ts_max:
+                    continue
+                yield entry
+
+    def arrays(self, ts_min: int | None = None, ts_max: int | None = None,
+               filter_ids: set[int] | None = None) -> dict[int, EntryArrays]:
+        """Read the matching entries as one EntryArrays per schema ID.
+
+        Same selection as entries(), decoded with decode_packet_arrays();
+        enum labels and bitfield bits are left as raw integers.
+        """
+        return concat_arrays(list(self.packet_arrays(ts_min, ts_max, filter_ids)))
+
+    def packet_arrays(self, ts_min: int | None = None, ts_max: int | None = None,
+                      filter_ids: set[int] | None = None) -> Iterator[dict[int, EntryArrays]]:
+        """arrays() one packet at a time, skipping packets left empty."""
+        for packet in self._packets(ts_min, ts_max, filter_ids):
+            arrays = decode_packet_arrays(self._schema, packet, filter_ids).arrays
+            if ts_min is not None or ts_max is not None:
+                for entry_id, ea in list(arrays.items()):
+                    keep = _time_mask(ea.timestamps, ts_min, ts_max)
+                    if keep is not None:
+                        arrays[entry_id] = EntryArrays(
+                            ea.id, ea.name, ea.timestamps[keep], ea.values[keep])
+            if any(len(ea.timestamps) for ea in arrays.values()):
+                yield arrays
+
+    def _packets(self, ts_min: int | None, ts_max: int | None,
+                 filter_ids: set[int] | None) -> Iterator[bytes]:
+        """Yield the raw packets that may hold matching entries."""
         if self._f is None:
             self.open()
 
         assert self._f is not None
         assert self._schema is not None
 
-        if self._index is not None and (ts_min is not None or ts_max is not None):
-            yield from self._entries_indexed(ts_min, ts_max, filter_ids)
+        if self._index is not None and (ts_min is not None or ts_max is not None
+                                        or (filter_ids is not None and self._has_id_counts)):
+            yield from self._packets_indexed(ts_min, ts_max, filter_ids)
         else:
             self._f.seek(self._data_start)
-            yield from self._entries_sequential(filter_ids)
+            yield from self._packets_sequential()
 
-    def _entries_sequential(self, filter_ids: set[int] | None) -> Iterator[DecodedEntry]:
+    def _packets_sequential(self) -> Iterator[bytes]:
         """Read packets sequentially until end of data section."""
         assert self._f is not None
-        assert self._schema is not None
 
         # If we have an index, we know exactly where packets end
         data_end = self._data_end
@@ -246,43 +357,37 @@ class LogReader:
                 PACKET_HEADER_FMT, hdr_data
             )
 
-            rest_size = entry_count * ENTRY_HEADER_SIZE + payload_size
+            rest_size = _packet_body_size(entry_count, flags, payload_size)
             rest_data = self._f.read(rest_size)
             if len(rest_data) < rest_size:
                 break
 
-            packet = hdr_data + rest_data
-            yield from decode_packet(self._schema, packet, filter_ids).entries
+            yield hdr_data + rest_data
 
-    def _entries_indexed(self, ts_min: int | None, ts_max: int | None,
-                         filter_ids: set[int] | None) -> Iterator[DecodedEntry]:
+    def _packets_indexed(self, ts_min: int | None, ts_max: int | None,
+                         filter_ids: set[int] | None) -> Iterator[bytes]:
         """Use the index to seek to relevant packets by time range."""
         assert self._f is not None
         assert self._schema is not None
         assert self._index is not None
 
+        to_ns = self._schema.timestamp_ns
         for ie in self._index:
             # Skip packets entirely outside the time range
-            if ts_max is not None and ie.ts_min > ts_max:
+            if ts_max is not None and to_ns(ie.ts_min) > ts_max:
+                continue
+            if ts_min is not None and to_ns(ie.ts_max) < ts_min:
                 continue
-            if ts_min is not None and ie.ts_max < ts_min:
+            if (filter_ids is not None and ie.id_counts is not None
+                    and filter_ids.isdisjoint(ie.id_counts)):
                 continue
 
             self._f.seek(ie.offset)
-            pkt_data = self._f.read(
-                PACKET_HEADER_SIZE + ie.entry_count * ENTRY_HEADER_SIZE
-            )
-            # Read payload size from header
-            _, _, payload_size, _, _ = struct.unpack_from(PACKET_HEADER_FMT, pkt_data, 0)
-            pkt_data += self._f.read(payload_size)
-
-            for entry in decode_packet(self._schema, pkt_data, filter_ids).entries:
-                # Per-entry time filter (packet may partially overlap range)
-                if ts_min is not None and entry.timestamp < ts_min:
-                    continue
-                if ts_max is not None and entry.timestamp > ts_max:
-                    continue
-                yield entry
+            pkt_data = self._f.read(PACKET_HEADER_SIZE)
+            entry_count, flags, payload_size, _, _ = struct.unpack_from(
+                PACKET_HEADER_FMT, pkt_data, 0)
+            pkt_data += self._f.read(_packet_body_size(entry_count, flags, payload_size))
+            yield pkt_data
 
     def _try_load_index(self) -> list[IndexEntry] | None:
         """Read the footer index if present.  Returns None if absent."""
@@ -316,9 +421,35 @@ class LogReader:
             offset, ts_min, ts_max, entry_count = struct.unpack(INDEX_ENTRY_FMT, data)
             index.append(IndexEntry(offset, ts_min, ts_max, entry_count))
 
-        self._data_end = index_offset
+        self._data_end = self._try_load_id_counts(index, index_offset)
         return index
 
+    def _try_load_id_counts(self, index: list[IndexEntry], index_offset: int) -> int:
+        """Fill index[i].id_counts from the ID summary if the file has one.
+        Returns the offset where packets end."""
+        assert self._f is not None
+
+        if index_offset < self._data_start + INDEX_IDS_FOOTER_SIZE:
+            return index_offset
+        self._f.seek(index_offset - INDEX_IDS_FOOTER_SIZE)
+        ids_offset, id_count, magic = struct.unpack(
+            INDEX_IDS_FOOTER_FMT, self._f.read(INDEX_IDS_FOOTER_SIZE))
+        n = len(index)
+        size = (n + 1) * 4 + id_count * INDEX_ID_SIZE + INDEX_IDS_FOOTER_SIZE
+        if magic != INDEX_IDS_MAGIC or ids_offset < self._data_start \
+                or ids_offset + size != index_offset:
+            return index_offset
+
+        self._f.seek(ids_offset)
+        first = struct.unpack(f"<{n + 1}I", self._f.read((n + 1) * 4))
+        records = list(struct.iter_unpack(INDEX_ID_FMT, self._f.read(id_count * INDEX_ID_SIZE)))
+        if first[n] != id_count or any(first[i] > first[i + 1] for i in range(n)):
+            return index_offset
+        for i, ie in enumerate(index):
+            ie.id_counts = dict(records[first[i]:first[i + 1]])
+        self._has_id_counts = True
+        return ids_offset
+
     def close(self) -> None:
         if self._f:
             self._f.close()
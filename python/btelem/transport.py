@@ -3,8 +3,65 @@
 from __future__ import annotations
 
 import socket
+import struct
+from collections.abc import Iterable, Mapping, MutableMapping
 from typing import Protocol
 
+# Viewer -> server control messages (must match btelem_types.h)
+CTRL_SUBSCRIBE = 1
+CTRL_UNSUBSCRIBE = 2
+CTRL_RESET = 3
+CTRL_HELLO = 4
+CTRL_COMPRESS = 5
+
+# Server reply to CTRL_HELLO (btelem_schema_hello)
+SCHEMA_HELLO_MAGIC = 0x48535442  # "BTSH"
+SCHEMA_HELLO_FMT = "<IIQ"
+SCHEMA_HELLO_SIZE = struct.calcsize(SCHEMA_HELLO_FMT)  # 16
+
+
+def encode_control(kind: int,
+                   subs: Mapping[int, float] | Iterable[int] = ()) -> bytes:
+    """Encode a length-prefixed control message.
+
+    *subs* maps schema ID to maximum rate in Hz (0 = every entry), or is a
+    plain iterable of IDs at full rate.
+    """
+    if not isinstance(subs, Mapping):
+        subs = {i: 0.0 for i in subs}
+    body = struct.pack("<HH", kind, len(subs))
+    for sid, rate in subs.items():
+        interval_us = min(int(round(1e6 / rate)), 0xFFFFFFFF) if rate > 0 else 0
+        body += struct.pack("<HHI", sid, 0, interval_us)
+    return struct.pack("<I", len(body)) + body
+
+
+def encode_hello(schema_hash: int = 0) -> bytes:
+    """Encode the HELLO a viewer sends on connect: the hash of the compact
+    schema it holds for this server, or 0 for none."""
+    body = struct.pack("<HHQ", CTRL_HELLO, 0, schema_hash)
+    return struct.pack("<I", len(body)) + body
+
+
+def resolve_schema(msg: bytes, cached: bytes | None = None) -> bytes:
+    """Schema blob from the first message of a TCP stream.
+
+    That is either a HELLO reply (the compact schema, or just its hash when
+    *cached* is current) or, from servers without HELLO support, the
+    fixed-size schema itself.
+    """
+    if len(msg) < SCHEMA_HELLO_SIZE:
+        return msg
+    magic, size, schema_hash = struct.unpack_from(SCHEMA_HELLO_FMT, msg, 0)
+    if magic != SCHEMA_HELLO_MAGIC:
+        return msg
+    if size:
+        return msg[SCHEMA_HELLO_SIZE:SCHEMA_HELLO_SIZE + size]
+    from .schema import compact_schema_hash
+    if cached is None or compact_schema_hash(cached) != schema_hash:
+        raise ValueError("server skipped a schema this viewer does not hold")
+    return cached
+
 
 class Transport(Protocol):
     """Abstract transport interface."""
@@ -58,13 +115,132 @@ class UDPTransport:
         self._sock.close()
 
 
+class UDPPacketReceiver:
+    """Receiver for btelem_serve_udp_binary() datagrams.
+
+    Each datagram is one packet.  The schema arrives in-band as
+    PACKET_FLAG_SCHEMA fragments (resent periodically), so a receiver can
+    start at any time; data datagrams before the first complete schema are
+    discarded.  ``lost`` counts datagrams missing from the sequence number
+    in the header's reserved field, ``dropped`` ring overwrites reported by
+    the sender.
+
+    ``feed()`` decodes a datagram without touching the socket, for callers
+    that receive datagrams themselves.
+    """
+
+    def __init__(self, host: str = "0.0.0.0", port: int = 4200,
+                 filter_ids: set[int] | None = None, timeout: float = 1.0,
+                 bind: bool = True):
+        self.schema = None
+        self.filter_ids = filter_ids
+        self.lost: int = 0
+        self.dropped: int = 0
+        self._next_seq: int | None = None
+        self._schema_bytes = b""
+        self._frag = bytearray()
+        self._frag_total = 0
+        self._sock = None
+        if bind:
+            self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self._sock.bind((host, port))
+            self._sock.settimeout(timeout)
+
+    def recv(self) -> list:
+        """Receive one datagram; return its decoded entries ([] on timeout)."""
+        try:
+            data = self._sock.recv(65536)
+        except socket.timeout:
+            return []
+        return self.feed(data)
+
+    def feed(self, data: bytes) -> list:
+        """Decode one datagram, return its entries."""
+        from .decoder import (
+            PACKET_FLAG_SCHEMA, PACKET_HEADER_FMT, PACKET_HEADER_SIZE,
+            decode_packet,
+        )
+        from .schema import Schema
+
+        if len(data) < PACKET_HEADER_SIZE:
+            return []
+        _, flags, payload_size, _, seq = struct.unpack_from(
+            PACKET_HEADER_FMT, data, 0)
+
+        if self._next_seq is not None:
+            gap = (seq - self._next_seq) & 0xFFFFFFFF
+            if gap < 0x80000000:  # otherwise reordered or sender restarted
+                self.lost += gap
+        self._next_seq = (seq + 1) & 0xFFFFFFFF
+
+        if flags & PACKET_FLAG_SCHEMA:
+            total, offset = struct.unpack_from("<II", data, PACKET_HEADER_SIZE)
+            chunk = data[PACKET_HEADER_SIZE + 8:PACKET_HEADER_SIZE + payload_size]
+            if offset == 0:
+                self._frag = bytearray()
+                self._frag_total = total
+            if total != self._frag_total or offset != len(self._frag):
+                self._frag = bytearray()  # lost a fragment; wait for resend
+                return []
+            self._frag.extend(chunk)
+            if len(self._frag) == total:
+                blob = bytes(self._frag)
+                if blob != self._schema_bytes:  # resends are identical
+                    self.schema = Schema.from_bytes(blob)
+                    self._schema_bytes = blob
+                self._frag = bytearray()
+            return []
+
+        if self.schema is None:
+            return []
+        result = decode_packet(self.schema, data, self.filter_ids)
+        if result.clock is not None:
+            self.schema.clock = result.clock
+        self.dropped += result.dropped
+        return result.entries
+
+    def close(self) -> None:
+        if self._sock is not None:
+            self._sock.close()
+
+
 class TCPTransport:
-    """TCP stream transport (client mode)."""
+    """TCP stream transport (client mode).
+
+    Sends HELLO on connect, so the server answers with the compact schema.
+    *schema_cache* (any mapping, e.g. a dict kept across reconnects or a
+    ``shelve``) holds the last schema per ``"host:port"``; when the server
+    still has that schema it sends only the hash.  Pass the stream's first
+    message through :meth:`schema_blob`.
+
+    With ``compress=True`` the server is asked for compressed packets
+    (PACKET_FLAG_COMPRESSED); decode_packet, LogWriter and LiveCapture
+    accept them as they are.
+    """
+
+    def __init__(self, host: str, port: int, timeout: float = 5.0,
+                 schema_cache: MutableMapping[str, bytes] | None = None,
+                 compress: bool = False):
+        from .schema import compact_schema_hash
 
-    def __init__(self, host: str, port: int, timeout: float = 5.0):
         self._sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self._sock.settimeout(timeout)
         self._sock.connect((host, port))
+        self._cache = schema_cache
+        self._cache_key = f"{host}:{port}"
+        cached = schema_cache.get(self._cache_key) if schema_cache is not None else None
+        self.write(encode_hello((cached and compact_schema_hash(cached)) or 0))
+        if compress:
+            self.write(encode_control(CTRL_COMPRESS))
+
+    def schema_blob(self, msg: bytes) -> bytes:
+        """Resolve the stream's first message to a schema blob (see
+        :func:`resolve_schema`), updating the cache."""
+        cached = self._cache.get(self._cache_key) if self._cache is not None else None
+        blob = resolve_schema(msg, cached)
+        if self._cache is not None and blob is not cached:
+            self._cache[self._cache_key] = blob
+        return blob
 
     def read(self, n: int) -> bytes:
         try:
@@ -87,6 +263,27 @@ class TCPTransport:
     def write(self, data: bytes) -> None:
         self._sock.sendall(data)
 
+    def subscribe(self, ids: Mapping[int, float] | Iterable[int],
+                  max_rate_hz: float = 0.0) -> None:
+        """Ask the server to send *ids*, each at most *max_rate_hz* (0 = every
+        entry); a mapping gives each ID its own rate.
+
+        The first subscription drops every ID not listed from the stream;
+        later ones add IDs or change their rate.  Decimation is by entry
+        timestamp on the server, so it saves link bandwidth.
+        """
+        if not isinstance(ids, Mapping):
+            ids = {i: max_rate_hz for i in ids}
+        self.write(encode_control(CTRL_SUBSCRIBE, ids))
+
+    def unsubscribe(self, ids: Iterable[int]) -> None:
+        """Stop sending *ids*."""
+        self.write(encode_control(CTRL_UNSUBSCRIBE, ids))
+
+    def subscribe_all(self) -> None:
+        """Return to every ID at full rate (the state on connect)."""
+        self.write(encode_control(CTRL_RESET))
+
     def close(self) -> None:
         self._sock.close()
 
@@ -9,7 +9,8 @@ setup(
             "btelem._native",
             sources=["btelem/_native.c"],
             include_dirs=["../include", numpy.get_include()],
-            extra_compile_args=["-std=c99", "-O2", "-Wall"],
+            extra_compile_args=["-std=c99", "-O2", "-Wall", "-pthread"],
+            extra_link_args=["-pthread"],
         ),
     ],
 )
@@ -10,6 +10,70 @@ static int is_power_of_2(uint32_t v)
     return v && !(v & (v - 1));
 }
 
+/* a * b / c without intermediate overflow (b * c must fit in 64 bits on
+ * compilers without a 128-bit type) */
+static uint64_t muldiv64(uint64_t a, uint64_t b, uint64_t c)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)((unsigned __int128)a * b / c);
+#else
+    return (a / c) * b + (a % c) * b / c;
+#endif
+}
+
+/* Shared tail of every btelem_init*(): calibrate the tick clock, if any */
+static void init_clock(struct btelem_ctx *ctx)
+{
+#ifdef BTELEM_TIMESTAMP_TICKS
+    btelem_clock_calibrate(ctx);
+#else
+    (void)ctx;
+#endif
+}
+
+/* --------------------------------------------------------------------------
+ * Live sharded contexts
+ *
+ * A thread evicting a shard binding (see binding_front) releases the shard
+ * through the binding's ctx, which may have been freed since.  Each live
+ * sharded ctx owns a slot here holding its epoch, so the evicting thread
+ * checks the slot instead of the ctx.  SHARD_LIVE_BUSY is set while it
+ * uses the ctx; retiring the ctx waits for the bit to clear.
+ * ----------------------------------------------------------------------- */
+
+#define SHARD_LIVE_BUSY (1ULL << 63)
+
+static btelem_atomic_u64 shard_live_epoch[BTELEM_MAX_SHARDED_CTXS];
+static btelem_atomic_u64 shard_live_owner[BTELEM_MAX_SHARDED_CTXS];  /* ctx address */
+
+static int shard_live_enlist(struct btelem_ctx *ctx)
+{
+    for (uint32_t i = 0; i < BTELEM_MAX_SHARDED_CTXS; i++) {
+        uint64_t cur = 0;
+        do {
+            if (btelem_atomic_cas(&shard_live_epoch[i], &cur, ctx->shard_epoch)) {
+                btelem_atomic_store_rel(&shard_live_owner[i], (uint64_t)(uintptr_t)ctx);
+                ctx->shard_live = i;
+                return 0;
+            }
+        } while (cur == 0);
+    }
+    return -1;
+}
+
+static void shard_live_retire(const struct btelem_ctx *ctx)
+{
+    for (uint32_t i = 0; i < BTELEM_MAX_SHARDED_CTXS; i++) {
+        if (btelem_atomic_load_acq(&shard_live_owner[i]) != (uint64_t)(uintptr_t)ctx)
+            continue;
+        btelem_atomic_store_rel(&shard_live_owner[i], 0);
+        /* Wait out a thread releasing an evicted shard through ctx */
+        uint64_t epoch = btelem_atomic_load_acq(&shard_live_epoch[i]) & ~SHARD_LIVE_BUSY;
+        while (!btelem_atomic_cas(&shard_live_epoch[i], &epoch, 0))
+            epoch &= ~SHARD_LIVE_BUSY;
+    }
+}
+
 /* --------------------------------------------------------------------------
  * Init
  * ----------------------------------------------------------------------- */
@@ -24,7 +88,9 @@ int btelem_init(struct btelem_ctx *ctx, void *ring_buf, uint32_t entry_count)
     if (!ctx || !ring_buf || !is_power_of_2(entry_count))
         return -1;
 
+    shard_live_retire(ctx);
     memset(ctx, 0, sizeof(*ctx));
+    ctx->clients = ctx->client_slots;
     ctx->endianness = BTELEM_LITTLE_ENDIAN ? 0 : 1;
 
     struct btelem_ring *r = (struct btelem_ring *)ring_buf;
@@ -33,9 +99,379 @@ int btelem_init(struct btelem_ctx *ctx, void *ring_buf, uint32_t entry_count)
     r->mask = entry_count - 1;
 
     ctx->ring = r;
+    btelem_atomic_store_rel(&ctx->wake_at, UINT64_MAX);
+    init_clock(ctx);
+    return 0;
+}
+
+void btelem_deinit(struct btelem_ctx *ctx)
+{
+    if (!ctx)
+        return;
+    shard_live_retire(ctx);
+    ctx->shard_epoch = 0;
+}
+
+size_t btelem_ring_size_var(uint32_t unit_count)
+{
+    return sizeof(struct btelem_ring) + (size_t)unit_count * BTELEM_VAR_UNIT;
+}
+
+int btelem_init_var(struct btelem_ctx *ctx, void *ring_buf, uint32_t unit_count)
+{
+    if (!ctx || !ring_buf || !is_power_of_2(unit_count)
+        || unit_count < BTELEM_VAR_MAX_UNITS)
+        return -1;
+
+    shard_live_retire(ctx);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->clients = ctx->client_slots;
+    ctx->endianness = BTELEM_LITTLE_ENDIAN ? 0 : 1;
+    ctx->ring_mode = BTELEM_RING_VAR;
+
+    struct btelem_ring *r = (struct btelem_ring *)ring_buf;
+    memset(r, 0, btelem_ring_size_var(unit_count));
+    r->capacity = unit_count;
+    r->mask = unit_count - 1;
+
+    ctx->ring = r;
+    btelem_atomic_store_rel(&ctx->wake_at, UINT64_MAX);
+    init_clock(ctx);
+    return 0;
+}
+
+size_t btelem_ring_size_sharded(uint32_t shard_count, uint32_t entries_per_shard)
+{
+    return (size_t)shard_count * btelem_ring_size(entries_per_shard);
+}
+
+BTELEM_THREAD_LOCAL struct btelem_shard_binding btelem_tls_shard;
+
+static btelem_atomic_u64 shard_epoch_counter;
+
+int btelem_init_sharded(struct btelem_ctx *ctx, void *ring_buf,
+                        uint32_t shard_count, uint32_t entries_per_shard)
+{
+    if (!ctx || !ring_buf || !is_power_of_2(entries_per_shard)
+        || shard_count == 0 || shard_count > BTELEM_MAX_SHARDS)
+        return -1;
+
+    shard_live_retire(ctx);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->clients = ctx->client_slots;
+    ctx->endianness = BTELEM_LITTLE_ENDIAN ? 0 : 1;
+    ctx->ring_mode = BTELEM_RING_SHARDED;
+    ctx->shard_count = (uint16_t)shard_count;
+    ctx->shard_epoch = btelem_atomic_fetch_add_relaxed(&shard_epoch_counter, 1) + 1;
+    if (shard_live_enlist(ctx) < 0)
+        return -1;
+
+    size_t stride = btelem_ring_size(entries_per_shard);
+    memset(ring_buf, 0, btelem_ring_size_sharded(shard_count, entries_per_shard));
+    for (uint32_t s = 0; s < shard_count; s++) {
+        struct btelem_ring *r = (struct btelem_ring *)((uint8_t *)ring_buf + s * stride);
+        r->capacity = entries_per_shard;
+        r->mask = entries_per_shard - 1;
+        ctx->shards[s] = r;
+    }
+
+    ctx->ring = ctx->shards[0];
+    btelem_atomic_store_rel(&ctx->wake_at, UINT64_MAX);
+    init_clock(ctx);
+    return 0;
+}
+
+/* Claim the lowest free shard, or -1.  The CAS also acquires the previous
+ * owner's writes to that shard. */
+static int shard_claim(struct btelem_ctx *ctx)
+{
+    uint64_t busy = btelem_atomic_load_acq(&ctx->shards_busy);
+    int shard;
+    do {
+        shard = 0;
+        while (shard < ctx->shard_count && (busy & (1ULL << shard)))
+            shard++;
+        if (shard == ctx->shard_count)
+            return -1;
+    } while (!btelem_atomic_cas(&ctx->shards_busy, &busy, busy | (1ULL << shard)));
+    return shard;
+}
+
+/* Claim shard `shard`, or -1 if another thread holds it */
+static int shard_claim_at(struct btelem_ctx *ctx, int shard)
+{
+    uint64_t busy = btelem_atomic_load_acq(&ctx->shards_busy);
+    do {
+        if (busy & (1ULL << shard))
+            return -1;
+    } while (!btelem_atomic_cas(&ctx->shards_busy, &busy, busy | (1ULL << shard)));
+    return shard;
+}
+
+static void shard_release(struct btelem_ctx *ctx, const struct btelem_ring *r)
+{
+    int shard = 0;
+    while (ctx->shards[shard] != r)
+        shard++;
+    uint64_t busy = btelem_atomic_load_relaxed(&ctx->shards_busy);
+    while (!btelem_atomic_cas(&ctx->shards_busy, &busy, busy & ~(1ULL << shard)))
+        ;
+    /* Unbound threads that see the new count also see the free bit */
+    btelem_atomic_fence_rel();
+    btelem_atomic_fetch_add_relaxed(&ctx->shard_releases, 1);
+}
+
+/*
+ * Per-thread bindings, most recently used first.  btelem_tls_shard is the
+ * front (the only one the inline log path looks at); the rest let a thread
+ * alternate between sharded contexts without claiming a new shard each
+ * time.  An empty slot has ctx == NULL.
+ */
+static BTELEM_THREAD_LOCAL struct btelem_shard_binding
+    tls_shard_rest[BTELEM_SHARD_BINDINGS - 1];
+
+static int binding_live(const struct btelem_shard_binding *b,
+                        const struct btelem_ctx *ctx)
+{
+    return b->ctx == ctx && b->epoch == ctx->shard_epoch;
+}
+
+/* Release an evicted binding's shard, unless its ctx has been retired
+ * (and possibly freed) since */
+static void binding_release(const struct btelem_shard_binding *b)
+{
+    btelem_atomic_u64 *live = &shard_live_epoch[b->live];
+    uint64_t epoch = b->epoch;
+    while (!btelem_atomic_cas(live, &epoch, b->epoch | SHARD_LIVE_BUSY)) {
+        if ((epoch & ~SHARD_LIVE_BUSY) != b->epoch)
+            return;
+        epoch = b->epoch;   /* another thread is releasing: wait */
+    }
+    shard_release((struct btelem_ctx *)b->ctx, b->ring);
+    btelem_atomic_store_rel(live, b->epoch);
+}
+
+/* Move ctx's binding to the front, or make room there for a new one (an
+ * empty front with ctx == NULL).  Evicting the least recently used binding
+ * releases its shard. */
+static struct btelem_shard_binding *binding_front(struct btelem_ctx *ctx)
+{
+    struct btelem_shard_binding *front = &btelem_tls_shard;
+    struct btelem_shard_binding *rest = tls_shard_rest;
+    const int n = BTELEM_SHARD_BINDINGS - 1;
+    if (binding_live(front, ctx))
+        return front;
+    if (front->ctx == ctx)
+        memset(front, 0, sizeof(*front));   /* ctx was re-initialised */
+
+    /* The slot that drops out when the front shifts down: ctx's own
+     * binding if it has one, else an empty slot, else the LRU */
+    int k = 0;
+    while (k < n && rest[k].ctx != ctx)
+        k++;
+    if (k == n) {
+        if (!front->ctx)
+            return front;
+        k = 0;
+        while (k < n - 1 && rest[k].ctx)
+            k++;
+    }
+
+    struct btelem_shard_binding out = rest[k];
+    if (front->ctx) {
+        for (int i = k; i > 0; i--)
+            rest[i] = rest[i - 1];
+        rest[0] = *front;
+    } else {
+        memset(&rest[k], 0, sizeof(rest[k]));
+    }
+
+    memset(front, 0, sizeof(*front));
+    if (out.ctx == ctx) {
+        if (binding_live(&out, ctx))
+            *front = out;
+    } else if (out.ctx && out.ring) {
+        binding_release(&out);
+    }
+    return front;
+}
+
+int btelem_shard_attach(struct btelem_ctx *ctx, int shard)
+{
+    if (!ctx || ctx->ring_mode != BTELEM_RING_SHARDED || shard >= ctx->shard_count)
+        return -1;
+
+    struct btelem_shard_binding *b = binding_front(ctx);
+    if (shard >= 0 && b->ring == ctx->shards[shard])
+        return shard;
+
+    shard = shard < 0 ? shard_claim(ctx) : shard_claim_at(ctx, shard);
+    if (shard < 0)
+        return -1;
+    if (b->ring)
+        shard_release(ctx, b->ring);   /* moving to another shard */
+
+    b->ctx = ctx;
+    b->epoch = ctx->shard_epoch;
+    b->live = ctx->shard_live;
+    b->ring = ctx->shards[shard];
+    b->releases = 0;
+    return shard;
+}
+
+int btelem_shard_detach(struct btelem_ctx *ctx)
+{
+    if (!ctx || ctx->ring_mode != BTELEM_RING_SHARDED)
+        return -1;
+
+    struct btelem_shard_binding *b = &btelem_tls_shard;
+    for (int i = 0; !binding_live(b, ctx); i++) {
+        if (i == BTELEM_SHARD_BINDINGS - 1)
+            return -1;
+        b = &tls_shard_rest[i];
+    }
+    if (!b->ring)
+        return -1;
+
+    shard_release(ctx, b->ring);
+    memset(b, 0, sizeof(*b));
+    return 0;
+}
+
+struct btelem_ring *btelem_shard_bind(struct btelem_ctx *ctx)
+{
+    struct btelem_shard_binding *b = binding_front(ctx);
+    if (b->ring)
+        return b->ring;             /* bound earlier, just not the front */
+
+    /* Already failed to claim: only retry once a shard has been released */
+    uint64_t releases = btelem_atomic_load_acq(&ctx->shard_releases);
+    int shard = -1;
+    if (!b->ctx || b->releases != releases)
+        shard = shard_claim(ctx);
+    b->ctx = ctx;
+    b->epoch = ctx->shard_epoch;
+    b->live = ctx->shard_live;
+    b->releases = releases;
+    if (shard < 0) {
+        b->ring = NULL;
+        btelem_atomic_fetch_add_relaxed(&ctx->shard_unbound, 1);
+        return NULL;
+    }
+    b->ring = ctx->shards[shard];
+    return b->ring;
+}
+
+/* --------------------------------------------------------------------------
+ * Tick clock calibration
+ * ----------------------------------------------------------------------- */
+
+#define CLOCK_CALIBRATE_NS 2000000ULL   /* 2 ms busy-wait baseline */
+
+#if defined(BTELEM_HAVE_MONOTONIC)
+/* One simultaneous (ticks, ns) reading: bracket the tick read with two
+ * monotonic reads and keep the tightest of a few attempts. */
+static void clock_ref(uint64_t *ticks, uint64_t *ns)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 5; i++) {
+        uint64_t a = btelem_monotonic_ns();
+        uint64_t t = BTELEM_TIMESTAMP();
+        uint64_t b = btelem_monotonic_ns();
+        if (b - a < best) {
+            best = b - a;
+            *ticks = t;
+            *ns = a + (b - a) / 2;
+        }
+    }
+}
+#endif
+
+int btelem_clock_calibrate(struct btelem_ctx *ctx)
+{
+    if (!ctx)
+        return -1;
+#if defined(BTELEM_HAVE_MONOTONIC)
+    uint64_t t0, n0, t1, n1;
+    clock_ref(&t0, &n0);
+    do {
+        clock_ref(&t1, &n1);
+    } while (n1 - n0 < CLOCK_CALIBRATE_NS);
+
+    if (t1 <= t0)
+        return -1;
+
+    uint64_t hz = muldiv64(t1 - t0, 1000000000ULL, n1 - n0);
+#if defined(BTELEM_TIMESTAMP_TSC) && defined(__aarch64__)
+    /* The generic timer advertises its exact frequency */
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(hz));
+#endif
+    if (hz == 0)
+        return -1;
+
+    ctx->clock.tick_hz = hz;
+    ctx->clock.ref_ticks = t1;
+    ctx->clock.ref_ns = n1;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int btelem_clock_sample(const struct btelem_ctx *ctx, struct btelem_clock *out)
+{
+    if (!ctx || !out || ctx->clock.tick_hz == 0)
+        return -1;
+
+    *out = ctx->clock;
+#if defined(BTELEM_HAVE_MONOTONIC)
+    uint64_t t, n;
+    clock_ref(&t, &n);
+    if (t <= ctx->clock.ref_ticks || n <= ctx->clock.ref_ns)
+        return 0;   /* counter went backwards (migration?): keep the old fit */
+    out->tick_hz = muldiv64(t - ctx->clock.ref_ticks, 1000000000ULL,
+                            n - ctx->clock.ref_ns);
+    out->ref_ticks = t;
+    out->ref_ns = n;
+#endif
     return 0;
 }
 
+uint64_t btelem_clock_ns(const struct btelem_clock *clk, uint64_t ts)
+{
+    if (!clk || clk->tick_hz == 0)
+        return ts;
+    if (ts >= clk->ref_ticks)
+        return clk->ref_ns + muldiv64(ts - clk->ref_ticks, 1000000000ULL, clk->tick_hz);
+    uint64_t back = muldiv64(clk->ref_ticks - ts, 1000000000ULL, clk->tick_hz);
+    return back < clk->ref_ns ? clk->ref_ns - back : 0;
+}
+
+static void clock_to_wire(const struct btelem_clock *clk,
+                          struct btelem_clock_wire *cw)
+{
+    memset(cw, 0, sizeof(*cw));
+    cw->magic = BTELEM_CLOCK_MAGIC;
+    cw->tick_hz = clk->tick_hz;
+    cw->ref_ticks = clk->ref_ticks;
+    cw->ref_ns = clk->ref_ns;
+}
+
+int btelem_clock_packet(const struct btelem_clock *clk, void *buf, size_t buf_size)
+{
+    size_t needed = sizeof(struct btelem_packet_header)
+                  + sizeof(struct btelem_clock_wire);
+    if (!clk || !buf || buf_size < needed)
+        return -1;
+
+    struct btelem_packet_header *hdr = (struct btelem_packet_header *)buf;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->flags = BTELEM_PACKET_FLAG_CLOCK;
+    hdr->payload_size = sizeof(struct btelem_clock_wire);
+    clock_to_wire(clk, (struct btelem_clock_wire *)(hdr + 1));
+    return (int)needed;
+}
+
 /* --------------------------------------------------------------------------
  * Schema registration
  * ----------------------------------------------------------------------- */
@@ -56,10 +492,398 @@ int btelem_register(struct btelem_ctx *ctx, const struct btelem_schema_entry *en
     return 0;
 }
 
+/* --------------------------------------------------------------------------
+ * Ring reads
+ *
+ * read_entry() copies the record at an absolute ring position into a
+ * struct btelem_entry, whichever layout the ring uses, so the drain paths
+ * share one loop.  It never moves the client cursor: the caller advances
+ * to *next once it has decided to consume the entry.
+ * ----------------------------------------------------------------------- */
+
+#define READ_PENDING 0  /* not committed yet — stop here */
+#define READ_OK      1  /* consistent copy in *out */
+#define READ_TORN    2  /* overwritten while copying — skip */
+
+static struct btelem_var_header *var_header(struct btelem_ring *r, uint64_t pos)
+{
+    return (struct btelem_var_header *)((uint8_t *)r->entries
+           + (size_t)(pos & r->mask) * BTELEM_VAR_UNIT);
+}
+
+/* A committed header at `pos` that describes a well-formed record */
+static int var_header_valid(struct btelem_ring *r, uint64_t pos, uint64_t head)
+{
+    struct btelem_var_header *h = var_header(r, pos);
+    if (btelem_atomic_load_acq((btelem_atomic_u64 *)&h->seq) != pos + 1)
+        return 0;
+    return h->payload_size <= BTELEM_MAX_PAYLOAD
+        && h->units >= BTELEM_VAR_UNITS(h->payload_size)
+        && h->units <= BTELEM_VAR_MAX_UNITS
+        && h->id < BTELEM_MAX_SCHEMA_ENTRIES
+        && pos + h->units <= head;
+}
+
+/*
+ * Find the first record boundary in [from, head).  Record starts are only
+ * known by walking from a previous boundary, so after an overwrite the
+ * reader scans for a unit whose seq matches its own absolute index.  Stale
+ * headers from earlier laps carry an older index and never match.
+ * Returns head if no committed record is found.
+ */
+static uint64_t var_resync(struct btelem_ring *r, uint64_t from, uint64_t head)
+{
+    for (uint64_t pos = from; pos < head; pos++) {
+        if (var_header_valid(r, pos, head))
+            return pos;
+    }
+    return head;
+}
+
+static int read_fixed(struct btelem_ring *r, uint64_t pos,
+                      struct btelem_entry *out, uint64_t *next)
+{
+    struct btelem_entry *e = &r->entries[pos & r->mask];
+
+    /* Check that this slot has been committed (seq == pos + 1) */
+    uint64_t seq = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
+    if (seq != pos + 1)
+        return READ_PENDING;
+
+    /* Copy to stack to avoid torn reads if producer overwrites mid-read */
+    memcpy(out, e, sizeof(*out));
+
+    /* Re-check seq — if it changed, the entry was overwritten during copy */
+    uint64_t seq2 = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
+    if (seq2 != seq)
+        return READ_TORN;
+
+    *next = pos + 1;
+    return READ_OK;
+}
+
+static int read_var(struct btelem_ring *r, uint64_t pos,
+                    struct btelem_entry *out, uint64_t *next)
+{
+    struct btelem_var_header *h = var_header(r, pos);
+
+    uint64_t seq = btelem_atomic_load_acq((btelem_atomic_u64 *)&h->seq);
+    if (seq != pos + 1)
+        return READ_PENDING;
+
+    out->seq = seq;
+    out->timestamp = h->timestamp;
+    out->id = h->id;
+    out->payload_size = h->payload_size;
+    uint16_t units = h->units;
+
+    /* Values may be torn until validated below; clamp before copying */
+    uint16_t len = out->payload_size <= BTELEM_MAX_PAYLOAD
+                 ? out->payload_size : BTELEM_MAX_PAYLOAD;
+    const uint8_t *base = (const uint8_t *)r->entries;
+    size_t ring_bytes = (size_t)r->capacity * BTELEM_VAR_UNIT;
+    size_t off = (size_t)(pos & r->mask) * BTELEM_VAR_UNIT + sizeof(*h);
+    size_t first = ring_bytes - off;
+    if (first > len)
+        first = len;
+    memcpy(out->payload, base + off, first);
+    if (first < len)
+        memcpy(out->payload + first, base, len - first);
+
+    /*
+     * A later record can overwrite the tail of this one without touching
+     * its header, so the seq re-check alone is not enough.  Units are
+     * reserved (head bumped) before they are written, so if head has not
+     * moved a full ring past `pos` nothing aliasing this record was written.
+     */
+    btelem_atomic_fence_acq();
+    uint64_t seq2 = btelem_atomic_load_acq((btelem_atomic_u64 *)&h->seq);
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    if (seq2 != seq || head > pos + r->capacity)
+        return READ_TORN;
+
+    /* Batched records may reserve more units than their payload needs */
+    if (units < BTELEM_VAR_UNITS(out->payload_size) || units > BTELEM_VAR_MAX_UNITS
+        || out->payload_size > BTELEM_MAX_PAYLOAD
+        || out->id >= BTELEM_MAX_SCHEMA_ENTRIES)
+        return READ_TORN;
+
+    *next = pos + units;
+    return READ_OK;
+}
+
+/*
+ * Per-drain snapshot.  Non-sharded rings use head[0] only.  For sharded
+ * rings, peek_ts caches the timestamp of each shard's next entry so the
+ * k-way merge touches one entry per consumed record, not one per shard.
+ */
+struct read_state {
+    uint64_t head[BTELEM_MAX_SHARDS];
+    uint64_t peek_ts[BTELEM_MAX_SHARDS];
+    uint64_t peeked;                    /* bit s set: peek_ts[s] is current */
+};
+
+/* Where an entry returned by client_read() came from */
+struct read_pos {
+    int      shard;                     /* -1 for non-sharded rings */
+    uint64_t next;                      /* cursor value once consumed */
+};
+
+static void read_state_init(struct btelem_ctx *ctx, struct read_state *st)
+{
+    st->peeked = 0;
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        for (uint16_t s = 0; s < ctx->shard_count; s++)
+            st->head[s] = btelem_atomic_load_acq(&ctx->shards[s]->head);
+    } else {
+        st->head[0] = btelem_atomic_load_acq(&ctx->ring->head);
+    }
+}
+
+/* Detect overwrite: if the cursor fell behind the oldest valid entry, skip forward */
+static void client_catch_up(struct btelem_ctx *ctx, struct btelem_client *c,
+                            const struct read_state *st)
+{
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            uint32_t cap = ctx->shards[s]->capacity;
+            if (st->head[s] <= cap)
+                continue;
+            uint64_t oldest = st->head[s] - cap;
+            if (c->shard_cursor[s] < oldest) {
+                uint64_t lost = oldest - c->shard_cursor[s];
+                c->shard_dropped[s] += lost;
+                c->dropped += lost;
+                c->shard_cursor[s] = oldest;
+            }
+        }
+        return;
+    }
+
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = st->head[0];
+    if (head <= r->capacity)
+        return;
+
+    uint64_t oldest = head - r->capacity;
+    if (c->cursor >= oldest)
+        return;
+
+    /* Entries up to the spill's high mark are still readable from it */
+    if (c->spill && c->cursor < btelem_atomic_load_acq(&c->spill->hi))
+        return;
+
+    uint64_t pos = (ctx->ring_mode == BTELEM_RING_VAR)
+                 ? var_resync(r, oldest, head)
+                 : oldest;
+    c->dropped += pos - c->cursor;
+    c->cursor = pos;
+}
+
+/* Skip the record at the cursor after a torn read */
+static void client_skip_torn(struct btelem_ctx *ctx, struct btelem_client *c)
+{
+    c->torn++;
+    if (ctx->ring_mode != BTELEM_RING_VAR) {
+        c->dropped++;
+        c->cursor++;
+        return;
+    }
+
+    /* The record's length is untrustworthy; find the next boundary */
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    uint64_t from = c->cursor + 1;
+    if (head > r->capacity && from < head - r->capacity)
+        from = head - r->capacity;
+    uint64_t pos = var_resync(r, from, head);
+    c->dropped += pos - c->cursor;
+    c->cursor = pos;
+}
+
+/* Pick the shard whose next entry is oldest and read it */
+static int client_read_sharded(struct btelem_ctx *ctx, struct btelem_client *c,
+                               struct read_state *st, struct btelem_entry *out,
+                               struct read_pos *rp)
+{
+    for (;;) {
+        int best = -1;
+        uint64_t best_ts = 0;
+
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            uint64_t cur = c->shard_cursor[s];
+            if (cur >= st->head[s])
+                continue;
+            if (!(st->peeked & ((uint64_t)1 << s))) {
+                /* Unvalidated peek: a torn value only affects merge order,
+                 * and the full read below rejects a torn entry */
+                struct btelem_ring *r = ctx->shards[s];
+                st->peek_ts[s] = r->entries[cur & r->mask].timestamp;
+                st->peeked |= (uint64_t)1 << s;
+            }
+            if (best < 0 || st->peek_ts[s] < best_ts) {
+                best = s;
+                best_ts = st->peek_ts[s];
+            }
+        }
+
+        if (best < 0)
+            return READ_PENDING;
+
+        /* head is published after commit, so a mismatched seq here means
+         * the producer lapped us: count it and move on */
+        st->peeked &= ~((uint64_t)1 << best);
+        if (read_fixed(ctx->shards[best], c->shard_cursor[best], out,
+                       &rp->next) == READ_OK) {
+            rp->shard = best;
+            return READ_OK;
+        }
+        c->shard_cursor[best]++;
+        c->shard_dropped[best]++;
+        c->dropped++;
+        c->torn++;
+    }
+}
+
+/*
+ * Read the next entry for a client without consuming it.  Torn entries are
+ * skipped (and counted) internally.  Returns READ_OK or READ_PENDING.
+ */
+static int client_read(struct btelem_ctx *ctx, struct btelem_client *c,
+                       struct read_state *st, struct btelem_entry *out,
+                       struct read_pos *rp)
+{
+    if (ctx->ring_mode == BTELEM_RING_SHARDED)
+        return client_read_sharded(ctx, c, st, out, rp);
+
+    if (c->spill) {
+        if (c->cursor < btelem_atomic_load_acq(&c->spill->hi)) {
+            memcpy(out, &c->spill->entries[c->cursor & c->spill->mask], sizeof(*out));
+            rp->shard = -1;
+            rp->next = c->cursor + 1;
+            return READ_OK;
+        }
+        /* Past the spill: skip whatever the ring has overwritten since */
+        client_catch_up(ctx, c, st);
+    }
+
+    while (c->cursor < st->head[0]) {
+        int rs = (ctx->ring_mode == BTELEM_RING_VAR)
+               ? read_var(ctx->ring, c->cursor, out, &rp->next)
+               : read_fixed(ctx->ring, c->cursor, out, &rp->next);
+        if (rs == READ_OK) {
+            rp->shard = -1;
+            return READ_OK;
+        }
+        if (rs == READ_PENDING) {
+            /* Producer hasn't finished writing yet — stop here */
+            return READ_PENDING;
+        }
+        client_skip_torn(ctx, c);
+    }
+    return READ_PENDING;
+}
+
+static void client_consume(struct btelem_client *c, const struct read_pos *rp)
+{
+    if (rp->shard >= 0) {
+        c->shard_cursor[rp->shard] = rp->next;
+        return;
+    }
+    c->cursor = rp->next;
+    if (c->spill)
+        btelem_atomic_store_rel(&c->spill->lo, c->cursor);
+}
+
+/* Upper bound on entries a client could read from the snapshot */
+static uint64_t client_pending(struct btelem_ctx *ctx, const struct btelem_client *c,
+                               const struct read_state *st)
+{
+    if (ctx->ring_mode != BTELEM_RING_SHARDED) {
+        uint64_t n = st->head[0] - c->cursor;
+        uint64_t cap = ctx->ring->capacity;
+        if (c->spill)
+            cap += c->spill->mask + 1;
+        return n > cap ? cap : n;
+    }
+    uint64_t total = 0;
+    for (uint16_t s = 0; s < ctx->shard_count; s++) {
+        uint64_t n = st->head[s] - c->shard_cursor[s];
+        total += n > ctx->shards[s]->capacity ? ctx->shards[s]->capacity : n;
+    }
+    return total;
+}
+
+/* head - cursor against a head snapshot, summed over shards */
+static uint64_t client_lag(const struct btelem_ctx *ctx, const struct btelem_client *c,
+                           const uint64_t *head)
+{
+    if (ctx->ring_mode != BTELEM_RING_SHARDED)
+        return head[0] > c->cursor ? head[0] - c->cursor : 0;
+    uint64_t total = 0;
+    for (uint16_t s = 0; s < ctx->shard_count; s++) {
+        if (head[s] > c->shard_cursor[s])
+            total += head[s] - c->shard_cursor[s];
+    }
+    return total;
+}
+
+/* Health counters (drain side only, see btelem_stats()) */
+static void client_note_lag(struct btelem_ctx *ctx, struct btelem_client *c,
+                            const struct read_state *st)
+{
+    uint64_t lag = client_lag(ctx, c, st->head);
+    if (lag > c->lag_max)
+        c->lag_max = lag;
+}
+
+static void client_count(struct btelem_client *c, uint16_t id)
+{
+    c->emitted++;
+#if BTELEM_STATS_IDS
+    c->id_count[id]++;
+#else
+    (void)id;
+#endif
+}
+
+static uint64_t stats_now(void)
+{
+#if defined(BTELEM_HAVE_MONOTONIC)
+    return btelem_monotonic_ns();
+#else
+    return 0;
+#endif
+}
+
 /* --------------------------------------------------------------------------
  * Client management
  * ----------------------------------------------------------------------- */
 
+/* Shared tables: take slot i unless another process got there first */
+static int client_claim(struct btelem_ctx *ctx, int i)
+{
+    if (!ctx->client_claim)
+        return 1;
+    uint64_t bit = (uint64_t)1 << i;
+    uint64_t cur = btelem_atomic_load_acq(ctx->client_claim);
+    while (!(cur & bit)) {
+        if (btelem_atomic_cas(ctx->client_claim, &cur, cur | bit))
+            return 1;
+    }
+    return 0;
+}
+
+static void client_unclaim(struct btelem_ctx *ctx, int i)
+{
+    if (!ctx->client_claim)
+        return;
+    uint64_t bit = (uint64_t)1 << i;
+    uint64_t cur = btelem_atomic_load_acq(ctx->client_claim);
+    while (!btelem_atomic_cas(ctx->client_claim, &cur, cur & ~bit))
+        ;
+}
+
 int btelem_client_open(struct btelem_ctx *ctx,
                        const uint16_t *filter_ids, int filter_count)
 {
@@ -67,8 +891,13 @@ int btelem_client_open(struct btelem_ctx *ctx,
         return -1;
 
     for (int i = 0; i < BTELEM_MAX_CLIENTS; i++) {
-        if (!ctx->clients[i].active) {
+        if (!ctx->clients[i].active && client_claim(ctx, i)) {
             ctx->clients[i].cursor  = btelem_atomic_load_acq(&ctx->ring->head);
+            for (uint16_t s = 0; s < ctx->shard_count; s++) {
+                ctx->clients[i].shard_cursor[s] =
+                    btelem_atomic_load_acq(&ctx->shards[s]->head);
+                ctx->clients[i].shard_dropped[s] = 0;
+            }
             memset(ctx->clients[i].filter, 0, sizeof(ctx->clients[i].filter));
             ctx->clients[i].filter_active = (filter_ids && filter_count > 0);
             for (int f = 0; f < filter_count; f++) {
@@ -77,6 +906,16 @@ int btelem_client_open(struct btelem_ctx *ctx,
             }
             ctx->clients[i].dropped = 0;
             ctx->clients[i].dropped_reported = 0;
+            ctx->clients[i].spill = NULL;
+            ctx->clients[i].owner = ctx->client_owner;
+            ctx->clients[i].torn = 0;
+            ctx->clients[i].lag_max = 0;
+            ctx->clients[i].emitted = 0;
+            ctx->clients[i].packets = 0;
+            ctx->clients[i].drain_ns = 0;
+#if BTELEM_STATS_IDS
+            memset(ctx->clients[i].id_count, 0, sizeof(ctx->clients[i].id_count));
+#endif
             ctx->clients[i].active  = 1;
             return i;
         }
@@ -84,11 +923,25 @@ int btelem_client_open(struct btelem_ctx *ctx,
     return -1;  /* no free slots */
 }
 
+int btelem_client_open_at(struct btelem_ctx *ctx, int from,
+                          const uint16_t *filter_ids, int filter_count)
+{
+    if (from != BTELEM_FROM_HEAD && from != BTELEM_FROM_OLDEST)
+        return -1;
+    int id = btelem_client_open(ctx, filter_ids, filter_count);
+    if (id >= 0 && from == BTELEM_FROM_OLDEST)
+        btelem_client_rewind(ctx, id);
+    return id;
+}
+
 void btelem_client_close(struct btelem_ctx *ctx, int client_id)
 {
     if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
         return;
+    if (!ctx->clients[client_id].active)
+        return;
     ctx->clients[client_id].active = 0;
+    client_unclaim(ctx, client_id);
 }
 
 void btelem_client_set_filter(struct btelem_ctx *ctx, int client_id,
@@ -105,6 +958,35 @@ void btelem_client_set_filter(struct btelem_ctx *ctx, int client_id,
     }
 }
 
+int btelem_client_rewind(struct btelem_ctx *ctx, int client_id)
+{
+    if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS
+        || !ctx->clients[client_id].active)
+        return -1;
+
+    struct btelem_client *c = &ctx->clients[client_id];
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            struct btelem_ring *r = ctx->shards[s];
+            uint64_t h = btelem_atomic_load_acq(&r->head);
+            c->shard_cursor[s] = h > r->capacity ? h - r->capacity : 0;
+        }
+        return 0;
+    }
+
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    uint64_t oldest = head > r->capacity ? head - r->capacity : 0;
+    c->cursor = (ctx->ring_mode == BTELEM_RING_VAR && oldest)
+              ? var_resync(r, oldest, head)
+              : oldest;
+    if (c->spill) {
+        btelem_atomic_store_rel(&c->spill->lo, c->cursor);
+        btelem_atomic_store_rel(&c->spill->hi, c->cursor);
+    }
+    return 0;
+}
+
 uint64_t btelem_client_available(struct btelem_ctx *ctx, int client_id, uint64_t *dropped)
 {
     if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
@@ -114,18 +996,59 @@ uint64_t btelem_client_available(struct btelem_ctx *ctx, int client_id, uint64_t
     uint64_t head = btelem_atomic_load_acq(&ctx->ring->head);
     uint64_t avail = 0;
 
+    if (dropped)
+        *dropped = 0;
+
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            struct btelem_ring *r = ctx->shards[s];
+            uint64_t h = btelem_atomic_load_acq(&r->head);
+            uint64_t cur = c->shard_cursor[s];
+            if (h <= cur)
+                continue;
+            uint64_t oldest = h > r->capacity ? h - r->capacity : 0;
+            if (cur < oldest) {
+                if (dropped)
+                    *dropped += oldest - cur;
+                cur = oldest;
+            }
+            avail += h - cur;
+        }
+        return avail;
+    }
+
+    if (ctx->ring_mode == BTELEM_RING_VAR) {
+        struct btelem_ring *r = ctx->ring;
+        uint64_t pos = c->cursor;
+        if (head > r->capacity && pos < head - r->capacity) {
+            pos = var_resync(r, head - r->capacity, head);
+            if (dropped)
+                *dropped = pos - c->cursor;
+        }
+        /* Walk committed records up to the first uncommitted one */
+        while (pos < head && var_header_valid(r, pos, head)) {
+            pos += var_header(r, pos)->units;
+            avail++;
+        }
+        return avail;
+    }
+
     if (head > c->cursor) {
-        /* Check if entries were overwritten */
+        /* Check if entries were overwritten (spilled ones survive) */
         uint64_t oldest = (head > ctx->ring->capacity)
                         ? head - ctx->ring->capacity
                         : 0;
-        if (c->cursor < oldest) {
+        uint64_t kept = c->cursor;
+        if (c->spill) {
+            uint64_t hi = btelem_atomic_load_acq(&c->spill->hi);
+            if (hi > kept)
+                kept = hi;
+        }
+        if (kept < oldest) {
             if (dropped)
-                *dropped = oldest - c->cursor;
-            avail = head - oldest;
+                *dropped = oldest - kept;
+            avail = head - c->cursor - (oldest - kept);
         } else {
-            if (dropped)
-                *dropped = 0;
             avail = head - c->cursor;
         }
     }
@@ -133,6 +1056,151 @@ uint64_t btelem_client_available(struct btelem_ctx *ctx, int client_id, uint64_t
     return avail;
 }
 
+uint64_t btelem_client_pending(struct btelem_ctx *ctx, int client_id)
+{
+    if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
+        return 0;
+
+    const struct btelem_client *c = &ctx->clients[client_id];
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        uint64_t pending = 0;
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            uint64_t h = btelem_atomic_load_acq(&ctx->shards[s]->head);
+            if (h > c->shard_cursor[s])
+                pending += h - c->shard_cursor[s];
+        }
+        return pending;
+    }
+
+    uint64_t head = btelem_atomic_load_acq(&ctx->ring->head);
+    return head > c->cursor ? head - c->cursor : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Snapshot triggers
+ * ----------------------------------------------------------------------- */
+
+/* ns -> entry timestamp units */
+static uint64_t trigger_span(const struct btelem_ctx *ctx, uint64_t ns)
+{
+    if (ctx->clock.tick_hz == 0)
+        return ns;
+    return muldiv64(ns, ctx->clock.tick_hz, 1000000000ULL);
+}
+
+void btelem_trigger(struct btelem_ctx *ctx, uint64_t pre_ns, uint64_t post_ns)
+{
+    if (!ctx)
+        return;
+    uint64_t now = BTELEM_TIMESTAMP();
+    uint64_t pre = trigger_span(ctx, pre_ns);
+    uint64_t post = trigger_span(ctx, post_ns);
+
+    /* Writers take the seqlock by making it odd */
+    uint64_t seq = btelem_atomic_load_relaxed(&ctx->trigger_seq);
+    for (;;) {
+        if ((seq & 1) == 0 && btelem_atomic_cas(&ctx->trigger_seq, &seq, seq + 1))
+            break;
+        seq = btelem_atomic_load_relaxed(&ctx->trigger_seq);
+    }
+    btelem_atomic_fence_rel();
+    ctx->trigger_from = now > pre ? now - pre : 0;
+    ctx->trigger_to = now + post < now ? UINT64_MAX : now + post;
+    btelem_atomic_store_rel(&ctx->trigger_seq, seq + 2);
+}
+
+uint64_t btelem_trigger_get(const struct btelem_ctx *ctx, uint64_t *from, uint64_t *to)
+{
+    if (!ctx)
+        return 0;
+    btelem_atomic_u64 *sp = (btelem_atomic_u64 *)&ctx->trigger_seq;
+    for (;;) {
+        uint64_t seq = btelem_atomic_load_acq(sp);
+        if (seq == 0)
+            return 0;
+        if (seq & 1)
+            continue;
+        uint64_t f = ctx->trigger_from;
+        uint64_t t = ctx->trigger_to;
+        btelem_atomic_fence_acq();
+        if (btelem_atomic_load_acq(sp) != seq)
+            continue;
+        if (from)
+            *from = f;
+        if (to)
+            *to = t;
+        return seq / 2;
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Consumer wake-up
+ * ----------------------------------------------------------------------- */
+
+/* wake_gate: low bits count producers inside the callback, WAKE_CLOSED
+ * keeps new ones out while btelem_wake_set() swaps it */
+#define WAKE_CLOSED (UINT64_C(1) << 63)
+
+void btelem_wake_set(struct btelem_ctx *ctx, void (*fn)(void *user), void *user)
+{
+    if (!ctx)
+        return;
+    btelem_atomic_store_rel(&ctx->wake_at, UINT64_MAX);
+
+    /* Close the gate, then wait out callbacks already running so the
+     * caller may free whatever the old hook used once we return */
+    uint64_t g = btelem_atomic_load_relaxed(&ctx->wake_gate);
+    while (!btelem_atomic_cas(&ctx->wake_gate, &g, g | WAKE_CLOSED))
+        ;
+    while (btelem_atomic_load_acq(&ctx->wake_gate) != WAKE_CLOSED)
+        ;
+
+    ctx->wake_fn = fn;
+    ctx->wake_user = user;
+    btelem_atomic_store_rel(&ctx->wake_gate, 0);
+}
+
+int btelem_wake_arm(struct btelem_ctx *ctx, int client_id, uint32_t threshold)
+{
+    if (!ctx || !ctx->wake_fn || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS
+        || !ctx->clients[client_id].active)
+        return -1;
+    if (threshold == 0)
+        threshold = 1;
+
+    /* Shard heads are independent: wake on the first entry anywhere.
+     * Every write ends at shard position >= 1; a discarded one reports 0. */
+    uint64_t at = 1;
+    if (ctx->ring_mode != BTELEM_RING_SHARDED)
+        at = ctx->clients[client_id].cursor + threshold;
+
+    /* Publish the arm before re-reading head (pairs with the producer's
+     * head RMW); otherwise an entry logged in between would not wake us */
+    btelem_atomic_store_rel(&ctx->wake_at, at);
+    btelem_atomic_fence_seq_cst();
+
+    return btelem_client_available(ctx, client_id, NULL) >= threshold ? 1 : 0;
+}
+
+void btelem_wake_fire(struct btelem_ctx *ctx)
+{
+    if (btelem_atomic_exchange(&ctx->wake_at, UINT64_MAX) == UINT64_MAX)
+        return;
+
+    uint64_t g = btelem_atomic_load_relaxed(&ctx->wake_gate);
+    do {
+        if (g & WAKE_CLOSED)
+            return;     /* hook being replaced: this wake is moot */
+    } while (!btelem_atomic_cas(&ctx->wake_gate, &g, g + 1));
+
+    void (*fn)(void *user) = ctx->wake_fn;
+    if (fn)
+        fn(ctx->wake_user);
+    g = btelem_atomic_load_relaxed(&ctx->wake_gate);
+    while (!btelem_atomic_cas(&ctx->wake_gate, &g, g - 1))
+        ;
+}
+
 /* --------------------------------------------------------------------------
  * Drain
  * ----------------------------------------------------------------------- */
@@ -147,42 +1215,21 @@ int btelem_drain(struct btelem_ctx *ctx, int client_id,
     if (!c->active)
         return -1;
 
-    struct btelem_ring *r = ctx->ring;
-    uint64_t head = btelem_atomic_load_acq(&r->head);
+    struct read_state st;
+    read_state_init(ctx, &st);
     int emitted = 0;
 
-    /* Detect overwrite: if cursor fell behind the oldest valid entry, skip forward */
-    if (head > r->capacity) {
-        uint64_t oldest = head - r->capacity;
-        if (c->cursor < oldest) {
-            c->dropped += oldest - c->cursor;
-            c->cursor = oldest;
-        }
-    }
-
-    while (c->cursor < head) {
-        struct btelem_entry *e = &r->entries[c->cursor & r->mask];
-
-        /* Check that this slot has been committed (seq == cursor + 1) */
-        uint64_t seq = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
-        if (seq != c->cursor + 1) {
-            /* Producer hasn't finished writing yet — stop here */
-            break;
-        }
+    client_note_lag(ctx, c, &st);
+    client_catch_up(ctx, c, &st);
 
-        /* Copy to stack to avoid torn reads if producer overwrites mid-read */
+    for (;;) {
         struct btelem_entry local;
-        memcpy(&local, e, sizeof(local));
+        struct read_pos rp;
 
-        /* Re-check seq — if it changed, the entry was overwritten during copy */
-        uint64_t seq2 = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
-        if (seq2 != seq) {
-            c->dropped++;
-            c->cursor++;
-            continue;
-        }
+        if (client_read(ctx, c, &st, &local, &rp) != READ_OK)
+            break;
 
-        c->cursor++;
+        client_consume(c, &rp);
 
         /* Apply filter */
         if (c->filter_active && !c->filter[local.id])
@@ -191,6 +1238,7 @@ int btelem_drain(struct btelem_ctx *ctx, int client_id,
         if (emit(&local, user) != 0)
             break;
 
+        client_count(c, local.id);
         emitted++;
     }
 
@@ -239,7 +1287,8 @@ int btelem_schema_serialize(const struct btelem_ctx *ctx, void *buf, size_t buf_
                   + sizeof(uint16_t)
                   + (size_t)enum_count * sizeof(struct btelem_enum_wire)
                   + sizeof(uint16_t)
-                  + (size_t)bitfield_count * sizeof(struct btelem_bitfield_wire);
+                  + (size_t)bitfield_count * sizeof(struct btelem_bitfield_wire)
+                  + (ctx->clock.tick_hz ? sizeof(struct btelem_clock_wire) : 0);
 
     /* Size-query mode: buf=NULL returns required size without writing */
     if (!buf)
@@ -329,6 +1378,10 @@ int btelem_schema_serialize(const struct btelem_ctx *ctx, void *buf, size_t buf_
                 p += sizeof(struct btelem_bitfield_wire);
             }
         }
+
+        /* Optional clock record (tick timestamps only) */
+        if (ctx->clock.tick_hz)
+            clock_to_wire(&ctx->clock, (struct btelem_clock_wire *)p);
     }
 
     return (int)needed;
@@ -487,19 +1540,210 @@ int btelem_schema_stream(const struct btelem_ctx *ctx,
         }
     }
 
+    /* 5. Clock record (tick timestamps only) */
+    if (ctx->clock.tick_hz) {
+        struct btelem_clock_wire cw;
+        clock_to_wire(&ctx->clock, &cw);
+        if (emit(&cw, sizeof(cw), user) != 0)
+            return -1;
+        total += (int)sizeof(cw);
+    }
+
     return total;
 }
 
+/* --------------------------------------------------------------------------
+ * Compact schema
+ *
+ * The encoder writes through a sink that always counts and hashes but only
+ * copies when given a buffer, so sizing, hashing and serialising share one
+ * code path.
+ * ----------------------------------------------------------------------- */
+
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+#define FNV64_PRIME  0x100000001b3ULL
+
+struct compact_sink {
+    uint8_t *buf;       /* NULL: count and hash only */
+    size_t   len;
+    uint64_t hash;
+};
+
+static void sink_put(struct compact_sink *s, const void *data, size_t n)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < n; i++)
+        s->hash = (s->hash ^ p[i]) * FNV64_PRIME;
+    if (s->buf && n)
+        memcpy(s->buf + s->len, p, n);
+    s->len += n;
+}
+
+static void sink_u8(struct compact_sink *s, uint8_t v)   { sink_put(s, &v, 1); }
+static void sink_u16(struct compact_sink *s, uint16_t v) { sink_put(s, &v, 2); }
+
+/* u8 length + bytes; NULL is the empty string */
+static void sink_str(struct compact_sink *s, const char *str, size_t max)
+{
+    uint8_t n = 0;
+    while (str && n < max - 1 && str[n])
+        n++;
+    sink_u8(s, n);
+    sink_put(s, str, n);
+}
+
+/* Everything between the compact header and the clock record */
+static void encode_compact_body(const struct btelem_ctx *ctx,
+                                struct compact_sink *s)
+{
+    uint16_t enum_count = 0;
+    uint16_t bitfield_count = 0;
+
+    for (uint16_t i = 0; i < ctx->schema_count; i++) {
+        const struct btelem_schema_entry *e = ctx->schema[i];
+        if (!e) continue;
+        sink_u16(s, e->id);
+        sink_u16(s, e->payload_size);
+        sink_u16(s, e->field_count);
+        sink_str(s, e->name, BTELEM_NAME_MAX);
+        sink_str(s, e->description, BTELEM_DESC_MAX);
+
+        uint16_t fc = e->field_count < BTELEM_MAX_FIELDS
+                    ? e->field_count : BTELEM_MAX_FIELDS;
+        for (uint16_t f = 0; f < fc; f++) {
+            const struct btelem_field_def *fd = &e->fields[f];
+            sink_str(s, fd->name, BTELEM_NAME_MAX);
+            sink_u16(s, fd->offset);
+            sink_u16(s, fd->size);
+            sink_u8(s, fd->type);
+            sink_u8(s, fd->count);
+            if (fd->type == BTELEM_ENUM && fd->enum_def)
+                enum_count++;
+            if (fd->type == BTELEM_BITFIELD && fd->bitfield_def)
+                bitfield_count++;
+        }
+    }
+
+    sink_u16(s, enum_count);
+    for (uint16_t i = 0; i < ctx->schema_count; i++) {
+        const struct btelem_schema_entry *e = ctx->schema[i];
+        if (!e) continue;
+        uint16_t fc = e->field_count < BTELEM_MAX_FIELDS
+                    ? e->field_count : BTELEM_MAX_FIELDS;
+        for (uint16_t f = 0; f < fc; f++) {
+            if (e->fields[f].type != BTELEM_ENUM || !e->fields[f].enum_def)
+                continue;
+            const struct btelem_enum_def *ed = e->fields[f].enum_def;
+            uint8_t lc = ed->label_count < BTELEM_ENUM_MAX_VALUES
+                       ? ed->label_count : BTELEM_ENUM_MAX_VALUES;
+            sink_u16(s, e->id);
+            sink_u16(s, f);
+            sink_u8(s, lc);
+            for (uint8_t li = 0; li < lc; li++)
+                sink_str(s, ed->labels[li], BTELEM_ENUM_LABEL_MAX);
+        }
+    }
+
+    sink_u16(s, bitfield_count);
+    for (uint16_t i = 0; i < ctx->schema_count; i++) {
+        const struct btelem_schema_entry *e = ctx->schema[i];
+        if (!e) continue;
+        uint16_t fc = e->field_count < BTELEM_MAX_FIELDS
+                    ? e->field_count : BTELEM_MAX_FIELDS;
+        for (uint16_t f = 0; f < fc; f++) {
+            if (e->fields[f].type != BTELEM_BITFIELD || !e->fields[f].bitfield_def)
+                continue;
+            const struct btelem_bitfield_def *bd = e->fields[f].bitfield_def;
+            uint8_t bc = bd->bit_count < BTELEM_BITFIELD_MAX_BITS
+                       ? bd->bit_count : BTELEM_BITFIELD_MAX_BITS;
+            sink_u16(s, e->id);
+            sink_u16(s, f);
+            sink_u8(s, bc);
+            for (uint8_t bi = 0; bi < bc; bi++) {
+                sink_str(s, bd->bits[bi].name, BTELEM_BIT_NAME_MAX);
+                sink_u8(s, bd->bits[bi].start);
+                sink_u8(s, bd->bits[bi].width);
+            }
+        }
+    }
+}
+
+int btelem_schema_serialize_compact(const struct btelem_ctx *ctx,
+                                    void *buf, size_t buf_size)
+{
+    if (!ctx)
+        return -1;
+
+    struct btelem_schema_compact_header hdr;
+    struct compact_sink s = { .buf = NULL, .len = 0, .hash = FNV64_OFFSET };
+    encode_compact_body(ctx, &s);
+
+    size_t needed = sizeof(hdr) + s.len
+                  + (ctx->clock.tick_hz ? sizeof(struct btelem_clock_wire) : 0);
+    if (!buf)
+        return (int)needed;
+    if (buf_size < needed)
+        return -1;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BTELEM_SCHEMA_COMPACT_MAGIC;
+    hdr.version = BTELEM_SCHEMA_COMPACT_VERSION;
+    hdr.endianness = ctx->endianness;
+    for (uint16_t i = 0; i < ctx->schema_count; i++) {
+        if (ctx->schema[i]) hdr.entry_count++;
+    }
+    hdr.hash = s.hash;
+    memcpy(buf, &hdr, sizeof(hdr));
+
+    s = (struct compact_sink){ .buf = (uint8_t *)buf + sizeof(hdr),
+                               .len = 0, .hash = FNV64_OFFSET };
+    encode_compact_body(ctx, &s);
+
+    if (ctx->clock.tick_hz) {
+        struct btelem_clock_wire cw;
+        clock_to_wire(&ctx->clock, &cw);
+        memcpy(s.buf + s.len, &cw, sizeof(cw));
+    }
+    return (int)needed;
+}
+
+uint64_t btelem_schema_hash(const struct btelem_ctx *ctx)
+{
+    struct compact_sink s = { .buf = NULL, .len = 0, .hash = FNV64_OFFSET };
+    if (ctx)
+        encode_compact_body(ctx, &s);
+    return s.hash;
+}
+
+/* Packet header for an entry batch; reports drops not yet sent */
+static void fill_packet_header(struct btelem_client *c,
+                               struct btelem_packet_header *pkt,
+                               uint16_t entry_count, uint32_t payload_size)
+{
+    pkt->entry_count = entry_count;
+    pkt->flags = 0;
+    pkt->payload_size = payload_size;
+
+    uint64_t drop_delta = c->dropped - c->dropped_reported;
+    pkt->dropped = (drop_delta > UINT32_MAX) ? UINT32_MAX : (uint32_t)drop_delta;
+    c->dropped_reported += pkt->dropped;
+    pkt->_reserved = 0;
+}
+
 /* --------------------------------------------------------------------------
  * Packed batch drain
  *
  * Builds: [packet_header(16)][entry_header(16) × N][payload_buffer]
  *
+ * For sharded contexts entries are merged across shards in timestamp order
+ * (per packet; an entry published late can still precede one already sent).
+ *
  * Single-pass approach:
  *   1. Estimate max_entries as upper bound for the entry table.
  *   2. Place payload buffer after the worst-case entry table.
  *   3. Walk committed entries once, copying each to a stack local
- *      (torn-read safe), checking payload space incrementally.
+ *      (torn-read safe), checking payload space incrementally.  An
+ *      entry that doesn't fit stays unconsumed for the next call.
  *   4. memmove payload down to close the gap between actual table
  *      and payload data.
  * ----------------------------------------------------------------------- */
@@ -514,19 +1758,14 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
     if (!c->active)
         return -1;
 
-    struct btelem_ring *r = ctx->ring;
-    uint64_t head = btelem_atomic_load_acq(&r->head);
+    struct read_state st;
+    read_state_init(ctx, &st);
 
-    /* Detect overwrite */
-    if (head > r->capacity) {
-        uint64_t oldest = head - r->capacity;
-        if (c->cursor < oldest) {
-            c->dropped += oldest - c->cursor;
-            c->cursor = oldest;
-        }
-    }
+    client_note_lag(ctx, c, &st);
+    client_catch_up(ctx, c, &st);
 
-    if (c->cursor >= head)
+    uint64_t available = client_pending(ctx, c, &st);
+    if (available == 0)
         return 0;  /* nothing to drain */
 
     /* Minimum buffer: must fit at least the packet header */
@@ -536,10 +1775,9 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
     /*
      * Estimate max_entries: the most entries we could possibly emit.
      * Cap to what the buffer can physically hold in entry headers.
+     * (In BTELEM_RING_VAR mode head - cursor counts units, which is still
+     * an upper bound on entries.)
      */
-    uint64_t available = head - c->cursor;
-    if (available > r->capacity)
-        available = r->capacity;
 
     size_t space_after_hdr = buf_size - sizeof(struct btelem_packet_header);
     /* Each entry needs a header AND payload space.  Use worst-case payload
@@ -548,10 +1786,14 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
     size_t max_entries = space_after_hdr / per_entry;
     if (max_entries > available)
         max_entries = (size_t)available;
+    if (max_entries > UINT16_MAX)
+        max_entries = UINT16_MAX;  /* entry_count is 16-bit */
 
     if (max_entries == 0)
         return 0;
 
+    uint64_t t0 = stats_now();
+
     struct btelem_packet_header *pkt = (struct btelem_packet_header *)buf;
     struct btelem_entry_header *table =
         (struct btelem_entry_header *)((uint8_t *)buf + sizeof(*pkt));
@@ -565,39 +1807,28 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
     uint16_t entry_count = 0;
     uint32_t payload_offset = 0;
 
-    while (c->cursor < head) {
-        struct btelem_entry *e = &r->entries[c->cursor & r->mask];
-
-        uint64_t seq = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
-        if (seq != c->cursor + 1)
-            break;
-
-        /* Copy to stack — torn-read safe */
+    for (;;) {
         struct btelem_entry local;
-        memcpy(&local, e, sizeof(local));
-
-        /* Re-check seq — if changed, entry was overwritten during copy */
-        uint64_t seq2 = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
-        if (seq2 != seq) {
-            c->dropped++;
-            c->cursor++;
-            continue;
-        }
+        struct read_pos rp;
 
-        c->cursor++;
+        if (client_read(ctx, c, &st, &local, &rp) != READ_OK)
+            break;
 
         /* Apply filter */
-        if (c->filter_active && !c->filter[local.id])
+        if (c->filter_active && !c->filter[local.id]) {
+            client_consume(c, &rp);
             continue;
+        }
 
-        /* Check payload space incrementally */
+        /* Check payload and entry table space before consuming, so an
+         * entry that doesn't fit is left for the next packet */
         if (payload_offset + local.payload_size > payload_capacity)
-            break;  /* buffer full — emit what we have */
-
-        /* Check entry table space */
+            break;
         if (entry_count >= (uint16_t)max_entries)
             break;
 
+        client_consume(c, &rp);
+
         struct btelem_entry_header *eh = &table[entry_count];
         eh->id = local.id;
         eh->payload_size = local.payload_size;
@@ -607,6 +1838,7 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
         memcpy(payload_buf + payload_offset, local.payload, local.payload_size);
         payload_offset += local.payload_size;
         entry_count++;
+        client_count(c, local.id);
     }
 
     if (entry_count == 0)
@@ -619,17 +1851,705 @@ int btelem_drain_packed(struct btelem_ctx *ctx, int client_id,
         memmove(actual_payload_start, payload_buf, payload_offset);
     }
 
-    /* Fill packet header */
-    pkt->entry_count = entry_count;
-    pkt->flags = 0;
-    pkt->payload_size = payload_offset;
-
-    uint64_t drop_delta = c->dropped - c->dropped_reported;
-    pkt->dropped = (drop_delta > UINT32_MAX) ? UINT32_MAX : (uint32_t)drop_delta;
-    c->dropped_reported += pkt->dropped;
-    pkt->_reserved = 0;
+    fill_packet_header(c, pkt, entry_count, payload_offset);
+    c->packets++;
+    c->drain_ns += stats_now() - t0;
 
     return (int)(sizeof(*pkt)
                + (size_t)entry_count * sizeof(struct btelem_entry_header)
                + payload_offset);
 }
+
+/* --------------------------------------------------------------------------
+ * Packet compression
+ *
+ * Format in btelem_types.h.  The per-ID "previous payload" is tracked as
+ * entry index + 1, so the table is reset with one memset per packet.
+ * ----------------------------------------------------------------------- */
+
+struct z_sink {
+    uint8_t *buf;
+    size_t   len;
+    size_t   cap;
+    int      overflow;
+};
+
+static void z_put(struct z_sink *z, uint8_t b)
+{
+    if (z->len >= z->cap) {
+        z->overflow = 1;
+        return;
+    }
+    z->buf[z->len++] = b;
+}
+
+static void z_varint(struct z_sink *z, uint64_t v)
+{
+    while (v >= 0x80) {
+        z_put(z, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    z_put(z, (uint8_t)v);
+}
+
+struct z_src {
+    const uint8_t *buf;
+    size_t         len;
+    size_t         pos;
+    int            bad;
+};
+
+static uint64_t z_get_varint(struct z_src *s)
+{
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64 && s->pos < s->len; shift += 7) {
+        uint8_t b = s->buf[s->pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    s->bad = 1;
+    return 0;
+}
+
+static uint64_t zigzag(uint64_t delta)
+{
+    return (delta << 1) ^ (uint64_t)-(int64_t)(delta >> 63);
+}
+
+static uint64_t unzigzag(uint64_t v)
+{
+    return (v >> 1) ^ (uint64_t)-(int64_t)(v & 1);
+}
+
+int btelem_packet_compress(const void *pkt, size_t len,
+                           void *out, size_t out_size)
+{
+    struct btelem_packet_header h;
+    if (!pkt || !out || len < sizeof(h))
+        return -1;
+    memcpy(&h, pkt, sizeof(h));
+    if (h.flags != 0 || h.entry_count == 0)
+        return 0;
+
+    const uint8_t *src = (const uint8_t *)pkt;
+    size_t table_end = sizeof(h) + (size_t)h.entry_count * sizeof(struct btelem_entry_header);
+    if (table_end + h.payload_size > len)
+        return -1;
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(src + sizeof(h));
+    const uint8_t *payload = src + table_end;
+
+    /* Only worth sending if smaller than the input */
+    size_t limit = out_size < len ? out_size : len - 1;
+    if (limit <= sizeof(h))
+        return 0;
+    struct z_sink z = { (uint8_t *)out + sizeof(h), 0, limit - sizeof(h), 0 };
+
+    uint16_t prev[BTELEM_PACKET_DELTA_IDS];
+    memset(prev, 0, sizeof(prev));
+    uint64_t prev_ts = 0;
+
+    for (uint16_t i = 0; i < h.entry_count && !z.overflow; i++) {
+        const struct btelem_entry_header *e = &table[i];
+        size_t size = e->payload_size;
+        if ((size_t)e->payload_offset + size > h.payload_size)
+            return -1;
+
+        z_varint(&z, e->id);
+        z_varint(&z, size);
+        z_varint(&z, zigzag(e->timestamp - prev_ts));
+        prev_ts = e->timestamp;
+
+        const uint8_t *cur = payload + e->payload_offset;
+        const uint8_t *ref = NULL;
+        if (e->id < BTELEM_PACKET_DELTA_IDS) {
+            const struct btelem_entry_header *r =
+                prev[e->id] ? &table[prev[e->id] - 1] : NULL;
+            if (r && r->payload_size == size)
+                ref = payload + r->payload_offset;
+            prev[e->id] = (uint16_t)(i + 1);
+        }
+
+        /* Runs of (zeros, literals); a lone zero stays in the literal */
+        size_t k = 0;
+        while (k < size) {
+            size_t zs = k;
+            while (k < size && (cur[k] ^ (ref ? ref[k] : 0)) == 0)
+                k++;
+            size_t ls = k;
+            while (k < size && ((cur[k] ^ (ref ? ref[k] : 0)) != 0
+                                || (k + 1 < size && (cur[k + 1] ^ (ref ? ref[k + 1] : 0)) != 0)))
+                k++;
+            size_t zeros = ls - zs;
+            do {
+                size_t lits = k - ls > 15 ? 15 : k - ls;
+                z_varint(&z, (uint64_t)zeros << 4 | lits);
+                for (size_t j = ls; j < ls + lits; j++)
+                    z_put(&z, (uint8_t)(cur[j] ^ (ref ? ref[j] : 0)));
+                ls += lits;
+                zeros = 0;
+            } while (ls < k);
+        }
+    }
+    if (z.overflow)
+        return 0;
+
+    h.flags |= BTELEM_PACKET_FLAG_COMPRESSED;
+    h.payload_size = (uint32_t)z.len;
+    memcpy(out, &h, sizeof(h));
+    return (int)(sizeof(h) + z.len);
+}
+
+int btelem_packet_decompress(const void *pkt, size_t len,
+                             void *out, size_t out_size)
+{
+    struct btelem_packet_header h;
+    if (!pkt || !out || len < sizeof(h))
+        return -1;
+    memcpy(&h, pkt, sizeof(h));
+    if (!(h.flags & BTELEM_PACKET_FLAG_COMPRESSED) || sizeof(h) + h.payload_size > len)
+        return -1;
+
+    size_t table_end = sizeof(h) + (size_t)h.entry_count * sizeof(struct btelem_entry_header);
+    if (table_end > out_size)
+        return -1;
+    uint8_t *dst = (uint8_t *)out;
+    struct btelem_entry_header *table = (struct btelem_entry_header *)(dst + sizeof(h));
+    uint8_t *payload = dst + table_end;
+    size_t capacity = out_size - table_end;
+
+    struct z_src s = { (const uint8_t *)pkt + sizeof(h), h.payload_size, 0, 0 };
+    uint16_t prev[BTELEM_PACKET_DELTA_IDS];
+    memset(prev, 0, sizeof(prev));
+    uint64_t ts = 0;
+    size_t off = 0;
+
+    for (uint16_t i = 0; i < h.entry_count; i++) {
+        uint64_t id = z_get_varint(&s);
+        uint64_t size = z_get_varint(&s);
+        ts += unzigzag(z_get_varint(&s));
+        if (s.bad || id > UINT16_MAX || size > UINT16_MAX || off + size > capacity)
+            return -1;
+
+        uint8_t *cur = payload + off;
+        const uint8_t *ref = NULL;
+        if (id < BTELEM_PACKET_DELTA_IDS) {
+            const struct btelem_entry_header *r =
+                prev[id] ? &table[prev[id] - 1] : NULL;
+            if (r && r->payload_size == size)
+                ref = payload + r->payload_offset;
+            prev[id] = (uint16_t)(i + 1);
+        }
+
+        size_t k = 0;
+        while (k < size) {
+            uint64_t run = z_get_varint(&s);
+            uint64_t zeros = run >> 4, lits = run & 15;
+            if (s.bad || zeros + lits == 0 || zeros > size - k
+                || lits > size - k - zeros || lits > s.len - s.pos)
+                return -1;
+            for (uint64_t j = 0; j < zeros; j++, k++)
+                cur[k] = ref ? ref[k] : 0;
+            for (uint64_t j = 0; j < lits; j++, k++)
+                cur[k] = (uint8_t)(s.buf[s.pos++] ^ (ref ? ref[k] : 0));
+        }
+
+        table[i].id = (uint16_t)id;
+        table[i].payload_size = (uint16_t)size;
+        table[i].payload_offset = (uint32_t)off;
+        table[i].timestamp = ts;
+        off += size;
+    }
+    if (s.pos != s.len)
+        return -1;
+
+    h.flags &= (uint16_t)~BTELEM_PACKET_FLAG_COMPRESSED;
+    h.payload_size = (uint32_t)off;
+    memcpy(dst, &h, sizeof(h));
+    return (int)(table_end + off);
+}
+
+/* --------------------------------------------------------------------------
+ * Zero-copy drain
+ *
+ * BTELEM_RING_FIXED only: walk committed slots reading just the 24-byte
+ * slot header (seq re-checked around it), and point an iov at the payload
+ * in place.  Slots close to being lapped are copied through read_fixed()
+ * into the caller's buffer instead, merging adjacent copies into one span.
+ * ----------------------------------------------------------------------- */
+
+/* Slots within capacity / 2^GUARD_SHIFT of the overwrite point get copied */
+#define DRAIN_IOV_GUARD_SHIFT 2
+
+int btelem_drain_iov(struct btelem_ctx *ctx, int client_id,
+                     struct btelem_drain_iov *d, void *buf, size_t buf_size)
+{
+    if (!ctx || !d || !buf || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
+        return -1;
+
+    struct btelem_client *c = &ctx->clients[client_id];
+    if (!c->active)
+        return -1;
+
+    d->iov_count = 0;
+    d->total = 0;
+    d->client_id = client_id;
+    d->ref_count = 0;
+
+    if (ctx->ring_mode != BTELEM_RING_FIXED || c->spill) {
+        int n = btelem_drain_packed(ctx, client_id, buf, buf_size);
+        if (n > 0) {
+            d->iov[0].base = buf;
+            d->iov[0].len = (size_t)n;
+            d->iov_count = 1;
+            d->total = (size_t)n;
+        }
+        return n;
+    }
+
+    struct read_state st;
+    read_state_init(ctx, &st);
+    client_note_lag(ctx, c, &st);
+    client_catch_up(ctx, c, &st);
+
+    uint64_t available = client_pending(ctx, c, &st);
+    if (available == 0)
+        return 0;
+
+    if (buf_size < sizeof(struct btelem_packet_header))
+        return -1;
+
+    /* Worst-case table sits before the copy area, so no memmove later */
+    size_t max_entries = (buf_size - sizeof(struct btelem_packet_header))
+                       / sizeof(struct btelem_entry_header);
+    if (max_entries > BTELEM_DRAIN_IOV_MAX - 1)
+        max_entries = BTELEM_DRAIN_IOV_MAX - 1;
+    if (max_entries > available)
+        max_entries = (size_t)available;
+    if (max_entries == 0)
+        return 0;
+
+    uint64_t t0 = stats_now();
+    struct btelem_ring *r = ctx->ring;
+    struct btelem_packet_header *pkt = (struct btelem_packet_header *)buf;
+    struct btelem_entry_header *table =
+        (struct btelem_entry_header *)((uint8_t *)buf + sizeof(*pkt));
+    uint8_t *copy_buf = (uint8_t *)&table[max_entries];
+    size_t copy_capacity = buf_size - (size_t)(copy_buf - (uint8_t *)buf);
+    size_t copy_used = 0;
+
+    uint64_t guard_end = st.head[0] > r->capacity
+                       ? st.head[0] - r->capacity + (r->capacity >> DRAIN_IOV_GUARD_SHIFT)
+                       : 0;
+
+    uint16_t entry_count = 0;
+    uint32_t payload_offset = 0;
+    int iov_count = 1;  /* iov[0] is header + table, filled in last */
+    int last_is_copy = 0;
+
+    while (c->cursor < st.head[0] && entry_count < (uint16_t)max_entries) {
+        uint64_t pos = c->cursor;
+        const struct btelem_entry *e = &r->entries[pos & r->mask];
+
+        if (pos < guard_end) {
+            /* About to be lapped: take a private copy */
+            struct btelem_entry local;
+            uint64_t next;
+            int rs = read_fixed(r, pos, &local, &next);
+            if (rs == READ_PENDING)
+                break;
+            if (rs == READ_TORN) {
+                client_skip_torn(ctx, c);
+                continue;
+            }
+            if (c->filter_active && !c->filter[local.id]) {
+                c->cursor = next;
+                continue;
+            }
+            if (copy_used + local.payload_size > copy_capacity)
+                break;
+            c->cursor = next;
+
+            uint8_t *dst = copy_buf + copy_used;
+            memcpy(dst, local.payload, local.payload_size);
+            copy_used += local.payload_size;
+
+            struct btelem_entry_header *eh = &table[entry_count++];
+            eh->id = local.id;
+            eh->payload_size = local.payload_size;
+            eh->payload_offset = payload_offset;
+            eh->timestamp = local.timestamp;
+            payload_offset += local.payload_size;
+            client_count(c, local.id);
+
+            if (local.payload_size == 0)
+                continue;
+            if (last_is_copy) {
+                d->iov[iov_count - 1].len += local.payload_size;
+            } else {
+                d->iov[iov_count].base = dst;
+                d->iov[iov_count].len = local.payload_size;
+                iov_count++;
+                last_is_copy = 1;
+            }
+            continue;
+        }
+
+        /* Reference in place: validate the slot header only */
+        uint64_t seq = btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq);
+        if (seq != pos + 1)
+            break;
+        uint16_t id = e->id;
+        uint16_t size = e->payload_size;
+        uint64_t ts = e->timestamp;
+        btelem_atomic_fence_acq();
+        if (btelem_atomic_load_acq((btelem_atomic_u64 *)&e->seq) != seq
+            || size > BTELEM_MAX_PAYLOAD) {
+            client_skip_torn(ctx, c);
+            continue;
+        }
+        if (c->filter_active && !c->filter[id]) {
+            c->cursor = pos + 1;
+            continue;
+        }
+        c->cursor = pos + 1;
+
+        struct btelem_entry_header *eh = &table[entry_count++];
+        eh->id = id;
+        eh->payload_size = size;
+        eh->payload_offset = payload_offset;
+        eh->timestamp = ts;
+        payload_offset += size;
+        client_count(c, id);
+
+        if (size == 0)
+            continue;
+        d->iov[iov_count].base = e->payload;
+        d->iov[iov_count].len = size;
+        iov_count++;
+        last_is_copy = 0;
+        d->ref_pos[d->ref_count++] = pos;
+    }
+
+    if (entry_count == 0) {
+        d->ref_count = 0;
+        return 0;
+    }
+
+    fill_packet_header(c, pkt, entry_count, payload_offset);
+    c->packets++;
+    c->drain_ns += stats_now() - t0;
+
+    d->iov[0].base = buf;
+    d->iov[0].len = sizeof(*pkt) + (size_t)entry_count * sizeof(struct btelem_entry_header);
+    d->iov_count = iov_count;
+    d->total = d->iov[0].len + payload_offset;
+    return (int)d->total;
+}
+
+int btelem_drain_iov_validate(struct btelem_ctx *ctx,
+                              const struct btelem_drain_iov *d)
+{
+    if (!ctx || !d || d->client_id < 0 || d->client_id >= BTELEM_MAX_CLIENTS)
+        return -1;
+    if (d->ref_count == 0)
+        return 0;
+
+    /* Same margin btelem_drain_iov() copied under; ref_pos is ascending */
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    uint64_t guard_end = head > r->capacity
+                       ? head - r->capacity + (r->capacity >> DRAIN_IOV_GUARD_SHIFT)
+                       : 0;
+
+    int near = 0;
+    for (uint32_t i = 0; i < d->ref_count && d->ref_pos[i] < guard_end; i++)
+        near++;
+    return near;
+}
+
+int btelem_drain_iov_release(struct btelem_ctx *ctx,
+                             const struct btelem_drain_iov *d)
+{
+    if (!ctx || !d || d->client_id < 0 || d->client_id >= BTELEM_MAX_CLIENTS)
+        return -1;
+    if (d->ref_count == 0)
+        return 0;
+
+    /* Slot p is reused once a producer claims p + capacity */
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    if (head <= r->capacity)
+        return 0;
+    uint64_t limit = head - r->capacity;
+
+    int torn = 0;
+    for (uint32_t i = 0; i < d->ref_count && d->ref_pos[i] < limit; i++)
+        torn++;
+
+    ctx->clients[d->client_id].dropped += (uint64_t)torn;
+    ctx->clients[d->client_id].torn += (uint64_t)torn;
+    return torn;
+}
+
+int btelem_drain_iov_settle(struct btelem_ctx *ctx, struct btelem_drain_iov *d,
+                            size_t sent, void *buf, size_t buf_size)
+{
+    if (!ctx || !d || !buf || d->client_id < 0 || d->client_id >= BTELEM_MAX_CLIENTS
+        || sent > d->total || d->total - sent > buf_size)
+        return -1;
+
+    /* Referenced spans point into the slots, in ref_pos order */
+    struct btelem_ring *r = ctx->ring;
+    uintptr_t slots = (uintptr_t)r->entries;
+    uintptr_t slots_end = slots + (uintptr_t)r->capacity * sizeof(struct btelem_entry);
+    uint8_t *out = (uint8_t *)buf;
+    size_t off = 0;
+    uint32_t ref = 0;
+    uint32_t first_unsent = d->ref_count;
+    for (int i = 0; i < d->iov_count; i++) {
+        const uint8_t *base = (const uint8_t *)d->iov[i].base;
+        size_t len = d->iov[i].len;
+        int is_ref = (uintptr_t)base >= slots && (uintptr_t)base < slots_end;
+        if (off + len > sent) {
+            size_t skip = sent > off ? sent - off : 0;
+            memcpy(out, base + skip, len - skip);
+            out += len - skip;
+            if (is_ref && first_unsent == d->ref_count)
+                first_unsent = ref;
+        }
+        ref += (uint32_t)is_ref;
+        off += len;
+    }
+
+    /* A slot reused before its copy above may have given newer bytes */
+    int torn = 0;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    if (head > r->capacity) {
+        uint64_t limit = head - r->capacity;
+        for (uint32_t i = first_unsent; i < d->ref_count && d->ref_pos[i] < limit; i++)
+            torn++;
+    }
+    ctx->clients[d->client_id].dropped += (uint64_t)torn;
+    ctx->clients[d->client_id].torn += (uint64_t)torn;
+
+    d->iov[0].base = buf;
+    d->iov[0].len = d->total - sent;
+    d->iov_count = 1;
+    d->total -= sent;
+    d->ref_count = 0;
+    return torn;
+}
+
+/* --------------------------------------------------------------------------
+ * Lossless clients (spill)
+ *
+ * The spill holds copies of ring positions [lo, hi) at index pos & mask.
+ * Only the pump writes hi and the slots; only the drain writes lo, after it
+ * has read a slot.  When the drain reads past hi straight from the ring the
+ * pump restarts at lo.  Slots the pump writes are always >= lo, and below
+ * lo + capacity, so they never alias one the drain may still read.
+ * ----------------------------------------------------------------------- */
+
+int btelem_spill_init(struct btelem_spill *sp, void *buf, uint64_t entry_count)
+{
+    if (!sp || !buf || entry_count == 0 || (entry_count & (entry_count - 1)))
+        return -1;
+    memset(sp, 0, sizeof(*sp));
+    sp->entries = (struct btelem_entry *)buf;
+    sp->mask = entry_count - 1;
+    return 0;
+}
+
+int btelem_client_set_spill(struct btelem_ctx *ctx, int client_id,
+                            struct btelem_spill *sp)
+{
+    if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS
+        || !ctx->clients[client_id].active || ctx->ring_mode != BTELEM_RING_FIXED)
+        return -1;
+    if (ctx->client_claim && sp)
+        return -1;  /* the spill pointer would be meaningless to other processes */
+
+    struct btelem_client *c = &ctx->clients[client_id];
+    if (sp) {
+        btelem_atomic_store_rel(&sp->lo, c->cursor);
+        btelem_atomic_store_rel(&sp->hi, c->cursor);
+    }
+    c->spill = sp;
+    return 0;
+}
+
+int btelem_spill_pump(struct btelem_ctx *ctx, int client_id)
+{
+    if (!ctx || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
+        return -1;
+    struct btelem_client *c = &ctx->clients[client_id];
+    struct btelem_spill *sp = c->spill;
+    if (!c->active || !sp)
+        return -1;
+
+    struct btelem_ring *r = ctx->ring;
+    uint64_t head = btelem_atomic_load_acq(&r->head);
+    uint64_t lo = btelem_atomic_load_acq(&sp->lo);
+    uint64_t pos = btelem_atomic_load_acq(&sp->hi);
+    if (pos < lo)
+        pos = lo;
+
+    /* Leave the newer half of the ring to the drain; copy only what the
+     * producers could reach before the next pump */
+    uint64_t keep = r->capacity / 2;
+    int n = 0;
+    while (pos + keep < head && pos - lo <= sp->mask) {
+        uint64_t next;
+        /* Not committed or already lapped: the drain will catch up */
+        if (read_fixed(r, pos, &sp->entries[pos & sp->mask], &next) != READ_OK)
+            break;
+        pos = next;
+        btelem_atomic_store_rel(&sp->hi, pos);
+        n++;
+    }
+    btelem_atomic_store_rel(&sp->hi, pos);
+
+    if (n)
+        btelem_atomic_store_rel(&sp->spilled,
+                                btelem_atomic_load_acq(&sp->spilled) + (uint64_t)n);
+    if (pos - lo > btelem_atomic_load_acq(&sp->peak))
+        btelem_atomic_store_rel(&sp->peak, pos - lo);
+    return n;
+}
+
+/* --------------------------------------------------------------------------
+ * Health metrics
+ * ----------------------------------------------------------------------- */
+
+int btelem_stats(struct btelem_ctx *ctx, struct btelem_stats *st)
+{
+    if (!ctx || !st || !ctx->ring)
+        return -1;
+
+    uint64_t heads[BTELEM_MAX_SHARDS];
+    uint64_t head = 0, capacity = 0;
+    if (ctx->ring_mode == BTELEM_RING_SHARDED) {
+        for (uint16_t s = 0; s < ctx->shard_count; s++) {
+            heads[s] = btelem_atomic_load_acq(&ctx->shards[s]->head);
+            head += heads[s];
+            capacity += ctx->shards[s]->capacity;
+        }
+    } else {
+        heads[0] = head = btelem_atomic_load_acq(&ctx->ring->head);
+        capacity = ctx->ring->capacity;
+    }
+
+    uint64_t now = stats_now();
+    st->head_rate = (st->t_ns && now > st->t_ns && head >= st->head)
+                  ? muldiv64(head - st->head, 1000000000ULL, now - st->t_ns)
+                  : 0;
+    st->t_ns = now;
+    st->head = head;
+    st->capacity = capacity;
+    st->unbound = btelem_atomic_load_relaxed(&ctx->shard_unbound);
+
+    for (int i = 0; i < BTELEM_MAX_CLIENTS; i++) {
+        const struct btelem_client *c = &ctx->clients[i];
+        struct btelem_client_stats *cs = &st->clients[i];
+        cs->active   = c->active;
+        cs->lag      = c->active ? client_lag(ctx, c, heads) : 0;
+        cs->lag_max  = c->lag_max;
+        cs->dropped  = c->dropped;
+        cs->torn     = c->torn;
+        cs->emitted  = c->emitted;
+        cs->packets  = c->packets;
+        cs->drain_ns = c->drain_ns;
+    }
+    return 0;
+}
+
+int btelem_stats_id_counts(struct btelem_ctx *ctx, int client_id,
+                           uint32_t *counts, int max)
+{
+    if (!ctx || !counts || max < 0 || client_id < 0 || client_id >= BTELEM_MAX_CLIENTS)
+        return -1;
+#if BTELEM_STATS_IDS
+    if (max > BTELEM_MAX_SCHEMA_ENTRIES)
+        max = BTELEM_MAX_SCHEMA_ENTRIES;
+    memcpy(counts, ctx->clients[client_id].id_count, (size_t)max * sizeof(*counts));
+    return max;
+#else
+    return -1;
+#endif
+}
+
+static const struct btelem_field_def stats_fields[] = {
+    BTELEM_FIELD(struct btelem_stats_entry, head, BTELEM_U64),
+    BTELEM_FIELD(struct btelem_stats_entry, head_rate, BTELEM_U64),
+    BTELEM_ARRAY_FIELD(struct btelem_stats_entry, dropped, BTELEM_U64, BTELEM_STATS_CLIENTS),
+    BTELEM_ARRAY_FIELD(struct btelem_stats_entry, lag, BTELEM_U32, BTELEM_STATS_CLIENTS),
+    BTELEM_ARRAY_FIELD(struct btelem_stats_entry, lag_max, BTELEM_U32, BTELEM_STATS_CLIENTS),
+    BTELEM_ARRAY_FIELD(struct btelem_stats_entry, torn, BTELEM_U32, BTELEM_STATS_CLIENTS),
+    BTELEM_ARRAY_FIELD(struct btelem_stats_entry, drain_ns, BTELEM_U32, BTELEM_STATS_CLIENTS),
+    BTELEM_FIELD(struct btelem_stats_entry, active, BTELEM_U32),
+};
+BTELEM_SCHEMA_ENTRY(BTELEM_STATS, BTELEM_STATS_ID, "btelem_stats",
+                    "btelem ring and client health", struct btelem_stats_entry,
+                    stats_fields);
+
+int btelem_stats_register(struct btelem_ctx *ctx)
+{
+    if (!ctx)
+        return -1;
+    const struct btelem_schema_entry *cur = ctx->schema[BTELEM_STATS_ID];
+    if (cur && cur != &btelem_schema_BTELEM_STATS)
+        return -1;
+    if (ctx->ring_mode == BTELEM_RING_SHARDED && !ctx->stats_shard) {
+        int shard = shard_claim(ctx);
+        if (shard < 0)
+            return -1;
+        ctx->stats_shard = ctx->shards[shard];
+    }
+    return btelem_register(ctx, &btelem_schema_BTELEM_STATS);
+}
+
+static uint32_t clamp_u32(uint64_t v)
+{
+    return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+int btelem_stats_publish(struct btelem_ctx *ctx, struct btelem_stats *prev)
+{
+    if (!ctx || !prev || ctx->schema[BTELEM_STATS_ID] != &btelem_schema_BTELEM_STATS)
+        return -1;
+
+    uint64_t packets[BTELEM_STATS_CLIENTS], drain_ns[BTELEM_STATS_CLIENTS];
+    for (int i = 0; i < BTELEM_STATS_CLIENTS; i++) {
+        packets[i] = prev->clients[i].packets;
+        drain_ns[i] = prev->clients[i].drain_ns;
+    }
+    if (btelem_stats(ctx, prev) != 0)
+        return -1;
+
+    struct btelem_stats_entry e;
+    memset(&e, 0, sizeof(e));
+    e.head = prev->head;
+    e.head_rate = prev->head_rate;
+    for (int i = 0; i < BTELEM_STATS_CLIENTS; i++) {
+        const struct btelem_client_stats *cs = &prev->clients[i];
+        if (!cs->active)
+            continue;
+        e.active |= 1u << i;
+        e.dropped[i] = cs->dropped;
+        e.lag[i] = clamp_u32(cs->lag);
+        e.lag_max[i] = clamp_u32(cs->lag_max);
+        e.torn[i] = clamp_u32(cs->torn);
+        /* A reopened slot restarts its counters */
+        if (cs->packets > packets[i] && cs->drain_ns >= drain_ns[i])
+            e.drain_ns[i] = clamp_u32((cs->drain_ns - drain_ns[i])
+                                      / (cs->packets - packets[i]));
+    }
+    if (ctx->stats_shard)
+        btelem_wake_check(ctx, btelem_shard_write(ctx->stats_shard, BTELEM_STATS_ID,
+                                                  &e, (uint16_t)sizeof(e)));
+    else
+        BTELEM_LOG_ID(ctx, BTELEM_STATS_ID, e);
+    return 0;
+}
@@ -0,0 +1,849 @@
+#include "btelem/btelem_record.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* .btlm file header, as python/btelem/storage.py (VERSION 1) */
+#define RECORD_MAGIC        "BTLM"
+#define RECORD_VERSION      1
+#define RECORD_HDR_SIZE     10      /* magic(4) + version(2) + schema_len(4) */
+#define RECORD_ALIGN        4096
+
+/* --------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------- */
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += (size_t)n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Growable index: an entry per packet plus its ID summary records */
+struct record_index {
+    struct btelem_index_entry *v;
+    uint32_t                  *first_id;    /* per packet: first record in ids */
+    uint32_t                   count;
+    uint32_t                   cap;
+    struct btelem_index_id    *ids;
+    uint32_t                   id_count;
+    uint32_t                   id_cap;
+};
+
+static int index_push(struct record_index *ix, const struct btelem_index_entry *e,
+                      const struct btelem_index_id *ids, uint32_t n)
+{
+    if (ix->count == ix->cap) {
+        uint32_t cap = ix->cap ? ix->cap * 2 : 1024;
+        struct btelem_index_entry *v = (struct btelem_index_entry *)
+            realloc(ix->v, (size_t)cap * sizeof(*v));
+        if (v)
+            ix->v = v;
+        uint32_t *first = (uint32_t *)realloc(ix->first_id, (size_t)cap * sizeof(*first));
+        if (first)
+            ix->first_id = first;
+        if (!v || !first)
+            return -1;
+        ix->cap = cap;
+    }
+    if (ix->id_count + n > ix->id_cap) {
+        uint32_t cap = ix->id_cap ? ix->id_cap : 4096;
+        while (cap < ix->id_count + n)
+            cap *= 2;
+        struct btelem_index_id *v = (struct btelem_index_id *)
+            realloc(ix->ids, (size_t)cap * sizeof(*v));
+        if (!v)
+            return -1;
+        ix->ids = v;
+        ix->id_cap = cap;
+    }
+    ix->first_id[ix->count] = ix->id_count;
+    ix->v[ix->count++] = *e;
+    memcpy(ix->ids + ix->id_count, ids, (size_t)n * sizeof(*ids));
+    ix->id_count += n;
+    return 0;
+}
+
+/* Packet i's ID records */
+static const struct btelem_index_id *index_ids(const struct record_index *ix,
+                                               uint32_t i, uint32_t *n)
+{
+    uint32_t end = i + 1 < ix->count ? ix->first_id[i + 1] : ix->id_count;
+    *n = end - ix->first_id[i];
+    return ix->ids + ix->first_id[i];
+}
+
+static void index_free(struct record_index *ix)
+{
+    free(ix->v);
+    free(ix->first_id);
+    free(ix->ids);
+}
+
+/* --------------------------------------------------------------------------
+ * Write buffers
+ *
+ * Packets back to back, plus an index entry per packet whose `offset` is
+ * relative to the buffer (the writer rebases it to the file offset) and its
+ * ID summary.
+ * ----------------------------------------------------------------------- */
+
+struct btelem_record_buf {
+    uint8_t            *data;
+    size_t              len;
+    size_t              cap;
+    struct record_index pkts;
+    uint64_t            entries;
+    uint64_t            dropped;
+    int                 close_after;    /* last of a trigger window */
+};
+
+static struct btelem_record_buf *buf_new(size_t cap)
+{
+    struct btelem_record_buf *b = (struct btelem_record_buf *)calloc(1, sizeof(*b));
+    if (!b)
+        return NULL;
+    if (posix_memalign((void **)&b->data, RECORD_ALIGN, cap) != 0) {
+        free(b);
+        return NULL;
+    }
+    b->cap = cap;
+    return b;
+}
+
+static void buf_free(struct btelem_record_buf *b)
+{
+    if (!b)
+        return;
+    index_free(&b->pkts);
+    free(b->data);
+    free(b);
+}
+
+static void buf_reset(struct btelem_record_buf *b)
+{
+    b->len = 0;
+    b->pkts.count = 0;
+    b->pkts.id_count = 0;
+    b->entries = 0;
+    b->dropped = 0;
+    b->close_after = 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Output files (writer thread)
+ * ----------------------------------------------------------------------- */
+
+struct btelem_record_file {
+    int                 fd;
+    uint32_t            number;         /* rotation sequence */
+    uint64_t            size;           /* bytes written so far */
+    uint64_t            opened_ms;
+    struct record_index index;
+};
+
+/* "dir/run.btlm" -> "dir/run.<n>.btlm" when rotating */
+static int file_name(const struct btelem_recorder *rec, uint32_t n,
+                     char *out, size_t out_size)
+{
+    int rotating = rec->opts.max_file_bytes || rec->opts.max_file_secs
+                || rec->opts.trigger;
+    if (!rotating)
+        return snprintf(out, out_size, "%s", rec->path) < (int)out_size ? 0 : -1;
+
+    const char *slash = strrchr(rec->path, '/');
+    const char *dot = strrchr(rec->path, '.');
+    if (!dot || (slash && dot < slash) || dot == (slash ? slash + 1 : rec->path))
+        dot = rec->path + strlen(rec->path);
+    int rc = snprintf(out, out_size, "%.*s.%u%s",
+                      (int)(dot - rec->path), rec->path, n, dot);
+    return rc >= 0 && rc < (int)out_size ? 0 : -1;
+}
+
+static int file_open(struct btelem_recorder *rec, uint32_t n)
+{
+    struct btelem_record_file *f = rec->file;
+    char name[sizeof(rec->path) + 16];
+    if (file_name(rec, n, name, sizeof(name)) < 0)
+        return -1;
+
+    f->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (f->fd < 0) {
+        fprintf(stderr, "btelem_record: %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    f->number = n;
+    f->size = 0;
+    f->opened_ms = now_ms();
+    f->index.count = 0;
+    f->index.id_count = 0;
+
+    uint8_t hdr[RECORD_HDR_SIZE];
+    uint16_t version = RECORD_VERSION;
+    memcpy(hdr, RECORD_MAGIC, 4);
+    memcpy(hdr + 4, &version, 2);
+    memcpy(hdr + 6, &rec->schema_len, 4);
+    if (write_all(f->fd, hdr, sizeof(hdr)) < 0
+        || write_all(f->fd, rec->schema, rec->schema_len) < 0) {
+        fprintf(stderr, "btelem_record: %s: %s\n", name, strerror(errno));
+        close(f->fd);
+        f->fd = -1;
+        return -1;
+    }
+    f->size = RECORD_HDR_SIZE + rec->schema_len;
+
+    pthread_mutex_lock(&rec->lock);
+    rec->stats.files++;
+    rec->stats.bytes += f->size;
+    pthread_mutex_unlock(&rec->lock);
+    return 0;
+}
+
+/* Bytes file_close() appends for an index of `packets` and `ids` records */
+static uint64_t trailer_size(uint64_t packets, uint64_t ids)
+{
+    return (packets + 1) * sizeof(uint32_t) + ids * sizeof(struct btelem_index_id)
+         + sizeof(struct btelem_index_ids_footer)
+         + packets * sizeof(struct btelem_index_entry)
+         + sizeof(struct btelem_index_footer);
+}
+
+/* Append the ID summary, index and footers, refresh the clock record, close */
+static void file_close(struct btelem_recorder *rec)
+{
+    struct btelem_record_file *f = rec->file;
+    if (f->fd < 0)
+        return;
+
+    struct record_index *ix = &f->index;
+    struct btelem_index_ids_footer ift = {
+        .ids_offset = f->size,
+        .id_count   = ix->id_count,
+        .magic      = BTELEM_INDEX_IDS_MAGIC,
+    };
+    struct btelem_index_footer ft = {
+        .index_offset = f->size
+                      + (uint64_t)(ix->count + 1) * sizeof(uint32_t)
+                      + (uint64_t)ix->id_count * sizeof(struct btelem_index_id)
+                      + sizeof(ift),
+        .index_count  = ix->count,
+        .magic        = BTELEM_INDEX_MAGIC,
+    };
+    uint64_t trailer = trailer_size(ix->count, ix->id_count);
+    int err = write_all(f->fd, ix->first_id, (size_t)ix->count * sizeof(uint32_t)) < 0
+           || write_all(f->fd, &ix->id_count, sizeof(uint32_t)) < 0
+           || write_all(f->fd, ix->ids, (size_t)ix->id_count * sizeof(struct btelem_index_id)) < 0
+           || write_all(f->fd, &ift, sizeof(ift)) < 0
+           || write_all(f->fd, ix->v, (size_t)ix->count * sizeof(struct btelem_index_entry)) < 0
+           || write_all(f->fd, &ft, sizeof(ft)) < 0;
+
+    /* The clock record ends the schema; a fit over the whole file beats
+     * the one measured at init */
+    struct btelem_clock clk;
+    uint8_t cbuf[sizeof(struct btelem_packet_header) + sizeof(struct btelem_clock_wire)];
+    if (!err && btelem_clock_sample(rec->ctx, &clk) == 0
+        && btelem_clock_packet(&clk, cbuf, sizeof(cbuf)) > 0) {
+        off_t at = RECORD_HDR_SIZE + rec->schema_len - sizeof(struct btelem_clock_wire);
+        err = pwrite(f->fd, cbuf + sizeof(struct btelem_packet_header),
+                     sizeof(struct btelem_clock_wire), at)
+              != (ssize_t)sizeof(struct btelem_clock_wire);
+    }
+    if (close(f->fd) < 0)
+        err = 1;
+    f->fd = -1;
+
+    pthread_mutex_lock(&rec->lock);
+    if (err)
+        rec->stats.write_errors++;
+    else
+        rec->stats.bytes += trailer;
+    pthread_mutex_unlock(&rec->lock);
+}
+
+/* Would `bytes` more of packets (and their index records) push the
+ * finished file past max_file_bytes? */
+static int file_too_big(const struct btelem_recorder *rec,
+                        const struct btelem_record_file *f,
+                        uint64_t bytes, uint32_t packets, uint32_t ids)
+{
+    return rec->opts.max_file_bytes
+        && f->size + bytes + trailer_size((uint64_t)f->index.count + packets,
+                                          (uint64_t)f->index.id_count + ids)
+           > rec->opts.max_file_bytes;
+}
+
+/* Write one buffer, rotating between packets as the options ask */
+static void file_write_buf(struct btelem_recorder *rec, struct btelem_record_buf *b)
+{
+    struct btelem_record_file *f = rec->file;
+    uint64_t max_ms = (uint64_t)rec->opts.max_file_secs * 1000u;
+    uint64_t now = max_ms ? now_ms() : 0;
+    int rotating = rec->opts.max_file_bytes || max_ms || rec->opts.trigger;
+
+    uint32_t i = 0;
+    while (i < b->pkts.count) {
+        if (f->fd >= 0 && f->index.count > 0) {
+            size_t first = (size_t)b->pkts.v[i].offset;
+            size_t next = i + 1 < b->pkts.count ? (size_t)b->pkts.v[i + 1].offset : b->len;
+            uint32_t nids;
+            index_ids(&b->pkts, i, &nids);
+            if (file_too_big(rec, f, next - first, 1, nids)
+                || (max_ms && now - f->opened_ms >= max_ms))
+                file_close(rec);
+        }
+        if (f->fd < 0 && (!rotating || file_open(rec, f->number + 1) < 0)) {
+            /* Nowhere to put it; a rotating recorder tries a new file with
+             * the next buffer, a single file is not reopened (truncated) */
+            pthread_mutex_lock(&rec->lock);
+            rec->stats.write_errors++;
+            pthread_mutex_unlock(&rec->lock);
+            return;
+        }
+
+        /* Take packets up to the next rotation point in one write */
+        uint32_t start = i;
+        uint32_t start_ids = f->index.id_count;
+        size_t first = (size_t)b->pkts.v[start].offset;
+        for (; i < b->pkts.count; i++) {
+            size_t end = i + 1 < b->pkts.count ? (size_t)b->pkts.v[i + 1].offset : b->len;
+            uint32_t nids;
+            const struct btelem_index_id *ids = index_ids(&b->pkts, i, &nids);
+            if (i > start && file_too_big(rec, f, end - first, 1, nids))
+                break;
+            struct btelem_index_entry e = b->pkts.v[i];
+            e.offset = f->size + (e.offset - first);
+            if (index_push(&f->index, &e, ids, nids) < 0)
+                break;
+        }
+        if (i == start) {
+            pthread_mutex_lock(&rec->lock);
+            rec->stats.write_errors++;
+            pthread_mutex_unlock(&rec->lock);
+            return;
+        }
+        size_t last = i < b->pkts.count ? (size_t)b->pkts.v[i].offset : b->len;
+        if (write_all(f->fd, b->data + first, last - first) < 0) {
+            fprintf(stderr, "btelem_record: write failed: %s\n", strerror(errno));
+            f->index.count -= i - start;
+            f->index.id_count = start_ids;
+            file_close(rec);
+            pthread_mutex_lock(&rec->lock);
+            rec->stats.write_errors++;
+            pthread_mutex_unlock(&rec->lock);
+            return;
+        }
+        f->size += last - first;
+
+        uint64_t entries = 0;
+        for (uint32_t j = start; j < i; j++)
+            entries += b->pkts.v[j].entry_count;
+        pthread_mutex_lock(&rec->lock);
+        rec->stats.packets += i - start;
+        rec->stats.entries += entries;
+        rec->stats.bytes += last - first;
+        pthread_mutex_unlock(&rec->lock);
+    }
+}
+
+static void *record_writer_thread(void *arg)
+{
+    struct btelem_recorder *rec = (struct btelem_recorder *)arg;
+
+    pthread_mutex_lock(&rec->lock);
+    for (;;) {
+        while (!rec->full && !rec->done)
+            pthread_cond_wait(&rec->cond, &rec->lock);
+        struct btelem_record_buf *b = rec->full;
+        if (!b)
+            break;
+        pthread_mutex_unlock(&rec->lock);
+
+        file_write_buf(rec, b);
+        if (b->close_after)
+            file_close(rec);
+        buf_reset(b);
+
+        pthread_mutex_lock(&rec->lock);
+        rec->full = NULL;
+        pthread_cond_broadcast(&rec->cond);
+    }
+    pthread_mutex_unlock(&rec->lock);
+
+    file_close(rec);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Drain thread
+ * ----------------------------------------------------------------------- */
+
+/* Give b to the writer once it has finished the other buffer; returns the
+ * other buffer, now free */
+static struct btelem_record_buf *hand_off(struct btelem_recorder *rec,
+                                          struct btelem_record_buf *b)
+{
+    pthread_mutex_lock(&rec->lock);
+    if (rec->full)
+        rec->stats.stalls++;
+    while (rec->full)
+        pthread_cond_wait(&rec->cond, &rec->lock);
+    rec->stats.dropped += b->dropped;
+    rec->full = b;
+    pthread_cond_broadcast(&rec->cond);
+    pthread_mutex_unlock(&rec->lock);
+    return b == rec->bufs[0] ? rec->bufs[1] : rec->bufs[0];
+}
+
+/* Drain one packet into b; returns its size, 0 if none pending.  With a
+ * window {from, to} (timestamps), packets entirely before it are dropped,
+ * and one entirely after it is dropped and returns -1. */
+static int drain_one(struct btelem_recorder *rec, struct btelem_record_buf *b,
+                     uint8_t *scratch, const uint64_t *win)
+{
+    uint8_t *dst = b->data + b->len;
+    uint8_t *plain = rec->opts.compress ? scratch : dst;
+    int n = btelem_drain_packed(rec->ctx, rec->btelem_client_id, plain, BTELEM_RECORD_PKT);
+    if (n <= 0)
+        return 0;
+
+    const struct btelem_packet_header *ph = (const struct btelem_packet_header *)plain;
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(plain + sizeof(*ph));
+    struct btelem_index_entry e = { b->len, UINT64_MAX, 0, ph->entry_count };
+    uint16_t counts[BTELEM_MAX_SCHEMA_ENTRIES];
+    uint16_t id_lo = BTELEM_MAX_SCHEMA_ENTRIES, id_hi = 0;
+    memset(counts, 0, sizeof(counts));
+    for (uint16_t i = 0; i < ph->entry_count; i++) {
+        uint16_t id = table[i].id;
+        if (table[i].timestamp < e.ts_min) e.ts_min = table[i].timestamp;
+        if (table[i].timestamp > e.ts_max) e.ts_max = table[i].timestamp;
+        if (id >= BTELEM_MAX_SCHEMA_ENTRIES)
+            continue;
+        counts[id]++;
+        if (id < id_lo) id_lo = id;
+        if (id > id_hi) id_hi = id;
+    }
+    if (ph->entry_count == 0)
+        e.ts_min = 0;
+    else if (win && e.ts_min > win[1])
+        return -1;
+    else if (win && e.ts_max < win[0])
+        return n;
+
+    struct btelem_index_id ids[BTELEM_MAX_SCHEMA_ENTRIES];
+    uint32_t nids = 0;
+    for (uint32_t id = id_lo; id <= id_hi; id++) {
+        if (counts[id]) {
+            ids[nids].id = (uint16_t)id;
+            ids[nids].count = counts[id];
+            nids++;
+        }
+    }
+    b->entries += ph->entry_count;
+    b->dropped += ph->dropped;
+
+    if (rec->opts.compress) {
+        int zn = btelem_packet_compress(plain, (size_t)n, dst, (size_t)n);
+        if (zn > 0)
+            n = zn;
+        else
+            memcpy(dst, plain, (size_t)n);
+    }
+    if (index_push(&b->pkts, &e, ids, nids) < 0) {
+        pthread_mutex_lock(&rec->lock);
+        rec->stats.write_errors++;
+        pthread_mutex_unlock(&rec->lock);
+        return n;
+    }
+    b->len += (size_t)n;
+    return n;
+}
+
+/* Compression staging buffer, or NULL when not compressing */
+static uint8_t *record_scratch(struct btelem_recorder *rec)
+{
+    uint8_t *scratch = rec->opts.compress ? (uint8_t *)malloc(BTELEM_RECORD_PKT) : NULL;
+    if (rec->opts.compress && !scratch) {
+        fprintf(stderr, "btelem_record: out of memory, not compressing\n");
+        rec->opts.compress = 0;
+    }
+    return scratch;
+}
+
+/* Tell the writer no more buffers are coming */
+static void record_done(struct btelem_recorder *rec)
+{
+    pthread_mutex_lock(&rec->lock);
+    rec->done = 1;
+    pthread_cond_broadcast(&rec->cond);
+    pthread_mutex_unlock(&rec->lock);
+}
+
+/* Ring heads (one per shard) at the time btelem_record_stop() was seen */
+static void stop_mark(const struct btelem_ctx *ctx, uint64_t *mark)
+{
+    if (ctx->ring_mode != BTELEM_RING_SHARDED) {
+        mark[0] = btelem_atomic_load_acq(&ctx->ring->head);
+        return;
+    }
+    for (uint16_t s = 0; s < ctx->shard_count; s++)
+        mark[s] = btelem_atomic_load_acq(&ctx->shards[s]->head);
+}
+
+/* Has the client read everything logged before the stop mark? */
+static int stop_reached(const struct btelem_ctx *ctx, int client_id,
+                        const uint64_t *mark)
+{
+    const struct btelem_client *c = &ctx->clients[client_id];
+    if (ctx->ring_mode != BTELEM_RING_SHARDED)
+        return c->cursor >= mark[0];
+    for (uint16_t s = 0; s < ctx->shard_count; s++) {
+        if (c->shard_cursor[s] < mark[s])
+            return 0;
+    }
+    return 1;
+}
+
+static void *record_drain_thread(void *arg)
+{
+    struct btelem_recorder *rec = (struct btelem_recorder *)arg;
+    uint8_t *scratch = record_scratch(rec);
+
+    struct btelem_record_buf *b = rec->bufs[0];
+    uint64_t first_ms = 0;
+    int stopping = 0;
+    uint64_t mark[BTELEM_MAX_SHARDS];
+
+    for (;;) {
+        /* The final drain ends at the heads seen at stop, so producers
+         * that keep logging cannot hold btelem_record_stop() up */
+        if (!stopping && !rec->running) {
+            stopping = 1;
+            stop_mark(rec->ctx, mark);
+        }
+        if (b->cap - b->len < BTELEM_RECORD_PKT) {
+            b = hand_off(rec, b);
+            continue;
+        }
+        int n = (stopping && stop_reached(rec->ctx, rec->btelem_client_id, mark))
+              ? 0 : drain_one(rec, b, scratch, NULL);
+        if (n > 0) {
+            if (b->pkts.count == 1)
+                first_ms = now_ms();
+            continue;
+        }
+        /* Ring empty: write what we have if it has waited long enough */
+        if (b->len && (stopping || now_ms() - first_ms >= rec->opts.flush_ms))
+            b = hand_off(rec, b);
+        if (stopping)
+            break;
+        usleep(1000);
+    }
+
+    record_done(rec);
+    free(scratch);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Trigger thread (flight recording)
+ * ----------------------------------------------------------------------- */
+
+/* Write the latest trigger's window to a file of its own; returns the
+ * free buffer */
+static struct btelem_record_buf *record_window(struct btelem_recorder *rec,
+                                               struct btelem_record_buf *b,
+                                               uint8_t *scratch)
+{
+    uint64_t win[2];
+    rec->trigger_seen = btelem_trigger_get(rec->ctx, &win[0], &win[1]);
+    int id = btelem_client_open_at(rec->ctx, BTELEM_FROM_OLDEST, NULL, 0);
+    if (id < 0) {
+        fprintf(stderr, "btelem_record: no free client slot for trigger\n");
+        pthread_mutex_lock(&rec->lock);
+        rec->stats.write_errors++;
+        pthread_mutex_unlock(&rec->lock);
+        return b;
+    }
+    rec->btelem_client_id = id;
+
+    for (;;) {
+        if (b->cap - b->len < BTELEM_RECORD_PKT) {
+            b = hand_off(rec, b);
+            continue;
+        }
+        int n = drain_one(rec, b, scratch, win);
+        if (n < 0)
+            break;
+
+        /* A trigger inside the window extends it */
+        uint64_t to;
+        uint64_t seen = btelem_trigger_get(rec->ctx, NULL, &to);
+        if (seen != rec->trigger_seen) {
+            rec->trigger_seen = seen;
+            if (to > win[1])
+                win[1] = to;
+        }
+        if (n > 0)
+            continue;
+        if (!rec->running || BTELEM_TIMESTAMP() > win[1])
+            break;
+        usleep(1000);
+    }
+
+    btelem_client_close(rec->ctx, id);
+    rec->btelem_client_id = -1;
+    b->close_after = 1;
+    b = hand_off(rec, b);
+    pthread_mutex_lock(&rec->lock);
+    rec->stats.snapshots++;
+    pthread_mutex_unlock(&rec->lock);
+    return b;
+}
+
+static void *record_trigger_thread(void *arg)
+{
+    struct btelem_recorder *rec = (struct btelem_recorder *)arg;
+    uint8_t *scratch = record_scratch(rec);
+
+    struct btelem_record_buf *b = rec->bufs[0];
+    while (rec->running) {
+        if (btelem_trigger_get(rec->ctx, NULL, NULL) != rec->trigger_seen)
+            b = record_window(rec, b, scratch);
+        else
+            usleep(1000);
+    }
+
+    record_done(rec);
+    free(scratch);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Spill thread (lossless recording)
+ * ----------------------------------------------------------------------- */
+
+static int spill_map(struct btelem_recorder *rec)
+{
+    uint32_t n = rec->opts.spill_entries;
+    if (n & (n - 1))
+        return -1;
+
+    size_t len = btelem_spill_size(n);
+    void *mem;
+    if (rec->opts.spill_path) {
+        int fd = open(rec->opts.spill_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0)
+            return -1;
+        unlink(rec->opts.spill_path);
+        if (ftruncate(fd, (off_t)len) < 0) {
+            close(fd);
+            return -1;
+        }
+        mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (mem == MAP_FAILED)
+        return -1;
+
+    rec->spill_mem = mem;
+    rec->spill_len = len;
+    return btelem_spill_init(&rec->spill, mem, n);
+}
+
+/* Never takes rec->lock, so a stalled drain or writer can't hold it up */
+static void *record_spill_thread(void *arg)
+{
+    struct btelem_recorder *rec = (struct btelem_recorder *)arg;
+    while (rec->running) {
+        if (btelem_spill_pump(rec->ctx, rec->btelem_client_id) <= 0)
+            usleep(BTELEM_RECORD_SPILL_US);
+    }
+    return NULL;
+}
+
+static void spill_stats(struct btelem_recorder *rec, struct btelem_record_stats *st)
+{
+    if (!rec->opts.spill_entries)
+        return;
+    st->spilled = btelem_atomic_load_acq(&rec->spill.spilled);
+    st->spill_peak = btelem_atomic_load_acq(&rec->spill.peak);
+}
+
+/* --------------------------------------------------------------------------
+ * Public API
+ * ----------------------------------------------------------------------- */
+
+static void record_free(struct btelem_recorder *rec)
+{
+    if (rec->spill_mem)
+        munmap(rec->spill_mem, rec->spill_len);
+    rec->spill_mem = NULL;
+    buf_free(rec->bufs[0]);
+    buf_free(rec->bufs[1]);
+    if (rec->file)
+        index_free(&rec->file->index);
+    free(rec->file);
+    free(rec->schema);
+    rec->bufs[0] = rec->bufs[1] = NULL;
+    rec->file = NULL;
+    rec->schema = NULL;
+    pthread_cond_destroy(&rec->cond);
+    pthread_mutex_destroy(&rec->lock);
+}
+
+/* Continuous recording: the first file, the client and its spill */
+static int record_open(struct btelem_recorder *rec)
+{
+    struct btelem_ctx *ctx = rec->ctx;
+    if (file_open(rec, 0) < 0)
+        return -1;
+
+    rec->btelem_client_id = btelem_client_open(ctx, NULL, 0);
+    if (rec->btelem_client_id < 0) {
+        fprintf(stderr, "btelem_record: no free client slots\n");
+        close(rec->file->fd);
+        return -1;
+    }
+
+    if (rec->opts.spill_entries
+        && (spill_map(rec) < 0
+            || btelem_client_set_spill(ctx, rec->btelem_client_id, &rec->spill) < 0)) {
+        fprintf(stderr, "btelem_record: spill setup failed (needs a fixed ring "
+                "and a power-of-2 size)\n");
+        btelem_client_close(ctx, rec->btelem_client_id);
+        close(rec->file->fd);
+        return -1;
+    }
+    return 0;
+}
+
+int btelem_record_start(struct btelem_recorder *rec, struct btelem_ctx *ctx,
+                        const char *path, const struct btelem_record_opts *opts)
+{
+    if (!rec || !ctx || !path || strlen(path) >= sizeof(rec->path))
+        return -1;
+
+    memset(rec, 0, sizeof(*rec));
+    /* Before anything that can fail: record_open() already takes the lock,
+     * and record_free() destroys both */
+    pthread_mutex_init(&rec->lock, NULL);
+    pthread_cond_init(&rec->cond, NULL);
+    rec->ctx = ctx;
+    strcpy(rec->path, path);
+    if (opts)
+        rec->opts = *opts;
+    if (rec->opts.buf_bytes == 0)
+        rec->opts.buf_bytes = BTELEM_RECORD_BUF;
+    if (rec->opts.buf_bytes < 2 * BTELEM_RECORD_PKT)
+        rec->opts.buf_bytes = 2 * BTELEM_RECORD_PKT;
+    if (rec->opts.flush_ms == 0)
+        rec->opts.flush_ms = BTELEM_RECORD_FLUSH_MS;
+
+    int slen = btelem_schema_serialize_compact(ctx, NULL, 0);
+    rec->schema = slen > 0 ? (uint8_t *)malloc((size_t)slen) : NULL;
+    rec->bufs[0] = buf_new(rec->opts.buf_bytes);
+    rec->bufs[1] = buf_new(rec->opts.buf_bytes);
+    rec->file = (struct btelem_record_file *)calloc(1, sizeof(*rec->file));
+    if (!rec->schema || !rec->bufs[0] || !rec->bufs[1] || !rec->file
+        || btelem_schema_serialize_compact(ctx, rec->schema, (size_t)slen) != slen) {
+        fprintf(stderr, "btelem_record: setup failed\n");
+        record_free(rec);
+        return -1;
+    }
+    rec->schema_len = (uint32_t)slen;
+
+    if (rec->opts.trigger) {
+        if (rec->opts.spill_entries) {
+            fprintf(stderr, "btelem_record: spill needs continuous recording, "
+                    "not trigger\n");
+            record_free(rec);
+            return -1;
+        }
+        /* Each window opens its own client and file, the first file 0 */
+        rec->btelem_client_id = -1;
+        rec->file->fd = -1;
+        rec->file->number = UINT32_MAX;
+        rec->trigger_seen = btelem_trigger_get(ctx, NULL, NULL);
+    } else if (record_open(rec) < 0) {
+        record_free(rec);
+        return -1;
+    }
+
+    rec->running = 1;
+    if (pthread_create(&rec->writer_thread, NULL, record_writer_thread, rec) != 0)
+        goto fail;
+    if (pthread_create(&rec->drain_thread, NULL,
+                       rec->opts.trigger ? record_trigger_thread : record_drain_thread,
+                       rec) != 0) {
+        record_done(rec);
+        pthread_join(rec->writer_thread, NULL);
+        goto fail;
+    }
+    if (rec->spill_mem
+        && pthread_create(&rec->spill_thread, NULL, record_spill_thread, rec) != 0) {
+        rec->running = 0;
+        pthread_join(rec->drain_thread, NULL);
+        pthread_join(rec->writer_thread, NULL);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    fprintf(stderr, "btelem_record: pthread_create failed\n");
+    rec->running = 0;
+    if (rec->file->fd >= 0)
+        close(rec->file->fd);
+    btelem_client_close(ctx, rec->btelem_client_id);
+    record_free(rec);
+    return -1;
+}
+
+void btelem_record_stop(struct btelem_recorder *rec)
+{
+    if (!rec || !rec->running)
+        return;
+
+    rec->running = 0;
+    if (rec->spill_mem)
+        pthread_join(rec->spill_thread, NULL);
+    pthread_join(rec->drain_thread, NULL);
+    pthread_join(rec->writer_thread, NULL);
+    btelem_client_close(rec->ctx, rec->btelem_client_id);
+    spill_stats(rec, &rec->stats);
+    record_free(rec);
+}
+
+void btelem_record_get_stats(struct btelem_recorder *rec,
+                             struct btelem_record_stats *out)
+{
+    pthread_mutex_lock(&rec->lock);
+    *out = rec->stats;
+    pthread_mutex_unlock(&rec->lock);
+    spill_stats(rec, out);
+}
@@ -1,4 +1,5 @@
 #include "btelem/btelem_serve.h"
+#include "btelem_serve_subs.h"
 
 #include <errno.h>
 #include <stdio.h>
@@ -8,12 +9,12 @@
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
-#define BTELEM_SERVE_PKT_BUF    65536
-
 /* TCP keepalive parameters for shedding viewers that vanished without
  * sending FIN (e.g. cable yanked, host crash).  Tuned for "notice within
  * ~25s" which is plenty for a developer-facing telemetry stream. */
@@ -21,24 +22,6 @@
 #define BTELEM_KEEPALIVE_INTVL_S   5
 #define BTELEM_KEEPALIVE_PROBES    3
 
-/* Returns 1 if the peer has closed the connection (FIN received), 0 if the
- * socket still looks healthy, -1 on any other error.  Non-blocking MSG_PEEK
- * does not consume data — important because the server never reads from
- * client sockets in normal operation. */
-static int peer_closed(int fd)
-{
-    uint8_t b;
-    ssize_t n = recv(fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
-    if (n == 0)
-        return 1; /* orderly close: peer sent FIN */
-    if (n < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
-            return 0; /* no data, no FIN — connection still up */
-        return -1; /* ECONNRESET, etc. — treat as closed by caller */
-    }
-    return 0; /* peer sent unexpected data — connection still up */
-}
-
 /* --------------------------------------------------------------------------
  * Helpers
  * ----------------------------------------------------------------------- */
@@ -65,6 +48,108 @@ static int send_all(int fd, const void *data, size_t len)
     return 0;
 }
 
+/* send_all() for a scatter list; advances through iov in place */
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n <= 0) {
+            int e = errno;
+            if (e == EAGAIN || e == EWOULDBLOCK) {
+                fprintf(stderr, "btelem_serve: writev() timed out (fd=%d, iovcnt=%d), retrying...\n",
+                        fd, iovcnt);
+                continue;
+            }
+            fprintf(stderr, "btelem_serve: writev() failed: %s (errno=%d, fd=%d, iovcnt=%d)\n",
+                    strerror(e), e, fd, iovcnt);
+            return -1;
+        }
+        size_t done = (size_t)n;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+/* Send a btelem_drain_iov() packet behind its length prefix.  Spans go
+ * out of the ring directly only if every referenced slot is still clear of
+ * the guard zone, and only as far as the socket takes them without
+ * waiting; the rest is copied into *bounce (grown as needed) before any
+ * wait, so a stalled viewer never reads a slot a producer has reused.
+ * Returns 0 when sent, -1 on a send error or if entries were overwritten
+ * before they could be copied or while they were being sent (the stream
+ * is cut rather than deliver them). */
+static int send_iov_packet(int fd, struct btelem_ctx *ctx, struct btelem_drain_iov *d,
+                           uint32_t *plen, struct iovec *wiov,
+                           uint8_t **bounce, size_t *bounce_size)
+{
+    ssize_t n = 0;
+    if (btelem_drain_iov_validate(ctx, d) == 0) {
+        wiov[0].iov_base = plen;
+        wiov[0].iov_len = 4;
+        for (int i = 0; i < d->iov_count; i++) {
+            wiov[i + 1].iov_base = (void *)d->iov[i].base;
+            wiov[i + 1].iov_len = d->iov[i].len;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = wiov;
+        msg.msg_iovlen = (size_t)d->iov_count + 1;
+        n = sendmsg(fd, &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            int e = errno;
+            if (e != EAGAIN && e != EWOULDBLOCK && e != EINTR) {
+                fprintf(stderr, "btelem_serve: sendmsg() failed: %s (errno=%d, fd=%d)\n",
+                        strerror(e), e, fd);
+                return -1;
+            }
+            n = 0;
+        }
+        if ((size_t)n == 4 + d->total) {
+            int torn = btelem_drain_iov_release(ctx, d);
+            if (torn != 0) {
+                fprintf(stderr, "btelem_serve: client %d: %d entries "
+                        "overwritten during send\n", d->client_id, torn);
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    /* The socket is full, or producers got close: copy out the rest, then
+     * send the copy */
+    size_t sent = (size_t)n > 4 ? (size_t)n - 4 : 0;
+    if (*bounce_size < d->total - sent) {
+        uint8_t *nb = (uint8_t *)realloc(*bounce, d->total - sent);
+        if (!nb)
+            return -1;
+        *bounce = nb;
+        *bounce_size = d->total - sent;
+    }
+    int torn = btelem_drain_iov_settle(ctx, d, sent, *bounce, *bounce_size);
+    if (torn != 0) {
+        fprintf(stderr, "btelem_serve: client %d: %d entries overwritten "
+                "before they could be sent\n", d->client_id, torn);
+        return -1;
+    }
+    int k = 0;
+    if (n < 4) {
+        wiov[0].iov_base = (uint8_t *)plen + n;
+        wiov[0].iov_len = 4 - (size_t)n;
+        k = 1;
+    }
+    wiov[k].iov_base = *bounce;
+    wiov[k].iov_len = d->total;
+    return writev_all(fd, wiov, k + 1);
+}
+
 /* Callback context for streaming schema over a socket */
 struct schema_send_ctx {
     int fd;
@@ -81,40 +166,352 @@ static int schema_send_chunk(const void *chunk, size_t len, void *user)
     return 0;
 }
 
+/* Send length-prefixed fixed-size schema, streamed chunk-by-chunk */
+static int send_schema(struct btelem_ctx *ctx, int fd)
+{
+    int schema_size = btelem_schema_serialize(ctx, NULL, 0);
+    if (schema_size <= 0)
+        return 0;
+
+    uint32_t slen = (uint32_t)schema_size;
+    if (send_all(fd, &slen, 4) < 0)
+        return -1;
+
+    struct schema_send_ctx sc = { .fd = fd, .error = 0 };
+    btelem_schema_stream(ctx, schema_send_chunk, &sc);
+    return sc.error ? -1 : 0;
+}
+
+/* Set send timeout so write() can't block forever when the receiver
+ * stalls (e.g. viewer backgrounded).  If we can't push data within
+ * this window we disconnect the slow client instead of wedging the
+ * drain thread.  The viewer will need to reconnect. */
+static void set_send_timeout(int fd)
+{
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* --------------------------------------------------------------------------
+ * Viewer subscriptions: control messages in, per-ID filter + decimation
+ *
+ * Owned by the connection thread.  In per-client mode the ID set is pushed
+ * into the btelem client filter, so the drain skips unsubscribed IDs; in
+ * fan-out mode it becomes the connection filter.  Decimation always runs
+ * here, compacting each packet before it is sent.  The event-loop server
+ * shares these (btelem_serve_subs.h).
+ * ----------------------------------------------------------------------- */
+
+/* Microseconds to entry timestamp units (ns, or ticks) */
+static uint64_t subs_interval(const struct btelem_ctx *ctx, uint32_t us)
+{
+    if (ctx->clock.tick_hz)
+        return (uint64_t)us * ctx->clock.tick_hz / 1000000u;
+    return (uint64_t)us * 1000u;
+}
+
+/* Apply one control message.  Returns 1 if the subscription changed, 0 if
+ * not, -1 if the message is malformed. */
+static int subs_apply(struct btelem_serve_subs *s, const struct btelem_ctx *ctx,
+                      const uint8_t *msg, uint32_t len)
+{
+    struct btelem_ctrl_header h;
+    memcpy(&h, msg, sizeof(h));
+    const uint8_t *rec = msg + sizeof(h);
+
+    if (h.type == BTELEM_CTRL_HELLO) {
+        if (len != sizeof(h) + sizeof(uint64_t))
+            return -1;
+        memcpy(&s->hello_hash, rec, sizeof(uint64_t));
+        s->hello = 1;
+        return 0;
+    }
+    if (len != sizeof(h) + (uint32_t)h.count * sizeof(struct btelem_ctrl_sub))
+        return -1;
+
+    switch (h.type) {
+    case BTELEM_CTRL_SUBSCRIBE:
+    case BTELEM_CTRL_UNSUBSCRIBE:
+        if (!s->active) {
+            s->active = 1;
+            memset(s->on, h.type == BTELEM_CTRL_UNSUBSCRIBE, sizeof(s->on));
+        }
+        for (uint16_t i = 0; i < h.count; i++) {
+            struct btelem_ctrl_sub sub;
+            memcpy(&sub, rec + (size_t)i * sizeof(sub), sizeof(sub));
+            if (sub.id >= BTELEM_MAX_SCHEMA_ENTRIES)
+                continue;
+            int on = (h.type == BTELEM_CTRL_SUBSCRIBE);
+            s->on[sub.id] = (uint8_t)on;
+            s->interval[sub.id] = on ? subs_interval(ctx, sub.min_interval_us) : 0;
+            s->last[sub.id] = 0;
+        }
+        break;
+    case BTELEM_CTRL_RESET:
+        s->active = 0;
+        memset(s->interval, 0, sizeof(s->interval));
+        break;
+    case BTELEM_CTRL_COMPRESS:
+        s->compress = 1;
+        return 0;
+    default:
+        return 0;   /* unknown type: ignore, for newer viewers */
+    }
+
+    s->rate_limited = 0;
+    for (int i = 0; i < BTELEM_MAX_SCHEMA_ENTRIES && !s->rate_limited; i++)
+        s->rate_limited = (s->interval[i] != 0);
+    return 1;
+}
+
+/* Read whatever the viewer has sent without blocking and apply complete
+ * messages.  Returns 1 if the subscription changed, 0 if not, -1 if the
+ * peer closed the connection or sent a malformed message. */
+int btelem_serve_subs_poll(struct btelem_serve_subs *s, const struct btelem_ctx *ctx,
+                           int fd)
+{
+    int changed = 0;
+    for (;;) {
+        ssize_t n = recv(fd, s->rx + s->rx_len, sizeof(s->rx) - s->rx_len,
+                         MSG_DONTWAIT);
+        if (n == 0)
+            return -1;  /* orderly close: peer sent FIN */
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return changed;
+            return -1;  /* ECONNRESET, etc. */
+        }
+        s->rx_len += (uint32_t)n;
+
+        uint32_t pos = 0;
+        while (s->rx_len - pos >= 4) {
+            uint32_t len;
+            memcpy(&len, s->rx + pos, 4);
+            if (len < sizeof(struct btelem_ctrl_header) || len > BTELEM_CTRL_MAX_SIZE)
+                return -1;
+            if (s->rx_len - pos - 4 < len)
+                break;
+            int rc = subs_apply(s, ctx, s->rx + pos + 4, len);
+            if (rc < 0)
+                return -1;
+            pos += 4 + len;
+            s->rx_msgs++;
+            changed |= rc;
+        }
+        memmove(s->rx, s->rx + pos, s->rx_len - pos);
+        s->rx_len -= pos;
+    }
+}
+
+/* Push the subscribed ID set into a btelem client filter */
+static void subs_set_client_filter(const struct btelem_serve_subs *s,
+                                   struct btelem_ctx *ctx, int client_id)
+{
+    uint16_t ids[BTELEM_MAX_SCHEMA_ENTRIES];
+    int count = 0;
+    for (int i = 0; s->active && i < BTELEM_MAX_SCHEMA_ENTRIES; i++) {
+        if (s->on[i])
+            ids[count++] = (uint16_t)i;
+    }
+    /* An empty filter means "all"; an out-of-range ID matches nothing */
+    if (s->active && count == 0)
+        ids[count++] = BTELEM_MAX_SCHEMA_ENTRIES;
+    btelem_client_set_filter(ctx, client_id, s->active ? ids : NULL, count);
+}
+
+/* Copy packet `src` to `dst` keeping only entries in `filter` (NULL = all)
+ * that pass decimation; payloads are repacked back to back.  `dst` may be
+ * `src`.  Returns the new packet length. */
+uint32_t btelem_serve_subs_compact(struct btelem_serve_subs *s,
+                                   const uint8_t *filter, const uint8_t *src,
+                                   uint32_t len, uint8_t *dst)
+{
+    struct btelem_packet_header h;
+    memcpy(&h, src, sizeof(h));
+    if (h.flags & BTELEM_PACKET_FLAG_CLOCK) {
+        if (dst != src)
+            memmove(dst, src, len);
+        return len;
+    }
+
+    const struct btelem_entry_header *in =
+        (const struct btelem_entry_header *)(src + sizeof(h));
+    struct btelem_entry_header *out =
+        (struct btelem_entry_header *)(dst + sizeof(h));
+    const uint8_t *in_payload = src + sizeof(h)
+                              + (size_t)h.entry_count * sizeof(*in);
+
+    /* Pass 1: pick entries (out[k] may alias in[i], k <= i) */
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < h.entry_count; i++) {
+        struct btelem_entry_header e = in[i];
+        if (e.id >= BTELEM_MAX_SCHEMA_ENTRIES || (filter && !filter[e.id]))
+            continue;
+        if (s->interval[e.id]) {
+            if (e.timestamp - s->last[e.id] < s->interval[e.id])
+                continue;
+            s->last[e.id] = e.timestamp;
+        }
+        out[kept++] = e;
+    }
+
+    /* Pass 2: move payloads down behind the shorter table */
+    uint8_t *out_payload = dst + sizeof(h) + (size_t)kept * sizeof(*out);
+    uint32_t off = 0;
+    for (uint16_t k = 0; k < kept; k++) {
+        memmove(out_payload + off, in_payload + out[k].payload_offset,
+                out[k].payload_size);
+        out[k].payload_offset = off;
+        off += out[k].payload_size;
+    }
+
+    h.entry_count = kept;
+    h.payload_size = off;
+    memcpy(dst, &h, sizeof(h));
+    return (uint32_t)(sizeof(h) + (size_t)kept * sizeof(*out) + off);
+}
+
 /* --------------------------------------------------------------------------
  * Client thread: stream schema, then drain loop
  * ----------------------------------------------------------------------- */
 
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+uint8_t *btelem_serve_schema_hello(struct btelem_ctx *ctx, uint64_t have,
+                                   size_t *len)
+{
+    int size = btelem_schema_serialize_compact(ctx, NULL, 0);
+    if (size <= 0)
+        return NULL;
+
+    struct btelem_schema_hello hello;
+    struct btelem_clock clk;
+    uint8_t cbuf[sizeof(struct btelem_packet_header)
+                 + sizeof(struct btelem_clock_wire)];
+    size_t off = 4 + sizeof(hello);
+    uint8_t *buf = (uint8_t *)malloc(off + (size_t)size + 4 + sizeof(cbuf));
+    if (!buf)
+        return NULL;
+    btelem_schema_serialize_compact(ctx, buf + off, (size_t)size);
+
+    struct btelem_schema_compact_header ch;
+    memcpy(&ch, buf + off, sizeof(ch));
+    int cached = (ch.hash == have);
+    hello.magic = BTELEM_SCHEMA_HELLO_MAGIC;
+    hello.schema_size = cached ? 0 : (uint32_t)size;
+    hello.hash = ch.hash;
+
+    uint32_t hlen = (uint32_t)sizeof(hello) + hello.schema_size;
+    memcpy(buf, &hlen, 4);
+    memcpy(buf + 4, &hello, sizeof(hello));
+    *len = 4 + hlen;
+
+    int cn;
+    if (cached && btelem_clock_sample(ctx, &clk) == 0
+        && (cn = btelem_clock_packet(&clk, cbuf, sizeof(cbuf))) > 0) {
+        uint32_t clen = (uint32_t)cn;
+        memcpy(buf + *len, &clen, 4);
+        memcpy(buf + *len + 4, cbuf, clen);
+        *len += 4 + clen;
+    }
+    return buf;
+}
+
+/* Send the HELLO reply (btelem_serve_schema_hello) */
+static int send_schema_hello(struct btelem_ctx *ctx, int fd, uint64_t have)
+{
+    size_t len;
+    uint8_t *buf = btelem_serve_schema_hello(ctx, have, &len);
+    if (!buf)
+        return -1;
+    struct btelem_schema_hello hello;
+    memcpy(&hello, buf + 4, sizeof(hello));
+    int rc = send_all(fd, buf, len);
+    free(buf);
+    if (rc == 0)
+        fprintf(stderr, "btelem_serve: schema %016llx %s (fd=%d)\n",
+                (unsigned long long)hello.hash,
+                hello.schema_size ? "sent compact" : "cached by viewer", fd);
+    return rc;
+}
+
+/* Schema handshake, without waiting: viewers send HELLO right after
+ * connecting, so it is normally queued by the time this runs and gets the
+ * compact reply.  Otherwise the fixed-size schema goes out at once; a HELLO
+ * arriving later is applied like any other message (the viewer already
+ * took the fixed schema as the answer).  Messages read here are applied to
+ * `subs` as usual. */
+static int serve_handshake(struct btelem_ctx *ctx, int fd,
+                           struct btelem_serve_subs *subs)
+{
+    if (btelem_serve_subs_poll(subs, ctx, fd) < 0)
+        return -1;
+    return subs->hello ? send_schema_hello(ctx, fd, subs->hello_hash)
+                       : send_schema(ctx, fd);
+}
+
+/* Batching policy with defaults filled in */
+static void batch_resolve(const struct btelem_serve_batch_opts *in,
+                          struct btelem_serve_batch_opts *out)
+{
+    *out = *in;
+    if (out->max_pkt_bytes == 0)
+        out->max_pkt_bytes = BTELEM_SERVE_PKT_BUF;
+    if (out->max_pkt_bytes < BTELEM_SERVE_MIN_PKT_BUF)
+        out->max_pkt_bytes = BTELEM_SERVE_MIN_PKT_BUF;
+}
+
+/* Log the built-in btelem_stats entry, at most once a second, if the
+ * application registered it (btelem_stats_register) */
+static void serve_publish_stats(struct btelem_server *srv)
+{
+    pthread_mutex_lock(&srv->clients_mu);
+    if (btelem_monotonic_ns() - srv->health.t_ns >= 1000000000ULL)
+        btelem_stats_publish(srv->ctx, &srv->health);
+    pthread_mutex_unlock(&srv->clients_mu);
+}
+
+/* Grow after this many consecutive packets that left entries behind */
+#define BATCH_GROW_AFTER 8
+
+/* While streaming, read control input at most this often; idle loops
+ * read it as soon as poll() reports the socket readable */
+#define CTRL_POLL_US 10000
+
 static void *client_thread(void *arg)
 {
     struct btelem_client_conn *conn = (struct btelem_client_conn *)arg;
     struct btelem_server *srv = conn->server;
     struct btelem_ctx *ctx = srv->ctx;
-    uint8_t pkt_buf[BTELEM_SERVE_PKT_BUF];
+    struct btelem_drain_iov drain;
+    struct iovec wiov[BTELEM_DRAIN_IOV_MAX + 1];
 
-    /* Send length-prefixed schema, streamed chunk-by-chunk */
-    int schema_size = btelem_schema_serialize(ctx, NULL, 0);
-    if (schema_size > 0) {
-        uint32_t slen = (uint32_t)schema_size;
-        if (send_all(conn->fd, &slen, 4) < 0)
-            goto done;
+    struct btelem_serve_batch_opts bo;
+    batch_resolve(&srv->batch, &bo);
+    size_t buf_size = bo.max_pkt_bytes < BTELEM_SERVE_PKT_BUF
+                    ? bo.max_pkt_bytes : BTELEM_SERVE_PKT_BUF;
+    uint8_t *pkt_buf = (uint8_t *)malloc(buf_size);
+    uint8_t *z_buf = NULL;          /* compressed copy, once asked for */
+    uint8_t *bounce = NULL;         /* zero-copy remainder, once a send stalls */
+    size_t bounce_size = 0;
+    size_t z_size = 0;
+    struct btelem_serve_subs *subs =
+        (struct btelem_serve_subs *)calloc(1, sizeof(*subs));
+    if (!pkt_buf || !subs)
+        goto done;
 
-        struct schema_send_ctx sc = { .fd = conn->fd, .error = 0 };
-        btelem_schema_stream(ctx, schema_send_chunk, &sc);
-        if (sc.error)
-            goto done;
-    }
+    if (serve_handshake(ctx, conn->fd, subs) < 0)
+        goto done;
+    if (subs->active)
+        subs_set_client_filter(subs, ctx, conn->btelem_client_id);
 
     /* Drain loop: send length-prefixed packed batches */
-
-    /* Set send timeout so write() can't block forever when the receiver
-     * stalls (e.g. viewer backgrounded).  If we can't push data within
-     * this window we disconnect the slow client instead of wedging the
-     * drain thread.  The viewer will need to reconnect. */
-    {
-        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
-        setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-    }
+    set_send_timeout(conn->fd);
 
     fprintf(stderr, "btelem_serve: client %d connected (fd=%d)\n",
             conn->btelem_client_id, conn->fd);
@@ -128,41 +525,183 @@ static void *client_thread(void *arg)
     struct timespec last_report;
     clock_gettime(CLOCK_MONOTONIC, &last_report);
 
+    /* Ring positions pending before the watermark counts as reached */
+    uint64_t ring_half = (uint64_t)ctx->ring->capacity
+                       * (ctx->ring_mode == BTELEM_RING_SHARDED ? ctx->shard_count : 1) / 2;
+    uint64_t pending_since = 0;     /* us; 0 = nothing pending */
+    uint32_t bytes_per_entry = sizeof(struct btelem_entry_header) + 16;
+    int more_pending = 0;           /* last packet hit the size limit */
+    int full_streak = 0;
+    int readable = 0;               /* poll() saw control input (or EOF) */
+    uint64_t last_ctrl = 0;         /* us; last control input check */
+
+    pthread_mutex_lock(&srv->clients_mu);
+    conn->stats.pkt_buf_size = (uint32_t)buf_size;
+    pthread_mutex_unlock(&srv->clients_mu);
+
     while (srv->running) {
-        int n = btelem_drain_packed(ctx, conn->btelem_client_id,
-                                    pkt_buf, sizeof(pkt_buf));
+        /* Subscription changes from the viewer; also notices viewers that
+         * quietly went away, which the drain loop would never see */
+        uint64_t t = now_us();
+        if (readable || t - last_ctrl >= CTRL_POLL_US) {
+            int sc = btelem_serve_subs_poll(subs, ctx, conn->fd);
+            if (sc < 0) {
+                fprintf(stderr, "btelem_serve: client %d peer gone or sent a bad "
+                        "control message — disconnecting\n", conn->btelem_client_id);
+                break;
+            }
+            if (sc > 0)
+                subs_set_client_filter(subs, ctx, conn->btelem_client_id);
+            readable = 0;
+            last_ctrl = t;
+        }
+
+        /* Decide whether to flush now, per the batching policy.  Ring
+         * positions rather than committed entries: O(1) in every mode. */
+        uint64_t avail = btelem_client_pending(ctx, conn->btelem_client_id);
+        int reason = -1;
+        uint32_t wait_us = 1000;
+
+        if (avail > 0) {
+            if (!pending_since)
+                pending_since = t;
+            uint64_t est = avail * (ctx->ring_mode == BTELEM_RING_VAR
+                                    ? BTELEM_VAR_UNIT : bytes_per_entry);
+            if (more_pending)
+                reason = BTELEM_SERVE_FLUSH_FULL;
+            else if (est >= bo.min_bytes)
+                reason = BTELEM_SERVE_FLUSH_SIZE;
+            else if (avail >= ring_half)
+                reason = BTELEM_SERVE_FLUSH_PRESSURE;
+            else if (t - pending_since >= bo.max_latency_us)
+                reason = BTELEM_SERVE_FLUSH_DEADLINE;
+            else if (pending_since + bo.max_latency_us - t < wait_us)
+                wait_us = (uint32_t)(pending_since + bo.max_latency_us - t);
+        }
+
+        /* Zero-copy at the default size.  Other sizes are packed: the iov
+         * drain bounds entries, not bytes, and grown buffers hold more
+         * entries than an iovec list can.  Decimation and compression
+         * rewrite the packet, so they need a packed copy too. */
+        int use_iov = (buf_size == BTELEM_SERVE_PKT_BUF) && !subs->rate_limited
+                   && !subs->compress;
+        int n = 0;
+        if (reason >= 0) {
+            if (use_iov)
+                n = btelem_drain_iov(ctx, conn->btelem_client_id, &drain,
+                                     pkt_buf, buf_size);
+            else
+                n = btelem_drain_packed(ctx, conn->btelem_client_id,
+                                        pkt_buf, buf_size);
+        }
+
         if (n > 0) {
             uint32_t plen = (uint32_t)n;
-            if (send_all(conn->fd, &plen, 4) < 0 ||
-                send_all(conn->fd, pkt_buf, plen) < 0) {
+            const struct btelem_packet_header *ph =
+                (const struct btelem_packet_header *)pkt_buf;
+
+            /* Judge fullness on what was drained, before decimation */
+            const size_t worst = sizeof(struct btelem_entry_header) + BTELEM_MAX_PAYLOAD;
+            int full = use_iov
+                ? ph->entry_count >= BTELEM_DRAIN_IOV_MAX - 1
+                : (ph->entry_count >= (buf_size - sizeof(*ph)) / worst
+                   || plen + worst > buf_size);
+            if (ph->entry_count)
+                bytes_per_entry = (plen - (uint32_t)sizeof(*ph)) / ph->entry_count;
+            int skip = 0;
+            if (subs->rate_limited) {
+                plen = btelem_serve_subs_compact(subs, NULL, pkt_buf, plen, pkt_buf);
+                skip = (ph->entry_count == 0 && ph->dropped == 0);
+            }
+            const uint8_t *send_buf = pkt_buf;
+            if (subs->compress && !skip) {
+                if (z_size < buf_size) {
+                    uint8_t *nb = (uint8_t *)realloc(z_buf, buf_size);
+                    if (nb) {
+                        z_buf = nb;
+                        z_size = buf_size;
+                    }
+                }
+                int zn = z_buf ? btelem_packet_compress(pkt_buf, plen, z_buf, z_size) : 0;
+                if (zn > 0) {
+                    send_buf = z_buf;
+                    plen = (uint32_t)zn;
+                }
+            }
+
+            int sent = 0;
+            if (skip) {
+                /* everything decimated: nothing to send */
+            } else if (use_iov) {
+                sent = send_iov_packet(conn->fd, ctx, &drain, &plen, wiov,
+                                       &bounce, &bounce_size);
+            } else {
+                wiov[0].iov_base = &plen;
+                wiov[0].iov_len = 4;
+                wiov[1].iov_base = (void *)send_buf;
+                wiov[1].iov_len = plen;
+                sent = writev_all(conn->fd, wiov, 2);
+            }
+            if (sent < 0) {
                 fprintf(stderr, "btelem_serve: client %d send failed after "
                         "%lu pkts / %lu bytes — disconnecting\n",
                         conn->btelem_client_id,
                         (unsigned long)total_pkts, (unsigned long)total_bytes);
                 break;
             }
-            total_bytes += 4 + plen;
-            total_pkts++;
-            const struct btelem_packet_header *ph =
-                (const struct btelem_packet_header *)pkt_buf;
-            total_dropped += ph->dropped;
             empty_drains = 0;
+            if (!skip) {
+                total_bytes += 4 + plen;
+                total_pkts++;
+                total_dropped += ph->dropped;
+
+                pthread_mutex_lock(&srv->clients_mu);
+                conn->stats.packets++;
+                conn->stats.entries += ph->entry_count;
+                conn->stats.bytes += 4 + plen;
+                conn->stats.dropped += ph->dropped;
+                conn->stats.flush[reason]++;
+                pthread_mutex_unlock(&srv->clients_mu);
+            }
+
+            /* Still behind after a full packet: send again, and grow the
+             * buffer if that keeps happening */
+            more_pending = full
+                        && btelem_client_pending(ctx, conn->btelem_client_id) > 0;
+            pending_since = more_pending ? now_us() : 0;
+            full_streak = more_pending ? full_streak + 1 : 0;
+            if (full_streak >= BATCH_GROW_AFTER && buf_size < bo.max_pkt_bytes) {
+                size_t grown = buf_size * 2;
+                if (grown > bo.max_pkt_bytes)
+                    grown = bo.max_pkt_bytes;
+                uint8_t *nb = (uint8_t *)realloc(pkt_buf, grown);
+                if (nb) {
+                    pkt_buf = nb;
+                    buf_size = grown;
+                    fprintf(stderr, "btelem_serve: client %d backlogged, "
+                            "packet buffer now %zu bytes\n",
+                            conn->btelem_client_id, buf_size);
+                    pthread_mutex_lock(&srv->clients_mu);
+                    conn->stats.pkt_buf_size = (uint32_t)buf_size;
+                    pthread_mutex_unlock(&srv->clients_mu);
+                }
+                full_streak = 0;
+            }
         } else {
+            if (reason >= 0) {
+                /* Pending entries were filtered or not yet committed */
+                more_pending = 0;
+                pending_since = 0;
+                wait_us = 100;
+            }
             empty_drains++;
-            /* Cheap liveness probe: detect viewers that quietly went away
-             * without sending us data we'd otherwise stumble over.  Without
-             * this the drain loop happily spins forever and the slot is
-             * never reclaimed. */
-            if ((empty_drains & 0xFF) == 0) {
-                int pc = peer_closed(conn->fd);
-                if (pc != 0) {
-                    fprintf(stderr, "btelem_serve: client %d peer gone "
-                            "(peer_closed=%d) — disconnecting\n",
-                            conn->btelem_client_id, pc);
-                    break;
-                }
+            if (wait_us >= 1000) {
+                /* Sleep on the socket so control input is read at once */
+                struct pollfd pfd = { .fd = conn->fd, .events = POLLIN };
+                readable = poll(&pfd, 1, (int)(wait_us / 1000)) > 0;
+            } else {
+                usleep(wait_us);
             }
-            usleep(1000);
         }
 
         /* Periodic status every 2 seconds */
@@ -173,17 +712,36 @@ static void *client_thread(void *arg)
         if (dt >= 2.0) {
             uint64_t delta_pkts = total_pkts - last_report_pkts;
             uint64_t delta_dropped = total_dropped - last_report_dropped;
+            const struct btelem_client *bc = &ctx->clients[conn->btelem_client_id];
             fprintf(stderr, "btelem_serve: client %d status: %lu pkts (+%lu) "
-                    "%lu bytes, dropped=%lu (+%lu), empty_drains=%lu\n",
+                    "%lu bytes, dropped=%lu (+%lu), torn=%lu, lag_max=%lu, "
+                    "empty_drains=%lu\n",
                     conn->btelem_client_id,
                     (unsigned long)total_pkts, (unsigned long)delta_pkts,
                     (unsigned long)total_bytes,
                     (unsigned long)total_dropped, (unsigned long)delta_dropped,
+                    (unsigned long)bc->torn, (unsigned long)bc->lag_max,
                     (unsigned long)empty_drains);
+            serve_publish_stats(srv);
+            pthread_mutex_lock(&srv->clients_mu);
+            conn->stats.packets_per_sec = (double)delta_pkts / dt;
+            pthread_mutex_unlock(&srv->clients_mu);
             last_report = now;
             last_report_pkts = total_pkts;
             last_report_dropped = total_dropped;
             empty_drains = 0;
+
+            /* Refresh the decoder's tick calibration (no-op for ns clocks) */
+            struct btelem_clock clk;
+            if (btelem_clock_sample(ctx, &clk) == 0) {
+                uint8_t cbuf[sizeof(struct btelem_packet_header)
+                             + sizeof(struct btelem_clock_wire)];
+                int cn = btelem_clock_packet(&clk, cbuf, sizeof(cbuf));
+                uint32_t clen = (uint32_t)cn;
+                if (cn > 0 && (send_all(conn->fd, &clen, 4) < 0 ||
+                               send_all(conn->fd, cbuf, clen) < 0))
+                    break;
+            }
         }
     }
 
@@ -192,6 +750,10 @@ static void *client_thread(void *arg)
                 conn->btelem_client_id);
 
 done:
+    free(subs);
+    free(z_buf);
+    free(pkt_buf);
+    free(bounce);
     close(conn->fd);
     conn->fd = -1;
     btelem_client_close(ctx, conn->btelem_client_id);
@@ -203,6 +765,337 @@ done:
     return NULL;
 }
 
+/* --------------------------------------------------------------------------
+ * Fan-out mode: one drain thread, refcounted packet pool
+ *
+ * The drain thread fills a free pool packet with btelem_drain_packed() and
+ * queues a reference on every subscribed connection.  Connection threads
+ * pop references and send them with their own packet header (dropped
+ * count); filtered or decimated viewers get a compacted copy.  All queue
+ * and refcount state is guarded by clients_mu.
+ * ----------------------------------------------------------------------- */
+
+struct btelem_serve_pkt {
+    uint32_t refs;    /* queued + in-flight references; 0 = free */
+    uint32_t len;
+    uint8_t  data[BTELEM_SERVE_PKT_BUF];
+};
+
+static uint64_t fanout_accepted(const struct btelem_client_conn *conn,
+                                const struct btelem_serve_pkt *pkt)
+{
+    const struct btelem_packet_header *ph =
+        (const struct btelem_packet_header *)pkt->data;
+    if (!conn->filter_active)
+        return ph->entry_count;
+
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(pkt->data + sizeof(*ph));
+    uint64_t n = 0;
+    for (uint16_t i = 0; i < ph->entry_count; i++)
+        n += (table[i].id < BTELEM_MAX_SCHEMA_ENTRIES && conn->filter[table[i].id]);
+    return n;
+}
+
+/* Drop the oldest queued packet of conn, accounting its entries as lost */
+static void fanout_drop_head(struct btelem_server *srv,
+                             struct btelem_client_conn *conn)
+{
+    struct btelem_serve_pkt *pkt = &srv->pool[conn->queue[conn->q_head]];
+    const struct btelem_packet_header *ph =
+        (const struct btelem_packet_header *)pkt->data;
+
+    conn->dropped_pending += fanout_accepted(conn, pkt) + ph->dropped;
+    conn->q_head = (conn->q_head + 1) % BTELEM_SERVE_QUEUE_DEPTH;
+    conn->q_count--;
+    pkt->refs--;
+}
+
+/* Find a free pool packet, evicting from the longest backlog if needed.
+ * Caller holds clients_mu.  Returns -1 if every packet is in flight. */
+static int fanout_acquire(struct btelem_server *srv)
+{
+    for (;;) {
+        for (int i = 0; i < BTELEM_SERVE_POOL_PKTS; i++) {
+            if (srv->pool[i].refs == 0)
+                return i;
+        }
+
+        struct btelem_client_conn *slowest = NULL;
+        for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++) {
+            struct btelem_client_conn *c = &srv->clients[i];
+            if (c->q_count > 0 && (!slowest || c->q_count > slowest->q_count))
+                slowest = c;
+        }
+        if (!slowest)
+            return -1;
+        fanout_drop_head(srv, slowest);
+    }
+}
+
+static void fanout_publish(struct btelem_server *srv, int idx)
+{
+    struct btelem_serve_pkt *pkt = &srv->pool[idx];
+
+    pthread_mutex_lock(&srv->clients_mu);
+    for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++) {
+        struct btelem_client_conn *c = &srv->clients[i];
+        if (!c->active || !c->subscribed)
+            continue;
+        if (c->q_count == BTELEM_SERVE_QUEUE_DEPTH)
+            fanout_drop_head(srv, c);
+        c->queue[(c->q_head + c->q_count) % BTELEM_SERVE_QUEUE_DEPTH] = (uint16_t)idx;
+        c->q_count++;
+        pkt->refs++;
+        pthread_cond_signal(&c->cond);
+    }
+    pthread_mutex_unlock(&srv->clients_mu);
+}
+
+static void *fanout_drain_thread(void *arg)
+{
+    struct btelem_server *srv = (struct btelem_server *)arg;
+    struct btelem_ctx *ctx = srv->ctx;
+
+    uint64_t total_pkts = 0;
+    uint64_t total_dropped = 0;
+    struct timespec last_report;
+    clock_gettime(CLOCK_MONOTONIC, &last_report);
+
+    while (srv->running) {
+        pthread_mutex_lock(&srv->clients_mu);
+        int idx = fanout_acquire(srv);
+        pthread_mutex_unlock(&srv->clients_mu);
+        if (idx < 0) {
+            usleep(1000);
+            continue;
+        }
+
+        /* A free packet has no references, so it is ours until published */
+        struct btelem_serve_pkt *pkt = &srv->pool[idx];
+        int n = btelem_drain_packed(ctx, srv->drain_client_id,
+                                    pkt->data, sizeof(pkt->data));
+        if (n > 0) {
+            pkt->len = (uint32_t)n;
+            total_pkts++;
+            total_dropped += ((const struct btelem_packet_header *)pkt->data)->dropped;
+            fanout_publish(srv, idx);
+        } else {
+            usleep(1000);
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (double)(now.tv_sec - last_report.tv_sec)
+                  + (double)(now.tv_nsec - last_report.tv_nsec) / 1e9;
+        if (dt < 2.0)
+            continue;
+        last_report = now;
+
+        int viewers = 0;
+        pthread_mutex_lock(&srv->clients_mu);
+        for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++)
+            viewers += srv->clients[i].active && srv->clients[i].subscribed;
+        pthread_mutex_unlock(&srv->clients_mu);
+        fprintf(stderr, "btelem_serve: fanout status: %lu pkts, ring dropped=%lu, "
+                "viewers=%d\n", (unsigned long)total_pkts,
+                (unsigned long)total_dropped, viewers);
+        serve_publish_stats(srv);
+
+        /* One shared clock refresh for every viewer */
+        struct btelem_clock clk;
+        if (btelem_clock_sample(ctx, &clk) == 0) {
+            pthread_mutex_lock(&srv->clients_mu);
+            idx = fanout_acquire(srv);
+            pthread_mutex_unlock(&srv->clients_mu);
+            if (idx >= 0) {
+                pkt = &srv->pool[idx];
+                n = btelem_clock_packet(&clk, pkt->data, sizeof(pkt->data));
+                if (n > 0) {
+                    pkt->len = (uint32_t)n;
+                    fanout_publish(srv, idx);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Send one pool packet to conn with its own header.  A filtered or
+ * decimated viewer gets a compacted copy built in `scratch`, and one that
+ * asked for compression a compressed copy in `z_buf` (both at least
+ * BTELEM_SERVE_PKT_BUF bytes; z_buf NULL = none).  Returns 1 if sent, 0 if
+ * nothing was left to send, -1 on a send failure. */
+static int fanout_send(struct btelem_client_conn *conn,
+                       const struct btelem_serve_pkt *pkt, uint64_t dropped,
+                       struct btelem_serve_subs *subs, uint8_t *scratch,
+                       uint8_t *z_buf,
+                       uint32_t *sent_len, uint16_t *sent_entries)
+{
+    const uint8_t *data = pkt->data;
+    uint32_t len = pkt->len;
+    if (conn->filter_active || subs->rate_limited) {
+        len = btelem_serve_subs_compact(subs, conn->filter_active ? conn->filter : NULL,
+                           data, len, scratch);
+        data = scratch;
+    }
+    if (z_buf) {
+        int zn = btelem_packet_compress(data, len, z_buf, BTELEM_SERVE_PKT_BUF);
+        if (zn > 0) {
+            data = z_buf;
+            len = (uint32_t)zn;
+        }
+    }
+
+    struct btelem_packet_header hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    dropped += hdr.dropped;
+    hdr.dropped = (dropped > UINT32_MAX) ? UINT32_MAX : (uint32_t)dropped;
+    if (hdr.entry_count == 0 && hdr.dropped == 0
+        && !(hdr.flags & BTELEM_PACKET_FLAG_CLOCK))
+        return 0;
+
+    struct iovec iov[3] = {
+        { .iov_base = &len,                         .iov_len = 4 },
+        { .iov_base = &hdr,                         .iov_len = sizeof(hdr) },
+        { .iov_base = (void *)(data + sizeof(hdr)), .iov_len = len - sizeof(hdr) },
+    };
+    *sent_len = 4 + len;
+    *sent_entries = hdr.entry_count;
+    return writev_all(conn->fd, iov, 3) < 0 ? -1 : 1;
+}
+
+/* Read control messages; a change becomes the connection filter */
+static int fanout_poll(struct btelem_client_conn *conn, struct btelem_serve_subs *subs)
+{
+    struct btelem_server *srv = conn->server;
+    int sc = btelem_serve_subs_poll(subs, srv->ctx, conn->fd);
+    if (sc > 0) {
+        pthread_mutex_lock(&srv->clients_mu);
+        memcpy(conn->filter, subs->on, sizeof(conn->filter));
+        conn->filter_active = subs->active;
+        pthread_mutex_unlock(&srv->clients_mu);
+    }
+    return sc;
+}
+
+static void *fanout_client_thread(void *arg)
+{
+    struct btelem_client_conn *conn = (struct btelem_client_conn *)arg;
+    struct btelem_server *srv = conn->server;
+    int slot = (int)(conn - srv->clients);
+    uint8_t *scratch = (uint8_t *)malloc(BTELEM_SERVE_PKT_BUF);
+    uint8_t *z_buf = NULL;          /* compressed copy, once asked for */
+    struct btelem_serve_subs *subs =
+        (struct btelem_serve_subs *)calloc(1, sizeof(*subs));
+    if (!scratch || !subs)
+        goto done;
+
+    if (serve_handshake(srv->ctx, conn->fd, subs) < 0)
+        goto done;
+    if (subs->active) {
+        pthread_mutex_lock(&srv->clients_mu);
+        memcpy(conn->filter, subs->on, sizeof(conn->filter));
+        conn->filter_active = 1;
+        pthread_mutex_unlock(&srv->clients_mu);
+    }
+    set_send_timeout(conn->fd);
+
+    fprintf(stderr, "btelem_serve: viewer %d connected (fd=%d, fanout)\n",
+            slot, conn->fd);
+
+    uint64_t total_pkts = 0;
+    uint64_t total_bytes = 0;
+
+    pthread_mutex_lock(&srv->clients_mu);
+    conn->subscribed = 1;
+    while (srv->running) {
+        if (conn->q_count == 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100 * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&conn->cond, &srv->clients_mu, &deadline);
+            if (conn->q_count > 0)
+                continue;
+
+            /* Idle: pick up control messages and check the viewer is
+             * still there */
+            pthread_mutex_unlock(&srv->clients_mu);
+            int sc = fanout_poll(conn, subs);
+            pthread_mutex_lock(&srv->clients_mu);
+            if (sc < 0) {
+                fprintf(stderr, "btelem_serve: viewer %d peer gone or sent a "
+                        "bad control message — disconnecting\n", slot);
+                break;
+            }
+            continue;
+        }
+
+        int idx = conn->queue[conn->q_head];
+        conn->q_head = (conn->q_head + 1) % BTELEM_SERVE_QUEUE_DEPTH;
+        conn->q_count--;
+        uint64_t dropped = conn->dropped_pending;
+        conn->dropped_pending = 0;
+        pthread_mutex_unlock(&srv->clients_mu);
+
+        /* refs held: the drain thread will not reuse the packet */
+        struct btelem_serve_pkt *pkt = &srv->pool[idx];
+        uint32_t sent_len = 0;
+        uint16_t sent_entries = 0;
+        if (subs->compress && !z_buf)
+            z_buf = (uint8_t *)malloc(BTELEM_SERVE_PKT_BUF);
+        int rc = fanout_send(conn, pkt, dropped, subs, scratch, z_buf,
+                             &sent_len, &sent_entries);
+        int sc = rc < 0 ? 0 : fanout_poll(conn, subs);
+
+        pthread_mutex_lock(&srv->clients_mu);
+        pkt->refs--;
+        if (rc < 0) {
+            fprintf(stderr, "btelem_serve: viewer %d send failed after "
+                    "%lu pkts / %lu bytes — disconnecting\n", slot,
+                    (unsigned long)total_pkts, (unsigned long)total_bytes);
+            break;
+        }
+        if (rc > 0) {
+            total_pkts++;
+            total_bytes += sent_len;
+            conn->stats.packets++;
+            conn->stats.entries += sent_entries;
+            conn->stats.bytes += sent_len;
+            conn->stats.dropped += dropped;
+        }
+        if (sc < 0) {
+            fprintf(stderr, "btelem_serve: viewer %d peer gone or sent a "
+                    "bad control message — disconnecting\n", slot);
+            break;
+        }
+    }
+
+    /* Return queued references to the pool */
+    conn->subscribed = 0;
+    while (conn->q_count > 0)
+        fanout_drop_head(srv, conn);
+    pthread_mutex_unlock(&srv->clients_mu);
+
+done:
+    free(subs);
+    free(z_buf);
+    free(scratch);
+    close(conn->fd);
+    conn->fd = -1;
+
+    pthread_mutex_lock(&srv->clients_mu);
+    conn->active = 0;
+    pthread_mutex_unlock(&srv->clients_mu);
+
+    return NULL;
+}
+
 /* --------------------------------------------------------------------------
  * Accept thread
  * ----------------------------------------------------------------------- */
@@ -229,8 +1122,9 @@ static void *accept_thread(void *arg)
             setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,   &cnt,   sizeof(cnt));
         }
 
-        int btelem_cid = btelem_client_open(srv->ctx, NULL, 0);
-        if (btelem_cid < 0) {
+        /* Fan-out viewers share the drain thread's btelem client */
+        int btelem_cid = srv->fanout ? -1 : btelem_client_open(srv->ctx, NULL, 0);
+        if (!srv->fanout && btelem_cid < 0) {
             fprintf(stderr, "btelem_serve: refusing client — "
                     "btelem_client_open() failed "
                     "(all %d btelem client slots in use)\n",
@@ -252,7 +1146,8 @@ static void *accept_thread(void *arg)
         if (slot < 0) {
             /* No free slots */
             pthread_mutex_unlock(&srv->clients_mu);
-            btelem_client_close(srv->ctx, btelem_cid);
+            if (btelem_cid >= 0)
+                btelem_client_close(srv->ctx, btelem_cid);
             close(fd);
             continue;
         }
@@ -262,8 +1157,16 @@ static void *accept_thread(void *arg)
         conn->btelem_client_id = btelem_cid;
         conn->server = srv;
         conn->active = 1;
+        conn->subscribed = 0;
+        conn->q_head = 0;
+        conn->q_count = 0;
+        conn->dropped_pending = 0;
+        conn->filter_active = 0;
+        memset(&conn->stats, 0, sizeof(conn->stats));
+        conn->stats.pkt_buf_size = BTELEM_SERVE_PKT_BUF;
 
-        pthread_create(&conn->thread, NULL, client_thread, conn);
+        pthread_create(&conn->thread, NULL,
+                       srv->fanout ? fanout_client_thread : client_thread, conn);
         pthread_detach(conn->thread);
 
         pthread_mutex_unlock(&srv->clients_mu);
@@ -276,8 +1179,8 @@ static void *accept_thread(void *arg)
  * Public API
  * ----------------------------------------------------------------------- */
 
-int btelem_serve(struct btelem_server *srv, struct btelem_ctx *ctx,
-                 const char *ip, uint16_t port)
+static int serve_start(struct btelem_server *srv, struct btelem_ctx *ctx,
+                       const char *ip, uint16_t port, int fanout)
 {
     if (!srv || !ctx)
         return -1;
@@ -310,21 +1213,110 @@ int btelem_serve(struct btelem_server *srv, struct btelem_ctx *ctx,
     }
 
     srv->ctx = ctx;
+    memset(&srv->health, 0, sizeof(srv->health));
     srv->listen_fd = lsock;
     srv->running = 1;
+    srv->fanout = fanout;
+    srv->drain_client_id = -1;
+    srv->pool = NULL;
     pthread_mutex_init(&srv->clients_mu, NULL);
 
     for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++) {
         srv->clients[i].fd = -1;
         srv->clients[i].active = 0;
+        srv->clients[i].subscribed = 0;
+        srv->clients[i].q_count = 0;
+        pthread_cond_init(&srv->clients[i].cond, NULL);
+    }
+
+    if (fanout) {
+        srv->pool = (struct btelem_serve_pkt *)calloc(BTELEM_SERVE_POOL_PKTS,
+                                                      sizeof(*srv->pool));
+        srv->drain_client_id = btelem_client_open(ctx, NULL, 0);
+        if (!srv->pool || srv->drain_client_id < 0
+            || pthread_create(&srv->drain_thread, NULL,
+                              fanout_drain_thread, srv) != 0) {
+            if (srv->drain_client_id >= 0)
+                btelem_client_close(ctx, srv->drain_client_id);
+            free(srv->pool);
+            srv->pool = NULL;
+            goto fail;
+        }
     }
 
     if (pthread_create(&srv->accept_thread, NULL, accept_thread, srv) != 0) {
-        close(lsock);
-        pthread_mutex_destroy(&srv->clients_mu);
+        if (fanout) {
+            srv->running = 0;
+            pthread_join(srv->drain_thread, NULL);
+            btelem_client_close(ctx, srv->drain_client_id);
+            free(srv->pool);
+            srv->pool = NULL;
+        }
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    srv->running = 0;
+    close(lsock);
+    for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++)
+        pthread_cond_destroy(&srv->clients[i].cond);
+    pthread_mutex_destroy(&srv->clients_mu);
+    return -1;
+}
+
+int btelem_serve(struct btelem_server *srv, struct btelem_ctx *ctx,
+                 const char *ip, uint16_t port)
+{
+    return serve_start(srv, ctx, ip, port, 0);
+}
+
+int btelem_serve_fanout(struct btelem_server *srv, struct btelem_ctx *ctx,
+                        const char *ip, uint16_t port)
+{
+    return serve_start(srv, ctx, ip, port, 1);
+}
+
+int btelem_server_set_filter(struct btelem_server *srv, int slot,
+                             const uint16_t *ids, int count)
+{
+    if (!srv || !srv->fanout || slot < 0 || slot >= BTELEM_SERVE_MAX_CLIENTS)
+        return -1;
+
+    pthread_mutex_lock(&srv->clients_mu);
+    struct btelem_client_conn *conn = &srv->clients[slot];
+    if (!conn->active) {
+        pthread_mutex_unlock(&srv->clients_mu);
         return -1;
     }
+    memset(conn->filter, 0, sizeof(conn->filter));
+    conn->filter_active = (ids && count > 0);
+    for (int i = 0; conn->filter_active && i < count; i++) {
+        if (ids[i] < BTELEM_MAX_SCHEMA_ENTRIES)
+            conn->filter[ids[i]] = 1;
+    }
+    pthread_mutex_unlock(&srv->clients_mu);
+    return 0;
+}
 
+int btelem_server_client_stats(struct btelem_server *srv, int slot,
+                               struct btelem_serve_client_stats *out)
+{
+    if (!srv || !out || slot < 0 || slot >= BTELEM_SERVE_MAX_CLIENTS)
+        return -1;
+
+    pthread_mutex_lock(&srv->clients_mu);
+    struct btelem_client_conn *conn = &srv->clients[slot];
+    if (!conn->active) {
+        pthread_mutex_unlock(&srv->clients_mu);
+        return -1;
+    }
+    *out = conn->stats;
+    pthread_mutex_unlock(&srv->clients_mu);
+
+    out->mean_entries_per_packet = out->packets
+        ? (double)out->entries / (double)out->packets : 0.0;
     return 0;
 }
 
@@ -342,12 +1334,16 @@ void btelem_server_stop(struct btelem_server *server)
     /* Join accept thread */
     pthread_join(server->accept_thread, NULL);
 
+    if (server->fanout)
+        pthread_join(server->drain_thread, NULL);
+
     /* Close all client connections to unblock their write()/usleep() */
     pthread_mutex_lock(&server->clients_mu);
     for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++) {
         if (server->clients[i].active && server->clients[i].fd >= 0) {
             shutdown(server->clients[i].fd, SHUT_RDWR);
         }
+        pthread_cond_broadcast(&server->clients[i].cond);
     }
     pthread_mutex_unlock(&server->clients_mu);
 
@@ -367,5 +1363,19 @@ void btelem_server_stop(struct btelem_server *server)
         usleep(10000);
     }
 
+    if (server->fanout) {
+        btelem_client_close(server->ctx, server->drain_client_id);
+        /* A viewer thread still inside writev() may reference the pool */
+        int any_active = 0;
+        for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++)
+            any_active |= server->clients[i].active;
+        if (!any_active) {
+            free(server->pool);
+            server->pool = NULL;
+        }
+    }
+
+    for (int i = 0; i < BTELEM_SERVE_MAX_CLIENTS; i++)
+        pthread_cond_destroy(&server->clients[i].cond);
     pthread_mutex_destroy(&server->clients_mu);
 }
@@ -0,0 +1,712 @@
+#define _GNU_SOURCE /* accept4 */
+
+#include "btelem/btelem_serve_evloop.h"
+#include "btelem_serve_subs.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define EVLOOP_PKT_BUF        65536
+#define EVLOOP_QUEUE_DEPTH    16    /* packets queued per viewer */
+#define EVLOOP_POOL_PKTS      64    /* live packets before evicting backlog */
+#define EVLOOP_DRAIN_BURST    16    /* packets drained between epoll polls */
+#define EVLOOP_MAX_EVENTS     64
+#define EVLOOP_IDLE_POLL_MS   100   /* backstop for a missed wake-up */
+
+#define BTELEM_KEEPALIVE_IDLE_S    10
+#define BTELEM_KEEPALIVE_INTVL_S   5
+#define BTELEM_KEEPALIVE_PROBES    3
+
+/* epoll_event.data.u64 tags; viewer connections use EV_CONN + slot */
+enum { EV_LISTEN = 0, EV_WAKE = 1, EV_TIMER = 2, EV_CONN = 3 };
+
+struct btelem_evloop_pkt {
+    struct btelem_evloop_pkt *next;   /* free list link */
+    uint32_t refs;                    /* queued + in-progress references */
+    uint32_t len;
+    uint8_t  data[EVLOOP_PKT_BUF];
+};
+
+struct btelem_evloop_conn {
+    int      fd;
+    uint32_t slot;
+    int      want_out;               /* EPOLLOUT registered */
+
+    struct btelem_serve_subs *subs;  /* control messages, filter, decimation */
+    int      private_pkts;           /* needs its own copy of each packet */
+
+    /* Length-prefixed schema (or HELLO reply), sent before any packet */
+    uint8_t *schema;
+    size_t   schema_len;
+    size_t   schema_off;
+
+    struct btelem_evloop_pkt *queue[EVLOOP_QUEUE_DEPTH];
+    uint32_t q_head;
+    uint32_t q_count;
+    uint64_t dropped_pending;        /* lost to queue overflow, reported next */
+
+    /* Packet being written: [plen][hdr][table + payload from cur] */
+    struct btelem_evloop_pkt   *cur;
+    uint32_t                    cur_plen;
+    struct btelem_packet_header cur_hdr;
+    size_t                      cur_off;
+
+    uint64_t pkts;
+    uint64_t bytes;
+};
+
+/* --------------------------------------------------------------------------
+ * Packet pool (loop thread only, no locking)
+ * ----------------------------------------------------------------------- */
+
+static void pkt_release(struct btelem_evloop_server *srv, struct btelem_evloop_pkt *p)
+{
+    if (--p->refs == 0) {
+        p->next = srv->free_pkts;
+        srv->free_pkts = p;
+    }
+}
+
+static void conn_drop_head(struct btelem_evloop_server *srv,
+                           struct btelem_evloop_conn *c)
+{
+    struct btelem_evloop_pkt *p = c->queue[c->q_head];
+    const struct btelem_packet_header *ph =
+        (const struct btelem_packet_header *)p->data;
+
+    c->dropped_pending += (uint64_t)ph->entry_count + ph->dropped;
+    c->q_head = (c->q_head + 1) % EVLOOP_QUEUE_DEPTH;
+    c->q_count--;
+    pkt_release(srv, p);
+}
+
+static struct btelem_evloop_pkt *pkt_acquire(struct btelem_evloop_server *srv)
+{
+    /* Over the soft cap: shed the longest backlog until a packet frees up */
+    while (!srv->free_pkts && srv->live_pkts >= EVLOOP_POOL_PKTS) {
+        struct btelem_evloop_conn *slowest = NULL;
+        for (uint32_t i = 0; i < srv->opts.max_conns; i++) {
+            struct btelem_evloop_conn *c = srv->conns[i];
+            if (c && c->q_count > 0 && (!slowest || c->q_count > slowest->q_count))
+                slowest = c;
+        }
+        if (!slowest)
+            break;  /* all references are mid-write: grow instead */
+        conn_drop_head(srv, slowest);
+    }
+
+    struct btelem_evloop_pkt *p = srv->free_pkts;
+    if (p) {
+        srv->free_pkts = p->next;
+    } else {
+        p = (struct btelem_evloop_pkt *)malloc(sizeof(*p));
+        if (!p)
+            return NULL;
+        srv->live_pkts++;
+    }
+    p->next = NULL;
+    p->refs = 0;
+    p->len = 0;
+    return p;
+}
+
+/* --------------------------------------------------------------------------
+ * Connections
+ * ----------------------------------------------------------------------- */
+
+static void conn_want_out(struct btelem_evloop_server *srv,
+                          struct btelem_evloop_conn *c, int on)
+{
+    if (c->want_out == on)
+        return;
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0),
+        .data.u64 = EV_CONN + c->slot,
+    };
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = on;
+}
+
+static void conn_close(struct btelem_evloop_server *srv,
+                       struct btelem_evloop_conn *c, const char *why)
+{
+    fprintf(stderr, "btelem_evloop: viewer %u %s after %lu pkts / %lu bytes\n",
+            c->slot, why, (unsigned long)c->pkts, (unsigned long)c->bytes);
+
+    while (c->q_count > 0)
+        conn_drop_head(srv, c);
+    if (c->cur)
+        pkt_release(srv, c->cur);
+
+    close(c->fd);
+    free(c->schema);
+    free(c->subs);
+    srv->conns[c->slot] = NULL;
+    srv->conn_count--;
+    free(c);
+}
+
+/* Start writing the next queued packet with this viewer's drop count */
+static void conn_begin(struct btelem_evloop_conn *c)
+{
+    struct btelem_evloop_pkt *p = c->queue[c->q_head];
+    c->q_head = (c->q_head + 1) % EVLOOP_QUEUE_DEPTH;
+    c->q_count--;
+
+    memcpy(&c->cur_hdr, p->data, sizeof(c->cur_hdr));
+    uint64_t dropped = c->dropped_pending + c->cur_hdr.dropped;
+    c->cur_hdr.dropped = (dropped > UINT32_MAX) ? UINT32_MAX : (uint32_t)dropped;
+    c->dropped_pending = 0;
+
+    c->cur = p;
+    c->cur_plen = p->len;
+    c->cur_off = 0;
+}
+
+/* Write until the socket would block.  Returns -1 if the viewer is gone. */
+static int conn_flush(struct btelem_evloop_server *srv, struct btelem_evloop_conn *c)
+{
+    for (;;) {
+        struct iovec iov[3];
+        int n = 0;
+        size_t skip;
+
+        if (c->schema_off < c->schema_len) {
+            iov[0].iov_base = c->schema + c->schema_off;
+            iov[0].iov_len = c->schema_len - c->schema_off;
+            n = 1;
+        } else {
+            if (!c->cur) {
+                if (c->q_count == 0)
+                    break;
+                conn_begin(c);
+            }
+            const size_t hdr_len = sizeof(c->cur_hdr);
+            const struct { const void *base; size_t len; } seg[3] = {
+                { &c->cur_plen, 4 },
+                { &c->cur_hdr, hdr_len },
+                { c->cur->data + hdr_len, c->cur->len - hdr_len },
+            };
+            skip = c->cur_off;
+            for (int i = 0; i < 3; i++) {
+                if (skip >= seg[i].len) {
+                    skip -= seg[i].len;
+                    continue;
+                }
+                iov[n].iov_base = (uint8_t *)seg[i].base + skip;
+                iov[n].iov_len = seg[i].len - skip;
+                skip = 0;
+                n++;
+            }
+        }
+
+        /* sendmsg() rather than writev(): MSG_NOSIGNAL, no SIGPIPE */
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)n;
+        ssize_t w = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_want_out(srv, c, 1);
+                return 0;
+            }
+            return -1;
+        }
+
+        c->bytes += (uint64_t)w;
+        if (c->schema_off < c->schema_len) {
+            c->schema_off += (size_t)w;
+            continue;
+        }
+        c->cur_off += (size_t)w;
+        if (c->cur_off == 4 + (size_t)c->cur->len) {
+            pkt_release(srv, c->cur);
+            c->cur = NULL;
+            c->pkts++;
+        }
+    }
+
+    conn_want_out(srv, c, 0);
+    return 0;
+}
+
+/* Viewers with a filter, a rate limit or compression get private copies */
+static void conn_subs_changed(struct btelem_evloop_conn *c)
+{
+    c->private_pkts = c->subs->active || c->subs->rate_limited
+                   || c->subs->compress;
+}
+
+static void set_keepalive(int fd)
+{
+    /* Let the kernel notice half-open connections while we're idle */
+    int one = 1;
+    int idle = BTELEM_KEEPALIVE_IDLE_S;
+    int intvl = BTELEM_KEEPALIVE_INTVL_S;
+    int cnt = BTELEM_KEEPALIVE_PROBES;
+    setsockopt(fd, SOL_SOCKET,  SO_KEEPALIVE,  &one,   sizeof(one));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE,  &idle,  sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,   &cnt,   sizeof(cnt));
+    /* Packets are already batched; don't let Nagle add latency */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,   &one,   sizeof(one));
+}
+
+/* Same handshake as btelem_serve(), without waiting: a HELLO already
+ * queued gets the compact reply, anything else the fixed-size schema */
+static int conn_handshake(struct btelem_evloop_server *srv,
+                          struct btelem_evloop_conn *c, int fd)
+{
+    if (btelem_serve_subs_poll(c->subs, srv->ctx, fd) < 0)
+        return -1;
+    conn_subs_changed(c);
+
+    if (c->subs->hello) {
+        c->schema = btelem_serve_schema_hello(srv->ctx, c->subs->hello_hash,
+                                              &c->schema_len);
+        return c->schema ? 0 : -1;
+    }
+
+    int schema_size = btelem_schema_serialize(srv->ctx, NULL, 0);
+    if (schema_size <= 0)
+        return 0;
+    c->schema = (uint8_t *)malloc(4 + (size_t)schema_size);
+    if (!c->schema)
+        return -1;
+    uint32_t slen = (uint32_t)schema_size;
+    memcpy(c->schema, &slen, 4);
+    btelem_schema_serialize(srv->ctx, c->schema + 4, (size_t)schema_size);
+    c->schema_len = 4 + (size_t)schema_size;
+    return 0;
+}
+
+static void accept_all(struct btelem_evloop_server *srv)
+{
+    for (;;) {
+        int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;  /* EAGAIN: backlog empty */
+
+        uint32_t slot = 0;
+        while (slot < srv->opts.max_conns && srv->conns[slot])
+            slot++;
+        if (slot == srv->opts.max_conns) {
+            fprintf(stderr, "btelem_evloop: refusing viewer — all %u slots in use\n",
+                    srv->opts.max_conns);
+            close(fd);
+            continue;
+        }
+
+        struct btelem_evloop_conn *c =
+            (struct btelem_evloop_conn *)calloc(1, sizeof(*c));
+        if (c)
+            c->subs = (struct btelem_serve_subs *)calloc(1, sizeof(*c->subs));
+        if (!c || !c->subs || conn_handshake(srv, c, fd) < 0) {
+            if (c) {
+                free(c->subs);
+                free(c);
+            }
+            close(fd);
+            continue;
+        }
+
+        set_keepalive(fd);
+        c->fd = fd;
+        c->slot = slot;
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLRDHUP,
+            .data.u64 = EV_CONN + slot,
+        };
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            free(c->schema);
+            free(c->subs);
+            free(c);
+            close(fd);
+            continue;
+        }
+        srv->conns[slot] = c;
+        srv->conn_count++;
+        fprintf(stderr, "btelem_evloop: viewer %u connected (fd=%d, %u total)\n",
+                slot, fd, srv->conn_count);
+
+        if (conn_flush(srv, c) < 0)
+            conn_close(srv, c, "send failed");
+    }
+}
+
+/* Apply control messages; -1 on EOF or a malformed message */
+static int conn_readable(struct btelem_evloop_server *srv,
+                         struct btelem_evloop_conn *c)
+{
+    int sc = btelem_serve_subs_poll(c->subs, srv->ctx, c->fd);
+    conn_subs_changed(c);
+    return sc < 0 ? -1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Drain and publish
+ * ----------------------------------------------------------------------- */
+
+/* This viewer's copy of `p`: compacted to its filter and rate limits, then
+ * compressed if it asked.  NULL if nothing is left to send (or no memory:
+ * the entries count as dropped). */
+static struct btelem_evloop_pkt *conn_private(struct btelem_evloop_server *srv,
+                                              struct btelem_evloop_conn *c,
+                                              const struct btelem_evloop_pkt *p)
+{
+    struct btelem_serve_subs *s = c->subs;
+    struct btelem_evloop_pkt *q = pkt_acquire(srv);
+    struct btelem_evloop_pkt *z = s->compress ? pkt_acquire(srv) : NULL;
+    if (!q || (s->compress && !z)) {
+        const struct btelem_packet_header *ph =
+            (const struct btelem_packet_header *)p->data;
+        c->dropped_pending += (uint64_t)ph->entry_count + ph->dropped;
+        q = NULL;
+        goto out;
+    }
+
+    q->len = btelem_serve_subs_compact(s, s->active ? s->on : NULL,
+                                       p->data, p->len, q->data);
+    struct btelem_packet_header h;
+    memcpy(&h, q->data, sizeof(h));
+    if (h.entry_count == 0 && h.dropped == 0 && !(h.flags & BTELEM_PACKET_FLAG_CLOCK)
+        && c->dropped_pending == 0) {
+        q->refs = 1;
+        pkt_release(srv, q);
+        q = NULL;
+        goto out;
+    }
+    if (z) {
+        int zn = btelem_packet_compress(q->data, q->len, z->data, sizeof(z->data));
+        if (zn > 0) {
+            struct btelem_evloop_pkt *t = q;
+            q = z;
+            z = t;
+            q->len = (uint32_t)zn;
+        }
+    }
+
+out:
+    if (z) {
+        z->refs = 1;
+        pkt_release(srv, z);
+    }
+    return q;
+}
+
+static void publish(struct btelem_evloop_server *srv, struct btelem_evloop_pkt *p)
+{
+    /* Hold a reference so an immediate complete send can't free p mid-loop */
+    p->refs = 1;
+    for (uint32_t i = 0; i < srv->opts.max_conns; i++) {
+        struct btelem_evloop_conn *c = srv->conns[i];
+        if (!c)
+            continue;
+        struct btelem_evloop_pkt *mine = p;
+        if (c->private_pkts) {
+            mine = conn_private(srv, c, p);
+            if (!mine)
+                continue;
+        }
+        if (c->q_count == EVLOOP_QUEUE_DEPTH)
+            conn_drop_head(srv, c);
+        c->queue[(c->q_head + c->q_count) % EVLOOP_QUEUE_DEPTH] = mine;
+        c->q_count++;
+        mine->refs++;
+
+        /* Sockets already waiting for EPOLLOUT will be flushed by epoll */
+        if (!c->want_out && conn_flush(srv, c) < 0)
+            conn_close(srv, c, "send failed");
+    }
+
+    pkt_release(srv, p);
+}
+
+/* Drain up to EVLOOP_DRAIN_BURST packets.  Returns the number published. */
+static int drain_burst(struct btelem_evloop_server *srv)
+{
+    int published = 0;
+    while (published < EVLOOP_DRAIN_BURST) {
+        struct btelem_evloop_pkt *p = pkt_acquire(srv);
+        if (!p)
+            break;
+        int n = btelem_drain_packed(srv->ctx, srv->btelem_client_id,
+                                    p->data, sizeof(p->data));
+        if (n <= 0) {
+            p->refs = 1;
+            pkt_release(srv, p);
+            break;
+        }
+        p->len = (uint32_t)n;
+        publish(srv, p);
+        published++;
+    }
+    return published;
+}
+
+static void publish_clock(struct btelem_evloop_server *srv)
+{
+    struct btelem_clock clk;
+    if (btelem_clock_sample(srv->ctx, &clk) != 0)
+        return;
+    struct btelem_evloop_pkt *p = pkt_acquire(srv);
+    if (!p)
+        return;
+    int n = btelem_clock_packet(&clk, p->data, sizeof(p->data));
+    if (n <= 0) {
+        p->refs = 1;
+        pkt_release(srv, p);
+        return;
+    }
+    p->len = (uint32_t)n;
+    publish(srv, p);
+}
+
+static void timer_set(struct btelem_evloop_server *srv, uint32_t us)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = us / 1000000;
+    its.it_value.tv_nsec = (long)(us % 1000000) * 1000;
+    timerfd_settime(srv->timer_fd, 0, &its, NULL);
+}
+
+/* --------------------------------------------------------------------------
+ * Event loop
+ * ----------------------------------------------------------------------- */
+
+static void evloop_wake(void *user)
+{
+    struct btelem_evloop_server *srv = (struct btelem_evloop_server *)user;
+    uint64_t one = 1;
+    ssize_t n = write(srv->event_fd, &one, sizeof(one));
+    (void)n;  /* EAGAIN: counter saturated, the loop is being woken anyway */
+}
+
+static void *evloop_thread(void *arg)
+{
+    struct btelem_evloop_server *srv = (struct btelem_evloop_server *)arg;
+    struct btelem_ctx *ctx = srv->ctx;
+    struct epoll_event evs[EVLOOP_MAX_EVENTS];
+    int timer_armed = 0;
+
+    uint64_t total_pkts = 0;
+    struct timespec last_report;
+    clock_gettime(CLOCK_MONOTONIC, &last_report);
+
+    while (srv->running) {
+        /* Hold back until wake_threshold entries are pending; the timer
+         * flushes anything smaller once it has waited max_latency_us */
+        uint64_t pending = btelem_client_available(ctx, srv->btelem_client_id, NULL);
+        int drained = 0;
+        if (pending >= srv->opts.wake_threshold) {
+            drained = drain_burst(srv);
+            total_pkts += (uint64_t)drained;
+            if (timer_armed) {
+                timer_set(srv, 0);
+                timer_armed = 0;
+            }
+        }
+
+        int timeout = 0;
+        if (drained < EVLOOP_DRAIN_BURST) {
+            /* Caught up or held back: sleep until the producer wakes us.
+             * An empty ring arms at one entry so the first entry of the
+             * next batch starts the latency timer. */
+            pending = btelem_client_available(ctx, srv->btelem_client_id, NULL);
+            uint32_t threshold = pending ? srv->opts.wake_threshold : 1;
+            if (btelem_wake_arm(ctx, srv->btelem_client_id, threshold) != 1) {
+                if (pending && !timer_armed) {
+                    timer_set(srv, srv->opts.max_latency_us);
+                    timer_armed = 1;
+                }
+                timeout = EVLOOP_IDLE_POLL_MS;
+            }
+        }
+
+        int n = epoll_wait(srv->epoll_fd, evs, EVLOOP_MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = evs[i].data.u64;
+            uint64_t counter;
+
+            if (tag == EV_LISTEN) {
+                accept_all(srv);
+            } else if (tag == EV_WAKE) {
+                if (read(srv->event_fd, &counter, sizeof(counter)) < 0)
+                    counter = 0;
+            } else if (tag == EV_TIMER) {
+                if (read(srv->timer_fd, &counter, sizeof(counter)) < 0)
+                    counter = 0;
+                timer_armed = 0;
+                /* Flush whatever is pending, even below the threshold */
+                total_pkts += (uint64_t)drain_burst(srv);
+            } else {
+                struct btelem_evloop_conn *c = srv->conns[tag - EV_CONN];
+                if (!c)
+                    continue;  /* closed earlier in this batch */
+                if (evs[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                    conn_close(srv, c, "disconnected");
+                    continue;
+                }
+                if ((evs[i].events & EPOLLIN) && conn_readable(srv, c) < 0) {
+                    conn_close(srv, c, "disconnected");
+                    continue;
+                }
+                if ((evs[i].events & EPOLLOUT) && conn_flush(srv, c) < 0)
+                    conn_close(srv, c, "send failed");
+            }
+        }
+
+        /* Periodic status and clock refresh every 2 seconds */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (double)(now.tv_sec - last_report.tv_sec)
+                  + (double)(now.tv_nsec - last_report.tv_nsec) / 1e9;
+        if (dt >= 2.0) {
+            fprintf(stderr, "btelem_evloop: status: %lu pkts, %u viewers, "
+                    "%u pool pkts\n", (unsigned long)total_pkts,
+                    srv->conn_count, srv->live_pkts);
+            last_report = now;
+            publish_clock(srv);
+        }
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+ * Public API
+ * ----------------------------------------------------------------------- */
+
+static int epoll_add(int epfd, int fd, uint64_t tag)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = tag };
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void close_fds(struct btelem_evloop_server *srv)
+{
+    if (srv->listen_fd >= 0) close(srv->listen_fd);
+    if (srv->epoll_fd >= 0)  close(srv->epoll_fd);
+    if (srv->event_fd >= 0)  close(srv->event_fd);
+    if (srv->timer_fd >= 0)  close(srv->timer_fd);
+    srv->listen_fd = srv->epoll_fd = srv->event_fd = srv->timer_fd = -1;
+}
+
+int btelem_serve_evloop(struct btelem_evloop_server *srv, struct btelem_ctx *ctx,
+                        const char *ip, uint16_t port,
+                        const struct btelem_evloop_opts *opts)
+{
+    if (!srv || !ctx)
+        return -1;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->ctx = ctx;
+    if (opts)
+        srv->opts = *opts;
+    if (srv->opts.wake_threshold == 0)
+        srv->opts.wake_threshold = 1;
+    if (srv->opts.max_latency_us == 0)
+        srv->opts.max_latency_us = 1000;
+    if (srv->opts.max_conns == 0)
+        srv->opts.max_conns = BTELEM_EVLOOP_MAX_CONNS;
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    srv->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    srv->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (srv->listen_fd < 0 || srv->epoll_fd < 0 || srv->event_fd < 0
+        || srv->timer_fd < 0)
+        goto fail;
+
+    int opt = 1;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (ip)
+        inet_pton(AF_INET, ip, &addr.sin_addr);
+    else
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(srv->listen_fd, 64) < 0)
+        goto fail;
+
+    if (epoll_add(srv->epoll_fd, srv->listen_fd, EV_LISTEN) < 0
+        || epoll_add(srv->epoll_fd, srv->event_fd, EV_WAKE) < 0
+        || epoll_add(srv->epoll_fd, srv->timer_fd, EV_TIMER) < 0)
+        goto fail;
+
+    srv->conns = (struct btelem_evloop_conn **)calloc(srv->opts.max_conns,
+                                                      sizeof(*srv->conns));
+    if (!srv->conns)
+        goto fail;
+
+    srv->btelem_client_id = btelem_client_open(ctx, NULL, 0);
+    if (srv->btelem_client_id < 0)
+        goto fail;
+
+    btelem_wake_set(ctx, evloop_wake, srv);
+    srv->running = 1;
+    if (pthread_create(&srv->thread, NULL, evloop_thread, srv) != 0) {
+        srv->running = 0;
+        btelem_wake_set(ctx, NULL, NULL);
+        btelem_client_close(ctx, srv->btelem_client_id);
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    free(srv->conns);
+    srv->conns = NULL;
+    close_fds(srv);
+    return -1;
+}
+
+void btelem_evloop_server_stop(struct btelem_evloop_server *srv)
+{
+    if (!srv || !srv->running)
+        return;
+
+    srv->running = 0;
+    evloop_wake(srv);
+    pthread_join(srv->thread, NULL);
+
+    /* Unhook only after the loop stopped arming; this waits for producers
+     * still writing to event_fd, which close_fds() then may close */
+    btelem_wake_set(srv->ctx, NULL, NULL);
+
+    for (uint32_t i = 0; i < srv->opts.max_conns; i++) {
+        if (srv->conns[i])
+            conn_close(srv, srv->conns[i], "closed (server stopping)");
+    }
+    free(srv->conns);
+    srv->conns = NULL;
+
+    while (srv->free_pkts) {
+        struct btelem_evloop_pkt *p = srv->free_pkts;
+        srv->free_pkts = p->next;
+        free(p);
+    }
+    srv->live_pkts = 0;
+
+    btelem_client_close(srv->ctx, srv->btelem_client_id);
+    close_fds(srv);
+}
@@ -0,0 +1,50 @@
+#ifndef BTELEM_SERVE_SUBS_H
+#define BTELEM_SERVE_SUBS_H
+
+/*
+ * Viewer control messages, shared by btelem_serve.c and
+ * btelem_serve_evloop.c.  Private to the btelem_serve library.
+ */
+
+#include "btelem/btelem.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* One viewer's subscription state and control-message reassembly */
+struct btelem_serve_subs {
+    int      active;        /* 0 = every ID */
+    int      rate_limited;  /* some ID has an interval */
+    uint8_t  on[BTELEM_MAX_SCHEMA_ENTRIES];
+    uint64_t interval[BTELEM_MAX_SCHEMA_ENTRIES];   /* timestamp units */
+    uint64_t last[BTELEM_MAX_SCHEMA_ENTRIES];       /* last sent timestamp */
+
+    int      hello;         /* viewer sent HELLO */
+    uint64_t hello_hash;    /* compact schema hash it holds */
+    int      compress;      /* viewer sent COMPRESS */
+
+    uint32_t rx_msgs;       /* control messages applied */
+    uint32_t rx_len;
+    uint8_t  rx[4 + BTELEM_CTRL_MAX_SIZE];
+};
+
+/* Read whatever the viewer has sent without blocking and apply complete
+ * messages.  Returns 1 if the subscription changed, 0 if not, -1 if the
+ * peer closed the connection or sent a malformed message. */
+int btelem_serve_subs_poll(struct btelem_serve_subs *s, const struct btelem_ctx *ctx,
+                           int fd);
+
+/* Copy packet `src` to `dst` keeping only entries in `filter` (NULL = all)
+ * that pass decimation; payloads are repacked back to back.  `dst` may be
+ * `src`.  Returns the new packet length. */
+uint32_t btelem_serve_subs_compact(struct btelem_serve_subs *s,
+                                   const uint8_t *filter, const uint8_t *src,
+                                   uint32_t len, uint8_t *dst);
+
+/* Length-prefixed reply to HELLO: btelem_schema_hello, then the compact
+ * schema unless the viewer's cached copy (hash `have`) is current.  A
+ * cached copy carries a stale calibration, so a clock packet follows in
+ * that case.  Returns a malloc'd buffer of *len bytes, NULL on failure. */
+uint8_t *btelem_serve_schema_hello(struct btelem_ctx *ctx, uint64_t have,
+                                   size_t *len);
+
+#endif /* BTELEM_SERVE_SUBS_H */
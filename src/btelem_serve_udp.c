@@ -1,362 +1,819 @@
+#define _GNU_SOURCE  /* sendmmsg */
 #include "btelem/btelem_serve_udp.h"
 
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
-/* Maximum JSON datagram size.  PlotJuggler handles up to 64 KB UDP
- * payloads, but we cap to the largest entry we could reasonably
- * produce (all 16 fields × generous key+value text). */
-#define JSON_BUF_SIZE 4096
+#define UDP_MAX_PAYLOAD 65507   /* IPv4 UDP payload limit */
+#define UDP_TX_MAX      64      /* datagrams per sendmmsg() */
 
 /* --------------------------------------------------------------------------
- * JSON encoding helpers — write directly into a char buffer
+ * Datagram batching: queue up to UDP_TX_MAX datagrams, send with sendmmsg()
  * ----------------------------------------------------------------------- */
 
-struct json_buf {
-    char  *buf;
-    size_t cap;
-    size_t len;
-    int    first;  /* suppress leading comma on first field */
+#ifdef __linux__
+typedef struct mmsghdr udp_msg;
+#else
+typedef struct { struct msghdr msg_hdr; unsigned int msg_len; } udp_msg;
+#endif
+
+struct udp_tx {
+    struct btelem_udp_server      *srv;
+    struct sockaddr_in             dest_addr;
+    int                            count;
+    udp_msg                        msgs[UDP_TX_MAX];
+    struct iovec                   iov[UDP_TX_MAX][3];
+    struct btelem_packet_header    hdr[UDP_TX_MAX];
+    struct btelem_schema_frag_wire frag[UDP_TX_MAX];
+    uint64_t                       sent;
+    uint64_t                       errors;
 };
 
-static void jb_init(struct json_buf *j, char *buf, size_t cap)
+static void udp_tx_init(struct udp_tx *tx, struct btelem_udp_server *srv)
 {
-    j->buf   = buf;
-    j->cap   = cap;
-    j->len   = 0;
-    j->first = 1;
+    tx->srv = srv;
+    tx->dest_addr.sin_family = AF_INET;
+    tx->dest_addr.sin_port = htons(srv->dest_port);
+    inet_pton(AF_INET, srv->dest_ip, &tx->dest_addr.sin_addr);
 }
 
-static int jb_remaining(const struct json_buf *j)
+static void udp_tx_flush(struct udp_tx *tx)
 {
-    return (int)(j->cap - j->len);
+    int done = 0;
+#ifdef __linux__
+    while (done < tx->count) {
+        int n = sendmmsg(tx->srv->sock_fd, tx->msgs + done,
+                         (unsigned int)(tx->count - done), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            /* Skip the datagram that failed; its seq shows up as loss */
+            tx->errors++;
+            done++;
+            continue;
+        }
+        tx->sent += (uint64_t)n;
+        done += n;
+    }
+#else
+    for (; done < tx->count; done++) {
+        if (sendmsg(tx->srv->sock_fd, &tx->msgs[done].msg_hdr, 0) < 0)
+            tx->errors++;
+        else
+            tx->sent++;
+    }
+#endif
+    tx->count = 0;
 }
 
-static void jb_append(struct json_buf *j, const char *s, size_t n)
+/* Claim the next datagram slot (flushing if all are queued) and return its
+ * iovec array for the caller to fill with `iov_count` spans.  The spans must
+ * stay valid until the next udp_tx_flush(). */
+static struct iovec *udp_tx_next(struct udp_tx *tx, int iov_count)
 {
-    if (j->len + n > j->cap)
-        n = j->cap - j->len;
-    memcpy(j->buf + j->len, s, n);
-    j->len += n;
+    if (tx->count == UDP_TX_MAX)
+        udp_tx_flush(tx);
+
+    int k = tx->count++;
+    udp_msg *m = &tx->msgs[k];
+    memset(m, 0, sizeof(*m));
+    m->msg_hdr.msg_name = &tx->dest_addr;
+    m->msg_hdr.msg_namelen = sizeof(tx->dest_addr);
+    m->msg_hdr.msg_iov = tx->iov[k];
+    m->msg_hdr.msg_iovlen = (size_t)iov_count;
+    return tx->iov[k];
 }
 
-/* Write the comma separator between fields (skipped for first field) */
-static void jb_sep(struct json_buf *j)
+/* --------------------------------------------------------------------------
+ * Number formatting
+ *
+ * Replacements for snprintf("%lu" / "%ld" / "%.8g") on the per-field path.
+ * Each writes at most JSON_NUM_MAX bytes and returns the end pointer.
+ * ----------------------------------------------------------------------- */
+
+#define JSON_NUM_MAX 24
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+static char *fmt_u64(char *d, uint64_t v)
 {
-    if (j->first) {
-        j->first = 0;
-        return;
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned r = (unsigned)(v % 100);
+        v /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + 2 * r, 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + 2 * v, 2);
+    } else {
+        *--p = (char)('0' + v);
     }
-    jb_append(j, ",", 1);
+    size_t n = (size_t)(tmp + sizeof(tmp) - p);
+    memcpy(d, p, n);
+    return d + n;
 }
 
-/* "key":value  where value is already formatted */
-static void jb_field_raw(struct json_buf *j, const char *key, size_t key_len,
-                         const char *val, size_t val_len)
+static char *fmt_i64(char *d, int64_t v)
 {
-    jb_sep(j);
-    jb_append(j, "\"", 1);
-    jb_append(j, key, key_len);
-    jb_append(j, "\":", 2);
-    jb_append(j, val, val_len);
+    if (v < 0) {
+        *d++ = '-';
+        return fmt_u64(d, (uint64_t)0 - (uint64_t)v);
+    }
+    return fmt_u64(d, (uint64_t)v);
 }
 
-/* Emit a float64 field */
-static void jb_field_f64(struct json_buf *j, const char *key, double v)
+static const double pow10_tab[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* v * 10^k; exact powers up to 1e22, so one rounding for |k| <= 22 */
+static double scale10(double v, int k)
 {
-    char tmp[32];
-    int n = snprintf(tmp, sizeof(tmp), "%.8g", v);
-    if (n > 0)
-        jb_field_raw(j, key, strlen(key), tmp, (size_t)n);
+    while (k > 22) {
+        v *= 1e22;
+        k -= 22;
+    }
+    while (k < -22) {
+        v /= 1e22;
+        k += 22;
+    }
+    return k >= 0 ? v * pow10_tab[k] : v / pow10_tab[-k];
 }
 
-/* Emit an int64 field */
-static void jb_field_i64(struct json_buf *j, const char *key, int64_t v)
+/* round(v * 10^k), ties to even as printf does */
+static uint64_t round_scaled(double v, int k)
 {
-    char tmp[24];
-    int n = snprintf(tmp, sizeof(tmp), "%ld", (long)v);
-    if (n > 0)
-        jb_field_raw(j, key, strlen(key), tmp, (size_t)n);
+    double x = scale10(v, k);
+    double f = floor(x);
+    uint64_t m = (uint64_t)f;
+    double r = x - f;
+    if (r > 0.5 || (r == 0.5 && (m & 1)))
+        m++;
+    return m;
 }
 
-/* Emit a uint64 field */
-static void jb_field_u64(struct json_buf *j, const char *key, uint64_t v)
+/* Same text as "%.8g"; NaN and infinities, which JSON cannot carry,
+ * become null */
+static char *fmt_f64(char *d, double v)
 {
-    char tmp[24];
-    int n = snprintf(tmp, sizeof(tmp), "%lu", (unsigned long)v);
-    if (n > 0)
-        jb_field_raw(j, key, strlen(key), tmp, (size_t)n);
+    if (!isfinite(v)) {
+        memcpy(d, "null", 4);
+        return d + 4;
+    }
+    if (v == 0.0) {
+        *d++ = '0';
+        return d;
+    }
+    if (v < 0) {
+        *d++ = '-';
+        v = -v;
+    }
+
+    /* m = 8 significant digits, v ~= m * 10^(e - 7) */
+    int e = (int)floor(log10(v));
+    uint64_t m = round_scaled(v, 7 - e);
+    if (m >= 100000000u) {
+        e++;
+        m = round_scaled(v, 7 - e);
+    } else if (m < 10000000u) {
+        e--;
+        m = round_scaled(v, 7 - e);
+    }
+    if (m >= 100000000u) {      /* rounded up to the next decade */
+        m /= 10;
+        e++;
+    }
+
+    char dig[8];
+    for (int i = 7; i >= 0; i--) {
+        dig[i] = (char)('0' + (int)(m % 10));
+        m /= 10;
+    }
+    int nd = 8;
+    while (nd > 1 && dig[nd - 1] == '0')
+        nd--;
+
+    if (e < -4 || e >= 8) {
+        *d++ = dig[0];
+        if (nd > 1) {
+            *d++ = '.';
+            memcpy(d, dig + 1, (size_t)nd - 1);
+            d += nd - 1;
+        }
+        *d++ = 'e';
+        *d++ = e < 0 ? '-' : '+';
+        int ae = e < 0 ? -e : e;
+        if (ae >= 100)
+            *d++ = (char)('0' + ae / 100);
+        memcpy(d, digit_pairs + 2 * (ae % 100), 2);
+        return d + 2;
+    }
+    if (e < 0) {
+        *d++ = '0';
+        *d++ = '.';
+        for (int i = -1; i > e; i--)
+            *d++ = '0';
+        memcpy(d, dig, (size_t)nd);
+        return d + nd;
+    }
+    int ip = e + 1;             /* integer digits, 1..8 */
+    if (nd <= ip) {
+        memcpy(d, dig, (size_t)nd);
+        d += nd;
+        for (int i = nd; i < ip; i++)
+            *d++ = '0';
+        return d;
+    }
+    memcpy(d, dig, (size_t)ip);
+    d += ip;
+    *d++ = '.';
+    memcpy(d, dig + ip, (size_t)(nd - ip));
+    return d + (nd - ip);
 }
 
 /* --------------------------------------------------------------------------
- * Field decoding — read a typed value from a raw payload
+ * JSON encode plan
  *
- * Produces one or more JSON fields per schema field:
- *   scalar  → "entry.field": value
- *   array   → "entry.field_0": v0, "entry.field_1": v1, ...
- *   enum    → "entry.field": numeric_value
- *   bitfield→ "entry.field.bit0": v, "entry.field.bit1": v, ...
+ * Built once per schema ID when the server starts.  Each op writes one JSON
+ * member: a pre-rendered `,"entry.field":` key followed by the value read
+ * from the payload by a per-type formatter.  Keys are dot-separated paths
+ * for PlotJuggler's tree view:
+ *   scalar    → "entry.field": value
+ *   array     → "entry.field.0": v0, "entry.field.1": v1, ...
+ *   enum      → "entry.field": numeric_value
+ *   bitfield  → "entry.field.bit0": v, "entry.field.bit1": v, ...
+ * Byte blobs and strings are skipped (not plottable).
  * ----------------------------------------------------------------------- */
 
-/* Build a dot-separated key into a stack buffer.  Returns length. */
-static int make_key(char *dst, size_t dst_sz,
+struct json_op;
+typedef char *(*json_fmt_fn)(char *d, const uint8_t *p, const struct json_op *op);
+
+struct json_op {
+    json_fmt_fn fmt;
+    uint32_t    key;        /* offset into the plan's key text */
+    uint16_t    key_len;
+    uint16_t    offset;     /* payload byte offset */
+    uint8_t     size;       /* bitfield storage bytes */
+    uint8_t     shift;      /* bitfield sub-field */
+    uint8_t     width;      /* 0 = whole value */
+};
+
+struct json_plan {
+    struct json_op *ops;    /* NULL = unknown ID, entry skipped */
+    uint32_t        op_count;
+    uint32_t        max_len;    /* longest possible object incl. braces + '\n' */
+};
+
+struct json_encoder {
+    struct json_plan plans[BTELEM_MAX_SCHEMA_ENTRIES];
+    char            *keys;
+    size_t           keys_len;
+    size_t           keys_cap;
+    uint32_t         max_len;   /* over all plans */
+};
+
+static char *fmt_u8(char *d, const uint8_t *p, const struct json_op *op)
+{
+    return fmt_u64(d, p[op->offset]);
+}
+
+static char *fmt_i8(char *d, const uint8_t *p, const struct json_op *op)
+{
+    return fmt_i64(d, (int8_t)p[op->offset]);
+}
+
+static char *fmt_bool(char *d, const uint8_t *p, const struct json_op *op)
+{
+    if (p[op->offset]) {
+        memcpy(d, "true", 4);
+        return d + 4;
+    }
+    memcpy(d, "false", 5);
+    return d + 5;
+}
+
+#define JSON_FMT_INT(name, ctype, fmt)                                        \
+    static char *name(char *d, const uint8_t *p, const struct json_op *op)    \
+    {                                                                         \
+        ctype v;                                                              \
+        memcpy(&v, p + op->offset, sizeof(v));                                \
+        return fmt(d, v);                                                     \
+    }
+
+JSON_FMT_INT(fmt_u16, uint16_t, fmt_u64)
+JSON_FMT_INT(fmt_i16, int16_t,  fmt_i64)
+JSON_FMT_INT(fmt_u32, uint32_t, fmt_u64)
+JSON_FMT_INT(fmt_i32, int32_t,  fmt_i64)
+JSON_FMT_INT(fmt_u64v, uint64_t, fmt_u64)
+JSON_FMT_INT(fmt_i64v, int64_t,  fmt_i64)
+JSON_FMT_INT(fmt_f64v, double,   fmt_f64)
+
+static char *fmt_f32(char *d, const uint8_t *p, const struct json_op *op)
+{
+    float v;
+    memcpy(&v, p + op->offset, sizeof(v));
+    return fmt_f64(d, (double)v);
+}
+
+static char *fmt_bits(char *d, const uint8_t *p, const struct json_op *op)
+{
+    uint32_t raw = 0;
+    if (op->size == 1)
+        raw = p[op->offset];
+    else if (op->size == 2 || op->size == 4)
+        memcpy(&raw, p + op->offset, op->size);   /* little-endian host */
+    if (op->width)
+        raw = (raw >> op->shift) & (uint32_t)((1ull << op->width) - 1);
+    return fmt_u64(d, raw);
+}
+
+/* Append `,"entry.field[.suffix]":` to the key text */
+static int plan_key(struct json_encoder *enc, struct json_op *op,
                     const char *entry, const char *field, const char *suffix)
 {
-    if (suffix)
-        return snprintf(dst, dst_sz, "%s.%s.%s", entry, field, suffix);
-    else
-        return snprintf(dst, dst_sz, "%s.%s", entry, field);
-}
-
-static void encode_field(struct json_buf *j,
-                         const char *entry_name,
-                         const struct btelem_field_def *f,
-                         const uint8_t *payload,
-                         int little_endian)
-{
-    char key[192];
-    const char *prefix = little_endian ? "<" : ">";
-    (void)prefix;
-
-    /* For arrays, append _N suffix */
-    int count = f->count > 0 ? f->count : 1;
-
-    for (int ai = 0; ai < count; ai++) {
-        size_t elem_size;
-        size_t offset;
-
-        if (f->type == BTELEM_BITFIELD) {
-            /* Bitfield: decode the raw integer, then explode sub-fields */
-            uint32_t raw = 0;
-            if (f->size == 1)
-                raw = payload[f->offset];
-            else if (f->size == 2)
-                memcpy(&raw, payload + f->offset, 2);
-            else if (f->size == 4)
-                memcpy(&raw, payload + f->offset, 4);
-
-            if (f->bitfield_def) {
-                for (uint8_t bi = 0; bi < f->bitfield_def->bit_count; bi++) {
+    size_t need = strlen(entry) + strlen(field) + (suffix ? strlen(suffix) + 1 : 0) + 6;
+    if (enc->keys_len + need > enc->keys_cap) {
+        size_t cap = enc->keys_cap ? enc->keys_cap * 2 : 4096;
+        while (cap < enc->keys_len + need)
+            cap *= 2;
+        char *k = (char *)realloc(enc->keys, cap);
+        if (!k)
+            return -1;
+        enc->keys = k;
+        enc->keys_cap = cap;
+    }
+    int n = suffix
+        ? snprintf(enc->keys + enc->keys_len, need, ",\"%s.%s.%s\":", entry, field, suffix)
+        : snprintf(enc->keys + enc->keys_len, need, ",\"%s.%s\":", entry, field);
+    op->key = (uint32_t)enc->keys_len;
+    op->key_len = (uint16_t)n;
+    enc->keys_len += (size_t)n;
+    return 0;
+}
+
+/* Formatter and element size for a plain (non-bitfield) field type */
+static json_fmt_fn plan_fmt(uint8_t type, size_t *elem_size)
+{
+    switch (type) {
+    case BTELEM_U8:  case BTELEM_ENUM: *elem_size = 1; return fmt_u8;
+    case BTELEM_I8:   *elem_size = 1; return fmt_i8;
+    case BTELEM_BOOL: *elem_size = 1; return fmt_bool;
+    case BTELEM_U16:  *elem_size = 2; return fmt_u16;
+    case BTELEM_I16:  *elem_size = 2; return fmt_i16;
+    case BTELEM_U32:  *elem_size = 4; return fmt_u32;
+    case BTELEM_I32:  *elem_size = 4; return fmt_i32;
+    case BTELEM_F32:  *elem_size = 4; return fmt_f32;
+    case BTELEM_U64:  *elem_size = 8; return fmt_u64v;
+    case BTELEM_I64:  *elem_size = 8; return fmt_i64v;
+    case BTELEM_F64:  *elem_size = 8; return fmt_f64v;
+    default:          return NULL;   /* bytes, strings: not plottable */
+    }
+}
+
+/* Ops one field expands to (upper bound, for allocation) */
+static uint32_t plan_field_ops(const struct btelem_field_def *f)
+{
+    if (f->type == BTELEM_BITFIELD)
+        return f->bitfield_def ? f->bitfield_def->bit_count : 1;
+    return f->count > 0 ? f->count : 1;
+}
+
+static void json_encoder_free(struct json_encoder *enc)
+{
+    for (int i = 0; i < BTELEM_MAX_SCHEMA_ENTRIES; i++)
+        free(enc->plans[i].ops);
+    free(enc->keys);
+    free(enc);
+}
+
+static struct json_encoder *json_encoder_build(const struct btelem_ctx *ctx)
+{
+    struct json_encoder *enc = (struct json_encoder *)calloc(1, sizeof(*enc));
+    if (!enc)
+        return NULL;
+
+    for (uint16_t id = 0; id < ctx->schema_count && id < BTELEM_MAX_SCHEMA_ENTRIES; id++) {
+        const struct btelem_schema_entry *se = ctx->schema[id];
+        if (!se)
+            continue;
+        uint16_t fc = se->field_count < BTELEM_MAX_FIELDS
+                    ? se->field_count : BTELEM_MAX_FIELDS;
+
+        uint32_t cap = 0;
+        for (uint16_t fi = 0; fi < fc; fi++)
+            cap += plan_field_ops(&se->fields[fi]);
+        struct json_plan *plan = &enc->plans[id];
+        plan->ops = (struct json_op *)calloc(cap ? cap : 1, sizeof(struct json_op));
+        if (!plan->ops)
+            goto fail;
+
+        /* {"timestamp":<sec>.<9 digits> ... }\n */
+        uint32_t len = (uint32_t)sizeof("{\"timestamp\":") - 1 + 20 + 1 + 9 + 2;
+        for (uint16_t fi = 0; fi < fc; fi++) {
+            const struct btelem_field_def *f = &se->fields[fi];
+            struct json_op op = { .offset = f->offset };
+
+            if (f->type == BTELEM_BITFIELD) {
+                op.fmt = fmt_bits;
+                op.size = (uint8_t)f->size;
+                uint8_t bits = f->bitfield_def ? f->bitfield_def->bit_count : 0;
+                if (!f->bitfield_def) {
+                    if (plan_key(enc, &op, se->name, f->name, NULL) < 0)
+                        goto fail;
+                    plan->ops[plan->op_count++] = op;
+                    len += op.key_len + JSON_NUM_MAX;
+                }
+                for (uint8_t bi = 0; bi < bits; bi++) {
                     const struct btelem_bit_def *bd = &f->bitfield_def->bits[bi];
-                    uint32_t mask = (1u << bd->width) - 1;
-                    uint32_t val  = (raw >> bd->start) & mask;
-                    make_key(key, sizeof(key), entry_name, f->name, bd->name);
-                    jb_field_u64(j, key, val);
+                    op.shift = bd->start;
+                    op.width = bd->width;
+                    if (plan_key(enc, &op, se->name, f->name, bd->name) < 0)
+                        goto fail;
+                    plan->ops[plan->op_count++] = op;
+                    len += op.key_len + JSON_NUM_MAX;
                 }
-            } else {
-                make_key(key, sizeof(key), entry_name, f->name, NULL);
-                jb_field_u64(j, key, raw);
+                continue;
             }
-            return;
-        }
 
-        if (f->type == BTELEM_BYTES) {
-            /* Skip raw byte blobs — not plottable */
-            return;
+            size_t elem_size;
+            op.fmt = plan_fmt(f->type, &elem_size);
+            if (!op.fmt)
+                continue;
+            int count = f->count > 0 ? f->count : 1;
+            for (int ai = 0; ai < count; ai++) {
+                char suffix[12];
+                snprintf(suffix, sizeof(suffix), "%d", ai);
+                op.offset = (uint16_t)(f->offset + (size_t)ai * elem_size);
+                if (plan_key(enc, &op, se->name, f->name, count > 1 ? suffix : NULL) < 0)
+                    goto fail;
+                plan->ops[plan->op_count++] = op;
+                len += op.key_len + JSON_NUM_MAX;
+            }
         }
+        plan->max_len = len;
+        if (len > enc->max_len)
+            enc->max_len = len;
+    }
+    return enc;
 
-        /* Compute element size and offset for scalar/array fields */
-        switch (f->type) {
-        case BTELEM_U8:  case BTELEM_I8:  case BTELEM_BOOL: case BTELEM_ENUM:
-            elem_size = 1; break;
-        case BTELEM_U16: case BTELEM_I16:
-            elem_size = 2; break;
-        case BTELEM_U32: case BTELEM_I32: case BTELEM_F32:
-            elem_size = 4; break;
-        case BTELEM_U64: case BTELEM_I64: case BTELEM_F64:
-            elem_size = 8; break;
-        default:
-            return;
-        }
-        offset = f->offset + ai * elem_size;
+fail:
+    json_encoder_free(enc);
+    return NULL;
+}
 
-        /* Build key */
-        if (count > 1) {
-            char suffix[12];
-            snprintf(suffix, sizeof(suffix), "%d", ai);
-            make_key(key, sizeof(key), entry_name, f->name, suffix);
-        } else {
-            make_key(key, sizeof(key), entry_name, f->name, NULL);
-        }
+/* Encode one entry as `{...}\n` at d (room for plan->max_len bytes).
+ * clk converts tick timestamps to nanoseconds.  Returns the end pointer,
+ * or NULL for an unknown ID. */
+static char *json_encode(const struct json_encoder *enc,
+                         const struct btelem_clock *clk,
+                         const struct btelem_entry *entry, char *d)
+{
+    if (entry->id >= BTELEM_MAX_SCHEMA_ENTRIES)
+        return NULL;
+    const struct json_plan *plan = &enc->plans[entry->id];
+    if (!plan->ops)
+        return NULL;
+
+    /* Timestamp in seconds, exact to the nanosecond */
+    static const char ts_key[] = "{\"timestamp\":";
+    memcpy(d, ts_key, sizeof(ts_key) - 1);
+    d += sizeof(ts_key) - 1;
+    uint64_t t = btelem_clock_ns(clk, entry->timestamp);
+    d = fmt_u64(d, t / 1000000000u);
+    *d++ = '.';
+    uint32_t ns = (uint32_t)(t % 1000000000u);
+    for (int i = 8; i >= 0; i--) {
+        d[i] = (char)('0' + ns % 10);
+        ns /= 10;
+    }
+    d += 9;
 
-        /* Decode value and emit */
-        switch (f->type) {
-        case BTELEM_F32: {
-            float v;
-            memcpy(&v, payload + offset, 4);
-            jb_field_f64(j, key, (double)v);
-            break;
-        }
-        case BTELEM_F64: {
-            double v;
-            memcpy(&v, payload + offset, 8);
-            jb_field_f64(j, key, v);
-            break;
-        }
-        case BTELEM_U8: case BTELEM_ENUM: {
-            jb_field_u64(j, key, payload[offset]);
-            break;
-        }
-        case BTELEM_I8: {
-            jb_field_i64(j, key, (int8_t)payload[offset]);
-            break;
-        }
-        case BTELEM_BOOL: {
-            const char *bv = payload[offset] ? "true" : "false";
-            jb_sep(j);
-            jb_append(j, "\"", 1);
-            jb_append(j, key, strlen(key));
-            jb_append(j, "\":", 2);
-            jb_append(j, bv, strlen(bv));
-            break;
-        }
-        case BTELEM_U16: {
-            uint16_t v;
-            memcpy(&v, payload + offset, 2);
-            jb_field_u64(j, key, v);
-            break;
-        }
-        case BTELEM_I16: {
-            int16_t v;
-            memcpy(&v, payload + offset, 2);
-            jb_field_i64(j, key, v);
-            break;
-        }
-        case BTELEM_U32: {
-            uint32_t v;
-            memcpy(&v, payload + offset, 4);
-            jb_field_u64(j, key, v);
-            break;
-        }
-        case BTELEM_I32: {
-            int32_t v;
-            memcpy(&v, payload + offset, 4);
-            jb_field_i64(j, key, v);
-            break;
-        }
-        case BTELEM_U64: {
-            uint64_t v;
-            memcpy(&v, payload + offset, 8);
-            jb_field_u64(j, key, v);
-            break;
-        }
-        case BTELEM_I64: {
-            int64_t v;
-            memcpy(&v, payload + offset, 8);
-            jb_field_i64(j, key, v);
-            break;
-        }
-        default:
-            break;
-        }
+    const struct json_op *op = plan->ops;
+    for (uint32_t i = 0; i < plan->op_count; i++, op++) {
+        memcpy(d, enc->keys + op->key, op->key_len);
+        d = op->fmt(d + op->key_len, entry->payload, op);
     }
+    *d++ = '}';
+    *d++ = '\n';
+    return d;
 }
 
 /* --------------------------------------------------------------------------
- * Drain callback — encodes one entry as JSON and sends as UDP datagram
+ * JSON drain thread
+ *
+ * Objects are encoded back to back into an arena.  Each datagram is a run
+ * of whole objects: one per datagram by default (what PlotJuggler expects),
+ * or as many as fit in max_datagram when coalescing.
  * ----------------------------------------------------------------------- */
 
-struct udp_emit_ctx {
-    struct btelem_udp_server *srv;
-    struct sockaddr_in        dest_addr;
-    char                      json_buf[JSON_BUF_SIZE];
-    uint64_t                  sent;
-    uint64_t                  errors;
+#define JSON_ARENA_SIZE (256 * 1024)
+
+struct udp_json_ctx {
+    struct udp_tx               tx;
+    const struct json_encoder  *enc;
+    struct btelem_clock         clock;  /* tick -> ns, refreshed periodically */
+    uint32_t                    limit;  /* 0 = one object per datagram */
+    char                       *arena;
+    size_t                      arena_size;
+    size_t                      cur;    /* start of the open datagram */
+    size_t                      used;
 };
 
+static void json_close_datagram(struct udp_json_ctx *jc)
+{
+    if (jc->used == jc->cur)
+        return;
+    struct iovec *iov = udp_tx_next(&jc->tx, 1);
+    iov[0].iov_base = jc->arena + jc->cur;
+    iov[0].iov_len = jc->used - jc->cur;
+    jc->cur = jc->used;
+}
+
+static void json_flush(struct udp_json_ctx *jc)
+{
+    json_close_datagram(jc);
+    udp_tx_flush(&jc->tx);
+    jc->cur = jc->used = 0;
+}
+
 static int udp_emit(const struct btelem_entry *entry, void *user)
 {
-    struct udp_emit_ctx *uc = (struct udp_emit_ctx *)user;
-    struct btelem_ctx *ctx = uc->srv->ctx;
+    struct udp_json_ctx *jc = (struct udp_json_ctx *)user;
 
-    const struct btelem_schema_entry *se = NULL;
-    if (entry->id < ctx->schema_count)
-        se = ctx->schema[entry->id];
-    if (!se)
-        return 0;  /* unknown entry — skip */
+    if (jc->arena_size - jc->used < jc->enc->max_len)
+        json_flush(jc);
 
-    struct json_buf j;
-    jb_init(&j, uc->json_buf, sizeof(uc->json_buf) - 2);
+    char *start = jc->arena + jc->used;
+    char *end = json_encode(jc->enc, &jc->clock, entry, start);
+    if (!end)
+        return 0;  /* unknown entry — skip */
+    size_t len = (size_t)(end - start);
 
-    jb_append(&j, "{", 1);
+    if (jc->limit && jc->used > jc->cur && jc->used + len - jc->cur > jc->limit)
+        json_close_datagram(jc);
+    jc->used += len;
+    if (!jc->limit)
+        json_close_datagram(jc);
+    return 0;
+}
 
-    /* Timestamp in seconds (float64) */
-    jb_field_f64(&j, "timestamp", (double)entry->timestamp / 1e9);
+static void *udp_drain_thread(void *arg)
+{
+    struct btelem_udp_server *srv = (struct btelem_udp_server *)arg;
 
-    /* Decode all fields */
-    int little_endian = (ctx->endianness == 0);
-    uint16_t fc = se->field_count < BTELEM_MAX_FIELDS
-                ? se->field_count : BTELEM_MAX_FIELDS;
-    for (uint16_t fi = 0; fi < fc; fi++) {
-        encode_field(&j, se->name, &se->fields[fi],
-                     entry->payload, little_endian);
+    struct udp_json_ctx *jc = (struct udp_json_ctx *)calloc(1, sizeof(*jc));
+    struct json_encoder *enc = json_encoder_build(srv->ctx);
+    if (!jc || !enc) {
+        fprintf(stderr, "btelem_serve_udp: JSON plan setup failed\n");
+        goto done;
     }
+    jc->enc = enc;
+    jc->clock = srv->ctx->clock;
+    jc->limit = srv->max_datagram;
+    jc->arena_size = JSON_ARENA_SIZE > 4 * (size_t)enc->max_len
+                   ? JSON_ARENA_SIZE : 4 * (size_t)enc->max_len;
+    jc->arena = (char *)malloc(jc->arena_size);
+    if (!jc->arena) {
+        fprintf(stderr, "btelem_serve_udp: JSON plan setup failed\n");
+        goto done;
+    }
+    udp_tx_init(&jc->tx, srv);
 
-    jb_append(&j, "}", 1);
-    jb_append(&j, "\n", 1);
-
-    ssize_t n = sendto(uc->srv->sock_fd, uc->json_buf, j.len, 0,
-                       (struct sockaddr *)&uc->dest_addr,
-                       sizeof(uc->dest_addr));
-    if (n < 0)
-        uc->errors++;
+    if (jc->limit)
+        fprintf(stderr, "btelem_serve_udp: streaming JSON to %s:%u "
+                "(up to %u bytes per datagram)\n",
+                srv->dest_ip, srv->dest_port, jc->limit);
     else
-        uc->sent++;
+        fprintf(stderr, "btelem_serve_udp: streaming JSON to %s:%u\n",
+                srv->dest_ip, srv->dest_port);
 
-    return 0;
+    struct timespec last_report;
+    clock_gettime(CLOCK_MONOTONIC, &last_report);
+    uint64_t last_sent = 0;
+
+    while (srv->running) {
+        int n = btelem_drain(srv->ctx, srv->btelem_client_id, udp_emit, jc);
+        json_flush(jc);
+
+        if (n <= 0)
+            usleep(1000);
+
+        /* Periodic status every 5 seconds */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (double)(now.tv_sec - last_report.tv_sec)
+                  + (double)(now.tv_nsec - last_report.tv_nsec) / 1e9;
+        if (dt >= 5.0) {
+            uint64_t delta = jc->tx.sent - last_sent;
+            fprintf(stderr, "btelem_serve_udp: %lu datagrams sent (+%lu), "
+                    "%lu errors\n",
+                    (unsigned long)jc->tx.sent, (unsigned long)delta,
+                    (unsigned long)jc->tx.errors);
+            last_report = now;
+            last_sent = jc->tx.sent;
+            btelem_clock_sample(srv->ctx, &jc->clock);
+        }
+    }
+
+    fprintf(stderr, "btelem_serve_udp: stopped (%lu total datagrams)\n",
+            (unsigned long)jc->tx.sent);
+
+done:
+    if (enc)
+        json_encoder_free(enc);
+    if (jc)
+        free(jc->arena);
+    free(jc);
+    return NULL;
 }
 
 /* --------------------------------------------------------------------------
- * Drain thread
+ * Binary mode: packed batches split into datagrams
+ *
+ * One btelem_drain_packed() batch is cut into runs of entries that fit a
+ * datagram.  Payloads are packed in entry order, so each run's payload is
+ * one contiguous span; its table entries are rebased in place and the
+ * datagram is gathered from [own header][table run][payload span].
  * ----------------------------------------------------------------------- */
 
-static void *udp_drain_thread(void *arg)
+#define UDP_BATCH_BUF   65536
+
+/* Queue one datagram: header, then up to two borrowed spans */
+static void udp_tx_push(struct udp_tx *tx, uint16_t entry_count, uint16_t flags,
+                        uint32_t payload_size, uint32_t dropped,
+                        const void *a, size_t a_len, const void *b, size_t b_len)
+{
+    if (tx->count == UDP_TX_MAX)
+        udp_tx_flush(tx);
+
+    struct btelem_packet_header *h = &tx->hdr[tx->count];
+    h->entry_count = entry_count;
+    h->flags = flags;
+    h->payload_size = payload_size;
+    h->dropped = dropped;
+    h->_reserved = tx->srv->seq++;
+
+    struct iovec *iov = udp_tx_next(tx, 1 + (a_len != 0) + (b_len != 0));
+    int n = 0;
+    iov[n].iov_base = h;
+    iov[n++].iov_len = sizeof(*h);
+    if (a_len) {
+        iov[n].iov_base = (void *)a;
+        iov[n++].iov_len = a_len;
+    }
+    if (b_len) {
+        iov[n].iov_base = (void *)b;
+        iov[n++].iov_len = b_len;
+    }
+}
+
+/* Queue a batch from btelem_drain_packed() as datagrams (rebases its
+ * table in place) */
+static void udp_tx_batch(struct udp_tx *tx, uint8_t *pkt)
+{
+    const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+    struct btelem_entry_header *table =
+        (struct btelem_entry_header *)(pkt + sizeof(*ph));
+    const uint8_t *payload = (const uint8_t *)&table[ph->entry_count];
+    size_t limit = tx->srv->max_datagram;
+    uint32_t dropped = ph->dropped;
+
+    uint16_t i = 0;
+    while (i < ph->entry_count) {
+        uint16_t start = i;
+        uint32_t base = table[i].payload_offset;
+        uint32_t end = base;
+        while (i < ph->entry_count) {
+            uint32_t e = table[i].payload_offset + table[i].payload_size;
+            size_t need = sizeof(*ph)
+                        + (size_t)(i - start + 1) * sizeof(*table) + (e - base);
+            if (need > limit && i > start)
+                break;
+            end = e;
+            i++;
+        }
+        for (uint16_t j = start; j < i; j++)
+            table[j].payload_offset -= base;
+        udp_tx_push(tx, (uint16_t)(i - start), 0, end - base, dropped,
+                    &table[start], (size_t)(i - start) * sizeof(*table),
+                    payload + base, end - base);
+        dropped = 0;
+    }
+}
+
+/* Queue the schema as fragments, then a clock packet if timestamps are
+ * ticks.  Flushes before returning, since the clock packet is on the stack. */
+static void udp_tx_schema(struct udp_tx *tx, const uint8_t *blob, uint32_t blob_len)
+{
+    size_t chunk = tx->srv->max_datagram - sizeof(struct btelem_packet_header)
+                 - sizeof(struct btelem_schema_frag_wire);
+    for (uint32_t off = 0; off < blob_len; ) {
+        uint32_t n = blob_len - off < chunk ? blob_len - off : (uint32_t)chunk;
+        if (tx->count == UDP_TX_MAX)
+            udp_tx_flush(tx);
+        struct btelem_schema_frag_wire *fw = &tx->frag[tx->count];
+        fw->total_size = blob_len;
+        fw->offset = off;
+        udp_tx_push(tx, 0, BTELEM_PACKET_FLAG_SCHEMA,
+                    (uint32_t)sizeof(*fw) + n, 0,
+                    fw, sizeof(*fw), blob + off, n);
+        off += n;
+    }
+
+    struct btelem_clock clk;
+    uint8_t cbuf[sizeof(struct btelem_packet_header)
+                 + sizeof(struct btelem_clock_wire)];
+    if (btelem_clock_sample(tx->srv->ctx, &clk) == 0
+        && btelem_clock_packet(&clk, cbuf, sizeof(cbuf)) > 0) {
+        udp_tx_push(tx, 0, BTELEM_PACKET_FLAG_CLOCK,
+                    (uint32_t)sizeof(struct btelem_clock_wire), 0,
+                    cbuf + sizeof(struct btelem_packet_header),
+                    sizeof(struct btelem_clock_wire), NULL, 0);
+    }
+    udp_tx_flush(tx);
+}
+
+static void *udp_binary_thread(void *arg)
 {
     struct btelem_udp_server *srv = (struct btelem_udp_server *)arg;
 
-    struct udp_emit_ctx uc;
-    memset(&uc, 0, sizeof(uc));
-    uc.srv = srv;
-    uc.dest_addr.sin_family = AF_INET;
-    uc.dest_addr.sin_port = htons(srv->dest_port);
-    inet_pton(AF_INET, srv->dest_ip, &uc.dest_addr.sin_addr);
+    struct udp_tx *tx = (struct udp_tx *)calloc(1, sizeof(*tx));
+    uint8_t *buf = (uint8_t *)malloc(UDP_BATCH_BUF);
+    int slen = btelem_schema_serialize_compact(srv->ctx, NULL, 0);
+    uint8_t *schema = slen > 0 ? (uint8_t *)malloc((size_t)slen) : NULL;
+    if (!tx || !buf || !schema
+        || btelem_schema_serialize_compact(srv->ctx, schema, (size_t)slen) != slen) {
+        fprintf(stderr, "btelem_serve_udp: binary mode setup failed\n");
+        goto done;
+    }
 
-    fprintf(stderr, "btelem_serve_udp: streaming JSON to %s:%u\n",
-            srv->dest_ip, srv->dest_port);
+    udp_tx_init(tx, srv);
 
-    struct timespec last_report;
+    fprintf(stderr, "btelem_serve_udp: streaming binary to %s:%u "
+            "(%u-byte datagrams)\n",
+            srv->dest_ip, srv->dest_port, srv->max_datagram);
+
+    struct timespec last_report, last_schema;
     clock_gettime(CLOCK_MONOTONIC, &last_report);
+    last_schema = last_report;
     uint64_t last_sent = 0;
+    udp_tx_schema(tx, schema, (uint32_t)slen);
 
     while (srv->running) {
-        int n = btelem_drain(srv->ctx, srv->btelem_client_id, udp_emit, &uc);
-
-        if (n <= 0)
+        int n = btelem_drain_packed(srv->ctx, srv->btelem_client_id,
+                                    buf, UDP_BATCH_BUF);
+        if (n > 0) {
+            udp_tx_batch(tx, buf);
+            udp_tx_flush(tx);
+        } else {
             usleep(1000);
+        }
 
-        /* Periodic status every 5 seconds */
         struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
+        double ds = (double)(now.tv_sec - last_schema.tv_sec)
+                  + (double)(now.tv_nsec - last_schema.tv_nsec) / 1e9;
+        if (ds * 1000.0 >= BTELEM_UDP_SCHEMA_INTERVAL_MS) {
+            udp_tx_schema(tx, schema, (uint32_t)slen);
+            last_schema = now;
+        }
+
+        /* Periodic status every 5 seconds */
         double dt = (double)(now.tv_sec - last_report.tv_sec)
                   + (double)(now.tv_nsec - last_report.tv_nsec) / 1e9;
         if (dt >= 5.0) {
-            uint64_t delta = uc.sent - last_sent;
+            uint64_t delta = tx->sent - last_sent;
             fprintf(stderr, "btelem_serve_udp: %lu datagrams sent (+%lu), "
                     "%lu errors\n",
-                    (unsigned long)uc.sent, (unsigned long)delta,
-                    (unsigned long)uc.errors);
+                    (unsigned long)tx->sent, (unsigned long)delta,
+                    (unsigned long)tx->errors);
             last_report = now;
-            last_sent = uc.sent;
+            last_sent = tx->sent;
         }
     }
 
     fprintf(stderr, "btelem_serve_udp: stopped (%lu total datagrams)\n",
-            (unsigned long)uc.sent);
+            (unsigned long)tx->sent);
+
+done:
+    free(schema);
+    free(buf);
+    free(tx);
     return NULL;
 }
 
@@ -364,8 +821,9 @@ static void *udp_drain_thread(void *arg)
  * Public API
  * ----------------------------------------------------------------------- */
 
-int btelem_serve_udp(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
-                     const char *dest_ip, uint16_t dest_port)
+static int udp_start(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                     const char *dest_ip, uint16_t dest_port,
+                     int binary, uint32_t max_datagram)
 {
     if (!srv || !ctx || !dest_ip)
         return -1;
@@ -389,9 +847,18 @@ int btelem_serve_udp(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
     srv->btelem_client_id = client_id;
     srv->dest_port = dest_port;
     strncpy(srv->dest_ip, dest_ip, sizeof(srv->dest_ip) - 1);
+    srv->binary = binary;
+    if (binary && max_datagram == 0)
+        max_datagram = BTELEM_UDP_DEFAULT_DATAGRAM;
+    if (binary && max_datagram < BTELEM_UDP_MIN_DATAGRAM)
+        max_datagram = (uint32_t)BTELEM_UDP_MIN_DATAGRAM;
+    if (max_datagram > UDP_MAX_PAYLOAD)
+        max_datagram = UDP_MAX_PAYLOAD;
+    srv->max_datagram = max_datagram;
     srv->running = 1;
 
-    if (pthread_create(&srv->drain_thread, NULL, udp_drain_thread, srv) != 0) {
+    if (pthread_create(&srv->drain_thread, NULL,
+                       binary ? udp_binary_thread : udp_drain_thread, srv) != 0) {
         close(sock);
         btelem_client_close(ctx, client_id);
         fprintf(stderr, "btelem_serve_udp: pthread_create failed\n");
@@ -401,6 +868,26 @@ int btelem_serve_udp(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
     return 0;
 }
 
+int btelem_serve_udp(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                     const char *dest_ip, uint16_t dest_port)
+{
+    return udp_start(srv, ctx, dest_ip, dest_port, 0, 0);
+}
+
+int btelem_serve_udp_json(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                          const char *dest_ip, uint16_t dest_port,
+                          uint32_t max_datagram)
+{
+    return udp_start(srv, ctx, dest_ip, dest_port, 0, max_datagram);
+}
+
+int btelem_serve_udp_binary(struct btelem_udp_server *srv, struct btelem_ctx *ctx,
+                            const char *dest_ip, uint16_t dest_port,
+                            uint32_t max_datagram)
+{
+    return udp_start(srv, ctx, dest_ip, dest_port, 1, max_datagram);
+}
+
 void btelem_udp_server_stop(struct btelem_udp_server *srv)
 {
     if (!srv || !srv->running)
@@ -0,0 +1,243 @@
+#include "btelem/btelem_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_ALIGN        4096
+#define SHM_SCHEMA_TRIES 100000     /* give up on a schema a dead writer left odd */
+
+/* --------------------------------------------------------------------------
+ * Layout
+ * ----------------------------------------------------------------------- */
+
+static uint64_t align_up(uint64_t v, uint64_t a)
+{
+    return (v + a - 1) & ~(a - 1);
+}
+
+static void shm_layout(uint32_t entry_count, struct btelem_shm_header *h)
+{
+    h->clients_offset = align_up(sizeof(*h), 64);
+    h->schema_offset  = align_up(h->clients_offset
+                                 + (uint64_t)BTELEM_MAX_CLIENTS * sizeof(struct btelem_client), 64);
+    h->ring_offset    = align_up(h->schema_offset + BTELEM_SHM_SCHEMA_MAX, SHM_ALIGN);
+    h->size           = align_up(h->ring_offset + btelem_ring_size(entry_count), SHM_ALIGN);
+}
+
+/* Header written by a compatible build, with offsets inside the mapping
+ * (the caller has already checked the magic) */
+static int shm_header_ok(const struct btelem_shm_header *h, uint64_t size)
+{
+    if (h->version != BTELEM_SHM_VERSION
+        || h->header_size != sizeof(*h)
+        || h->entry_size != sizeof(struct btelem_entry)
+        || h->client_size != sizeof(struct btelem_client)
+        || h->max_clients != BTELEM_MAX_CLIENTS
+        || h->capacity == 0 || (h->capacity & (h->capacity - 1)))
+        return 0;
+
+    struct btelem_shm_header want;
+    shm_layout(h->capacity, &want);
+    return h->size == size && h->size == want.size
+        && h->clients_offset == want.clients_offset
+        && h->schema_offset == want.schema_offset
+        && h->ring_offset == want.ring_offset
+        && h->schema_max == BTELEM_SHM_SCHEMA_MAX;
+}
+
+/* Point ctx's client table at the segment */
+static void shm_bind(struct btelem_ctx *ctx, struct btelem_shm_header *h)
+{
+    ctx->clients = (struct btelem_client *)((uint8_t *)h + h->clients_offset);
+    ctx->client_claim = &h->client_claim;
+    ctx->client_owner = (uint32_t)getpid();
+    ctx->shm = h;
+}
+
+/* Close clients whose owning process has exited */
+static void shm_reap(struct btelem_ctx *ctx)
+{
+    for (int i = 0; i < BTELEM_MAX_CLIENTS; i++) {
+        uint32_t owner = ctx->clients[i].owner;
+        if (!ctx->clients[i].active || owner == 0)
+            continue;
+        if (kill((pid_t)owner, 0) < 0 && errno == ESRCH) {
+            fprintf(stderr, "btelem_shm: closing client %d of exited process %u\n",
+                    i, (unsigned)owner);
+            btelem_client_close(ctx, i);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Producer
+ * ----------------------------------------------------------------------- */
+
+int btelem_init_shm(struct btelem_ctx *ctx, const char *name, uint32_t entry_count)
+{
+    if (!ctx || !name || entry_count == 0 || (entry_count & (entry_count - 1)))
+        return -1;
+
+    struct btelem_shm_header layout;
+    memset(&layout, 0, sizeof(layout));
+    shm_layout(entry_count, &layout);
+
+    /* Never replace a segment: it may be live, or a crash's post-mortem */
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, (off_t)layout.size) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void *mem = mmap(NULL, (size_t)layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    /* The new segment reads as zeros: no clients, no schema */
+    struct btelem_shm_header *h = (struct btelem_shm_header *)mem;
+    if (btelem_init(ctx, (uint8_t *)mem + layout.ring_offset, entry_count) < 0) {
+        munmap(mem, (size_t)layout.size);
+        shm_unlink(name);
+        return -1;
+    }
+    h->version        = BTELEM_SHM_VERSION;
+    h->header_size    = sizeof(*h);
+    h->entry_size     = sizeof(struct btelem_entry);
+    h->client_size    = sizeof(struct btelem_client);
+    h->max_clients    = BTELEM_MAX_CLIENTS;
+    h->capacity       = entry_count;
+    h->producer_pid   = (uint32_t)getpid();
+    h->size           = layout.size;
+    h->clients_offset = layout.clients_offset;
+    h->schema_offset  = layout.schema_offset;
+    h->ring_offset    = layout.ring_offset;
+    h->schema_max     = BTELEM_SHM_SCHEMA_MAX;
+    shm_bind(ctx, h);
+
+    /* Attachers check the magic first */
+    btelem_atomic_fence_rel();
+    h->magic = BTELEM_SHM_MAGIC;
+    return 0;
+}
+
+int btelem_shm_publish_schema(struct btelem_ctx *ctx)
+{
+    if (!ctx || !ctx->shm || ctx->schema_count == 0)
+        return -1;
+
+    struct btelem_shm_header *h = (struct btelem_shm_header *)ctx->shm;
+    int n = btelem_schema_serialize_compact(ctx, NULL, 0);
+    if (n <= 0 || (uint32_t)n > h->schema_max)
+        return -1;
+
+    /* Seqlock: readers retry while seq is odd or has moved */
+    uint64_t seq = btelem_atomic_load_acq(&h->schema_seq);
+    btelem_atomic_store_rel(&h->schema_seq, seq + 1);
+    btelem_atomic_fence_rel();
+    btelem_schema_serialize_compact(ctx, (uint8_t *)h + h->schema_offset, (size_t)n);
+    h->schema_len = (uint32_t)n;
+    btelem_atomic_store_rel(&h->schema_seq, seq + 2);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Consumer
+ * ----------------------------------------------------------------------- */
+
+int btelem_attach_shm(struct btelem_ctx *ctx, const char *name)
+{
+    if (!ctx || !name)
+        return -1;
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(struct btelem_shm_header)) {
+        close(fd);
+        return -1;
+    }
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return -1;
+
+    /* The magic is written last (after a release fence): read it first,
+     * then fence, so every other header field is read after it */
+    struct btelem_shm_header *h = (struct btelem_shm_header *)mem;
+    uint32_t magic = *(volatile const uint32_t *)&h->magic;
+    btelem_atomic_fence_acq();
+    struct btelem_ring *r = NULL;
+    if (magic == BTELEM_SHM_MAGIC && shm_header_ok(h, (uint64_t)st.st_size))
+        r = (struct btelem_ring *)((uint8_t *)mem + h->ring_offset);
+    if (!r || r->capacity != h->capacity || r->mask != h->capacity - 1) {
+        fprintf(stderr, "btelem_shm: %s: not a compatible btelem segment\n", name);
+        munmap(mem, (size_t)st.st_size);
+        return -1;
+    }
+
+    btelem_deinit(ctx);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->endianness = BTELEM_LITTLE_ENDIAN ? 0 : 1;
+    ctx->ring_mode = BTELEM_RING_FIXED;
+    ctx->ring = r;
+    btelem_atomic_store_rel(&ctx->wake_at, UINT64_MAX);
+    shm_bind(ctx, h);
+    shm_reap(ctx);
+    return 0;
+}
+
+int btelem_shm_schema(const struct btelem_ctx *ctx, void *buf, size_t buf_size)
+{
+    if (!ctx || !ctx->shm)
+        return -1;
+
+    struct btelem_shm_header *h = (struct btelem_shm_header *)ctx->shm;
+    const uint8_t *src = (const uint8_t *)h + h->schema_offset;
+    for (int tries = 0; tries < SHM_SCHEMA_TRIES; tries++) {
+        uint64_t seq = btelem_atomic_load_acq(&h->schema_seq);
+        if (seq == 0)
+            return 0;
+        if (seq & 1)
+            continue;
+        uint32_t len = h->schema_len;
+        int fits = len <= h->schema_max && (!buf || len <= buf_size);
+        if (buf && fits)
+            memcpy(buf, src, len);
+        btelem_atomic_fence_acq();
+        if (btelem_atomic_load_acq(&h->schema_seq) != seq)
+            continue;
+        return fits ? (int)len : -1;
+    }
+    return -1;
+}
+
+void btelem_shm_detach(struct btelem_ctx *ctx)
+{
+    if (!ctx || !ctx->shm)
+        return;
+    struct btelem_shm_header *h = (struct btelem_shm_header *)ctx->shm;
+    munmap(h, (size_t)h->size);
+    ctx->shm = NULL;
+    ctx->ring = NULL;
+    ctx->clients = ctx->client_slots;
+    ctx->client_claim = NULL;
+}
+
+int btelem_shm_unlink(const char *name)
+{
+    if (!name)
+        return -1;
+    return shm_unlink(name) == 0 ? 0 : -1;
+}
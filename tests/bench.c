@@ -0,0 +1,930 @@
+/**
+ * btelem end-to-end benchmark suite
+ *
+ * Where bench_log.c times the BTELEM_LOG call site alone, this measures
+ * the paths behind it:
+ *
+ *   drain       btelem_drain_packed() throughput by payload mix and by
+ *               client filter selectivity
+ *   contention  producers logging while 1..N clients drain the same ring
+ *   tcp         btelem_serve() throughput with 1..N viewers on loopback
+ *   latency     producer-to-viewer latency over loopback TCP; the producer
+ *               embeds CLOCK_MONOTONIC ns in the payload and the viewer
+ *               subtracts it on receipt, into an HDR-style histogram
+ *
+ * With --corpus FILE it also records a mixed .btlm file through
+ * btelem_record, which tests/bench.py feeds to the Python and Rust
+ * decoder benchmarks.  --json FILE writes every result (and the latency
+ * histograms) for tests/bench.py to merge, compare and render into
+ * docs/benchmark.md.
+ *
+ * Usage:
+ *   btelem_bench [--quick] [--only SCENARIO] [--json FILE] [--corpus FILE]
+ *
+ * Build with optimizations for meaningful results:
+ *   make bench-suite
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "btelem/btelem_serve.h"
+#include "btelem/btelem_record.h"
+#ifdef __linux__
+#include "btelem/btelem_serve_evloop.h"
+#endif
+
+/* --------------------------------------------------------------------------
+ * Schema
+ * ----------------------------------------------------------------------- */
+
+struct payload_small { uint32_t value; };
+struct payload_medium { uint32_t a; uint32_t b; uint64_t c; };
+struct payload_max { uint8_t data[BTELEM_MAX_PAYLOAD]; };
+
+struct payload_imu {
+    float    accel[3];
+    float    gyro[3];
+    uint32_t seq;
+};
+
+/* Producer timestamp for the latency scenario */
+struct payload_lat {
+    uint64_t t_ns;
+    uint64_t seq;
+};
+
+static const struct btelem_field_def fields_small[] = {
+    BTELEM_FIELD(struct payload_small, value, BTELEM_U32),
+};
+BTELEM_SCHEMA_ENTRY(SMALL, 0, "small", "4-byte payload",
+                     struct payload_small, fields_small);
+
+static const struct btelem_field_def fields_medium[] = {
+    BTELEM_FIELD(struct payload_medium, a, BTELEM_U32),
+    BTELEM_FIELD(struct payload_medium, b, BTELEM_U32),
+    BTELEM_FIELD(struct payload_medium, c, BTELEM_U64),
+};
+BTELEM_SCHEMA_ENTRY(MEDIUM, 1, "medium", "16-byte payload",
+                     struct payload_medium, fields_medium);
+
+static const struct btelem_field_def fields_max[] = {
+    { .name = "data", .offset = 0, .size = BTELEM_MAX_PAYLOAD,
+      .type = BTELEM_BYTES, .count = 1 },
+};
+BTELEM_SCHEMA_ENTRY(MAX, 2, "max", "max-size payload",
+                     struct payload_max, fields_max);
+
+static const struct btelem_field_def fields_imu[] = {
+    BTELEM_ARRAY_FIELD(struct payload_imu, accel, BTELEM_F32, 3),
+    BTELEM_ARRAY_FIELD(struct payload_imu, gyro,  BTELEM_F32, 3),
+    BTELEM_FIELD(struct payload_imu, seq,   BTELEM_U32),
+};
+BTELEM_SCHEMA_ENTRY(IMU, 3, "imu", "6-axis IMU sample",
+                     struct payload_imu, fields_imu);
+
+static const struct btelem_field_def fields_lat[] = {
+    BTELEM_FIELD(struct payload_lat, t_ns, BTELEM_U64),
+    BTELEM_FIELD(struct payload_lat, seq,  BTELEM_U64),
+};
+BTELEM_SCHEMA_ENTRY(LAT, 4, "latency", "producer timestamp probe",
+                     struct payload_lat, fields_lat);
+
+/* Eight IDs sharing the medium layout, for filter selectivity */
+#define CH_BASE  8
+#define CH_COUNT 8
+
+static struct btelem_schema_entry ch_schema[CH_COUNT];
+static char ch_names[CH_COUNT][8];
+
+static void register_all(struct btelem_ctx *c)
+{
+    btelem_register(c, &btelem_schema_SMALL);
+    btelem_register(c, &btelem_schema_MEDIUM);
+    btelem_register(c, &btelem_schema_MAX);
+    btelem_register(c, &btelem_schema_IMU);
+    btelem_register(c, &btelem_schema_LAT);
+    for (int i = 0; i < CH_COUNT; i++) {
+        snprintf(ch_names[i], sizeof(ch_names[i]), "ch%d", i);
+        ch_schema[i] = btelem_schema_MEDIUM;
+        ch_schema[i].id = (uint16_t)(CH_BASE + i);
+        ch_schema[i].name = ch_names[i];
+        btelem_register(c, &ch_schema[i]);
+    }
+}
+
+/* Log one entry of schema `id` with a payload derived from `i` */
+static void log_one(struct btelem_ctx *c, uint16_t id, uint64_t i)
+{
+    switch (id) {
+    case BTELEM_ID_SMALL: {
+        struct payload_small d = { .value = (uint32_t)i };
+        BTELEM_LOG_ID(c, id, d);
+        break;
+    }
+    case BTELEM_ID_MAX: {
+        struct payload_max d;
+        memset(&d, (int)(i & 0xFF), sizeof(d));
+        BTELEM_LOG_ID(c, id, d);
+        break;
+    }
+    case BTELEM_ID_IMU: {
+        float x = (float)(i % 1000) * 0.001f;
+        struct payload_imu d = {
+            .accel = { x, 1.0f - x, 9.81f },
+            .gyro  = { 0.01f * x, -0.02f * x, 0.5f },
+            .seq   = (uint32_t)i,
+        };
+        BTELEM_LOG_ID(c, id, d);
+        break;
+    }
+    default: {
+        struct payload_medium d = { .a = (uint32_t)i, .b = 2, .c = i * 3 };
+        BTELEM_LOG_ID(c, id, d);
+        break;
+    }
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Timing helpers
+ * ----------------------------------------------------------------------- */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t)
+{
+    struct timespec ts = {
+        .tv_sec  = (time_t)(t / 1000000000ULL),
+        .tv_nsec = (long)(t % 1000000000ULL),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+        ;
+}
+
+/* --------------------------------------------------------------------------
+ * Latency histogram
+ *
+ * Log-linear buckets in the style of HdrHistogram: values below 128 are
+ * exact, above that each power of two is split into 64 buckets, so any
+ * recorded value is reported to within 1.6%.
+ * ----------------------------------------------------------------------- */
+
+#define HIST_SUB     64
+#define HIST_LINEAR  (2 * HIST_SUB)
+#define HIST_BUCKETS (HIST_LINEAR + 56 * HIST_SUB)
+
+struct hist {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+};
+
+static int hist_index(uint64_t v)
+{
+    if (v < HIST_LINEAR)
+        return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - 6;                            /* v >> shift in [64, 128) */
+    int idx = HIST_LINEAR + (shift - 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+/* Largest value that lands in bucket idx */
+static uint64_t hist_upper(int idx)
+{
+    if (idx < HIST_LINEAR)
+        return (uint64_t)idx;
+    int shift = (idx - HIST_LINEAR) / HIST_SUB + 1;
+    uint64_t sub = (uint64_t)((idx - HIST_LINEAR) % HIST_SUB + HIST_SUB);
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hist_record(struct hist *h, uint64_t v)
+{
+    h->counts[hist_index(v)]++;
+    if (h->total == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->total++;
+}
+
+static uint64_t hist_percentile(const struct hist *h, double pct)
+{
+    if (h->total == 0)
+        return 0;
+    uint64_t want = (uint64_t)((double)h->total * pct / 100.0 + 0.5);
+    if (want < 1) want = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = hist_upper(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* --------------------------------------------------------------------------
+ * Results
+ * ----------------------------------------------------------------------- */
+
+#define MAX_RESULTS 128
+#define MAX_HISTS   8
+
+struct result {
+    char        name[64];
+    double      value;
+    const char *unit;
+    int         higher;             /* 1 = higher is better */
+};
+
+static struct result results[MAX_RESULTS];
+static int           result_count;
+
+static struct {
+    char         name[64];
+    struct hist *h;
+} hists[MAX_HISTS];
+static int hist_count;
+
+static int quick;
+
+static void report(const char *unit, int higher, double value,
+                   const char *fmt, ...)
+{
+    if (result_count == MAX_RESULTS)
+        return;
+    struct result *r = &results[result_count++];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(r->name, sizeof(r->name), fmt, ap);
+    va_end(ap);
+    r->value = value;
+    r->unit = unit;
+    r->higher = higher;
+    printf("  %-36s %10.2f %s\n", r->name, value, unit);
+}
+
+static int write_json(const char *path, const char *corpus, uint64_t corpus_entries)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return -1; }
+    fprintf(f, "{\n  \"suite\": \"btelem_bench\",\n  \"quick\": %s,\n",
+            quick ? "true" : "false");
+    fprintf(f, "  \"entry_size\": %zu,\n", sizeof(struct btelem_entry));
+    if (corpus)
+        fprintf(f, "  \"corpus\": {\"path\": \"%s\", \"entries\": %llu},\n",
+                corpus, (unsigned long long)corpus_entries);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < result_count; i++)
+        fprintf(f, "    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", "
+                   "\"better\": \"%s\"}%s\n",
+                results[i].name, results[i].value, results[i].unit,
+                results[i].higher ? "higher" : "lower",
+                i + 1 < result_count ? "," : "");
+    fprintf(f, "  ],\n  \"histograms\": {\n");
+    for (int i = 0; i < hist_count; i++) {
+        const struct hist *h = hists[i].h;
+        fprintf(f, "    \"%s\": [", hists[i].name);
+        int first = 1;
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            if (!h->counts[b])
+                continue;
+            fprintf(f, "%s[%llu, %llu]", first ? "" : ", ",
+                    (unsigned long long)hist_upper(b),
+                    (unsigned long long)h->counts[b]);
+            first = 0;
+        }
+        fprintf(f, "]%s\n", i + 1 < hist_count ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    return fclose(f);
+}
+
+/* --------------------------------------------------------------------------
+ * Scenario: drain throughput
+ *
+ * Fill three quarters of the ring (no overwrite), then time
+ * btelem_drain_packed() until it runs dry.  Only the drain is timed.
+ * ----------------------------------------------------------------------- */
+
+#define DRAIN_RING  4096
+#define DRAIN_FILL  (DRAIN_RING * 3 / 4)
+#define PKT_BUF     65536
+
+static uint8_t pkt_buf[PKT_BUF];
+
+static void drain_case(const char *label, const uint16_t *ids, int nids,
+                       const uint16_t *filter, int filter_count, int bandwidth)
+{
+    static struct btelem_ctx c;
+    void *ring = calloc(1, btelem_ring_size(DRAIN_RING));
+    if (!ring) { perror("calloc"); exit(1); }
+    memset(&c, 0, sizeof(c));
+    btelem_init(&c, ring, DRAIN_RING);
+    register_all(&c);
+    int client = btelem_client_open(&c, filter, filter_count);
+
+    int rounds = quick ? 50 : 500;
+    uint64_t elapsed = 0, bytes = 0, emitted = 0, seq = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < DRAIN_FILL; i++, seq++)
+            log_one(&c, ids[seq % (uint64_t)nids], seq);
+        uint64_t t0 = now_ns();
+        int n;
+        while ((n = btelem_drain_packed(&c, client, pkt_buf, sizeof(pkt_buf))) > 0) {
+            bytes += (uint64_t)n;
+            emitted += ((const struct btelem_packet_header *)pkt_buf)->entry_count;
+        }
+        elapsed += now_ns() - t0;
+    }
+
+    double scanned = (double)rounds * DRAIN_FILL;
+    report("Mentries/s", 1, scanned / (double)elapsed * 1e3, "drain/%s", label);
+    if (bandwidth)
+        report("MB/s", 1, (double)bytes / (double)elapsed * 1e3,
+               "drain/%s/bandwidth", label);
+    if (filter_count && emitted != (uint64_t)(scanned * filter_count / nids))
+        fprintf(stderr, "  warning: %s emitted %llu of %.0f\n", label,
+                (unsigned long long)emitted, scanned);
+
+    btelem_client_close(&c, client);
+    free(ring);
+}
+
+static void bench_drain(void)
+{
+    printf("\ndrain (btelem_drain_packed, %d-entry ring):\n", DRAIN_RING);
+
+    static const uint16_t small[] = { BTELEM_ID_SMALL };
+    static const uint16_t medium[] = { BTELEM_ID_MEDIUM };
+    static const uint16_t max[] = { BTELEM_ID_MAX };
+    /* Roughly a control loop: mostly mid-sized samples, some status */
+    static const uint16_t mixed[] = {
+        BTELEM_ID_IMU, BTELEM_ID_IMU, BTELEM_ID_IMU, BTELEM_ID_MEDIUM,
+        BTELEM_ID_IMU, BTELEM_ID_SMALL, BTELEM_ID_IMU, BTELEM_ID_MAX,
+    };
+    drain_case("small", small, 1, NULL, 0, 1);
+    drain_case("medium", medium, 1, NULL, 0, 1);
+    drain_case("max", max, 1, NULL, 0, 1);
+    drain_case("mixed", mixed, 8, NULL, 0, 1);
+
+    uint16_t chs[CH_COUNT];
+    for (int i = 0; i < CH_COUNT; i++)
+        chs[i] = (uint16_t)(CH_BASE + i);
+    drain_case("filter/8of8", chs, CH_COUNT, chs, 8, 0);
+    drain_case("filter/4of8", chs, CH_COUNT, chs, 4, 0);
+    drain_case("filter/1of8", chs, CH_COUNT, chs, 1, 0);
+}
+
+/* --------------------------------------------------------------------------
+ * Scenario: producer / drainer contention
+ * ----------------------------------------------------------------------- */
+
+#define CONT_RING 4096
+
+static struct btelem_ctx cont_ctx;
+static volatile int cont_producing;
+
+struct cont_prod {
+    uint64_t entries;
+};
+
+struct cont_drain {
+    int      client;
+    uint64_t delivered;
+    uint8_t  buf[PKT_BUF];
+};
+
+static void *cont_producer(void *arg)
+{
+    struct cont_prod *p = (struct cont_prod *)arg;
+    for (uint64_t i = 0; i < p->entries; i++)
+        log_one(&cont_ctx, BTELEM_ID_MEDIUM, i);
+    return NULL;
+}
+
+static void *cont_drainer(void *arg)
+{
+    struct cont_drain *d = (struct cont_drain *)arg;
+    for (;;) {
+        int running = cont_producing;
+        int n = btelem_drain_packed(&cont_ctx, d->client, d->buf, sizeof(d->buf));
+        if (n > 0) {
+            d->delivered += ((const struct btelem_packet_header *)d->buf)->entry_count;
+        } else if (!running) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void contention_case(int nprod, int ndrain)
+{
+    void *ring = calloc(1, btelem_ring_size(CONT_RING));
+    if (!ring) { perror("calloc"); exit(1); }
+    memset(&cont_ctx, 0, sizeof(cont_ctx));
+    btelem_init(&cont_ctx, ring, CONT_RING);
+    register_all(&cont_ctx);
+
+    uint64_t per_prod = quick ? 200000 : 2000000;
+    pthread_t pth[4], dth[4];
+    struct cont_prod prods[4];
+    static struct cont_drain drains[4];
+    for (int i = 0; i < ndrain; i++) {
+        drains[i].client = btelem_client_open(&cont_ctx, NULL, 0);
+        drains[i].delivered = 0;
+    }
+
+    cont_producing = 1;
+    for (int i = 0; i < ndrain; i++)
+        pthread_create(&dth[i], NULL, cont_drainer, &drains[i]);
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < nprod; i++) {
+        prods[i].entries = per_prod;
+        pthread_create(&pth[i], NULL, cont_producer, &prods[i]);
+    }
+    for (int i = 0; i < nprod; i++)
+        pthread_join(pth[i], NULL);
+    uint64_t elapsed = now_ns() - t0;
+    cont_producing = 0;
+    uint64_t delivered = 0;
+    for (int i = 0; i < ndrain; i++) {
+        pthread_join(dth[i], NULL);
+        delivered += drains[i].delivered;
+        btelem_client_close(&cont_ctx, drains[i].client);
+    }
+
+    double total = (double)per_prod * nprod;
+    report("Mentries/s", 1, total / (double)elapsed * 1e3,
+           "contention/p%d_d%d/log", nprod, ndrain);
+    report("%", 1, 100.0 * (double)delivered / (total * ndrain),
+           "contention/p%d_d%d/delivered", nprod, ndrain);
+    free(ring);
+}
+
+static void bench_contention(void)
+{
+    printf("\ncontention (16B payload, %d-entry ring, drainers via "
+           "btelem_drain_packed):\n", CONT_RING);
+    static const int cases[][2] = { {1, 1}, {2, 1}, {4, 1}, {1, 2}, {4, 4} };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        contention_case(cases[i][0], cases[i][1]);
+}
+
+/* --------------------------------------------------------------------------
+ * TCP helpers
+ * ----------------------------------------------------------------------- */
+
+static int find_free_port(void)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    bind(s, (struct sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(s, (struct sockaddr *)&addr, &len);
+    int port = ntohs(addr.sin_port);
+    close(s);
+    return port;
+}
+
+static int connect_to(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port   = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    for (int i = 0; i < 50; i++) {
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            return fd;
+        usleep(100000);
+    }
+    close(fd);
+    return -1;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return -1;
+        p += (size_t)n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Send BTELEM_CTRL_HELLO and read past the compact schema it returns */
+static int open_viewer(int port)
+{
+    int fd = connect_to(port);
+    if (fd < 0)
+        return -1;
+    uint8_t msg[4 + sizeof(struct btelem_ctrl_header) + sizeof(uint64_t)];
+    uint32_t len = sizeof(msg) - 4;
+    struct btelem_ctrl_header h = { .type = BTELEM_CTRL_HELLO, .count = 0 };
+    memset(msg, 0, sizeof(msg));
+    memcpy(msg, &len, 4);
+    memcpy(msg + 4, &h, sizeof(h));
+    uint32_t slen;
+    if (write(fd, msg, sizeof(msg)) != (ssize_t)sizeof(msg)
+        || recv_all(fd, &slen, 4) < 0) {
+        close(fd);
+        return -1;
+    }
+    uint8_t discard[4096];
+    while (slen > 0) {
+        uint32_t chunk = slen < sizeof(discard) ? slen : (uint32_t)sizeof(discard);
+        if (recv_all(fd, discard, chunk) < 0) {
+            close(fd);
+            return -1;
+        }
+        slen -= chunk;
+    }
+    return fd;
+}
+
+/* Read one length-prefixed packet; returns its size or -1 on EOF */
+static int recv_packet(int fd, uint8_t *buf, size_t cap)
+{
+    uint32_t plen;
+    if (recv_all(fd, &plen, 4) < 0 || plen > cap || recv_all(fd, buf, plen) < 0)
+        return -1;
+    return (int)plen;
+}
+
+/* --------------------------------------------------------------------------
+ * Scenario: TCP server throughput
+ *
+ * Producers log as fast as they can for a fixed time; each viewer counts
+ * what reaches it.  The ring overwrites under the load, so "delivered"
+ * is the share of logged entries each viewer saw.
+ * ----------------------------------------------------------------------- */
+
+#define TCP_RING    16384
+#define TCP_VIEWERS 4
+
+static struct btelem_ctx tcp_ctx;
+
+struct tcp_viewer {
+    int      fd;
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t t_last;
+    uint8_t  buf[1 << 20];
+};
+
+static void *tcp_viewer_thread(void *arg)
+{
+    struct tcp_viewer *v = (struct tcp_viewer *)arg;
+    int n;
+    while ((n = recv_packet(v->fd, v->buf, sizeof(v->buf))) >= 0) {
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)v->buf;
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+        v->entries += pkt->entry_count;
+        v->bytes += (uint64_t)n + 4;
+        v->t_last = now_ns();
+    }
+    return NULL;
+}
+
+static void tcp_case(int nviewers)
+{
+    void *ring = calloc(1, btelem_ring_size(TCP_RING));
+    if (!ring) { perror("calloc"); exit(1); }
+    memset(&tcp_ctx, 0, sizeof(tcp_ctx));
+    btelem_init(&tcp_ctx, ring, TCP_RING);
+    register_all(&tcp_ctx);
+
+    static struct btelem_server srv;
+    memset(&srv, 0, sizeof(srv));
+    int port = find_free_port();
+    if (btelem_serve(&srv, &tcp_ctx, "127.0.0.1", (uint16_t)port) < 0) {
+        fprintf(stderr, "  btelem_serve failed\n");
+        free(ring);
+        return;
+    }
+
+    static struct tcp_viewer viewers[TCP_VIEWERS];
+    pthread_t th[TCP_VIEWERS];
+    int connected = 0;
+    for (int i = 0; i < nviewers; i++) {
+        memset(&viewers[i], 0, offsetof(struct tcp_viewer, buf));
+        viewers[i].fd = open_viewer(port);
+        if (viewers[i].fd < 0)
+            break;
+        pthread_create(&th[i], NULL, tcp_viewer_thread, &viewers[i]);
+        connected++;
+    }
+    usleep(50000);
+
+    /* Log in bursts and yield, so a single core still runs the server */
+    uint64_t dur = quick ? 300000000ULL : 2000000000ULL;
+    uint64_t logged = 0;
+    uint64_t t0 = now_ns();
+    while (now_ns() - t0 < dur) {
+        for (int i = 0; i < 256; i++, logged++)
+            log_one(&tcp_ctx, BTELEM_ID_MEDIUM, logged);
+        sched_yield();
+    }
+    usleep(200000);
+    btelem_server_stop(&srv);
+
+    uint64_t entries = 0, bytes = 0, t_last = t0;
+    for (int i = 0; i < connected; i++) {
+        pthread_join(th[i], NULL);
+        close(viewers[i].fd);
+        entries += viewers[i].entries;
+        bytes += viewers[i].bytes;
+        if (viewers[i].t_last > t_last)
+            t_last = viewers[i].t_last;
+    }
+    if (connected < nviewers)
+        fprintf(stderr, "  warning: only %d of %d viewers connected\n",
+                connected, nviewers);
+
+    double secs = (double)(t_last - t0) / 1e9;
+    report("Mentries/s", 1, (double)entries / secs / 1e6,
+           "tcp/%d_viewers/entries", nviewers);
+    report("MB/s", 1, (double)bytes / secs / 1e6,
+           "tcp/%d_viewers/bandwidth", nviewers);
+    report("%", 1, connected ? 100.0 * (double)entries
+                               / ((double)logged * connected) : 0.0,
+           "tcp/%d_viewers/delivered", nviewers);
+    free(ring);
+}
+
+static void bench_tcp(void)
+{
+    printf("\ntcp (btelem_serve, 16B payload, %d-entry ring, aggregate "
+           "over viewers):\n", TCP_RING);
+    tcp_case(1);
+    tcp_case(2);
+    tcp_case(4);
+}
+
+/* --------------------------------------------------------------------------
+ * Scenario: producer-to-viewer latency
+ * ----------------------------------------------------------------------- */
+
+#define LAT_RING 4096
+
+static struct btelem_ctx lat_ctx;
+
+struct lat_viewer {
+    int          fd;
+    struct hist *h;
+    uint8_t      buf[1 << 16];
+};
+
+static void *lat_viewer_thread(void *arg)
+{
+    struct lat_viewer *v = (struct lat_viewer *)arg;
+    while (recv_packet(v->fd, v->buf, sizeof(v->buf)) >= 0) {
+        uint64_t t = now_ns();
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)v->buf;
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+        const struct btelem_entry_header *table =
+            (const struct btelem_entry_header *)(v->buf + sizeof(*pkt));
+        const uint8_t *payload = (const uint8_t *)&table[pkt->entry_count];
+        for (uint16_t i = 0; i < pkt->entry_count; i++) {
+            if (table[i].id != BTELEM_ID_LAT)
+                continue;
+            struct payload_lat p;
+            memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+            hist_record(v->h, t - p.t_ns);
+        }
+    }
+    return NULL;
+}
+
+enum lat_server { LAT_SERVE, LAT_EVLOOP };
+
+static void latency_case(enum lat_server kind, const char *label, int rate_hz)
+{
+    void *ring = calloc(1, btelem_ring_size(LAT_RING));
+    struct hist *h = calloc(1, sizeof(*h));
+    if (!ring || !h) { perror("calloc"); exit(1); }
+    memset(&lat_ctx, 0, sizeof(lat_ctx));
+    btelem_init(&lat_ctx, ring, LAT_RING);
+    register_all(&lat_ctx);
+
+    static struct btelem_server srv;
+#ifdef __linux__
+    static struct btelem_evloop_server ev;
+#endif
+    int port = find_free_port();
+    int rc = -1;
+    memset(&srv, 0, sizeof(srv));
+    if (kind == LAT_SERVE)
+        rc = btelem_serve(&srv, &lat_ctx, "127.0.0.1", (uint16_t)port);
+#ifdef __linux__
+    else
+        rc = btelem_serve_evloop(&ev, &lat_ctx, "127.0.0.1", (uint16_t)port, NULL);
+#endif
+    static struct lat_viewer v;
+    v.h = h;
+    v.fd = rc < 0 ? -1 : open_viewer(port);
+    if (v.fd < 0) {
+        fprintf(stderr, "  %s: server/viewer setup failed\n", label);
+        free(ring);
+        free(h);
+        return;
+    }
+    pthread_t th;
+    pthread_create(&th, NULL, lat_viewer_thread, &v);
+    usleep(50000);
+
+    int samples = rate_hz * (quick ? 1 : 5);
+    uint64_t period = 1000000000ULL / (uint64_t)rate_hz;
+    uint64_t next = now_ns();
+    for (int i = 0; i < samples; i++) {
+        next += period;
+        sleep_until_ns(next);
+        struct payload_lat p = { .t_ns = now_ns(), .seq = (uint64_t)i };
+        BTELEM_LOG(&lat_ctx, LAT, p);
+    }
+    usleep(200000);
+    if (kind == LAT_SERVE)
+        btelem_server_stop(&srv);
+#ifdef __linux__
+    else
+        btelem_evloop_server_stop(&ev);
+#endif
+    pthread_join(th, NULL);
+    close(v.fd);
+
+    char name[64];
+    snprintf(name, sizeof(name), "latency/%s/%dhz", label, rate_hz);
+    static const double pcts[] = { 50, 90, 99, 99.9 };
+    for (size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+        report("us", 0, (double)hist_percentile(h, pcts[i]) / 1e3,
+               "%s/p%g", name, pcts[i]);
+    report("us", 0, (double)h->max / 1e3, "%s/max", name);
+    if (h->total < (uint64_t)samples)
+        fprintf(stderr, "  warning: %s received %llu of %d\n", name,
+                (unsigned long long)h->total, samples);
+
+    if (hist_count < MAX_HISTS) {
+        snprintf(hists[hist_count].name, sizeof(hists[0].name), "%s", name);
+        hists[hist_count++].h = h;
+    } else {
+        free(h);
+    }
+    free(ring);
+}
+
+static void bench_latency(void)
+{
+    printf("\nlatency (producer timestamp in payload, loopback viewer):\n");
+    latency_case(LAT_SERVE, "serve", 1000);
+    latency_case(LAT_SERVE, "serve", 10000);
+#ifdef __linux__
+    latency_case(LAT_EVLOOP, "evloop", 1000);
+    latency_case(LAT_EVLOOP, "evloop", 10000);
+#endif
+}
+
+/* --------------------------------------------------------------------------
+ * Decoder corpus
+ *
+ * Logged in bursts of a quarter ring, each waiting for the recorder to
+ * catch up, so the file holds every entry.
+ * ----------------------------------------------------------------------- */
+
+#define CORPUS_RING  65536
+#define CORPUS_BURST (CORPUS_RING / 4)
+
+static uint64_t write_corpus(const char *path)
+{
+    static struct btelem_ctx c;
+    static struct btelem_recorder rec;
+    void *ring = calloc(1, btelem_ring_size(CORPUS_RING));
+    if (!ring) { perror("calloc"); exit(1); }
+    memset(&c, 0, sizeof(c));
+    btelem_init(&c, ring, CORPUS_RING);
+    register_all(&c);
+    if (btelem_record_start(&rec, &c, path, NULL) < 0) {
+        fprintf(stderr, "btelem_record_start(%s) failed\n", path);
+        free(ring);
+        return 0;
+    }
+
+    static const uint16_t mix[] = {
+        BTELEM_ID_IMU, BTELEM_ID_IMU, BTELEM_ID_MEDIUM, BTELEM_ID_IMU,
+        BTELEM_ID_SMALL, BTELEM_ID_IMU, BTELEM_ID_MEDIUM, BTELEM_ID_IMU,
+    };
+    uint64_t total = quick ? 100000 : 1000000;
+    struct btelem_record_stats st;
+    for (uint64_t i = 0; i < total; i++) {
+        log_one(&c, mix[i % 8], i);
+        if ((i + 1) % CORPUS_BURST)
+            continue;
+        for (int tries = 0; tries < 2000; tries++) {
+            btelem_record_get_stats(&rec, &st);
+            if (st.entries + st.dropped >= i + 1 - CORPUS_BURST)
+                break;
+            usleep(1000);
+        }
+    }
+    btelem_record_stop(&rec);
+    btelem_record_get_stats(&rec, &st);
+    printf("\ncorpus: %llu entries, %llu dropped, %llu bytes -> %s\n",
+           (unsigned long long)st.entries, (unsigned long long)st.dropped,
+           (unsigned long long)st.bytes, path);
+    free(ring);
+    return st.entries;
+}
+
+/* --------------------------------------------------------------------------
+ * Main
+ * ----------------------------------------------------------------------- */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--quick] [--only drain|contention|tcp|latency]\n"
+            "          [--json FILE] [--corpus FILE]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL, *json = NULL, *corpus = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = 1;
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* Viewers can be closed under the server mid-write */
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("btelem benchmark suite%s\n", quick ? " (quick)" : "");
+    printf("======================\n");
+    printf("Entry: %zu bytes, payload max %d\n", sizeof(struct btelem_entry),
+           BTELEM_MAX_PAYLOAD);
+
+    static const struct {
+        const char *name;
+        void (*run)(void);
+    } scenarios[] = {
+        { "drain",      bench_drain },
+        { "contention", bench_contention },
+        { "tcp",        bench_tcp },
+        { "latency",    bench_latency },
+    };
+    int ran = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        if (only && strcmp(only, scenarios[i].name) != 0)
+            continue;
+        scenarios[i].run();
+        ran++;
+    }
+    if (only && !ran && !corpus) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    uint64_t corpus_entries = corpus ? write_corpus(corpus) : 0;
+    if (corpus && corpus_entries == 0)
+        return 1;
+    if (json && write_json(json, corpus, corpus_entries) < 0)
+        return 1;
+    return 0;
+}
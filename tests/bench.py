@@ -0,0 +1,324 @@
+"""btelem benchmark harness.
+
+Runs the C suite (btelem_bench), then the Python and Rust decoders over
+the .btlm corpus it records, and merges everything into one JSON report:
+
+    python3 tests/bench.py --build build-bench --out bench.json
+
+Compare against an earlier report; exits 1 if any result is worse by more
+than --threshold percent:
+
+    python3 tests/bench.py --build build-bench --compare baseline.json
+
+Regenerate the results section of docs/benchmark.md from a new run (or,
+with --from, from an existing report):
+
+    python3 tests/bench.py --build build-bench --markdown docs/benchmark.md
+
+Set BTELEM_BENCH_MARKDOWN_HOST to describe the machine in the rendered
+section; by default it lists the CPU model and count.
+"""
+
+from __future__ import annotations
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+sys.path.insert(0, os.path.join(ROOT, "python"))
+
+BEGIN = "<!-- btelem_bench:begin -->"
+END = "<!-- btelem_bench:end -->"
+
+
+# ---------------------------------------------------------------------------
+# Runners
+# ---------------------------------------------------------------------------
+
+def run_c(build: str, quick: bool, corpus: str) -> dict:
+    exe = os.path.join(build, "btelem_bench")
+    if not os.path.exists(exe):
+        sys.exit(f"{exe} not found; build the btelem_bench target first")
+    with tempfile.NamedTemporaryFile(suffix=".json", delete=False) as f:
+        out = f.name
+    try:
+        cmd = [exe, "--json", out, "--corpus", corpus] + (["--quick"] if quick else [])
+        subprocess.run(cmd, check=True, stderr=subprocess.DEVNULL)
+        with open(out) as f:
+            return json.load(f)
+    finally:
+        os.unlink(out)
+
+
+def _best_of(rounds: int, fn) -> tuple[float, int]:
+    """Smallest wall time over `rounds` calls of fn(), with fn's count."""
+    best, count = float("inf"), 0
+    for _ in range(rounds):
+        t0 = time.perf_counter()
+        count = fn()
+        best = min(best, time.perf_counter() - t0)
+    return best, count
+
+
+def run_python(corpus: str, rounds: int) -> list[dict]:
+    """Decode the corpus with the pure-Python reader and the C extension."""
+    results = []
+    try:
+        from btelem.storage import LogReader
+    except ImportError as e:
+        print(f"python: skipped ({e})", file=sys.stderr)
+        return results
+
+    def entries() -> int:
+        with LogReader(corpus) as r:
+            return sum(1 for _ in r.entries())
+
+    secs, n = _best_of(rounds, entries)
+    results.append(_result("decode/python/entries", n / secs / 1e6, "Mentries/s"))
+
+    try:
+        import numpy  # noqa: F401
+        from btelem.capture import Capture
+    except ImportError as e:
+        print(f"python native: skipped ({e})", file=sys.stderr)
+        return results
+
+    def native() -> int:
+        with Capture(corpus) as cap:
+            counts = cap.entry_counts()
+            for name in counts:
+                cap.table(name)
+            return sum(counts.values())
+
+    secs, n = _best_of(rounds, native)
+    results.append(_result("decode/native/table", n / secs / 1e6, "Mentries/s"))
+    return results
+
+
+def run_rust(corpus: str, rounds: int, xtask: str | None) -> list[dict]:
+    args = ["decode-bench", "--file", os.path.abspath(corpus), "--rounds", str(rounds)]
+    if xtask:
+        cmd = [os.path.abspath(xtask)] + args
+    elif shutil.which("cargo"):
+        cmd = ["cargo", "run", "-q", "-p", "xtask", "--release", "--"] + args
+    else:
+        print("rust: skipped (cargo not found)", file=sys.stderr)
+        return []
+    try:
+        out = subprocess.run(cmd, cwd=os.path.join(ROOT, "viewer"), check=True,
+                             capture_output=True, text=True).stdout
+    except subprocess.CalledProcessError as e:
+        print(f"rust: skipped (xtask failed: {e.stderr.strip()[-200:]})", file=sys.stderr)
+        return []
+    results = json.loads(out.strip().splitlines()[-1])["results"]
+    for r in results:
+        _result(r["name"], r["value"], r["unit"], r["better"])
+    return results
+
+
+def _result(name: str, value: float, unit: str, better: str = "higher") -> dict:
+    print(f"  {name:<36} {value:10.2f} {unit}")
+    return {"name": name, "value": value, "unit": unit, "better": better}
+
+
+def host_info() -> dict:
+    cpu = platform.processor() or platform.machine()
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    cpu = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    rev = subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=ROOT,
+                         capture_output=True, text=True).stdout.strip()
+    return {
+        "cpu": cpu,
+        "cpus": os.cpu_count(),
+        "system": f"{platform.system()} {platform.release()}",
+        "python": platform.python_version(),
+        "git": rev,
+        "date": datetime.date.today().isoformat(),
+    }
+
+
+# ---------------------------------------------------------------------------
+# Compare
+# ---------------------------------------------------------------------------
+
+def compare(base: dict, new: dict, threshold: float) -> int:
+    """Print per-result change against `base`; return the regression count."""
+    old = {r["name"]: r for r in base["results"]}
+    regressions = 0
+    print(f"\n{'result':<40} {'base':>10} {'new':>10} {'change':>8}")
+    for r in new["results"]:
+        b = old.get(r["name"])
+        if b is None or b["value"] == 0:
+            continue
+        change = (r["value"] - b["value"]) / b["value"] * 100.0
+        worse = -change if r["better"] == "higher" else change
+        flag = ""
+        if worse > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{r['name']:<40} {b['value']:>10.2f} {r['value']:>10.2f} "
+              f"{change:>+7.1f}%{flag}")
+    print(f"\n{regressions} regression(s) beyond {threshold:g}%")
+    return regressions
+
+
+# ---------------------------------------------------------------------------
+# Markdown
+# ---------------------------------------------------------------------------
+
+def _table(rows: list[tuple], header: tuple) -> list[str]:
+    lines = ["| " + " | ".join(header) + " |",
+             "|" + "|".join("-" * (len(h) + 2) for h in header) + "|"]
+    lines += ["| " + " | ".join(str(c) for c in row) + " |" for row in rows]
+    return lines
+
+
+def render(report: dict) -> str:
+    vals = {r["name"]: r["value"] for r in report["results"]}
+    host = report.get("host", {})
+    desc = os.environ.get("BTELEM_BENCH_MARKDOWN_HOST") or \
+        f"{host.get('cpu', '?')}, {host.get('cpus', '?')} CPU(s), {host.get('system', '?')}"
+    out = [BEGIN,
+           "<!-- Generated by tests/bench.py; edit the script, not this section. -->",
+           "",
+           "## End-to-end suite (`btelem_bench`)",
+           "",
+           f"{desc}; commit `{host.get('git', '?')}`, {host.get('date', '?')}"
+           f"{' (quick run)' if report.get('quick') else ''}.",
+           ""]
+
+    def v(name, fmt="{:.1f}"):
+        return fmt.format(vals[name]) if name in vals else "-"
+
+    out += ["### Drain throughput (`btelem_drain_packed`)", ""]
+    out += _table([(mix, v(f"drain/{mix}"), v(f"drain/{mix}/bandwidth", "{:.0f}"))
+                   for mix in ("small", "medium", "max", "mixed")],
+                  ("Payload", "M entries/s", "MB/s"))
+    out += [""]
+    out += _table([(f"{k} of 8 IDs", v(f"drain/filter/{k}of8"))
+                   for k in (8, 4, 1)],
+                  ("Filter", "M entries scanned/s"))
+
+    cont = sorted({n.split("/")[1] for n in vals if n.startswith("contention/")})
+    if cont:
+        out += ["", "### Producers vs concurrent drainers", ""]
+        rows = []
+        for c in cont:
+            p, d = c[1:].split("_d")
+            rows.append((p, d, v(f"contention/{c}/log"),
+                         v(f"contention/{c}/delivered", "{:.1f}%")))
+        out += _table(rows, ("Producers", "Drainers", "Log M entries/s",
+                             "Delivered per drainer"))
+
+    tcp = sorted({int(n.split("/")[1].split("_")[0]) for n in vals
+                  if n.startswith("tcp/")})
+    if tcp:
+        out += ["", "### TCP server (`btelem_serve`)", ""]
+        out += _table([(k, v(f"tcp/{k}_viewers/entries", "{:.2f}"),
+                        v(f"tcp/{k}_viewers/bandwidth", "{:.0f}"),
+                        v(f"tcp/{k}_viewers/delivered", "{:.0f}%"))
+                       for k in tcp],
+                      ("Viewers", "Aggregate M entries/s", "MB/s", "Delivered"))
+
+    lat = []
+    for n in vals:
+        if n.startswith("latency/") and n.endswith("/p50"):
+            lat.append(n[:-len("/p50")])
+    if lat:
+        out += ["", "### Producer-to-viewer latency (us)", ""]
+        rows = [(name.split("/")[1], name.split("/")[2],
+                 *(v(f"{name}/{p}", "{:.0f}") for p in ("p50", "p90", "p99", "p99.9", "max")))
+                for name in lat]
+        out += _table(rows, ("Server", "Rate", "p50", "p90", "p99", "p99.9", "max"))
+
+    dec = [n for n in vals if n.startswith("decode/")]
+    if dec:
+        corpus = report.get("corpus", {})
+        out += ["", "### Decoders", "",
+                f"Over the {corpus.get('entries', '?')}-entry mixed corpus.", ""]
+        out += _table([(n[len("decode/"):], v(n, "{:.2f}")) for n in dec],
+                      ("Decoder", "M entries/s"))
+
+    out += ["", END]
+    return "\n".join(out)
+
+
+def write_markdown(path: str, report: dict) -> None:
+    with open(path) as f:
+        text = f.read()
+    section = render(report)
+    if BEGIN in text and END in text:
+        head, rest = text.split(BEGIN, 1)
+        tail = rest.split(END, 1)[1]
+        text = head + section + tail
+    else:
+        text = text.rstrip("\n") + "\n\n" + section + "\n"
+    with open(path, "w") as f:
+        f.write(text)
+    print(f"wrote {path}")
+
+
+# ---------------------------------------------------------------------------
+# Main
+# ---------------------------------------------------------------------------
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("--build", default="build-bench", help="directory holding btelem_bench")
+    ap.add_argument("--quick", action="store_true", help="shorter runs (smoke test)")
+    ap.add_argument("--out", help="write the merged JSON report here")
+    ap.add_argument("--from", dest="from_report", help="use this report instead of running")
+    ap.add_argument("--compare", help="baseline report to compare against")
+    ap.add_argument("--threshold", type=float, default=10.0,
+                    help="percent worse that counts as a regression (default 10)")
+    ap.add_argument("--markdown", help="regenerate the results section of this file")
+    ap.add_argument("--rounds", type=int, default=3, help="decoder runs, best is kept")
+    ap.add_argument("--no-rust", action="store_true", help="skip the Rust decoder")
+    ap.add_argument("--xtask", help="prebuilt xtask binary (default: cargo run)")
+    args = ap.parse_args()
+
+    if args.from_report:
+        with open(args.from_report) as f:
+            report = json.load(f)
+    else:
+        with tempfile.TemporaryDirectory() as tmp:
+            corpus = os.path.join(tmp, "corpus.btlm")
+            report = run_c(args.build, args.quick, corpus)
+            print("\ndecoders:")
+            report["results"] += run_python(corpus, args.rounds)
+            if not args.no_rust:
+                report["results"] += run_rust(corpus, args.rounds, args.xtask)
+        # The corpus lived in the temporary directory; keep only its size
+        report.get("corpus", {}).pop("path", None)
+        report["host"] = host_info()
+
+    if args.out:
+        with open(args.out, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+    if args.markdown:
+        write_markdown(args.markdown, report)
+    if args.compare:
+        with open(args.compare) as f:
+            base = json.load(f)
+        if compare(base, report, args.threshold):
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
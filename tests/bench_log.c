@@ -115,6 +115,30 @@ static void bench_max(void)
            BTELEM_MAX_PAYLOAD, ns, 1000.0 / ns);
 }
 
+#define BATCH_SIZE 16
+
+static void bench_batch(void)
+{
+    struct payload_medium d[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        d[i].a = (uint32_t)i;
+        d[i].b = 2;
+        d[i].c = 3;
+    }
+
+    for (int i = 0; i < WARMUP / BATCH_SIZE; i++)
+        BTELEM_LOG_BATCH(&ctx, MEDIUM, d, BATCH_SIZE, 1000);
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < ITERATIONS / BATCH_SIZE; i++)
+        BTELEM_LOG_BATCH(&ctx, MEDIUM, d, BATCH_SIZE, 1000);
+    uint64_t t1 = now_ns();
+
+    double ns = (double)(t1 - t0) / ((ITERATIONS / BATCH_SIZE) * BATCH_SIZE);
+    printf("  medium (16B) x%d batch: %6.1f ns/entry  %6.1f M entries/s\n",
+           BATCH_SIZE, ns, 1000.0 / ns);
+}
+
 /* --------------------------------------------------------------------------
  * Multi-thread benchmark
  * ----------------------------------------------------------------------- */
@@ -142,7 +166,27 @@ static void *thread_bench_medium(void *arg)
     return NULL;
 }
 
-static void bench_threaded(int nthreads)
+static struct btelem_ctx shard_ctx;
+
+static void *thread_bench_sharded(void *arg)
+{
+    struct thread_arg *ta = (struct thread_arg *)arg;
+    struct payload_medium d = { .a = 1, .b = 2, .c = 3 };
+
+    /* Warmup (first log binds this thread to a shard) */
+    for (int i = 0; i < WARMUP; i++)
+        BTELEM_LOG(&shard_ctx, MEDIUM, d);
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < ta->iterations; i++)
+        BTELEM_LOG(&shard_ctx, MEDIUM, d);
+    uint64_t t1 = now_ns();
+
+    ta->elapsed_ns = t1 - t0;
+    return NULL;
+}
+
+static void bench_threaded(int nthreads, int sharded)
 {
     int per_thread = ITERATIONS;
 
@@ -154,9 +198,20 @@ static void bench_threaded(int nthreads)
         args[i].elapsed_ns = 0;
     }
 
+    /* Fresh sharded context per run so every thread gets its own shard */
+    uint8_t *shard_mem = NULL;
+    if (sharded) {
+        shard_mem = calloc(1, btelem_ring_size_sharded((uint32_t)nthreads, RING_ENTRIES));
+        if (!shard_mem) { perror("calloc"); exit(1); }
+        btelem_init_sharded(&shard_ctx, shard_mem, (uint32_t)nthreads, RING_ENTRIES);
+        btelem_register(&shard_ctx, &btelem_schema_MEDIUM);
+    }
+
     uint64_t wall_t0 = now_ns();
     for (int i = 0; i < nthreads; i++)
-        pthread_create(&threads[i], NULL, thread_bench_medium, &args[i]);
+        pthread_create(&threads[i], NULL,
+                       sharded ? thread_bench_sharded : thread_bench_medium,
+                       &args[i]);
     for (int i = 0; i < nthreads; i++)
         pthread_join(threads[i], NULL);
     uint64_t wall_t1 = now_ns();
@@ -177,6 +232,7 @@ static void bench_threaded(int nthreads)
 
     free(threads);
     free(args);
+    free(shard_mem);
 }
 
 /* --------------------------------------------------------------------------
@@ -204,11 +260,20 @@ int main(void)
     bench_medium();
     bench_max();
 
+    printf("\nBatched (BTELEM_LOG_BATCH, one atomic + timestamp per batch):\n");
+    bench_batch();
+
     printf("\nMulti-thread (16B payload):\n");
-    bench_threaded(1);
-    bench_threaded(2);
-    bench_threaded(4);
-    bench_threaded(8);
+    bench_threaded(1, 0);
+    bench_threaded(2, 0);
+    bench_threaded(4, 0);
+    bench_threaded(8, 0);
+
+    printf("\nMulti-thread sharded (16B payload, one shard per thread):\n");
+    bench_threaded(1, 1);
+    bench_threaded(2, 1);
+    bench_threaded(4, 1);
+    bench_threaded(8, 1);
 
     free(ring_mem);
     return 0;
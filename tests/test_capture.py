@@ -6,15 +6,23 @@ Run from repo root:
 
 import sys
 import os
+import socket
 import struct
 import tempfile
+import threading
+import time
 
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "python"))
 
 import numpy as np
 
-from btelem.schema import Schema, SchemaEntry, FieldDef, BtelemType
-from btelem.storage import LogWriter, build_packet
+from btelem.schema import (
+    Schema, SchemaEntry, FieldDef, BitDef, BtelemType, ClockCalibration,
+)
+from btelem.decoder import (
+    PacketDecoder, compress_packet, decode_packet, decode_packet_arrays,
+)
+from btelem.storage import LogReader, LogWriter, build_packet
 from btelem._native import Capture, LiveCapture
 
 
@@ -241,6 +249,38 @@ def test_live_capture_series():
     assert len(ts) == 1
     np.testing.assert_array_equal(rpm, [3200])
 
+    # The held packets were decoded with this schema: no swapping it
+    try:
+        live.__init__(schema_bytes)
+        assert False, "expected RuntimeError"
+    except RuntimeError:
+        pass
+
+    print(" OK")
+
+
+def test_live_capture_malformed():
+    """Plain packets whose table or payloads overrun the packet are refused."""
+    print("test_live_capture_malformed...", end="")
+
+    live = LiveCapture(make_test_schema().to_bytes())
+    good = build_packet([
+        (0, 1000, make_sensor_payload(25.0, 101.0, 1)),
+        (0, 2000, make_sensor_payload(26.0, 102.0, 2)),
+    ])
+    bad_offset = bytearray(good)
+    struct.pack_into("<I", bad_offset, 16 + 4, 0xFFFFFFF0)
+    for pkt in (good[:16 + 16], good[:-1], bytes(bad_offset)):
+        try:
+            live.add_packet(pkt)
+            assert False, "expected ValueError"
+        except ValueError:
+            pass
+
+    live.add_packet(good)
+    ts, _ = live.series("sensor_data", "temperature")
+    np.testing.assert_array_equal(ts, [1000, 2000])
+
     print(" OK")
 
 
@@ -315,6 +355,143 @@ def test_live_capture_table():
     print(" OK")
 
 
+def test_live_capture_rolling_window():
+    """max_packets / max_bytes keep the newest packets, dropping whole segments."""
+    print("test_live_capture_rolling_window...", end="")
+
+    schema = make_test_schema()
+    packets = [build_packet([(0, i * 10 + j, make_sensor_payload(float(i), 0.0, i)) for j in range(4)])
+               for i in range(1000)]
+
+    for kwargs in ({"max_packets": 200}, {"max_bytes": 40000}):
+        live = LiveCapture(schema.to_bytes(), **kwargs)
+        for pkt in packets:
+            live.add_packet(pkt)
+
+        held = live.packets
+        assert held + live.truncated_packets == 1000
+        assert live.truncated_entries == 4 * live.truncated_packets
+        assert live.bytes == held * len(packets[0])
+        if "max_packets" in kwargs:
+            assert 150 <= held <= 200
+        else:
+            assert 30000 <= live.bytes <= 40000
+
+        ts, status = live.series("sensor_data", "status")
+        assert len(ts) == 4 * held
+        np.testing.assert_array_equal(status[::4], np.arange(1000 - held, 1000))
+        assert live.time_range == ((1000 - held) * 10, 9993)
+
+    print(" OK")
+
+
+def test_live_capture_column_cache():
+    """Cached series() columns follow appends and eviction like a full scan."""
+    print("test_live_capture_column_cache...", end="")
+
+    schema = make_test_schema()
+    live = LiveCapture(schema.to_bytes(), max_packets=400)
+    live.series("sensor_data", "status")          # cached before any data
+
+    for i in range(2000):
+        entries = [(0, i * 10 + j, make_sensor_payload(float(i), float(j), i * 4 + j)) for j in range(4)]
+        if i % 7 == 0:
+            entries.append((1, i * 10 + 5, make_motor_payload(i % 1000, -1, 0)))
+        live.add_packet(build_packet(entries))
+        if i == 900:
+            live.series("motor_state", "rpm")     # cached mid-stream
+
+        if i % 250 == 249:
+            t1 = i * 10
+            for entry, field in (("sensor_data", "status"), ("sensor_data", "pressure"),
+                                 ("motor_state", "rpm")):
+                for t0, t1_ in ((None, None), (t1 - 1500, None), (t1 - 1500, t1 - 700)):
+                    ts, vals = live.series(entry, field, t0=t0, t1=t1_)
+                    ref_ts, ref_vals = live.series(entry, field, t0=t0, t1=t1_, cache=False)
+                    np.testing.assert_array_equal(ts, ref_ts)
+                    np.testing.assert_array_equal(vals, ref_vals)
+
+    assert live.truncated_packets > 0
+    ts, status = live.series("sensor_data", "status")
+    assert len(ts) == 4 * live.packets
+    assert status[-1] == 1999 * 4 + 3
+
+    live.clear()
+    ts, _ = live.series("sensor_data", "status")
+    assert len(ts) == 0
+    live.clear_cache()
+
+    print(" OK")
+
+
+def test_live_capture_attach_socket():
+    """attach_socket() ingests a length-prefixed stream on its own thread."""
+    print("test_live_capture_attach_socket...", end="")
+
+    schema = make_test_schema()
+    stream = bytearray()
+    for i in range(500):
+        entries = [(0, i * 10 + j, make_sensor_payload(float(i), float(j), i * 4 + j)) for j in range(4)]
+        pkt = build_packet(entries)
+        if i % 2:
+            pkt = compress_packet(pkt) or pkt
+        stream += struct.pack("<I", len(pkt)) + pkt
+
+    a, b = socket.socketpair()
+    try:
+        live = LiveCapture(schema.to_bytes())
+        live.attach_socket(a, buffer_bytes=4096)
+        try:
+            live.attach_socket(a)
+            assert False, "expected RuntimeError"
+        except RuntimeError:
+            pass
+
+        def send():
+            for pos in range(0, len(stream), 1000):
+                b.sendall(stream[pos:pos + 1000])
+            b.shutdown(socket.SHUT_WR)
+
+        sender = threading.Thread(target=send)
+        sender.start()
+        while live.receive_stats()["running"]:
+            live.series("sensor_data", "status")      # queries run alongside
+        sender.join()
+
+        stats = live.receive_stats()
+        assert stats["eof"] and stats["error"] is None
+        assert stats["bytes"] == len(stream) and stats["packets"] == 500
+        live.detach_socket()
+        assert live.receive_stats() is None
+
+        ts, status = live.series("sensor_data", "status")
+        np.testing.assert_array_equal(ts, [i * 10 + j for i in range(500) for j in range(4)])
+        np.testing.assert_array_equal(status, np.arange(2000))
+    finally:
+        a.close()
+        b.close()
+
+    # A length prefix past the limit stops the thread; detach reports it
+    a, b = socket.socketpair()
+    try:
+        live = LiveCapture(schema.to_bytes())
+        live.attach_socket(a.fileno())
+        b.sendall(bytes(stream[:4 + struct.unpack_from("<I", stream)[0]]) + b"\xff" * 4)
+        while live.receive_stats()["running"]:
+            time.sleep(0.01)
+        try:
+            live.detach_socket()
+            assert False, "expected ValueError"
+        except ValueError:
+            pass
+        assert live.packets == 1
+    finally:
+        a.close()
+        b.close()
+
+    print(" OK")
+
+
 def test_empty_results():
     """Empty results return zero-length arrays with correct dtype."""
     print("test_empty_results...", end="")
@@ -444,6 +621,249 @@ def test_read_c_generated_log():
     print(" OK")
 
 
+def test_compressed_packets():
+    """Capture and LiveCapture expand compressed packets on the way in."""
+    print("test_compressed_packets...", end="")
+
+    schema = make_test_schema()
+    packets = [
+        [(0, t0 + i * 100, make_sensor_payload(25.0 + i, 101.0, 1)) for i in range(20)]
+        + [(1, t0 + 50, make_motor_payload(3200, 450, 0))]
+        for t0 in (1000, 10_000, 20_000)
+    ]
+    want_ts = [t0 + i * 100 for t0 in (1000, 10_000, 20_000) for i in range(20)]
+
+    live = LiveCapture(schema.to_bytes())
+    for entries in packets:
+        live.add_packet(compress_packet(build_packet(entries)))
+    ts, temp = live.series("sensor_data", "temperature")
+    np.testing.assert_array_equal(ts, want_ts)
+    np.testing.assert_allclose(temp[:20], 25.0 + np.arange(20), rtol=1e-5)
+    assert live.entry_counts() == {"sensor_data": 60, "motor_state": 3}
+    try:
+        live.add_packet(compress_packet(build_packet(packets[0]))[:-1])
+        assert False, "expected ValueError"
+    except ValueError:
+        pass
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+    try:
+        with LogWriter(tmppath, schema, compress=True) as w:
+            for entries in packets:
+                w.write_entries(entries)
+        with Capture(tmppath) as cap:
+            ts, rpm = cap.series("motor_state", "rpm", t0=10_000)
+            np.testing.assert_array_equal(ts, [10_050, 20_050])
+            np.testing.assert_array_equal(rpm, [3200, 3200])
+            table = cap.table("sensor_data")
+            np.testing.assert_array_equal(table["_timestamp"], want_ts)
+            assert cap.time_range == (1000, 21_900)
+
+        # Without the footer the packets are found by scanning
+        with open(tmppath, "rb") as f:
+            data = f.read()
+        index_offset = struct.unpack_from("<Q", data, len(data) - 16)[0]
+        ids_offset = struct.unpack_from("<Q", data, index_offset - 16)[0]
+        with open(tmppath, "wb") as f:
+            f.write(data[:ids_offset])
+        with Capture(tmppath) as cap:
+            ts, _ = cap.series("sensor_data", "temperature")
+            np.testing.assert_array_equal(ts, want_ts)
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
+def test_id_summary():
+    """Queries for a rare ID agree with and without the index ID summary."""
+    print("test_id_summary...", end="")
+
+    schema = make_test_schema()
+    packets = []
+    for p in range(30):
+        entries = [(0, p * 1000 + i * 10, make_sensor_payload(float(p), 0.0, i)) for i in range(40)]
+        if p % 10 == 4:
+            entries.insert(7, (1, p * 1000 + 75, make_motor_payload(p, -p, 1)))
+        packets.append(entries)
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+    try:
+        write_test_file(tmppath, schema, packets)
+        with open(tmppath, "rb") as f:
+            data = f.read()
+        index_offset, count, magic = struct.unpack_from("<QII", data, len(data) - 16)
+        ids_offset = struct.unpack_from("<Q", data, index_offset - 16)[0]
+        v1 = (data[:ids_offset] + data[index_offset:-16]
+              + struct.pack("<QII", ids_offset, count, magic))
+
+        results = []
+        for blob in (data, v1):
+            with open(tmppath, "wb") as f:
+                f.write(blob)
+            with Capture(tmppath) as cap:
+                assert cap.entry_counts() == {"sensor_data": 1200, "motor_state": 3}
+                ts, rpm = cap.series("motor_state", "rpm")
+                np.testing.assert_array_equal(ts, [4075, 14075, 24075])
+                np.testing.assert_array_equal(rpm, [4, 14, 24])
+                ts, _ = cap.series("motor_state", "rpm", t0=4080, t1=24075)
+                np.testing.assert_array_equal(ts, [14075, 24075])
+                table = cap.table("sensor_data", t0=14005, t1=14999)
+                results.append(len(table["_timestamp"]))
+        assert results == [39, 39]
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
+def test_series_many_threads():
+    """series_many() and thread counts agree with single-threaded series()."""
+    print("test_series_many_threads...", end="")
+
+    schema = make_test_schema()
+    packets = []
+    for p in range(2000):
+        entries = [(0, p * 100 + i, make_sensor_payload(float(p), float(i), p * 10 + i)) for i in range(8)]
+        if p % 3 == 0:
+            entries.append((1, p * 100 + 50, make_motor_payload(p % 30000, -(p % 1000), p % 2)))
+        packets.append(entries)
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+    try:
+        write_test_file(tmppath, schema, packets)
+        fields = [("sensor_data", "status"), ("motor_state", "rpm"),
+                  ("sensor_data", "temperature"), ("motor_state", "fault")]
+        with Capture(tmppath) as cap:
+            for t0, t1 in ((None, None), (12345, 150000), (199950, None)):
+                ref = [cap.series(e, f, t0=t0, t1=t1, threads=1) for e, f in fields]
+                for threads in (1, 4, 0):
+                    many = cap.series_many(fields, t0=t0, t1=t1, threads=threads)
+                    assert len(many) == len(fields)
+                    for (ts, vals), (ref_ts, ref_vals) in zip(many, ref):
+                        np.testing.assert_array_equal(ts, ref_ts)
+                        np.testing.assert_array_equal(vals, ref_vals)
+                    # Fields of one entry share a timestamp array
+                    assert many[0][0] is many[2][0]
+                    table = cap.table("sensor_data", t0=t0, t1=t1, threads=threads)
+                    np.testing.assert_array_equal(table["status"], ref[0][1])
+
+            ts, status = cap.series("sensor_data", "status", threads=8)
+            assert len(ts) == 16000
+            np.testing.assert_array_equal(status[:10], [0, 1, 2, 3, 4, 5, 6, 7, 10, 11])
+            assert cap.series_many([]) == []
+
+        live = LiveCapture(schema.to_bytes())
+        for entries in packets[:500]:
+            live.add_packet(build_packet(entries))
+        (ts, rpm), = live.series_many([("motor_state", "rpm")], threads=3)
+        ref_ts, ref_rpm = live.series("motor_state", "rpm")
+        np.testing.assert_array_equal(ts, ref_ts)
+        np.testing.assert_array_equal(rpm, ref_rpm)
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
+def test_decode_arrays():
+    """decode_packet_arrays / feed_arrays / LogReader.arrays match decode_packet."""
+    print("test_decode_arrays...", end="")
+
+    base = make_test_schema()
+    schema = Schema(list(base.entries.values()) + [
+        SchemaEntry(2, "mixed", "Arrays, bits and strings", 24, [
+            FieldDef("axes", 0, 6, BtelemType.I16, count=3),
+            FieldDef("flags", 8, 2, BtelemType.BITFIELD, bitfield_bits=[
+                BitDef("armed", 0, 1), BitDef("mode", 1, 3)]),
+            FieldDef("state", 10, 1, BtelemType.ENUM, enum_labels=["OFF", "ON"]),
+            FieldDef("tag", 12, 8, BtelemType.STRING),
+            FieldDef("gain", 20, 4, BtelemType.F32),
+        ]),
+    ])
+    dt = schema.dtype(2)
+    assert dt.itemsize == 24
+    assert dt.fields["axes"][0].shape == (3,) and dt.fields["gain"][1] == 20
+
+    def mixed(i):
+        return struct.pack("<3hxxHB x8sf", i, -i, 2 * i, (i & 7) << 1 | (i & 1),
+                           i & 1, b"t%d" % i, 0.5 * i)
+
+    packets = [
+        [(0, 1000 * k + i, make_sensor_payload(float(i), 100.0 + k, i)) for i in range(5)]
+        + [(2, 1000 * k + 10 + i, mixed(i)) for i in range(4)]
+        + [(1, 1000 * k + 20, make_motor_payload(k, -k, k & 1)), (7, 1000 * k + 30, b"??")]
+        for k in range(1, 4)
+    ]
+    raw = [build_packet(e) for e in packets]
+
+    # One packet: every schema ID comes back as columns matching decode_packet()
+    got = decode_packet_arrays(schema, raw[0]).arrays
+    assert sorted(got) == [0, 1, 2]
+    ref = decode_packet(schema, raw[0]).entries
+    for entry_id, ea in got.items():
+        want = [e for e in ref if e.id == entry_id]
+        assert ea.name == schema.entries[entry_id].name
+        np.testing.assert_array_equal(ea.timestamps, [e.timestamp for e in want])
+        for f in schema.entries[entry_id].fields:
+            col = ea.values[f.name]
+            for j, e in enumerate(want):
+                v = e.fields[f.name]
+                if f.type == BtelemType.BITFIELD:
+                    assert f.split_bits(int(col[j])) == v
+                elif f.type == BtelemType.ENUM:
+                    assert f.enum_labels[col[j]] == v
+                elif f.type == BtelemType.STRING:
+                    assert col[j].decode() == v
+                elif f.count > 1:
+                    assert col[j].tolist() == v
+                else:
+                    assert col[j] == v
+    bits = schema.entries[2].fields[1].split_bits(got[2].values["flags"])
+    np.testing.assert_array_equal(bits["mode"], [i & 7 for i in range(4)])
+
+    # Gathered (interleaved) payloads decode like packed ones
+    order = [0, 5, 1, 6, 2, 7, 3, 8, 4, 9, 10]
+    mixed_up = decode_packet_arrays(schema, build_packet([packets[0][i] for i in order])).arrays
+    for entry_id in (0, 2):
+        assert mixed_up[entry_id].values.tobytes() == got[entry_id].values.tobytes()
+    assert sorted(decode_packet_arrays(schema, raw[0], {1, 7}).arrays) == [1]
+
+    # Stream: split writes, a clock update and a compressed packet
+    clock = ClockCalibration(tick_hz=1000, ref_ticks=1000, ref_ns=5_000_000_000)
+    clock_pkt = struct.pack("<HHIII", 0, 0x0001, 32, 0, 0) + clock.to_bytes()
+    stream = b"".join(struct.pack("<I", len(p)) + p for p in
+                      [raw[0], clock_pkt, compress_packet(raw[1]), raw[2]])
+    dec = PacketDecoder(Schema(list(schema.entries.values())))
+    parts = [dec.feed_arrays(stream[i:i + 97]) for i in range(0, len(stream), 97)]
+    ts = np.concatenate([p[0].timestamps for p in parts if 0 in p])
+    want = [1000 + i for i in range(5)] + [
+        clock.to_ns(1000 * k + i) for k in (2, 3) for i in range(5)]
+    np.testing.assert_array_equal(ts, want)
+    assert ts.dtype == np.uint64
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+    try:
+        write_test_file(tmppath, schema, packets)
+        with LogReader(tmppath) as reader:
+            arrays = reader.arrays()
+            np.testing.assert_array_equal(arrays[1].values["rpm"], [1, 2, 3])
+            window = reader.arrays(ts_min=2002, ts_max=2012, filter_ids={0, 2})
+            np.testing.assert_array_equal(window[0].timestamps, [2002, 2003, 2004])
+            np.testing.assert_array_equal(window[2].values["axes"][:, 1], [0, -1, -2])
+            want = [(e.id, e.timestamp) for e in reader.entries(ts_min=2002, ts_max=2012)]
+            assert sorted(want) == [(0, t) for t in (2002, 2003, 2004)] + [
+                (2, t) for t in (2010, 2011, 2012)]
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
 if __name__ == "__main__":
     print("btelem Capture/LiveCapture tests")
     print("=================================\n")
@@ -453,12 +873,20 @@ if __name__ == "__main__":
     test_capture_table()
     test_capture_context_manager()
     test_live_capture_series()
+    test_live_capture_malformed()
     test_live_capture_clear()
     test_live_capture_time_range()
     test_live_capture_table()
+    test_live_capture_rolling_window()
+    test_live_capture_column_cache()
+    test_live_capture_attach_socket()
     test_empty_results()
     test_no_footer_fallback()
     test_unknown_entry_raises()
     test_read_c_generated_log()
+    test_compressed_packets()
+    test_id_summary()
+    test_series_many_threads()
+    test_decode_arrays()
 
     print("\nAll capture tests passed.")
@@ -5,9 +5,11 @@
  * Each counter increments by (index + 1) per sample:
  *   c0 += 1, c1 += 2, c2 += 3, ... c7 += 8
  *
- * Usage: ./btelem_test_counter_server PORT [NUM_ENTRIES] [RATE_HZ]
+ * Usage: ./btelem_test_counter_server [--udp] PORT [NUM_ENTRIES] [RATE_HZ]
  *   Default NUM_ENTRIES = 2000000 (2M).  Pass 0 for unlimited.
  *   Default RATE_HZ     = 0 (max rate).  Pass e.g. 1000 to throttle.
+ *   --udp sends binary UDP datagrams to 127.0.0.1:PORT instead of
+ *   listening for TCP.
  */
 
 #include <stdio.h>
@@ -17,6 +19,7 @@
 #include <unistd.h>
 
 #include "btelem/btelem_serve.h"
+#include "btelem/btelem_serve_udp.h"
 
 /* --------------------------------------------------------------------------
  * Schema
@@ -50,11 +53,17 @@ static void handle_signal(int sig)
 
 int main(int argc, char *argv[])
 {
+    const char *prog = argv[0];
+    int udp = (argc >= 2 && strcmp(argv[1], "--udp") == 0);
+    if (udp) {
+        argv++;
+        argc--;
+    }
     if (argc < 2) {
-        fprintf(stderr, "usage: %s PORT [NUM_ENTRIES] [RATE_HZ]\n"
+        fprintf(stderr, "usage: %s [--udp] PORT [NUM_ENTRIES] [RATE_HZ]\n"
                         "  NUM_ENTRIES=0 -> run forever\n"
                         "  RATE_HZ=0     -> max rate (default)\n",
-                argv[0]);
+                prog);
         return 1;
     }
 
@@ -79,10 +88,14 @@ int main(int argc, char *argv[])
     btelem_init(&ctx, ring_mem, RING_ENTRIES);
     btelem_register(&ctx, &btelem_schema_COUNTERS);
 
-    struct btelem_server srv;
-    memset(&srv, 0, sizeof(srv));
-    if (btelem_serve(&srv, &ctx, "127.0.0.1", (uint16_t)port) < 0) {
-        fprintf(stderr, "btelem_serve failed on port %d\n", port);
+    static struct btelem_server srv;
+    static struct btelem_udp_server udp_srv;
+    int rc = udp ? btelem_serve_udp_binary(&udp_srv, &ctx, "127.0.0.1",
+                                           (uint16_t)port, 0)
+                 : btelem_serve(&srv, &ctx, "127.0.0.1", (uint16_t)port);
+    if (rc < 0) {
+        fprintf(stderr, "%s failed on port %d\n",
+                udp ? "btelem_serve_udp_binary" : "btelem_serve", port);
         free(ring_mem);
         return 1;
     }
@@ -112,7 +125,10 @@ int main(int argc, char *argv[])
     /* Let drain loop flush */
     usleep(200000);
 
-    btelem_server_stop(&srv);
+    if (udp)
+        btelem_udp_server_stop(&udp_srv);
+    else
+        btelem_server_stop(&srv);
     free(ring_mem);
     return 0;
 }
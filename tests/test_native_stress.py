@@ -172,7 +172,7 @@ def test_stress_table():
 
 
 def test_stress_rolling_window():
-    """LiveCapture with max_packets — exercises compaction + query together."""
+    """LiveCapture with max_packets — exercises segment eviction + query together."""
     print("test_stress_rolling_window (50k packets, max_packets=5000)...", end="", flush=True)
 
     schema = make_stress_schema()
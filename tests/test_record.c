@@ -0,0 +1,787 @@
+/**
+ * btelem recorder test
+ *
+ * Runs btelem_record_start() against a temporary directory and parses the
+ * .btlm files it leaves.  Verifies that:
+ *   - The header, compact schema, packets, ID summary and index trailer are
+ *     consistent and every logged entry is in the file, in order.
+ *   - Compressed recording stores smaller packets that expand to the same
+ *     entries.
+ *   - Size- and time-based rotation produce several complete files, each
+ *     within the size limit.
+ *   - A lossless (spilling) recorder keeps every entry through a drain
+ *     stall several rings long.
+ *   - A triggered (flight) recorder writes nothing until btelem_trigger(),
+ *     then one file per window holding the ring's history and what follows.
+ *   - btelem_record_stop() returns promptly while producers keep logging.
+ *
+ * Also prints the recording throughput.
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "btelem/btelem_record.h"
+
+/* --------------------------------------------------------------------------
+ * Config
+ * ----------------------------------------------------------------------- */
+
+#define RING_ENTRIES       (1 << 16)
+#define PLAIN_ENTRIES      50000
+#define BATCH_ENTRIES      5000
+#define ROTATE_BATCHES     40
+#define ROTATE_BYTES       (256u << 10)
+#define BENCH_ENTRIES      2000000
+#define LOSSLESS_ENTRIES   150000
+#define SPILL_ENTRIES      (1u << 18)
+#define TRIGGER_POST_MS    1000
+#define STOP_LIMIT_S       2.0
+#define FLOOD_THREADS      4
+#define MAX_FILES          128
+#define TEST_TIMEOUT_SEC   60
+
+/* --------------------------------------------------------------------------
+ * Schema
+ * ----------------------------------------------------------------------- */
+
+struct seq_payload {
+    uint64_t seq;
+    double   value;
+    uint32_t mode;
+};
+
+static const struct btelem_field_def seq_fields[] = {
+    BTELEM_FIELD(struct seq_payload, seq, BTELEM_U64),
+    BTELEM_FIELD(struct seq_payload, value, BTELEM_F64),
+    BTELEM_FIELD(struct seq_payload, mode, BTELEM_U32),
+};
+BTELEM_SCHEMA_ENTRY(SEQ, 0, "seq", "Sequence counter", struct seq_payload, seq_fields);
+
+/* --------------------------------------------------------------------------
+ * Shared state and helpers
+ * ----------------------------------------------------------------------- */
+
+static struct btelem_ctx ctx;
+static char dir[64];
+static uint64_t next_seq;
+
+static double mono_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int setup(void)
+{
+    static void *ring;
+    if (!ring)
+        ring = malloc(btelem_ring_size(RING_ENTRIES));
+    if (!ring || btelem_init(&ctx, ring, RING_ENTRIES) < 0)
+        return -1;
+    btelem_register(&ctx, &btelem_schema_SEQ);
+    next_seq = 0;
+    return 0;
+}
+
+static void log_entries(int n)
+{
+    for (int i = 0; i < n; i++) {
+        struct seq_payload p = {
+            .seq = next_seq,
+            .value = (double)(next_seq / 64),
+            .mode = 3,
+        };
+        BTELEM_LOG(&ctx, SEQ, p);
+        next_seq++;
+    }
+}
+
+/* Log in batches the recorder can keep up with, so nothing is dropped */
+static void log_paced(int batches)
+{
+    for (int b = 0; b < batches; b++) {
+        log_entries(BATCH_ENTRIES);
+        usleep(5000);
+    }
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(n > 0 ? (size_t)n : 1);
+    if (data && fread(data, 1, (size_t)n, fp) != (size_t)n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *len = (size_t)n;
+    return data;
+}
+
+/* dir/<fmt...> into a PATH_MAX buffer; a truncated name is a test bug */
+static void dir_path(char *out, const char *fmt, ...)
+{
+    char name[NAME_MAX + 1];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(name, sizeof(name), fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(name)
+        || snprintf(out, PATH_MAX, "%s/%s", dir, name) >= PATH_MAX) {
+        fprintf(stderr, "path too long: %s/%s\n", dir, name);
+        exit(1);
+    }
+}
+
+static void remove_files(void)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+    struct dirent *de;
+    char path[PATH_MAX];
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        dir_path(path, "%s", de->d_name);
+        unlink(path);
+    }
+    closedir(d);
+}
+
+/* What check_file() found */
+struct file_info {
+    uint64_t packets;
+    uint64_t entries;
+    uint64_t compressed;
+    uint64_t plain_bytes;
+    size_t   size;
+};
+
+/* Parse one recorded file; entries must continue from *seq.  Returns the
+ * number of problems found (printed). */
+static int check_file(const char *path, uint64_t *seq, struct file_info *info)
+{
+    static uint8_t plain[BTELEM_RECORD_PKT];
+    memset(info, 0, sizeof(*info));
+
+    size_t len;
+    uint8_t *data = read_file(path, &len);
+    if (!data) {
+        printf("  %s: cannot read\n", path);
+        return 1;
+    }
+    info->size = len;
+
+    int bad = 0;
+    uint32_t schema_len = 0;
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    if (len >= 10) {
+        memcpy(&version, data + 4, 2);
+        memcpy(&schema_len, data + 6, 4);
+    }
+    if (len >= 14 + (size_t)schema_len)
+        memcpy(&magic, data + 10, 4);
+    if (len < 10 + (size_t)schema_len + sizeof(struct btelem_index_footer)
+        || memcmp(data, "BTLM", 4) != 0 || version != 1
+        || magic != BTELEM_SCHEMA_COMPACT_MAGIC) {
+        printf("  %s: bad header\n", path);
+        free(data);
+        return 1;
+    }
+
+    struct btelem_index_footer ft;
+    memcpy(&ft, data + len - sizeof(ft), sizeof(ft));
+    size_t index_end = (size_t)ft.index_offset
+                     + (size_t)ft.index_count * sizeof(struct btelem_index_entry);
+    if (ft.magic != BTELEM_INDEX_MAGIC || index_end + sizeof(ft) != len) {
+        printf("  %s: bad index footer\n", path);
+        free(data);
+        return 1;
+    }
+
+    /* The ID summary ends where the index starts */
+    struct btelem_index_ids_footer ift = {0};
+    if (ft.index_offset >= sizeof(ift))
+        memcpy(&ift, data + ft.index_offset - sizeof(ift), sizeof(ift));
+    size_t ids_end = (size_t)ift.ids_offset + ((size_t)ft.index_count + 1) * sizeof(uint32_t)
+                   + (size_t)ift.id_count * sizeof(struct btelem_index_id) + sizeof(ift);
+    if (ift.magic != BTELEM_INDEX_IDS_MAGIC || ids_end != ft.index_offset) {
+        printf("  %s: no ID summary\n", path);
+        free(data);
+        return 1;
+    }
+    const uint8_t *first_id = data + ift.ids_offset;
+    const uint8_t *ids = first_id + ((size_t)ft.index_count + 1) * sizeof(uint32_t);
+
+    /* Walk the packets and compare each with its index entry */
+    size_t off = 10 + schema_len;
+    const uint8_t *index = data + ft.index_offset;
+    for (uint32_t k = 0; k < ft.index_count && !bad; k++) {
+        struct btelem_index_entry ie;
+        memcpy(&ie, index + k * sizeof(ie), sizeof(ie));
+        struct btelem_packet_header ph;
+        memcpy(&ph, data + off, sizeof(ph));
+        size_t body = (ph.flags & BTELEM_PACKET_FLAG_COMPRESSED)
+            ? ph.payload_size
+            : (size_t)ph.entry_count * sizeof(struct btelem_entry_header) + ph.payload_size;
+        if (ie.offset != off || off + sizeof(ph) + body > ift.ids_offset) {
+            printf("  %s: packet %u at %zu, index says %llu\n", path, k, off,
+                   (unsigned long long)ie.offset);
+            bad++;
+            break;
+        }
+
+        const uint8_t *pkt = data + off;
+        size_t pkt_len = sizeof(ph) + body;
+        if (ph.flags & BTELEM_PACKET_FLAG_COMPRESSED) {
+            int n = btelem_packet_decompress(pkt, pkt_len, plain, sizeof(plain));
+            if (n < 0) {
+                printf("  %s: packet %u does not decompress\n", path, k);
+                bad++;
+                break;
+            }
+            info->compressed++;
+            info->plain_bytes += (uint64_t)n;
+            pkt = plain;
+        } else {
+            info->plain_bytes += pkt_len;
+        }
+        memcpy(&ph, pkt, sizeof(ph));
+
+        const uint8_t *table = pkt + sizeof(ph);
+        const uint8_t *payload = table + (size_t)ph.entry_count * sizeof(struct btelem_entry_header);
+        uint64_t ts_min = UINT64_MAX, ts_max = 0;
+        for (uint16_t i = 0; i < ph.entry_count; i++) {
+            struct btelem_entry_header eh;
+            struct seq_payload p;
+            memcpy(&eh, table + i * sizeof(eh), sizeof(eh));
+            memcpy(&p, payload + eh.payload_offset, sizeof(p));
+            if (eh.timestamp < ts_min) ts_min = eh.timestamp;
+            if (eh.timestamp > ts_max) ts_max = eh.timestamp;
+            if (eh.id != 0 || p.seq != *seq || p.value != (double)(p.seq / 64)) {
+                printf("  %s: entry seq %llu, expected %llu\n", path,
+                       (unsigned long long)p.seq, (unsigned long long)*seq);
+                bad++;
+                break;
+            }
+            (*seq)++;
+        }
+        /* Every entry is SEQ, so the summary is one (0, entry_count) record */
+        uint32_t id_lo, id_hi;
+        struct btelem_index_id rec_id = {0};
+        memcpy(&id_lo, first_id + k * sizeof(uint32_t), sizeof(id_lo));
+        memcpy(&id_hi, first_id + (k + 1) * sizeof(uint32_t), sizeof(id_hi));
+        if (id_hi == id_lo + 1)
+            memcpy(&rec_id, ids + id_lo * sizeof(rec_id), sizeof(rec_id));
+        if (!bad && (ie.entry_count != ph.entry_count
+                     || ie.ts_min != ts_min || ie.ts_max != ts_max
+                     || id_hi != id_lo + (ph.entry_count ? 1 : 0)
+                     || (ph.entry_count && (rec_id.id != 0 || rec_id.count != ph.entry_count)))) {
+            printf("  %s: index entry %u does not match its packet\n", path, k);
+            bad++;
+        }
+        info->packets++;
+        info->entries += ph.entry_count;
+        off += pkt_len;
+    }
+    if (!bad && off != ift.ids_offset) {
+        printf("  %s: %zu bytes between packets and index\n", path,
+               (size_t)ift.ids_offset - off);
+        bad++;
+    }
+
+    free(data);
+    return bad;
+}
+
+/* Check run.0.btlm, run.1.btlm, ... in order; returns problems found */
+static int check_rotated(int *files, uint64_t *seq, size_t *max_size,
+                         uint64_t *bytes)
+{
+    int bad = 0;
+    *files = 0;
+    *max_size = 0;
+    *bytes = 0;
+    for (int n = 0; n < MAX_FILES; n++) {
+        char path[PATH_MAX];
+        dir_path(path, "run.%d.btlm", n);
+        if (access(path, F_OK) != 0)
+            break;
+        struct file_info info;
+        bad += check_file(path, seq, &info);
+        if (info.size > *max_size)
+            *max_size = info.size;
+        *bytes += info.size;
+        (*files)++;
+    }
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 1: every entry lands in one well-formed file
+ * ----------------------------------------------------------------------- */
+
+static int test_plain(void)
+{
+    printf("Test 1: plain recording\n");
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, NULL) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    log_paced(PLAIN_ENTRIES / BATCH_ENTRIES);
+    btelem_record_stop(&rec);
+
+    struct btelem_record_stats st = rec.stats;
+    uint64_t seq = 0;
+    struct file_info info;
+    int bad = check_file(path, &seq, &info);
+
+    printf("  %llu entries in %llu packets, %zu bytes, %llu stalls\n",
+           (unsigned long long)info.entries, (unsigned long long)info.packets,
+           info.size, (unsigned long long)st.stalls);
+    if (info.entries != PLAIN_ENTRIES || st.dropped != 0) {
+        printf("  expected %d entries, %llu dropped\n", PLAIN_ENTRIES,
+               (unsigned long long)st.dropped);
+        bad++;
+    }
+    if (st.entries != info.entries || st.packets != info.packets
+        || st.bytes != info.size || st.files != 1 || st.write_errors != 0) {
+        printf("  stats disagree with the file\n");
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 2: compressed recording round-trips and is smaller
+ * ----------------------------------------------------------------------- */
+
+static int test_compress(void)
+{
+    printf("Test 2: compressed recording\n");
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_record_opts opts = { .compress = 1 };
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, &opts) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    log_paced(PLAIN_ENTRIES / BATCH_ENTRIES);
+    btelem_record_stop(&rec);
+
+    uint64_t seq = 0;
+    struct file_info info;
+    int bad = check_file(path, &seq, &info);
+
+    printf("  %llu entries, %llu/%llu packets compressed, %zu bytes (%llu plain)\n",
+           (unsigned long long)info.entries, (unsigned long long)info.compressed,
+           (unsigned long long)info.packets, info.size,
+           (unsigned long long)info.plain_bytes);
+    if (info.entries != PLAIN_ENTRIES || info.compressed == 0
+        || info.size * 2 > info.plain_bytes) {
+        printf("  expected %d entries and at least 2x smaller packets\n", PLAIN_ENTRIES);
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 3: size rotation
+ * ----------------------------------------------------------------------- */
+
+static int test_rotate_size(void)
+{
+    printf("Test 3: size rotation (%u KiB files)\n", ROTATE_BYTES >> 10);
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_record_opts opts = {
+        .max_file_bytes = ROTATE_BYTES,
+        .buf_bytes = 2 * BTELEM_RECORD_PKT,
+    };
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, &opts) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    log_paced(ROTATE_BATCHES);
+    btelem_record_stop(&rec);
+
+    int files;
+    uint64_t seq = 0, bytes;
+    size_t max_size;
+    int bad = check_rotated(&files, &seq, &max_size, &bytes);
+
+    printf("  %d files, largest %zu bytes, %llu entries\n", files, max_size,
+           (unsigned long long)seq);
+    if (files < 3 || max_size > ROTATE_BYTES
+        || seq != (uint64_t)ROTATE_BATCHES * BATCH_ENTRIES) {
+        printf("  expected several files under the limit holding every entry\n");
+        bad++;
+    }
+    if (rec.stats.files != (uint64_t)files || rec.stats.bytes != bytes) {
+        printf("  stats disagree with the files\n");
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 4: time rotation
+ * ----------------------------------------------------------------------- */
+
+static int test_rotate_time(void)
+{
+    printf("Test 4: time rotation (1 s files)\n");
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_record_opts opts = { .max_file_secs = 1, .flush_ms = 50 };
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, &opts) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    double t1 = mono_s() + 2.5;
+    while (mono_s() < t1) {
+        log_entries(1000);
+        usleep(20000);
+    }
+    btelem_record_stop(&rec);
+
+    int files;
+    uint64_t seq = 0, bytes;
+    size_t max_size;
+    int bad = check_rotated(&files, &seq, &max_size, &bytes);
+
+    printf("  %d files, %llu entries\n", files, (unsigned long long)seq);
+    if (files < 2 || files > 4 || seq != next_seq) {
+        printf("  expected 2-4 files holding all %llu entries\n",
+               (unsigned long long)next_seq);
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 5: throughput
+ * ----------------------------------------------------------------------- */
+
+static int test_throughput(void)
+{
+    printf("Test 5: throughput (%d entries, unpaced)\n", BENCH_ENTRIES);
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, NULL) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    double t0 = mono_s();
+    log_entries(BENCH_ENTRIES);
+    btelem_record_stop(&rec);
+    double dt = mono_s() - t0;
+
+    struct btelem_record_stats st = rec.stats;
+    printf("  %llu written, %llu dropped, %.1f MB in %.3f s (%.0f entries/s)\n",
+           (unsigned long long)st.entries, (unsigned long long)st.dropped,
+           (double)st.bytes / 1e6, dt, (double)st.entries / dt);
+    int bad = st.entries + st.dropped != BENCH_ENTRIES || st.write_errors != 0;
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 6: a spilling recorder loses nothing while its drain is stalled
+ * ----------------------------------------------------------------------- */
+
+static int test_lossless(void)
+{
+    printf("Test 6: lossless recording (%d entries, drain stalled)\n",
+           LOSSLESS_ENTRIES);
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX], spill[PATH_MAX];
+    dir_path(path, "run.btlm");
+    dir_path(spill, "spill");
+    struct btelem_record_opts opts = {
+        .buf_bytes = 1,                 /* smallest buffers: stalls early */
+        .spill_entries = SPILL_ENTRIES,
+        .spill_path = spill,
+    };
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, &opts) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    int bad = 0;
+    if (access(spill, F_OK) == 0) {
+        printf("  spill file left behind\n");
+        bad++;
+    }
+
+    /* The drain blocks handing off its first full buffer; only the spill
+     * thread keeps up while the log runs past the ring */
+    pthread_mutex_lock(&rec.lock);
+    log_paced(LOSSLESS_ENTRIES / BATCH_ENTRIES);
+    pthread_mutex_unlock(&rec.lock);
+    btelem_record_stop(&rec);
+
+    struct btelem_record_stats st = rec.stats;
+    uint64_t seq = 0;
+    struct file_info info;
+    bad += check_file(path, &seq, &info);
+
+    printf("  %llu entries, %llu dropped, %llu spilled (peak %llu)\n",
+           (unsigned long long)info.entries, (unsigned long long)st.dropped,
+           (unsigned long long)st.spilled, (unsigned long long)st.spill_peak);
+    if (info.entries != LOSSLESS_ENTRIES || st.dropped != 0) {
+        printf("  expected %d entries, none dropped\n", LOSSLESS_ENTRIES);
+        bad++;
+    }
+    if (st.spilled < LOSSLESS_ENTRIES - RING_ENTRIES || st.spill_peak > SPILL_ENTRIES) {
+        printf("  spill counters look wrong\n");
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 7: flight recording
+ * ----------------------------------------------------------------------- */
+
+static int test_trigger(void)
+{
+    printf("Test 7: flight recording (two triggers)\n");
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX], file0[PATH_MAX], file1[PATH_MAX], file2[PATH_MAX];
+    dir_path(path, "run.btlm");
+    dir_path(file0, "run.0.btlm");
+    dir_path(file1, "run.1.btlm");
+    dir_path(file2, "run.2.btlm");
+    struct btelem_record_opts opts = { .trigger = 1, .flush_ms = 50 };
+    struct btelem_recorder rec;
+    struct btelem_record_opts spill = { .trigger = 1, .spill_entries = SPILL_ENTRIES };
+    if (btelem_record_start(&rec, &ctx, path, &spill) == 0) {
+        printf("  FAIL: accepted a spill with trigger\n\n");
+        btelem_record_stop(&rec);
+        return 1;
+    }
+    if (btelem_record_start(&rec, &ctx, path, &opts) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+
+    /* Quiet: several rings go by unrecorded */
+    int bad = 0;
+    log_entries(3 * RING_ENTRIES);
+    usleep(50000);
+    struct btelem_record_stats st;
+    btelem_record_get_stats(&rec, &st);
+    if (access(file0, F_OK) == 0 || st.entries != 0 || st.files != 0) {
+        printf("  wrote before any trigger\n");
+        bad++;
+    }
+
+    /* First window reaches back past the oldest entry; the pause lets the
+     * recorder take the history before new entries overwrite it */
+    uint64_t first0 = next_seq - RING_ENTRIES;
+    btelem_trigger(&ctx, 60000000000ULL, (uint64_t)TRIGGER_POST_MS * 1000000u);
+    usleep(100000);
+    log_paced(4);
+    uint64_t end0 = next_seq;
+    usleep((TRIGGER_POST_MS + 200) * 1000);
+    log_paced(2);                       /* after the window */
+
+    /* Second window: no history wanted, only what follows */
+    usleep(50000);
+    uint64_t first1 = next_seq;
+    btelem_trigger(&ctx, 0, 300000000ULL);
+    usleep(100000);
+    log_paced(2);
+    uint64_t end1 = next_seq;
+    usleep(500000);
+    btelem_record_stop(&rec);
+    st = rec.stats;
+
+    uint64_t seq = first0;
+    struct file_info info;
+    bad += check_file(file0, &seq, &info);
+    printf("  window 1: %llu entries (seq %llu..%llu)\n",
+           (unsigned long long)info.entries, (unsigned long long)first0,
+           (unsigned long long)seq - 1);
+    if (seq != end0) {
+        printf("  expected seq %llu..%llu\n", (unsigned long long)first0,
+               (unsigned long long)end0 - 1);
+        bad++;
+    }
+    seq = first1;
+    bad += check_file(file1, &seq, &info);
+    printf("  window 2: %llu entries\n", (unsigned long long)info.entries);
+    if (seq != end1) {
+        printf("  expected seq %llu..%llu\n", (unsigned long long)first1,
+               (unsigned long long)end1 - 1);
+        bad++;
+    }
+    if (access(file2, F_OK) == 0 || st.snapshots != 2 || st.files != 2
+        || st.dropped != 0 || st.write_errors != 0) {
+        printf("  %llu snapshots, %llu files, %llu dropped, %llu errors\n",
+               (unsigned long long)st.snapshots, (unsigned long long)st.files,
+               (unsigned long long)st.dropped, (unsigned long long)st.write_errors);
+        bad++;
+    }
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 8: stop does not chase producers that keep logging
+ * ----------------------------------------------------------------------- */
+
+static volatile int flood_stop;
+
+static void *flood_thread(void *arg)
+{
+    (void)arg;
+    while (!flood_stop)
+        log_entries(64);
+    return NULL;
+}
+
+static int test_stop_under_load(void)
+{
+    printf("Test 8: stop while producers keep logging\n");
+    if (setup() < 0)
+        return 1;
+
+    char path[PATH_MAX];
+    dir_path(path, "run.btlm");
+    struct btelem_recorder rec;
+    if (btelem_record_start(&rec, &ctx, path, NULL) < 0) {
+        printf("  FAIL: btelem_record_start\n\n");
+        return 1;
+    }
+    pthread_t th[FLOOD_THREADS];
+    flood_stop = 0;
+    for (int i = 0; i < FLOOD_THREADS; i++)
+        pthread_create(&th[i], NULL, flood_thread, NULL);
+    usleep(200000);
+
+    double t0 = mono_s();
+    btelem_record_stop(&rec);
+    double dt = mono_s() - t0;
+    flood_stop = 1;
+    for (int i = 0; i < FLOOD_THREADS; i++)
+        pthread_join(th[i], NULL);
+
+    struct btelem_record_stats st = rec.stats;
+    printf("  stopped in %.3f s, %llu written, %llu logged\n", dt,
+           (unsigned long long)st.entries, (unsigned long long)next_seq);
+    int bad = dt > STOP_LIMIT_S || st.entries == 0 || st.write_errors != 0;
+    remove_files();
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Main
+ * ----------------------------------------------------------------------- */
+
+static void alarm_handler(int sig)
+{
+    (void)sig;
+    fprintf(stderr, "TIMEOUT: test exceeded %d seconds\n", TEST_TIMEOUT_SEC);
+    remove_files();
+    rmdir(dir);
+    _exit(1);
+}
+
+int main(void)
+{
+    signal(SIGALRM, alarm_handler);
+    alarm(TEST_TIMEOUT_SEC);
+
+    printf("btelem recorder test\n");
+    printf("====================\n\n");
+
+    snprintf(dir, sizeof(dir), "/tmp/btelem_record_XXXXXX");
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    int failed = 0;
+    failed += test_plain();
+    failed += test_compress();
+    failed += test_rotate_size();
+    failed += test_rotate_time();
+    failed += test_throughput();
+    failed += test_lossless();
+    failed += test_trigger();
+    failed += test_stop_under_load();
+    int total = 8;
+
+    rmdir(dir);
+    printf("%s (%d/%d passed)\n",
+           failed ? "FAILED" : "ALL PASSED",
+           total - failed, total);
+
+    return failed ? 1 : 0;
+}
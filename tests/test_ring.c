@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "btelem/btelem.h"
 
 #define RING_ENTRIES 16  /* small ring to test wrap-around */
@@ -25,6 +27,9 @@ BTELEM_SCHEMA_ENTRY(TEST, 0, "test", "Test entry", struct test_data, test_fields
 
 /* ---- Helpers ---- */
 
+/* Trailing schema clock record, present in tick-timestamp builds */
+#define CLOCK_RECORD_SIZE (ctx.clock.tick_hz ? sizeof(struct btelem_clock_wire) : 0)
+
 static struct btelem_ctx ctx;
 static uint8_t ring_mem[sizeof(struct btelem_ring) + RING_ENTRIES * sizeof(struct btelem_entry)];
 
@@ -190,7 +195,8 @@ static void test_schema_serialize_roundtrip(void)
     int expected = (int)(sizeof(struct btelem_schema_header)
                        + 1 * sizeof(struct btelem_schema_wire)
                        + sizeof(uint16_t)   /* enum_count = 0 */
-                       + sizeof(uint16_t)); /* bitfield_count = 0 */
+                       + sizeof(uint16_t)   /* bitfield_count = 0 */
+                       + CLOCK_RECORD_SIZE);
     assert(len == expected);
 
     /* Verify via packed header struct */
@@ -346,6 +352,286 @@ static void test_drain_packed_dropped(void)
     printf(" OK\n");
 }
 
+/* Concatenate a drain_iov packet into one buffer */
+static size_t flatten_iov(const struct btelem_drain_iov *d, uint8_t *out)
+{
+    size_t off = 0;
+    for (int i = 0; i < d->iov_count; i++) {
+        memcpy(out + off, d->iov[i].base, d->iov[i].len);
+        off += d->iov[i].len;
+    }
+    assert(off == d->total);
+    return off;
+}
+
+static void test_drain_iov(void)
+{
+    printf("test_drain_iov...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    int ref = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data d;
+    for (uint32_t i = 0; i < 5; i++) {
+        d.value = 100 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+
+    static struct btelem_drain_iov drain;
+    uint8_t buf[4096], flat[4096], packed[4096];
+    int n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    int np = btelem_drain_packed(&ctx, ref, packed, sizeof(packed));
+    assert(n > 0 && n == np);
+
+    /* Header + table span, then one span per payload pointing into the ring */
+    assert(drain.iov_count == 1 + 5);
+    assert(drain.iov[0].base == buf);
+    assert(drain.iov[0].len == sizeof(struct btelem_packet_header)
+                             + 5 * sizeof(struct btelem_entry_header));
+    for (int i = 1; i < drain.iov_count; i++) {
+        const uint8_t *p = (const uint8_t *)drain.iov[i].base;
+        assert(p >= ring_mem && p < ring_mem + sizeof(ring_mem));
+    }
+    assert(drain.ref_count == 5);
+
+    assert(flatten_iov(&drain, flat) == (size_t)n);
+    assert(memcmp(flat, packed, (size_t)n) == 0);
+    assert(btelem_drain_iov_release(&ctx, &drain) == 0);
+
+    n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    assert(n == 0 && drain.iov_count == 0);
+
+    btelem_client_close(&ctx, client);
+    btelem_client_close(&ctx, ref);
+    printf(" OK (%d spans)\n", 1 + 5);
+}
+
+static void test_drain_iov_guard(void)
+{
+    printf("test_drain_iov_guard...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    int ref = btelem_client_open(&ctx, NULL, 0);
+
+    /* Overflow by 4: readable window is [4, 20), guard zone is [4, 8) */
+    struct test_data d;
+    for (uint32_t i = 0; i < RING_ENTRIES + 4; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+
+    static struct btelem_drain_iov drain;
+    uint8_t buf[4096], flat[4096], packed[4096];
+    int n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    int np = btelem_drain_packed(&ctx, ref, packed, sizeof(packed));
+    assert(n > 0 && n == np);
+
+    /* Guarded slots are copied and merged into a single span */
+    assert(drain.iov_count == 1 + 1 + (RING_ENTRIES - 4));
+    assert(drain.iov[1].len == 4 * sizeof(struct test_data));
+    assert((const uint8_t *)drain.iov[1].base > buf
+           && (const uint8_t *)drain.iov[1].base < buf + sizeof(buf));
+    assert(drain.ref_count == RING_ENTRIES - 4);
+
+    assert(flatten_iov(&drain, flat) == (size_t)n);
+    assert(memcmp(flat, packed, (size_t)n) == 0);
+    assert(((const struct btelem_packet_header *)flat)->dropped == 4);
+
+    /* Producer laps two referenced slots (8, 9) before the send completes;
+     * checked before the send, those and the four now guarded (10..13)
+     * would have been copied out instead */
+    assert(btelem_drain_iov_validate(&ctx, &drain) == 0);
+    for (uint32_t i = 0; i < 6; i++) {
+        d.value = 1000 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    assert(btelem_drain_iov_validate(&ctx, &drain) == 6);
+    assert(btelem_drain_iov_release(&ctx, &drain) == 2);
+
+    /* The loss is reported in the next packet */
+    n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    assert(n > 0);
+    const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+    assert(pkt->entry_count == 6);
+    assert(pkt->dropped == 2);
+    assert(btelem_drain_iov_release(&ctx, &drain) == 0);
+
+    btelem_client_close(&ctx, client);
+    btelem_client_close(&ctx, ref);
+    printf(" OK\n");
+}
+
+static void test_drain_iov_settle(void)
+{
+    printf("test_drain_iov_settle...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    int ref = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data d;
+    for (uint32_t i = 0; i < 8; i++) {
+        d.value = 200 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+
+    static struct btelem_drain_iov drain;
+    uint8_t buf[4096], bounce[4096], packed[4096];
+    int n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    int np = btelem_drain_packed(&ctx, ref, packed, sizeof(packed));
+    assert(n > 0 && n == np && drain.ref_count == 8);
+
+    /* The socket took the table and two payloads, then would block */
+    size_t sent = drain.iov[0].len + 2 * sizeof(struct test_data);
+    assert(btelem_drain_iov_settle(&ctx, &drain, sent, bounce, 8) == -1);
+    assert(btelem_drain_iov_settle(&ctx, &drain, sent, bounce, sizeof(bounce)) == 0);
+    assert(drain.iov_count == 1 && drain.iov[0].base == bounce);
+    assert(drain.total == (size_t)n - sent && drain.ref_count == 0);
+
+    /* Laps after the copy no longer reach what is left to send */
+    for (uint32_t i = 0; i < RING_ENTRIES; i++) {
+        d.value = 9000 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    assert(memcmp(bounce, packed + sent, (size_t)n - sent) == 0);
+    assert(btelem_drain_iov_release(&ctx, &drain) == 0);
+
+    /* Lapped before the copy: every unsent reference is reported torn,
+     * including a payload cut part way */
+    btelem_drain_packed(&ctx, ref, packed, sizeof(packed));
+    n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    assert(n > 0);
+    uint32_t refs = drain.ref_count;
+    assert(refs > 0);
+    sent = 0;
+    for (int i = 0; i < drain.iov_count; i++) {
+        const uint8_t *p = (const uint8_t *)drain.iov[i].base;
+        if (p >= ring_mem && p < ring_mem + sizeof(ring_mem)) {
+            sent += 1;  /* one byte into the first referenced payload */
+            break;
+        }
+        sent += drain.iov[i].len;
+    }
+    for (uint32_t i = 0; i < RING_ENTRIES; i++)
+        BTELEM_LOG(&ctx, TEST, d);
+    uint64_t torn = ctx.clients[client].torn;
+    assert(btelem_drain_iov_settle(&ctx, &drain, sent, bounce, sizeof(bounce)) == (int)refs);
+    assert(ctx.clients[client].torn == torn + refs);
+
+    btelem_client_close(&ctx, client);
+    btelem_client_close(&ctx, ref);
+    printf(" OK\n");
+}
+
+static void count_wake(void *user)
+{
+    (*(int *)user)++;
+}
+
+static void test_wake_arm(void)
+{
+    printf("test_wake_arm...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    int wakes = 0;
+    assert(btelem_wake_arm(&ctx, client, 1) == -1);  /* no callback yet */
+    btelem_wake_set(&ctx, count_wake, &wakes);
+
+    /* Fires once, when the third pending entry is logged */
+    struct test_data d = {.value = 1};
+    assert(btelem_wake_arm(&ctx, client, 3) == 0);
+    BTELEM_LOG(&ctx, TEST, d);
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(wakes == 0);
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(wakes == 1);
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(wakes == 1);
+
+    /* Already satisfied: the caller should drain rather than sleep */
+    assert(btelem_wake_arm(&ctx, client, 4) == 1);
+
+    struct collect_ctx cc = {0};
+    btelem_drain(&ctx, client, collect_emit, &cc);
+    assert(cc.count == 4);
+
+    /* Batches check once, on commit */
+    wakes = 0;
+    assert(btelem_wake_arm(&ctx, client, 1) == 0);
+    struct test_data burst[4] = {{1}, {2}, {3}, {4}};
+    BTELEM_LOG_BATCH(&ctx, TEST, burst, 4, 0);
+    assert(wakes == 1);
+
+    btelem_wake_set(&ctx, NULL, NULL);
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(wakes == 1);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+/* Callback that parks inside the hook until told to leave */
+struct slow_wake {
+    btelem_atomic_u64 inside;
+    btelem_atomic_u64 leave;
+    btelem_atomic_u64 done;
+};
+
+static void slow_wake(void *user)
+{
+    struct slow_wake *w = (struct slow_wake *)user;
+    btelem_atomic_store_rel(&w->inside, 1);
+    while (!btelem_atomic_load_acq(&w->leave))
+        ;
+    btelem_atomic_store_rel(&w->done, 1);
+}
+
+static void *slow_wake_logger(void *arg)
+{
+    (void)arg;
+    struct test_data d = {.value = 7};
+    BTELEM_LOG(&ctx, TEST, d);
+    return NULL;
+}
+
+static void *slow_wake_release(void *arg)
+{
+    struct slow_wake *w = (struct slow_wake *)arg;
+    usleep(20000);
+    btelem_atomic_store_rel(&w->leave, 1);
+    return NULL;
+}
+
+static void test_wake_set_waits(void)
+{
+    printf("test_wake_set_waits...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    struct slow_wake w;
+    memset(&w, 0, sizeof(w));
+    btelem_wake_set(&ctx, slow_wake, &w);
+    assert(btelem_wake_arm(&ctx, client, 1) == 0);
+
+    pthread_t logger, release;
+    assert(pthread_create(&logger, NULL, slow_wake_logger, NULL) == 0);
+    while (!btelem_atomic_load_acq(&w.inside))
+        ;
+
+    /* Removing the hook must not return while the producer is in it */
+    assert(pthread_create(&release, NULL, slow_wake_release, &w) == 0);
+    btelem_wake_set(&ctx, NULL, NULL);
+    assert(btelem_atomic_load_acq(&w.done) == 1);
+
+    pthread_join(logger, NULL);
+    pthread_join(release, NULL);
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
 static void test_enum_schema_serialize(void)
 {
     printf("test_enum_schema_serialize...");
@@ -376,7 +662,8 @@ static void test_enum_schema_serialize(void)
                        + sizeof(struct btelem_schema_wire)
                        + sizeof(uint16_t)
                        + sizeof(struct btelem_enum_wire)
-                       + sizeof(uint16_t));  /* bitfield_count = 0 */
+                       + sizeof(uint16_t)   /* bitfield_count = 0 */
+                       + CLOCK_RECORD_SIZE);
     assert(len == expected);
 
     /* Verify the enum section */
@@ -431,7 +718,8 @@ static void test_bitfield_schema_serialize(void)
                        + sizeof(struct btelem_schema_wire)
                        + sizeof(uint16_t)  /* enum_count = 0 */
                        + sizeof(uint16_t)  /* bitfield_count = 1 */
-                       + sizeof(struct btelem_bitfield_wire));
+                       + sizeof(struct btelem_bitfield_wire)
+                       + CLOCK_RECORD_SIZE);
     assert(len == expected);
 
     /* Verify the bitfield section */
@@ -460,8 +748,1245 @@ static void test_bitfield_schema_serialize(void)
     printf(" OK (%d bytes)\n", len);
 }
 
+/* ---- Variable-length ring ---- */
+
+#define VAR_UNITS 32  /* 32 units: 2 KB at 64 B/unit */
+
+struct big_data {
+    uint32_t value;
+    uint8_t  fill[96];
+};
+
+static const struct btelem_field_def big_fields[] = {
+    BTELEM_FIELD(struct big_data, value, BTELEM_U32),
+    BTELEM_ARRAY_FIELD(struct big_data, fill, BTELEM_U8, 96),
+};
+BTELEM_SCHEMA_ENTRY(BIG, 1, "big", "Multi-unit entry", struct big_data, big_fields);
+
+static uint8_t var_ring_mem[sizeof(struct btelem_ring) + VAR_UNITS * BTELEM_VAR_UNIT];
+
+static void setup_var(void)
+{
+    assert(btelem_ring_size_var(VAR_UNITS) == sizeof(var_ring_mem));
+    memset(var_ring_mem, 0, sizeof(var_ring_mem));
+    int rc = btelem_init_var(&ctx, var_ring_mem, VAR_UNITS);
+    assert(rc == 0);
+    btelem_register(&ctx, &btelem_schema_TEST);
+    btelem_register(&ctx, &btelem_schema_BIG);
+}
+
+static void test_var_init_args(void)
+{
+    printf("test_var_init_args...");
+    assert(btelem_init_var(&ctx, var_ring_mem, 24) == -1);  /* not power of 2 */
+    assert(btelem_init_var(&ctx, var_ring_mem, 2) == -1);   /* < max record */
+    assert(btelem_init_var(NULL, var_ring_mem, VAR_UNITS) == -1);
+    printf(" OK\n");
+}
+
+static void test_var_log_drain(void)
+{
+    printf("test_var_log_drain...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data d = {.value = 7};
+    struct big_data b;
+    memset(&b, 0xAB, sizeof(b));
+    b.value = 8;
+    BTELEM_LOG(&ctx, TEST, d);
+    BTELEM_LOG(&ctx, BIG, b);
+    d.value = 9;
+    BTELEM_LOG(&ctx, TEST, d);
+
+    /* 1 + 2 + 1 units, not 3 full slots */
+    assert(btelem_atomic_load_acq(&ctx.ring->head)
+           == 2 * BTELEM_VAR_UNITS(sizeof(d)) + BTELEM_VAR_UNITS(sizeof(b)));
+
+    uint64_t dropped = 99;
+    assert(btelem_client_available(&ctx, client, &dropped) == 3);
+    assert(dropped == 0);
+    /* Pending counts units, not records */
+    assert(btelem_client_pending(&ctx, client)
+           == btelem_atomic_load_acq(&ctx.ring->head));
+
+    struct collect_ctx cc = {0};
+    int n = btelem_drain(&ctx, client, collect_emit, &cc);
+    assert(n == 3);
+    assert(cc.values[0] == 7);
+    assert(cc.values[1] == 8);
+    assert(cc.values[2] == 9);
+
+    assert(btelem_client_available(&ctx, client, NULL) == 0);
+    assert(btelem_client_pending(&ctx, client) == 0);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+/* Emit callback: checks that BIG payloads survived the wrap intact */
+static int check_big_emit(const struct btelem_entry *entry, void *user)
+{
+    struct collect_ctx *cc = (struct collect_ctx *)user;
+    struct big_data b;
+    assert(entry->payload_size == sizeof(b));
+    memcpy(&b, entry->payload, sizeof(b));
+    for (size_t i = 0; i < sizeof(b.fill); i++)
+        assert(b.fill[i] == (uint8_t)(b.value + i));
+    cc->values[cc->count++] = b.value;
+    return 0;
+}
+
+static void test_var_wrap_payload(void)
+{
+    printf("test_var_wrap_payload...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* Drain as we go so no record is lost, and sizes don't divide the
+     * ring evenly so payloads straddle the end of the ring. */
+    struct test_data d = {.value = 0};
+    BTELEM_LOG(&ctx, TEST, d);
+    struct collect_ctx cc = {0};
+    btelem_drain(&ctx, client, collect_emit, &cc);
+
+    cc.count = 0;
+    struct big_data b;
+    for (uint32_t i = 0; i < 40; i++) {
+        b.value = i;
+        for (size_t j = 0; j < sizeof(b.fill); j++)
+            b.fill[j] = (uint8_t)(i + j);
+        BTELEM_LOG(&ctx, BIG, b);
+        assert(btelem_drain(&ctx, client, check_big_emit, &cc) == 1);
+    }
+    assert(cc.count == 40);
+    assert(cc.values[39] == 39);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_var_overwrite_resync(void)
+{
+    printf("test_var_overwrite_resync...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* Mixed sizes so record boundaries don't line up with the ring size */
+    struct test_data d;
+    struct big_data b;
+    memset(&b, 0, sizeof(b));
+    for (uint32_t i = 0; i < 60; i++) {
+        if (i % 3 == 0) {
+            b.value = i;
+            BTELEM_LOG(&ctx, BIG, b);
+        } else {
+            d.value = i;
+            BTELEM_LOG(&ctx, TEST, d);
+        }
+    }
+
+    struct collect_ctx cc = {0};
+    int n = btelem_drain(&ctx, client, collect_emit, &cc);
+    assert(n > 0);
+
+    /* Survivors are the newest entries, contiguous and in order */
+    assert(cc.values[n - 1] == 59);
+    for (int i = 1; i < n; i++)
+        assert(cc.values[i] == cc.values[i - 1] + 1);
+    assert(ctx.clients[client].dropped > 0);
+
+    /* Cursor is back on a record boundary: new entries drain normally */
+    d.value = 1000;
+    BTELEM_LOG(&ctx, TEST, d);
+    cc.count = 0;
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == 1);
+    assert(cc.values[0] == 1000);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_var_drain_packed(void)
+{
+    printf("test_var_drain_packed...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data d = {.value = 0xDEADBEEF};
+    struct big_data b;
+    memset(&b, 0x5A, sizeof(b));
+    b.value = 0xCAFEBABE;
+    BTELEM_LOG(&ctx, TEST, d);
+    BTELEM_LOG(&ctx, BIG, b);
+
+    uint8_t buf[4096];
+    int n = btelem_drain_packed(&ctx, client, buf, sizeof(buf));
+    int expected = (int)(sizeof(struct btelem_packet_header)
+                       + 2 * sizeof(struct btelem_entry_header)
+                       + sizeof(d) + sizeof(b));
+    assert(n == expected);
+
+    const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+    assert(pkt->entry_count == 2);
+    assert(pkt->dropped == 0);
+
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+    assert(table[0].id == BTELEM_ID_TEST);
+    assert(table[1].id == BTELEM_ID_BIG);
+    assert(table[1].payload_size == sizeof(b));
+
+    const uint8_t *payload_base = buf + sizeof(*pkt)
+                                + 2 * sizeof(struct btelem_entry_header);
+    assert(memcmp(payload_base + table[1].payload_offset, &b, sizeof(b)) == 0);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK (%d bytes)\n", n);
+}
+
+static void test_var_drain_iov(void)
+{
+    printf("test_var_drain_iov...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data d = {.value = 7};
+    BTELEM_LOG(&ctx, TEST, d);
+    BTELEM_LOG(&ctx, TEST, d);
+
+    /* No stable slot layout to reference: one copied span */
+    static struct btelem_drain_iov drain;
+    uint8_t buf[4096];
+    int n = btelem_drain_iov(&ctx, client, &drain, buf, sizeof(buf));
+    assert(n > 0);
+    assert(drain.iov_count == 1);
+    assert(drain.iov[0].base == buf && drain.iov[0].len == (size_t)n);
+    assert(drain.ref_count == 0);
+    assert(((const struct btelem_packet_header *)buf)->entry_count == 2);
+    assert(btelem_drain_iov_release(&ctx, &drain) == 0);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_var_density(void)
+{
+    printf("test_var_density...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* A 4-byte payload takes one unit, so the ring holds VAR_UNITS of them */
+    struct test_data d;
+    for (uint32_t i = 0; i < VAR_UNITS; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+
+    struct collect_ctx cc = {0};
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == VAR_UNITS);
+    assert(ctx.clients[client].dropped == 0);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK (%d entries in %zu bytes)\n", VAR_UNITS,
+           (size_t)VAR_UNITS * BTELEM_VAR_UNIT);
+}
+
+/* ---- Sharded rings ---- */
+
+#define NUM_SHARDS 2
+
+static uint8_t shard_ring_mem[NUM_SHARDS * (sizeof(struct btelem_ring)
+                              + RING_ENTRIES * sizeof(struct btelem_entry))];
+
+static void setup_sharded(void)
+{
+    assert(btelem_ring_size_sharded(NUM_SHARDS, RING_ENTRIES) == sizeof(shard_ring_mem));
+    int rc = btelem_init_sharded(&ctx, shard_ring_mem, NUM_SHARDS, RING_ENTRIES);
+    assert(rc == 0);
+    btelem_register(&ctx, &btelem_schema_TEST);
+}
+
+static void test_sharded_merge(void)
+{
+    printf("test_sharded_merge...");
+    setup_sharded();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* Interleave writes across shards from one thread by rebinding */
+    struct test_data d;
+    for (uint32_t i = 0; i < 8; i++) {
+        assert(btelem_shard_attach(&ctx, (int)(i % 3 == 0)) == (int)(i % 3 == 0));
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 5);
+    assert(btelem_atomic_load_acq(&ctx.shards[1]->head) == 3);
+    assert(btelem_client_available(&ctx, client, NULL) == 8);
+
+    /* drain_packed merges by timestamp back into logging order */
+    uint8_t buf[4096];
+    int n = btelem_drain_packed(&ctx, client, buf, sizeof(buf));
+    assert(n > 0);
+    const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+    assert(pkt->entry_count == 8);
+    const struct btelem_entry_header *table =
+        (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+    const uint8_t *payload_base = buf + sizeof(*pkt) + 8 * sizeof(*table);
+    for (uint32_t i = 0; i < 8; i++) {
+        uint32_t val;
+        memcpy(&val, payload_base + table[i].payload_offset, 4);
+        assert(val == i);
+        if (i > 0)
+            assert(table[i].timestamp >= table[i - 1].timestamp);
+    }
+
+    /* Callback drain sees the same order */
+    int c2 = btelem_client_open(&ctx, NULL, 0);
+    btelem_shard_attach(&ctx, 1);
+    d.value = 100;
+    BTELEM_LOG(&ctx, TEST, d);
+    btelem_shard_attach(&ctx, 0);
+    d.value = 101;
+    BTELEM_LOG(&ctx, TEST, d);
+    struct collect_ctx cc = {0};
+    assert(btelem_drain(&ctx, c2, collect_emit, &cc) == 2);
+    assert(cc.values[0] == 100 && cc.values[1] == 101);
+
+    btelem_client_close(&ctx, client);
+    btelem_client_close(&ctx, c2);
+    printf(" OK\n");
+}
+
+static void test_sharded_drops(void)
+{
+    printf("test_sharded_drops...");
+    setup_sharded();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* Overflow shard 0 by 4; shard 1 stays within capacity */
+    struct test_data d;
+    btelem_shard_attach(&ctx, 0);
+    for (uint32_t i = 0; i < RING_ENTRIES + 4; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    btelem_shard_attach(&ctx, 1);
+    d.value = 1000;
+    BTELEM_LOG(&ctx, TEST, d);
+
+    uint64_t dropped = 0;
+    assert(btelem_client_available(&ctx, client, &dropped) == RING_ENTRIES + 1);
+    assert(dropped == 4);
+
+    uint8_t buf[16384];
+    int n = btelem_drain_packed(&ctx, client, buf, sizeof(buf));
+    assert(n > 0);
+    const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+    assert(pkt->entry_count == RING_ENTRIES + 1);
+    assert(pkt->dropped == 4);
+    assert(ctx.clients[client].shard_dropped[0] == 4);
+    assert(ctx.clients[client].shard_dropped[1] == 0);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+/* A producer thread: optionally attach, log `count` values, optionally
+ * wait for `go` and log once more, optionally detach */
+struct shard_worker {
+    const int         *attach;  /* shard to btelem_shard_attach() first */
+    int                attach_rc;
+    uint32_t           value;
+    uint32_t           count;
+    int                detach;
+    int                detach_rc;
+    btelem_atomic_u64 *logged;  /* set after the first logs, if non-NULL */
+    btelem_atomic_u64 *go;
+};
+
+static void *shard_worker_thread(void *arg)
+{
+    struct shard_worker *w = (struct shard_worker *)arg;
+    struct test_data d;
+    if (w->attach)
+        w->attach_rc = btelem_shard_attach(&ctx, *w->attach);
+    for (uint32_t i = 0; i < w->count; i++) {
+        d.value = w->value + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    if (w->logged) {
+        btelem_atomic_store_rel(w->logged, 1);
+        while (!btelem_atomic_load_acq(w->go))
+            ;
+        d.value = w->value + w->count;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    w->detach_rc = w->detach ? btelem_shard_detach(&ctx) : 0;
+    return NULL;
+}
+
+static void run_shard_worker(struct shard_worker *w)
+{
+    pthread_t t;
+    assert(pthread_create(&t, NULL, shard_worker_thread, w) == 0);
+    pthread_join(t, NULL);
+}
+
+static void test_sharded_auto_attach(void)
+{
+    printf("test_sharded_auto_attach...");
+    setup_sharded();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* First log binds this thread to the first unclaimed shard */
+    struct test_data d = {.value = 5};
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 1);
+
+    /* Attaching again moves the thread and frees its old shard */
+    assert(btelem_shard_attach(&ctx, -1) == 1);
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 2);
+    assert(btelem_shard_attach(&ctx, 0) == 0);
+    assert(btelem_shard_attach(&ctx, 0) == 0);   /* already there */
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 1);
+
+    /* Another thread takes the other shard and exits holding it; no shard
+     * is left to move to, so this thread stays put */
+    const int any = -1;
+    struct shard_worker w = { .attach = &any };
+    run_shard_worker(&w);
+    assert(w.attach_rc == 1);
+    assert(btelem_shard_attach(&ctx, -1) == -1);
+    assert(btelem_shard_attach(&ctx, NUM_SHARDS) == -1);
+    d.value = 6;
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 2);
+
+    struct collect_ctx cc = {0};
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == 2);
+    assert(cc.values[0] == 5 && cc.values[1] == 6);
+
+    /* Non-sharded contexts have no shards to attach to */
+    setup();
+    assert(btelem_shard_attach(&ctx, -1) == -1);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_sharded_detach(void)
+{
+    printf("test_sharded_detach...");
+    setup_sharded();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    assert(btelem_shard_detach(&ctx) == -1);   /* not bound in this ctx */
+
+    /* Threads that detach hand their shard on: far more threads than
+     * shards, nothing lost */
+    for (uint32_t i = 0; i < 4 * NUM_SHARDS; i++) {
+        struct shard_worker w = { .value = i, .count = 1, .detach = 1 };
+        run_shard_worker(&w);
+        assert(w.detach_rc == 0);
+    }
+    assert(btelem_atomic_load_relaxed(&ctx.shard_unbound) == 0);
+    struct collect_ctx cc = {0};
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == 4 * NUM_SHARDS);
+    for (uint32_t i = 0; i < 4 * NUM_SHARDS; i++)
+        assert(cc.values[i] == i);
+
+    /* Threads that exit bound keep their shard; the last one goes to
+     * this thread */
+    for (uint32_t i = 0; i < NUM_SHARDS - 1; i++) {
+        struct shard_worker w = { .value = 100, .count = 1 };
+        run_shard_worker(&w);
+    }
+    struct test_data d = {.value = 200};
+    BTELEM_LOG(&ctx, TEST, d);
+
+    /* A thread with no free shard discards (visible in the stats, and
+     * waking nobody), then binds once one is released */
+    int wakes = 0;
+    btelem_wake_set(&ctx, count_wake, &wakes);
+    btelem_wake_arm(&ctx, client, 1);
+    btelem_atomic_u64 logged = 0, go = 0;
+    struct shard_worker w = { .value = 300, .count = 3, .detach = 1,
+                              .logged = &logged, .go = &go };
+    pthread_t t;
+    assert(pthread_create(&t, NULL, shard_worker_thread, &w) == 0);
+    while (!btelem_atomic_load_acq(&logged))
+        ;
+    assert(btelem_atomic_load_relaxed(&ctx.shard_unbound) == 3);
+    assert(wakes == 0);
+    btelem_wake_set(&ctx, NULL, NULL);
+    static struct btelem_stats st;
+    assert(btelem_stats(&ctx, &st) == 0 && st.unbound == 3);
+    assert(btelem_shard_detach(&ctx) == 0);
+    assert(btelem_shard_detach(&ctx) == -1);
+    btelem_atomic_store_rel(&go, 1);
+    pthread_join(t, NULL);
+    assert(w.detach_rc == 0);
+    assert(btelem_atomic_load_relaxed(&ctx.shard_unbound) == 3);
+
+    memset(&cc, 0, sizeof(cc));
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == NUM_SHARDS + 1);
+    assert(cc.values[NUM_SHARDS - 1] == 200);
+    assert(cc.values[NUM_SHARDS] == 303);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_sharded_explicit_attach(void)
+{
+    printf("test_sharded_explicit_attach...");
+    setup_sharded();
+
+    /* A shard held by one thread can't be attached to by another */
+    assert(btelem_shard_attach(&ctx, 0) == 0);
+    const int zero = 0, one = 1;
+    struct shard_worker w = { .attach = &zero };
+    run_shard_worker(&w);
+    assert(w.attach_rc == -1);
+    w.attach = &one;
+    w.detach = 1;
+    run_shard_worker(&w);
+    assert(w.attach_rc == 1 && w.detach_rc == 0);
+
+    /* The worker's detach released only its own shard */
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 1);
+    assert(btelem_shard_detach(&ctx) == 0);
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 0);
+    printf(" OK\n");
+}
+
+static struct btelem_ctx ctx2;
+static uint8_t shard_ring_mem2[sizeof(shard_ring_mem)];
+
+static void test_sharded_two_contexts(void)
+{
+    printf("test_sharded_two_contexts...");
+    setup_sharded();
+    assert(btelem_init_sharded(&ctx2, shard_ring_mem2, NUM_SHARDS, RING_ENTRIES) == 0);
+    btelem_register(&ctx2, &btelem_schema_TEST);
+
+    /* Alternating keeps one shard per context, not one per switch */
+    struct test_data d;
+    for (uint32_t i = 0; i < 3 * NUM_SHARDS; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+        BTELEM_LOG(&ctx2, TEST, d);
+    }
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 1);
+    assert(btelem_atomic_load_relaxed(&ctx2.shards_busy) == 1);
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 3 * NUM_SHARDS);
+    assert(btelem_atomic_load_acq(&ctx2.shards[0]->head) == 3 * NUM_SHARDS);
+    assert(btelem_atomic_load_relaxed(&ctx.shard_unbound) == 0);
+    assert(btelem_atomic_load_relaxed(&ctx2.shard_unbound) == 0);
+
+    /* Either binding can be detached, whichever was used last */
+    assert(btelem_shard_detach(&ctx) == 0);
+    assert(btelem_shard_detach(&ctx2) == 0);
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 0);
+    assert(btelem_atomic_load_relaxed(&ctx2.shards_busy) == 0);
+
+    /* One context per binding slot plus one: the least recently used
+     * binding is evicted and its shard released */
+    static struct btelem_ctx many[BTELEM_SHARD_BINDINGS + 1];
+    static uint8_t many_mem[BTELEM_SHARD_BINDINGS + 1][sizeof(shard_ring_mem)];
+    for (int i = 0; i <= BTELEM_SHARD_BINDINGS; i++) {
+        assert(btelem_init_sharded(&many[i], many_mem[i], NUM_SHARDS, RING_ENTRIES) == 0);
+        btelem_register(&many[i], &btelem_schema_TEST);
+        BTELEM_LOG(&many[i], TEST, d);
+    }
+    assert(btelem_atomic_load_relaxed(&many[0].shards_busy) == 0);
+    for (int i = 1; i <= BTELEM_SHARD_BINDINGS; i++) {
+        assert(btelem_atomic_load_relaxed(&many[i].shards_busy) == 1);
+        assert(btelem_shard_detach(&many[i]) == 0);
+    }
+    printf(" OK\n");
+}
+
+static void test_sharded_deinit(void)
+{
+    printf("test_sharded_deinit...");
+    setup_sharded();
+    struct test_data d = { .value = 1 };
+    BTELEM_LOG(&ctx, TEST, d);
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 1);
+
+    /* Retire ctx, then leave its old bytes in place, as freed memory
+     * would.  Evicting the stale binding must not write to it. */
+    static struct btelem_ctx saved;
+    memcpy(&saved, &ctx, sizeof(ctx));
+    btelem_deinit(&ctx);
+    memcpy(&ctx, &saved, sizeof(ctx));
+
+    static struct btelem_ctx others[BTELEM_SHARD_BINDINGS];
+    static uint8_t others_mem[BTELEM_SHARD_BINDINGS][sizeof(shard_ring_mem)];
+    for (int i = 0; i < BTELEM_SHARD_BINDINGS; i++) {
+        assert(btelem_init_sharded(&others[i], others_mem[i], NUM_SHARDS, RING_ENTRIES) == 0);
+        btelem_register(&others[i], &btelem_schema_TEST);
+        BTELEM_LOG(&others[i], TEST, d);
+    }
+    assert(memcmp(&ctx, &saved, sizeof(ctx)) == 0);
+    for (int i = 0; i < BTELEM_SHARD_BINDINGS; i++) {
+        assert(btelem_shard_detach(&others[i]) == 0);
+        btelem_deinit(&others[i]);
+    }
+
+    /* Retired slots are reused: far more init/deinit cycles than slots */
+    for (int i = 0; i < 4 * BTELEM_MAX_SHARDED_CTXS; i++) {
+        assert(btelem_init_sharded(&others[0], others_mem[0], NUM_SHARDS, RING_ENTRIES) == 0);
+        btelem_deinit(&others[0]);
+    }
+    printf(" OK\n");
+}
+
+/* ---- Batched logging ---- */
+
+/* Emit callback: records timestamps alongside values */
+struct ts_collect_ctx {
+    uint32_t values[64];
+    uint64_t ts[64];
+    int count;
+};
+
+static int ts_collect_emit(const struct btelem_entry *entry, void *user)
+{
+    struct ts_collect_ctx *tc = (struct ts_collect_ctx *)user;
+    memcpy(&tc->values[tc->count], entry->payload, sizeof(uint32_t));
+    tc->ts[tc->count++] = entry->timestamp;
+    return 0;
+}
+
+static void check_batch(int client, uint32_t n, uint64_t dt)
+{
+    struct ts_collect_ctx tc = {0};
+    int got = btelem_drain(&ctx, client, ts_collect_emit, &tc);
+    assert(got == (int)n);
+    for (uint32_t i = 0; i < n; i++) {
+        assert(tc.values[i] == 100 + i);
+        assert(tc.ts[i] == tc.ts[0] + i * dt);
+    }
+}
+
+static void test_batch_log(void)
+{
+    printf("test_batch_log...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data burst[8];
+    for (uint32_t i = 0; i < 8; i++)
+        burst[i].value = 100 + i;
+
+    /* One reservation claims all 8 slots */
+    BTELEM_LOG_BATCH(&ctx, TEST, burst, 8, 1000);
+    assert(btelem_atomic_load_acq(&ctx.ring->head) == 8);
+    check_batch(client, 8, 1000);
+
+    /* Reserve/commit by hand; uncommitted entries are invisible */
+    struct btelem_batch b;
+    assert(btelem_reserve(&ctx, &b, 4, sizeof(struct test_data)) == 0);
+    for (uint32_t i = 0; i < 4; i++)
+        btelem_batch_put(&b, i, BTELEM_ID_TEST, &burst[i], sizeof(burst[i]), 0);
+    struct ts_collect_ctx tc = {0};
+    assert(btelem_drain(&ctx, client, ts_collect_emit, &tc) == 0);
+    btelem_commit(&b);
+    check_batch(client, 4, 0);
+
+    /* Reservation limits */
+    assert(btelem_reserve(&ctx, &b, 0, 4) == -1);
+    assert(btelem_reserve(&ctx, &b, RING_ENTRIES + 1, 4) == -1);
+    assert(btelem_reserve(&ctx, &b, 1, BTELEM_MAX_PAYLOAD + 1) == -1);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_batch_log_var(void)
+{
+    printf("test_batch_log_var...");
+    setup_var();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    /* Reserve for the larger struct, then put smaller payloads into some
+     * of the records: each still takes the reserved unit count */
+    struct big_data b0;
+    memset(&b0, 0, sizeof(b0));
+    struct test_data d;
+    struct btelem_batch b;
+    assert(btelem_reserve(&ctx, &b, 6, sizeof(b0)) == 0);
+    for (uint32_t i = 0; i < 6; i++) {
+        if (i & 1) {
+            b0.value = 100 + i;
+            btelem_batch_put(&b, i, BTELEM_ID_BIG, &b0, sizeof(b0), i * 10);
+        } else {
+            d.value = 100 + i;
+            btelem_batch_put(&b, i, BTELEM_ID_TEST, &d, sizeof(d), i * 10);
+        }
+    }
+    btelem_commit(&b);
+    assert(btelem_atomic_load_acq(&ctx.ring->head) == 6 * BTELEM_VAR_UNITS(sizeof(b0)));
+    assert(btelem_client_available(&ctx, client, NULL) == 6);
+    check_batch(client, 6, 10);
+
+    /* A batch larger than the ring is refused */
+    assert(btelem_reserve(&ctx, &b, VAR_UNITS + 1, 4) == -1);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_batch_log_sharded(void)
+{
+    printf("test_batch_log_sharded...");
+    setup_sharded();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+
+    struct test_data burst[5];
+    for (uint32_t i = 0; i < 5; i++)
+        burst[i].value = 100 + i;
+
+    btelem_shard_attach(&ctx, 1);
+    BTELEM_LOG_BATCH(&ctx, TEST, burst, 5, 7);
+    assert(btelem_atomic_load_acq(&ctx.shards[1]->head) == 5);
+    check_batch(client, 5, 7);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+/* ---- Tick clock calibration ---- */
+
+struct stream_buf {
+    uint8_t data[4096];
+    size_t len;
+};
+
+static int stream_collect(const void *chunk, size_t len, void *user)
+{
+    struct stream_buf *sb = (struct stream_buf *)user;
+    memcpy(sb->data + sb->len, chunk, len);
+    sb->len += len;
+    return 0;
+}
+
+static void test_clock_schema_record(void)
+{
+    printf("test_clock_schema_record...");
+    setup();
+
+    uint8_t buf[4096];
+    int base = (int)(sizeof(struct btelem_schema_header)
+                   + sizeof(struct btelem_schema_wire)
+                   + 2 * sizeof(uint16_t));
+
+    /* Calibrate whatever BTELEM_TIMESTAMP() is (ns in the default build) */
+    assert(btelem_clock_calibrate(&ctx) == 0);
+    assert(ctx.clock.tick_hz > 0);
+#ifndef BTELEM_TIMESTAMP_TICKS
+    assert(ctx.clock.tick_hz > 900000000ULL && ctx.clock.tick_hz < 1100000000ULL);
+#endif
+
+    int len = btelem_schema_serialize(&ctx, buf, sizeof(buf));
+    assert(len == base + (int)sizeof(struct btelem_clock_wire));
+    assert(btelem_schema_serialize(&ctx, NULL, 0) == len);
+
+    struct btelem_clock_wire cw;
+    memcpy(&cw, buf + base, sizeof(cw));
+    assert(cw.magic == BTELEM_CLOCK_MAGIC);
+    assert(cw.tick_hz == ctx.clock.tick_hz);
+    assert(cw.ref_ticks == ctx.clock.ref_ticks);
+    assert(cw.ref_ns == ctx.clock.ref_ns);
+
+    /* Streamed form is byte-identical */
+    struct stream_buf sb = { .len = 0 };
+    assert(btelem_schema_stream(&ctx, stream_collect, &sb) == len);
+    assert(sb.len == (size_t)len);
+    assert(memcmp(sb.data, buf, (size_t)len) == 0);
+
+    /* Re-sample and wrap as an in-band update packet */
+    struct btelem_clock clk;
+    assert(btelem_clock_sample(&ctx, &clk) == 0);
+    assert(clk.tick_hz > 0);
+    assert(clk.ref_ns >= ctx.clock.ref_ns);
+
+    uint8_t pkt[64];
+    assert(btelem_clock_packet(&clk, pkt, 16) == -1);
+    int n = btelem_clock_packet(&clk, pkt, sizeof(pkt));
+    assert(n == (int)(sizeof(struct btelem_packet_header) + sizeof(cw)));
+    const struct btelem_packet_header *ph = (const struct btelem_packet_header *)pkt;
+    assert(ph->entry_count == 0);
+    assert(ph->flags == BTELEM_PACKET_FLAG_CLOCK);
+    assert(ph->payload_size == sizeof(cw));
+    memcpy(&cw, pkt + sizeof(*ph), sizeof(cw));
+    assert(cw.magic == BTELEM_CLOCK_MAGIC);
+    assert(cw.ref_ticks == clk.ref_ticks);
+
+    /* No tick clock: no record, and nothing to sample */
+    memset(&ctx.clock, 0, sizeof(ctx.clock));
+    assert(btelem_schema_serialize(&ctx, buf, sizeof(buf)) == base);
+    assert(btelem_clock_sample(&ctx, &clk) == -1);
+
+    printf(" OK (%lu Hz)\n", (unsigned long)cw.tick_hz);
+}
+
+/* ---- Compact schema ---- */
+
+static uint64_t fnv1a(const uint8_t *p, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static void test_compact_schema(void)
+{
+    printf("test_compact_schema...");
+    setup();
+
+    struct mixed_data { uint8_t state; uint16_t flags; };
+    static const char *labels[] = { "OFF", NULL, "ON" };
+    BTELEM_ENUM_DEF(mixed_state, labels);
+    static const struct btelem_bit_def bits[] = {
+        BTELEM_BIT("ready", 0, 1),
+        BTELEM_BIT("mode",  1, 3),
+    };
+    BTELEM_BITFIELD_DEF(mixed_flags, bits);
+    static const struct btelem_field_def mixed_fields[] = {
+        BTELEM_FIELD_ENUM(struct mixed_data, state, mixed_state),
+        BTELEM_FIELD_BITFIELD(struct mixed_data, flags, mixed_flags),
+    };
+    BTELEM_SCHEMA_ENTRY(MIXED, 3, "mixed", NULL, struct mixed_data, mixed_fields);
+    btelem_register(&ctx, &btelem_schema_MIXED);
+
+    uint8_t buf[4096];
+    int len = btelem_schema_serialize_compact(&ctx, buf, sizeof(buf));
+    assert(len > 0);
+    assert(btelem_schema_serialize_compact(&ctx, NULL, 0) == len);
+    assert(btelem_schema_serialize_compact(&ctx, buf, (size_t)len - 1) == -1);
+    int body = len - (int)sizeof(struct btelem_schema_compact_header)
+                   - (int)CLOCK_RECORD_SIZE;
+
+    struct btelem_schema_compact_header hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    assert(hdr.magic == BTELEM_SCHEMA_COMPACT_MAGIC);
+    assert(hdr.version == BTELEM_SCHEMA_COMPACT_VERSION);
+    assert(hdr.entry_count == 2);
+    assert(hdr.hash == btelem_schema_hash(&ctx));
+    assert(hdr.hash == fnv1a(buf + sizeof(hdr), (size_t)body));
+
+    /* Walk the records */
+    const uint8_t *p = buf + sizeof(hdr);
+    uint16_t v;
+#define U16() (memcpy(&v, p, 2), p += 2, v)
+#define STR(s) (assert(*p == strlen(s) && memcmp(p + 1, s, *p) == 0), p += 1 + *p)
+    assert(U16() == BTELEM_ID_TEST);
+    assert(U16() == sizeof(struct test_data));
+    assert(U16() == 1);
+    STR("test");
+    STR("Test entry");
+    STR("value");
+    assert(U16() == 0 && U16() == 4 && p[0] == BTELEM_U32 && p[1] == 1);
+    p += 2;
+
+    assert(U16() == 3);
+    assert(U16() == sizeof(struct mixed_data));
+    assert(U16() == 2);
+    STR("mixed");
+    STR("");
+    STR("state");
+    p += 6;
+    STR("flags");
+    p += 6;
+
+    assert(U16() == 1);                         /* enum section */
+    assert(U16() == 3 && U16() == 0 && *p++ == 3);
+    STR("OFF");
+    STR("");
+    STR("ON");
+
+    assert(U16() == 1);                         /* bitfield section */
+    assert(U16() == 3 && U16() == 1 && *p++ == 2);
+    STR("ready");
+    assert(p[0] == 0 && p[1] == 1);
+    p += 2;
+    STR("mode");
+    assert(p[0] == 1 && p[1] == 3);
+    p += 2;
+#undef U16
+#undef STR
+    assert(p == buf + sizeof(hdr) + body);
+
+    int fixed = btelem_schema_serialize(&ctx, NULL, 0);
+    assert(len * 20 < fixed);
+
+    /* The hash follows the content, not the calibration */
+    uint64_t h = hdr.hash;
+    assert(btelem_clock_calibrate(&ctx) == 0);
+    assert(btelem_schema_hash(&ctx) == h);
+    len = btelem_schema_serialize_compact(&ctx, buf, sizeof(buf));
+    assert(len == (int)sizeof(hdr) + body + (int)sizeof(struct btelem_clock_wire));
+    struct btelem_clock_wire cw;
+    memcpy(&cw, buf + sizeof(hdr) + body, sizeof(cw));
+    assert(cw.magic == BTELEM_CLOCK_MAGIC);
+
+    BTELEM_SCHEMA_ENTRY(MIXED2, 3, "mixed", "described", struct mixed_data, mixed_fields);
+    setup();
+    btelem_register(&ctx, &btelem_schema_MIXED2);
+    assert(btelem_schema_hash(&ctx) != h);
+
+    printf(" OK (%d bytes vs %d fixed)\n", len, fixed);
+}
+
+static void test_packet_compress(void)
+{
+    printf("test_packet_compress...");
+
+    struct sensor_data {
+        uint32_t seq;
+        float    temp;
+        float    volts;
+        int16_t  raw[4];
+        uint8_t  state;
+    };
+    static const struct btelem_field_def sensor_fields[] = {
+        BTELEM_FIELD(struct sensor_data, seq,   BTELEM_U32),
+        BTELEM_FIELD(struct sensor_data, temp,  BTELEM_F32),
+        BTELEM_FIELD(struct sensor_data, volts, BTELEM_F32),
+        BTELEM_ARRAY_FIELD(struct sensor_data, raw, BTELEM_I16, 4),
+        BTELEM_FIELD(struct sensor_data, state, BTELEM_U8),
+    };
+    BTELEM_SCHEMA_ENTRY(SENSOR, 1, "sensor", "Slow sensor", struct sensor_data, sensor_fields);
+
+    static struct btelem_ctx zctx;
+    void *mem = calloc(1, btelem_ring_size(256));
+    assert(btelem_init(&zctx, mem, 256) == 0);
+    btelem_register(&zctx, &btelem_schema_TEST);
+    btelem_register(&zctx, &btelem_schema_SENSOR);
+    int client = btelem_client_open(&zctx, NULL, 0);
+
+    for (uint32_t i = 0; i < 100; i++) {
+        struct test_data t = { .value = i };
+        struct sensor_data d = {
+            .seq = i, .temp = 21.5f + (float)(i / 50) * 0.25f, .volts = 3.3f,
+            .raw = { 100, -100, (int16_t)(i & 1), 0 }, .state = 2,
+        };
+        BTELEM_LOG(&zctx, TEST, t);
+        BTELEM_LOG(&zctx, SENSOR, d);
+    }
+
+    static uint8_t pkt[65536], z[65536], back[65536];
+    int n = btelem_drain_packed(&zctx, client, pkt, sizeof(pkt));
+    assert(n > 0 && ((struct btelem_packet_header *)pkt)->entry_count == 200);
+
+    int zn = btelem_packet_compress(pkt, (size_t)n, z, sizeof(z));
+    assert(zn > 0 && zn * 3 < n);
+    struct btelem_packet_header zh;
+    memcpy(&zh, z, sizeof(zh));
+    assert(zh.flags == BTELEM_PACKET_FLAG_COMPRESSED);
+    assert(zh.entry_count == 200);
+    assert(zh.payload_size == (uint32_t)zn - sizeof(zh));
+
+    /* Round trip is exact */
+    assert(btelem_packet_decompress(z, (size_t)zn, back, sizeof(back)) == n);
+    assert(memcmp(back, pkt, (size_t)n) == 0);
+
+    /* Truncated, undersized or not compressed */
+    zh.payload_size--;
+    memcpy(z, &zh, sizeof(zh));
+    assert(btelem_packet_decompress(z, (size_t)zn - 1, back, sizeof(back)) == -1);
+    zh.payload_size++;
+    memcpy(z, &zh, sizeof(zh));
+    assert(btelem_packet_decompress(z, (size_t)zn, back, (size_t)n - 1) == -1);
+    assert(btelem_packet_decompress(pkt, (size_t)n, back, sizeof(back)) == -1);
+
+    /* Not worth it or not applicable: send as is */
+    assert(btelem_packet_compress(pkt, (size_t)n, z, (size_t)zn - 1) == 0);
+    assert(btelem_packet_compress(z, (size_t)zn, back, sizeof(back)) == 0);
+    struct btelem_clock clk = { .tick_hz = 1000 };
+    int cn = btelem_clock_packet(&clk, back, sizeof(back));
+    assert(btelem_packet_compress(back, (size_t)cn, z, sizeof(z)) == 0);
+
+    btelem_client_close(&zctx, client);
+    free(mem);
+    printf(" OK (%d -> %d bytes)\n", n, zn);
+}
+
 /* ---- Main ---- */
 
+static void test_spill_lossless(void)
+{
+    printf("test_spill_lossless...");
+    setup();
+
+    static struct btelem_entry spill_mem[64];
+    struct btelem_spill sp;
+    assert(btelem_spill_init(&sp, spill_mem, 48) == -1);  /* not a power of 2 */
+    assert(btelem_spill_init(&sp, spill_mem, 64) == 0);
+    int client = btelem_client_open(&ctx, NULL, 0);
+    assert(btelem_spill_pump(&ctx, client) == -1);        /* no spill yet */
+    assert(btelem_client_set_spill(&ctx, client, &sp) == 0);
+
+    /* 2.5 rings' worth, pumped along the way: nothing is lost */
+    struct test_data d;
+    for (uint32_t i = 0; i < 40; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+        if (i % 4 == 3)
+            assert(btelem_spill_pump(&ctx, client) >= 0);
+    }
+    assert(btelem_atomic_load_acq(&sp.spilled) > 0);
+    assert(btelem_atomic_load_acq(&sp.peak) <= 64);
+    uint64_t dropped = 1;
+    assert(btelem_client_available(&ctx, client, &dropped) == 40);
+    assert(dropped == 0);
+
+    /* One drain reads the spill, then the ring; iov falls back to a copy */
+    uint32_t got = 0;
+    uint8_t buf[16384];
+    int n;
+    while ((n = btelem_drain_packed(&ctx, client, buf, sizeof(buf) / 2)) > 0) {
+        const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+        const struct btelem_entry_header *eh = (const struct btelem_entry_header *)(pkt + 1);
+        const uint8_t *payload = (const uint8_t *)(eh + pkt->entry_count);
+        assert(pkt->dropped == 0);
+        for (int i = 0; i < pkt->entry_count; i++) {
+            memcpy(&d, payload + eh[i].payload_offset, sizeof(d));
+            assert(d.value == got);
+            got++;
+        }
+    }
+    assert(got == 40);
+
+    /* Reading from the ring past the spill restarts the pump at the cursor */
+    for (uint32_t i = 0; i < 12; i++) {
+        d.value = 100 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    assert(btelem_spill_pump(&ctx, client) == 4);
+    static struct btelem_drain_iov dv;
+    struct collect_ctx cc = {0};
+    assert(btelem_drain_iov(&ctx, client, &dv, buf, sizeof(buf)) > 0);
+    assert(dv.iov_count == 1 && dv.ref_count == 0);
+    assert(btelem_drain(&ctx, client, collect_emit, &cc) == 0);
+
+    /* A spill too small to cover the burst drops, but keeps order */
+    struct btelem_spill small;
+    btelem_spill_init(&small, spill_mem, 4);
+    btelem_client_set_spill(&ctx, client, &small);
+    for (uint32_t i = 0; i < 40; i++) {
+        d.value = 200 + i;
+        BTELEM_LOG(&ctx, TEST, d);
+        btelem_spill_pump(&ctx, client);
+    }
+    memset(&cc, 0, sizeof(cc));
+    btelem_drain(&ctx, client, collect_emit, &cc);
+    assert(cc.count > RING_ENTRIES && cc.count < 40);
+    for (int i = 1; i < cc.count; i++)
+        assert(cc.values[i] > cc.values[i - 1]);
+    assert(cc.values[cc.count - 1] == 239);
+    assert(ctx.clients[client].dropped == (uint64_t)(40 - cc.count));
+
+    /* Fixed rings only */
+    static uint8_t var_mem[sizeof(struct btelem_ring) + 256 * BTELEM_VAR_UNIT];
+    struct btelem_ctx vctx;
+    assert(btelem_init_var(&vctx, var_mem, 256) == 0);
+    int vc = btelem_client_open(&vctx, NULL, 0);
+    assert(btelem_client_set_spill(&vctx, vc, &sp) == -1);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_stats(void)
+{
+    printf("test_stats...");
+    setup();
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    struct btelem_stats st;
+    memset(&st, 0, sizeof(st));
+    assert(btelem_stats(&ctx, &st) == 0);
+    assert(st.head == 0 && st.capacity == RING_ENTRIES && st.head_rate == 0);
+    assert(st.clients[client].active && st.clients[client].lag == 0);
+
+    /* Overflow by 4: lag is uncapped, the drain sees it and drops 4 */
+    struct test_data d;
+    for (uint32_t i = 0; i < RING_ENTRIES + 4; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    st.t_ns -= 1000000000ULL;   /* pretend the previous snapshot is 1 s old */
+    assert(btelem_stats(&ctx, &st) == 0);
+    assert(st.clients[client].lag == RING_ENTRIES + 4);
+    if (st.t_ns)
+        assert(st.head_rate > 0 && st.head_rate <= RING_ENTRIES + 4);
+
+    uint8_t buf[16384];
+    assert(btelem_drain_packed(&ctx, client, buf, sizeof(buf)) > 0);
+    btelem_stats(&ctx, &st);
+    assert(st.clients[client].lag == 0);
+    assert(st.clients[client].lag_max == RING_ENTRIES + 4);
+    assert(st.clients[client].dropped == 4);
+    assert(st.clients[client].torn == 0);
+    assert(st.clients[client].emitted == RING_ENTRIES);
+    assert(st.clients[client].packets == 1);
+
+    uint32_t counts[4];
+#if BTELEM_STATS_IDS
+    assert(btelem_stats_id_counts(&ctx, client, counts, 4) == 4);
+    assert(counts[BTELEM_ID_TEST] == RING_ENTRIES && counts[1] == 0);
+#else
+    assert(btelem_stats_id_counts(&ctx, client, counts, 4) == -1);
+#endif
+
+    /* Referenced slots lapped before release count as torn */
+    for (uint32_t i = 0; i < 4; i++)
+        BTELEM_LOG(&ctx, TEST, d);
+    static struct btelem_drain_iov dv;
+    assert(btelem_drain_iov(&ctx, client, &dv, buf, sizeof(buf)) > 0);
+    for (uint32_t i = 0; i < RING_ENTRIES; i++)
+        BTELEM_LOG(&ctx, TEST, d);
+    assert(btelem_drain_iov_release(&ctx, &dv) == 4);
+    btelem_stats(&ctx, &st);
+    assert(st.clients[client].torn == 4);
+    assert(st.clients[client].packets == 2);
+
+    /* Reopening a slot resets its counters */
+    btelem_client_close(&ctx, client);
+    client = btelem_client_open(&ctx, NULL, 0);
+    btelem_stats(&ctx, &st);
+    assert(st.clients[client].torn == 0 && st.clients[client].lag_max == 0);
+    assert(st.clients[client].emitted == 0);
+
+    /* Self-published entry */
+    assert(btelem_stats_publish(&ctx, &st) == -1);  /* not registered */
+    assert(btelem_stats_register(&ctx) == 0);
+    assert(btelem_stats_publish(&ctx, &st) == 0);
+    int found = 0;
+    uint64_t head = st.head;
+    for (;;) {
+        uint8_t pb[4096];
+        int n = btelem_drain_packed(&ctx, client, pb, sizeof(pb));
+        if (n <= 0)
+            break;
+        const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)pb;
+        const struct btelem_entry_header *eh = (const struct btelem_entry_header *)(pkt + 1);
+        const uint8_t *payload = (const uint8_t *)(eh + pkt->entry_count);
+        for (int i = 0; i < pkt->entry_count; i++) {
+            if (eh[i].id != BTELEM_STATS_ID)
+                continue;
+            struct btelem_stats_entry se;
+            assert(eh[i].payload_size == sizeof(se));
+            memcpy(&se, payload + eh[i].payload_offset, sizeof(se));
+            assert(se.head == head);
+            assert(se.active == (1u << client));
+            found++;
+        }
+    }
+    assert(found == 1);
+
+    /* The reserved ID can't be taken over */
+    static const struct btelem_schema_entry other = {
+        .id = BTELEM_STATS_ID, .name = "other", .payload_size = 4,
+        .field_count = 1, .fields = test_fields,
+    };
+    setup();
+    btelem_register(&ctx, &other);
+    assert(btelem_stats_register(&ctx) == -1);
+
+    printf(" OK\n");
+}
+
+static void test_stats_sharded(void)
+{
+    printf("test_stats_sharded...");
+    setup_sharded();
+
+    /* The stats writer gets its own shard, never a producer thread's */
+    assert(btelem_stats_register(&ctx) == 0);
+    assert(btelem_stats_register(&ctx) == 0);    /* idempotent */
+    assert(btelem_atomic_load_relaxed(&ctx.shards_busy) == 1);
+
+    int client = btelem_client_open(&ctx, NULL, 0);
+    struct btelem_stats st;
+    memset(&st, 0, sizeof(st));
+    assert(btelem_stats_publish(&ctx, &st) == 0);
+    assert(btelem_shard_detach(&ctx) == -1);     /* publishing bound nothing */
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 1);
+
+    struct test_data d = {.value = 7};
+    BTELEM_LOG(&ctx, TEST, d);                   /* producer takes shard 1 */
+    assert(btelem_atomic_load_acq(&ctx.shards[1]->head) == 1);
+    assert(btelem_shard_attach(&ctx, -1) == -1);
+    assert(btelem_stats_publish(&ctx, &st) == 0);
+    assert(btelem_atomic_load_acq(&ctx.shards[0]->head) == 2);
+    assert(btelem_client_available(&ctx, client, NULL) == 3);
+
+    btelem_client_close(&ctx, client);
+    printf(" OK\n");
+}
+
+static void test_open_at_trigger(void)
+{
+    printf("test_open_at_trigger...");
+    setup();
+
+    /* History logged before the client exists */
+    struct test_data d;
+    for (uint32_t i = 0; i < RING_ENTRIES + 4; i++) {
+        d.value = i;
+        BTELEM_LOG(&ctx, TEST, d);
+    }
+    assert(btelem_client_open_at(&ctx, 7, NULL, 0) == -1);
+    int head = btelem_client_open_at(&ctx, BTELEM_FROM_HEAD, NULL, 0);
+    int oldest = btelem_client_open_at(&ctx, BTELEM_FROM_OLDEST, NULL, 0);
+    assert(head >= 0 && oldest >= 0);
+
+    struct collect_ctx cc = {0};
+    assert(btelem_drain(&ctx, head, collect_emit, &cc) == 0);
+    assert(btelem_drain(&ctx, oldest, collect_emit, &cc) == RING_ENTRIES);
+    assert(cc.values[0] == 4 && cc.values[RING_ENTRIES - 1] == RING_ENTRIES + 3);
+    assert(ctx.clients[oldest].dropped == 0);
+
+    /* Triggers: a window around now, latest wins */
+    uint64_t from = 1, to = 1;
+    assert(btelem_trigger_get(&ctx, &from, &to) == 0);
+    assert(from == 1 && to == 1);
+    uint64_t t0 = BTELEM_TIMESTAMP();
+    btelem_trigger(&ctx, 0, 0);
+    uint64_t t1 = BTELEM_TIMESTAMP();
+    assert(btelem_trigger_get(&ctx, &from, &to) == 1);
+    assert(from == to && from >= t0 && from <= t1);
+    btelem_trigger(&ctx, 1000000, 2000000);
+    assert(btelem_trigger_get(&ctx, &from, NULL) == 2);
+    assert(btelem_trigger_get(&ctx, NULL, &to) == 2);
+    assert(to > from);
+    if (ctx.clock.tick_hz == 0)
+        assert(to - from == 3000000);
+
+    btelem_client_close(&ctx, head);
+    btelem_client_close(&ctx, oldest);
+    printf(" OK\n");
+}
+
 int main(void)
 {
     printf("btelem ring buffer tests\n");
@@ -477,8 +2002,37 @@ int main(void)
     test_drain_packed();
     test_drain_packed_filtered();
     test_drain_packed_dropped();
+    test_drain_iov();
+    test_drain_iov_guard();
+    test_drain_iov_settle();
+    test_wake_arm();
+    test_wake_set_waits();
     test_enum_schema_serialize();
     test_bitfield_schema_serialize();
+    test_var_init_args();
+    test_var_log_drain();
+    test_var_wrap_payload();
+    test_var_overwrite_resync();
+    test_var_drain_packed();
+    test_var_drain_iov();
+    test_var_density();
+    test_sharded_merge();
+    test_sharded_drops();
+    test_sharded_auto_attach();
+    test_sharded_detach();
+    test_sharded_explicit_attach();
+    test_sharded_two_contexts();
+    test_sharded_deinit();
+    test_batch_log();
+    test_batch_log_var();
+    test_batch_log_sharded();
+    test_clock_schema_record();
+    test_compact_schema();
+    test_packet_compress();
+    test_stats();
+    test_stats_sharded();
+    test_spill_lossless();
+    test_open_at_trigger();
 
     printf("\nAll tests passed.\n");
     return 0;
@@ -10,9 +10,21 @@ sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "python"))
 
 import struct
 
-from btelem.schema import Schema, SchemaEntry, FieldDef, BitDef, BtelemType
-from btelem.decoder import decode_packet, PacketDecoder
+from btelem.schema import (
+    Schema, SchemaEntry, FieldDef, BitDef, BtelemType, ClockCalibration,
+    CLOCK_WIRE_SIZE, compact_schema_hash, fnv1a64,
+)
+from btelem.decoder import (
+    decode_packet, PacketDecoder, PACKET_HEADER_FMT, PACKET_HEADER_SIZE,
+    PACKET_FLAG_CLOCK, PACKET_FLAG_COMPRESSED, PACKET_FLAG_SCHEMA,
+    compress_packet, decompress_packet,
+)
 from btelem.storage import LogReader, LogWriter, build_packet
+from btelem.transport import (
+    CTRL_COMPRESS, CTRL_HELLO, CTRL_RESET, CTRL_SUBSCRIBE, CTRL_UNSUBSCRIBE, SCHEMA_HELLO_FMT,
+    SCHEMA_HELLO_MAGIC, UDPPacketReceiver, encode_control, encode_hello,
+    resolve_schema,
+)
 
 
 def test_schema_roundtrip():
@@ -260,6 +272,63 @@ def test_log_file_time_range():
     print(" OK")
 
 
+def test_log_file_id_summary():
+    """Test the per-packet ID summary (index v2) and ID-filtered reads."""
+    print("test_log_file_id_summary...", end="")
+
+    import tempfile
+    from btelem.storage import INDEX_FOOTER_FMT, INDEX_FOOTER_SIZE, INDEX_ENTRY_SIZE
+
+    schema = Schema([
+        SchemaEntry(0, "common", "Common", 4, [
+            FieldDef("value", 0, 4, BtelemType.U32),
+        ]),
+        SchemaEntry(7, "rare", "Rare", 4, [
+            FieldDef("value", 0, 4, BtelemType.U32),
+        ]),
+    ])
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+
+    try:
+        with LogWriter(tmppath, schema) as writer:
+            writer.write_entries([(0, 1000, struct.pack("<I", 1)),
+                                  (0, 2000, struct.pack("<I", 2))])
+            writer.write_entries([(7, 3000, struct.pack("<I", 70)),
+                                  (0, 3500, struct.pack("<I", 3)),
+                                  (7, 4000, struct.pack("<I", 71))])
+            writer.write_entries([])
+            writer.write_entries([(0, 5000, struct.pack("<I", 4))])
+
+        with LogReader(tmppath) as reader:
+            assert [ie.id_counts for ie in reader.index] == [
+                {0: 2}, {0: 1, 7: 2}, {}, {0: 1}]
+            assert [e.fields["value"] for e in reader.entries(filter_ids={7})] == [70, 71]
+            assert [e.fields["value"] for e in reader.entries(filter_ids={0})] == [1, 2, 3, 4]
+            assert len(list(reader.entries())) == 6
+
+        # A file whose index has no ID summary still reads (index v1)
+        with open(tmppath, "rb") as f:
+            data = f.read()
+        index_offset, count, magic = struct.unpack(INDEX_FOOTER_FMT, data[-INDEX_FOOTER_SIZE:])
+        ids_offset = struct.unpack_from("<Q", data, index_offset - 16)[0]
+        v1 = (data[:ids_offset] + data[index_offset:-INDEX_FOOTER_SIZE]
+              + struct.pack(INDEX_FOOTER_FMT, ids_offset, count, magic))
+        assert len(v1) == ids_offset + count * INDEX_ENTRY_SIZE + INDEX_FOOTER_SIZE
+        with open(tmppath, "wb") as f:
+            f.write(v1)
+        with LogReader(tmppath) as reader:
+            assert len(reader.index) == 4
+            assert all(ie.id_counts is None for ie in reader.index)
+            assert [e.fields["value"] for e in reader.entries(filter_ids={7})] == [70, 71]
+            assert len(list(reader.entries())) == 6
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
 def test_read_c_generated_log():
     """Read the .btlm file generated by the C basic example."""
     print("test_read_c_generated_log...", end="")
@@ -470,6 +539,286 @@ def test_bitfield_backward_compat():
     print(" OK")
 
 
+def _clock_packet(clock: ClockCalibration) -> bytes:
+    return struct.pack(PACKET_HEADER_FMT, 0, PACKET_FLAG_CLOCK,
+                       CLOCK_WIRE_SIZE, 0, 0) + clock.to_bytes()
+
+
+def test_clock_calibration():
+    """Tick timestamps are converted to ns via the schema clock record."""
+    print("test_clock_calibration...", end="")
+
+    entries = [SchemaEntry(0, "test", "Test", 4, [
+        FieldDef("value", 0, 4, BtelemType.U32),
+    ])]
+    plain = Schema(entries).to_bytes()
+    assert Schema.from_bytes(plain).clock is None
+
+    # 2 GHz counter, tick 1_000_000 observed at 5 s
+    clock = ClockCalibration(2_000_000_000, 1_000_000, 5_000_000_000)
+    blob = Schema(entries, clock=clock).to_bytes()
+    assert len(blob) == len(plain) + CLOCK_WIRE_SIZE
+    schema = Schema.from_bytes(blob)
+    assert schema.clock == clock
+
+    pkt = build_packet([
+        (0, 1_000_000, struct.pack("<I", 1)),
+        (0, 1_002_000, struct.pack("<I", 2)),
+        (0, 999_998, struct.pack("<I", 3)),
+    ])
+    result = decode_packet(schema, pkt)
+    assert [e.timestamp for e in result.entries] == [
+        5_000_000_000, 5_000_001_000, 4_999_999_999]
+
+    # In-band update replaces the calibration for later packets
+    decoder = PacketDecoder(schema)
+    update = ClockCalibration(1_000_000_000, 0, 0)
+    stream = b""
+    for p in (_clock_packet(update), pkt):
+        stream += struct.pack("<I", len(p)) + p
+    results = decoder.feed(stream)
+    assert decoder.schema.clock == update
+    assert [e.timestamp for e in results] == [1_000_000, 1_002_000, 999_998]
+
+    print(" OK")
+
+
+def test_log_file_clock():
+    """LogWriter folds clock packets into the file's schema record."""
+    print("test_log_file_clock...", end="")
+
+    import tempfile
+
+    schema = Schema([
+        SchemaEntry(0, "test", "Test", 4, [
+            FieldDef("value", 0, 4, BtelemType.U32),
+        ]),
+    ], clock=ClockCalibration(1_000_000, 0, 0))  # 1 tick = 1 us
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+
+    try:
+        with LogWriter(tmppath, schema) as writer:
+            writer.write_entries([(0, 10, struct.pack("<I", 10))])
+            writer.write_packet(_clock_packet(ClockCalibration(1_000_000, 0, 1000)))
+            writer.write_entries([(0, 20, struct.pack("<I", 20))])
+
+        with LogReader(tmppath) as reader:
+            assert reader.schema.clock == ClockCalibration(1_000_000, 0, 1000)
+            assert len(reader.index) == 2
+            entries = list(reader.entries())
+            assert [e.timestamp for e in entries] == [11_000, 21_000]
+            entries = list(reader.entries(ts_min=15_000, ts_max=25_000))
+            assert [e.fields["value"] for e in entries] == [20]
+    finally:
+        os.unlink(tmppath)
+
+    print(" OK")
+
+
+def _with_seq(pkt: bytes, seq: int) -> bytes:
+    return pkt[:12] + struct.pack("<I", seq) + pkt[PACKET_HEADER_SIZE:]
+
+
+def test_udp_packet_receiver():
+    """Binary UDP datagrams: in-band schema fragments and sequence gaps."""
+    print("test_udp_packet_receiver...", end="")
+
+    blob = Schema([
+        SchemaEntry(0, "test", "Test", 4, [
+            FieldDef("value", 0, 4, BtelemType.U32),
+        ]),
+    ]).to_bytes()
+    frags = []
+    for off in range(0, len(blob), 500):
+        chunk = blob[off:off + 500]
+        frags.append(struct.pack(PACKET_HEADER_FMT, 0, PACKET_FLAG_SCHEMA,
+                                 8 + len(chunk), 0, 0)
+                     + struct.pack("<II", len(blob), off) + chunk)
+    assert len(frags) > 1
+
+    rx = UDPPacketReceiver(bind=False)
+    data = build_packet([(0, 1000, struct.pack("<I", 7))])
+    assert rx.feed(_with_seq(data, 0)) == []          # no schema yet
+    seq = 1
+    for f in frags:
+        assert rx.feed(_with_seq(f, seq)) == []
+        seq += 1
+    assert rx.schema is not None and 0 in rx.schema.entries
+
+    out = rx.feed(_with_seq(data, seq))
+    assert [e.fields["value"] for e in out] == [7]
+    assert rx.lost == 0
+
+    # Two datagrams lost in transit
+    seq += 3
+    out = rx.feed(_with_seq(data, seq))
+    assert len(out) == 1 and rx.lost == 2
+
+    # A resend missing its first fragment is ignored, schema kept
+    for f in frags[1:]:
+        seq += 1
+        rx.feed(_with_seq(f, seq))
+    assert rx.lost == 2 and rx.schema is not None
+
+    print(" OK")
+
+
+def test_encode_control():
+    """Subscription control messages match the btelem_ctrl_* wire layout."""
+    print("test_encode_control...", end="")
+
+    msg = encode_control(CTRL_SUBSCRIBE, {3: 50.0, 7: 0})
+    assert struct.unpack_from("<IHH", msg) == (4 + 2 * 8, CTRL_SUBSCRIBE, 2)
+    assert struct.unpack_from("<HHIHHI", msg, 8) == (3, 0, 20000, 7, 0, 0)
+
+    msg = encode_control(CTRL_UNSUBSCRIBE, [5])
+    assert msg == struct.pack("<IHHHHI", 12, CTRL_UNSUBSCRIBE, 1, 5, 0, 0)
+    assert encode_control(CTRL_RESET) == struct.pack("<IHH", 4, CTRL_RESET, 0)
+
+    print(" OK")
+
+
+def test_compact_schema():
+    """Compact schema round-trips the same content as the fixed-size form."""
+    print("test_compact_schema...", end="")
+
+    entries = [
+        SchemaEntry(0, "motor", "Motor controller", 7, [
+            FieldDef("state", 0, 1, BtelemType.ENUM, 1,
+                     enum_labels=["IDLE", "", "RUNNING"]),
+            FieldDef("flags", 1, 2, BtelemType.BITFIELD, 1,
+                     bitfield_bits=[BitDef("ready", 0, 1), BitDef("mode", 1, 3)]),
+            FieldDef("rpm", 3, 4, BtelemType.F32),
+        ]),
+        SchemaEntry(5, "x" * 80, "", 8, [
+            FieldDef("samples", 0, 8, BtelemType.U16, 4),
+        ]),
+    ]
+    clock = ClockCalibration(3_000_000_000, 10, 20)
+    schema = Schema(entries, clock=clock)
+
+    blob = schema.to_compact_bytes()
+    fixed = schema.to_bytes()
+    assert len(blob) * 20 < len(fixed)
+
+    got = Schema.from_bytes(blob)
+    want = Schema.from_bytes(fixed)
+    assert got.entries == want.entries
+    assert got.entries[5].name == "x" * 63           # truncated like NAME_MAX
+    assert got.entries[0].fields[1].bitfield_bits[1] == BitDef("mode", 1, 3)
+    assert got.clock == clock
+
+    # Header hash covers the records, not the clock
+    h = compact_schema_hash(blob)
+    assert h == fnv1a64(blob[16:-CLOCK_WIRE_SIZE])
+    assert compact_schema_hash(Schema(entries).to_compact_bytes()) == h
+    assert compact_schema_hash(fixed) is None
+    entries[0].fields[2].name = "rpm2"
+    assert compact_schema_hash(Schema(entries).to_compact_bytes()) != h
+
+    print(" OK")
+
+
+def test_schema_hello():
+    """HELLO messages and resolving the stream's first message."""
+    print("test_schema_hello...", end="")
+
+    assert encode_hello(0x1122334455667788) == struct.pack(
+        "<IHHQ", 12, CTRL_HELLO, 0, 0x1122334455667788)
+
+    blob = Schema([SchemaEntry(1, "a", "b", 4, [
+        FieldDef("v", 0, 4, BtelemType.U32)])]).to_compact_bytes()
+    h = compact_schema_hash(blob)
+
+    sent = struct.pack(SCHEMA_HELLO_FMT, SCHEMA_HELLO_MAGIC, len(blob), h) + blob
+    assert resolve_schema(sent) == blob
+    skipped = struct.pack(SCHEMA_HELLO_FMT, SCHEMA_HELLO_MAGIC, 0, h)
+    assert resolve_schema(skipped, blob) is blob
+    try:
+        resolve_schema(skipped, None)
+        assert False, "expected ValueError"
+    except ValueError:
+        pass
+
+    # Servers without HELLO support send the fixed-size schema directly
+    fixed = Schema.from_bytes(blob).to_bytes()
+    assert resolve_schema(fixed) == fixed
+
+    print(" OK")
+
+
+def test_packet_compression():
+    """Delta-coded packets: round trip, decode, and compressed log files."""
+    print("test_packet_compression...", end="")
+
+    import tempfile
+
+    schema = Schema([
+        SchemaEntry(0, "sensor", "Sensor", 12, [
+            FieldDef("seq", 0, 4, BtelemType.U32),
+            FieldDef("temp", 4, 4, BtelemType.F32),
+            FieldDef("state", 8, 4, BtelemType.U32),
+        ]),
+        SchemaEntry(1, "event", "Event", 4, [
+            FieldDef("code", 0, 4, BtelemType.U32),
+        ]),
+    ])
+
+    def batch(t0, n):
+        return [(i % 2, t0 + i * 1000 - (i % 3),
+                 struct.pack("<IfI", i, 20.5, 3) if i % 2 == 0
+                 else struct.pack("<I", 0xE000 + i % 4)) for i in range(n)]
+
+    pkt = build_packet(batch(10_000, 40))
+    z = compress_packet(pkt)
+    assert z is not None and len(z) * 3 < len(pkt)
+    count, flags, body, _, _ = struct.unpack_from(PACKET_HEADER_FMT, z, 0)
+    assert (count, flags, body) == (40, PACKET_FLAG_COMPRESSED, len(z) - PACKET_HEADER_SIZE)
+    assert decompress_packet(z) == pkt
+    assert decode_packet(schema, z).entries == decode_packet(schema, pkt).entries
+
+    # Only plain entry batches are compressed
+    clock = _clock_packet(ClockCalibration(24_000_000, 0, 0))
+    assert compress_packet(clock) is None
+    assert compress_packet(z) is None
+    assert compress_packet(build_packet([])) is None
+    for bad in (z[:-1], z[:PACKET_HEADER_SIZE + 3], pkt):
+        try:
+            decompress_packet(bad)
+            assert False, "expected ValueError"
+        except ValueError:
+            pass
+
+    with tempfile.NamedTemporaryFile(suffix=".btlm", delete=False) as f:
+        tmppath = f.name
+    try:
+        with LogWriter(tmppath, schema, compress=True) as writer:
+            writer.write_entries(batch(10_000, 40))
+            writer.write_entries(batch(100_000, 40))
+        with LogWriter(tmppath + ".plain", schema) as writer:
+            writer.write_entries(batch(10_000, 40))
+            writer.write_entries(batch(100_000, 40))
+        assert os.path.getsize(tmppath) * 2 < os.path.getsize(tmppath + ".plain")
+
+        with LogReader(tmppath) as reader:
+            assert [(ie.ts_min, ie.ts_max, ie.entry_count) for ie in reader.index] == [
+                (10_000, 49_000, 40), (100_000, 139_000, 40)]
+            with LogReader(tmppath + ".plain") as plain:
+                assert list(reader.entries()) == list(plain.entries())
+            in_range = list(reader.entries(ts_min=120_000, ts_max=130_000))
+            assert [e.timestamp for e in in_range] == [
+                100_000 + i * 1000 - (i % 3) for i in range(21, 31)]
+    finally:
+        os.unlink(tmppath)
+        os.unlink(tmppath + ".plain")
+
+    assert encode_control(CTRL_COMPRESS) == struct.pack("<IHH", 4, CTRL_COMPRESS, 0)
+
+    print(" OK")
+
+
 if __name__ == "__main__":
     print("btelem Python tests")
     print("====================\n")
@@ -481,6 +830,7 @@ if __name__ == "__main__":
     test_packet_decoder_stream()
     test_log_file_roundtrip()
     test_log_file_time_range()
+    test_log_file_id_summary()
     test_read_c_generated_log()
     test_enum_schema_roundtrip()
     test_enum_decode()
@@ -488,5 +838,12 @@ if __name__ == "__main__":
     test_bitfield_schema_roundtrip()
     test_bitfield_decode()
     test_bitfield_backward_compat()
+    test_clock_calibration()
+    test_log_file_clock()
+    test_udp_packet_receiver()
+    test_encode_control()
+    test_compact_schema()
+    test_schema_hello()
+    test_packet_compression()
 
     print("\nAll tests passed.")
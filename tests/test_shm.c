@@ -0,0 +1,321 @@
+/**
+ * btelem shared-memory ring test
+ *
+ * Forks processes around a btelem_init_shm() segment.  Verifies that:
+ *   - A consumer process that attaches, opens a client and drains sees
+ *     every entry in order, along with the producer's published schema.
+ *   - The segment outlives a producer killed mid-run, the dead process's
+ *     client slot is reclaimed, and the last ring's worth can be extracted.
+ *   - Attach refuses missing or incompatible segments, and init refuses
+ *     to replace an existing one.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "btelem/btelem_shm.h"
+
+/* --------------------------------------------------------------------------
+ * Config
+ * ----------------------------------------------------------------------- */
+
+#define RING_ENTRIES       4096
+#define STREAM_ENTRIES     100000
+#define BATCH_ENTRIES      1000
+#define CRASH_ENTRIES      10000
+#define TEST_TIMEOUT_SEC   30
+
+/* --------------------------------------------------------------------------
+ * Schema
+ * ----------------------------------------------------------------------- */
+
+struct seq_payload {
+    uint64_t seq;
+    uint32_t pid;
+};
+
+static const struct btelem_field_def seq_fields[] = {
+    BTELEM_FIELD(struct seq_payload, seq, BTELEM_U64),
+    BTELEM_FIELD(struct seq_payload, pid, BTELEM_U32),
+};
+BTELEM_SCHEMA_ENTRY(SEQ, 0, "seq", "Sequence counter", struct seq_payload, seq_fields);
+
+static char name[64];
+
+static void log_seq(struct btelem_ctx *ctx, uint64_t from, uint64_t n)
+{
+    for (uint64_t i = from; i < from + n; i++) {
+        struct seq_payload p = { i, (uint32_t)getpid() };
+        BTELEM_LOG(ctx, SEQ, p);
+    }
+}
+
+/* Drain one packet; checks order.  Returns entries, -1 on a gap. */
+static int drain_check(struct btelem_ctx *ctx, int client, uint64_t *next,
+                       uint64_t *dropped)
+{
+    static uint8_t buf[65536];
+    int n = btelem_drain_packed(ctx, client, buf, sizeof(buf));
+    if (n <= 0)
+        return 0;
+    const struct btelem_packet_header *pkt = (const struct btelem_packet_header *)buf;
+    const struct btelem_entry_header *eh = (const struct btelem_entry_header *)(pkt + 1);
+    const uint8_t *payload = (const uint8_t *)(eh + pkt->entry_count);
+    *dropped += pkt->dropped;
+    for (int i = 0; i < pkt->entry_count; i++) {
+        struct seq_payload p;
+        memcpy(&p, payload + eh[i].payload_offset, sizeof(p));
+        if (p.seq != *next) {
+            printf("  expected seq %llu, got %llu\n",
+                   (unsigned long long)*next, (unsigned long long)p.seq);
+            return -1;
+        }
+        (*next)++;
+    }
+    return pkt->entry_count;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 1: a separate process drains the shared ring
+ * ----------------------------------------------------------------------- */
+
+/* Child: attach, check the schema, drain STREAM_ENTRIES in order */
+static int consumer(void)
+{
+    struct btelem_ctx ctx;
+    if (btelem_attach_shm(&ctx, name) < 0) {
+        printf("  consumer: attach failed\n");
+        return 1;
+    }
+    int client = btelem_client_open(&ctx, NULL, 0);
+    if (client < 0) {
+        printf("  consumer: no client slot\n");
+        return 1;
+    }
+
+    uint8_t schema[4096];
+    int slen = btelem_shm_schema(&ctx, schema, sizeof(schema));
+    const struct btelem_schema_compact_header *sh =
+        (const struct btelem_schema_compact_header *)schema;
+    if (slen <= 0 || sh->magic != BTELEM_SCHEMA_COMPACT_MAGIC
+        || btelem_shm_schema(&ctx, NULL, 0) != slen
+        || btelem_shm_schema(&ctx, schema, 8) != -1) {
+        printf("  consumer: schema missing or malformed (%d bytes)\n", slen);
+        return 1;
+    }
+
+    uint64_t next = 0, dropped = 0;
+    while (next < STREAM_ENTRIES) {
+        int n = drain_check(&ctx, client, &next, &dropped);
+        if (n < 0 || dropped)
+            return 1;
+        if (n == 0)
+            usleep(200);
+    }
+    btelem_client_close(&ctx, client);
+    btelem_shm_detach(&ctx);
+    return 0;
+}
+
+static int test_stream(void)
+{
+    printf("Test 1: out-of-process drain (%d entries)\n", STREAM_ENTRIES);
+    struct btelem_ctx ctx;
+    if (btelem_init_shm(&ctx, name, RING_ENTRIES) < 0) {
+        printf("  FAIL: btelem_init_shm\n\n");
+        return 1;
+    }
+    btelem_register(&ctx, &btelem_schema_SEQ);
+    if (btelem_shm_publish_schema(&ctx) < 0) {
+        printf("  FAIL: btelem_shm_publish_schema\n\n");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(consumer());
+
+    /* Start once the consumer holds a client, pacing so it keeps up */
+    const struct btelem_shm_header *h = (const struct btelem_shm_header *)ctx.shm;
+    while (btelem_atomic_load_acq((btelem_atomic_u64 *)&h->client_claim) == 0)
+        usleep(1000);
+    for (uint64_t i = 0; i < STREAM_ENTRIES; i += BATCH_ENTRIES) {
+        log_seq(&ctx, i, BATCH_ENTRIES);
+        usleep(2000);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    int bad = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    if (btelem_atomic_load_acq((btelem_atomic_u64 *)&h->client_claim) != 0) {
+        printf("  consumer's slot still claimed\n");
+        bad = 1;
+    }
+    btelem_shm_detach(&ctx);
+    btelem_shm_unlink(name);
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 2: post-mortem extraction after the producer is killed
+ * ----------------------------------------------------------------------- */
+
+static int test_post_mortem(void)
+{
+    printf("Test 2: post-mortem extraction (%d entries, %d-slot ring)\n",
+           CRASH_ENTRIES, RING_ENTRIES);
+
+    int ready[2];
+    if (pipe(ready) < 0)
+        return 1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        struct btelem_ctx ctx;
+        if (btelem_init_shm(&ctx, name, RING_ENTRIES) < 0)
+            _exit(1);
+        btelem_register(&ctx, &btelem_schema_SEQ);
+        btelem_shm_publish_schema(&ctx);
+        btelem_client_open(&ctx, NULL, 0);  /* dies holding a slot */
+        log_seq(&ctx, 0, CRASH_ENTRIES);
+        char c = 1;
+        if (write(ready[1], &c, 1) != 1)
+            _exit(1);
+        for (;;)
+            pause();
+    }
+    close(ready[1]);
+    char c = 0;
+    int bad = read(ready[0], &c, 1) != 1;
+    close(ready[0]);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    struct btelem_ctx ctx;
+    if (bad || btelem_attach_shm(&ctx, name) < 0) {
+        printf("  FAIL: attach after crash\n\n");
+        btelem_shm_unlink(name);
+        return 1;
+    }
+    if (ctx.clients[0].active) {
+        printf("  dead producer's client not reclaimed\n");
+        bad = 1;
+    }
+    int client = btelem_client_open(&ctx, NULL, 0);
+    if (client < 0 || btelem_client_rewind(&ctx, client) < 0) {
+        printf("  FAIL: client open/rewind\n\n");
+        return 1;
+    }
+
+    uint64_t next = CRASH_ENTRIES - RING_ENTRIES, dropped = 0;
+    int n;
+    while ((n = drain_check(&ctx, client, &next, &dropped)) > 0)
+        ;
+    printf("  extracted seq %d..%llu\n", CRASH_ENTRIES - RING_ENTRIES,
+           (unsigned long long)next - 1);
+    if (n < 0 || next != CRASH_ENTRIES || dropped != 0)
+        bad = 1;
+
+    btelem_client_close(&ctx, client);
+    btelem_shm_detach(&ctx);
+    btelem_shm_unlink(name);
+
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 3: attach validates the segment
+ * ----------------------------------------------------------------------- */
+
+static int test_attach_checks(void)
+{
+    printf("Test 3: attach and init reject missing, incompatible and existing segments\n");
+    int bad = 0;
+    struct btelem_ctx ctx, other;
+
+    btelem_shm_unlink(name);
+    if (btelem_attach_shm(&other, name) == 0) {
+        printf("  attached to a missing segment\n");
+        bad = 1;
+    }
+
+    if (btelem_init_shm(&ctx, name, RING_ENTRIES) < 0 || btelem_init_shm(&other, name, 1000) == 0) {
+        printf("  FAIL: init\n\n");
+        return 1;
+    }
+    if (btelem_shm_schema(&ctx, NULL, 0) != 0) {
+        printf("  schema reported before publish\n");
+        bad = 1;
+    }
+    errno = 0;
+    if (btelem_init_shm(&other, name, RING_ENTRIES) == 0 || errno != EEXIST) {
+        printf("  init replaced an existing segment\n");
+        bad = 1;
+    }
+    struct btelem_shm_header *h = (struct btelem_shm_header *)ctx.shm;
+    h->version++;
+    if (btelem_attach_shm(&other, name) == 0) {
+        printf("  attached to a segment of another version\n");
+        bad = 1;
+    }
+    h->version--;
+    h->client_size++;
+    if (btelem_attach_shm(&other, name) == 0) {
+        printf("  attached to a segment with another client layout\n");
+        bad = 1;
+    }
+    h->client_size--;
+    if (btelem_attach_shm(&other, name) != 0) {
+        printf("  could not attach to a good segment\n");
+        bad = 1;
+    } else {
+        btelem_shm_detach(&other);
+    }
+
+    btelem_shm_detach(&ctx);
+    btelem_shm_unlink(name);
+    printf("  %s\n\n", bad ? "FAIL" : "PASS");
+    return bad;
+}
+
+/* --------------------------------------------------------------------------
+ * Main
+ * ----------------------------------------------------------------------- */
+
+static void alarm_handler(int sig)
+{
+    (void)sig;
+    fprintf(stderr, "TIMEOUT: test exceeded %d seconds\n", TEST_TIMEOUT_SEC);
+    btelem_shm_unlink(name);
+    _exit(1);
+}
+
+int main(void)
+{
+    signal(SIGALRM, alarm_handler);
+    alarm(TEST_TIMEOUT_SEC);
+
+    printf("btelem shared-memory ring test\n");
+    printf("==============================\n\n");
+
+    snprintf(name, sizeof(name), "/btelem_test_shm_%d", (int)getpid());
+
+    int failed = 0;
+    failed += test_stream();
+    failed += test_post_mortem();
+    failed += test_attach_checks();
+    int total = 3;
+
+    printf("%s (%d/%d passed)\n",
+           failed ? "FAILED" : "ALL PASSED",
+           total - failed, total);
+
+    return failed ? 1 : 0;
+}
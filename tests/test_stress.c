@@ -53,10 +53,12 @@ struct test_case {
     int  num_producers;
     int  num_consumers;
     int  entries_per_producer;
-    int  ring_entries;          /* must be power of 2 */
+    int  ring_entries;          /* must be power of 2 (units if var_ring) */
     int  producer_delay_us;     /* sleep between writes */
     int  consumer_delay_us;     /* sleep between drain calls */
     int  expect_drops;          /* 1 if drops are expected */
+    int  var_ring;              /* 1 = BTELEM_RING_VAR layout */
+    int  sharded;               /* 1 = one shard per producer */
 };
 
 static const struct test_case test_cases[] = {
@@ -120,6 +122,61 @@ static const struct test_case test_cases[] = {
         .consumer_delay_us   = 0,
         .expect_drops        = 0,
     },
+    {
+        .name                = "var_fast_prod_slow_cons",
+        .num_producers       = 4,
+        .num_consumers       = 2,
+        .entries_per_producer = 100000,
+        .ring_entries        = 64,
+        .producer_delay_us   = 0,
+        .consumer_delay_us   = 1000,
+        .expect_drops        = 1,
+        .var_ring            = 1,
+    },
+    {
+        .name                = "var_many_prod_one_cons",
+        .num_producers       = MAX_PRODUCERS,
+        .num_consumers       = 1,
+        .entries_per_producer = 50000,
+        .ring_entries        = 64,
+        .producer_delay_us   = 0,
+        .consumer_delay_us   = 0,
+        .expect_drops        = 1,
+        .var_ring            = 1,
+    },
+    {
+        .name                = "var_slow_prod_fast_cons",
+        .num_producers       = 2,
+        .num_consumers       = 4,
+        .entries_per_producer = 10000,
+        .ring_entries        = 256,
+        .producer_delay_us   = 50,
+        .consumer_delay_us   = 0,
+        .expect_drops        = 0,
+        .var_ring            = 1,
+    },
+    {
+        .name                = "shard_many_prod_one_cons",
+        .num_producers       = MAX_PRODUCERS,
+        .num_consumers       = 1,
+        .entries_per_producer = 50000,
+        .ring_entries        = 64,
+        .producer_delay_us   = 0,
+        .consumer_delay_us   = 0,
+        .expect_drops        = 1,
+        .sharded             = 1,
+    },
+    {
+        .name                = "shard_slow_prod_fast_cons",
+        .num_producers       = 4,
+        .num_consumers       = 4,
+        .entries_per_producer = 10000,
+        .ring_entries        = 256,
+        .producer_delay_us   = 50,
+        .consumer_delay_us   = 0,
+        .expect_drops        = 0,
+        .sharded             = 1,
+    },
 };
 
 #define NUM_TEST_CASES ((int)(sizeof(test_cases) / sizeof(test_cases[0])))
@@ -236,14 +293,20 @@ static void *consumer_thread(void *arg)
 
 static int run_test_case(const struct test_case *tc)
 {
-    printf("  %-24s prod=%d cons=%d entries=%d ring=%d "
+    printf("  %-24s prod=%d cons=%d entries=%d ring=%d%s "
            "p_delay=%dus c_delay=%dus\n",
            tc->name, tc->num_producers, tc->num_consumers,
            tc->entries_per_producer, tc->ring_entries,
+           tc->var_ring ? "u" : tc->sharded ? "/shard" : "",
            tc->producer_delay_us, tc->consumer_delay_us);
 
     /* Allocate ring dynamically for this test's ring size */
-    size_t ring_sz = btelem_ring_size((uint32_t)tc->ring_entries);
+    uint32_t nshards = (uint32_t)tc->num_producers;
+    size_t ring_sz = tc->var_ring
+                   ? btelem_ring_size_var((uint32_t)tc->ring_entries)
+                   : tc->sharded
+                   ? btelem_ring_size_sharded(nshards, (uint32_t)tc->ring_entries)
+                   : btelem_ring_size((uint32_t)tc->ring_entries);
     void *ring_mem = calloc(1, ring_sz);
     if (!ring_mem) {
         fprintf(stderr, "    FAILED: malloc ring\n");
@@ -251,7 +314,13 @@ static int run_test_case(const struct test_case *tc)
     }
 
     memset(&ctx, 0, sizeof(ctx));
-    if (btelem_init(&ctx, ring_mem, (uint32_t)tc->ring_entries) != 0) {
+    int init_rc = tc->var_ring
+                ? btelem_init_var(&ctx, ring_mem, (uint32_t)tc->ring_entries)
+                : tc->sharded
+                ? btelem_init_sharded(&ctx, ring_mem, nshards,
+                                      (uint32_t)tc->ring_entries)
+                : btelem_init(&ctx, ring_mem, (uint32_t)tc->ring_entries);
+    if (init_rc != 0) {
         fprintf(stderr, "    FAILED: btelem_init\n");
         free(ring_mem);
         return 1;
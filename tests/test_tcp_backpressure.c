@@ -6,6 +6,15 @@
  *   - The server drain thread doesn't wedge permanently.
  *   - btelem_server_stop() completes cleanly even with blocked clients.
  *   - Data received before the stall is not corrupt.
+ *   - The fan-out server serves more viewers than BTELEM_MAX_CLIENTS.
+ *   - The batching policy batches trickles and grows under bursts.
+ *   - Viewer subscriptions filter and decimate in both server modes.
+ *   - The schema handshake sends the compact schema, or only its hash
+ *     to a viewer that has it cached, and falls back for silent viewers.
+ *   - Viewers that ask for compression get packets that expand exactly.
+ *   - The event-loop server serves many viewers from one thread, wakes
+ *     promptly on a single entry, and holds entries below its wake
+ *     threshold for no longer than its latency bound.
  *
  * The test has a hard alarm() timeout — if anything deadlocks the
  * process is killed and the test fails.
@@ -20,8 +29,12 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <time.h>
 
 #include "btelem/btelem_serve.h"
+#ifdef __linux__
+#include "btelem/btelem_serve_evloop.h"
+#endif
 
 /* --------------------------------------------------------------------------
  * Config
@@ -53,6 +66,10 @@ static const struct btelem_field_def bp_fields[] = {
 BTELEM_SCHEMA_ENTRY(BP, 0, "backpressure", "Backpressure test",
                      struct bp_payload, bp_fields);
 
+/* Second entry type, used to check per-viewer filtering in fan-out mode */
+BTELEM_SCHEMA_ENTRY(BP_ALT, 1, "backpressure_alt", "Filtered entry",
+                     struct bp_payload, bp_fields);
+
 /* --------------------------------------------------------------------------
  * Shared state
  * ----------------------------------------------------------------------- */
@@ -144,6 +161,25 @@ static int consume_schema(int fd)
     return 0;
 }
 
+/* Opt in to the compact schema, so the server answers without waiting */
+static int send_hello(int fd, uint64_t hash)
+{
+    uint8_t msg[4 + sizeof(struct btelem_ctrl_header) + sizeof(hash)];
+    uint32_t len = sizeof(msg) - 4;
+    struct btelem_ctrl_header h = { .type = BTELEM_CTRL_HELLO, .count = 0 };
+    memcpy(msg, &len, 4);
+    memcpy(msg + 4, &h, sizeof(h));
+    memcpy(msg + 4 + sizeof(h), &hash, sizeof(hash));
+    return write(fd, msg, sizeof(msg)) == (ssize_t)sizeof(msg) ? 0 : -1;
+}
+
+static double mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
 /* --------------------------------------------------------------------------
  * Test 1: Stalled consumer — stops reading entirely
  *
@@ -221,7 +257,8 @@ static int test_stalled_consumer(void)
 struct slow_consumer_ctx {
     int      fd;
     uint64_t entries_ok;
-    uint64_t bad_magic;
+    uint64_t bad_magic;     /* payloads that are not a producer's entry */
+    uint64_t reordered;     /* a producer's counter not increasing */
     int      delay_ms;
     volatile int *stop;
 };
@@ -230,6 +267,7 @@ static void *slow_consumer_thread(void *arg)
 {
     struct slow_consumer_ctx *sc = (struct slow_consumer_ctx *)arg;
     uint8_t buf[65536];
+    uint64_t next[NUM_PRODUCERS] = {0};
 
     while (!*sc->stop) {
         /* Read length prefix */
@@ -244,11 +282,30 @@ static void *slow_consumer_thread(void *arg)
         if (recv_all(sc->fd, buf, plen) < 0)
             break;
 
-        /* Minimal validation: check packet header */
+        /* Every payload must be intact: a slot overwritten while the
+         * server waited on the socket would show up here */
         if (plen >= sizeof(struct btelem_packet_header)) {
             const struct btelem_packet_header *pkt =
                 (const struct btelem_packet_header *)buf;
-            sc->entries_ok += pkt->entry_count;
+            const struct btelem_entry_header *table =
+                (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+            const uint8_t *payload = (const uint8_t *)(table + pkt->entry_count);
+            for (uint16_t i = 0; i < pkt->entry_count; i++) {
+                struct bp_payload p;
+                if (table[i].payload_size != sizeof(p)) {
+                    sc->bad_magic++;
+                    continue;
+                }
+                memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+                if (p.magic != MAGIC || p.thread_id >= NUM_PRODUCERS) {
+                    sc->bad_magic++;
+                    continue;
+                }
+                if (p.counter < next[p.thread_id])
+                    sc->reordered++;
+                next[p.thread_id] = p.counter + 1;
+                sc->entries_ok++;
+            }
         }
 
         /* Simulate slow processing */
@@ -323,10 +380,11 @@ static int test_slow_consumer(void)
 
     pthread_join(cons_th, NULL);
 
-    printf("  consumer received %lu entries, bad_magic=%lu\n",
-           (unsigned long)sc.entries_ok, (unsigned long)sc.bad_magic);
+    printf("  consumer received %lu entries, bad_magic=%lu, reordered=%lu\n",
+           (unsigned long)sc.entries_ok, (unsigned long)sc.bad_magic,
+           (unsigned long)sc.reordered);
 
-    if (sc.bad_magic > 0) {
+    if (sc.bad_magic > 0 || sc.reordered > 0) {
         fprintf(stderr, "  FAILED: corruption\n");
         close(fd);
         free(ring_mem);
@@ -408,6 +466,974 @@ static int test_consumer_disconnect(void)
     return 0;
 }
 
+/* --------------------------------------------------------------------------
+ * Test 4: Fan-out server with more viewers than btelem clients
+ *
+ * BTELEM_MAX_CLIENTS + 4 viewers on one shared drain: one stalls, one
+ * filters to BP_ALT, the rest read at full speed.  Every live viewer
+ * must receive valid data and the filtered one only BP_ALT entries.
+ * ----------------------------------------------------------------------- */
+
+#define FANOUT_VIEWERS  (BTELEM_MAX_CLIENTS + 4)
+#define FANOUT_ENTRIES  50000
+
+struct viewer_ctx {
+    int      fd;
+    uint64_t entries;
+    uint64_t bad_magic;
+    uint64_t bad_id;
+    uint64_t dropped;
+    uint16_t only_id;    /* 0xFFFF = any */
+    volatile int *stop;
+};
+
+static void *viewer_thread(void *arg)
+{
+    struct viewer_ctx *vc = (struct viewer_ctx *)arg;
+    uint8_t buf[65536];
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(vc->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*vc->stop) {
+        uint32_t plen;
+        if (recv_all(vc->fd, &plen, 4) < 0)
+            break;
+        if (plen > sizeof(buf) || recv_all(vc->fd, buf, plen) < 0)
+            break;
+
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)buf;
+        vc->dropped += pkt->dropped;
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+
+        const struct btelem_entry_header *table =
+            (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+        const uint8_t *payload = (const uint8_t *)&table[pkt->entry_count];
+        for (uint16_t i = 0; i < pkt->entry_count; i++) {
+            struct bp_payload p;
+            memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+            if (p.magic != MAGIC)
+                vc->bad_magic++;
+            if (vc->only_id != 0xFFFF && table[i].id != vc->only_id)
+                vc->bad_id++;
+            vc->entries++;
+        }
+    }
+    return NULL;
+}
+
+static void *alt_producer_thread(void *arg)
+{
+    struct producer_arg *pa = (struct producer_arg *)arg;
+    for (uint64_t i = 0; i < (uint64_t)pa->entries; i++) {
+        struct bp_payload p = {
+            .magic     = MAGIC,
+            .thread_id = pa->thread_id,
+            .counter   = i,
+        };
+        BTELEM_LOG(&ctx, BP_ALT, p);
+    }
+    return NULL;
+}
+
+static int test_fanout_viewers(void)
+{
+    printf("test_fanout_viewers...\n");
+
+    size_t ring_sz = btelem_ring_size(RING_ENTRIES);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, RING_ENTRIES);
+    btelem_register(&ctx, &btelem_schema_BP);
+    btelem_register(&ctx, &btelem_schema_BP_ALT);
+
+    int port = find_free_port();
+    static struct btelem_server srv;
+    memset(&srv, 0, sizeof(srv));
+    if (btelem_serve_fanout(&srv, &ctx, "127.0.0.1", (uint16_t)port) < 0) {
+        fprintf(stderr, "  FAILED: btelem_serve_fanout\n");
+        free(ring_mem);
+        return 1;
+    }
+
+    /* Viewers connect one at a time so viewer i lands in slot i */
+    volatile int stop = 0;
+    struct viewer_ctx vc[FANOUT_VIEWERS];
+    pthread_t view_th[FANOUT_VIEWERS];
+    memset(vc, 0, sizeof(vc));
+    for (int i = 0; i < FANOUT_VIEWERS; i++) {
+        vc[i].fd = connect_to(port);
+        if (vc[i].fd < 0 || send_hello(vc[i].fd, 0) < 0
+            || consume_schema(vc[i].fd) < 0) {
+            fprintf(stderr, "  FAILED: viewer %d connect\n", i);
+            btelem_server_stop(&srv);
+            free(ring_mem);
+            return 1;
+        }
+        vc[i].only_id = 0xFFFF;
+        vc[i].stop = &stop;
+    }
+    uint16_t alt_only[] = { 1 };
+    btelem_server_set_filter(&srv, 1, alt_only, 1);
+    vc[1].only_id = 1;
+
+    /* Viewer 0 stalls; the rest read */
+    for (int i = 1; i < FANOUT_VIEWERS; i++)
+        pthread_create(&view_th[i], NULL, viewer_thread, &vc[i]);
+    usleep(100000);
+    printf("  %d viewers connected (BTELEM_MAX_CLIENTS=%d)\n",
+           FANOUT_VIEWERS, BTELEM_MAX_CLIENTS);
+
+    pthread_t prod_th[NUM_PRODUCERS + 1];
+    struct producer_arg pargs[NUM_PRODUCERS + 1];
+    for (int i = 0; i <= NUM_PRODUCERS; i++) {
+        pargs[i].thread_id = (uint32_t)i;
+        pargs[i].entries = FANOUT_ENTRIES;
+        pthread_create(&prod_th[i], NULL,
+                       i == NUM_PRODUCERS ? alt_producer_thread : producer_thread,
+                       &pargs[i]);
+    }
+    for (int i = 0; i <= NUM_PRODUCERS; i++)
+        pthread_join(prod_th[i], NULL);
+
+    usleep(300000);
+    stop = 1;
+    printf("  stopping server...\n");
+    btelem_server_stop(&srv);
+    printf("  server stopped OK\n");
+
+    int failed = 0;
+    for (int i = 1; i < FANOUT_VIEWERS; i++) {
+        pthread_join(view_th[i], NULL);
+        if (vc[i].entries == 0 || vc[i].bad_magic || vc[i].bad_id) {
+            fprintf(stderr, "  FAILED: viewer %d entries=%lu bad_magic=%lu "
+                    "bad_id=%lu\n", i, (unsigned long)vc[i].entries,
+                    (unsigned long)vc[i].bad_magic,
+                    (unsigned long)vc[i].bad_id);
+            failed = 1;
+        }
+    }
+    printf("  viewer 1 (filtered): %lu entries, viewer 2: %lu entries "
+           "(dropped %lu)\n", (unsigned long)vc[1].entries,
+           (unsigned long)vc[2].entries, (unsigned long)vc[2].dropped);
+
+    for (int i = 0; i < FANOUT_VIEWERS; i++)
+        close(vc[i].fd);
+    free(ring_mem);
+    if (failed)
+        return 1;
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 5: Batching policy and per-client stats
+ *
+ * A trickle below min_bytes must go out on the latency deadline in
+ * multi-entry packets; a burst past the ring's half-full mark must flush
+ * on pressure, send back-to-back full packets and grow the buffer.
+ * ----------------------------------------------------------------------- */
+
+#define BATCH_RING      4096
+#define BATCH_TRICKLE   60
+#define BATCH_BURST     3000
+
+static int test_batching_stats(void)
+{
+    printf("test_batching_stats...\n");
+
+    size_t ring_sz = btelem_ring_size(BATCH_RING);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, BATCH_RING);
+    btelem_register(&ctx, &btelem_schema_BP);
+
+    int port = find_free_port();
+    struct btelem_server srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.batch.max_latency_us = 20000;
+    srv.batch.min_bytes = 1 << 20;          /* only deadline/pressure flush */
+    srv.batch.max_pkt_bytes = 4 * BTELEM_SERVE_PKT_BUF;
+    if (btelem_serve(&srv, &ctx, "127.0.0.1", (uint16_t)port) < 0) {
+        fprintf(stderr, "  FAILED: btelem_serve\n");
+        free(ring_mem);
+        return 1;
+    }
+
+    volatile int stop = 0;
+    struct viewer_ctx vc;
+    memset(&vc, 0, sizeof(vc));
+    vc.fd = connect_to(port);
+    if (vc.fd < 0 || consume_schema(vc.fd) < 0) {
+        fprintf(stderr, "  FAILED: connect\n");
+        btelem_server_stop(&srv);
+        free(ring_mem);
+        return 1;
+    }
+    vc.only_id = 0xFFFF;
+    vc.stop = &stop;
+    pthread_t view_th;
+    pthread_create(&view_th, NULL, viewer_thread, &vc);
+
+    for (uint64_t i = 0; i < BATCH_TRICKLE; i++) {
+        struct bp_payload p = { .magic = MAGIC, .thread_id = 0, .counter = i };
+        BTELEM_LOG(&ctx, BP, p);
+        usleep(1000);
+    }
+    usleep(100000);
+
+    struct btelem_serve_client_stats trickle;
+    int rc = btelem_server_client_stats(&srv, 0, &trickle);
+
+    for (uint64_t i = 0; i < BATCH_BURST; i++) {
+        struct bp_payload p = { .magic = MAGIC, .thread_id = 1, .counter = i };
+        BTELEM_LOG(&ctx, BP, p);
+    }
+    for (int i = 0; i < 100 && vc.entries < BATCH_TRICKLE + BATCH_BURST; i++)
+        usleep(10000);
+
+    struct btelem_serve_client_stats burst;
+    rc |= btelem_server_client_stats(&srv, 0, &burst);
+
+    stop = 1;
+    pthread_join(view_th, NULL);
+    btelem_server_stop(&srv);
+    close(vc.fd);
+    free(ring_mem);
+
+    printf("  trickle: %lu pkts, %.1f entries/pkt, deadline=%lu\n",
+           (unsigned long)trickle.packets, trickle.mean_entries_per_packet,
+           (unsigned long)trickle.flush[BTELEM_SERVE_FLUSH_DEADLINE]);
+    printf("  burst:   %lu pkts, pressure=%lu full=%lu, pkt_buf=%u\n",
+           (unsigned long)burst.packets,
+           (unsigned long)burst.flush[BTELEM_SERVE_FLUSH_PRESSURE],
+           (unsigned long)burst.flush[BTELEM_SERVE_FLUSH_FULL],
+           burst.pkt_buf_size);
+
+    int failed = 0;
+    if (rc != 0) {
+        fprintf(stderr, "  FAILED: btelem_server_client_stats\n");
+        failed = 1;
+    }
+    if (trickle.packets == 0 || trickle.mean_entries_per_packet < 2.0
+        || trickle.flush[BTELEM_SERVE_FLUSH_DEADLINE] == 0
+        || trickle.flush[BTELEM_SERVE_FLUSH_SIZE] != 0) {
+        fprintf(stderr, "  FAILED: trickle not batched on the deadline\n");
+        failed = 1;
+    }
+    if (burst.flush[BTELEM_SERVE_FLUSH_PRESSURE] == 0
+        || burst.flush[BTELEM_SERVE_FLUSH_FULL] == 0
+        || burst.pkt_buf_size <= BTELEM_SERVE_PKT_BUF) {
+        fprintf(stderr, "  FAILED: burst did not flush on pressure and grow\n");
+        failed = 1;
+    }
+    if (vc.entries != BATCH_TRICKLE + BATCH_BURST || vc.bad_magic
+        || burst.entries != vc.entries) {
+        fprintf(stderr, "  FAILED: received %lu entries (stats %lu), bad_magic=%lu\n",
+                (unsigned long)vc.entries, (unsigned long)burst.entries,
+                (unsigned long)vc.bad_magic);
+        failed = 1;
+    }
+    if (failed)
+        return 1;
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 6: Viewer subscriptions
+ *
+ * A viewer subscribes to BP_ALT at full rate and BP at SUB_INTERVAL_US,
+ * then unsubscribes BP_ALT, then resets to everything.  Run against the
+ * per-client, fan-out and event-loop servers.
+ * ----------------------------------------------------------------------- */
+
+/* Server under test for the control-message tests */
+enum { MODE_PER_CLIENT, MODE_FANOUT, MODE_EVLOOP, MODE_COUNT };
+static const char *const mode_names[MODE_COUNT] = { "per-client", "fanout", "evloop" };
+static struct btelem_server mode_srv;
+static struct btelem_evloop_server mode_ev;
+
+static int mode_start(int mode, int port)
+{
+    memset(&mode_srv, 0, sizeof(mode_srv));
+    if (mode == MODE_EVLOOP)
+        return btelem_serve_evloop(&mode_ev, &ctx, "127.0.0.1", (uint16_t)port, NULL);
+    if (mode == MODE_FANOUT)
+        return btelem_serve_fanout(&mode_srv, &ctx, "127.0.0.1", (uint16_t)port);
+    return btelem_serve(&mode_srv, &ctx, "127.0.0.1", (uint16_t)port);
+}
+
+static void mode_stop(int mode)
+{
+    if (mode == MODE_EVLOOP)
+        btelem_evloop_server_stop(&mode_ev);
+    else
+        btelem_server_stop(&mode_srv);
+}
+
+#define SUB_RING            4096
+#define SUB_INTERVAL_US     10000
+#define SUB_PRODUCE_MS      200
+
+static int send_ctrl(int fd, uint16_t type, const struct btelem_ctrl_sub *subs,
+                     uint16_t count)
+{
+    struct btelem_ctrl_header h = { .type = type, .count = count };
+    uint32_t len = (uint32_t)(sizeof(h) + count * sizeof(*subs));
+    if (write(fd, &len, 4) != 4 || write(fd, &h, sizeof(h)) != (ssize_t)sizeof(h))
+        return -1;
+    if (count && write(fd, subs, count * sizeof(*subs))
+                 != (ssize_t)(count * sizeof(*subs)))
+        return -1;
+    usleep(250000);  /* idle fan-out viewers poll every 100 ms */
+    return 0;
+}
+
+struct sub_tally {
+    uint64_t bp, alt, dropped;
+    uint64_t min_bp_gap_ns;
+    uint64_t alt_gaps;      /* BP_ALT counters not consecutive */
+};
+
+/* Log BP and BP_ALT for SUB_PRODUCE_MS, then read until the stream idles */
+static int sub_round(int fd, uint64_t *logged, struct sub_tally *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->min_bp_gap_ns = UINT64_MAX;
+    *logged = 0;
+
+    double end = mono_us() + SUB_PRODUCE_MS * 1000.0;
+    while (mono_us() < end) {
+        struct bp_payload p = { .magic = MAGIC, .counter = *logged };
+        BTELEM_LOG(&ctx, BP, p);
+        BTELEM_LOG(&ctx, BP_ALT, p);
+        (*logged)++;
+        usleep(200);
+    }
+
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 300000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    uint8_t buf[65536];
+    uint64_t last_bp = 0, next_alt = UINT64_MAX;
+    for (;;) {
+        uint32_t plen;
+        if (recv_all(fd, &plen, 4) < 0)
+            break;  /* idle */
+        if (plen > sizeof(buf) || recv_all(fd, buf, plen) < 0)
+            return -1;
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)buf;
+        t->dropped += pkt->dropped;
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+        const struct btelem_entry_header *table =
+            (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+        const uint8_t *payload = (const uint8_t *)&table[pkt->entry_count];
+        if (sizeof(*pkt) + pkt->entry_count * sizeof(*table) + pkt->payload_size != plen)
+            return -1;
+        for (uint16_t i = 0; i < pkt->entry_count; i++) {
+            struct bp_payload p;
+            memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+            if (p.magic != MAGIC)
+                return -1;
+            if (table[i].id == BTELEM_ID_BP) {
+                if (t->bp && table[i].timestamp - last_bp < t->min_bp_gap_ns)
+                    t->min_bp_gap_ns = table[i].timestamp - last_bp;
+                last_bp = table[i].timestamp;
+                t->bp++;
+            } else {
+                if (next_alt != UINT64_MAX && p.counter != next_alt)
+                    t->alt_gaps++;
+                next_alt = p.counter + 1;
+                t->alt++;
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_subscriptions_mode(int m)
+{
+    size_t ring_sz = btelem_ring_size(SUB_RING);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, SUB_RING);
+    btelem_register(&ctx, &btelem_schema_BP);
+    btelem_register(&ctx, &btelem_schema_BP_ALT);
+
+    int port = find_free_port();
+    if (mode_start(m, port) < 0) {
+        fprintf(stderr, "  FAILED: server start\n");
+        free(ring_mem);
+        return 1;
+    }
+    int fd = connect_to(port);
+    if (fd < 0 || consume_schema(fd) < 0) {
+        fprintf(stderr, "  FAILED: connect\n");
+        mode_stop(m);
+        free(ring_mem);
+        return 1;
+    }
+
+    const char *mode = mode_names[m];
+    int failed = 0;
+    uint64_t logged;
+    struct sub_tally t;
+    const uint64_t want_gap = (uint64_t)SUB_INTERVAL_US * 1000u;
+    const uint64_t max_bp = SUB_PRODUCE_MS * 1000u / SUB_INTERVAL_US + 2;
+
+    /* BP_ALT at full rate, BP decimated */
+    struct btelem_ctrl_sub subs[2] = {
+        { .id = BTELEM_ID_BP_ALT, .min_interval_us = 0 },
+        { .id = BTELEM_ID_BP,     .min_interval_us = SUB_INTERVAL_US },
+    };
+    if (send_ctrl(fd, BTELEM_CTRL_SUBSCRIBE, subs, 2) < 0
+        || sub_round(fd, &logged, &t) < 0) {
+        fprintf(stderr, "  FAILED: %s subscribe round\n", mode);
+        failed = 1;
+    } else {
+        printf("  %s subscribed: logged %lu each, got alt=%lu bp=%lu "
+               "(min gap %.1f ms, dropped %lu)\n", mode,
+               (unsigned long)logged, (unsigned long)t.alt, (unsigned long)t.bp,
+               (double)t.min_bp_gap_ns / 1e6, (unsigned long)t.dropped);
+        if (t.bp == 0 || t.bp > max_bp || (t.bp > 1 && t.min_bp_gap_ns < want_gap)
+            || t.alt == 0 || (t.dropped == 0 && (t.alt != logged || t.alt_gaps))) {
+            fprintf(stderr, "  FAILED: %s subscription not applied\n", mode);
+            failed = 1;
+        }
+    }
+
+    /* Drop BP_ALT entirely */
+    if (!failed && (send_ctrl(fd, BTELEM_CTRL_UNSUBSCRIBE, subs, 1) < 0
+                    || sub_round(fd, &logged, &t) < 0
+                    || t.alt != 0 || t.bp == 0 || t.bp > max_bp)) {
+        fprintf(stderr, "  FAILED: %s unsubscribe: alt=%lu bp=%lu\n", mode,
+                (unsigned long)t.alt, (unsigned long)t.bp);
+        failed = 1;
+    }
+
+    /* Back to the full stream */
+    if (!failed && (send_ctrl(fd, BTELEM_CTRL_RESET, NULL, 0) < 0
+                    || sub_round(fd, &logged, &t) < 0
+                    || t.alt == 0 || t.bp <= max_bp)) {
+        fprintf(stderr, "  FAILED: %s reset: alt=%lu bp=%lu of %lu\n", mode,
+                (unsigned long)t.alt, (unsigned long)t.bp, (unsigned long)logged);
+        failed = 1;
+    }
+
+    struct btelem_serve_client_stats st;
+    if (!failed && m != MODE_EVLOOP && btelem_server_client_stats(&mode_srv, 0, &st) == 0)
+        printf("  %s: %lu packets, %lu entries, %lu bytes sent\n", mode,
+               (unsigned long)st.packets, (unsigned long)st.entries,
+               (unsigned long)st.bytes);
+
+    close(fd);
+    mode_stop(m);
+    free(ring_mem);
+    return failed;
+}
+
+static int test_subscriptions(void)
+{
+    printf("test_subscriptions...\n");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        if (test_subscriptions_mode(m))
+            return 1;
+    }
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 7: Schema handshake
+ *
+ * HELLO without a cached hash gets the compact schema, HELLO with the
+ * current hash gets only the hash (and the stream still works), and a
+ * viewer that says nothing gets the fixed-size schema without waiting.
+ * ----------------------------------------------------------------------- */
+
+/* First message after connecting; returns its length, -1 on error */
+static int recv_first(int fd, uint8_t *buf, size_t cap, double *ms)
+{
+    double t0 = mono_us();
+    uint32_t len;
+    if (recv_all(fd, &len, 4) < 0 || len > cap || recv_all(fd, buf, len) < 0)
+        return -1;
+    *ms = (mono_us() - t0) / 1e3;
+    return (int)len;
+}
+
+/* Connect and open with HELLO; returns the reply length with the socket in
+ * *fdp.  The server only looks once, so a HELLO that lost the race with
+ * the connection thread gets the fixed schema: retry those. */
+static int hello_first(int port, uint64_t have, uint8_t *buf, size_t cap,
+                       double *ms, int *fdp)
+{
+    for (int attempt = 0; attempt < 10; attempt++) {
+        int fd = connect_to(port);
+        int n = (fd < 0 || send_hello(fd, have) < 0) ? -1
+              : recv_first(fd, buf, cap, ms);
+        struct btelem_schema_hello hello;
+        memcpy(&hello, buf, sizeof(hello));
+        if (n < (int)sizeof(hello) || hello.magic == BTELEM_SCHEMA_HELLO_MAGIC) {
+            *fdp = fd;
+            return n;
+        }
+        close(fd);
+    }
+    *fdp = -1;
+    return -1;
+}
+
+static int test_handshake_mode(int m)
+{
+    size_t ring_sz = btelem_ring_size(RING_ENTRIES);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, RING_ENTRIES);
+    btelem_register(&ctx, &btelem_schema_BP);
+    btelem_register(&ctx, &btelem_schema_BP_ALT);
+
+    int port = find_free_port();
+    if (mode_start(m, port) < 0) {
+        fprintf(stderr, "  FAILED: server start\n");
+        free(ring_mem);
+        return 1;
+    }
+
+    const char *mode = mode_names[m];
+    const uint64_t hash = btelem_schema_hash(&ctx);
+    const int compact = btelem_schema_serialize_compact(&ctx, NULL, 0);
+    const int fixed = btelem_schema_serialize(&ctx, NULL, 0);
+    static uint8_t buf[65536];
+    struct btelem_schema_hello hello;
+    struct btelem_schema_compact_header ch;
+    double ms;
+    int failed = 0;
+
+    /* No cache: hello + compact schema, without waiting */
+    int fd;
+    int n = hello_first(port, 0, buf, sizeof(buf), &ms, &fd);
+    memcpy(&hello, buf, sizeof(hello));
+    memcpy(&ch, buf + sizeof(hello), sizeof(ch));
+    if (n != (int)sizeof(hello) + compact
+        || hello.magic != BTELEM_SCHEMA_HELLO_MAGIC
+        || hello.schema_size != (uint32_t)compact || hello.hash != hash
+        || ch.magic != BTELEM_SCHEMA_COMPACT_MAGIC || ch.hash != hash) {
+        fprintf(stderr, "  FAILED: %s compact reply (len %d)\n", mode, n);
+        failed = 1;
+    } else {
+        printf("  %s: compact schema %d bytes (fixed %d) in %.1f ms\n",
+               mode, compact, fixed, ms);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    /* Cached: hash only, then the stream carries on */
+    fd = -1;
+    n = failed ? -1 : hello_first(port, hash, buf, sizeof(buf), &ms, &fd);
+    memcpy(&hello, buf, sizeof(hello));
+    if (!failed && (n != (int)sizeof(hello) || hello.schema_size != 0
+                    || hello.hash != hash)) {
+        fprintf(stderr, "  FAILED: %s cached reply (len %d)\n", mode, n);
+        failed = 1;
+    }
+    if (!failed) {
+        usleep(100000);  /* fan-out viewers join the queue after the reply */
+        struct bp_payload p = { .magic = MAGIC, .counter = 42 };
+        BTELEM_LOG(&ctx, BP, p);
+        struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)buf;
+        do {
+            n = recv_first(fd, buf, sizeof(buf), &ms);
+        } while (n > 0 && (pkt->flags & BTELEM_PACKET_FLAG_CLOCK));
+        if (n <= 0 || pkt->entry_count != 1) {
+            fprintf(stderr, "  FAILED: %s no data after cached schema\n", mode);
+            failed = 1;
+        } else {
+            printf("  %s: cached schema, reply %d bytes\n", mode,
+                   (int)(4 + sizeof(hello)));
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+
+    /* Silent viewer: fixed-size schema, without waiting for a HELLO */
+    fd = failed ? -1 : connect_to(port);
+    n = fd < 0 ? -1 : recv_first(fd, buf, sizeof(buf), &ms);
+    if (!failed && (n != fixed || buf[0] > 1 || ms >= 100)) {
+        fprintf(stderr, "  FAILED: %s fallback (len %d, %.1f ms)\n", mode, n, ms);
+        failed = 1;
+    } else if (!failed) {
+        printf("  %s: fixed schema %d bytes in %.1f ms\n", mode, fixed, ms);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    mode_stop(m);
+    free(ring_mem);
+    return failed;
+}
+
+static int test_handshake(void)
+{
+    printf("test_handshake...\n");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        if (test_handshake_mode(m))
+            return 1;
+    }
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 8: Compressed packets
+ *
+ * A viewer that sends COMPRESS gets BTELEM_PACKET_FLAG_COMPRESSED packets
+ * that expand back to every entry logged, in every server mode.
+ * ----------------------------------------------------------------------- */
+
+#define Z_ENTRIES 2000
+
+static int test_compression_mode(int m)
+{
+    size_t ring_sz = btelem_ring_size(SUB_RING);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, SUB_RING);
+    btelem_register(&ctx, &btelem_schema_BP);
+
+    int port = find_free_port();
+    if (mode_start(m, port) < 0) {
+        fprintf(stderr, "  FAILED: server start\n");
+        free(ring_mem);
+        return 1;
+    }
+    const char *mode = mode_names[m];
+    int fd = connect_to(port);
+    if (fd < 0 || send_hello(fd, 0) < 0 || consume_schema(fd) < 0
+        || send_ctrl(fd, BTELEM_CTRL_COMPRESS, NULL, 0) < 0) {
+        fprintf(stderr, "  FAILED: %s connect\n", mode);
+        mode_stop(m);
+        free(ring_mem);
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < Z_ENTRIES; i++) {
+        struct bp_payload p = { .magic = MAGIC, .counter = i };
+        BTELEM_LOG(&ctx, BP, p);
+        if (i % 100 == 99)
+            usleep(1000);
+    }
+
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 300000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    static uint8_t buf[65536], raw[65536];
+    uint64_t next = 0, packets = 0, compressed = 0, wire = 0, plain = 0;
+    int failed = 0;
+    for (;;) {
+        uint32_t plen;
+        if (recv_all(fd, &plen, 4) < 0)
+            break;  /* idle */
+        if (plen > sizeof(buf) || recv_all(fd, buf, plen) < 0) {
+            failed = 1;
+            break;
+        }
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)raw;
+        int n = (int)plen;
+        if (((const struct btelem_packet_header *)buf)->flags & BTELEM_PACKET_FLAG_COMPRESSED) {
+            n = btelem_packet_decompress(buf, plen, raw, sizeof(raw));
+            compressed++;
+        } else {
+            memcpy(raw, buf, plen);
+        }
+        if (n < 0) {
+            failed = 1;
+            break;
+        }
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+        packets++;
+        wire += 4 + plen;
+        plain += 4 + (uint64_t)n;
+
+        const struct btelem_entry_header *table =
+            (const struct btelem_entry_header *)(raw + sizeof(*pkt));
+        const uint8_t *payload = (const uint8_t *)&table[pkt->entry_count];
+        for (uint16_t i = 0; i < pkt->entry_count; i++) {
+            struct bp_payload p;
+            memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+            if (p.magic != MAGIC || p.counter != next++)
+                failed = 1;
+        }
+    }
+
+    printf("  %s: %lu entries, %lu/%lu packets compressed, %lu -> %lu bytes\n",
+           mode, (unsigned long)next, (unsigned long)compressed,
+           (unsigned long)packets, (unsigned long)plain, (unsigned long)wire);
+    if (failed || next != Z_ENTRIES || compressed == 0 || wire * 2 > plain) {
+        fprintf(stderr, "  FAILED: %s compressed stream\n", mode);
+        failed = 1;
+    }
+
+    close(fd);
+    mode_stop(m);
+    free(ring_mem);
+    return failed;
+}
+
+static int test_compression(void)
+{
+    printf("test_compression...\n");
+    for (int m = 0; m < MODE_COUNT; m++) {
+        if (test_compression_mode(m))
+            return 1;
+    }
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 9: Event-loop server — wake latency and many viewers
+ *
+ * First times single entries logged into an idle ring until a viewer
+ * reads them (the loop must be woken, not polling).  Then runs
+ * EVLOOP_VIEWERS readers plus one stalled viewer against full-rate
+ * producers.
+ * ----------------------------------------------------------------------- */
+
+#ifdef __linux__
+
+#define EVLOOP_VIEWERS  64
+#define EVLOOP_PROBES   20
+
+/* Read packets until one carrying BP counter `want` arrives */
+static int recv_counter(int fd, uint64_t want)
+{
+    uint8_t buf[65536];
+    for (;;) {
+        uint32_t plen;
+        if (recv_all(fd, &plen, 4) < 0 || plen > sizeof(buf)
+            || recv_all(fd, buf, plen) < 0)
+            return -1;
+        const struct btelem_packet_header *pkt =
+            (const struct btelem_packet_header *)buf;
+        if (pkt->flags & BTELEM_PACKET_FLAG_CLOCK)
+            continue;
+        const struct btelem_entry_header *table =
+            (const struct btelem_entry_header *)(buf + sizeof(*pkt));
+        const uint8_t *payload = (const uint8_t *)&table[pkt->entry_count];
+        for (uint16_t i = 0; i < pkt->entry_count; i++) {
+            struct bp_payload p;
+            memcpy(&p, payload + table[i].payload_offset, sizeof(p));
+            if (p.counter == want)
+                return 0;
+        }
+    }
+}
+
+static int test_evloop_viewers(void)
+{
+    printf("test_evloop_viewers...\n");
+
+    size_t ring_sz = btelem_ring_size(RING_ENTRIES);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, RING_ENTRIES);
+    btelem_register(&ctx, &btelem_schema_BP);
+
+    int port = find_free_port();
+    static struct btelem_evloop_server srv;
+    if (btelem_serve_evloop(&srv, &ctx, "127.0.0.1", (uint16_t)port, NULL) < 0) {
+        fprintf(stderr, "  FAILED: btelem_serve_evloop\n");
+        free(ring_mem);
+        return 1;
+    }
+
+    int probe = connect_to(port);
+    if (probe < 0 || consume_schema(probe) < 0) {
+        fprintf(stderr, "  FAILED: probe connect\n");
+        btelem_evloop_server_stop(&srv);
+        free(ring_mem);
+        return 1;
+    }
+    struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(probe, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    /* Idle gaps longer than the loop's 100 ms backstop poll would show up
+     * as ~100 ms latencies if the producer-side wake did not work */
+    double best = 1e9, worst = 0;
+    for (int i = 0; i < EVLOOP_PROBES; i++) {
+        usleep(5000);
+        struct bp_payload p = { .magic = MAGIC, .thread_id = 99, .counter = (uint64_t)i };
+        double t0 = mono_us();
+        BTELEM_LOG(&ctx, BP, p);
+        if (recv_counter(probe, (uint64_t)i) < 0) {
+            fprintf(stderr, "  FAILED: probe %d not received\n", i);
+            btelem_evloop_server_stop(&srv);
+            free(ring_mem);
+            return 1;
+        }
+        double dt = mono_us() - t0;
+        if (dt < best) best = dt;
+        if (dt > worst) worst = dt;
+    }
+    printf("  idle wake latency: best %.0f us, worst %.0f us\n", best, worst);
+    if (best > 50000) {
+        fprintf(stderr, "  FAILED: wake-up never faster than the idle poll\n");
+        btelem_evloop_server_stop(&srv);
+        free(ring_mem);
+        return 1;
+    }
+
+    /* Many viewers; the probe socket now stalls */
+    volatile int stop = 0;
+    static struct viewer_ctx vc[EVLOOP_VIEWERS];
+    pthread_t view_th[EVLOOP_VIEWERS];
+    memset(vc, 0, sizeof(vc));
+    for (int i = 0; i < EVLOOP_VIEWERS; i++) {
+        vc[i].fd = connect_to(port);
+        if (vc[i].fd < 0 || consume_schema(vc[i].fd) < 0) {
+            fprintf(stderr, "  FAILED: viewer %d connect\n", i);
+            btelem_evloop_server_stop(&srv);
+            free(ring_mem);
+            return 1;
+        }
+        vc[i].only_id = 0xFFFF;
+        vc[i].stop = &stop;
+        pthread_create(&view_th[i], NULL, viewer_thread, &vc[i]);
+    }
+    printf("  %d viewers connected\n", EVLOOP_VIEWERS + 1);
+
+    pthread_t prod_th[NUM_PRODUCERS];
+    struct producer_arg pargs[NUM_PRODUCERS];
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        pargs[i].thread_id = (uint32_t)i;
+        pargs[i].entries = FANOUT_ENTRIES;
+        pthread_create(&prod_th[i], NULL, producer_thread, &pargs[i]);
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++)
+        pthread_join(prod_th[i], NULL);
+
+    usleep(300000);
+    stop = 1;
+    printf("  stopping server...\n");
+    btelem_evloop_server_stop(&srv);
+    printf("  server stopped OK\n");
+
+    int failed = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < EVLOOP_VIEWERS; i++) {
+        pthread_join(view_th[i], NULL);
+        total += vc[i].entries;
+        if (vc[i].entries == 0 || vc[i].bad_magic) {
+            fprintf(stderr, "  FAILED: viewer %d entries=%lu bad_magic=%lu\n",
+                    i, (unsigned long)vc[i].entries,
+                    (unsigned long)vc[i].bad_magic);
+            failed = 1;
+        }
+        close(vc[i].fd);
+    }
+    printf("  %lu entries across %d viewers\n", (unsigned long)total,
+           EVLOOP_VIEWERS);
+
+    close(probe);
+    free(ring_mem);
+    if (failed)
+        return 1;
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 10: Event-loop wake threshold and latency bound
+ *
+ * With a high wake_threshold, a lone entry is held back until the timer
+ * flushes it after about max_latency_us, while a full threshold's worth
+ * goes out at once.
+ * ----------------------------------------------------------------------- */
+
+#define EVLOOP_THRESHOLD    64
+#define EVLOOP_LATENCY_US   20000
+
+static int test_evloop_latency_bound(void)
+{
+    printf("test_evloop_latency_bound...\n");
+
+    size_t ring_sz = btelem_ring_size(SUB_RING);
+    void *ring_mem = calloc(1, ring_sz);
+    memset(&ctx, 0, sizeof(ctx));
+    btelem_init(&ctx, ring_mem, SUB_RING);
+    btelem_register(&ctx, &btelem_schema_BP);
+
+    int port = find_free_port();
+    static struct btelem_evloop_server srv;
+    struct btelem_evloop_opts opts = {
+        .wake_threshold = EVLOOP_THRESHOLD,
+        .max_latency_us = EVLOOP_LATENCY_US,
+    };
+    if (btelem_serve_evloop(&srv, &ctx, "127.0.0.1", (uint16_t)port, &opts) < 0) {
+        fprintf(stderr, "  FAILED: btelem_serve_evloop\n");
+        free(ring_mem);
+        return 1;
+    }
+
+    int fd = connect_to(port);
+    if (fd < 0 || consume_schema(fd) < 0) {
+        fprintf(stderr, "  FAILED: connect\n");
+        btelem_evloop_server_stop(&srv);
+        free(ring_mem);
+        return 1;
+    }
+    struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int failed = 0;
+    uint64_t counter = 0;
+
+    /* One entry: held back by the threshold, flushed by the timer */
+    usleep(50000);
+    struct bp_payload p = { .magic = MAGIC, .counter = counter };
+    double t0 = mono_us();
+    BTELEM_LOG(&ctx, BP, p);
+    double lone = recv_counter(fd, counter++) < 0 ? -1 : mono_us() - t0;
+
+    /* A full threshold: drained on the wake, without waiting */
+    usleep(50000);
+    t0 = mono_us();
+    for (int i = 0; i < EVLOOP_THRESHOLD; i++) {
+        p.counter = counter++;
+        BTELEM_LOG(&ctx, BP, p);
+    }
+    double batch = recv_counter(fd, counter - 1) < 0 ? -1 : mono_us() - t0;
+
+    printf("  lone entry %.0f us, %d-entry batch %.0f us (bound %d us)\n",
+           lone, EVLOOP_THRESHOLD, batch, EVLOOP_LATENCY_US);
+    if (lone < EVLOOP_LATENCY_US * 0.8 || lone > EVLOOP_LATENCY_US * 10.0) {
+        fprintf(stderr, "  FAILED: lone entry not held to the latency bound\n");
+        failed = 1;
+    }
+    if (batch < 0 || batch >= EVLOOP_LATENCY_US * 0.8) {
+        fprintf(stderr, "  FAILED: threshold batch waited for the timer\n");
+        failed = 1;
+    }
+
+    close(fd);
+    btelem_evloop_server_stop(&srv);
+    free(ring_mem);
+    if (failed)
+        return 1;
+    printf("  PASSED\n\n");
+    return 0;
+}
+
+#endif /* __linux__ */
+
 /* --------------------------------------------------------------------------
  * Main
  * ----------------------------------------------------------------------- */
@@ -438,10 +1464,21 @@ int main(void)
     failed += test_stalled_consumer();
     failed += test_slow_consumer();
     failed += test_consumer_disconnect();
+    failed += test_fanout_viewers();
+    failed += test_batching_stats();
+    failed += test_subscriptions();
+    failed += test_handshake();
+    failed += test_compression();
+    int total = 8;
+#ifdef __linux__
+    failed += test_evloop_viewers();
+    failed += test_evloop_latency_bound();
+    total += 2;
+#endif
 
     printf("%s (%d/%d passed)\n",
            failed ? "FAILED" : "ALL PASSED",
-           3 - failed, 3);
+           total - failed, total);
 
     return failed ? 1 : 0;
 }
@@ -0,0 +1,552 @@
+/**
+ * btelem UDP JSON test
+ *
+ * Runs btelem_serve_udp() / btelem_serve_udp_json() against a loopback
+ * socket and checks the datagrams.  Verifies that:
+ *   - Every field type is encoded with the expected key and text.
+ *   - Floats match snprintf("%.8g") and non-finite values become null.
+ *   - Coalesced datagrams hold several objects and respect the limit.
+ *   - Tick timestamps are converted to nanoseconds with ctx->clock.
+ *
+ * Also prints the end-to-end JSON throughput for both modes.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/* Log fake_ticks when set, so the tick-clock test controls timestamps */
+static uint64_t fake_ticks;
+#define BTELEM_TIMESTAMP() (fake_ticks ? fake_ticks : btelem_monotonic_ns())
+
+#include "btelem/btelem_serve_udp.h"
+
+/* --------------------------------------------------------------------------
+ * Config
+ * ----------------------------------------------------------------------- */
+
+#define RING_ENTRIES       (1 << 16)
+#define FLOAT_SAMPLES      20000
+#define COALESCE_ENTRIES   2000
+#define COALESCE_LIMIT     512
+#define BENCH_ENTRIES      100000
+#define TEST_TIMEOUT_SEC   30
+
+/* --------------------------------------------------------------------------
+ * Schema
+ * ----------------------------------------------------------------------- */
+
+struct all_payload {
+    double   f64;
+    int64_t  i64;
+    uint64_t u64;
+    float    f32;
+    int32_t  i32;
+    uint32_t u32;
+    float    vec[3];
+    int16_t  i16;
+    uint16_t u16;
+    uint16_t flags;
+    int8_t   i8;
+    uint8_t  u8;
+    uint8_t  ok;
+    uint8_t  mode;
+    uint8_t  blob[4];
+    char     name[8];
+};
+
+static const char *const mode_labels[] = { "IDLE", "RUN" };
+BTELEM_ENUM_DEF(mode, mode_labels);
+
+static const struct btelem_bit_def flag_bits[] = {
+    BTELEM_BIT("en",  0, 1),
+    BTELEM_BIT("chan", 4, 4),
+};
+BTELEM_BITFIELD_DEF(flags, flag_bits);
+
+static const struct btelem_field_def all_fields[] = {
+    BTELEM_FIELD(struct all_payload, f64, BTELEM_F64),
+    BTELEM_FIELD(struct all_payload, i64, BTELEM_I64),
+    BTELEM_FIELD(struct all_payload, u64, BTELEM_U64),
+    BTELEM_FIELD(struct all_payload, f32, BTELEM_F32),
+    BTELEM_FIELD(struct all_payload, i32, BTELEM_I32),
+    BTELEM_FIELD(struct all_payload, u32, BTELEM_U32),
+    BTELEM_ARRAY_FIELD(struct all_payload, vec, BTELEM_F32, 3),
+    BTELEM_FIELD(struct all_payload, i16, BTELEM_I16),
+    BTELEM_FIELD(struct all_payload, u16, BTELEM_U16),
+    BTELEM_FIELD_BITFIELD(struct all_payload, flags, flags),
+    BTELEM_FIELD(struct all_payload, i8, BTELEM_I8),
+    BTELEM_FIELD(struct all_payload, u8, BTELEM_U8),
+    BTELEM_FIELD(struct all_payload, ok, BTELEM_BOOL),
+    BTELEM_FIELD_ENUM(struct all_payload, mode, mode),
+    BTELEM_FIELD(struct all_payload, blob, BTELEM_BYTES),
+    BTELEM_FIELD_STRING(struct all_payload, name),
+};
+BTELEM_SCHEMA_ENTRY(ALL, 0, "all", "Every field type", struct all_payload, all_fields);
+
+struct val_payload {
+    double v;
+};
+
+static const struct btelem_field_def val_fields[] = {
+    BTELEM_FIELD(struct val_payload, v, BTELEM_F64),
+};
+BTELEM_SCHEMA_ENTRY(VAL, 1, "val", "One double", struct val_payload, val_fields);
+
+/* --------------------------------------------------------------------------
+ * Shared state and helpers
+ * ----------------------------------------------------------------------- */
+
+static struct btelem_ctx ctx;
+static struct btelem_udp_server srv;
+static int rx_fd = -1;
+static struct btelem_clock tick_clock;  /* installed by setup(); 0 Hz = ns */
+
+static double mono_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Fresh context + loopback receiver + server; limit < 0 = btelem_serve_udp() */
+static int setup(int limit)
+{
+    static void *ring;
+    if (!ring)
+        ring = malloc(btelem_ring_size(RING_ENTRIES));
+    if (!ring || btelem_init(&ctx, ring, RING_ENTRIES) < 0)
+        return -1;
+    btelem_register(&ctx, &btelem_schema_ALL);
+    btelem_register(&ctx, &btelem_schema_VAL);
+    ctx.clock = tick_clock;
+
+    rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sz = 4 << 20;
+    setsockopt(rx_fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    struct timeval tv = { .tv_sec = 1 };
+    setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof(addr);
+    if (bind(rx_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || getsockname(rx_fd, (struct sockaddr *)&addr, &len) < 0) {
+        perror("bind");
+        return -1;
+    }
+
+    memset(&srv, 0, sizeof(srv));
+    int rc = limit < 0
+        ? btelem_serve_udp(&srv, &ctx, "127.0.0.1", ntohs(addr.sin_port))
+        : btelem_serve_udp_json(&srv, &ctx, "127.0.0.1", ntohs(addr.sin_port),
+                                (uint32_t)limit);
+    return rc;
+}
+
+static void teardown(void)
+{
+    btelem_udp_server_stop(&srv);
+    close(rx_fd);
+    rx_fd = -1;
+}
+
+/* Receive one datagram into buf (NUL-terminated); returns length or -1 */
+static int recv_dgram(char *buf, size_t cap)
+{
+    ssize_t n = recv(rx_fd, buf, cap - 1, 0);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return (int)n;
+}
+
+/* Skip `{"timestamp":<sec>.<9 digits>`; returns the rest or NULL */
+static const char *skip_timestamp(const char *s)
+{
+    static const char key[] = "{\"timestamp\":";
+    if (strncmp(s, key, sizeof(key) - 1) != 0)
+        return NULL;
+    s += sizeof(key) - 1;
+    if (*s < '0' || *s > '9')
+        return NULL;
+    while (*s >= '0' && *s <= '9')
+        s++;
+    if (*s++ != '.')
+        return NULL;
+    for (int i = 0; i < 9; i++, s++)
+        if (*s < '0' || *s > '9')
+            return NULL;
+    return s;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 1: one datagram per entry, exact text for every field type
+ * ----------------------------------------------------------------------- */
+
+static int test_field_types(void)
+{
+    printf("Test 1: field types\n");
+    if (setup(-1) < 0) {
+        printf("  FAIL: setup\n");
+        return 1;
+    }
+
+    struct all_payload p;
+    memset(&p, 0, sizeof(p));
+    p.f64 = -1234.5678125;
+    p.i64 = INT64_MIN;
+    p.u64 = UINT64_MAX;
+    p.f32 = 0.1f;
+    p.i32 = -7;
+    p.u32 = 4000000000u;
+    p.vec[0] = 1.0f;
+    p.vec[1] = -2.5e-7f;
+    p.vec[2] = 3e9f;
+    p.i16 = -32768;
+    p.u16 = 65535;
+    p.flags = 0x00A1;   /* en=1, chan=10 */
+    p.i8 = -128;
+    p.u8 = 200;
+    p.ok = 1;
+    p.mode = 1;
+    memcpy(p.name, "skip", 5);
+    BTELEM_LOG(&ctx, ALL, p);
+
+    static const char want[] =
+        ",\"all.f64\":-1234.5678"
+        ",\"all.i64\":-9223372036854775808"
+        ",\"all.u64\":18446744073709551615"
+        ",\"all.f32\":0.1"
+        ",\"all.i32\":-7"
+        ",\"all.u32\":4000000000"
+        ",\"all.vec.0\":1,\"all.vec.1\":-2.5e-07,\"all.vec.2\":3e+09"
+        ",\"all.i16\":-32768"
+        ",\"all.u16\":65535"
+        ",\"all.flags.en\":1,\"all.flags.chan\":10"
+        ",\"all.i8\":-128"
+        ",\"all.u8\":200"
+        ",\"all.ok\":true"
+        ",\"all.mode\":1"
+        "}\n";
+
+    int fail = 0;
+    char buf[4096];
+    if (recv_dgram(buf, sizeof(buf)) < 0) {
+        printf("  FAIL: no datagram\n");
+        fail = 1;
+    } else {
+        const char *rest = skip_timestamp(buf);
+        if (!rest || strcmp(rest, want) != 0) {
+            printf("  FAIL: got  %s", buf);
+            printf("        want {\"timestamp\":<s.ns>%s", want);
+            fail = 1;
+        }
+    }
+
+    /* BOOL false and a non-finite double */
+    p.ok = 0;
+    p.f64 = NAN;
+    BTELEM_LOG(&ctx, ALL, p);
+    if (!fail && (recv_dgram(buf, sizeof(buf)) < 0
+                  || !strstr(buf, "\"all.f64\":null,")
+                  || !strstr(buf, "\"all.ok\":false,"))) {
+        printf("  FAIL: false/null: %s", buf);
+        fail = 1;
+    }
+
+    teardown();
+    if (!fail)
+        printf("  PASS\n\n");
+    return fail;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 2: float text matches "%.8g" over a wide range of magnitudes
+ * ----------------------------------------------------------------------- */
+
+static double random_double(unsigned *seed)
+{
+    double m = (double)rand_r(seed) / RAND_MAX;
+    int e = rand_r(seed) % 80 - 40;
+    double v = m * pow(10.0, e);
+    switch (rand_r(seed) % 8) {
+    case 0: return -v;
+    case 1: return (double)(rand_r(seed) % 100000);        /* integers */
+    case 2: return (double)(rand_r(seed) % 1000) / 8.0;    /* exact binary */
+    case 3: return (float)v;                               /* F32 widened */
+    default: return v;
+    }
+}
+
+static int test_float_format(void)
+{
+    printf("Test 2: float formatting (%d samples)\n", FLOAT_SAMPLES);
+    if (setup(1400) < 0) {
+        printf("  FAIL: setup\n");
+        return 1;
+    }
+
+    static const double edge[] = {
+        0.0, 1.0, -1.0, 0.0001, 0.00001, 99999999.0, 100000000.0,
+        99999999.5, 123456785.0, 9.9999999e-5, 1e-300, 1e300,
+        5e-324, 1.7976931348623157e308, 0.1, 1.0 / 3.0,
+    };
+    int n_edge = (int)(sizeof(edge) / sizeof(edge[0]));
+
+    double *vals = (double *)malloc(sizeof(double) * FLOAT_SAMPLES);
+    unsigned seed = 12345;
+    for (int i = 0; i < FLOAT_SAMPLES; i++)
+        vals[i] = i < n_edge ? edge[i] : random_double(&seed);
+
+    /* Log in chunks so the receive buffer never overflows */
+    int sent = 0, got = 0, bad = 0;
+    char buf[65536];
+    while (got < FLOAT_SAMPLES) {
+        while (sent < FLOAT_SAMPLES && sent - got < 1000) {
+            struct val_payload p = { vals[sent++] };
+            BTELEM_LOG(&ctx, VAL, p);
+        }
+        if (recv_dgram(buf, sizeof(buf)) < 0) {
+            printf("  FAIL: timed out after %d/%d\n", got, FLOAT_SAMPLES);
+            bad++;
+            break;
+        }
+        for (char *line = buf; *line; ) {
+            char *nl = strchr(line, '\n');
+            if (!nl)
+                break;
+            *nl = '\0';
+            const char *rest = skip_timestamp(line);
+            char want[64];
+            if (isfinite(vals[got]))
+                snprintf(want, sizeof(want), ",\"val.v\":%.8g}", vals[got]);
+            else
+                snprintf(want, sizeof(want), ",\"val.v\":null}");
+            if (!rest || strcmp(rest, want) != 0) {
+                if (bad < 5)
+                    printf("  %.17g: got %s want %s\n",
+                           vals[got], rest ? rest : line, want);
+                bad++;
+            }
+            got++;
+            line = nl + 1;
+        }
+    }
+
+    free(vals);
+    teardown();
+    if (bad) {
+        printf("  FAIL: %d mismatches\n\n", bad);
+        return 1;
+    }
+    printf("  PASS\n\n");
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 3: coalescing stays within the datagram limit
+ * ----------------------------------------------------------------------- */
+
+static int test_coalesce(void)
+{
+    printf("Test 3: coalescing (limit %d bytes)\n", COALESCE_LIMIT);
+    if (setup(COALESCE_LIMIT) < 0) {
+        printf("  FAIL: setup\n");
+        return 1;
+    }
+
+    for (int i = 0; i < COALESCE_ENTRIES; i++) {
+        struct val_payload p = { (double)i };
+        BTELEM_LOG(&ctx, VAL, p);
+    }
+
+    int fail = 0, lines = 0, dgrams = 0, max_len = 0, next = 0;
+    char buf[65536];
+    while (lines < COALESCE_ENTRIES) {
+        int n = recv_dgram(buf, sizeof(buf));
+        if (n < 0) {
+            printf("  FAIL: timed out after %d/%d\n", lines, COALESCE_ENTRIES);
+            fail = 1;
+            break;
+        }
+        dgrams++;
+        if (n > max_len)
+            max_len = n;
+        if (n > COALESCE_LIMIT || buf[n - 1] != '\n') {
+            printf("  FAIL: datagram of %d bytes\n", n);
+            fail = 1;
+            break;
+        }
+        for (char *line = buf; *line; ) {
+            char *nl = strchr(line, '\n');
+            const char *rest = skip_timestamp(line);
+            char want[64];
+            int wl = snprintf(want, sizeof(want), ",\"val.v\":%d}", next++);
+            if (!rest || strncmp(rest, want, (size_t)wl) != 0 || rest + wl != nl) {
+                printf("  FAIL: line %d out of order\n", next - 1);
+                fail = 1;
+                break;
+            }
+            lines++;
+            line = nl + 1;
+        }
+        if (fail)
+            break;
+    }
+
+    printf("  %d entries in %d datagrams (max %d bytes)\n",
+           lines, dgrams, max_len);
+    if (!fail && dgrams * 4 > lines) {
+        printf("  FAIL: expected several entries per datagram\n");
+        fail = 1;
+    }
+
+    teardown();
+    if (!fail)
+        printf("  PASS\n\n");
+    return fail;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 4: tick timestamps are emitted as seconds of CLOCK_MONOTONIC
+ * ----------------------------------------------------------------------- */
+
+static int test_tick_clock(void)
+{
+    printf("Test 4: tick timestamps\n");
+    tick_clock.tick_hz = 2500000000ULL;     /* 2.5 GHz */
+    tick_clock.ref_ticks = 1000000000000ULL;
+    tick_clock.ref_ns = 7000000000ULL;
+    int rc = setup(-1);
+    memset(&tick_clock, 0, sizeof(tick_clock));
+    if (rc < 0) {
+        printf("  FAIL: setup\n");
+        return 1;
+    }
+
+    static const struct {
+        uint64_t    ticks;
+        const char *want;
+    } cases[] = {
+        { 1000000000000ULL + 7500000250ULL, "{\"timestamp\":10.000000100," },
+        { 1000000000000ULL,                 "{\"timestamp\":7.000000000," },
+        { 1000000000000ULL - 2500000000ULL, "{\"timestamp\":6.000000000," },
+    };
+
+    int fail = 0;
+    char buf[4096];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && !fail; i++) {
+        struct val_payload p = { (double)i };
+        fake_ticks = cases[i].ticks;
+        BTELEM_LOG(&ctx, VAL, p);
+        fake_ticks = 0;
+        if (recv_dgram(buf, sizeof(buf)) < 0) {
+            printf("  FAIL: no datagram\n");
+            fail = 1;
+        } else if (strncmp(buf, cases[i].want, strlen(cases[i].want)) != 0) {
+            printf("  FAIL: got  %s", buf);
+            printf("        want %s...\n", cases[i].want);
+            fail = 1;
+        }
+    }
+
+    teardown();
+    if (!fail)
+        printf("  PASS\n\n");
+    return fail;
+}
+
+/* --------------------------------------------------------------------------
+ * Test 5: end-to-end throughput (informational)
+ * ----------------------------------------------------------------------- */
+
+static int bench_mode(const char *label, int limit)
+{
+    if (setup(limit) < 0) {
+        printf("  FAIL: setup\n");
+        return 1;
+    }
+
+    struct all_payload p;
+    memset(&p, 0, sizeof(p));
+    p.vec[0] = 1.5f;
+    p.vec[1] = -2.25f;
+    p.vec[2] = 3.125f;
+
+    double t0 = mono_s();
+    int got = 0;
+    char buf[65536];
+    for (int sent = 0; got < BENCH_ENTRIES; ) {
+        while (sent < BENCH_ENTRIES && sent - got < RING_ENTRIES / 2) {
+            p.f64 += 0.001;
+            p.i32 = sent++;
+            BTELEM_LOG(&ctx, ALL, p);
+        }
+        int n = recv_dgram(buf, sizeof(buf));
+        if (n < 0)
+            break;  /* dropped datagram(s); report what arrived */
+        for (int i = 0; i < n; i++)
+            got += buf[i] == '\n';
+    }
+    double dt = mono_s() - t0;
+
+    printf("  %-22s %d/%d entries, %.0f entries/s\n",
+           label, got, BENCH_ENTRIES, got / dt);
+    teardown();
+    return got == 0;
+}
+
+static int test_throughput(void)
+{
+    printf("Test 5: throughput (%d entries, %zu-byte payload)\n",
+           BENCH_ENTRIES, sizeof(struct all_payload));
+    int fail = 0;
+    fail |= bench_mode("one per datagram:", -1);
+    fail |= bench_mode("coalesced (1472 B):", 1472);
+    if (!fail)
+        printf("  PASS\n\n");
+    return fail;
+}
+
+/* --------------------------------------------------------------------------
+ * Main
+ * ----------------------------------------------------------------------- */
+
+static void alarm_handler(int sig)
+{
+    (void)sig;
+    fprintf(stderr, "\nFAILED: test timed out after %d seconds\n",
+            TEST_TIMEOUT_SEC);
+    _exit(1);
+}
+
+int main(void)
+{
+    signal(SIGALRM, alarm_handler);
+    alarm(TEST_TIMEOUT_SEC);
+
+    printf("btelem UDP JSON test\n");
+    printf("====================\n\n");
+
+    int failed = 0;
+    failed += test_field_types();
+    failed += test_float_format();
+    failed += test_coalesce();
+    failed += test_tick_clock();
+    failed += test_throughput();
+    int total = 5;
+
+    printf("%s (%d/%d passed)\n",
+           failed ? "FAILED" : "ALL PASSED",
+           total - failed, total);
+
+    return failed ? 1 : 0;
+}
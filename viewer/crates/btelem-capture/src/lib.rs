@@ -6,7 +6,11 @@
 //! time (interop with the existing Python `.btlm` tooling), or
 //! [`Capture::clear`] to start fresh.
 //!
-//! The ring drops oldest packets when its byte budget is exceeded.
+//! The ring drops oldest packets when its byte budget is exceeded. Packets
+//! are stored back to back in segments of up to [`SEGMENT_BYTES`] (or a
+//! quarter of the budget, if smaller), and eviction drops a whole segment
+//! at a time: one free instead of one per packet, and no per-packet
+//! allocation on push.
 //!
 //! The on-disk format mirrors `python/btelem/storage.py`:
 //!
@@ -14,9 +18,14 @@
 //! [magic "BTLM" 4] [version u16 LE] [schema_len u32 LE]
 //! [schema blob]
 //! [packet 0] [packet 1] ... [packet N]
+//! [first_id u32 x (N+2)]  // ID summary: packet i's records are first_id[i]..first_id[i+1]
+//! [index_id x M]          // 4 bytes each: id u16 / count u16, ascending per packet
+//! [ids_footer]            // 16 bytes: ids_offset u64 / M u32 / magic u32 = "BIDS"
 //! [index_entry x (N+1)]   // 28 bytes each: offset/ts_min/ts_max/entry_count
 //! [index_footer]          // 16 bytes: index_offset u64 / count u32 / magic u32 = "BTLI"
 //! ```
+//!
+//! The ID summary is optional on read (older files lack it).
 
 #![forbid(unsafe_code)]
 
@@ -35,8 +44,12 @@ pub const MAGIC: &[u8; 4] = b"BTLM";
 pub const VERSION: u16 = 1;
 /// Footer magic ("BTLI" little-endian).
 pub const INDEX_MAGIC: u32 = 0x494C5442;
+/// ID summary footer magic ("BIDS" little-endian).
+pub const INDEX_IDS_MAGIC: u32 = 0x53444942;
 /// Default ring byte budget (256 MiB).
 pub const DEFAULT_RING_BYTES: usize = 256 * 1024 * 1024;
+/// Largest ring segment; the unit of eviction.
+pub const SEGMENT_BYTES: usize = 4 * 1024 * 1024;
 
 // Packet wire layout (mirror of btelem-wire's private constants).
 const PACKET_HEADER_SIZE: usize = 16;
@@ -88,10 +101,33 @@ pub struct CaptureStats {
     pub has_schema: bool,
 }
 
+/// Packets stored back to back, with where each one starts.
+struct Segment {
+    buf: Vec<u8>,
+    packets: Vec<(usize, PacketMeta)>,
+    ts_min: u64,
+    ts_max: u64,
+}
+
+impl Segment {
+    fn packet(&self, i: usize) -> &[u8] {
+        let end = self.packets.get(i + 1).map_or(self.buf.len(), |p| p.0);
+        &self.buf[self.packets[i].0..end]
+    }
+
+    fn iter(&self) -> impl Iterator<Item = (&[u8], &PacketMeta)> {
+        (0..self.packets.len()).map(move |i| (self.packet(i), &self.packets[i].1))
+    }
+}
+
 struct Inner {
     schema: Option<Vec<u8>>,
-    /// Front = oldest. We push to back and pop from front on overflow.
-    packets: VecDeque<(Vec<u8>, PacketMeta)>,
+    /// Front = oldest. We append to the back segment and pop whole
+    /// segments from the front on overflow.
+    segments: VecDeque<Segment>,
+    /// Buffer of the last evicted segment, reused by the next one.
+    spare: Option<Vec<u8>>,
+    packets: usize,
     bytes: usize,
     cap_bytes: usize,
     packets_total: u64,
@@ -103,7 +139,9 @@ impl Inner {
     fn new(cap_bytes: usize) -> Self {
         Self {
             schema: None,
-            packets: VecDeque::new(),
+            segments: VecDeque::new(),
+            spare: None,
+            packets: 0,
             bytes: 0,
             cap_bytes,
             packets_total: 0,
@@ -114,22 +152,57 @@ impl Inner {
 
     fn clear(&mut self) {
         self.schema = None;
-        self.packets.clear();
+        self.segments.clear();
+        self.packets = 0;
         self.bytes = 0;
         self.packets_total = 0;
         self.packets_dropped = 0;
         self.epoch = None;
     }
 
+    fn push(&mut self, bytes: &[u8], meta: PacketMeta) {
+        let seg_bytes = SEGMENT_BYTES.min(self.cap_bytes / 4).max(1);
+        let fits = self
+            .segments
+            .back()
+            .is_some_and(|s| s.buf.len() + bytes.len() <= s.buf.capacity());
+        if !fits {
+            let mut buf = self.spare.take().unwrap_or_default();
+            buf.clear();
+            buf.reserve(seg_bytes.max(bytes.len()));
+            self.segments.push_back(Segment {
+                buf,
+                packets: Vec::new(),
+                ts_min: u64::MAX,
+                ts_max: 0,
+            });
+        }
+        let seg = self.segments.back_mut().unwrap();
+        seg.packets.push((seg.buf.len(), meta));
+        seg.buf.extend_from_slice(bytes);
+        seg.ts_min = seg.ts_min.min(meta.ts_min);
+        seg.ts_max = seg.ts_max.max(meta.ts_max);
+        self.packets += 1;
+        self.bytes += bytes.len();
+    }
+
+    /// Drop the oldest segments while over budget, never the one being
+    /// filled.
     fn evict_to_fit(&mut self) {
-        while self.bytes > self.cap_bytes {
-            let Some((pkt, _)) = self.packets.pop_front() else {
+        while self.bytes > self.cap_bytes && self.segments.len() > 1 {
+            let Some(seg) = self.segments.pop_front() else {
                 break;
             };
-            self.bytes -= pkt.len();
-            self.packets_dropped += 1;
+            self.bytes -= seg.buf.len();
+            self.packets -= seg.packets.len();
+            self.packets_dropped += seg.packets.len() as u64;
+            self.spare = Some(seg.buf);
         }
     }
+
+    fn iter(&self) -> impl Iterator<Item = (&[u8], &PacketMeta)> {
+        self.segments.iter().flat_map(Segment::iter)
+    }
 }
 
 /// Cheap-clone, thread-safe capture handle.
@@ -176,12 +249,13 @@ impl Capture {
 
     /// Append a raw packet (as it would appear on the wire, *without* the
     /// u32 length prefix). FIFO-evicts oldest packets if the byte budget
-    /// is exceeded.
-    pub fn push_packet(&self, bytes: Vec<u8>) -> Result<(), CaptureError> {
-        let meta = extract_meta(&bytes)?;
+    /// is exceeded. Compressed packets are kept compressed. The bytes are
+    /// copied into the current segment, so callers can lend their buffer.
+    pub fn push_packet(&self, bytes: impl AsRef<[u8]>) -> Result<(), CaptureError> {
+        let bytes = bytes.as_ref();
+        let meta = extract_meta(bytes)?;
         let mut g = self.inner.lock().unwrap();
-        g.bytes += bytes.len();
-        g.packets.push_back((bytes, meta));
+        g.push(bytes, meta);
         g.packets_total += 1;
         if g.epoch.is_none() {
             g.epoch = Some(Instant::now());
@@ -198,16 +272,16 @@ impl Capture {
     /// Current stats snapshot (cheap).
     pub fn stats(&self) -> CaptureStats {
         let g = self.inner.lock().unwrap();
-        let (ts_min, ts_max) = if g.packets.is_empty() {
+        let (ts_min, ts_max) = if g.packets == 0 {
             (None, None)
         } else {
-            let lo = g.packets.iter().map(|(_, m)| m.ts_min).min();
-            let hi = g.packets.iter().map(|(_, m)| m.ts_max).max();
+            let lo = g.segments.iter().map(|s| s.ts_min).min();
+            let hi = g.segments.iter().map(|s| s.ts_max).max();
             (lo, hi)
         };
         let age_secs = g.epoch.map(|t| t.elapsed().as_secs_f64()).unwrap_or(0.0);
         CaptureStats {
-            packets: g.packets.len() as u64,
+            packets: g.packets as u64,
             bytes: g.bytes as u64,
             packets_total: g.packets_total,
             packets_dropped: g.packets_dropped,
@@ -221,7 +295,7 @@ impl Capture {
     /// Returns true if the ring has at least one packet.
     pub fn has_data(&self) -> bool {
         let g = self.inner.lock().unwrap();
-        !g.packets.is_empty()
+        g.packets > 0
     }
 
     /// Write the ring out as a `.btlm` file (header + schema + packets +
@@ -233,11 +307,12 @@ impl Capture {
         let schema = g.schema.as_deref().ok_or(CaptureError::NoSchema)?;
         let file = File::create(path)?;
         let mut w = BufWriter::new(file);
-        write_btlm_inner(&mut w, schema, &g.packets)?;
+        let packets: Vec<(&[u8], &PacketMeta)> = g.iter().collect();
+        write_btlm_inner(&mut w, schema, &packets)?;
         w.flush()?;
         let bytes_written = w.stream_position()?;
         Ok(SaveReport {
-            packets: g.packets.len() as u64,
+            packets: g.packets as u64,
             bytes: bytes_written,
             schema_bytes: schema.len() as u64,
         })
@@ -252,14 +327,38 @@ pub struct SaveReport {
     pub schema_bytes: u64,
 }
 
+/// `(schema id, entries)` pairs for one packet, ascending by id.
+pub type IdCounts = Vec<(u16, u16)>;
+
 /// In-memory snapshot of a `.btlm` file produced by [`read_btlm`].
 ///
 /// `packets` are the raw packet bodies in file order, ready to feed
-/// straight back through `btelem_wire::decode_packet`.
+/// back through `btelem_wire::decode_packet` (after
+/// `btelem_wire::decompress_packet`, as files may hold compressed ones).
+///
+/// `id_counts[i]` lists the `(schema id, entries)` pairs in `packets[i]`,
+/// ascending by id, when the file carries an ID summary.
 #[derive(Debug, Clone)]
 pub struct LoadedCapture {
     pub schema: Vec<u8>,
     pub packets: Vec<Vec<u8>>,
+    pub id_counts: Option<Vec<IdCounts>>,
+}
+
+impl LoadedCapture {
+    /// Indices of the packets that may hold entries with `id`: those the
+    /// ID summary lists it in, or every packet without a summary.
+    pub fn packets_with_id(&self, id: u16) -> Vec<usize> {
+        match &self.id_counts {
+            Some(counts) => counts
+                .iter()
+                .enumerate()
+                .filter(|(_, c)| c.binary_search_by_key(&id, |&(i, _)| i).is_ok())
+                .map(|(i, _)| i)
+                .collect(),
+            None => (0..self.packets.len()).collect(),
+        }
+    }
 }
 
 /// Read a `.btlm` file from disk. Validates the magic + version, then
@@ -313,15 +412,17 @@ pub fn read_btlm(path: &Path) -> Result<LoadedCapture, CaptureError> {
         let off = u64::from_le_bytes(buf[0..8].try_into().unwrap());
         entries.push(off);
     }
+    let (id_counts, data_end) = read_id_summary(&mut r, index_offset, count)?;
+
     // Compute each packet's length from its successor's offset (or the
-    // index offset for the last one).
+    // end of the packet data for the last one).
     let mut packets: Vec<Vec<u8>> = Vec::with_capacity(count);
     for i in 0..count {
         let start = entries[i];
         let end = if i + 1 < count {
             entries[i + 1]
         } else {
-            index_offset
+            data_end
         };
         if end < start {
             return Err(CaptureError::Truncated);
@@ -333,7 +434,58 @@ pub fn read_btlm(path: &Path) -> Result<LoadedCapture, CaptureError> {
         packets.push(buf);
     }
 
-    Ok(LoadedCapture { schema, packets })
+    Ok(LoadedCapture {
+        schema,
+        packets,
+        id_counts,
+    })
+}
+
+/// Load the ID summary ending at `index_offset`, if the file has one.
+/// Returns it with the offset where packet data ends.
+fn read_id_summary<R: Read + Seek>(
+    r: &mut R,
+    index_offset: u64,
+    count: usize,
+) -> Result<(Option<Vec<IdCounts>>, u64), CaptureError> {
+    if index_offset < 16 {
+        return Ok((None, index_offset));
+    }
+    r.seek(SeekFrom::Start(index_offset - 16))?;
+    let mut footer = [0u8; 16];
+    r.read_exact(&mut footer)?;
+    let ids_offset = u64::from_le_bytes(footer[0..8].try_into().unwrap());
+    let id_count = u32::from_le_bytes(footer[8..12].try_into().unwrap()) as u64;
+    let magic = u32::from_le_bytes(footer[12..16].try_into().unwrap());
+    let size = (count as u64 + 1) * 4 + id_count * 4 + 16;
+    if magic != INDEX_IDS_MAGIC || ids_offset.checked_add(size) != Some(index_offset) {
+        return Ok((None, index_offset));
+    }
+
+    r.seek(SeekFrom::Start(ids_offset))?;
+    let mut table = vec![0u8; (size - 16) as usize];
+    r.read_exact(&mut table)?;
+    let first = |i: usize| u32::from_le_bytes(table[i * 4..i * 4 + 4].try_into().unwrap()) as u64;
+    let recs = &table[(count + 1) * 4..];
+    let mut out = Vec::with_capacity(count);
+    for i in 0..count {
+        let (lo, hi) = (first(i), first(i + 1));
+        if lo > hi || hi > id_count {
+            return Ok((None, index_offset));
+        }
+        out.push(
+            (lo as usize..hi as usize)
+                .map(|k| {
+                    let rec = &recs[k * 4..k * 4 + 4];
+                    (
+                        u16::from_le_bytes([rec[0], rec[1]]),
+                        u16::from_le_bytes([rec[2], rec[3]]),
+                    )
+                })
+                .collect(),
+        );
+    }
+    Ok((Some(out), ids_offset))
 }
 
 /// UTC-flavoured suggested filename: `{prefix}-YYYYMMDD-HHMMSS{suffix}.btlm`.
@@ -399,6 +551,9 @@ fn extract_meta(buf: &[u8]) -> Result<PacketMeta, CaptureError> {
     if buf.len() < PACKET_HEADER_SIZE {
         return Err(CaptureError::BadPacket(buf.len()));
     }
+    let plain =
+        btelem_wire::decompress_packet(buf).map_err(|_| CaptureError::BadPacket(buf.len()))?;
+    let buf = plain.as_ref();
     let entry_count = u16::from_le_bytes([buf[0], buf[1]]) as usize;
     let need = PACKET_HEADER_SIZE + entry_count * ENTRY_HEADER_SIZE;
     if buf.len() < need {
@@ -426,10 +581,35 @@ fn extract_meta(buf: &[u8]) -> Result<PacketMeta, CaptureError> {
     })
 }
 
+/// `(schema id, entries)` pairs in a packet, ascending by id.
+fn packet_id_counts(buf: &[u8]) -> IdCounts {
+    let Ok(plain) = btelem_wire::decompress_packet(buf) else {
+        return Vec::new();
+    };
+    let buf = plain.as_ref();
+    let entry_count = u16::from_le_bytes([buf[0], buf[1]]) as usize;
+    let mut ids: Vec<u16> = (0..entry_count)
+        .filter_map(|i| {
+            let off = PACKET_HEADER_SIZE + i * ENTRY_HEADER_SIZE;
+            buf.get(off..off + 2)
+                .map(|b| u16::from_le_bytes([b[0], b[1]]))
+        })
+        .collect();
+    ids.sort_unstable();
+    let mut out: IdCounts = Vec::new();
+    for id in ids {
+        match out.last_mut() {
+            Some((last, n)) if *last == id => *n += 1,
+            _ => out.push((id, 1)),
+        }
+    }
+    out
+}
+
 fn write_btlm_inner<W: Write + Seek>(
     w: &mut W,
     schema: &[u8],
-    packets: &VecDeque<(Vec<u8>, PacketMeta)>,
+    packets: &[(&[u8], &PacketMeta)],
 ) -> Result<(), CaptureError> {
     // File header: 4s + u16 + u32 = 10 bytes.
     w.write_all(MAGIC)?;
@@ -438,12 +618,31 @@ fn write_btlm_inner<W: Write + Seek>(
     w.write_all(schema)?;
 
     let mut offsets: Vec<(u64, PacketMeta)> = Vec::with_capacity(packets.len());
-    for (pkt, meta) in packets {
+    for &(pkt, meta) in packets {
         let off = w.stream_position()?;
         w.write_all(pkt)?;
         offsets.push((off, *meta));
     }
 
+    let ids_offset = w.stream_position()?;
+    let id_counts: Vec<IdCounts> = packets
+        .iter()
+        .map(|(pkt, _)| packet_id_counts(pkt))
+        .collect();
+    let mut first = 0u32;
+    for counts in &id_counts {
+        w.write_all(&first.to_le_bytes())?;
+        first += counts.len() as u32;
+    }
+    w.write_all(&first.to_le_bytes())?;
+    for &(id, n) in id_counts.iter().flatten() {
+        w.write_all(&id.to_le_bytes())?;
+        w.write_all(&n.to_le_bytes())?;
+    }
+    w.write_all(&ids_offset.to_le_bytes())?;
+    w.write_all(&first.to_le_bytes())?;
+    w.write_all(&INDEX_IDS_MAGIC.to_le_bytes())?;
+
     let index_offset = w.stream_position()?;
     for (off, meta) in &offsets {
         w.write_all(&off.to_le_bytes())?;
@@ -504,6 +703,27 @@ mod tests {
         assert!(s.has_schema);
     }
 
+    #[test]
+    fn push_reads_ts_range_of_compressed_packets() {
+        // id 0 @5000 and @4000, 8 bytes each, delta-coded
+        let body: &[u8] = &[
+            0x00, 0x08, 0x90, 0x4e, 0x01, 0x01, 0x61, 0x02, 0x00, 0x08, 0xcf, 0x0f, 0x71, 0x01,
+        ];
+        let mut pkt = vec![2, 0];
+        pkt.extend_from_slice(&btelem_wire::PACKET_FLAG_COMPRESSED.to_le_bytes());
+        pkt.extend_from_slice(&(body.len() as u32).to_le_bytes());
+        pkt.extend_from_slice(&[0u8; 8]);
+        pkt.extend_from_slice(body);
+
+        let cap = Capture::default();
+        cap.push_packet(pkt.clone()).unwrap();
+        let s = cap.stats();
+        assert_eq!((s.ts_min, s.ts_max), (Some(4000), Some(5000)));
+        assert_eq!(s.bytes, pkt.len() as u64);
+        pkt.pop();
+        assert!(cap.push_packet(pkt).is_err());
+    }
+
     #[test]
     fn ring_drops_oldest_at_cap() {
         let cap = Capture::with_capacity(128); // tiny
@@ -519,6 +739,34 @@ mod tests {
         assert!(s.ts_min.unwrap() > 0);
     }
 
+    #[test]
+    fn ring_evicts_whole_segments_in_order() {
+        // 1 KiB segments hold 21 of these 48-byte packets
+        let cap = Capture::with_capacity(4096);
+        cap.set_schema(b"S".to_vec());
+        let pkts: Vec<Vec<u8>> = (0..500u64)
+            .map(|i| build_packet(&[(1, i, &[i as u8; 16])]))
+            .collect();
+        for p in &pkts {
+            cap.push_packet(p.clone()).unwrap();
+        }
+        let s = cap.stats();
+        assert!(s.bytes <= 4096 && s.bytes >= 3 * 1024, "bytes={}", s.bytes);
+        assert_eq!(s.packets + s.packets_dropped, 500);
+        assert_eq!(s.packets_dropped % 21, 0);
+        assert_eq!(s.ts_min, Some(s.packets_dropped));
+        assert_eq!(s.ts_max, Some(499));
+
+        let dir = std::env::temp_dir().join(format!("btelem-seg-test-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("seg.btlm");
+        cap.save_btlm(&path).unwrap();
+        let loaded = read_btlm(&path).unwrap();
+        assert_eq!(loaded.packets, pkts[s.packets_dropped as usize..]);
+        let _ = std::fs::remove_file(&path);
+        let _ = std::fs::remove_dir(&dir);
+    }
+
     #[test]
     fn clear_resets_everything() {
         let cap = Capture::default();
@@ -622,6 +870,43 @@ mod tests {
         assert_eq!(loaded.packets.len(), 2);
         assert_eq!(loaded.packets[0], p1);
         assert_eq!(loaded.packets[1], p2);
+        assert_eq!(
+            loaded.id_counts,
+            Some(vec![vec![(1, 1)], vec![(2, 1), (3, 1)]])
+        );
+        assert_eq!(loaded.packets_with_id(3), vec![1]);
+
+        let _ = std::fs::remove_file(&path);
+        let _ = std::fs::remove_dir(&dir);
+    }
+
+    #[test]
+    fn read_btlm_accepts_index_without_id_summary() {
+        let cap = Capture::default();
+        cap.set_schema(vec![0x55u8; 12]);
+        let p1 = build_packet(&[(4, 100, &[1u8; 4]), (4, 110, &[2u8; 4])]);
+        cap.push_packet(p1.clone()).unwrap();
+        let dir = std::env::temp_dir().join(format!("btelem-v1-test-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("v1.btlm");
+        cap.save_btlm(&path).unwrap();
+
+        // Cut the ID summary out, as files written before it look
+        let bytes = std::fs::read(&path).unwrap();
+        let n = bytes.len();
+        let index_off = u64::from_le_bytes(bytes[n - 16..n - 8].try_into().unwrap()) as usize;
+        let ids_off =
+            u64::from_le_bytes(bytes[index_off - 16..index_off - 8].try_into().unwrap()) as usize;
+        let mut v1 = bytes[..ids_off].to_vec();
+        v1.extend_from_slice(&bytes[index_off..n - 16]);
+        v1.extend_from_slice(&(ids_off as u64).to_le_bytes());
+        v1.extend_from_slice(&bytes[n - 8..]);
+        std::fs::write(&path, &v1).unwrap();
+
+        let loaded = read_btlm(&path).unwrap();
+        assert_eq!(loaded.packets, vec![p1]);
+        assert_eq!(loaded.id_counts, None);
+        assert_eq!(loaded.packets_with_id(9), vec![0]);
 
         let _ = std::fs::remove_file(&path);
         let _ = std::fs::remove_dir(&dir);
@@ -1,20 +1,27 @@
 //! Ingest sources for btelem.
 //!
-//! Currently provides a TCP source that connects to a btelem `btelem_serve`
-//! endpoint, decodes the schema + packet stream, and pushes samples into a
-//! [`btelem_store::MockStore`].
+//! Provides a TCP source that connects to a btelem `btelem_serve` endpoint,
+//! decodes the schema + packet stream, and pushes samples into a
+//! [`btelem_store::InMemoryStore`], and a UDP source that does the same for
+//! `btelem_serve_udp_binary` datagrams.
 //!
-//! All work happens on a single background thread per source. The thread
-//! exits cleanly when the connection closes or the [`SourceHandle`] is
-//! dropped.
+//! Each source is driven by one background thread. The UDP thread decodes
+//! datagrams itself; the TCP thread only frames packets and feeds decode
+//! workers and an in-order store writer (see [`PipelineStats`]). The
+//! threads exit cleanly when the connection closes or the
+//! [`SourceHandle`] is dropped.
 
 #![forbid(unsafe_code)]
 
 mod mapper;
+mod pipeline;
 mod tcp;
+mod udp;
 
 pub use mapper::{ChannelMap, MapError};
+pub use pipeline::{PipelineStats, PIPELINE_BUDGET};
 pub use tcp::{SourceHandle, TcpSource};
+pub use udp::UdpSource;
 
 use thiserror::Error;
 
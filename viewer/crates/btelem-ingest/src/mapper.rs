@@ -1,9 +1,14 @@
 //! Schema → store channel mapping.
+//!
+//! [`ChannelMap::build`] compiles each schema entry into a [`Plan`]: a flat
+//! list of loads with the channel each one feeds, checked against the
+//! schema once. Dispatch then runs the list without looking at the schema
+//! again, and checks the payload length once per entry.
 
 use std::collections::HashMap;
 
-use btelem_store::{ChannelId, MockStore};
-use btelem_wire::{BitDef, FieldDef, FieldType, Schema, SchemaEntry, field_as_string};
+use btelem_store::{Batch, ChannelId, InMemoryStore};
+use btelem_wire::{field_as_string, Clock, DecodedEntry, FieldDef, FieldType, Schema, SchemaEntry};
 use thiserror::Error;
 
 #[derive(Debug, Error)]
@@ -14,48 +19,172 @@ pub enum MapError {
 
 #[derive(Default)]
 pub struct ChannelMap {
-    entries: HashMap<u16, EntryMap>,
+    entries: HashMap<u16, Plan>,
 }
 
-struct EntryMap {
-    fields: Vec<FieldKind>,
+/// Decode plan for one schema entry.
+#[derive(Default)]
+struct Plan {
+    ops: Vec<Op>,
+    /// Payload bytes every op fits in; shorter payloads take the checked path.
+    len: usize,
 }
 
-enum FieldKind {
+/// One step of a [`Plan`], in field declaration order.
+enum Op {
     Scalar {
+        load: Load,
+        off: usize,
         ch: ChannelId,
-        ty: FieldType,
-        offset: u16,
-        size: u16,
-    },
-    ScalarArray {
-        ty: FieldType,
-        base_offset: u16,
-        elem_size: u16,
-        channels: Vec<ChannelId>,
     },
+    /// One byte as a state value (bool / enum).
     State {
+        off: usize,
         ch: ChannelId,
-        offset: u16,
     },
-    Bitfield {
-        offset: u16,
-        storage_bytes: u16,
-        /// Scalar channel for the whole word (integer storage). `None`
-        /// when `storage_bytes` is not a supported width (1/2/4/8); in
-        /// that case only the per-bit lanes are dispatched.
-        word: Option<ChannelId>,
-        bits: Vec<(BitDef, ChannelId)>,
+    /// Load a little-endian bitfield word of `n` bytes into the word
+    /// register, pushing it to `ch` when the width is one the store models.
+    Word {
+        off: usize,
+        n: usize,
+        ch: Option<ChannelId>,
+    },
+    /// `(word >> shift) & mask` from the last [`Op::Word`].
+    Bits {
+        shift: u32,
+        mask: u64,
+        ch: ChannelId,
     },
     Text {
+        field: FieldDef,
         ch: ChannelId,
-        field_def: FieldDef,
     },
-    Ignored,
+}
+
+#[derive(Clone, Copy)]
+enum Load {
+    U8,
+    U16,
+    U32,
+    U64,
+    I8,
+    I16,
+    I32,
+    I64,
+    F32,
+    F64,
+}
+
+impl Load {
+    fn of(ty: FieldType) -> Option<Self> {
+        Some(match ty {
+            FieldType::U8 => Load::U8,
+            FieldType::U16 => Load::U16,
+            FieldType::U32 => Load::U32,
+            FieldType::U64 => Load::U64,
+            FieldType::I8 => Load::I8,
+            FieldType::I16 => Load::I16,
+            FieldType::I32 => Load::I32,
+            FieldType::I64 => Load::I64,
+            FieldType::F32 => Load::F32,
+            FieldType::F64 => Load::F64,
+            _ => return None,
+        })
+    }
+
+    fn size(self) -> usize {
+        match self {
+            Load::U8 | Load::I8 => 1,
+            Load::U16 | Load::I16 => 2,
+            Load::U32 | Load::I32 | Load::F32 => 4,
+            Load::U64 | Load::I64 | Load::F64 => 8,
+        }
+    }
+
+    /// Read at `off`; the caller has checked `off + size() <= p.len()`.
+    fn read(self, p: &[u8], off: usize) -> f64 {
+        match self {
+            Load::U8 => p[off] as f64,
+            Load::I8 => p[off] as i8 as f64,
+            Load::U16 => u16::from_le_bytes(le(p, off)) as f64,
+            Load::I16 => i16::from_le_bytes(le(p, off)) as f64,
+            Load::U32 => u32::from_le_bytes(le(p, off)) as f64,
+            Load::I32 => i32::from_le_bytes(le(p, off)) as f64,
+            Load::F32 => f32::from_le_bytes(le(p, off)) as f64,
+            Load::U64 => u64::from_le_bytes(le(p, off)) as f64,
+            Load::I64 => i64::from_le_bytes(le(p, off)) as f64,
+            Load::F64 => f64::from_le_bytes(le(p, off)),
+        }
+    }
+}
+
+fn le<const N: usize>(p: &[u8], off: usize) -> [u8; N] {
+    p[off..off + N]
+        .try_into()
+        .expect("length checked by the plan")
+}
+
+impl Op {
+    /// Payload bytes this op reads up to (0 when it reads none).
+    fn end(&self) -> usize {
+        match *self {
+            Op::Scalar { load, off, .. } => off + load.size(),
+            Op::State { off, .. } => off + 1,
+            Op::Word { off, n, .. } => off + n,
+            Op::Bits { .. } => 0,
+            Op::Text { ref field, .. } => field.offset as usize + field.size as usize,
+        }
+    }
+}
+
+impl Plan {
+    fn push(&mut self, op: Op) {
+        self.len = self.len.max(op.end());
+        self.ops.push(op);
+    }
+
+    fn run(&self, t: u64, payload: &[u8], batch: &mut Batch) {
+        // A short payload keeps the fields that fit, as the firmware may
+        // log a prefix of a grown struct.
+        let full = payload.len() >= self.len;
+        let mut word = None;
+        for op in &self.ops {
+            if !full && op.end() > payload.len() {
+                if let Op::Word { .. } = op {
+                    word = None;
+                }
+                continue;
+            }
+            match *op {
+                Op::Scalar { load, off, ch } => batch.push_scalar(ch, t, load.read(payload, off)),
+                Op::State { off, ch } => batch.push_state(ch, t, payload[off] as u32),
+                Op::Word { off, n, ch } => {
+                    let mut raw = 0u64;
+                    for (i, b) in payload[off..off + n.min(8)].iter().enumerate() {
+                        raw |= (*b as u64) << (i * 8);
+                    }
+                    if let Some(ch) = ch {
+                        batch.push_scalar(ch, t, raw as f64);
+                    }
+                    word = Some(raw);
+                }
+                Op::Bits { shift, mask, ch } => {
+                    if let Some(raw) = word {
+                        batch.push_scalar(ch, t, ((raw >> shift) & mask) as f64);
+                    }
+                }
+                Op::Text { ref field, ch } => {
+                    if let Some(value) = field_as_string(field, payload) {
+                        batch.push_text(ch, t, value);
+                    }
+                }
+            }
+        }
+    }
 }
 
 impl ChannelMap {
-    pub fn build(schema: &Schema, store: &MockStore) -> Result<Self, MapError> {
+    pub fn build(schema: &Schema, store: &InMemoryStore) -> Result<Self, MapError> {
         let mut map = ChannelMap::default();
         for entry in &schema.entries {
             if map.entries.contains_key(&entry.id) {
@@ -67,83 +196,48 @@ impl ChannelMap {
         Ok(map)
     }
 
-    pub fn dispatch(&self, schema_id: u16, t: u64, payload: &[u8], store: &MockStore) {
-        let Some(em) = self.entries.get(&schema_id) else {
-            return;
-        };
-        for fk in &em.fields {
-            match fk {
-                FieldKind::Scalar {
-                    ch,
-                    ty,
-                    offset,
-                    size,
-                } => {
-                    if let Some(v) = read_scalar(*ty, payload, *offset, *size) {
-                        store.push_scalar(*ch, t, v);
-                    }
-                }
-                FieldKind::ScalarArray {
-                    ty,
-                    base_offset,
-                    elem_size,
-                    channels,
-                } => {
-                    for (i, ch) in channels.iter().enumerate() {
-                        let off = *base_offset + (i as u16) * *elem_size;
-                        if let Some(v) = read_scalar(*ty, payload, off, *elem_size) {
-                            store.push_scalar(*ch, t, v);
-                        }
-                    }
-                }
-                FieldKind::State { ch, offset } => {
-                    let off = *offset as usize;
-                    if off < payload.len() {
-                        store.push_state(*ch, t, payload[off] as u32);
-                    }
-                }
-                FieldKind::Bitfield {
-                    offset,
-                    storage_bytes,
-                    word,
-                    bits,
-                } => {
-                    let off = *offset as usize;
-                    let n = *storage_bytes as usize;
-                    if off + n <= payload.len() {
-                        // Read the storage word once; bits are masked from
-                        // this value rather than re-reading the payload.
-                        let mut raw = 0u64;
-                        for (i, b) in payload[off..off + n].iter().enumerate() {
-                            raw |= (*b as u64) << (i * 8);
-                        }
-                        if let Some(ch) = word {
-                            store.push_scalar(*ch, t, raw as f64);
-                        }
-                        for (bit, ch) in bits {
-                            let mask = ((1u64 << bit.width) - 1) << bit.start;
-                            let v = ((raw & mask) >> bit.start) as f64;
-                            store.push_scalar(*ch, t, v);
-                        }
-                    }
-                }
-                FieldKind::Ignored => {}
-                FieldKind::Text { ch, field_def } => {
-                    if let Some(value) = field_as_string(field_def, payload) {
-                        store.push_text(*ch, t, value);
-                    }
-                }
+    /// Decode one entry into `batch`; commit with [`InMemoryStore::push_batch`].
+    pub fn dispatch(&self, schema_id: u16, t: u64, payload: &[u8], batch: &mut Batch) {
+        if let Some(plan) = self.entries.get(&schema_id) {
+            plan.run(t, payload, batch);
+        }
+    }
+
+    /// Decode a packet's entries into `batch`, converting ticks with
+    /// `clock` when set. Entries are taken one ID at a time (in arrival
+    /// order within an ID), so each plan is looked up once per packet and
+    /// runs over its entries back to back.
+    pub fn dispatch_packet(
+        &self,
+        entries: &[DecodedEntry<'_>],
+        clock: Option<Clock>,
+        batch: &mut Batch,
+    ) {
+        let mut order: Vec<(u16, u32)> = entries
+            .iter()
+            .enumerate()
+            .map(|(i, e)| (e.id, i as u32))
+            .collect();
+        order.sort_unstable();
+        for run in order.chunk_by(|a, b| a.0 == b.0) {
+            let Some(plan) = self.entries.get(&run[0].0) else {
+                continue;
+            };
+            for &(_, i) in run {
+                let e = &entries[i as usize];
+                let ts = clock.map_or(e.timestamp, |c| c.to_ns(e.timestamp));
+                plan.run(ts, e.payload, batch);
             }
         }
     }
 }
 
-fn build_entry(entry: &SchemaEntry, schema: &Schema, store: &MockStore) -> EntryMap {
-    let mut fields = Vec::with_capacity(entry.fields.len());
+fn build_entry(entry: &SchemaEntry, schema: &Schema, store: &InMemoryStore) -> Plan {
+    let mut plan = Plan::default();
     for (fi, f) in entry.fields.iter().enumerate() {
-        fields.push(build_field(entry.id, fi as u16, f, schema, store));
+        build_field(entry.id, fi as u16, f, schema, store, &mut plan);
     }
-    EntryMap { fields }
+    plan
 }
 
 fn build_field(
@@ -151,8 +245,9 @@ fn build_field(
     field_index: u16,
     f: &FieldDef,
     schema: &Schema,
-    store: &MockStore,
-) -> FieldKind {
+    store: &InMemoryStore,
+    plan: &mut Plan,
+) {
     let entry_name = schema
         .entry(schema_id)
         .map(|e| e.name.as_str())
@@ -166,36 +261,14 @@ fn build_field(
         }
     };
 
-    let is_numeric = matches!(
-        f.ty,
-        FieldType::U8
-            | FieldType::U16
-            | FieldType::U32
-            | FieldType::U64
-            | FieldType::I8
-            | FieldType::I16
-            | FieldType::I32
-            | FieldType::I64
-            | FieldType::F32
-            | FieldType::F64
-    );
-    let is_integer = matches!(
-        f.ty,
-        FieldType::U8
-            | FieldType::U16
-            | FieldType::U32
-            | FieldType::U64
-            | FieldType::I8
-            | FieldType::I16
-            | FieldType::I32
-            | FieldType::I64
-    );
-    if is_numeric {
+    let off = f.offset as usize;
+    if let Some(load) = Load::of(f.ty) {
         let elem_size = if f.count > 0 {
             f.size / f.count as u16
         } else {
             f.size
         };
+        let is_integer = !matches!(load, Load::F32 | Load::F64);
         let add = |p: String| {
             if is_integer {
                 store.add_scalar_int(p)
@@ -203,35 +276,35 @@ fn build_field(
                 store.add_scalar(p)
             }
         };
-        if f.count == 1 {
-            let ch = add(path(""));
-            return FieldKind::Scalar {
-                ch,
-                ty: f.ty,
-                offset: f.offset,
-                size: elem_size,
-            };
-        }
-        let channels: Vec<ChannelId> = (0..f.count as usize)
-            .map(|i| add(path(&format!("[{i}]"))))
-            .collect();
-        return FieldKind::ScalarArray {
-            ty: f.ty,
-            base_offset: f.offset,
-            elem_size,
-            channels,
+        let paths: Vec<String> = if f.count == 1 {
+            vec![path("")]
+        } else {
+            (0..f.count as usize)
+                .map(|i| path(&format!("[{i}]")))
+                .collect()
         };
+        // Channels are registered even when the declared size does not
+        // match the type, so the tree still shows the field; it just never
+        // gets samples.
+        for (i, p) in paths.into_iter().enumerate() {
+            let ch = add(p);
+            if elem_size as usize == load.size() {
+                plan.push(Op::Scalar {
+                    load,
+                    off: off + i * load.size(),
+                    ch,
+                });
+            }
+        }
+        return;
     }
     if f.count != 1 {
-        return FieldKind::Ignored;
+        return;
     }
     match f.ty {
         FieldType::Bool => {
             let ch = store.add_state(path(""), &["false", "true"]);
-            FieldKind::State {
-                ch,
-                offset: f.offset,
-            }
+            plan.push(Op::State { off, ch });
         }
         FieldType::Enum => {
             let labels = schema
@@ -239,14 +312,11 @@ fn build_field(
                 .map(|v| v.iter().map(String::as_str).collect::<Vec<_>>())
                 .unwrap_or_default();
             let ch = store.add_state(path(""), &labels);
-            FieldKind::State {
-                ch,
-                offset: f.offset,
-            }
+            plan.push(Op::State { off, ch });
         }
         FieldType::Bitfield => {
             let Some(bf) = schema.bitfield(schema_id, field_index) else {
-                return FieldKind::Ignored;
+                return;
             };
             let word = match f.size {
                 1 | 2 | 4 | 8 => Some(store.add_scalar_int(path(""))),
@@ -258,62 +328,48 @@ fn build_field(
                     None
                 }
             };
-            let bits: Vec<(BitDef, ChannelId)> = bf
-                .bits
-                .iter()
-                .map(|b| {
-                    let ch = store.add_scalar_int(path(&format!(".{}", b.name)));
-                    (b.clone(), ch)
-                })
-                .collect();
-            if let Some(w) = word {
-                store.register_word_bits(w, bits.iter().map(|(_, c)| *c).collect());
+            plan.push(Op::Word {
+                off,
+                n: f.size as usize,
+                ch: word,
+            });
+            let mut bits = Vec::with_capacity(bf.bits.len());
+            for b in &bf.bits {
+                let ch = store.add_scalar_int(path(&format!(".{}", b.name)));
+                let width = b.width as u32;
+                let mask = if width >= 64 {
+                    u64::MAX
+                } else {
+                    (1u64 << width) - 1
+                };
+                let (shift, mask) = if b.start < 64 {
+                    (b.start as u32, mask)
+                } else {
+                    (0, 0)
+                };
+                plan.push(Op::Bits { shift, mask, ch });
+                bits.push(ch);
             }
-            FieldKind::Bitfield {
-                offset: f.offset,
-                storage_bytes: f.size,
-                word,
-                bits,
+            if let Some(w) = word {
+                store.register_word_bits(w, bits);
             }
         }
         FieldType::String => {
             let ch = store.add_text(path(""));
-            FieldKind::Text {
+            plan.push(Op::Text {
+                field: f.clone(),
                 ch,
-                field_def: f.clone(),
-            }
+            });
         }
-        _ => FieldKind::Ignored,
-    }
-}
-
-fn read_scalar(ty: FieldType, payload: &[u8], offset: u16, size: u16) -> Option<f64> {
-    let off = offset as usize;
-    let n = size as usize;
-    if off + n > payload.len() {
-        return None;
+        _ => {}
     }
-    let s = &payload[off..off + n];
-    Some(match ty {
-        FieldType::U8 => s[0] as f64,
-        FieldType::U16 => u16::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::U32 => u32::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::U64 => u64::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::I8 => s[0] as i8 as f64,
-        FieldType::I16 => i16::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::I32 => i32::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::I64 => i64::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::F32 => f32::from_le_bytes(s.try_into().ok()?) as f64,
-        FieldType::F64 => f64::from_le_bytes(s.try_into().ok()?),
-        _ => return None,
-    })
 }
 
 #[cfg(test)]
 mod tests {
     use super::*;
     use btelem_store::{ChannelKind, Store};
-    use btelem_wire::{BitfieldDef, FieldDef};
+    use btelem_wire::{BitDef, BitfieldDef, FieldDef};
 
     fn bitfield_schema() -> Schema {
         // One schema entry "flags" with a single u32 bitfield field "f"
@@ -344,12 +400,13 @@ mod tests {
             entries: vec![entry],
             enums: vec![],
             bitfields: vec![bf],
+            clock: None,
         }
     }
 
     #[test]
     fn bitfield_registration_records_word_to_bits_in_order() {
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let schema = bitfield_schema();
         ChannelMap::build(&schema, &store).unwrap();
 
@@ -376,4 +433,113 @@ mod tests {
 
         assert!(store.bits_for_word(bit_a).is_none());
     }
+
+    fn field(name: &str, offset: u16, size: u16, ty: FieldType, count: u8) -> FieldDef {
+        FieldDef {
+            name: name.to_owned(),
+            offset,
+            size,
+            ty,
+            count,
+        }
+    }
+
+    /// "imu" (id 2): f32 x @0, i16 v[2] @4, bool ok @8 — payload 9 bytes.
+    fn imu_schema() -> Schema {
+        let mut schema = bitfield_schema();
+        schema.entries.push(SchemaEntry {
+            id: 2,
+            name: "imu".to_owned(),
+            description: String::new(),
+            payload_size: 9,
+            fields: vec![
+                field("x", 0, 4, FieldType::F32, 1),
+                field("v", 4, 4, FieldType::I16, 2),
+                field("ok", 8, 1, FieldType::Bool, 1),
+            ],
+        });
+        schema
+    }
+
+    fn imu_payload(x: f32, v: [i16; 2], ok: bool) -> Vec<u8> {
+        let mut p = x.to_le_bytes().to_vec();
+        p.extend(v[0].to_le_bytes());
+        p.extend(v[1].to_le_bytes());
+        p.push(ok as u8);
+        p
+    }
+
+    #[test]
+    fn plan_decodes_packet_grouped_by_id() {
+        let store = InMemoryStore::new();
+        let map = ChannelMap::build(&imu_schema(), &store).unwrap();
+        let chans = store.channels();
+        let by_path = |p: &str| chans.iter().find(|c| c.path == p).expect(p).id;
+
+        let payloads: Vec<_> = (0..4i16)
+            .map(|i| imu_payload(i as f32 * 0.5, [i, -i], i % 2 == 1))
+            .collect();
+        let flags = [0b1_1001u32.to_le_bytes(), 0b0_0001u32.to_le_bytes()];
+        // IDs interleaved in the packet; per-channel order must survive.
+        let mut entries = Vec::new();
+        for (i, p) in payloads.iter().enumerate() {
+            entries.push(DecodedEntry {
+                id: 2,
+                timestamp: 10 + i as u64,
+                payload: p,
+            });
+            if i < 2 {
+                entries.push(DecodedEntry {
+                    id: 1,
+                    timestamp: 10 + i as u64,
+                    payload: &flags[i],
+                });
+            }
+        }
+        entries.push(DecodedEntry {
+            id: 9,
+            timestamp: 11,
+            payload: &[],
+        });
+
+        let mut batch = Batch::new();
+        map.dispatch_packet(&entries, None, &mut batch);
+        store.push_batch(&mut batch);
+
+        let raw = |p: &str| store.query_raw(by_path(p), 0, 100, 100);
+        assert_eq!(
+            raw("imu.x"),
+            vec![(10, 0.0), (11, 0.5), (12, 1.0), (13, 1.5)]
+        );
+        assert_eq!(
+            raw("imu.v[1]"),
+            vec![(10, 0.0), (11, -1.0), (12, -2.0), (13, -3.0)]
+        );
+        assert_eq!(store.query_state(by_path("imu.ok"), 0, 100).len(), 4);
+        assert_eq!(raw("flags.f"), vec![(10, 25.0), (11, 1.0)]);
+        assert_eq!(raw("flags.f.a"), vec![(10, 1.0), (11, 1.0)]);
+        assert_eq!(raw("flags.f.b"), vec![(10, 3.0), (11, 0.0)]);
+    }
+
+    #[test]
+    fn short_payload_keeps_the_fields_that_fit() {
+        let store = InMemoryStore::new();
+        let map = ChannelMap::build(&imu_schema(), &store).unwrap();
+        let chans = store.channels();
+        let by_path = |p: &str| chans.iter().find(|c| c.path == p).expect(p).id;
+
+        let p = imu_payload(2.0, [7, 8], true);
+        let mut batch = Batch::new();
+        map.dispatch(2, 5, &p[..6], &mut batch);
+        map.dispatch(1, 5, &[1, 0], &mut batch);
+        store.push_batch(&mut batch);
+
+        assert_eq!(store.sample_count(by_path("imu.x")), 1);
+        assert_eq!(store.sample_count(by_path("imu.v[0]")), 1);
+        assert_eq!(store.sample_count(by_path("imu.v[1]")), 0);
+        assert_eq!(store.sample_count(by_path("imu.ok")), 0);
+        // A cut-off bitfield word yields neither the word nor its bits.
+        assert_eq!(store.sample_count(by_path("flags.f")), 0);
+        assert_eq!(store.sample_count(by_path("flags.f.a")), 0);
+    }
 }
@@ -0,0 +1,412 @@
+//! Staged ingest behind a socket reader.
+//!
+//! The reader only frames packets into pooled buffers and hands them to
+//! [`Pipeline::submit`]. Decode workers turn packets into store batches in
+//! parallel, and one commit thread applies them to the store and capture
+//! in arrival order, so per-channel timestamps stay non-decreasing. The
+//! packets between the socket and the store are bounded by a byte budget;
+//! the reader only waits when the budget is spent, never on a particular
+//! stage.
+
+use std::collections::BTreeMap;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::Duration;
+
+use btelem_capture::Capture;
+use btelem_store::{Batch, InMemoryStore};
+use btelem_wire::{decode_packet, decompress_packet, Clock};
+
+use crate::{ChannelMap, IngestError};
+
+/// Default bytes of framed packets allowed between the socket and the
+/// store before the reader waits.
+pub const PIPELINE_BUDGET: usize = 64 << 20;
+
+/// Spare packet buffers and batches kept for reuse.
+const POOL_LEN: usize = 64;
+
+/// Snapshot of a source's ingest pipeline, from
+/// [`crate::SourceHandle::pipeline_stats`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct PipelineStats {
+    /// Decode worker threads.
+    pub workers: u64,
+    /// Packets framed by the reader and waiting for a decode worker.
+    pub queued: u64,
+    /// Packets decoded and waiting for the commit thread.
+    pub decoded: u64,
+    /// Bytes of packets between the socket and the store.
+    pub bytes_in_flight: u64,
+    /// Packets committed to the store since the source started.
+    pub committed: u64,
+    /// Times the reader waited for the byte budget.
+    pub reader_waits: u64,
+}
+
+/// Live counters behind [`PipelineStats`]; kept across reconnects.
+#[derive(Default)]
+pub(crate) struct Counters {
+    workers: AtomicU64,
+    queued: AtomicU64,
+    decoded: AtomicU64,
+    bytes: AtomicU64,
+    committed: AtomicU64,
+    waits: AtomicU64,
+}
+
+impl Counters {
+    pub(crate) fn snapshot(&self) -> PipelineStats {
+        PipelineStats {
+            workers: self.workers.load(Ordering::Relaxed),
+            queued: self.queued.load(Ordering::Relaxed),
+            decoded: self.decoded.load(Ordering::Relaxed),
+            bytes_in_flight: self.bytes.load(Ordering::Relaxed),
+            committed: self.committed.load(Ordering::Relaxed),
+            reader_waits: self.waits.load(Ordering::Relaxed),
+        }
+    }
+}
+
+struct Shared {
+    budget: usize,
+    in_flight: Mutex<usize>,
+    freed: Condvar,
+    buffers: Mutex<Vec<Vec<u8>>>,
+    batches: Mutex<Vec<Batch>>,
+    error: Mutex<Option<IngestError>>,
+    counters: Arc<Counters>,
+}
+
+impl Shared {
+    fn fail(&self, e: IngestError) {
+        self.error.lock().unwrap().get_or_insert(e);
+    }
+
+    /// Return a packet buffer and its share of the budget.
+    fn release(&self, buf: Vec<u8>) {
+        {
+            let mut used = self.in_flight.lock().unwrap();
+            *used -= buf.len();
+            self.counters.bytes.store(*used as u64, Ordering::Relaxed);
+        }
+        self.freed.notify_all();
+        let mut pool = self.buffers.lock().unwrap();
+        if pool.len() < POOL_LEN {
+            pool.push(buf);
+        }
+    }
+}
+
+struct Job {
+    seq: u64,
+    buf: Vec<u8>,
+    clock: Option<Clock>,
+}
+
+struct Done {
+    seq: u64,
+    buf: Vec<u8>,
+    batch: Batch,
+    ok: bool,
+}
+
+/// Decode workers to use: the cores left after the reader and the commit
+/// thread, at least one and at most four.
+pub(crate) fn default_workers() -> usize {
+    thread::available_parallelism()
+        .map_or(1, |n| n.get())
+        .saturating_sub(2)
+        .clamp(1, 4)
+}
+
+/// One connection's worth of decode workers and commit thread. Dropping
+/// it commits everything submitted so far, then joins the threads.
+pub(crate) struct Pipeline {
+    shared: Arc<Shared>,
+    jobs: Option<Sender<Job>>,
+    threads: Vec<JoinHandle<()>>,
+    seq: u64,
+}
+
+impl Pipeline {
+    pub(crate) fn start(
+        store: InMemoryStore,
+        map: ChannelMap,
+        capture: Option<Capture>,
+        counters: Arc<Counters>,
+        workers: usize,
+    ) -> Result<Self, IngestError> {
+        let workers = workers.max(1);
+        counters.workers.store(workers as u64, Ordering::Relaxed);
+        let shared = Arc::new(Shared {
+            budget: PIPELINE_BUDGET,
+            in_flight: Mutex::new(0),
+            freed: Condvar::new(),
+            buffers: Mutex::default(),
+            batches: Mutex::default(),
+            error: Mutex::default(),
+            counters,
+        });
+
+        let map = Arc::new(map);
+        let (jobs_tx, jobs_rx) = mpsc::channel::<Job>();
+        let jobs_rx = Arc::new(Mutex::new(jobs_rx));
+        let (done_tx, done_rx) = mpsc::channel::<Done>();
+        let mut threads = Vec::with_capacity(workers + 1);
+        for i in 0..workers {
+            let (shared, map) = (Arc::clone(&shared), Arc::clone(&map));
+            let (jobs, done) = (Arc::clone(&jobs_rx), done_tx.clone());
+            threads.push(
+                thread::Builder::new()
+                    .name(format!("btelem-ingest-decode-{i}"))
+                    .spawn(move || decode_worker(&shared, &map, &jobs, &done))?,
+            );
+        }
+        drop(done_tx);
+        let commit_shared = Arc::clone(&shared);
+        threads.push(
+            thread::Builder::new()
+                .name("btelem-ingest-commit".into())
+                .spawn(move || commit_loop(&commit_shared, &store, capture.as_ref(), done_rx))?,
+        );
+        Ok(Self {
+            shared,
+            jobs: Some(jobs_tx),
+            threads,
+            seq: 0,
+        })
+    }
+
+    /// A zeroed buffer for a `len`-byte packet, charged to the budget. Waits
+    /// while the budget is spent (a packet larger than the whole budget
+    /// still gets through once the pipeline is empty); `None` if `stop` is
+    /// set meanwhile.
+    pub(crate) fn buffer(&self, len: usize, stop: &AtomicBool) -> Option<Vec<u8>> {
+        let s = &self.shared;
+        let mut used = s.in_flight.lock().unwrap();
+        if *used > 0 && *used + len > s.budget {
+            s.counters.waits.fetch_add(1, Ordering::Relaxed);
+            while *used > 0 && *used + len > s.budget {
+                if stop.load(Ordering::SeqCst) {
+                    return None;
+                }
+                used = s
+                    .freed
+                    .wait_timeout(used, Duration::from_millis(100))
+                    .unwrap()
+                    .0;
+            }
+        }
+        *used += len;
+        s.counters.bytes.store(*used as u64, Ordering::Relaxed);
+        drop(used);
+        let mut buf = s.buffers.lock().unwrap().pop().unwrap_or_default();
+        buf.clear();
+        buf.resize(len, 0);
+        Some(buf)
+    }
+
+    /// Give back a buffer from [`Pipeline::buffer`] that is not submitted.
+    pub(crate) fn recycle(&self, buf: Vec<u8>) {
+        self.shared.release(buf);
+    }
+
+    /// Queue a data packet, timestamps converted with `clock` if set.
+    pub(crate) fn submit(&mut self, buf: Vec<u8>, clock: Option<Clock>) {
+        let job = Job {
+            seq: self.seq,
+            buf,
+            clock,
+        };
+        self.seq += 1;
+        self.shared.counters.queued.fetch_add(1, Ordering::Relaxed);
+        if let Some(jobs) = &self.jobs {
+            // Workers only exit once this sender is gone.
+            let _ = jobs.send(job);
+        }
+    }
+
+    /// First decode error since the pipeline started, if any.
+    pub(crate) fn take_error(&self) -> Option<IngestError> {
+        self.shared.error.lock().unwrap().take()
+    }
+}
+
+impl Drop for Pipeline {
+    fn drop(&mut self) {
+        self.jobs = None;
+        for t in self.threads.drain(..) {
+            let _ = t.join();
+        }
+    }
+}
+
+fn decode_worker(
+    shared: &Shared,
+    map: &ChannelMap,
+    jobs: &Mutex<Receiver<Job>>,
+    done: &Sender<Done>,
+) {
+    loop {
+        // Hold the receiver only while waiting; decode runs unlocked.
+        let Ok(job) = jobs.lock().unwrap().recv() else {
+            return;
+        };
+        shared.counters.queued.fetch_sub(1, Ordering::Relaxed);
+        let mut batch = shared.batches.lock().unwrap().pop().unwrap_or_default();
+        let decoded = decompress_packet(&job.buf)
+            .map_err(IngestError::from)
+            .and_then(|plain| {
+                let p = decode_packet(&plain)?;
+                map.dispatch_packet(&p.entries, job.clock, &mut batch);
+                Ok(())
+            });
+        let ok = match decoded {
+            Ok(()) => true,
+            Err(e) => {
+                shared.fail(e);
+                false
+            }
+        };
+        shared.counters.decoded.fetch_add(1, Ordering::Relaxed);
+        let d = Done {
+            seq: job.seq,
+            buf: job.buf,
+            batch,
+            ok,
+        };
+        if done.send(d).is_err() {
+            return;
+        }
+    }
+}
+
+fn commit_loop(
+    shared: &Shared,
+    store: &InMemoryStore,
+    capture: Option<&Capture>,
+    done: Receiver<Done>,
+) {
+    let mut next = 0u64;
+    let mut pending = BTreeMap::new();
+    for d in done {
+        pending.insert(d.seq, d);
+        while let Some(mut d) = pending.remove(&next) {
+            next += 1;
+            if d.ok {
+                store.push_batch(&mut d.batch);
+                if let Some(cap) = capture {
+                    let _ = cap.push_packet(&d.buf);
+                }
+                shared.counters.committed.fetch_add(1, Ordering::Relaxed);
+            }
+            shared.counters.decoded.fetch_sub(1, Ordering::Relaxed);
+            shared.release(d.buf);
+            let mut pool = shared.batches.lock().unwrap();
+            if pool.len() < POOL_LEN {
+                pool.push(d.batch);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use btelem_store::Store;
+    use btelem_wire::{FieldDef, FieldType, Schema, SchemaEntry};
+
+    /// One entry per packet: id 1, u32 `n` at offset 0.
+    fn packet(ts: u64, n: u32) -> Vec<u8> {
+        let mut p = Vec::new();
+        p.extend(1u16.to_le_bytes()); // entry_count
+        p.extend(0u16.to_le_bytes()); // flags
+        p.extend(4u32.to_le_bytes()); // payload_size
+        p.extend(0u32.to_le_bytes()); // dropped
+        p.extend(0u32.to_le_bytes()); // seq
+        p.extend(1u16.to_le_bytes()); // id
+        p.extend(4u16.to_le_bytes()); // payload size
+        p.extend(0u32.to_le_bytes()); // payload offset
+        p.extend(ts.to_le_bytes());
+        p.extend(n.to_le_bytes());
+        p
+    }
+
+    #[test]
+    fn workers_commit_in_arrival_order() {
+        let schema = Schema {
+            entries: vec![SchemaEntry {
+                id: 1,
+                name: "s".to_owned(),
+                description: String::new(),
+                payload_size: 4,
+                fields: vec![FieldDef {
+                    name: "n".to_owned(),
+                    offset: 0,
+                    size: 4,
+                    ty: FieldType::U32,
+                    count: 1,
+                }],
+            }],
+            enums: vec![],
+            bitfields: vec![],
+            clock: None,
+        };
+        let store = InMemoryStore::new();
+        let map = ChannelMap::build(&schema, &store).unwrap();
+        let capture = Capture::with_capacity(1 << 20);
+        let counters = Arc::new(Counters::default());
+        let stop = AtomicBool::new(false);
+        let mut pipe = Pipeline::start(
+            store.clone(),
+            map,
+            Some(capture.clone()),
+            Arc::clone(&counters),
+            4,
+        )
+        .unwrap();
+        for i in 0..2000u32 {
+            let bytes = packet(i as u64 + 1, i);
+            let mut buf = pipe.buffer(bytes.len(), &stop).unwrap();
+            buf.copy_from_slice(&bytes);
+            pipe.submit(buf, None);
+        }
+        drop(pipe);
+
+        let stats = counters.snapshot();
+        assert_eq!(stats.workers, 4);
+        assert_eq!(stats.committed, 2000);
+        assert_eq!(
+            (stats.queued, stats.decoded, stats.bytes_in_flight),
+            (0, 0, 0)
+        );
+        assert_eq!(capture.stats().packets, 2000);
+        let raw = store.query_raw(0, 0, u64::MAX, usize::MAX);
+        assert_eq!(raw.len(), 2000);
+        assert!(raw
+            .iter()
+            .enumerate()
+            .all(|(i, &(t, v))| t == i as u64 + 1 && v == i as f64));
+    }
+
+    #[test]
+    fn decode_errors_surface_to_the_reader() {
+        let store = InMemoryStore::new();
+        let counters = Arc::new(Counters::default());
+        let stop = AtomicBool::new(false);
+        let mut pipe = Pipeline::start(store, ChannelMap::default(), None, counters, 2).unwrap();
+        let mut buf = pipe.buffer(3, &stop).unwrap();
+        buf.copy_from_slice(&[1, 2, 3]);
+        pipe.submit(buf, None);
+        let deadline = std::time::Instant::now() + Duration::from_secs(5);
+        let mut err = None;
+        while err.is_none() && std::time::Instant::now() < deadline {
+            err = pipe.take_error();
+            thread::sleep(Duration::from_millis(1));
+        }
+        assert!(matches!(err, Some(IngestError::Wire(_))), "{err:?}");
+    }
+}
@@ -1,16 +1,24 @@
 //! TCP source: connect, decode schema, decode packets, push to store.
+//!
+//! The connection thread only reads and frames packets; decoding and the
+//! store writes run in a [`Pipeline`] so a slow store or capture never
+//! stops the socket being drained.
 
-use std::io::{ErrorKind, Read};
+use std::io::{ErrorKind, Read, Write};
 use std::net::{SocketAddr, TcpStream, ToSocketAddrs};
-use std::sync::atomic::{AtomicBool, Ordering};
-use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
 use std::thread::{self, JoinHandle};
 use std::time::Duration;
 
 use btelem_capture::Capture;
-use btelem_store::{MockStore, Store};
-use btelem_wire::{decode_packet, Schema};
+use btelem_store::{InMemoryStore, Store};
+use btelem_wire::{
+    compact_hash, decode_packet, encode_control, encode_hello, resolve_schema, Clock, Schema,
+    Subscription, CTRL_COMPRESS, CTRL_RESET, CTRL_SUBSCRIBE, MAX_SCHEMA_ENTRIES, PACKET_FLAG_CLOCK,
+};
 
+use crate::pipeline::{default_workers, Counters, Pipeline, PipelineStats};
 use crate::{ChannelMap, IngestError};
 
 /// Owned handle to a running TCP ingest thread. Drop to request shutdown
@@ -18,9 +26,49 @@ use crate::{ChannelMap, IngestError};
 pub struct SourceHandle {
     stop: Arc<AtomicBool>,
     join: Option<JoinHandle<Result<(), IngestError>>>,
+    lost: Arc<AtomicU64>,
+    subs: Option<Arc<SubState>>,
+    pipeline: Option<Arc<Counters>>,
+}
+
+/// Subscription requested through [`SourceHandle::subscribe`]; the ingest
+/// thread sends it whenever `generation` moves and after each reconnect.
+#[derive(Default)]
+pub(crate) struct SubState {
+    want: Mutex<Option<Vec<Subscription>>>,
+    generation: AtomicU64,
 }
 
 impl SourceHandle {
+    pub(crate) fn new(
+        stop: Arc<AtomicBool>,
+        join: JoinHandle<Result<(), IngestError>>,
+        lost: Arc<AtomicU64>,
+        subs: Option<Arc<SubState>>,
+        pipeline: Option<Arc<Counters>>,
+    ) -> Self {
+        Self {
+            stop,
+            join: Some(join),
+            lost,
+            subs,
+            pipeline,
+        }
+    }
+
+    /// Ask the server to send only `subs`, each ID rate-limited as given
+    /// (`None` = every ID at full rate, the state on connect). Sent within
+    /// one read timeout and re-sent after every reconnect. Returns false
+    /// for sources without a back channel (UDP).
+    pub fn subscribe(&self, subs: Option<Vec<Subscription>>) -> bool {
+        let Some(state) = &self.subs else {
+            return false;
+        };
+        *state.want.lock().unwrap() = subs;
+        state.generation.fetch_add(1, Ordering::SeqCst);
+        true
+    }
+
     /// Block until the ingest thread exits.
     pub fn join(mut self) -> Result<(), IngestError> {
         self.stop.store(true, Ordering::SeqCst);
@@ -34,6 +82,18 @@ impl SourceHandle {
     pub fn is_alive(&self) -> bool {
         self.join.as_ref().is_some_and(|h| !h.is_finished())
     }
+
+    /// Datagrams missing from the sequence so far (UDP sources; always 0
+    /// over TCP, where the producer's `dropped` count covers loss).
+    pub fn lost(&self) -> u64 {
+        self.lost.load(Ordering::Relaxed)
+    }
+
+    /// Queue depths and totals of the decode pipeline (TCP sources; `None`
+    /// for UDP, which decodes on its receive thread).
+    pub fn pipeline_stats(&self) -> Option<PipelineStats> {
+        self.pipeline.as_ref().map(|c| c.snapshot())
+    }
 }
 
 impl Drop for SourceHandle {
@@ -59,11 +119,16 @@ impl TcpSource {
     /// stale channel IDs don't conflict with the new schema. The thread
     /// exits only when the [`SourceHandle`] is dropped.
     ///
+    /// Each connection opens with a HELLO carrying the hash of the schema
+    /// from the previous connection, so a server that supports it skips
+    /// resending an unchanged schema on reconnect. It then asks for
+    /// compressed packets, which older servers ignore.
+    ///
     /// If `capture` is `Some`, the schema blob and every raw packet are
     /// also pushed into it for later `.btlm` saving.
     pub fn connect(
         addr: impl ToSocketAddrs,
-        store: MockStore,
+        store: InMemoryStore,
         capture: Option<Capture>,
     ) -> Result<SourceHandle, IngestError> {
         let resolved: Vec<SocketAddr> = addr.to_socket_addrs()?.collect();
@@ -77,42 +142,66 @@ impl TcpSource {
         // Initial connect synchronously so the caller learns whether the
         // endpoint is reachable. Subsequent reconnects happen in the
         // background.
-        let (stream, schema_buf, map) = connect_once(&resolved, &store)?;
+        let (stream, schema_buf, map, clock) = connect_once(&resolved, &store, None)?;
         if let Some(cap) = &capture {
-            cap.set_schema(schema_buf);
+            cap.set_schema(schema_buf.clone());
         }
 
         let stop = Arc::new(AtomicBool::new(false));
-        let stop_thread = Arc::clone(&stop);
+        let subs = Arc::new(SubState::default());
+        let counters = Arc::new(Counters::default());
+        let (stop_thread, subs_thread) = (Arc::clone(&stop), Arc::clone(&subs));
+        let counters_thread = Arc::clone(&counters);
         let join = thread::Builder::new()
             .name("btelem-ingest-tcp".into())
-            .spawn(move || run_with_reconnect(resolved, stream, store, map, capture, stop_thread))?;
+            .spawn(move || {
+                let cfg = Reconnect {
+                    addrs: resolved,
+                    store,
+                    capture,
+                    stop: stop_thread,
+                    subs: subs_thread,
+                    counters: counters_thread,
+                };
+                run_with_reconnect(cfg, stream, schema_buf, map, clock)
+            })?;
 
-        Ok(SourceHandle {
+        Ok(SourceHandle::new(
             stop,
-            join: Some(join),
-        })
+            join,
+            Arc::new(AtomicU64::new(0)),
+            Some(subs),
+            Some(counters),
+        ))
     }
 }
 
 /// Perform a single connect + schema read. Used both for the initial
-/// connection and for each reconnect attempt.
+/// connection and for each reconnect attempt. `cached` is the schema blob
+/// from the previous connection, used if the server reports it unchanged.
+/// Also returns the schema's tick calibration, if the producer logs raw
+/// counter ticks.
 fn connect_once(
     addrs: &[SocketAddr],
-    store: &MockStore,
-) -> Result<(TcpStream, Vec<u8>, ChannelMap), IngestError> {
+    store: &InMemoryStore,
+    cached: Option<&[u8]>,
+) -> Result<(TcpStream, Vec<u8>, ChannelMap, Option<Clock>), IngestError> {
     let mut last_err: Option<IngestError> = None;
     for a in addrs {
         match TcpStream::connect_timeout(a, Duration::from_secs(2)) {
             Ok(s) => {
                 s.set_read_timeout(Some(Duration::from_millis(250)))?;
                 let mut stream = s;
+                let hash = cached.and_then(compact_hash).unwrap_or(0);
+                stream.write_all(&encode_hello(hash))?;
+                stream.write_all(&encode_control(CTRL_COMPRESS, &[]))?;
                 let schema_len = read_u32(&mut stream)? as usize;
-                let mut buf = vec![0u8; schema_len];
-                read_exact_or_eof(&mut stream, &mut buf)?;
+                let mut msg = vec![0u8; schema_len];
+                read_exact_or_eof(&mut stream, &mut msg)?;
+                let buf = resolve_schema(msg, cached)?;
                 let schema = Schema::decode(&buf)?;
                 let map = ChannelMap::build(&schema, store)?;
-                return Ok((stream, buf, map));
+                return Ok((stream, buf, map, schema.clock));
             }
             Err(e) => last_err = Some(IngestError::Io(e)),
         }
@@ -122,27 +211,53 @@ fn connect_once(
     }))
 }
 
+/// Everything the background thread keeps across reconnects: where to
+/// connect, where decoded samples go, and the state shared with the
+/// [`SourceHandle`].
+struct Reconnect {
+    addrs: Vec<SocketAddr>,
+    store: InMemoryStore,
+    capture: Option<Capture>,
+    stop: Arc<AtomicBool>,
+    subs: Arc<SubState>,
+    counters: Arc<Counters>,
+}
+
 /// Drive the packet loop on the current connection, and on disconnect
 /// keep reconnecting until `stop` is set. The store and capture are
 /// cleared on each reconnect so a new schema doesn't collide with
 /// previously registered channels.
 fn run_with_reconnect(
-    addrs: Vec<SocketAddr>,
+    cfg: Reconnect,
     stream: TcpStream,
-    store: MockStore,
+    mut schema_blob: Vec<u8>,
     map: ChannelMap,
-    capture: Option<Capture>,
-    stop: Arc<AtomicBool>,
+    clock: Option<Clock>,
 ) -> Result<(), IngestError> {
+    let Reconnect {
+        addrs,
+        store,
+        capture,
+        stop,
+        subs,
+        counters,
+    } = cfg;
     // Initial session uses the already-connected stream + map.
-    if let Err(e) = packet_loop(stream, &store, &map, &capture, &stop) {
+    let workers = default_workers();
+    let pipe = Pipeline::start(
+        store.clone(),
+        map,
+        capture.clone(),
+        Arc::clone(&counters),
+        workers,
+    )?;
+    if let Err(e) = packet_loop(stream, pipe, clock, &capture, &stop, &subs) {
         if stop.load(Ordering::SeqCst) {
             return Ok(());
         }
         // Anything other than a clean shutdown falls through to retry.
         let _ = e;
     }
-    drop(map); // schema may change across reboots
 
     let mut delay_ms: u64 = 250;
     while !stop.load(Ordering::SeqCst) {
@@ -164,13 +279,21 @@ fn run_with_reconnect(
             cap.clear();
         }
 
-        match connect_once(&addrs, &store) {
-            Ok((s, schema_buf, m)) => {
+        match connect_once(&addrs, &store, Some(&schema_blob)) {
+            Ok((s, schema_buf, m, clock)) => {
                 if let Some(cap) = &capture {
-                    cap.set_schema(schema_buf);
+                    cap.set_schema(schema_buf.clone());
                 }
+                schema_blob = schema_buf;
                 delay_ms = 250;
-                if let Err(e) = packet_loop(s, &store, &m, &capture, &stop) {
+                let pipe = Pipeline::start(
+                    store.clone(),
+                    m,
+                    capture.clone(),
+                    Arc::clone(&counters),
+                    workers,
+                )?;
+                if let Err(e) = packet_loop(s, pipe, clock, &capture, &stop, &subs) {
                     if stop.load(Ordering::SeqCst) {
                         return Ok(());
                     }
@@ -186,15 +309,44 @@ fn run_with_reconnect(
     Ok(())
 }
 
+/// RESET followed by the wanted set, split so no message exceeds
+/// `BTELEM_CTRL_MAX_SIZE`. `Some(empty)` leaves nothing subscribed.
+fn control_bytes(want: &Option<Vec<Subscription>>) -> Vec<u8> {
+    let mut msg = encode_control(CTRL_RESET, &[]);
+    if let Some(list) = want {
+        if list.is_empty() {
+            msg.extend(encode_control(CTRL_SUBSCRIBE, &[]));
+        }
+        for chunk in list.chunks(MAX_SCHEMA_ENTRIES) {
+            msg.extend(encode_control(CTRL_SUBSCRIBE, chunk));
+        }
+    }
+    msg
+}
+
+/// Read packets until the connection ends or `stop` is set. Clock updates
+/// are applied here, in stream order, and every data packet goes to `pipe`
+/// tagged with the clock in force; dropping `pipe` on return commits what
+/// is queued before any reconnect clears the store.
 fn packet_loop(
     mut stream: TcpStream,
-    store: &MockStore,
-    map: &ChannelMap,
+    mut pipe: Pipeline,
+    mut clock: Option<Clock>,
     capture: &Option<Capture>,
     stop: &Arc<AtomicBool>,
+    subs: &SubState,
 ) -> Result<(), IngestError> {
-    let mut pkt = Vec::new();
+    // A fresh connection streams every ID, which is what generation 0 means.
+    let mut applied = 0u64;
     while !stop.load(Ordering::SeqCst) {
+        if let Some(e) = pipe.take_error() {
+            return Err(e);
+        }
+        let generation = subs.generation.load(Ordering::SeqCst);
+        if generation != applied {
+            stream.write_all(&control_bytes(&subs.want.lock().unwrap()))?;
+            applied = generation;
+        }
         let len = match read_u32(&mut stream) {
             Ok(n) => n as usize,
             Err(IngestError::Closed) => return Err(IngestError::Closed),
@@ -205,14 +357,28 @@ fn packet_loop(
             }
             Err(e) => return Err(e),
         };
-        pkt.resize(len, 0);
+        let Some(mut pkt) = pipe.buffer(len, stop) else {
+            break;
+        };
         read_exact_or_eof(&mut stream, &mut pkt)?;
-        let p = decode_packet(&pkt)?;
-        for e in &p.entries {
-            map.dispatch(e.id, e.timestamp, e.payload, store);
+        let flags = pkt
+            .get(2..4)
+            .map_or(0, |f| u16::from_le_bytes([f[0], f[1]]));
+        if flags & PACKET_FLAG_CLOCK == 0 {
+            pipe.submit(pkt, clock);
+            continue;
         }
-        if let Some(cap) = capture {
-            let _ = cap.push_packet(pkt.clone());
+        // Calibration refresh: use it from here on, and fold it into
+        // the captured schema rather than storing an entry-less packet.
+        let refreshed = decode_packet(&pkt)?.clock;
+        pipe.recycle(pkt);
+        if let Some(c) = refreshed {
+            clock = Some(c);
+            if let Some(mut blob) = capture.as_ref().and_then(Capture::schema) {
+                if c.patch_schema_blob(&mut blob) {
+                    capture.as_ref().unwrap().set_schema(blob);
+                }
+            }
         }
     }
     Ok(())
@@ -0,0 +1,226 @@
+//! UDP source: receive binary datagrams from `btelem_serve_udp_binary`.
+
+use std::io::ErrorKind;
+use std::net::{ToSocketAddrs, UdpSocket};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
+use std::thread;
+use std::time::Duration;
+
+use btelem_capture::Capture;
+use btelem_store::{Batch, InMemoryStore, Store};
+use btelem_wire::{
+    decode_packet, decompress_packet, Clock, Schema, PACKET_HEADER_SIZE, SCHEMA_FRAG_HEADER_SIZE,
+};
+
+use crate::{ChannelMap, IngestError, SourceHandle};
+
+/// Binary UDP ingest source.
+pub struct UdpSource;
+
+impl UdpSource {
+    /// Bind `addr` and spawn a background thread that decodes datagrams
+    /// into `store`. Returns as soon as the socket is bound.
+    ///
+    /// Channels are registered when the first complete schema arrives; the
+    /// sender repeats it about once a second, so data before that is
+    /// discarded. If a different schema shows up later (sender restarted
+    /// with another build) the store and capture are cleared, as on a TCP
+    /// reconnect. Gaps in the datagram sequence number are counted in
+    /// [`SourceHandle::lost`].
+    ///
+    /// If `capture` is `Some`, the schema blob and every data packet are
+    /// also pushed into it for later `.btlm` saving.
+    pub fn bind(
+        addr: impl ToSocketAddrs,
+        store: InMemoryStore,
+        capture: Option<Capture>,
+    ) -> Result<SourceHandle, IngestError> {
+        let sock = UdpSocket::bind(addr)?;
+        sock.set_read_timeout(Some(Duration::from_millis(250)))?;
+
+        let stop = Arc::new(AtomicBool::new(false));
+        let lost = Arc::new(AtomicU64::new(0));
+        let (stop_thread, lost_thread) = (Arc::clone(&stop), Arc::clone(&lost));
+        let join = thread::Builder::new()
+            .name("btelem-ingest-udp".into())
+            .spawn(move || recv_loop(sock, store, capture, stop_thread, lost_thread))?;
+
+        Ok(SourceHandle::new(stop, join, lost, None, None))
+    }
+}
+
+fn recv_loop(
+    sock: UdpSocket,
+    store: InMemoryStore,
+    capture: Option<Capture>,
+    stop: Arc<AtomicBool>,
+    lost: Arc<AtomicU64>,
+) -> Result<(), IngestError> {
+    let mut buf = vec![0u8; 65536];
+    let mut next_seq: Option<u32> = None;
+    let mut frags = Reassembly::default();
+    let mut schema_blob = Vec::new();
+    let mut map: Option<ChannelMap> = None;
+    let mut clock: Option<Clock> = None;
+    let mut batch = Batch::new();
+
+    while !stop.load(Ordering::SeqCst) {
+        let n = match sock.recv(&mut buf) {
+            Ok(n) => n,
+            Err(e)
+                if e.kind() == ErrorKind::WouldBlock
+                    || e.kind() == ErrorKind::TimedOut
+                    || e.kind() == ErrorKind::Interrupted =>
+            {
+                continue;
+            }
+            Err(e) => return Err(IngestError::Io(e)),
+        };
+        let dgram = &buf[..n];
+        // A malformed datagram is just lost; the next one stands alone.
+        let Ok(plain) = decompress_packet(dgram) else {
+            continue;
+        };
+        let Ok(p) = decode_packet(&plain) else {
+            continue;
+        };
+
+        let seq = p.header.seq;
+        if let Some(want) = next_seq {
+            let gap = seq.wrapping_sub(want);
+            if gap < 0x8000_0000 {
+                // otherwise reordered, or the sender restarted
+                lost.fetch_add(u64::from(gap), Ordering::Relaxed);
+            }
+        }
+        next_seq = Some(seq.wrapping_add(1));
+
+        if p.header.is_schema() {
+            let Some(blob) = frags.push(dgram, p.header.payload_size as usize) else {
+                continue;
+            };
+            if blob == schema_blob {
+                continue; // periodic resend
+            }
+            let Ok(schema) = Schema::decode(&blob) else {
+                continue;
+            };
+            if map.is_some() {
+                store.clear();
+                if let Some(cap) = &capture {
+                    cap.clear();
+                }
+            }
+            map = Some(ChannelMap::build(&schema, &store)?);
+            clock = schema.clock;
+            if let Some(cap) = &capture {
+                cap.set_schema(blob.clone());
+            }
+            schema_blob = blob;
+            continue;
+        }
+
+        let Some(map) = &map else {
+            continue;
+        };
+        if p.header.is_clock() {
+            if let Some(c) = p.clock {
+                clock = Some(c);
+                if let Some(cap) = &capture {
+                    if let Some(mut blob) = cap.schema() {
+                        if c.patch_schema_blob(&mut blob) {
+                            cap.set_schema(blob);
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+        map.dispatch_packet(&p.entries, clock, &mut batch);
+        store.push_batch(&mut batch);
+        if let Some(cap) = &capture {
+            let _ = cap.push_packet(dgram);
+        }
+    }
+    Ok(())
+}
+
+/// Schema fragments in arrival order. Fragments must arrive contiguously
+/// from offset 0; any gap discards the partial blob until the next resend.
+#[derive(Default)]
+struct Reassembly {
+    buf: Vec<u8>,
+    total: usize,
+}
+
+impl Reassembly {
+    /// Add the fragment in `dgram`; returns the whole blob once complete.
+    fn push(&mut self, dgram: &[u8], payload_size: usize) -> Option<Vec<u8>> {
+        let body = dgram.get(PACKET_HEADER_SIZE..PACKET_HEADER_SIZE + payload_size)?;
+        if body.len() < SCHEMA_FRAG_HEADER_SIZE {
+            return None;
+        }
+        let total = u32::from_le_bytes(body[0..4].try_into().ok()?) as usize;
+        let offset = u32::from_le_bytes(body[4..8].try_into().ok()?) as usize;
+        if offset == 0 {
+            self.buf.clear();
+            self.total = total;
+        }
+        if total != self.total || offset != self.buf.len() {
+            self.buf.clear();
+            self.total = 0;
+            return None;
+        }
+        self.buf.extend_from_slice(&body[SCHEMA_FRAG_HEADER_SIZE..]);
+        if self.buf.len() < total {
+            return None;
+        }
+        self.total = 0;
+        Some(std::mem::take(&mut self.buf))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use btelem_wire::PACKET_FLAG_SCHEMA;
+
+    fn frag(total: u32, offset: u32, bytes: &[u8]) -> Vec<u8> {
+        let mut d = Vec::new();
+        d.extend_from_slice(&0u16.to_le_bytes());
+        d.extend_from_slice(&PACKET_FLAG_SCHEMA.to_le_bytes());
+        d.extend_from_slice(&((SCHEMA_FRAG_HEADER_SIZE + bytes.len()) as u32).to_le_bytes());
+        d.extend_from_slice(&[0u8; 8]);
+        d.extend_from_slice(&total.to_le_bytes());
+        d.extend_from_slice(&offset.to_le_bytes());
+        d.extend_from_slice(bytes);
+        d
+    }
+
+    fn push(r: &mut Reassembly, d: &[u8]) -> Option<Vec<u8>> {
+        let p = decode_packet(d).unwrap();
+        r.push(d, p.header.payload_size as usize)
+    }
+
+    #[test]
+    fn reassembles_in_order_fragments() {
+        let mut r = Reassembly::default();
+        assert_eq!(push(&mut r, &frag(6, 0, b"abc")), None);
+        assert_eq!(push(&mut r, &frag(6, 3, b"def")), Some(b"abcdef".to_vec()));
+    }
+
+    #[test]
+    fn gap_discards_until_next_start() {
+        let mut r = Reassembly::default();
+        assert_eq!(push(&mut r, &frag(9, 0, b"abc")), None);
+        assert_eq!(push(&mut r, &frag(9, 6, b"ghi")), None); // lost 3..6
+        assert_eq!(push(&mut r, &frag(9, 3, b"def")), None);
+        assert_eq!(push(&mut r, &frag(9, 0, b"abc")), None);
+        assert_eq!(push(&mut r, &frag(9, 3, b"def")), None);
+        assert_eq!(
+            push(&mut r, &frag(9, 6, b"ghi")),
+            Some(b"abcdefghi".to_vec())
+        );
+    }
+}
@@ -8,7 +8,8 @@ use std::thread;
 use std::time::Duration;
 
 use btelem_ingest::TcpSource;
-use btelem_store::{ChannelKind, MockStore, Store};
+use btelem_store::{ChannelKind, InMemoryStore, Store};
+use btelem_wire::Subscription;
 
 fn server_path() -> Option<PathBuf> {
     let mut p = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
@@ -53,7 +54,7 @@ fn counter_server_round_trip() {
     let child = ChildGuard(cmd.spawn().expect("spawn server"));
 
     let addr = format!("127.0.0.1:{port}");
-    let store = MockStore::new();
+    let store = InMemoryStore::new();
     let mut handle = None;
     for _ in 0..40 {
         thread::sleep(Duration::from_millis(50));
@@ -99,6 +100,60 @@ fn counter_server_round_trip() {
         }
     }
 
+    let stats = handle
+        .pipeline_stats()
+        .expect("tcp sources expose pipeline stats");
+    assert!(stats.workers >= 1);
+    assert!(stats.committed > 0, "{stats:?}");
+    assert!(stats.bytes_in_flight as usize <= btelem_ingest::PIPELINE_BUDGET);
+
     drop(handle);
     drop(child);
 }
+
+#[test]
+fn subscription_decimates_counter_stream() {
+    let Some(server) = server_path() else {
+        eprintln!("skipped: btelem_test_counter_server not built (run `make build`)");
+        return;
+    };
+
+    // 1000 entries at 1 kHz; subscribed at 20 Hz we expect ~20 per channel.
+    let port = pick_port();
+    let mut cmd = Command::new(&server);
+    cmd.arg(port.to_string())
+        .arg("1000")
+        .arg("1000")
+        .stdout(Stdio::null())
+        .stderr(Stdio::null());
+    let mut child = ChildGuard(cmd.spawn().expect("spawn server"));
+
+    let addr = format!("127.0.0.1:{port}");
+    let store = InMemoryStore::new();
+    let mut handle = None;
+    for _ in 0..40 {
+        thread::sleep(Duration::from_millis(50));
+        if let Ok(h) = TcpSource::connect(&addr, store.clone(), None) {
+            handle = Some(h);
+            break;
+        }
+    }
+    let handle = handle.expect("connect to counter server");
+    // The server idles 500ms before producing, so this lands first.
+    assert!(handle.subscribe(Some(vec![Subscription::at_rate(0, 20.0)])));
+
+    // Count as soon as the server exits: it lingers 200ms after the last
+    // entry, and the reconnect that follows clears the store.
+    while child.0.try_wait().expect("server status").is_none() {
+        thread::sleep(Duration::from_millis(20));
+    }
+
+    let chs = store.channels();
+    assert_eq!(chs.len(), 8);
+    for c in &chs {
+        let n = store.sample_count(c.id);
+        assert!((5..=60).contains(&n), "channel {}: {n} samples", c.path);
+    }
+
+    drop(handle);
+}
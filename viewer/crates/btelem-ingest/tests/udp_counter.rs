@@ -0,0 +1,89 @@
+//! Integration test: binary UDP ingest from `btelem_test_counter_server --udp`.
+//!
+//! Skipped if the binary isn't built (CI must `make build` first).
+
+use std::path::PathBuf;
+use std::process::{Child, Command, Stdio};
+use std::thread;
+use std::time::Duration;
+
+use btelem_ingest::UdpSource;
+use btelem_store::{ChannelKind, InMemoryStore, Store};
+
+fn server_path() -> Option<PathBuf> {
+    let mut p = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+    for _ in 0..5 {
+        let candidate = p.join("build/btelem_test_counter_server");
+        if candidate.is_file() {
+            return Some(candidate);
+        }
+        if !p.pop() {
+            break;
+        }
+    }
+    None
+}
+
+fn pick_port() -> u16 {
+    let s = std::net::UdpSocket::bind("127.0.0.1:0").unwrap();
+    s.local_addr().unwrap().port()
+}
+
+struct ChildGuard(Child);
+impl Drop for ChildGuard {
+    fn drop(&mut self) {
+        let _ = self.0.kill();
+        let _ = self.0.wait();
+    }
+}
+
+#[test]
+fn counter_server_udp_round_trip() {
+    let Some(server) = server_path() else {
+        eprintln!("skipped: btelem_test_counter_server not built (run `make build`)");
+        return;
+    };
+
+    let port = pick_port();
+    let store = InMemoryStore::new();
+    let handle = UdpSource::bind(("127.0.0.1", port), store.clone(), None).expect("bind");
+
+    // Throttled so loopback never overruns the socket buffer.
+    let mut cmd = Command::new(&server);
+    cmd.arg("--udp")
+        .arg(port.to_string())
+        .arg("20000")
+        .arg("20000")
+        .stdout(Stdio::null())
+        .stderr(Stdio::null());
+    let child = ChildGuard(cmd.spawn().expect("spawn server"));
+
+    let deadline = std::time::Instant::now() + Duration::from_secs(5);
+    let mut bounds = None;
+    while std::time::Instant::now() < deadline {
+        if let Some(b) = store.time_bounds() {
+            if b.1 > b.0 {
+                bounds = Some(b);
+                break;
+            }
+        }
+        thread::sleep(Duration::from_millis(50));
+    }
+    assert!(bounds.is_some(), "no samples ingested");
+
+    let chs = store.channels();
+    assert_eq!(
+        chs.len(),
+        8,
+        "expected 8 scalar channels, got {}",
+        chs.len()
+    );
+    for c in &chs {
+        assert!(c.path.starts_with("counters.c["), "path: {}", c.path);
+        assert_eq!(c.kind, ChannelKind::Scalar);
+    }
+    assert_eq!(handle.lost(), 0, "datagrams lost on loopback");
+
+    drop(handle);
+    drop(child);
+}
@@ -5,7 +5,11 @@
 //! The whole crate revolves around the [`Store`] trait. Implementations:
 //!
 //! * [`MockStore`] — scriptable, in-process, used by viewer tests.
-//! * `InMemoryStore` (added in a later phase) — production store fed by ingest.
+//! * [`InMemoryStore`] — production store fed by ingest: chunked columns
+//!   with a min/max LOD pyramid, locked per channel.
+//!
+//! [`TileCache`] sits on the viewer side of the trait and keeps
+//! `query_scalar` results per time tile between frames.
 //!
 //! Numeric channels collapse to `f64`. Bool / enum / bitfield channels are
 //! exposed as [`ChannelKind::State`] with a label table.
@@ -14,8 +18,12 @@
 
 use std::sync::Arc;
 
+mod memory;
 mod mock;
+mod tiles;
+pub use memory::{Batch, InMemoryStore};
 pub use mock::MockStore;
+pub use tiles::{TileCache, TileStats, TILE_BUCKETS};
 
 /// Stable identifier for a channel within a session.
 ///
@@ -73,6 +81,20 @@ pub struct StateRun {
     pub value: u32,
 }
 
+/// What a cache needs to know about one scalar channel's data; see
+/// [`Store::scalar_extent`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ScalarExtent {
+    /// Changes whenever earlier answers for `ch` may no longer hold other
+    /// than by appending, e.g. after [`Store::clear`] reuses channel IDs.
+    pub epoch: u64,
+    /// Samples held; grows as samples are appended.
+    pub samples: u64,
+    /// Newest sample time. Samples only arrive at or after it, so queries
+    /// over ranges ending at or before it stay valid until `epoch` moves.
+    pub t_last: Option<Timestamp>,
+}
+
 /// The viewer ↔ data-source contract.
 ///
 /// All methods are pull-style and must be cheap (target: well under 1 ms for
@@ -174,6 +196,20 @@ pub trait Store: Send + Sync {
         Some((lo as f64, hi as f64))
     }
 
+    /// Change stamp of scalar channel `ch`, for caches of
+    /// [`Store::query_scalar`] results (see [`TileCache`]). Cheap (O(1)).
+    ///
+    /// Default impl uses the store revision as the epoch and reports no
+    /// `t_last`, which makes every change invalidate everything; stores
+    /// that only append should override.
+    fn scalar_extent(&self, ch: ChannelId) -> ScalarExtent {
+        ScalarExtent {
+            epoch: self.revision(),
+            samples: self.sample_count(ch),
+            t_last: None,
+        }
+    }
+
     /// Text samples in `[t0, t1)`, capped at `max_samples`.
     ///
     /// Returned pairs are sorted by timestamp ascending. For channels
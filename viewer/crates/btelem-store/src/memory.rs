@@ -0,0 +1,879 @@
+//! Production [`Store`] fed by ingest.
+//!
+//! Scalar samples go into append-only per-channel columns of `(t, v)`
+//! chunks, so history never reallocates or moves. Each column also keeps
+//! a min/max pyramid: level `l` holds one [`Bucket`] per `FANOUT^l`
+//! consecutive samples, extended as samples arrive. `query_scalar` covers
+//! the requested range with the coarsest complete buckets that fit inside
+//! it and merges those into the output buckets, so its cost follows
+//! `max_buckets`, not the length of the history.
+//!
+//! Every channel has its own lock and the channel table is only written
+//! when channels are registered, so a query on one channel never waits on
+//! ingest into another, and on its own channel only for one push. Ingest
+//! stages each packet in a [`Batch`] and commits it with one lock per
+//! touched channel.
+
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, RwLock};
+
+use crate::{
+    Bucket, ChannelId, ChannelInfo, ChannelKind, ScalarExtent, StateRun, Store, TimeRange,
+    Timestamp,
+};
+
+/// Samples per column chunk.
+const CHUNK_LEN: usize = 4096;
+
+/// Samples (or lower-level buckets) summarised by one pyramid bucket.
+const FANOUT: usize = 16;
+
+#[derive(Default)]
+struct Chunk {
+    t: Vec<Timestamp>,
+    v: Vec<f64>,
+}
+
+/// Scalar samples of one channel plus their min/max pyramid.
+#[derive(Default)]
+struct Column {
+    chunks: Vec<Chunk>,
+    len: usize,
+    /// `levels[l - 1][k]` covers samples `k * FANOUT^l .. (k + 1) * FANOUT^l`;
+    /// the last bucket of a level may still be filling. Level `l` exists
+    /// once there are more than `FANOUT^l` samples.
+    levels: Vec<Vec<Bucket>>,
+    min: f64,
+    max: f64,
+}
+
+impl Column {
+    fn t(&self, i: usize) -> Timestamp {
+        self.chunks[i / CHUNK_LEN].t[i % CHUNK_LEN]
+    }
+
+    fn v(&self, i: usize) -> f64 {
+        self.chunks[i / CHUNK_LEN].v[i % CHUNK_LEN]
+    }
+
+    /// Index of the first sample with `t >= target`.
+    fn lower_bound(&self, target: Timestamp) -> usize {
+        let c = self
+            .chunks
+            .partition_point(|ch| ch.t.last().is_some_and(|&t| t < target));
+        match self.chunks.get(c) {
+            Some(ch) => c * CHUNK_LEN + ch.t.partition_point(|&t| t < target),
+            None => self.len,
+        }
+    }
+
+    fn push(&mut self, t: Timestamp, v: f64) {
+        if self.len.is_multiple_of(CHUNK_LEN) {
+            self.chunks.push(Chunk {
+                t: Vec::with_capacity(CHUNK_LEN),
+                v: Vec::with_capacity(CHUNK_LEN),
+            });
+        }
+        let chunk = self.chunks.last_mut().expect("chunk just ensured");
+        chunk.t.push(t);
+        chunk.v.push(v);
+        let i = self.len;
+        self.len += 1;
+        if i == 0 {
+            (self.min, self.max) = (v, v);
+        } else {
+            self.min = self.min.min(v);
+            self.max = self.max.max(v);
+        }
+
+        let mut span = FANOUT;
+        for level in &mut self.levels {
+            let k = i / span;
+            match level.get_mut(k) {
+                Some(b) => {
+                    b.min = b.min.min(v);
+                    b.max = b.max.max(v);
+                }
+                None => level.push(Bucket { t, min: v, max: v }),
+            }
+            span *= FANOUT;
+        }
+        if self.len > span {
+            self.add_level();
+        }
+    }
+
+    /// Build the next pyramid level from the one below it (or the samples).
+    fn add_level(&mut self) {
+        let level: Vec<Bucket> = match self.levels.last() {
+            Some(below) => below.chunks(FANOUT).map(merge).collect(),
+            None => (0..self.len)
+                .step_by(FANOUT)
+                .map(|s| {
+                    let mut b = self.sample(s);
+                    for i in s + 1..(s + FANOUT).min(self.len) {
+                        let v = self.v(i);
+                        b.min = b.min.min(v);
+                        b.max = b.max.max(v);
+                    }
+                    b
+                })
+                .collect(),
+        };
+        self.levels.push(level);
+    }
+
+    fn sample(&self, i: usize) -> Bucket {
+        let v = self.v(i);
+        Bucket {
+            t: self.t(i),
+            min: v,
+            max: v,
+        }
+    }
+
+    /// Call `f` with buckets that exactly cover samples `lo..hi`, in order,
+    /// using complete buckets of level `max_level` at most. Returns how
+    /// many it produced.
+    fn cover(&self, lo: usize, hi: usize, max_level: usize, mut f: impl FnMut(Bucket)) -> usize {
+        let mut n = 0;
+        let mut i = lo;
+        while i < hi {
+            let (mut l, mut span) = (0, 1);
+            while l < max_level && i.is_multiple_of(span * FANOUT) && i + span * FANOUT <= hi {
+                l += 1;
+                span *= FANOUT;
+            }
+            f(if l == 0 {
+                self.sample(i)
+            } else {
+                self.levels[l - 1][i / span]
+            });
+            i += span;
+            n += 1;
+        }
+        n
+    }
+
+    /// Coarsest level with at least `max_buckets` buckets across `n` samples.
+    fn level_for(&self, n: usize, max_buckets: usize) -> usize {
+        let (mut l, mut span) = (0, FANOUT);
+        while l < self.levels.len() && span.saturating_mul(max_buckets) <= n {
+            l += 1;
+            span = span.saturating_mul(FANOUT);
+        }
+        l
+    }
+}
+
+fn merge(bs: &[Bucket]) -> Bucket {
+    let mut out = bs[0];
+    for b in &bs[1..] {
+        out.min = out.min.min(b.min);
+        out.max = out.max.max(b.max);
+    }
+    out
+}
+
+/// All data of one channel. Like [`crate::MockStore`], any kind of sample
+/// may be pushed to any channel; queries read the matching column.
+#[derive(Default)]
+struct Data {
+    scalars: Column,
+    states: Vec<StateRun>,
+    state_bounds: (u32, u32),
+    texts: Vec<(Timestamp, String)>,
+}
+
+impl Data {
+    fn push_state(&mut self, t: Timestamp, value: u32) {
+        match self.states.last_mut() {
+            Some(last) if last.value == value => last.t_end = t,
+            last => {
+                if let Some(last) = last {
+                    last.t_end = t;
+                }
+                self.states.push(StateRun {
+                    t_start: t,
+                    t_end: t,
+                    value,
+                });
+                let (lo, hi) = self.state_bounds;
+                self.state_bounds = if self.states.len() == 1 {
+                    (value, value)
+                } else {
+                    (lo.min(value), hi.max(value))
+                };
+            }
+        }
+    }
+}
+
+struct Channel {
+    info: ChannelInfo,
+    data: RwLock<Data>,
+}
+
+#[derive(Default)]
+struct Registry {
+    channels: Vec<Arc<Channel>>,
+    word_to_bits: HashMap<ChannelId, Vec<ChannelId>>,
+}
+
+struct Shared {
+    registry: RwLock<Registry>,
+    revision: AtomicU64,
+    /// Bumped by `clear`, which reuses channel IDs.
+    epoch: AtomicU64,
+    t_min: AtomicU64,
+    t_max: AtomicU64,
+}
+
+impl Default for Shared {
+    fn default() -> Self {
+        Self {
+            registry: RwLock::default(),
+            revision: AtomicU64::new(0),
+            epoch: AtomicU64::new(0),
+            t_min: AtomicU64::new(u64::MAX),
+            t_max: AtomicU64::new(0),
+        }
+    }
+}
+
+#[derive(Default)]
+struct Staged {
+    scalars: Vec<(Timestamp, f64)>,
+    states: Vec<(Timestamp, u32)>,
+    texts: Vec<(Timestamp, String)>,
+    bounds: TimeRange,
+}
+
+impl Staged {
+    fn is_empty(&self) -> bool {
+        self.scalars.is_empty() && self.states.is_empty() && self.texts.is_empty()
+    }
+
+    fn stage(&mut self, t: Timestamp) -> bool {
+        let first = self.is_empty();
+        self.bounds = if first {
+            (t, t)
+        } else {
+            (self.bounds.0.min(t), self.bounds.1.max(t))
+        };
+        first
+    }
+
+    fn clear(&mut self) {
+        self.scalars.clear();
+        self.states.clear();
+        self.texts.clear();
+    }
+}
+
+/// Samples staged per channel for [`InMemoryStore::push_batch`], so
+/// ingest can decode a whole packet without touching the store. Reuse one
+/// batch across packets; committing keeps its buffers.
+#[derive(Default)]
+pub struct Batch {
+    staged: Vec<Staged>,
+    /// Channels with staged samples, in first-touched order.
+    touched: Vec<ChannelId>,
+}
+
+impl Batch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// True when nothing is staged.
+    pub fn is_empty(&self) -> bool {
+        self.touched.is_empty()
+    }
+
+    fn slot(&mut self, ch: ChannelId, t: Timestamp) -> &mut Staged {
+        let i = ch as usize;
+        if i >= self.staged.len() {
+            self.staged.resize_with(i + 1, Staged::default);
+        }
+        if self.staged[i].stage(t) {
+            self.touched.push(ch);
+        }
+        &mut self.staged[i]
+    }
+
+    /// Stage a scalar sample (see [`InMemoryStore::push_scalar`]).
+    pub fn push_scalar(&mut self, ch: ChannelId, t: Timestamp, v: f64) {
+        self.slot(ch, t).scalars.push((t, v));
+    }
+
+    /// Stage a state observation (see [`InMemoryStore::push_state`]).
+    pub fn push_state(&mut self, ch: ChannelId, t: Timestamp, value: u32) {
+        self.slot(ch, t).states.push((t, value));
+    }
+
+    /// Stage a text sample (see [`InMemoryStore::push_text`]).
+    pub fn push_text(&mut self, ch: ChannelId, t: Timestamp, value: String) {
+        self.slot(ch, t).texts.push((t, value));
+    }
+}
+
+/// Production store: chunked columns, LOD pyramid, per-channel locking.
+/// Clones share the same data. Registration and push methods match
+/// [`crate::MockStore`].
+#[derive(Default, Clone)]
+pub struct InMemoryStore {
+    inner: Arc<Shared>,
+}
+
+impl InMemoryStore {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Register a float-storage scalar channel.
+    pub fn add_scalar(&self, path: impl Into<String>) -> ChannelId {
+        self.add(path.into(), ChannelKind::Scalar, false)
+    }
+
+    /// Register an integer-storage scalar channel (accepted by the logic
+    /// analyser).
+    pub fn add_scalar_int(&self, path: impl Into<String>) -> ChannelId {
+        self.add(path.into(), ChannelKind::Scalar, true)
+    }
+
+    /// Register a state channel with the given labels.
+    pub fn add_state(&self, path: impl Into<String>, labels: &[&str]) -> ChannelId {
+        let labels: Arc<[String]> = labels.iter().map(|s| (*s).to_owned()).collect();
+        self.add(path.into(), ChannelKind::State { labels }, true)
+    }
+
+    /// Register a text channel.
+    pub fn add_text(&self, path: impl Into<String>) -> ChannelId {
+        self.add(path.into(), ChannelKind::Text, false)
+    }
+
+    fn add(&self, path: String, kind: ChannelKind, integer_storage: bool) -> ChannelId {
+        let mut g = self.inner.registry.write().unwrap();
+        let id = g.channels.len() as ChannelId;
+        g.channels.push(Arc::new(Channel {
+            info: ChannelInfo {
+                id,
+                path,
+                kind,
+                integer_storage,
+            },
+            data: RwLock::default(),
+        }));
+        self.bump();
+        id
+    }
+
+    /// Register that `word` is a bitfield-word channel whose per-bit state
+    /// channels are `bits` (in declaration order).
+    pub fn register_word_bits(&self, word: ChannelId, bits: Vec<ChannelId>) {
+        let mut g = self.inner.registry.write().unwrap();
+        g.word_to_bits.insert(word, bits);
+    }
+
+    /// Bits associated with a bitfield-word channel, if any.
+    pub fn bits_for_word(&self, word: ChannelId) -> Option<Vec<ChannelId>> {
+        let g = self.inner.registry.read().unwrap();
+        g.word_to_bits.get(&word).cloned()
+    }
+
+    /// Append a scalar sample. Timestamps must be non-decreasing per channel.
+    pub fn push_scalar(&self, ch: ChannelId, t: Timestamp, v: f64) {
+        let Some(c) = self.channel(ch) else {
+            return;
+        };
+        c.data.write().unwrap().scalars.push(t, v);
+        self.pushed(t);
+    }
+
+    /// Append a state observation; coalesces with previous run if value matches.
+    pub fn push_state(&self, ch: ChannelId, t: Timestamp, value: u32) {
+        let Some(c) = self.channel(ch) else {
+            return;
+        };
+        c.data.write().unwrap().push_state(t, value);
+        self.pushed(t);
+    }
+
+    /// Append a text sample.
+    pub fn push_text(&self, ch: ChannelId, t: Timestamp, value: String) {
+        let Some(c) = self.channel(ch) else {
+            return;
+        };
+        c.data.write().unwrap().texts.push((t, value));
+        self.pushed(t);
+    }
+
+    /// Commit everything staged in `batch` and empty it (keeping its
+    /// buffers). Each touched channel is locked once and the revision is
+    /// bumped once, however many samples the batch holds.
+    pub fn push_batch(&self, batch: &mut Batch) {
+        if batch.touched.is_empty() {
+            return;
+        }
+        let (mut t_min, mut t_max) = (u64::MAX, 0);
+        {
+            let g = self.inner.registry.read().unwrap();
+            for &ch in &batch.touched {
+                let staged = &mut batch.staged[ch as usize];
+                if let Some(c) = g.channels.get(ch as usize) {
+                    let mut d = c.data.write().unwrap();
+                    for &(t, v) in &staged.scalars {
+                        d.scalars.push(t, v);
+                    }
+                    for &(t, v) in &staged.states {
+                        d.push_state(t, v);
+                    }
+                    d.texts.append(&mut staged.texts);
+                    drop(d);
+                    let (lo, hi) = staged.bounds;
+                    t_min = t_min.min(lo);
+                    t_max = t_max.max(hi);
+                }
+                staged.clear();
+            }
+        }
+        batch.touched.clear();
+        if t_min <= t_max {
+            self.inner.t_min.fetch_min(t_min, Ordering::Relaxed);
+            self.inner.t_max.fetch_max(t_max, Ordering::Relaxed);
+            self.bump();
+        }
+    }
+
+    fn channel(&self, ch: ChannelId) -> Option<Arc<Channel>> {
+        let g = self.inner.registry.read().unwrap();
+        g.channels.get(ch as usize).cloned()
+    }
+
+    fn pushed(&self, t: Timestamp) {
+        self.inner.t_min.fetch_min(t, Ordering::Relaxed);
+        self.inner.t_max.fetch_max(t, Ordering::Relaxed);
+        self.bump();
+    }
+
+    fn bump(&self) {
+        self.inner.revision.fetch_add(1, Ordering::Release);
+    }
+}
+
+impl Store for InMemoryStore {
+    fn channels(&self) -> Vec<ChannelInfo> {
+        let g = self.inner.registry.read().unwrap();
+        g.channels.iter().map(|c| c.info.clone()).collect()
+    }
+
+    fn time_bounds(&self) -> Option<TimeRange> {
+        let min = self.inner.t_min.load(Ordering::Relaxed);
+        let max = self.inner.t_max.load(Ordering::Relaxed);
+        (min <= max).then_some((min, max))
+    }
+
+    fn revision(&self) -> u64 {
+        self.inner.revision.load(Ordering::Acquire)
+    }
+
+    fn query_scalar(
+        &self,
+        ch: ChannelId,
+        t0: Timestamp,
+        t1: Timestamp,
+        max_buckets: usize,
+    ) -> Vec<Bucket> {
+        if max_buckets == 0 || t1 <= t0 {
+            return Vec::new();
+        }
+        let Some(c) = self.channel(ch) else {
+            return Vec::new();
+        };
+        let d = c.data.read().unwrap();
+        let col = &d.scalars;
+        let lo = col.lower_bound(t0);
+        let hi = col.lower_bound(t1);
+        let n = hi - lo;
+        if n <= max_buckets {
+            return (lo..hi).map(|i| col.sample(i)).collect();
+        }
+
+        // Equal-width time buckets over pyramid buckets, dropping empty
+        // ones; a pyramid bucket lands in the output bucket of its first t.
+        let bw = (t1 - t0) as f64 / max_buckets as f64;
+        let mut out: Vec<Bucket> = Vec::with_capacity(max_buckets);
+        let mut cur_idx: i64 = -1;
+        col.cover(lo, hi, col.level_for(n, max_buckets), |b| {
+            let idx = (((b.t - t0) as f64) / bw).floor() as i64;
+            match out.last_mut() {
+                Some(cur) if idx == cur_idx => {
+                    cur.min = cur.min.min(b.min);
+                    cur.max = cur.max.max(b.max);
+                }
+                _ => {
+                    cur_idx = idx;
+                    out.push(b);
+                }
+            }
+        });
+        out
+    }
+
+    fn query_raw(
+        &self,
+        ch: ChannelId,
+        t0: Timestamp,
+        t1: Timestamp,
+        max_samples: usize,
+    ) -> Vec<(Timestamp, f64)> {
+        if max_samples == 0 || t1 <= t0 {
+            return Vec::new();
+        }
+        let Some(c) = self.channel(ch) else {
+            return Vec::new();
+        };
+        let d = c.data.read().unwrap();
+        let col = &d.scalars;
+        let lo = col.lower_bound(t0);
+        let hi = col.lower_bound(t1);
+        let stride = (hi - lo).div_ceil(max_samples).max(1);
+        (lo..hi)
+            .step_by(stride)
+            .map(|i| (col.t(i), col.v(i)))
+            .collect()
+    }
+
+    fn query_state(&self, ch: ChannelId, t0: Timestamp, t1: Timestamp) -> Vec<StateRun> {
+        let Some(c) = self.channel(ch) else {
+            return Vec::new();
+        };
+        let d = c.data.read().unwrap();
+        let runs = &d.states;
+        let Some(last_idx) = runs.len().checked_sub(1) else {
+            return Vec::new();
+        };
+        // The trailing run is held forward (t_end = u64::MAX), so only
+        // earlier runs can end before the window.
+        let start = runs[..last_idx].partition_point(|r| r.t_end <= t0);
+        runs[start..]
+            .iter()
+            .enumerate()
+            .take_while(|(_, r)| r.t_start < t1)
+            .map(|(i, r)| StateRun {
+                t_end: if start + i == last_idx {
+                    u64::MAX
+                } else {
+                    r.t_end
+                },
+                ..*r
+            })
+            .collect()
+    }
+
+    fn sample_at(&self, ch: ChannelId, t: Timestamp) -> Option<f64> {
+        let c = self.channel(ch)?;
+        let d = c.data.read().unwrap();
+        match c.info.kind {
+            ChannelKind::Scalar => {
+                let col = &d.scalars;
+                let i = col.lower_bound(t);
+                if i < col.len && col.t(i) == t {
+                    return Some(col.v(i));
+                }
+                if i == 0 || i == col.len {
+                    return None;
+                }
+                let (t_a, v_a) = (col.t(i - 1), col.v(i - 1));
+                let (t_b, v_b) = (col.t(i), col.v(i));
+                let frac = (t - t_a) as f64 / (t_b - t_a) as f64;
+                Some(v_a + frac * (v_b - v_a))
+            }
+            ChannelKind::State { .. } => {
+                let runs = &d.states;
+                let i = runs.partition_point(|r| r.t_start <= t).checked_sub(1)?;
+                let r = &runs[i];
+                (i == runs.len() - 1 || t < r.t_end).then_some(r.value as f64)
+            }
+            ChannelKind::Text => None,
+        }
+    }
+
+    fn sample_count(&self, ch: ChannelId) -> u64 {
+        let Some(c) = self.channel(ch) else {
+            return 0;
+        };
+        let d = c.data.read().unwrap();
+        (match c.info.kind {
+            ChannelKind::Scalar => d.scalars.len,
+            ChannelKind::State { .. } => d.states.len(),
+            ChannelKind::Text => d.texts.len(),
+        }) as u64
+    }
+
+    fn clear(&self) {
+        let mut g = self.inner.registry.write().unwrap();
+        g.channels.clear();
+        g.word_to_bits.clear();
+        self.inner.epoch.fetch_add(1, Ordering::Relaxed);
+        self.inner.t_min.store(u64::MAX, Ordering::Relaxed);
+        self.inner.t_max.store(0, Ordering::Relaxed);
+        self.bump();
+    }
+
+    fn value_bounds(&self, ch: ChannelId) -> Option<(f64, f64)> {
+        let c = self.channel(ch)?;
+        let d = c.data.read().unwrap();
+        if d.scalars.len > 0 {
+            return Some((d.scalars.min, d.scalars.max));
+        }
+        let (lo, hi) = d.state_bounds;
+        (!d.states.is_empty()).then_some((lo as f64, hi as f64))
+    }
+
+    fn scalar_extent(&self, ch: ChannelId) -> ScalarExtent {
+        let epoch = self.inner.epoch.load(Ordering::Relaxed);
+        let Some(c) = self.channel(ch) else {
+            return ScalarExtent {
+                epoch,
+                ..ScalarExtent::default()
+            };
+        };
+        let d = c.data.read().unwrap();
+        let col = &d.scalars;
+        ScalarExtent {
+            epoch,
+            samples: col.len as u64,
+            t_last: col.len.checked_sub(1).map(|i| col.t(i)),
+        }
+    }
+
+    fn query_text(
+        &self,
+        ch: ChannelId,
+        t0: Timestamp,
+        t1: Timestamp,
+        max_samples: usize,
+    ) -> Vec<(Timestamp, String)> {
+        if max_samples == 0 || t1 <= t0 {
+            return Vec::new();
+        }
+        let Some(c) = self.channel(ch) else {
+            return Vec::new();
+        };
+        let d = c.data.read().unwrap();
+        let samples = &d.texts;
+        let lo = samples.partition_point(|(t, _)| *t < t0);
+        let hi = samples.partition_point(|(t, _)| *t < t1);
+        let stride = (hi - lo).div_ceil(max_samples).max(1);
+        samples[lo..hi].iter().step_by(stride).cloned().collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::MockStore;
+
+    /// Small deterministic generator (no external RNG in this crate).
+    struct Lcg(u64);
+
+    impl Lcg {
+        fn next(&mut self) -> u64 {
+            self.0 = self
+                .0
+                .wrapping_mul(6364136223846793005)
+                .wrapping_add(1442695040888963407);
+            self.0 >> 33
+        }
+    }
+
+    fn filled(n: u64, seed: u64) -> (InMemoryStore, MockStore, ChannelId) {
+        let (s, m) = (InMemoryStore::new(), MockStore::new());
+        let ch = s.add_scalar("x");
+        assert_eq!(m.add_scalar("x"), ch);
+        let mut rng = Lcg(seed);
+        let mut t = 0;
+        for _ in 0..n {
+            t += 1 + rng.next() % 4;
+            let v = (rng.next() % 2001) as f64 - 1000.0;
+            s.push_scalar(ch, t, v);
+            m.push_scalar(ch, t, v);
+        }
+        (s, m, ch)
+    }
+
+    #[test]
+    fn matches_mock_on_raw_queries() {
+        let (s, m, ch) = filled(20_000, 1);
+        let st = s.add_state("fsm", &["a", "b", "c"]);
+        let tx = s.add_text("log");
+        assert_eq!(m.add_state("fsm", &["a", "b", "c"]), st);
+        assert_eq!(m.add_text("log"), tx);
+        for i in 0..300u64 {
+            let v = ((i / 7) % 3) as u32;
+            s.push_state(st, i * 10, v);
+            m.push_state(st, i * 10, v);
+            s.push_text(tx, i * 10 + 3, format!("m{i}"));
+            m.push_text(tx, i * 10 + 3, format!("m{i}"));
+        }
+
+        assert_eq!(s.channels(), m.channels());
+        assert_eq!(s.time_bounds(), m.time_bounds());
+        let (_, t_end) = s.time_bounds().unwrap();
+        let mut rng = Lcg(2);
+        for _ in 0..200 {
+            let t0 = rng.next() % t_end;
+            let t1 = t0 + rng.next() % 5000;
+            assert_eq!(s.query_raw(ch, t0, t1, 100), m.query_raw(ch, t0, t1, 100));
+            assert_eq!(
+                s.query_scalar(ch, t0, t1, 50_000),
+                m.query_scalar(ch, t0, t1, 50_000)
+            );
+            assert_eq!(s.query_state(st, t0, t1), m.query_state(st, t0, t1));
+            assert_eq!(s.query_text(tx, t0, t1, 20), m.query_text(tx, t0, t1, 20));
+            for t in [t0, t1, rng.next() % 3100] {
+                assert_eq!(s.sample_at(ch, t), m.sample_at(ch, t), "t={t}");
+                assert_eq!(s.sample_at(st, t), m.sample_at(st, t), "t={t}");
+            }
+        }
+        for c in [ch, st, tx, 99] {
+            assert_eq!(s.sample_count(c), m.sample_count(c));
+            assert_eq!(s.value_bounds(c), m.value_bounds(c));
+        }
+    }
+
+    #[test]
+    fn lod_buckets_keep_the_envelope() {
+        let (s, m, ch) = filled(200_000, 3);
+        let (_, t_end) = s.time_bounds().unwrap();
+        let mut rng = Lcg(4);
+        for _ in 0..200 {
+            let t0 = rng.next() % t_end;
+            let t1 = t0 + 1 + rng.next() % (t_end - t0 + 10);
+            let max_buckets = 1 + (rng.next() % 2000) as usize;
+            let got = s.query_scalar(ch, t0, t1, max_buckets);
+            let raw = m.query_raw(ch, t0, t1, usize::MAX);
+            assert_eq!(got.is_empty(), raw.is_empty());
+            if raw.is_empty() {
+                continue;
+            }
+            assert!(got.len() <= max_buckets);
+            assert!(got.windows(2).all(|w| w[0].t < w[1].t));
+            assert_eq!(got[0].t, raw[0].0);
+            assert!(got.iter().all(|b| b.t >= t0 && b.t < t1 && b.min <= b.max));
+            let lo = raw.iter().map(|r| r.1).fold(f64::INFINITY, f64::min);
+            let hi = raw.iter().map(|r| r.1).fold(f64::NEG_INFINITY, f64::max);
+            assert_eq!(got.iter().map(|b| b.min).fold(f64::INFINITY, f64::min), lo);
+            assert_eq!(
+                got.iter().map(|b| b.max).fold(f64::NEG_INFINITY, f64::max),
+                hi
+            );
+        }
+    }
+
+    #[test]
+    fn query_cost_follows_max_buckets_not_history() {
+        for n in [100_000u64, 1_000_000] {
+            let s = InMemoryStore::new();
+            let ch = s.add_scalar("x");
+            for i in 0..n {
+                s.push_scalar(ch, i, (i % 977) as f64);
+            }
+            let c = s.channel(ch).unwrap();
+            let d = c.data.read().unwrap();
+            let col = &d.scalars;
+            for (lo, hi) in [(0, col.len), (123, col.len - 77), (5, col.len / 3)] {
+                let visited = col.cover(lo, hi, col.level_for(hi - lo, 1000), |_| {});
+                assert!(
+                    visited <= FANOUT * 1000 + 4 * FANOUT * col.levels.len(),
+                    "{visited}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn readers_run_alongside_ingest() {
+        let s = InMemoryStore::new();
+        let a = s.add_scalar("a");
+        let b = s.add_scalar("b");
+        let writer = {
+            let s = s.clone();
+            std::thread::spawn(move || {
+                for i in 0..200_000u64 {
+                    s.push_scalar(a, i, i as f64);
+                    s.push_scalar(b, i, -(i as f64));
+                }
+            })
+        };
+        while !writer.is_finished() {
+            for b in s.query_scalar(a, 0, u64::MAX, 500) {
+                assert!(b.min <= b.max);
+            }
+        }
+        writer.join().unwrap();
+        assert_eq!(s.sample_count(a), 200_000);
+        assert_eq!(s.value_bounds(b), Some((-199_999.0, 0.0)));
+        assert_eq!(s.query_scalar(a, 0, u64::MAX, 1)[0].max, 199_999.0);
+    }
+
+    #[test]
+    fn batch_matches_per_sample_pushes() {
+        let (a, b) = (InMemoryStore::new(), InMemoryStore::new());
+        for s in [&a, &b] {
+            s.add_scalar("x");
+            s.add_state("fsm", &["a", "b"]);
+            s.add_text("log");
+        }
+        let mut batch = Batch::new();
+        for pkt in 0..50u64 {
+            let rev = a.revision();
+            for i in 0..40 {
+                let t = pkt * 100 + i + 1;
+                let v = ((t * 7) % 13) as f64;
+                batch.push_scalar(0, t, v);
+                b.push_scalar(0, t, v);
+                batch.push_state(1, t, (t / 30 % 2) as u32);
+                b.push_state(1, t, (t / 30 % 2) as u32);
+                if i % 10 == 0 {
+                    batch.push_text(2, t, format!("{t}"));
+                    b.push_text(2, t, format!("{t}"));
+                }
+            }
+            batch.push_scalar(99, pkt, 0.0); // unknown channel: dropped
+            a.push_batch(&mut batch);
+            assert!(batch.is_empty());
+            assert_eq!(a.revision(), rev + 1);
+        }
+        assert_eq!(a.time_bounds(), b.time_bounds());
+        for ch in 0..3 {
+            assert_eq!(a.sample_count(ch), b.sample_count(ch));
+            assert_eq!(a.value_bounds(ch), b.value_bounds(ch));
+        }
+        assert_eq!(
+            a.query_scalar(0, 0, 6000, 64),
+            b.query_scalar(0, 0, 6000, 64)
+        );
+        assert_eq!(a.query_state(1, 0, 6000), b.query_state(1, 0, 6000));
+        assert_eq!(
+            a.query_text(2, 0, 6000, 1000),
+            b.query_text(2, 0, 6000, 1000)
+        );
+    }
+
+    #[test]
+    fn clear_resets_bounds_and_ids() {
+        let s = InMemoryStore::new();
+        let ch = s.add_scalar("x");
+        s.push_scalar(ch, 5, 1.0);
+        let rev = s.revision();
+        Store::clear(&s);
+        assert!(s.revision() > rev);
+        assert_eq!(s.time_bounds(), None);
+        assert_eq!(s.sample_count(ch), 0);
+        assert_eq!(s.add_scalar("y"), 0);
+    }
+}
@@ -0,0 +1,259 @@
+//! Frame-to-frame cache of [`Store::query_scalar`] results.
+//!
+//! Time is cut into tiles aligned to absolute time, each holding
+//! [`TILE_BUCKETS`] buckets of a power-of-two width (the LOD level). A
+//! query picks the narrowest level whose buckets are at least as wide as
+//! the requested ones and stitches together the tiles it overlaps. Panning
+//! reuses every tile still on screen, and zooming reuses them until the
+//! bucket width crosses a power of two.
+//!
+//! A tile that ends at or before the channel's newest sample can no longer
+//! change and is kept until the store's epoch moves ([`ScalarExtent`]).
+//! The tile at the live edge is rebuilt only when the channel has gained
+//! samples since it was built.
+
+use std::collections::HashMap;
+
+use crate::{Bucket, ChannelId, Store, Timestamp};
+
+/// Buckets per tile.
+pub const TILE_BUCKETS: u64 = 256;
+
+/// Tiles kept before the least recently used half is dropped.
+const MAX_TILES: usize = 8192;
+
+/// Tiles one query may span before it bypasses the cache.
+const MAX_QUERY_TILES: u64 = 1024;
+
+#[derive(Clone, Copy, PartialEq, Eq, Hash)]
+struct Key {
+    ch: ChannelId,
+    level: u32,
+    index: u64,
+}
+
+struct Tile {
+    buckets: Vec<Bucket>,
+    epoch: u64,
+    samples: u64,
+    sealed: bool,
+    used: u64,
+}
+
+/// Counters for a [`TileCache`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TileStats {
+    /// Tiles held.
+    pub tiles: usize,
+    /// Tiles queried from the store.
+    pub built: u64,
+    /// Tiles served from the cache.
+    pub reused: u64,
+}
+
+/// Per-channel tile cache in front of a [`Store`]; one per viewer.
+#[derive(Default)]
+pub struct TileCache {
+    tiles: HashMap<Key, Tile>,
+    tick: u64,
+    built: u64,
+    reused: u64,
+}
+
+impl TileCache {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Like [`Store::query_scalar`], at most about `max_buckets` buckets
+    /// over `[t0, t1)`, answered from cached tiles where they are still
+    /// valid. Bucket edges are aligned to absolute time rather than `t0`,
+    /// so one bucket either side of the window may reach past it.
+    pub fn query_scalar(
+        &mut self,
+        store: &impl Store,
+        ch: ChannelId,
+        t0: Timestamp,
+        t1: Timestamp,
+        max_buckets: usize,
+    ) -> Vec<Bucket> {
+        if max_buckets == 0 || t1 <= t0 {
+            return Vec::new();
+        }
+        let width = ((t1 - t0) / max_buckets as u64).max(1);
+        let level = 64 - (width - 1).leading_zeros();
+        let Some(span) = 1u64
+            .checked_shl(level)
+            .and_then(|bw| bw.checked_mul(TILE_BUCKETS))
+        else {
+            return store.query_scalar(ch, t0, t1, max_buckets);
+        };
+        let (first, last) = (t0 / span, (t1 - 1) / span);
+        if last - first >= MAX_QUERY_TILES {
+            return store.query_scalar(ch, t0, t1, max_buckets);
+        }
+
+        self.tick += 1;
+        let ext = store.scalar_extent(ch);
+        let bw = span / TILE_BUCKETS;
+        let mut out = Vec::new();
+        for index in first..=last {
+            let key = Key { ch, level, index };
+            let fresh = self
+                .tiles
+                .get(&key)
+                .is_some_and(|t| t.epoch == ext.epoch && (t.sealed || t.samples == ext.samples));
+            if fresh {
+                self.reused += 1;
+            } else {
+                let a = index * span;
+                let b = a.saturating_add(span);
+                let buckets = store.query_scalar(ch, a, b, TILE_BUCKETS as usize);
+                let tile = Tile {
+                    buckets,
+                    epoch: ext.epoch,
+                    samples: ext.samples,
+                    sealed: ext.t_last.is_some_and(|t| b <= t),
+                    used: 0,
+                };
+                self.tiles.insert(key, tile);
+                self.built += 1;
+            }
+            let tile = self.tiles.get_mut(&key).expect("tile just ensured");
+            tile.used = self.tick;
+            out.extend(
+                tile.buckets
+                    .iter()
+                    .filter(|b| b.t < t1 && b.t.saturating_add(bw) > t0),
+            );
+        }
+        if self.tiles.len() > MAX_TILES {
+            self.evict();
+        }
+        out
+    }
+
+    /// Drop every tile.
+    pub fn clear(&mut self) {
+        self.tiles.clear();
+    }
+
+    pub fn stats(&self) -> TileStats {
+        TileStats {
+            tiles: self.tiles.len(),
+            built: self.built,
+            reused: self.reused,
+        }
+    }
+
+    /// Keep the most recently used half.
+    fn evict(&mut self) {
+        let mut used: Vec<u64> = self.tiles.values().map(|t| t.used).collect();
+        used.sort_unstable();
+        let cutoff = used[used.len() - MAX_TILES / 2];
+        self.tiles.retain(|_, t| t.used >= cutoff);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{InMemoryStore, MockStore};
+
+    fn ramp(n: u64, dt: u64) -> (InMemoryStore, ChannelId) {
+        let s = InMemoryStore::new();
+        let ch = s.add_scalar("x");
+        for i in 0..n {
+            s.push_scalar(ch, i * dt, ((i * 37) % 101) as f64);
+        }
+        (s, ch)
+    }
+
+    fn envelope(bs: &[Bucket]) -> (f64, f64) {
+        bs.iter()
+            .fold((f64::INFINITY, f64::NEG_INFINITY), |(lo, hi), b| {
+                (lo.min(b.min), hi.max(b.max))
+            })
+    }
+
+    #[test]
+    fn tiles_match_the_store_envelope() {
+        let (s, ch) = ramp(100_000, 10);
+        let mut cache = TileCache::new();
+        for (t0, t1, n) in [(0, 1_000_000, 800), (12_345, 456_789, 300), (5, 900, 1000)] {
+            let got = cache.query_scalar(&s, ch, t0, t1, n);
+            assert!(got.len() <= n + 2, "{} buckets for {n}", got.len());
+            assert!(got.windows(2).all(|w| w[0].t < w[1].t));
+            // The window's samples, plus at most one bucket either side.
+            let inner = envelope(&s.query_scalar(ch, t0, t1, 1));
+            let width = ((t1 - t0) / n as u64).max(1).next_power_of_two();
+            let outer = envelope(&s.query_scalar(ch, t0.saturating_sub(width), t1 + width, 1));
+            let (lo, hi) = envelope(&got);
+            assert!(lo <= inner.0 && lo >= outer.0);
+            assert!(hi >= inner.1 && hi <= outer.1);
+        }
+    }
+
+    #[test]
+    fn panning_reuses_tiles() {
+        let (s, ch) = ramp(100_000, 10);
+        let mut cache = TileCache::new();
+        cache.query_scalar(&s, ch, 0, 500_000, 1000);
+        let before = cache.stats();
+        // A quarter-window pan only needs the tiles that scroll in.
+        cache.query_scalar(&s, ch, 125_000, 625_000, 1000);
+        let after = cache.stats();
+        assert!(after.built - before.built <= 2, "{before:?} -> {after:?}");
+        assert!(after.reused > before.reused);
+        // Re-querying the same view builds nothing.
+        cache.query_scalar(&s, ch, 125_000, 625_000, 1000);
+        assert_eq!(cache.stats().built, after.built);
+    }
+
+    #[test]
+    fn only_the_live_edge_is_rebuilt() {
+        // 262144 ns tiles; data ends in tile 3, tile 4 is still empty.
+        let (s, ch) = ramp(100_000, 10);
+        let mut cache = TileCache::new();
+        let view = (0, 1_100_000);
+        cache.query_scalar(&s, ch, view.0, view.1, 2000);
+        let built = cache.stats().built;
+        assert_eq!(built, 5);
+        for i in 100_000..100_100u64 {
+            s.push_scalar(ch, i * 10, 1000.0);
+        }
+        let got = cache.query_scalar(&s, ch, view.0, view.1, 2000);
+        assert_eq!(cache.stats().built - built, 2, "tiles 0-2 are sealed");
+        assert_eq!(envelope(&got).1, 1000.0);
+
+        // clear() moves the epoch: nothing survives.
+        Store::clear(&s);
+        let ch = s.add_scalar("y");
+        s.push_scalar(ch, 50, -5.0);
+        let got = cache.query_scalar(&s, ch, view.0, view.1, 500);
+        assert_eq!(
+            got,
+            vec![Bucket {
+                t: 50,
+                min: -5.0,
+                max: -5.0
+            }]
+        );
+    }
+
+    #[test]
+    fn default_extent_invalidates_on_any_change() {
+        let m = MockStore::new();
+        let ch = m.add_scalar("x");
+        for i in 0..1000 {
+            m.push_scalar(ch, i, i as f64);
+        }
+        let mut cache = TileCache::new();
+        cache.query_scalar(&m, ch, 0, 1000, 100);
+        let other = m.add_scalar("z");
+        m.push_scalar(other, 2000, 0.0);
+        let built = cache.stats().built;
+        cache.query_scalar(&m, ch, 0, 1000, 100);
+        assert!(cache.stats().built > built);
+    }
+}
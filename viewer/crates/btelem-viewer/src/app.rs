@@ -11,9 +11,9 @@ use std::sync::Arc;
 use std::time::{Duration, Instant};
 
 use btelem_capture::{read_btlm, Capture, CaptureStats};
-use btelem_ingest::{ChannelMap, SourceHandle, TcpSource};
-use btelem_store::{ChannelId, ChannelInfo, ChannelKind, MockStore, Store};
-use btelem_wire::{decode_packet, Schema};
+use btelem_ingest::{ChannelMap, IngestError, SourceHandle, TcpSource, UdpSource};
+use btelem_store::{Batch, ChannelId, ChannelInfo, ChannelKind, InMemoryStore, Store, TileCache};
+use btelem_wire::{decode_packet, decompress_packet, Schema};
 use eframe::egui;
 use egui::{Color32, DragAndDrop};
 use egui_dock::{DockArea, DockState, NodeIndex, Style, TabViewer};
@@ -29,6 +29,26 @@ use crate::Args;
 
 const CURSOR_IDLE_MS: u128 = 500;
 
+/// Start the ingest source for `c`: connect for TCP, bind the local
+/// address for binary UDP.
+fn open_source(
+    c: &Connection,
+    store: &InMemoryStore,
+    capture: &Capture,
+) -> Result<SourceHandle, IngestError> {
+    match c.protocol {
+        Protocol::Udp => UdpSource::bind(c.socket_addr(), store.clone(), Some(capture.clone())),
+        _ => TcpSource::connect(c.socket_addr(), store.clone(), Some(capture.clone())),
+    }
+}
+
+fn connected_status(c: &Connection) -> String {
+    match c.protocol {
+        Protocol::Udp => format!("listening on {}", c.pretty()),
+        _ => format!("connected to {}", c.pretty()),
+    }
+}
+
 /// Add `ch` to a logic-analyser panel, expanding bitfield-word channels
 /// into one lane per bit (Saleae-style). Plain integer channels (incl.
 /// individual bit children) are added as a single lane.
@@ -36,7 +56,7 @@ fn add_logic_lane(
     panel: &mut LogicAnalyserPanel,
     ch: ChannelId,
     info: &ChannelInfo,
-    store: &MockStore,
+    store: &InMemoryStore,
     by_id: &HashMap<ChannelId, ChannelInfo>,
 ) {
     if let Some(bits) = store.bits_for_word(ch) {
@@ -62,7 +82,9 @@ fn log_view_from_group(
 }
 
 pub struct ViewerApp {
-    store: MockStore,
+    store: InMemoryStore,
+    /// Scalar query results kept between frames, per time tile.
+    tiles: TileCache,
     capture: Capture,
     _handle: Option<SourceHandle>,
     _args: Arc<Args>,
@@ -172,7 +194,7 @@ fn make_default_dock(plots: &mut PlotRegistry) -> DockState<PlotId> {
 
 impl ViewerApp {
     pub fn new(args: Arc<Args>) -> Self {
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let capture = Capture::default();
         let connection = Connection::parse(&args.addr).unwrap_or_default();
         let pending_layout = args.layout.clone();
@@ -184,12 +206,8 @@ impl ViewerApp {
             let deadline =
                 Instant::now() + Duration::from_secs_f64(args.connect_timeout.max(0.0));
             let (h, s) = loop {
-                match TcpSource::connect(
-                    connection.socket_addr(),
-                    store.clone(),
-                    Some(capture.clone()),
-                ) {
-                    Ok(h) => break (Some(h), format!("connected to {}", connection.pretty())),
+                match open_source(&connection, &store, &capture) {
+                    Ok(h) => break (Some(h), connected_status(&connection)),
                     Err(e) if Instant::now() >= deadline => {
                         break (None, format!("connection failed: {e}"));
                     }
@@ -225,6 +243,7 @@ impl ViewerApp {
             marker_mode: false,
             last_revision: 0,
             rate: RateEstimator::new(2.0),
+            tiles: TileCache::new(),
             group_counts: HashMap::new(),
             group_counts_last_refresh: None,
             current_layout_name: None,
@@ -247,9 +266,9 @@ impl ViewerApp {
     /// Tear down the current source, clear the store, and connect to
     /// `self.connection`. Leaves status with a human-readable result.
     fn reconnect(&mut self) {
-        if self.connection.protocol != Protocol::Tcp {
+        if self.connection.protocol == Protocol::Serial {
             self.status = format!(
-                "{} not yet implemented (TCP only)",
+                "{} not yet implemented (TCP and UDP only)",
                 self.connection.protocol.label()
             );
             return;
@@ -261,14 +280,10 @@ impl ViewerApp {
         self.capture.clear();
         self.last_revision = 0;
         self.rate = RateEstimator::new(2.0);
-        match TcpSource::connect(
-            self.connection.socket_addr(),
-            self.store.clone(),
-            Some(self.capture.clone()),
-        ) {
+        match open_source(&self.connection, &self.store, &self.capture) {
             Ok(h) => {
                 self._handle = Some(h);
-                self.status = format!("connected to {}", self.connection.pretty());
+                self.status = connected_status(&self.connection);
             }
             Err(e) => {
                 self.status = format!("connection failed: {e}");
@@ -339,14 +354,22 @@ impl ViewerApp {
         let mut dispatched_pkts: u64 = 0;
         let mut dispatched_entries: u64 = 0;
         let mut skipped: u64 = 0;
+        let mut clock = schema.clock;
+        let mut batch = Batch::new();
         for pkt in &loaded.packets {
-            match decode_packet(pkt) {
+            let Ok(plain) = decompress_packet(pkt) else {
+                skipped += 1;
+                continue;
+            };
+            match decode_packet(&plain) {
                 Ok(p) => {
-                    for e in &p.entries {
-                        map.dispatch(e.id, e.timestamp, e.payload, &self.store);
-                        dispatched_entries += 1;
+                    if let Some(c) = p.clock {
+                        clock = Some(c);
                     }
-                    let _ = self.capture.push_packet(pkt.clone());
+                    map.dispatch_packet(&p.entries, clock, &mut batch);
+                    dispatched_entries += p.entries.len() as u64;
+                    self.store.push_batch(&mut batch);
+                    let _ = self.capture.push_packet(pkt);
                     dispatched_pkts += 1;
                 }
                 Err(_) => skipped += 1,
@@ -1153,7 +1176,7 @@ impl ViewerApp {
                                     Protocol::Udp,
                                     "UDP",
                                 )
-                                .on_hover_text("not yet implemented");
+                                .on_hover_text("binary datagrams; host:port is the bind address");
                                 ui.selectable_value(
                                     &mut self.pending_connection.protocol,
                                     Protocol::Serial,
@@ -1507,6 +1530,7 @@ impl eframe::App for ViewerApp {
         // registry while DockArea has a &mut borrow on dock).
         let mut tab_viewer = ViewerTabs {
             store: &self.store,
+            tiles: &mut self.tiles,
             plots: &mut self.plots,
             view,
             by_id: &by_id,
@@ -1570,7 +1594,8 @@ impl eframe::App for ViewerApp {
 // --------------------------------------------------------------------------
 
 struct ViewerTabs<'a> {
-    store: &'a MockStore,
+    store: &'a InMemoryStore,
+    tiles: &'a mut TileCache,
     plots: &'a mut PlotRegistry,
     view: Option<(u64, u64)>,
     by_id: &'a HashMap<ChannelId, ChannelInfo>,
@@ -1654,6 +1679,7 @@ impl<'a> TabViewer for ViewerTabs<'a> {
                 let Some(kind) = kind_clone else { return };
                 let mut ctx = PlotContext {
                     store: self.store,
+                    tiles: self.tiles,
                     plots: self.plots,
                     view: self.view,
                     by_id: self.by_id,
@@ -1992,13 +2018,13 @@ mod logic_drop_tests {
     use super::*;
     use btelem_store::Store;
 
-    fn by_id_map(store: &MockStore) -> HashMap<ChannelId, ChannelInfo> {
+    fn by_id_map(store: &InMemoryStore) -> HashMap<ChannelId, ChannelInfo> {
         store.channels().into_iter().map(|c| (c.id, c)).collect()
     }
 
     #[test]
     fn dropping_word_on_logic_analyser_expands_into_per_bit_lanes() {
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let word = store.add_scalar_int("flags.f");
         let bit_a = store.add_scalar_int("flags.f.a");
         let bit_b = store.add_scalar_int("flags.f.b");
@@ -2017,7 +2043,7 @@ mod logic_drop_tests {
 
     #[test]
     fn dropping_plain_int_on_logic_analyser_adds_single_lane() {
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let ch = store.add_scalar_int("imu.count");
         let by_id = by_id_map(&store);
         let mut panel = LogicAnalyserPanel::new("la");
@@ -2030,7 +2056,7 @@ mod logic_drop_tests {
     #[test]
     fn dropping_individual_bit_child_on_logic_analyser_adds_single_lane() {
         // Mixed dragging: bit child only — no decomposition.
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let word = store.add_scalar_int("flags.f");
         let bit_a = store.add_scalar_int("flags.f.a");
         store.register_word_bits(word, vec![bit_a]);
@@ -2047,7 +2073,7 @@ mod logic_drop_tests {
     fn dropping_word_on_scalar_panel_keeps_word_as_single_trace() {
         // Regression: only LogicAnalyser drops decompose. ScalarPanel::add
         // takes the word as-is and does not see the bits mapping at all.
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let word = store.add_scalar_int("flags.f");
         let bit_a = store.add_scalar_int("flags.f.a");
         store.register_word_bits(word, vec![bit_a]);
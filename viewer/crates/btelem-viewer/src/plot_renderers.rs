@@ -6,7 +6,9 @@
 use std::collections::{BTreeMap, BTreeSet, HashMap};
 use std::sync::Arc;
 
-use btelem_store::{ChannelId, ChannelInfo, ChannelKind, MockStore, StateRun, Store};
+use btelem_store::{
+    ChannelId, ChannelInfo, ChannelKind, InMemoryStore, StateRun, Store, TileCache,
+};
 use eframe::egui::{self, Color32};
 use egui_plot::{
     Bar, BarChart, Line, LineStyle, MarkerShape, Plot, PlotBounds, PlotPoint, PlotPoints, PlotUi,
@@ -983,7 +985,9 @@ pub fn render_xy(ui: &mut egui::Ui, ctx: &mut PlotContext<'_>, pid: u64, xy: &XY
 /// Bundle of borrows the renderers need from the app. Keeps individual
 /// function signatures sane.
 pub struct PlotContext<'a> {
-    pub store: &'a MockStore,
+    pub store: &'a InMemoryStore,
+    /// Time-series queries go through this so unchanged tiles are reused.
+    pub tiles: &'a mut TileCache,
     pub plots: &'a mut PlotRegistry,
     pub view: Option<(u64, u64)>,
     pub by_id: &'a HashMap<ChannelId, ChannelInfo>,
@@ -1018,7 +1022,7 @@ fn render_scalar_section(
     let mut ymin = f64::INFINITY;
     let mut ymax = f64::NEG_INFINITY;
     for (i, ch) in panel.channels.iter().enumerate() {
-        let bs = ctx.store.query_scalar(*ch, t0, t1, max_buckets);
+        let bs = ctx.tiles.query_scalar(ctx.store, *ch, t0, t1, max_buckets);
         if bs.is_empty() {
             continue;
         }
@@ -1402,7 +1406,7 @@ fn render_log_highlights(pui: &mut PlotUi, highlights: &std::collections::HashSe
 fn render_link_deltas(
     pui: &mut PlotUi,
     markers: &MarkerSet,
-    store: &MockStore,
+    store: &InMemoryStore,
     signals: &[SignalData],
     ylo: f64,
     yhi: f64,
@@ -2520,14 +2524,14 @@ pub fn short_name(p: &str) -> &str {
 mod log_view_tests {
     use super::*;
 
-    fn by_id_map(store: &MockStore) -> HashMap<ChannelId, ChannelInfo> {
+    fn by_id_map(store: &InMemoryStore) -> HashMap<ChannelId, ChannelInfo> {
         store.channels().into_iter().map(|c| (c.id, c)).collect()
     }
 
     /// Build a store with `n` log entries: a text `message`, an enum
     /// `severity` (toggling), and a scalar `device`. Returns (store, ids).
-    fn make_log(n: u64) -> (MockStore, ChannelId, ChannelId, ChannelId) {
-        let store = MockStore::new();
+    fn make_log(n: u64) -> (InMemoryStore, ChannelId, ChannelId, ChannelId) {
+        let store = InMemoryStore::new();
         let msg = store.add_text("log.message");
         let sev = store.add_state("log.severity", &["TRACE", "INFO", "WARN", "ERROR"]);
         let dev = store.add_scalar_int("log.device");
@@ -2603,7 +2607,7 @@ mod log_view_tests {
     /// that overflows is partially included; lower tiers are dropped entirely.
     #[test]
     fn truncation_fills_tiers_highest_first() {
-        let store = MockStore::new();
+        let store = InMemoryStore::new();
         let msg = store.add_text("log.message");
         let sev = store.add_state("log.severity", &["TRACE", "INFO", "WARN", "ERROR"]);
         let mut t = 0u64;
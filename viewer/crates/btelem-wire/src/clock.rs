@@ -0,0 +1,113 @@
+//! Tick-counter calibration (`btelem_clock_wire`).
+//!
+//! Producers built with `BTELEM_TIMESTAMP_TSC` log raw cycle-counter ticks.
+//! The schema then carries a trailing clock record, and the server refreshes
+//! it with `PACKET_FLAG_CLOCK` packets; both hold the same 32-byte layout.
+
+use crate::*;
+
+pub const CLOCK_MAGIC: u32 = 0x4B43_5442; // "BTCK"
+pub const CLOCK_WIRE_SIZE: usize = 4 + 4 + 8 + 8 + 8; // 32
+
+/// Maps counter ticks to CLOCK_MONOTONIC nanoseconds:
+/// `ns = ref_ns + (ticks - ref_ticks) * 1e9 / tick_hz`.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Clock {
+    pub tick_hz: u64,
+    pub ref_ticks: u64,
+    pub ref_ns: u64,
+}
+
+impl Clock {
+    /// Decode a clock record at `off`. `None` if short, wrong magic or a
+    /// zero frequency — callers treat that as "timestamps are already ns".
+    pub fn decode(buf: &[u8], off: usize) -> Option<Self> {
+        if read_u32(buf, off).ok()? != CLOCK_MAGIC {
+            return None;
+        }
+        let tick_hz = read_u64(buf, off + 8).ok()?;
+        if tick_hz == 0 {
+            return None;
+        }
+        Some(Clock {
+            tick_hz,
+            ref_ticks: read_u64(buf, off + 16).ok()?,
+            ref_ns: read_u64(buf, off + 24).ok()?,
+        })
+    }
+
+    pub fn encode(&self) -> [u8; CLOCK_WIRE_SIZE] {
+        let mut b = [0u8; CLOCK_WIRE_SIZE];
+        b[0..4].copy_from_slice(&CLOCK_MAGIC.to_le_bytes());
+        b[8..16].copy_from_slice(&self.tick_hz.to_le_bytes());
+        b[16..24].copy_from_slice(&self.ref_ticks.to_le_bytes());
+        b[24..32].copy_from_slice(&self.ref_ns.to_le_bytes());
+        b
+    }
+
+    /// Convert a tick timestamp to nanoseconds (floored, saturating).
+    #[inline]
+    pub fn to_ns(&self, ticks: u64) -> u64 {
+        let d = ticks as i128 - self.ref_ticks as i128;
+        let ns = self.ref_ns as i128 + (d * 1_000_000_000).div_euclid(self.tick_hz as i128);
+        ns.clamp(0, u64::MAX as i128) as u64
+    }
+
+    /// Overwrite the clock record of a serialised schema blob in place, so a
+    /// saved capture carries the latest calibration. Returns `false` (and
+    /// leaves the blob alone) if the schema has no clock record.
+    pub fn patch_schema_blob(&self, blob: &mut [u8]) -> bool {
+        let Some(off) = blob.len().checked_sub(CLOCK_WIRE_SIZE) else {
+            return false;
+        };
+        match Schema::decode(blob) {
+            Ok(s) if s.clock.is_some() && Clock::decode(blob, off).is_some() => {
+                blob[off..].copy_from_slice(&self.encode());
+                true
+            }
+            _ => false,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn to_ns_around_reference() {
+        let c = Clock {
+            tick_hz: 2_000_000_000,
+            ref_ticks: 1_000_000,
+            ref_ns: 5_000_000_000,
+        };
+        assert_eq!(c.to_ns(1_000_000), 5_000_000_000);
+        assert_eq!(c.to_ns(1_002_000), 5_000_001_000);
+        assert_eq!(c.to_ns(999_998), 4_999_999_999);
+        assert_eq!(c.to_ns(0), 4_999_500_000);
+
+        // Saturates rather than wrapping
+        let slow = Clock {
+            tick_hz: 1,
+            ref_ticks: 1_000,
+            ref_ns: 0,
+        };
+        assert_eq!(slow.to_ns(u64::MAX), u64::MAX);
+        assert_eq!(slow.to_ns(0), 0);
+    }
+
+    #[test]
+    fn encode_decode_round_trip() {
+        let c = Clock {
+            tick_hz: 24_000_000,
+            ref_ticks: 7,
+            ref_ns: 9,
+        };
+        let b = c.encode();
+        assert_eq!(Clock::decode(&b, 0), Some(c));
+        assert_eq!(Clock::decode(&b[..31], 0), None);
+        let mut bad = b;
+        bad[0] = 0;
+        assert_eq!(Clock::decode(&bad, 0), None);
+    }
+}
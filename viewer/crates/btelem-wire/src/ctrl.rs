@@ -0,0 +1,193 @@
+//! Viewer → server control messages, written on the TCP connection.
+//!
+//! Each message is length-prefixed like a packet:
+//!
+//! ```text
+//! u32 len
+//! u16 type                 # CTRL_*
+//! u16 count
+//! CtrlSub[count]:          # 8 bytes each
+//!     u16 id
+//!     u16 _reserved
+//!     u32 min_interval_us  # 0 = every entry
+//! ```
+//!
+//! A connection starts with every ID at full rate. The first
+//! [`CTRL_SUBSCRIBE`] drops every ID not listed; [`CTRL_UNSUBSCRIBE`]
+//! removes IDs and [`CTRL_RESET`] goes back to everything.
+//!
+//! [`CTRL_HELLO`], sent before reading anything, asks for the compact
+//! schema; the server's first message is then a [`SchemaHello`] (see
+//! [`resolve_schema`]). [`CTRL_COMPRESS`] asks for compressed packets from
+//! then on (see [`crate::decompress_packet`]); older servers ignore it.
+
+use crate::{compact_hash, read_u32, read_u64, Result, WireError};
+
+/// Add IDs (or change their interval).
+pub const CTRL_SUBSCRIBE: u16 = 1;
+/// Remove IDs; intervals are ignored.
+pub const CTRL_UNSUBSCRIBE: u16 = 2;
+/// Every ID at full rate again; no records.
+pub const CTRL_RESET: u16 = 3;
+/// Opt in to the compact schema; carries the hash of the one the viewer
+/// holds (0 = none).
+pub const CTRL_HELLO: u16 = 4;
+/// Send packets compressed whenever that makes them smaller; no records.
+pub const CTRL_COMPRESS: u16 = 5;
+
+pub const CTRL_HEADER_SIZE: usize = 4;
+pub const CTRL_SUB_SIZE: usize = 8;
+
+/// One subscribed schema ID.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Subscription {
+    pub id: u16,
+    /// Minimum spacing of entry timestamps sent; 0 = every entry.
+    pub min_interval_us: u32,
+}
+
+impl Subscription {
+    /// Subscribe to `id`, at most `max_rate_hz` entries per second
+    /// (0 or less = every entry).
+    pub fn at_rate(id: u16, max_rate_hz: f64) -> Self {
+        let min_interval_us = if max_rate_hz > 0.0 {
+            (1e6 / max_rate_hz).round().min(f64::from(u32::MAX)) as u32
+        } else {
+            0
+        };
+        Self {
+            id,
+            min_interval_us,
+        }
+    }
+}
+
+/// Encode one length-prefixed control message.
+pub fn encode_control(kind: u16, subs: &[Subscription]) -> Vec<u8> {
+    let body = CTRL_HEADER_SIZE + subs.len() * CTRL_SUB_SIZE;
+    let mut out = Vec::with_capacity(4 + body);
+    out.extend_from_slice(&(body as u32).to_le_bytes());
+    out.extend_from_slice(&kind.to_le_bytes());
+    out.extend_from_slice(&(subs.len() as u16).to_le_bytes());
+    for s in subs {
+        out.extend_from_slice(&s.id.to_le_bytes());
+        out.extend_from_slice(&0u16.to_le_bytes());
+        out.extend_from_slice(&s.min_interval_us.to_le_bytes());
+    }
+    out
+}
+
+/// Encode the HELLO a viewer sends on connect.
+pub fn encode_hello(schema_hash: u64) -> Vec<u8> {
+    let mut out = Vec::with_capacity(4 + CTRL_HEADER_SIZE + 8);
+    out.extend_from_slice(&((CTRL_HEADER_SIZE + 8) as u32).to_le_bytes());
+    out.extend_from_slice(&CTRL_HELLO.to_le_bytes());
+    out.extend_from_slice(&0u16.to_le_bytes());
+    out.extend_from_slice(&schema_hash.to_le_bytes());
+    out
+}
+
+pub const SCHEMA_HELLO_MAGIC: u32 = 0x4853_5442; // "BTSH"
+pub const SCHEMA_HELLO_SIZE: usize = 16;
+
+/// Server reply to [`CTRL_HELLO`], followed by `schema_size` bytes of
+/// compact schema (0 = the viewer's cached copy is current).
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SchemaHello {
+    pub schema_size: u32,
+    pub hash: u64,
+}
+
+impl SchemaHello {
+    /// `None` if `msg` is not a hello reply.
+    pub fn decode(msg: &[u8]) -> Option<Self> {
+        if read_u32(msg, 0).ok()? != SCHEMA_HELLO_MAGIC {
+            return None;
+        }
+        Some(Self {
+            schema_size: read_u32(msg, 4).ok()?,
+            hash: read_u64(msg, 8).ok()?,
+        })
+    }
+}
+
+/// Schema blob from the first message of a TCP stream: a hello reply
+/// (compact schema, or only its hash when `cached` is current) or, from a
+/// server without HELLO support, the fixed-size schema itself.
+pub fn resolve_schema(msg: Vec<u8>, cached: Option<&[u8]>) -> Result<Vec<u8>> {
+    let Some(hello) = SchemaHello::decode(&msg) else {
+        return Ok(msg);
+    };
+    if hello.schema_size > 0 {
+        let end = SCHEMA_HELLO_SIZE + hello.schema_size as usize;
+        crate::need(&msg, end)?;
+        return Ok(msg[SCHEMA_HELLO_SIZE..end].to_vec());
+    }
+    match cached {
+        Some(c) if compact_hash(c) == Some(hello.hash) => Ok(c.to_vec()),
+        _ => Err(WireError::SchemaNotCached),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn encodes_subscribe() {
+        let msg = encode_control(
+            CTRL_SUBSCRIBE,
+            &[
+                Subscription::at_rate(3, 50.0),
+                Subscription::at_rate(7, 0.0),
+            ],
+        );
+        assert_eq!(
+            msg,
+            [
+                20, 0, 0, 0, // len
+                1, 0, 2, 0, // SUBSCRIBE, 2 records
+                3, 0, 0, 0, 0x20, 0x4e, 0, 0, // id 3, 20000 us
+                7, 0, 0, 0, 0, 0, 0, 0, // id 7, every entry
+            ]
+        );
+    }
+
+    #[test]
+    fn encodes_reset() {
+        assert_eq!(encode_control(CTRL_RESET, &[]), [4, 0, 0, 0, 3, 0, 0, 0]);
+    }
+
+    #[test]
+    fn encodes_hello() {
+        assert_eq!(
+            encode_hello(0x0102_0304_0506_0708),
+            [12, 0, 0, 0, 4, 0, 0, 0, 8, 7, 6, 5, 4, 3, 2, 1]
+        );
+    }
+
+    #[test]
+    fn resolves_hello_replies() {
+        let mut blob = vec![0u8; 20];
+        blob[0..4].copy_from_slice(&crate::SCHEMA_COMPACT_MAGIC.to_le_bytes());
+        blob[8..16].copy_from_slice(&77u64.to_le_bytes());
+        let hello = |size: u32| {
+            let mut m = SCHEMA_HELLO_MAGIC.to_le_bytes().to_vec();
+            m.extend_from_slice(&size.to_le_bytes());
+            m.extend_from_slice(&77u64.to_le_bytes());
+            m
+        };
+
+        let mut sent = hello(20);
+        sent.extend_from_slice(&blob);
+        assert_eq!(resolve_schema(sent, None).unwrap(), blob);
+        assert_eq!(resolve_schema(hello(0), Some(&blob)).unwrap(), blob);
+        assert_eq!(
+            resolve_schema(hello(0), Some(&[0u8; 20])),
+            Err(WireError::SchemaNotCached)
+        );
+        assert!(resolve_schema(hello(21), None).is_err());
+        // Fixed-size schema from an older server passes through
+        assert_eq!(resolve_schema(vec![0, 1, 0], None).unwrap(), [0, 1, 0]);
+    }
+}
@@ -13,6 +13,7 @@
 //!     EnumWire[enum_count]      # 2053 bytes each
 //!     u16 bitfield_count
 //!     BitfieldWire[bf_count]    # 1093 bytes each
+//!     [ClockWire]               # 32 bytes, only for tick timestamps
 //!
 //! repeated:
 //!     u32 packet_len
@@ -22,18 +23,43 @@
 //!         payload_buffer            # variable; offsets into here
 //! ```
 //!
+//! A packet with `PACKET_FLAG_CLOCK` set carries no entries; its payload is
+//! a `ClockWire` refreshing the schema's tick calibration (see [`Clock`]).
+//!
+//! Binary UDP carries one packet per datagram with no length prefix, a
+//! sequence number in the header's last word, and the schema in-band as
+//! `PACKET_FLAG_SCHEMA` fragments.
+//!
+//! The schema blob also comes in a compact form (see [`Schema::decode`]):
+//! a 16-byte header with magic, version and a content hash, then
+//! length-prefixed records. Viewers that open with [`ctrl::encode_hello`]
+//! receive it wrapped in a [`SchemaHello`], and only the hash if they
+//! already hold that schema.
+//!
+//! Viewers may write [`ctrl`] messages back on a TCP connection to
+//! subscribe to a subset of IDs, optionally rate-limited.
+//!
 //! See `include/btelem/btelem_types.h` for the authoritative definitions.
 
 #![forbid(unsafe_code)]
 
 use thiserror::Error;
 
+pub mod clock;
+pub mod ctrl;
 pub mod packet;
 pub mod schema;
 pub mod value;
 
-pub use packet::{decode_packet, DecodedEntry, Packet, PacketHeader};
-pub use schema::{BitDef, BitfieldDef, EnumDef, FieldDef, FieldType, Schema, SchemaEntry};
+pub use clock::{Clock, CLOCK_MAGIC, CLOCK_WIRE_SIZE};
+pub use ctrl::{
+    encode_control, encode_hello, resolve_schema, SchemaHello, Subscription, CTRL_COMPRESS,
+    CTRL_HELLO, CTRL_RESET, CTRL_SUBSCRIBE, CTRL_UNSUBSCRIBE,
+};
+pub use packet::{decode_packet, decompress_packet, DecodedEntry, Packet, PacketHeader};
+pub use schema::{
+    compact_hash, BitDef, BitfieldDef, EnumDef, FieldDef, FieldType, Schema, SchemaEntry,
+};
 pub use value::{field_as_f64, field_as_string};
 
 #[derive(Debug, Error, PartialEq, Eq)]
@@ -56,6 +82,14 @@ pub enum WireError {
     },
     #[error("unknown field type {0}")]
     UnknownType(u8),
+    #[error("unsupported compact schema version {0}")]
+    BadVersion(u8),
+    #[error("server skipped the schema but no matching copy is cached")]
+    SchemaNotCached,
+    #[error("compressed packet; decompress_packet it first")]
+    Compressed,
+    #[error("malformed compressed packet")]
+    BadCompression,
 }
 
 pub type Result<T> = std::result::Result<T, WireError>;
@@ -71,6 +105,10 @@ pub const BITFIELD_MAX_BITS: usize = 32;
 pub const BIT_NAME_MAX: usize = 32;
 
 pub const SCHEMA_HEADER_SIZE: usize = 3;
+/// Compact schema header: magic "BTCS", version, endianness, entry_count, hash.
+pub const SCHEMA_COMPACT_MAGIC: u32 = 0x5343_5442;
+pub const SCHEMA_COMPACT_VERSION: u8 = 1;
+pub const SCHEMA_COMPACT_HEADER_SIZE: usize = 16;
 pub const FIELD_WIRE_SIZE: usize = NAME_MAX + 2 + 2 + 1 + 1; // 70
 pub const SCHEMA_WIRE_HEADER_SIZE: usize = 2 + 2 + 2 + NAME_MAX + DESC_MAX; // 198
 pub const SCHEMA_WIRE_SIZE: usize = SCHEMA_WIRE_HEADER_SIZE + MAX_FIELDS * FIELD_WIRE_SIZE; // 1318
@@ -81,6 +119,19 @@ pub const BITFIELD_WIRE_SIZE: usize =
 pub const PACKET_HEADER_SIZE: usize = 16;
 pub const ENTRY_HEADER_SIZE: usize = 16;
 
+/// Packet flag: no entries, payload is a clock calibration record.
+pub const PACKET_FLAG_CLOCK: u16 = 0x0001;
+/// Packet flag: no entries, payload is a schema fragment (datagram
+/// transports): `total_size: u32`, `offset: u32`, then the fragment bytes.
+pub const PACKET_FLAG_SCHEMA: u16 = 0x0002;
+pub const SCHEMA_FRAG_HEADER_SIZE: usize = 8;
+/// Packet flag: entries are delta-coded (see [`decompress_packet`]);
+/// `payload_size` counts the bytes after the header.
+pub const PACKET_FLAG_COMPRESSED: u16 = 0x0004;
+/// IDs below this are XORed against their previous payload in a
+/// compressed packet.
+pub const PACKET_DELTA_IDS: usize = 512;
+
 // Compile-time sanity vs the C header.
 const _: () = assert!(FIELD_WIRE_SIZE == 70);
 const _: () = assert!(SCHEMA_WIRE_SIZE == 1318);
@@ -1,5 +1,7 @@
 //! Packet decode.
 
+use std::borrow::Cow;
+
 use crate::*;
 
 /// Decoded packet header.
@@ -9,6 +11,8 @@ pub struct PacketHeader {
     pub flags: u16,
     pub payload_size: u32,
     pub dropped: u32,
+    /// Datagram sequence number (binary UDP); 0 on stream transports.
+    pub seq: u32,
 }
 
 /// One entry within a packet, with the payload borrowed from the input.
@@ -19,27 +23,73 @@ pub struct DecodedEntry<'a> {
     pub payload: &'a [u8],
 }
 
+impl PacketHeader {
+    /// True for a clock-update packet (`PACKET_FLAG_CLOCK`).
+    pub fn is_clock(&self) -> bool {
+        self.flags & PACKET_FLAG_CLOCK != 0
+    }
+
+    /// True for a schema fragment packet (`PACKET_FLAG_SCHEMA`).
+    pub fn is_schema(&self) -> bool {
+        self.flags & PACKET_FLAG_SCHEMA != 0
+    }
+
+    /// True for a delta-coded packet (`PACKET_FLAG_COMPRESSED`); pass it
+    /// through [`decompress_packet`] before decoding.
+    pub fn is_compressed(&self) -> bool {
+        self.flags & PACKET_FLAG_COMPRESSED != 0
+    }
+}
+
 /// Whole packet: header plus entries borrowing from the input.
 #[derive(Clone, Debug, PartialEq, Eq)]
 pub struct Packet<'a> {
     pub header: PacketHeader,
     pub entries: Vec<DecodedEntry<'a>>,
+    /// Calibration carried by a clock-update packet; apply it to the
+    /// schema clock for subsequent packets.
+    pub clock: Option<Clock>,
 }
 
 /// Decode one packet (the bytes that follow the u32 length prefix on the wire).
+///
+/// Compressed packets are rejected with [`WireError::Compressed`]; see
+/// [`decompress_packet`].
 pub fn decode_packet(buf: &[u8]) -> Result<Packet<'_>> {
     need(buf, PACKET_HEADER_SIZE)?;
     let entry_count = read_u16(buf, 0)?;
     let flags = read_u16(buf, 2)?;
     let payload_size = read_u32(buf, 4)?;
     let dropped = read_u32(buf, 8)?;
+    let seq = read_u32(buf, 12)?;
     let header = PacketHeader {
         entry_count,
         flags,
         payload_size,
         dropped,
+        seq,
     };
 
+    if header.is_clock() {
+        need(buf, PACKET_HEADER_SIZE + payload_size as usize)?;
+        return Ok(Packet {
+            header,
+            entries: Vec::new(),
+            clock: Clock::decode(buf, PACKET_HEADER_SIZE),
+        });
+    }
+    if header.is_schema() {
+        need(buf, PACKET_HEADER_SIZE + payload_size as usize)?;
+        return Ok(Packet {
+            header,
+            entries: Vec::new(),
+            clock: None,
+        });
+    }
+    if header.is_compressed() {
+        return Err(WireError::Compressed);
+    }
+
     let table_off = PACKET_HEADER_SIZE;
     let payload_base = table_off + entry_count as usize * ENTRY_HEADER_SIZE;
     need(buf, payload_base)?;
@@ -67,5 +117,125 @@ pub fn decode_packet(buf: &[u8]) -> Result<Packet<'_>> {
         });
     }
 
-    Ok(Packet { header, entries })
+    Ok(Packet {
+        header,
+        entries,
+        clock: None,
+    })
+}
+
+/// Expand a `PACKET_FLAG_COMPRESSED` packet into the plain layout that
+/// [`decode_packet`] reads; any other packet is returned as is.
+///
+/// Same format as `btelem_packet_decompress()` (see btelem_types.h):
+/// varint id, size and zigzag timestamp delta per entry, then the payload
+/// as (zeros << 4 | literals) runs, XORed with the previous payload of the
+/// same ID and size.
+pub fn decompress_packet(buf: &[u8]) -> Result<Cow<'_, [u8]>> {
+    need(buf, PACKET_HEADER_SIZE)?;
+    let entry_count = read_u16(buf, 0)? as usize;
+    let flags = read_u16(buf, 2)?;
+    if flags & PACKET_FLAG_COMPRESSED == 0 {
+        return Ok(Cow::Borrowed(buf));
+    }
+    let body_size = read_u32(buf, 4)? as usize;
+    need(buf, PACKET_HEADER_SIZE + body_size)?;
+    let mut src = Varints {
+        buf: &buf[PACKET_HEADER_SIZE..PACKET_HEADER_SIZE + body_size],
+        pos: 0,
+    };
+
+    let table_end = PACKET_HEADER_SIZE + entry_count * ENTRY_HEADER_SIZE;
+    let mut table = Vec::with_capacity(table_end);
+    table.extend_from_slice(&buf[..PACKET_HEADER_SIZE]);
+    let mut payload: Vec<u8> = Vec::new();
+    // (offset, size) of the previous payload per delta-coded ID
+    let mut prev: Vec<Option<(usize, usize)>> = vec![None; PACKET_DELTA_IDS];
+    let mut ts = 0u64;
+
+    for _ in 0..entry_count {
+        let id = src.next()?;
+        let size = src.next()?;
+        let zz = src.next()?;
+        ts = ts.wrapping_add((zz >> 1) ^ (zz & 1).wrapping_neg());
+        let (Ok(id), Ok(size)) = (u16::try_from(id), u16::try_from(size)) else {
+            return Err(WireError::BadCompression);
+        };
+        let size = size as usize;
+
+        let off = payload.len();
+        let slot = prev.get_mut(id as usize);
+        let reference = match slot.as_deref() {
+            Some(Some((r_off, r_size))) if *r_size == size => Some(*r_off),
+            _ => None,
+        };
+        if let Some(slot) = slot {
+            *slot = Some((off, size));
+        }
+        match reference {
+            Some(r_off) => payload.extend_from_within(r_off..r_off + size),
+            None => payload.resize(off + size, 0),
+        }
+
+        let mut k = 0;
+        while k < size {
+            let run = src.next()?;
+            let (zeros, lits) = ((run >> 4) as usize, (run & 15) as usize);
+            if run == 0 || (run >> 4) > (size - k) as u64 || lits > size - k - zeros {
+                return Err(WireError::BadCompression);
+            }
+            k += zeros;
+            for b in src.take(lits)? {
+                payload[off + k] ^= b;
+                k += 1;
+            }
+        }
+
+        table.extend_from_slice(&id.to_le_bytes());
+        table.extend_from_slice(&(size as u16).to_le_bytes());
+        table.extend_from_slice(&(off as u32).to_le_bytes());
+        table.extend_from_slice(&ts.to_le_bytes());
+    }
+    if src.pos != src.buf.len() || u32::try_from(payload.len()).is_err() {
+        return Err(WireError::BadCompression);
+    }
+
+    table[2..4].copy_from_slice(&(flags & !PACKET_FLAG_COMPRESSED).to_le_bytes());
+    table[4..8].copy_from_slice(&(payload.len() as u32).to_le_bytes());
+    table.extend_from_slice(&payload);
+    Ok(Cow::Owned(table))
+}
+
+/// LEB128 reader over a compressed packet body.
+struct Varints<'a> {
+    buf: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Varints<'a> {
+    fn next(&mut self) -> Result<u64> {
+        let mut v = 0u64;
+        let mut shift = 0;
+        while shift < 64 {
+            let Some(&b) = self.buf.get(self.pos) else {
+                break;
+            };
+            self.pos += 1;
+            v |= u64::from(b & 0x7f) << shift;
+            if b & 0x80 == 0 {
+                return Ok(v);
+            }
+            shift += 7;
+        }
+        Err(WireError::BadCompression)
+    }
+
+    fn take(&mut self, n: usize) -> Result<impl Iterator<Item = u8> + 'a> {
+        let bytes = self
+            .buf
+            .get(self.pos..self.pos + n)
+            .ok_or(WireError::BadCompression)?;
+        self.pos += n;
+        Ok(bytes.iter().copied())
+    }
 }
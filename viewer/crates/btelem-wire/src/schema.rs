@@ -91,12 +91,30 @@ pub struct Schema {
     pub entries: Vec<SchemaEntry>,
     pub enums: Vec<EnumDef>,
     pub bitfields: Vec<BitfieldDef>,
+    /// Tick calibration; `None` means timestamps are already nanoseconds.
+    pub clock: Option<Clock>,
 }
 
 impl Schema {
     /// Decode a serialised schema blob (the bytes that follow the u32 length
-    /// prefix on the wire).
+    /// prefix on the wire), in either the fixed-size or the compact format.
+    ///
+    /// Compact layout (strings are a u8 length then that many bytes):
+    ///
+    /// ```text
+    /// u32 magic, u8 version, u8 endianness, u16 entry_count, u64 hash
+    /// entry[entry_count]: u16 id, u16 payload_size, u16 field_count,
+    ///     str name, str description,
+    ///     field[field_count]: str name, u16 offset, u16 size, u8 type, u8 count
+    /// u16 enum_count, enum[]: u16 schema_id, u16 field_index, u8 n, str[n]
+    /// u16 bitfield_count, bitfield[]: u16 schema_id, u16 field_index, u8 n,
+    ///     (str name, u8 start, u8 width)[n]
+    /// [ClockWire]
+    /// ```
     pub fn decode(buf: &[u8]) -> Result<Self> {
+        if compact_hash(buf).is_some() {
+            return decode_compact(buf);
+        }
         let endian = read_u8(buf, 0)?;
         if endian != 0 {
             return Err(WireError::BadEndian(endian));
@@ -137,13 +155,23 @@ impl Schema {
             }
         }
 
+        // Optional clock record
+        let clock = Clock::decode(buf, pos);
+
         Ok(Schema {
             entries,
             enums,
             bitfields,
+            clock,
         })
     }
 
+    /// Convert an entry timestamp to nanoseconds using the schema clock.
+    #[inline]
+    pub fn timestamp_ns(&self, timestamp: u64) -> u64 {
+        self.clock.map_or(timestamp, |c| c.to_ns(timestamp))
+    }
+
     /// Find an entry by id.
     pub fn entry(&self, id: u16) -> Option<&SchemaEntry> {
         self.entries.iter().find(|e| e.id == id)
@@ -165,6 +193,140 @@ impl Schema {
     }
 }
 
+/// Content hash from a compact schema blob's header (FNV-1a over the
+/// records, excluding the clock); `None` for fixed-size blobs.
+pub fn compact_hash(buf: &[u8]) -> Option<u64> {
+    if read_u32(buf, 0).ok()? != SCHEMA_COMPACT_MAGIC {
+        return None;
+    }
+    read_u64(buf, 8).ok()
+}
+
+/// Read position in a compact schema blob.
+struct Cursor<'a> {
+    buf: &'a [u8],
+    pos: usize,
+}
+
+impl Cursor<'_> {
+    fn u8(&mut self) -> Result<u8> {
+        let v = read_u8(self.buf, self.pos)?;
+        self.pos += 1;
+        Ok(v)
+    }
+
+    fn u16(&mut self) -> Result<u16> {
+        let v = read_u16(self.buf, self.pos)?;
+        self.pos += 2;
+        Ok(v)
+    }
+
+    fn str(&mut self) -> Result<String> {
+        let n = self.u8()? as usize;
+        need(self.buf, self.pos + n)?;
+        let s = std::str::from_utf8(&self.buf[self.pos..self.pos + n])
+            .map_err(|_| WireError::BadName)?;
+        self.pos += n;
+        Ok(s.to_owned())
+    }
+}
+
+fn decode_compact(buf: &[u8]) -> Result<Schema> {
+    let version = read_u8(buf, 4)?;
+    if version != SCHEMA_COMPACT_VERSION {
+        return Err(WireError::BadVersion(version));
+    }
+    let endian = read_u8(buf, 5)?;
+    if endian != 0 {
+        return Err(WireError::BadEndian(endian));
+    }
+    let entry_count = read_u16(buf, 6)? as usize;
+    if entry_count > MAX_SCHEMA_ENTRIES {
+        return Err(WireError::TooManyEntries(entry_count as u16));
+    }
+
+    let mut c = Cursor {
+        buf,
+        pos: SCHEMA_COMPACT_HEADER_SIZE,
+    };
+    let mut entries = Vec::with_capacity(entry_count);
+    for _ in 0..entry_count {
+        let id = c.u16()?;
+        let payload_size = c.u16()?;
+        let field_count = c.u16()? as usize;
+        if field_count > MAX_FIELDS {
+            return Err(WireError::TooManyFields(field_count as u16));
+        }
+        let name = c.str()?;
+        let description = c.str()?;
+        let mut fields = Vec::with_capacity(field_count);
+        for _ in 0..field_count {
+            let name = c.str()?;
+            let offset = c.u16()?;
+            let size = c.u16()?;
+            let ty = FieldType::from_u8(c.u8()?)?;
+            let count = c.u8()?;
+            fields.push(FieldDef {
+                name,
+                offset,
+                size,
+                ty,
+                count,
+            });
+        }
+        entries.push(SchemaEntry {
+            id,
+            name,
+            description,
+            payload_size,
+            fields,
+        });
+    }
+
+    let n = c.u16()? as usize;
+    let mut enums = Vec::with_capacity(n);
+    for _ in 0..n {
+        let schema_id = c.u16()?;
+        let field_index = c.u16()?;
+        let label_count = c.u8()? as usize;
+        let labels = (0..label_count)
+            .map(|_| c.str())
+            .collect::<Result<Vec<_>>>()?;
+        enums.push(EnumDef {
+            schema_id,
+            field_index,
+            labels,
+        });
+    }
+
+    let n = c.u16()? as usize;
+    let mut bitfields = Vec::with_capacity(n);
+    for _ in 0..n {
+        let schema_id = c.u16()?;
+        let field_index = c.u16()?;
+        let bit_count = c.u8()? as usize;
+        let mut bits = Vec::with_capacity(bit_count);
+        for _ in 0..bit_count {
+            let name = c.str()?;
+            let start = c.u8()?;
+            let width = c.u8()?;
+            bits.push(BitDef { name, start, width });
+        }
+        bitfields.push(BitfieldDef {
+            schema_id,
+            field_index,
+            bits,
+        });
+    }
+
+    Ok(Schema {
+        entries,
+        enums,
+        bitfields,
+        clock: Clock::decode(buf, c.pos),
+    })
+}
+
 fn decode_schema_entry(buf: &[u8], pos: usize) -> Result<SchemaEntry> {
     let id = read_u16(buf, pos)?;
     let payload_size = read_u16(buf, pos + 2)?;
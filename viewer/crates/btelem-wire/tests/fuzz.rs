@@ -1,6 +1,6 @@
 //! Fuzz-style: random byte slices must never panic the decoders.
 
-use btelem_wire::{decode_packet, Schema};
+use btelem_wire::{decode_packet, decompress_packet, Schema};
 use proptest::prelude::*;
 
 proptest! {
@@ -15,4 +15,14 @@ proptest! {
     fn packet_decode_does_not_panic(data: Vec<u8>) {
         let _ = decode_packet(&data);
     }
+
+    #[test]
+    fn packet_decompress_does_not_panic(mut data: Vec<u8>) {
+        if data.len() >= 4 {
+            data[2] |= 0x04; // PACKET_FLAG_COMPRESSED
+        }
+        if let Ok(plain) = decompress_packet(&data) {
+            let _ = decode_packet(&plain);
+        }
+    }
 }
@@ -2,8 +2,10 @@
 //! These exercise the exact byte layout used by the C side.
 
 use btelem_wire::{
-    decode_packet, FieldType, Schema, BITFIELD_WIRE_SIZE, ENUM_WIRE_SIZE, FIELD_WIRE_SIZE,
-    SCHEMA_HEADER_SIZE, SCHEMA_WIRE_HEADER_SIZE, SCHEMA_WIRE_SIZE,
+    compact_hash, decode_packet, decompress_packet, Clock, FieldType, Schema, WireError,
+    BITFIELD_WIRE_SIZE, CLOCK_WIRE_SIZE, ENUM_WIRE_SIZE, FIELD_WIRE_SIZE, PACKET_FLAG_CLOCK,
+    PACKET_FLAG_COMPRESSED, SCHEMA_COMPACT_MAGIC, SCHEMA_COMPACT_VERSION, SCHEMA_HEADER_SIZE,
+    SCHEMA_WIRE_HEADER_SIZE, SCHEMA_WIRE_SIZE,
 };
 
 fn write_cstr(buf: &mut [u8], s: &str) {
@@ -100,6 +102,85 @@ fn schema_round_trip_full() {
     assert_eq!(bf.bits[1].start, 1);
 }
 
+fn put_str(buf: &mut Vec<u8>, s: &str) {
+    buf.push(s.len() as u8);
+    buf.extend_from_slice(s.as_bytes());
+}
+
+/// Same content as [`build_schema_blob`] in the compact format.
+fn build_compact_blob() -> Vec<u8> {
+    let mut buf = Vec::new();
+    buf.extend_from_slice(&SCHEMA_COMPACT_MAGIC.to_le_bytes());
+    buf.push(SCHEMA_COMPACT_VERSION);
+    buf.push(0); // little
+    buf.extend_from_slice(&1u16.to_le_bytes()); // entry_count
+    buf.extend_from_slice(&0xfeed_u64.to_le_bytes()); // hash
+
+    buf.extend_from_slice(&0u16.to_le_bytes());
+    buf.extend_from_slice(&32u16.to_le_bytes());
+    buf.extend_from_slice(&8u16.to_le_bytes());
+    put_str(&mut buf, "counters");
+    put_str(&mut buf, "Staggered uint32 counters");
+    for i in 0..8u16 {
+        put_str(&mut buf, &format!("c{i}"));
+        buf.extend_from_slice(&(i * 4).to_le_bytes());
+        buf.extend_from_slice(&4u16.to_le_bytes());
+        buf.push(FieldType::U32 as u8);
+        buf.push(1);
+    }
+
+    buf.extend_from_slice(&1u16.to_le_bytes());
+    buf.extend_from_slice(&99u16.to_le_bytes());
+    buf.extend_from_slice(&0u16.to_le_bytes());
+    buf.push(3);
+    for l in ["idle", "run", "fault"] {
+        put_str(&mut buf, l);
+    }
+
+    buf.extend_from_slice(&1u16.to_le_bytes());
+    buf.extend_from_slice(&42u16.to_le_bytes());
+    buf.extend_from_slice(&0u16.to_le_bytes());
+    buf.push(2);
+    for (name, start) in [("fault_a", 0u8), ("fault_b", 1)] {
+        put_str(&mut buf, name);
+        buf.push(start);
+        buf.push(1);
+    }
+
+    buf
+}
+
+#[test]
+fn compact_schema_matches_fixed() {
+    let blob = build_compact_blob();
+    assert_eq!(compact_hash(&blob), Some(0xfeed));
+    assert_eq!(compact_hash(&build_schema_blob()), None);
+    assert_eq!(
+        Schema::decode(&blob).expect("decode"),
+        Schema::decode(&build_schema_blob()).unwrap()
+    );
+    assert!(blob.len() * 20 < build_schema_blob().len());
+
+    let clock = Clock {
+        tick_hz: 1_000_000,
+        ref_ticks: 7,
+        ref_ns: 9,
+    };
+    let mut with_clock = blob.clone();
+    with_clock.extend_from_slice(&clock.encode());
+    assert_eq!(Schema::decode(&with_clock).unwrap().clock, Some(clock));
+
+    for n in 0..blob.len() {
+        assert!(Schema::decode(&blob[..n]).is_err(), "truncated at {n}");
+    }
+    let mut newer = blob.clone();
+    newer[4] = SCHEMA_COMPACT_VERSION + 1;
+    assert_eq!(
+        Schema::decode(&newer),
+        Err(WireError::BadVersion(SCHEMA_COMPACT_VERSION + 1))
+    );
+}
+
 #[test]
 fn schema_decode_rejects_bad_endian() {
     let mut blob = build_schema_blob();
@@ -168,3 +249,127 @@ fn packet_short_buffer_does_not_panic() {
         let _ = decode_packet(&buf[..n]);
     }
 }
+
+/// `build_packet()` as btelem_packet_compress() encodes it.
+fn build_compressed_packet() -> Vec<u8> {
+    let body: &[u8] = &[
+        0x00, 0x04, 0xd0, 0x0f, // id 0, 4 bytes, ts +1000
+        0x04, 0xef, 0xbe, 0xad, 0xde, // 4 literals
+        0x00, 0x04, 0xd0, 0x0f, // id 0, 4 bytes, ts +1000
+        0x04, 0x51, 0x04, 0x53, 0x14, // XOR with the previous id 0 payload
+    ];
+    let mut buf = Vec::new();
+    buf.extend_from_slice(&2u16.to_le_bytes());
+    buf.extend_from_slice(&PACKET_FLAG_COMPRESSED.to_le_bytes());
+    buf.extend_from_slice(&(body.len() as u32).to_le_bytes());
+    buf.extend_from_slice(&7u32.to_le_bytes());
+    buf.extend_from_slice(&0u32.to_le_bytes());
+    buf.extend_from_slice(body);
+    buf
+}
+
+#[test]
+fn compressed_packet_expands_to_plain() {
+    let plain = build_packet();
+    let z = build_compressed_packet();
+    assert_eq!(decode_packet(&z), Err(WireError::Compressed));
+    assert_eq!(decompress_packet(&z).unwrap().as_ref(), plain.as_slice());
+    // Plain packets pass through untouched
+    assert!(matches!(
+        decompress_packet(&plain).unwrap(),
+        std::borrow::Cow::Borrowed(_)
+    ));
+
+    for n in 0..z.len() {
+        assert!(decompress_packet(&z[..n]).is_err());
+    }
+    let mut trailing = z.clone();
+    trailing.push(0);
+    let body_size = (trailing.len() - 16) as u32;
+    trailing[4..8].copy_from_slice(&body_size.to_le_bytes());
+    assert_eq!(decompress_packet(&trailing), Err(WireError::BadCompression));
+}
+
+#[test]
+fn compressed_packet_zero_runs_and_untracked_ids() {
+    // Zero runs, a negative timestamp delta and an ID past PACKET_DELTA_IDS
+    let body: &[u8] = &[
+        0x00, 0x08, 0x90, 0x4e, 0x01, 0x01, 0x61, 0x02, // id 0 @5000: 01, 6 zeros, 02
+        0x00, 0x08, 0xcf, 0x0f, 0x71, 0x01, // id 0 @4000: 7 zeros, ^01
+        0xbc, 0x05, 0x02, 0x02, 0x02, 0x61, 0x62, // id 700 @4001: "ab"
+    ];
+    let mut z = vec![3, 0];
+    z.extend_from_slice(&PACKET_FLAG_COMPRESSED.to_le_bytes());
+    z.extend_from_slice(&(body.len() as u32).to_le_bytes());
+    z.extend_from_slice(&[0u8; 8]);
+    z.extend_from_slice(body);
+
+    let plain = decompress_packet(&z).expect("decompress");
+    let pkt = decode_packet(&plain).expect("decode");
+    assert_eq!(pkt.header.flags, 0);
+    assert_eq!(pkt.header.payload_size, 18);
+    let got: Vec<_> = pkt
+        .entries
+        .iter()
+        .map(|e| (e.id, e.timestamp, e.payload))
+        .collect();
+    assert_eq!(
+        got,
+        [
+            (0, 5000, &[1u8, 0, 0, 0, 0, 0, 0, 2][..]),
+            (0, 4000, &[1u8, 0, 0, 0, 0, 0, 0, 3][..]),
+            (700, 4001, &b"ab"[..]),
+        ]
+    );
+}
+
+#[test]
+fn schema_clock_record_optional() {
+    let blob = build_schema_blob();
+    assert_eq!(Schema::decode(&blob).unwrap().clock, None);
+
+    let clock = Clock {
+        tick_hz: 3_000_000_000,
+        ref_ticks: 300,
+        ref_ns: 1_000,
+    };
+    let mut with_clock = blob.clone();
+    with_clock.extend_from_slice(&clock.encode());
+    let s = Schema::decode(&with_clock).expect("decode");
+    assert_eq!(s.clock, Some(clock));
+    assert_eq!(s.timestamp_ns(3_300), 2_000);
+
+    // Refresh in place; a clock-less blob is left untouched
+    let newer = Clock {
+        ref_ns: 5_000,
+        ..clock
+    };
+    assert!(newer.patch_schema_blob(&mut with_clock));
+    assert_eq!(Schema::decode(&with_clock).unwrap().clock, Some(newer));
+    let mut plain = blob.clone();
+    assert!(!newer.patch_schema_blob(&mut plain));
+    assert_eq!(plain, blob);
+}
+
+#[test]
+fn clock_packet_decodes_without_entries() {
+    let clock = Clock {
+        tick_hz: 24_000_000,
+        ref_ticks: 1,
+        ref_ns: 2,
+    };
+    let mut buf = Vec::new();
+    buf.extend_from_slice(&0u16.to_le_bytes());
+    buf.extend_from_slice(&PACKET_FLAG_CLOCK.to_le_bytes());
+    buf.extend_from_slice(&(CLOCK_WIRE_SIZE as u32).to_le_bytes());
+    buf.extend_from_slice(&[0u8; 8]);
+    buf.extend_from_slice(&clock.encode());
+
+    let pkt = decode_packet(&buf).expect("decode");
+    assert!(pkt.header.is_clock());
+    assert!(pkt.entries.is_empty());
+    assert_eq!(pkt.clock, Some(clock));
+    assert!(decode_packet(&buf[..buf.len() - 1]).is_err());
+
+    assert_eq!(decode_packet(&build_packet()).unwrap().clock, None);
+}
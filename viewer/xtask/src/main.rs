@@ -1,6 +1,6 @@
 //! xtask: headless soak / replay harness for the Rust viewer pipeline.
 //!
-//! Connects to a btelem TCP server, runs ingest into a MockStore for a
+//! Connects to a btelem TCP server, runs ingest into an InMemoryStore for a
 //! configurable duration, and emits a JSON metrics report on stdout:
 //!
 //! ```json
@@ -21,14 +21,21 @@
 //!
 //! CI runs this with `--duration 5` as a smoke gate; nightly runs longer
 //! with `--duration 600` for memory-leak detection.
+//!
+//! `decode-bench` times the Rust decode paths over a `.btlm` file (the
+//! corpus `btelem_bench --corpus` records) and prints results in the
+//! `btelem_bench` JSON shape for `tests/bench.py` to merge.
 
 use std::io::{BufRead, BufReader};
+use std::path::PathBuf;
 use std::process::{Command, Stdio};
 use std::thread;
 use std::time::{Duration, Instant};
 
-use btelem_ingest::TcpSource;
-use btelem_store::{ChannelKind, MockStore, Store};
+use btelem_capture::read_btlm;
+use btelem_ingest::{ChannelMap, TcpSource};
+use btelem_store::{Batch, ChannelKind, InMemoryStore, Store};
+use btelem_wire::{decode_packet, field_as_f64, Schema};
 use clap::Parser;
 
 #[derive(Parser, Debug)]
@@ -55,6 +62,16 @@ enum Cmd {
         #[arg(long, default_value_t = 5_000_000)]
         spawn_entries: u64,
     },
+    /// Time packet decode and store ingest over a .btlm file and emit the
+    /// results as JSON.
+    DecodeBench {
+        /// Capture to decode.
+        #[arg(long)]
+        file: PathBuf,
+        /// Passes over the file; the fastest is reported.
+        #[arg(long, default_value_t = 3)]
+        rounds: u32,
+    },
 }
 
 fn rss_mb() -> f64 {
@@ -84,9 +101,73 @@ fn main() {
             spawn,
             spawn_entries,
         } => replay(addr, duration, query_hz, spawn, spawn_entries),
+        Cmd::DecodeBench { file, rounds } => decode_bench(file, rounds),
     }
 }
 
+fn decode_bench(file: PathBuf, rounds: u32) {
+    let cap = read_btlm(&file).expect("read capture");
+    let schema = Schema::decode(&cap.schema).expect("decode schema");
+
+    // Fastest of `rounds` passes of `f`, which returns the entries it saw.
+    let best = |f: &dyn Fn() -> u64| -> (f64, u64) {
+        let mut best = f64::INFINITY;
+        let mut entries = 0;
+        for _ in 0..rounds.max(1) {
+            let t = Instant::now();
+            entries = f();
+            best = best.min(t.elapsed().as_secs_f64());
+        }
+        (best, entries)
+    };
+
+    // Wire decode plus a generic per-field f64 conversion.
+    let (wire_s, wire_n) = best(&|| {
+        let mut n = 0u64;
+        let mut sum = 0.0;
+        for p in &cap.packets {
+            let pkt = decode_packet(p).expect("decode packet");
+            for e in &pkt.entries {
+                if let Some(entry) = schema.entry(e.id) {
+                    for f in &entry.fields {
+                        sum += field_as_f64(f, e.payload).unwrap_or(0.0);
+                    }
+                }
+            }
+            n += pkt.entries.len() as u64;
+        }
+        std::hint::black_box(sum);
+        n
+    });
+
+    // The viewer's path: decode plans into a Batch, committed per packet.
+    let (ingest_s, ingest_n) = best(&|| {
+        let store = InMemoryStore::new();
+        let map = ChannelMap::build(&schema, &store).expect("build channel map");
+        let mut batch = Batch::default();
+        let mut n = 0u64;
+        for p in &cap.packets {
+            let pkt = decode_packet(p).expect("decode packet");
+            map.dispatch_packet(&pkt.entries, schema.clock, &mut batch);
+            store.push_batch(&mut batch);
+            n += pkt.entries.len() as u64;
+        }
+        n
+    });
+
+    let result = |name: &str, secs: f64, n: u64| {
+        format!(
+            "{{\"name\":\"{name}\",\"value\":{:.4},\"unit\":\"Mentries/s\",\"better\":\"higher\"}}",
+            n as f64 / secs.max(1e-9) / 1e6
+        )
+    };
+    println!(
+        "{{\"results\":[{},{}]}}",
+        result("decode/rust/wire", wire_s, wire_n),
+        result("decode/rust/ingest", ingest_s, ingest_n),
+    );
+}
+
 fn replay(
     addr: String,
     duration_s: f64,
@@ -112,7 +193,7 @@ fn replay(
         ChildGuard(child)
     });
 
-    let store = MockStore::new();
+    let store = InMemoryStore::new();
     let rss_start = rss_mb();
 
     // Connect with retries.